@@ -45,11 +45,35 @@
 extern FILE * popen( char const *, char const * );
 extern int pclose( FILE * );
 
+extern void bist_apll( void );
 extern void bist_bat( void );
+extern void bist_batch( void );
+extern void bist_batsim( void );
+extern void bist_cansess( void );
 extern void bist_cli( void );
 extern void i_cli( void );
+extern void bist_dpwm( void );
+extern void bist_encoder( void );
+extern void bist_fsched( void );
+extern void bist_hallest( void );
+extern void bist_health( void );
+extern void bist_imu( void );
+extern void bist_infilt( void );
+extern void bist_mt6816( void );
+extern void bist_nvm( void );
+extern void bist_overmod( void );
+extern void bist_profc( void );
 extern void bist_profile( void );
+extern void bist_pstore( void );
+extern void bist_sixstep( void );
+extern void bist_speedloop( void );
 extern void bist_temp( void );
+extern void bist_thermal( void );
+extern void bist_traction( void );
+extern void bist_traj( void );
+extern void bist_trie( void );
+extern void bist_vartab( void );
+extern void bist_vehicle( void );
 
 static void flash_register_profile_io( void )
 {
@@ -387,10 +411,34 @@ static int virt_flash( int argc, char * argv[] )
 int main( int argc, char * argv[] )
 {
     bool const en   = (argc > 1) ? false : true;
-    bool en_bat     = en;
-    bool en_cli     = en;
-    bool en_profile = en;
-    bool en_temp    = en;
+    bool en_apll      = en;
+    bool en_bat       = en;
+    bool en_batch     = en;
+    bool en_batsim    = en;
+    bool en_cansess   = en;
+    bool en_cli       = en;
+    bool en_dpwm      = en;
+    bool en_encoder   = en;
+    bool en_fsched    = en;
+    bool en_hallest   = en;
+    bool en_health    = en;
+    bool en_imu       = en;
+    bool en_infilt    = en;
+    bool en_mt6816    = en;
+    bool en_nvm       = en;
+    bool en_overmod   = en;
+    bool en_profc     = en;
+    bool en_profile   = en;
+    bool en_pstore    = en;
+    bool en_sixstep   = en;
+    bool en_speedloop = en;
+    bool en_temp      = en;
+    bool en_thermal   = en;
+    bool en_traction  = en;
+    bool en_traj      = en;
+    bool en_trie      = en;
+    bool en_vartab    = en;
+    bool en_vehicle   = en;
 
     for ( int a = 1; a < argc; ++a )
     {
@@ -411,25 +459,150 @@ int main( int argc, char * argv[] )
             return virt_flash( argc, argv );
         }
 
+        if (strcmp( argv[a], "+apll" ) == 0)
+        {
+            en_apll = true;
+        }
+
         if (strcmp( argv[a], "+bat" ) == 0)
         {
             en_bat = true;
         }
 
+        if (strcmp( argv[a], "+batch" ) == 0)
+        {
+            en_batch = true;
+        }
+
+        if (strcmp( argv[a], "+batsim" ) == 0)
+        {
+            en_batsim = true;
+        }
+
+        if (strcmp( argv[a], "+cansess" ) == 0)
+        {
+            en_cansess = true;
+        }
+
         if (strcmp( argv[a], "+cli" ) == 0)
         {
             en_cli = true;
         }
 
+        if (strcmp( argv[a], "+dpwm" ) == 0)
+        {
+            en_dpwm = true;
+        }
+
+        if (strcmp( argv[a], "+encoder" ) == 0)
+        {
+            en_encoder = true;
+        }
+
+        if (strcmp( argv[a], "+fsched" ) == 0)
+        {
+            en_fsched = true;
+        }
+
+        if (strcmp( argv[a], "+hallest" ) == 0)
+        {
+            en_hallest = true;
+        }
+
+        if (strcmp( argv[a], "+health" ) == 0)
+        {
+            en_health = true;
+        }
+
+        if (strcmp( argv[a], "+imu" ) == 0)
+        {
+            en_imu = true;
+        }
+
+        if (strcmp( argv[a], "+infilt" ) == 0)
+        {
+            en_infilt = true;
+        }
+
+        if (strcmp( argv[a], "+mt6816" ) == 0)
+        {
+            en_mt6816 = true;
+        }
+
+        if (strcmp( argv[a], "+nvm" ) == 0)
+        {
+            en_nvm = true;
+        }
+
+        if (strcmp( argv[a], "+overmod" ) == 0)
+        {
+            en_overmod = true;
+        }
+
+        if (strcmp( argv[a], "+profc" ) == 0)
+        {
+            en_profc = true;
+        }
+
         if (strcmp( argv[a], "+profile" ) == 0)
         {
             en_profile = true;
         }
 
+        if (strcmp( argv[a], "+pstore" ) == 0)
+        {
+            en_pstore = true;
+        }
+
+        if (strcmp( argv[a], "+sixstep" ) == 0)
+        {
+            en_sixstep = true;
+        }
+
+        if (strcmp( argv[a], "+speedloop" ) == 0)
+        {
+            en_speedloop = true;
+        }
+
         if (strcmp( argv[a], "+temp" ) == 0)
         {
             en_temp = true;
         }
+
+        if (strcmp( argv[a], "+thermal" ) == 0)
+        {
+            en_thermal = true;
+        }
+
+        if (strcmp( argv[a], "+traction" ) == 0)
+        {
+            en_traction = true;
+        }
+
+        if (strcmp( argv[a], "+traj" ) == 0)
+        {
+            en_traj = true;
+        }
+
+        if (strcmp( argv[a], "+trie" ) == 0)
+        {
+            en_trie = true;
+        }
+
+        if (strcmp( argv[a], "+vartab" ) == 0)
+        {
+            en_vartab = true;
+        }
+
+        if (strcmp( argv[a], "+vehicle" ) == 0)
+        {
+            en_vehicle = true;
+        }
+    }
+
+    if (en_apll)
+    {
+        bist_apll();
     }
 
     if (en_bat)
@@ -437,21 +610,136 @@ int main( int argc, char * argv[] )
         bist_bat();
     }
 
+    if (en_batch)
+    {
+        bist_batch();
+    }
+
+    if (en_batsim)
+    {
+        bist_batsim();
+    }
+
+    if (en_cansess)
+    {
+        bist_cansess();
+    }
+
     if (en_cli)
     {
         bist_cli();
     }
 
+    if (en_dpwm)
+    {
+        bist_dpwm();
+    }
+
+    if (en_encoder)
+    {
+        bist_encoder();
+    }
+
+    if (en_fsched)
+    {
+        bist_fsched();
+    }
+
+    if (en_hallest)
+    {
+        bist_hallest();
+    }
+
+    if (en_health)
+    {
+        bist_health();
+    }
+
+    if (en_imu)
+    {
+        bist_imu();
+    }
+
+    if (en_infilt)
+    {
+        bist_infilt();
+    }
+
+    if (en_mt6816)
+    {
+        bist_mt6816();
+    }
+
+    if (en_nvm)
+    {
+        bist_nvm();
+    }
+
+    if (en_overmod)
+    {
+        bist_overmod();
+    }
+
+    if (en_profc)
+    {
+        bist_profc();
+    }
+
     if (en_profile)
     {
         bist_profile();
     }
 
+    if (en_pstore)
+    {
+        bist_pstore();
+    }
+
+    if (en_sixstep)
+    {
+        bist_sixstep();
+    }
+
+    if (en_speedloop)
+    {
+        bist_speedloop();
+    }
+
     if (en_temp)
     {
         bist_temp();
     }
 
+    if (en_thermal)
+    {
+        bist_thermal();
+    }
+
+    if (en_traction)
+    {
+        bist_traction();
+    }
+
+    if (en_traj)
+    {
+        bist_traj();
+    }
+
+    if (en_trie)
+    {
+        bist_trie();
+    }
+
+    if (en_vartab)
+    {
+        bist_vartab();
+    }
+
+    if (en_vehicle)
+    {
+        bist_vehicle();
+    }
+
     return EXIT_SUCCESS;
 (void)argc;
 (void)argv;
@@ -0,0 +1,254 @@
+/*
+* Copyright 2021-2023 cod3b453
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its contributors
+*    may be used to endorse or promote products derived from this software
+*    without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "MESCapll.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define BIST_APLL_F 20000.0f
+
+/*
+Fixed gain PLL as run at the end of fastLoop
+*/
+struct BISTPLL
+{
+    uint32_t angle;
+    float    integral;
+    float    error;
+};
+
+typedef struct BISTPLL BISTPLL;
+
+static float bist_apll_legacy( BISTPLL * const pll, uint16_t const theta )
+{
+    pll->angle    = pll->angle + (uint32_t)(int32_t)((int16_t)pll->integral + (int16_t)pll->error);
+    pll->error    = 0.5f * (float)(int16_t)(theta - (uint16_t)(pll->angle & 0xFFFF));
+    pll->integral = pll->integral + (0.02f * pll->error);
+
+    return pll->integral * BIST_APLL_F * (1.0f / 65536.0f);
+}
+
+static uint32_t bist_apll_seed;
+
+static float bist_apll_gauss( void )
+{
+    float u[2];
+
+    for ( uint32_t i = 0; i < 2; ++i )
+    {
+        bist_apll_seed = (bist_apll_seed * 1664525u) + 1013904223u;
+        u[i] = ((float)(bist_apll_seed >> 8) + 0.5f) / 16777216.0f;
+    }
+
+    return sqrtf( -2.0f * logf( u[0] ) ) * cosf( 6.28318531f * u[1] );
+}
+
+enum BISTAPLLCase
+{
+    BIST_APLL_STEP,   // 50 -> 150 eHz instantly
+    BIST_APLL_RAMP,   // 0 -> 1000 eHz at 5000 eHz/s
+    BIST_APLL_NOISE,  // 30 eHz, 3 deg RMS angle noise
+};
+
+typedef enum BISTAPLLCase BISTAPLLCase;
+
+struct BISTAPLLResult
+{
+    float settle;     // s, last time outside 2 eHz (STEP)
+    float overshoot;  // eHz (STEP)
+    float lag;        // eHz, mean speed error over the last 20 ms (RAMP)
+    float rms;        // eHz, speed error RMS after the first 0.1 s (NOISE)
+};
+
+typedef struct BISTAPLLResult BISTAPLLResult;
+
+/*
+type < 0 runs the fixed gain PLL
+*/
+static BISTAPLLResult bist_apll_run( int const type, BISTAPLLCase const c )
+{
+    APLL           ap;
+    BISTPLL        pll = { 0, 0.0f, 0.0f };
+    BISTAPLLResult res = { 0.0f, 0.0f, 0.0f, 0.0f };
+    double         theta = 0.0;
+    float          eHz_true = 0.0f;
+    uint32_t const N = (uint32_t)(0.25f * BIST_APLL_F);
+    double         sum = 0.0;
+    uint32_t       n_sum = 0;
+
+    apll_init( &ap, BIST_APLL_F );
+    ap.type = (uint8_t)((type < 0) ? APLL_TYPE_NONE : type);
+
+    bist_apll_seed = 12345u;
+
+    // Start locked onto the initial speed so only the disturbance is measured
+    switch (c)
+    {
+        case BIST_APLL_STEP:  eHz_true = 50.0f; break;
+        case BIST_APLL_NOISE: eHz_true = 30.0f; break;
+        case BIST_APLL_RAMP:  eHz_true = 0.0f;  break;
+    }
+
+    ap.omega     = eHz_true * 65536.0f / BIST_APLL_F;
+    pll.integral = ap.omega;
+
+    for ( uint32_t i = 0; i < N; ++i )
+    {
+        float const t = (float)i / BIST_APLL_F;
+
+        switch (c)
+        {
+            case BIST_APLL_STEP:
+                eHz_true = (t < 0.05f) ? 50.0f : 150.0f;
+                break;
+            case BIST_APLL_RAMP:
+                eHz_true = 5000.0f * fminf( t, 0.2f );
+                break;
+            case BIST_APLL_NOISE:
+                break;
+        }
+
+        theta = theta + (65536.0 * (double)eHz_true / (double)BIST_APLL_F);
+
+        double meas = theta;
+
+        if (c == BIST_APLL_NOISE)
+        {
+            meas = meas + (double)(bist_apll_gauss() * (3.0f * 65536.0f / 360.0f));
+        }
+
+        uint16_t const z = (uint16_t)(uint32_t)(int64_t)floor( fmod( meas, 65536.0 ) + 65536.0 );
+        float eHz;
+
+        if (type < 0)
+        {
+            eHz = bist_apll_legacy( &pll, z );
+        }
+        else
+        {
+            apll_run( &ap, z );
+            eHz = apll_eHz( &ap );
+        }
+
+        float const err = eHz - eHz_true;
+
+        switch (c)
+        {
+            case BIST_APLL_STEP:
+                if ((t >= 0.05f) && (fabsf( err ) > 2.0f))
+                {
+                    res.settle = t - 0.05f;
+                }
+
+                if (err > res.overshoot)
+                {
+                    res.overshoot = err;
+                }
+                break;
+            case BIST_APLL_RAMP:
+                if ((t > 0.18f) && (t < 0.2f))
+                {
+                    sum = sum + (double)err;
+                    ++n_sum;
+                }
+                break;
+            case BIST_APLL_NOISE:
+                if (t > 0.1f)
+                {
+                    sum = sum + ((double)err * (double)err);
+                    ++n_sum;
+                }
+                break;
+        }
+    }
+
+    if (n_sum > 0)
+    {
+        res.lag = (float)(sum / (double)n_sum);
+        res.rms = sqrtf( res.lag );
+    }
+
+    return res;
+}
+
+void bist_apll( void )
+{
+    fprintf( stdout, "Starting APLL BIST\n" );
+
+    static char const * const name[] = { "fixed ", "PI    ", "KALMAN" };
+    BISTAPLLResult step[3];
+    BISTAPLLResult ramp[3];
+    BISTAPLLResult noise[3];
+
+    for ( int i = 0; i < 3; ++i )
+    {
+        int const type = (i == 0) ? -1 : ((i == 1) ? APLL_TYPE_PI : APLL_TYPE_KALMAN);
+
+        step[i]  = bist_apll_run( type, BIST_APLL_STEP );
+        ramp[i]  = bist_apll_run( type, BIST_APLL_RAMP );
+        noise[i] = bist_apll_run( type, BIST_APLL_NOISE );
+
+        fprintf( stdout, "    %s step settle %5.1f ms overshoot %5.1f eHz  ramp lag %6.2f eHz  noise %6.2f eHz RMS\n",
+            name[i], (double)(1000.0f * step[i].settle), (double)step[i].overshoot,
+            (double)ramp[i].lag, (double)noise[i].rms );
+    }
+
+    // Locked tracking converges
+    for ( int i = 1; i < 3; ++i )
+    {
+        assert( step[i].settle < 0.025f );
+        assert( fabsf( ramp[i].lag ) < fabsf( ramp[0].lag ) );
+    }
+
+    // Acceleration state removes the ramp lag
+    assert( fabsf( ramp[2].lag ) < (0.1f * fabsf( ramp[0].lag )) );
+    assert( fabsf( ramp[2].lag ) < 1.0f );
+
+    // Low speed with a noisy angle; the bandwidth comes down
+    assert( noise[1].rms < (0.5f * noise[0].rms) );
+    assert( noise[2].rms < (0.5f * noise[0].rms) );
+
+    // Frequency changes leave the speed estimate alone
+    APLL ap;
+
+    apll_init( &ap, 20000.0f );
+    ap.omega = 100.0f;
+    ap.alpha = 0.01f;
+
+    float const eHz = apll_eHz( &ap );
+
+    apll_set_frequency( &ap, 10000.0f );
+    assert( fabsf( apll_eHz( &ap ) - eHz ) < 1.0e-3f );
+    assert( fabsf( ap.alpha - 0.04f ) < 1.0e-6f );
+
+    fprintf( stdout, "Finished APLL BIST\n" );
+}
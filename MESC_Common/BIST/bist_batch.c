@@ -0,0 +1,407 @@
+/*
+* Copyright 2021-2023 cod3b453
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its contributors
+*    may be used to endorse or promote products derived from this software
+*    without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "MESCbatch.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+// A cut down motor setup with derived gains, as calculateGains would produce
+struct BIST_BATCH_MOTOR
+{
+    float    R;
+    float    L;
+    float    bw;
+    float    kp;
+    float    ki;
+    uint8_t  pp;
+    int16_t  trim;
+    bool     enable;
+    uint32_t node;
+};
+
+typedef struct BIST_BATCH_MOTOR BIST_BATCH_MOTOR;
+
+static BIST_BATCH_MOTOR bist_batch_motor;
+static uint32_t         bist_batch_gains;
+static uint32_t         bist_batch_other;
+
+#define BIST_BATCH_GROUP_GAINS 1
+#define BIST_BATCH_GROUP_OTHER 2
+
+struct BIST_BATCH_DESC
+{
+    char const * name;
+    void *       ptr;
+    uint8_t      type;
+    uint8_t      size;
+    bool         writable;
+    float        min;
+    float        max;
+    uintptr_t    group;
+};
+
+typedef struct BIST_BATCH_DESC BIST_BATCH_DESC;
+
+static BIST_BATCH_DESC const bist_batch_desc[] =
+{
+    { "par_r",    &bist_batch_motor.R,      BATCH_TYPE_FLOAT, 4, true,  0.0f,     10.0f,   BIST_BATCH_GROUP_GAINS },
+    { "par_l",    &bist_batch_motor.L,      BATCH_TYPE_FLOAT, 4, true,  0.0f,     10.0f,   BIST_BATCH_GROUP_GAINS },
+    { "curr_bw",  &bist_batch_motor.bw,     BATCH_TYPE_FLOAT, 4, true,  200.0f,   10000.0f, BIST_BATCH_GROUP_GAINS },
+    { "kp",       &bist_batch_motor.kp,     BATCH_TYPE_FLOAT, 4, false, 0.0f,     0.0f,    0 },
+    { "ki",       &bist_batch_motor.ki,     BATCH_TYPE_FLOAT, 4, false, 0.0f,     0.0f,    0 },
+    { "par_pp",   &bist_batch_motor.pp,     BATCH_TYPE_UINT,  1, true,  0.0f,     255.0f,  BIST_BATCH_GROUP_OTHER },
+    { "trim",     &bist_batch_motor.trim,   BATCH_TYPE_INT,   2, true,  -1000.0f, 1000.0f, 0 },
+    { "enable",   &bist_batch_motor.enable, BATCH_TYPE_BOOL,  1, true,  0.0f,     1.0f,    0 },
+    { "node_id",  &bist_batch_motor.node,   BATCH_TYPE_UINT,  4, true,  1.0f,     254.0f,  BIST_BATCH_GROUP_OTHER },
+};
+
+static BATCHError bist_batch_lookup( void * ctx, char const * name, uint32_t len, BATCH_VAR * var )
+{
+    (void)ctx;
+
+    if ((len == 4) && (strncmp( name, "name", 4 ) == 0))
+    {
+        return BATCH_ERR_TYPE;
+    }
+
+    for ( uint32_t i = 0; i < (sizeof(bist_batch_desc) / sizeof(bist_batch_desc[0])); ++i )
+    {
+        BIST_BATCH_DESC const * const d = &bist_batch_desc[i];
+
+        if ((strlen( d->name ) != len) || (strncmp( d->name, name, len ) != 0))
+        {
+            continue;
+        }
+
+        var->ptr      = d->ptr;
+        var->type     = d->type;
+        var->size     = d->size;
+        var->readable = true;
+        var->writable = d->writable;
+        var->group    = d->group;
+        var->tag      = (void *)d;
+
+        switch (d->type)
+        {
+            case BATCH_TYPE_FLOAT:
+                var->min.f = d->min;
+                var->max.f = d->max;
+                break;
+            case BATCH_TYPE_INT:
+                var->min.i = (int32_t)d->min;
+                var->max.i = (int32_t)d->max;
+                break;
+            default:
+                var->min.u = (uint32_t)d->min;
+                var->max.u = (uint32_t)d->max;
+                break;
+        }
+
+        return BATCH_OK;
+    }
+
+    return BATCH_ERR_UNKNOWN;
+}
+
+static void bist_batch_complete( BATCH * batch )
+{
+    for ( uint32_t i = 0; i < batch->count; ++i )
+    {
+        if (batch_first_of_group( batch, i ) == false)
+        {
+            continue;
+        }
+
+        switch (batch->entry[i].group)
+        {
+            case BIST_BATCH_GROUP_GAINS:
+                bist_batch_motor.kp = bist_batch_motor.L * bist_batch_motor.bw;
+                bist_batch_motor.ki = bist_batch_motor.R * bist_batch_motor.bw;
+                bist_batch_gains++;
+                break;
+            case BIST_BATCH_GROUP_OTHER:
+                bist_batch_other++;
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+static void bist_batch_reset( void )
+{
+    memset( &bist_batch_motor, 0, sizeof(bist_batch_motor) );
+
+    bist_batch_motor.R    = 0.1f;
+    bist_batch_motor.L    = 100e-6f;
+    bist_batch_motor.bw   = 1000.0f;
+    bist_batch_motor.kp   = bist_batch_motor.L * bist_batch_motor.bw;
+    bist_batch_motor.ki   = bist_batch_motor.R * bist_batch_motor.bw;
+    bist_batch_motor.pp   = 7;
+    bist_batch_motor.node = 10;
+
+    bist_batch_gains = 0;
+    bist_batch_other = 0;
+}
+
+// The control side only ever sees the old or the new setup, never a mixture
+static bool bist_batch_consistent( void )
+{
+    return (bist_batch_motor.kp == (bist_batch_motor.L * bist_batch_motor.bw))
+        && (bist_batch_motor.ki == (bist_batch_motor.R * bist_batch_motor.bw));
+}
+
+static BIST_BATCH_MOTOR bist_batch_before;
+
+static void bist_batch_untouched( void )
+{
+    assert( memcmp( &bist_batch_motor, &bist_batch_before, sizeof(bist_batch_motor) ) == 0 );
+}
+
+void bist_batch( void )
+{
+    fprintf( stdout, "Starting BATCH BIST\n" );
+
+    BATCH b;
+
+    batch_init( &b, bist_batch_complete );
+    bist_batch_reset();
+    bist_batch_before = bist_batch_motor;
+
+    // Nothing pending, the slow loop has nothing to do
+    assert( batch_apply( &b ) == 0 );
+    assert( batch_state( &b ) == BATCH_STATE_IDLE );
+
+    // A full motor setup in one go
+    assert( batch_parse_text( &b, "par_r=0.05 par_l=80u,curr_bw=2k;par_pp=14 trim=-12 enable=true node_id=0x20 kp", bist_batch_lookup, NULL ) == BATCH_OK );
+    assert( b.count == 8 );
+    assert( batch_state( &b ) == BATCH_STATE_STAGING );
+
+    // Staged and even committed values are not visible until the slow loop runs
+    assert( batch_apply( &b ) == 0 );
+    bist_batch_untouched();
+    assert( batch_commit( &b ) == BATCH_OK );
+    bist_batch_untouched();
+
+    // A second batch cannot start while one is pending
+    assert( batch_begin( &b ) == BATCH_ERR_BUSY );
+    assert( batch_parse_text( &b, "par_r=1", bist_batch_lookup, NULL ) == BATCH_ERR_BUSY );
+
+    assert( batch_apply( &b ) == 8 );
+    assert( batch_state( &b ) == BATCH_STATE_APPLIED );
+    assert( b.applied == 1 );
+
+    assert( bist_batch_motor.R == 0.05f );
+    assert( fabsf( bist_batch_motor.L - 80e-6f ) < 1e-12f );
+    assert( bist_batch_motor.bw == 2000.0f );
+    assert( bist_batch_motor.pp == 14 );
+    assert( bist_batch_motor.trim == -12 );
+    assert( bist_batch_motor.enable == true );
+    assert( bist_batch_motor.node == 0x20 );
+
+    // Derived gains computed once for three related writes, from the final values
+    assert( bist_batch_gains == 1 );
+    assert( bist_batch_other == 1 );
+    assert( bist_batch_consistent() );
+
+    // The read returns the value after the completion
+    assert( b.entry[7].write == false );
+    assert( b.entry[7].value.f == bist_batch_motor.kp );
+
+    // Any bad token rejects the whole batch
+    static struct
+    {
+        char const * text;
+        BATCHError   error;
+        uint32_t     index;
+    }
+    const bad[] =
+    {
+        { "par_r=0.2 par_l=1 nope=3",          BATCH_ERR_UNKNOWN, 2 },
+        { "par_r=0.2 kp=5",                    BATCH_ERR_ACCESS,  1 },
+        { "par_r=11",                          BATCH_ERR_RANGE,   0 },
+        { "curr_bw=100",                       BATCH_ERR_RANGE,   0 },
+        { "par_pp=256",                        BATCH_ERR_RANGE,   0 },
+        { "par_pp=-1",                         BATCH_ERR_RANGE,   0 },
+        { "trim=2000",                         BATCH_ERR_RANGE,   0 },
+        { "node_id=0",                         BATCH_ERR_RANGE,   0 },
+        { "par_r=0.2 par_l=1x",                BATCH_ERR_SYNTAX,  1 },
+        { "par_r=0.2 par_l=",                  BATCH_ERR_SYNTAX,  1 },
+        { "par_r=nan",                         BATCH_ERR_RANGE,   0 },
+        { "trim=1.5",                          BATCH_ERR_SYNTAX,  0 },
+        { "enable=maybe",                      BATCH_ERR_SYNTAX,  0 },
+        { "=5",                                BATCH_ERR_SYNTAX,  0 },
+        { "name=motor",                        BATCH_ERR_TYPE,    0 },
+    };
+
+    bist_batch_before = bist_batch_motor;
+
+    for ( uint32_t i = 0; i < (sizeof(bad) / sizeof(bad[0])); ++i )
+    {
+        assert( batch_parse_text( &b, bad[i].text, bist_batch_lookup, NULL ) == bad[i].error );
+        assert( b.error == bad[i].error );
+        assert( b.error_index == bad[i].index );
+        assert( batch_state( &b ) == BATCH_STATE_IDLE );
+        assert( b.count == 0 );
+        assert( batch_commit( &b ) == BATCH_ERR_BUSY );
+        assert( batch_apply( &b ) == 0 );
+        bist_batch_untouched();
+    }
+
+    // Repeated names keep the last write, a read of a written name does not add an entry
+    assert( batch_parse_text( &b, "par_r=0.3 par_r=0.4 par_r", bist_batch_lookup, NULL ) == BATCH_OK );
+    assert( b.count == 1 );
+    assert( batch_commit( &b ) == BATCH_OK );
+    assert( batch_apply( &b ) == 1 );
+    assert( bist_batch_motor.R == 0.4f );
+    assert( b.entry[0].value.f == 0.4f );
+    assert( bist_batch_gains == 2 );
+    assert( bist_batch_consistent() );
+
+    // Reads only, no completion work
+    assert( batch_parse_text( &b, "par_r par_pp node_id", bist_batch_lookup, NULL ) == BATCH_OK );
+    assert( batch_commit( &b ) == BATCH_OK );
+    assert( batch_apply( &b ) == 3 );
+    assert( bist_batch_gains == 2 );
+    assert( b.entry[1].value.u == 14 );
+
+    // Too many entries
+    {
+        static uint8_t slot[BATCH_MAX_ENTRIES + 1];
+
+        BATCH_VAR   var;
+        BATCH_VALUE v;
+
+        v.u = 0;
+
+        assert( bist_batch_lookup( NULL, "par_pp", 6, &var ) == BATCH_OK );
+        assert( batch_begin( &b ) == BATCH_OK );
+
+        for ( uint32_t i = 0; i < BATCH_MAX_ENTRIES; ++i )
+        {
+            var.ptr = &slot[i];
+            assert( batch_stage( &b, &var, true, v ) == BATCH_OK );
+        }
+
+        // Replacing an entry is still fine when full, a new one is not
+        var.ptr = &slot[0];
+        assert( batch_stage( &b, &var, true, v ) == BATCH_OK );
+        var.ptr = &slot[BATCH_MAX_ENTRIES];
+        assert( batch_stage( &b, &var, true, v ) == BATCH_ERR_FULL );
+
+        batch_abort( &b );
+        assert( batch_state( &b ) == BATCH_STATE_IDLE );
+        assert( slot[0] == 0 );
+    }
+
+    // Binary frame, writes then reads, and the reply
+    {
+        uint8_t frame[64];
+        uint32_t n = 0;
+        float const r = 0.07f;
+        uint32_t ru;
+
+        memcpy( &ru, &r, 4 );
+
+        frame[n++] = 5;
+        memcpy( &frame[n], "par_r", 5 ); n += 5;
+        frame[n++] = (uint8_t)ru; frame[n++] = (uint8_t)(ru >> 8); frame[n++] = (uint8_t)(ru >> 16); frame[n++] = (uint8_t)(ru >> 24);
+
+        frame[n++] = 4;
+        memcpy( &frame[n], "trim", 4 ); n += 4;
+        frame[n++] = 0x9C; frame[n++] = 0xFF; frame[n++] = 0xFF; frame[n++] = 0xFF; // -100
+
+        frame[n++] = BATCH_FRAME_READ | 2;
+        memcpy( &frame[n], "ki", 2 ); n += 2;
+
+        assert( batch_parse_frame( &b, frame, n, bist_batch_lookup, NULL ) == BATCH_OK );
+        assert( b.count == 3 );
+        assert( batch_commit( &b ) == BATCH_OK );
+        assert( batch_apply( &b ) == 3 );
+        assert( bist_batch_motor.R == r );
+        assert( bist_batch_motor.trim == -100 );
+        assert( bist_batch_consistent() );
+
+        uint8_t reply[64];
+
+        assert( batch_reply( &b, reply, 8 ) == 0 );
+        assert( batch_reply( &b, reply, sizeof(reply) ) == 15 );
+        assert( reply[0] == BATCH_OK );
+        assert( reply[2] == 3 );
+
+        float ki;
+
+        memcpy( &ki, &reply[3 + 8], 4 );
+        assert( ki == bist_batch_motor.ki );
+
+        // Truncated record
+        bist_batch_before = bist_batch_motor;
+        assert( batch_parse_frame( &b, frame, n - 1, bist_batch_lookup, NULL ) == BATCH_ERR_SYNTAX );
+        assert( b.error_index == 2 );
+        assert( batch_parse_frame( &b, frame, 7, bist_batch_lookup, NULL ) == BATCH_ERR_SYNTAX );
+        assert( b.error_index == 0 );
+        bist_batch_untouched();
+
+        // Range is checked on frames too
+        frame[1 + 5 + 3] = 0x7F; // +inf territory for par_r
+        assert( batch_parse_frame( &b, frame, n, bist_batch_lookup, NULL ) == BATCH_ERR_RANGE );
+    }
+
+    // A slow loop running between every token never sees a partial update
+    {
+        static char const * const token[] = { "par_r=0.2", "par_l=150u", "curr_bw=3000", "par_pp=21" };
+
+        bist_batch_before = bist_batch_motor;
+
+        assert( batch_begin( &b ) == BATCH_OK );
+
+        for ( uint32_t i = 0; i < 4; ++i )
+        {
+            assert( batch_parse_token( &b, token[i], (uint32_t)strlen( token[i] ), bist_batch_lookup, NULL ) == BATCH_OK );
+            assert( batch_apply( &b ) == 0 );
+            bist_batch_untouched();
+        }
+
+        uint32_t const gains = bist_batch_gains;
+
+        assert( batch_commit( &b ) == BATCH_OK );
+        assert( batch_apply( &b ) == 4 );
+        assert( batch_apply( &b ) == 0 );
+        assert( bist_batch_gains == (gains + 1) );
+        assert( bist_batch_motor.R == 0.2f );
+        assert( bist_batch_motor.pp == 21 );
+        assert( bist_batch_consistent() );
+    }
+
+    fprintf( stdout, "Finished BATCH BIST\n" );
+}
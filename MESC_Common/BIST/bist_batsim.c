@@ -0,0 +1,296 @@
+/*
+* Copyright 2021-2023 cod3b453
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its contributors
+*    may be used to endorse or promote products derived from this software
+*    without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "MESCbat.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define BIST_BATSIM_T       0.01f   // s, slow loop period
+#define BIST_BATSIM_TMAX    10800.0f
+#define BIST_BATSIM_PI      3.14159265f
+
+/*
+Simulated pack: the profile curve with a ripple the engine does not know
+about, a larger ohmic resistance than the profile ESR, an RC polarisation
+branch and an offset and noise on the current sensor.
+*/
+struct BIST_BATSIM
+{
+    BAT      curve;     // Profile curve only
+    float    C;         // Ah held
+    float    R0;        // Ohm
+    float    R1;        // Ohm
+    float    tau;       // s
+    float    V1;        // V across the RC branch
+    float    ripple;    // V
+    float    I_offset;  // A on the measured current
+    uint32_t seed;
+};
+
+typedef struct BIST_BATSIM BIST_BATSIM;
+
+static float bist_batsim_rand( BIST_BATSIM * const sim )
+{
+    sim->seed = (sim->seed * UINT32_C(1664525)) + UINT32_C(1013904223);
+
+    return ((float)(sim->seed >> 8) / 16777216.0f);
+}
+
+static float bist_batsim_noise( BIST_BATSIM * const sim )
+{
+    return (bist_batsim_rand( sim ) + bist_batsim_rand( sim ) + bist_batsim_rand( sim ) - 1.5f);
+}
+
+// Inverse of the level functions at the profile curve
+static float bist_batsim_ocv( BIST_BATSIM const * const sim )
+{
+    BAT const * const c = &sim->curve;
+    float x = sim->C;
+    uint32_t i = 1;
+
+    while ((i < (BAT_OCV_POINTS - 1)) && (x > c->ocv_C[i]))
+    {
+        ++i;
+    }
+
+    float const V = c->ocv_V[i - 1] + ((x - c->ocv_C[i - 1]) * (c->ocv_V[i] - c->ocv_V[i - 1]) / (c->ocv_C[i] - c->ocv_C[i - 1]));
+
+    return V + (sim->ripple * sinf( 6.0f * BIST_BATSIM_PI * (x / c->Cmax) ));
+}
+
+static float bist_batsim_terminal( BIST_BATSIM const * const sim, float const I )
+{
+    return (bist_batsim_ocv( sim ) - sim->V1 - (I * sim->R0));
+}
+
+static void bist_batsim_step( BIST_BATSIM * const sim, float const I, float const T )
+{
+    sim->C  = sim->C - ((I * T) / 3600.0f);
+    sim->V1 = sim->V1 + ((T / sim->tau) * ((I * sim->R1) - sim->V1));
+}
+
+struct BIST_BATSIM_RESULT
+{
+    float Vlow;        // V, least terminal voltage
+    float Vhigh;       // V, greatest terminal voltage
+    float t_under;     // s below the cell Vmin
+    float t_over;      // s above the cell Vmax
+    float energy;      // Wh delivered
+    float C_err;       // Ah, largest charge error after the first 10 minutes
+    float R_err;       // Fraction, final resistance error
+    float headroom;    // V, mean margin over Vmin while held by the voltage limit
+};
+
+typedef struct BIST_BATSIM_RESULT BIST_BATSIM_RESULT;
+
+/*
+Drive the pack from 90% with a random demand of 5 to 40 s steps between full
+regen and 1.5x the current limit, with rests, until it is nearly empty. With
+dynamic set the engine limits are applied, otherwise only Imax.
+*/
+static BIST_BATSIM_RESULT bist_batsim_run( BATProfile const * const bp, bool const dynamic, float const C_start_err )
+{
+    BIST_BATSIM sim;
+    BAT bat;
+
+    bat_reset( &sim.curve, bp );
+    bat_reset( &bat, bp );
+
+    sim.C        = 0.9f * sim.curve.Cmax;
+    sim.R0       = 1.3f * bp->battery.ESR;
+    sim.R1       = 0.4f * bp->battery.ESR;
+    sim.tau      = 30.0f;
+    sim.V1       = 0.0f;
+    sim.ripple   = 0.01f * (float)bp->battery.series;
+    sim.I_offset = 0.2f;
+    sim.seed     = 1;
+
+    float const Vmin = bp->cell.Vmin * (float)bp->battery.series;
+    float const Vmax = bp->cell.Vmax * (float)bp->battery.series;
+
+    BIST_BATSIM_RESULT res = { .Vlow = Vmax, .Vhigh = 0.0f };
+
+    float demand  = 0.0f;
+    float t_next  = 0.0f;
+    float I       = 0.0f;
+    float head    = 0.0f;
+    uint32_t held = 0;
+
+    for ( float t = 0.0f; (t < BIST_BATSIM_TMAX) && (sim.C > (0.05f * sim.curve.Cmax)); t = t + BIST_BATSIM_T )
+    {
+        if (t >= t_next)
+        {
+            t_next = t + 5.0f + (35.0f * bist_batsim_rand( &sim ));
+            float const r = bist_batsim_rand( &sim );
+            demand = (r < 0.3f) ? 0.0f : (((2.0f * bist_batsim_rand( &sim )) - 0.5f) * bat.Imax);
+        }
+
+        float const V  = bist_batsim_terminal( &sim, I );
+        float const Vm = V + (0.002f * (float)bp->battery.series * bist_batsim_noise( &sim ));
+        float const Im = I + sim.I_offset + (0.2f * bist_batsim_noise( &sim ));
+
+        bat_update( &bat, Vm, Im, BIST_BATSIM_T );
+
+        if ((C_start_err != 0.0f) && (t == 0.0f))
+        {
+            bat.C    = bat.C + (C_start_err * bat.Cmax);
+            bat.C_sd = 0.5f * bat.Cmax;
+        }
+
+        res.Vlow  = fminf( res.Vlow,  V );
+        res.Vhigh = fmaxf( res.Vhigh, V );
+
+        if (V < Vmin)
+        {
+            res.t_under = res.t_under + BIST_BATSIM_T;
+        }
+
+        if (V > Vmax)
+        {
+            res.t_over = res.t_over + BIST_BATSIM_T;
+        }
+
+        if (t > 600.0f)
+        {
+            res.C_err = fmaxf( res.C_err, fabsf( bat.C - sim.C ) );
+        }
+
+        res.energy = res.energy + ((V * I * BIST_BATSIM_T) / 3600.0f);
+
+        // Next current request, limited
+        float Idis = bat.Imax;
+        float Ichg = bat.Imax;
+
+        if (dynamic)
+        {
+            Idis = bat.Idis;
+            Ichg = bat.Ichg;
+        }
+
+        if ((demand > Idis) && (Idis < bat.Imax))
+        {
+            head = head + (V - Vmin);
+            ++held;
+        }
+
+        I = fmaxf( fminf( demand, Idis ), -Ichg );
+
+        bist_batsim_step( &sim, I, BIST_BATSIM_T );
+    }
+
+    res.R_err    = (bat.R - sim.R0) / sim.R0;
+    res.headroom = (held > 0) ? (head / (float)held) : 0.0f;
+
+    return res;
+}
+
+static void bist_batsim_print( char const * const name, BIST_BATSIM_RESULT const * const res )
+{
+    fprintf( stdout, "    %-8s V %5.2f..%5.2f under %6.1f s over %6.1f s %6.1f Wh  charge error %5.3f Ah  R error %+5.1f %%  headroom %4.2f V\n",
+        name, res->Vlow, res->Vhigh, res->t_under, res->t_over, res->energy, res->C_err, (100.0f * res->R_err), res->headroom );
+}
+
+void bist_batsim( void )
+{
+    fprintf( stdout, "Starting Battery simulation BIST\n" );
+
+    BATProfile bp;
+
+    bp.cell.Imax = 30.0f;
+    bp.cell.Vmax =  4.2f;
+    bp.cell.Cmax =  4.2f;
+    bp.cell.Vmid =  3.4f;
+    bp.cell.Cmid =  0.7f;
+    bp.cell.Vlow =  3.2f;
+    bp.cell.Clow =  0.5f;
+    bp.cell.Vmin =  2.8f;
+
+    bp.battery.Imax     =   50.0f;
+    bp.battery.Pmax     = 5000.0f;
+    bp.battery.parallel =    2;
+    bp.battery.series   =   20;
+    bp.battery.ESR      = ((0.030f * (float)bp.battery.series) / (float)bp.battery.parallel);
+
+    bp.display = BAT_DISPLAY_PERCENT;
+
+    float const Cmax = bp.cell.Cmax * (float)bp.battery.parallel;
+
+    BIST_BATSIM_RESULT const fixed = bist_batsim_run( &bp, false, 0.0f );
+    BIST_BATSIM_RESULT const dyn   = bist_batsim_run( &bp, true,  0.0f );
+    BIST_BATSIM_RESULT const wrong = bist_batsim_run( &bp, true,  -0.4f );
+
+    bist_batsim_print( "Imax",    &fixed );
+    bist_batsim_print( "dynamic", &dyn   );
+    bist_batsim_print( "-40%",    &wrong );
+
+    // Fixed limits sag through Vmin
+    assert( fixed.t_under > 0.0f );
+
+    // Dynamic limits keep the terminals inside the cell range
+    assert( dyn.t_under == 0.0f );
+    assert( dyn.t_over  == 0.0f );
+    assert( wrong.t_under == 0.0f );
+    assert( wrong.t_over  == 0.0f );
+
+    // Without giving much away
+    assert( dyn.headroom < (0.1f * (float)bp.battery.series) );
+
+    // Charge within 5% after 10 minutes, also from a bad start
+    assert( dyn.C_err   < (0.05f * Cmax) );
+    assert( wrong.C_err < (0.05f * Cmax) );
+
+    // Ohmic resistance found despite the 30% profile error and the RC branch
+    assert( fabsf( dyn.R_err ) < 0.15f );
+
+    // Limits at the extremes of a pack at rest
+    BAT bat;
+
+    bat_reset( &bat, &bp );
+    bat_update( &bat, bp.cell.Vmax * (float)bp.battery.series, 0.0f, BIST_BATSIM_T );
+    assert( bat.Ichg == 0.0f );
+    assert( fabsf( bat_get_soc( &bat ) - 1.0f ) < 0.01f );
+
+    bat_reset( &bat, &bp );
+    bat_update( &bat, bp.cell.Vmin * (float)bp.battery.series, 0.0f, BIST_BATSIM_T );
+    assert( bat.Idis == 0.0f );
+    assert( bat.Ichg == bat.Imax );
+    assert( bat_get_soc( &bat ) < 0.01f );
+
+    // Power limit: (E - I*R)*I <= Pmax
+    bp.battery.Pmax = 250.0f;
+    bat_reset( &bat, &bp );
+    bat_update( &bat, bp.cell.Vmid * (float)bp.battery.series, 0.0f, BIST_BATSIM_T );
+    assert( fabsf( ((bat.E - (bat.Idis * bat.R)) * bat.Idis) - bp.battery.Pmax ) < 1.0f );
+
+    fprintf( stdout, "Finished Battery simulation BIST\n" );
+}
@@ -0,0 +1,486 @@
+/*
+* Copyright 2021-2023 cod3b453
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its contributors
+*    may be used to endorse or promote products derived from this software
+*    without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "MESCcansess.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+/*
+Loopback bus at 1Mbit/s; an extended frame with 8 data bytes is about 130
+bits so roughly 7 frames fit in each 1ms tick. Each node has the 3 transmit
+mailboxes of the bxCAN.
+*/
+#define BIST_CANSESS_BUS_FRAMES  7
+#define BIST_CANSESS_MAILBOXES   3
+#define BIST_CANSESS_NODES       4
+#define BIST_CANSESS_BUS_MAX     64
+
+struct BISTCANFrame
+{
+    uint8_t      from;
+    uint8_t      to;
+    CANSESSFrame type;
+    uint8_t      len;
+    uint8_t      data[8];
+};
+
+typedef struct BISTCANFrame BISTCANFrame;
+
+struct BISTCANNode
+{
+    uint8_t     id;
+    CANSESS_MUX mux;
+    uint32_t    queued;  // Frames in mailboxes this tick
+    bool        alive;
+};
+
+typedef struct BISTCANNode BISTCANNode;
+
+static BISTCANNode  bist_cansess_node[BIST_CANSESS_NODES];
+static BISTCANFrame bist_cansess_bus[BIST_CANSESS_BUS_MAX];
+static uint32_t     bist_cansess_bus_len;
+static uint32_t     bist_cansess_loss;   // Drop one frame in this many, 0 = none
+static uint32_t     bist_cansess_seed;
+static uint32_t     bist_cansess_frames;
+
+static bool bist_cansess_send( void * ctx, CANSESSFrame const frame, uint8_t const remote, uint8_t const * const data, uint8_t const len )
+{
+    BISTCANNode * const node = (BISTCANNode *)ctx;
+
+    if ((node->queued >= BIST_CANSESS_MAILBOXES) || (bist_cansess_bus_len >= BIST_CANSESS_BUS_FRAMES))
+    {
+        return false;
+    }
+
+    BISTCANFrame * const f = &bist_cansess_bus[bist_cansess_bus_len];
+
+    f->from = node->id;
+    f->to   = remote;
+    f->type = frame;
+    f->len  = len;
+    memcpy( f->data, data, len );
+
+    ++bist_cansess_bus_len;
+    ++node->queued;
+    ++bist_cansess_frames;
+
+    return true;
+}
+
+static void bist_cansess_setup( uint32_t const loss )
+{
+    for ( uint32_t i = 0; i < BIST_CANSESS_NODES; ++i )
+    {
+        bist_cansess_node[i].id     = (uint8_t)(i + 1);
+        bist_cansess_node[i].alive  = true;
+        bist_cansess_node[i].queued = 0;
+        cansess_init( &bist_cansess_node[i].mux, bist_cansess_send, &bist_cansess_node[i] );
+    }
+
+    bist_cansess_bus_len = 0;
+    bist_cansess_loss    = loss;
+    bist_cansess_seed    = 1;
+    bist_cansess_frames  = 0;
+}
+
+static void bist_cansess_tick( uint32_t const tick )
+{
+    // Nodes poll in turn, which one goes first changes every tick
+    for ( uint32_t i = 0; i < BIST_CANSESS_NODES; ++i )
+    {
+        BISTCANNode * const node = &bist_cansess_node[(tick + i) % BIST_CANSESS_NODES];
+
+        if (node->alive)
+        {
+            cansess_poll( &node->mux, tick );
+        }
+    }
+
+    for ( uint32_t i = 0; i < bist_cansess_bus_len; ++i )
+    {
+        BISTCANFrame const * const f = &bist_cansess_bus[i];
+
+        if (bist_cansess_loss > 0)
+        {
+            bist_cansess_seed = (bist_cansess_seed * 1664525u) + 1013904223u;
+
+            if (((bist_cansess_seed >> 16) % bist_cansess_loss) == 0)
+            {
+                continue;
+            }
+        }
+
+        BISTCANNode * const dst = &bist_cansess_node[f->to - 1];
+
+        if (dst->alive)
+        {
+            cansess_receive( &dst->mux, f->type, f->from, f->data, f->len, tick );
+        }
+    }
+
+    bist_cansess_bus_len = 0;
+
+    for ( uint32_t i = 0; i < BIST_CANSESS_NODES; ++i )
+    {
+        bist_cansess_node[i].queued = 0;
+    }
+}
+
+static uint8_t bist_cansess_pattern( uint32_t const i, uint32_t const stream )
+{
+    return (uint8_t)((i * 7u) + (i >> 8) + (stream * 31u));
+}
+
+struct BISTCANStream
+{
+    CANSESS * tx;
+    CANSESS * rx;
+    uint32_t  stream;
+    uint32_t  written;
+    uint32_t  read;
+    uint32_t  errors;
+};
+
+typedef struct BISTCANStream BISTCANStream;
+
+static void bist_cansess_pump( BISTCANStream * const st, uint32_t const total )
+{
+    uint8_t buf[64];
+
+    while (st->written < total)
+    {
+        uint32_t n = total - st->written;
+
+        if (n > sizeof(buf))
+        {
+            n = sizeof(buf);
+        }
+
+        for ( uint32_t i = 0; i < n; ++i )
+        {
+            buf[i] = bist_cansess_pattern( st->written + i, st->stream );
+        }
+
+        n = cansess_write( st->tx, buf, n );
+
+        if (n == 0)
+        {
+            break;
+        }
+
+        st->written = st->written + n;
+    }
+
+    uint32_t n;
+
+    while ((n = cansess_read( st->rx, buf, sizeof(buf) )) > 0)
+    {
+        for ( uint32_t i = 0; i < n; ++i )
+        {
+            if (buf[i] != bist_cansess_pattern( st->read + i, st->stream ))
+            {
+                ++st->errors;
+            }
+        }
+
+        st->read = st->read + n;
+    }
+}
+
+/*
+Run streams of total bytes each until all are delivered, returns the ticks taken
+*/
+static uint32_t bist_cansess_transfer( BISTCANStream * const st, uint32_t const count, uint32_t const total )
+{
+    uint32_t tick = 0;
+    bool     done = false;
+
+    while (!done && (tick < 100000))
+    {
+        done = true;
+
+        for ( uint32_t i = 0; i < count; ++i )
+        {
+            bist_cansess_pump( &st[i], total );
+
+            if (st[i].read < total)
+            {
+                done = false;
+            }
+        }
+
+        bist_cansess_tick( tick );
+        ++tick;
+    }
+
+    return tick;
+}
+
+/*
+Terminal stream as it was; TASK_CAN_tx moves up to 8 bytes from tx_stream per
+1ms loop with no acknowledgement, frames lost on the bus are lost for good.
+*/
+static uint32_t bist_cansess_legacy( uint32_t const total, uint32_t const loss, uint32_t * const lost )
+{
+    uint32_t tick = 0;
+    uint32_t sent = 0;
+
+    bist_cansess_seed = 1;
+    *lost = 0;
+
+    while (sent < total)
+    {
+        uint32_t n = total - sent;
+
+        if (n > 8)
+        {
+            n = 8;
+        }
+
+        if (loss > 0)
+        {
+            bist_cansess_seed = (bist_cansess_seed * 1664525u) + 1013904223u;
+
+            if (((bist_cansess_seed >> 16) % loss) == 0)
+            {
+                *lost = *lost + n;
+            }
+        }
+
+        sent = sent + n;
+        ++tick;
+    }
+
+    return tick;
+}
+
+#define BIST_CANSESS_BYTES 16384
+
+void bist_cansess( void )
+{
+    fprintf( stdout, "Starting CANSESS BIST\n" );
+
+    uint32_t lost;
+    uint32_t const legacy_ticks = bist_cansess_legacy( BIST_CANSESS_BYTES, 0, &lost );
+    float const    legacy_rate  = (float)BIST_CANSESS_BYTES / (float)legacy_ticks;
+
+    fprintf( stdout, "    legacy          %6.2f kB/s\n", (double)legacy_rate );
+
+    // Single session, clean bus
+    {
+        bist_cansess_setup( 0 );
+
+        BISTCANStream st = { NULL, NULL, 0, 0, 0, 0 };
+
+        st.tx = cansess_open( &bist_cansess_node[0].mux, 2 );
+        st.rx = cansess_accept( &bist_cansess_node[1].mux, 1 );
+
+        uint32_t const ticks = bist_cansess_transfer( &st, 1, BIST_CANSESS_BYTES );
+        float const    rate  = (float)BIST_CANSESS_BYTES / (float)ticks;
+
+        fprintf( stdout, "    one session     %6.2f kB/s, %u frames\n", (double)rate, (unsigned)bist_cansess_frames );
+
+        assert( st.errors == 0 );
+        assert( st.tx->resent == 0 );
+        assert( rate > (2.0f * legacy_rate) );
+    }
+
+    // Three terminals from node 1 to nodes 2..4 with answers coming back
+    {
+        bist_cansess_setup( 0 );
+
+        BISTCANStream st[6];
+
+        memset( st, 0, sizeof(st) );
+
+        for ( uint32_t i = 0; i < 3; ++i )
+        {
+            uint8_t const remote = (uint8_t)(2 + i);
+
+            CANSESS * const local = cansess_open( &bist_cansess_node[0].mux, remote );
+            CANSESS * const far   = cansess_accept( &bist_cansess_node[remote - 1].mux, 1 );
+
+            st[2 * i].tx         = local;
+            st[2 * i].rx         = far;
+            st[2 * i].stream     = 2 * i;
+            st[(2 * i) + 1].tx     = far;
+            st[(2 * i) + 1].rx     = local;
+            st[(2 * i) + 1].stream = (2 * i) + 1;
+        }
+
+        uint32_t const ticks = bist_cansess_transfer( st, 6, BIST_CANSESS_BYTES / 4 );
+        float const    rate  = (6.0f * (float)(BIST_CANSESS_BYTES / 4)) / (float)ticks;
+
+        fprintf( stdout, "    six streams     %6.2f kB/s total\n", (double)rate );
+
+        for ( uint32_t i = 0; i < 6; ++i )
+        {
+            assert( st[i].errors == 0 );
+            assert( st[i].read == (BIST_CANSESS_BYTES / 4) );
+        }
+
+        assert( rate > (2.0f * legacy_rate) );
+    }
+
+    // Lossy bus, one frame in 50 dropped
+    {
+        bist_cansess_setup( 50 );
+
+        BISTCANStream st = { NULL, NULL, 0, 0, 0, 0 };
+
+        st.tx = cansess_open( &bist_cansess_node[0].mux, 2 );
+        st.rx = cansess_accept( &bist_cansess_node[1].mux, 1 );
+
+        uint32_t const ticks = bist_cansess_transfer( &st, 1, BIST_CANSESS_BYTES );
+
+        bist_cansess_legacy( BIST_CANSESS_BYTES, 50, &lost );
+
+        fprintf( stdout, "    2%% loss         %6.2f kB/s, %u resent (legacy loses %u bytes)\n",
+            (double)((float)BIST_CANSESS_BYTES / (float)ticks), (unsigned)st.tx->resent, (unsigned)lost );
+
+        assert( st.errors == 0 );
+        assert( st.read == BIST_CANSESS_BYTES );
+        assert( st.tx->resent > 0 );
+        assert( lost > 0 );
+    }
+
+    // Receiver not reading; the sender stalls on a full window and nothing is lost
+    {
+        bist_cansess_setup( 0 );
+
+        CANSESS * const tx = cansess_open( &bist_cansess_node[0].mux, 2 );
+        CANSESS * const rx = cansess_accept( &bist_cansess_node[1].mux, 1 );
+        uint8_t         buf[2 * CANSESS_BUF_SIZE];
+        uint32_t        written = 0;
+
+        for ( uint32_t i = 0; i < sizeof(buf); ++i )
+        {
+            buf[i] = bist_cansess_pattern( i, 9 );
+        }
+
+        for ( uint32_t tick = 0; tick < 200; ++tick )
+        {
+            written = written + cansess_write( tx, &buf[written], sizeof(buf) - written );
+            bist_cansess_tick( tick );
+        }
+
+        assert( written > CANSESS_BUF_SIZE );
+        assert( cansess_rx_avail( rx ) > (CANSESS_BUF_SIZE - CANSESS_PAYLOAD) );
+        assert( cansess_tx_free( tx ) < CANSESS_BUF_SIZE );
+        assert( tx->peer_free == 0 );
+
+        uint32_t got = 0;
+
+        for ( uint32_t tick = 200; (tick < 400) && (got < sizeof(buf)); ++tick )
+        {
+            uint8_t        in[16];
+            uint32_t const n = cansess_read( rx, in, sizeof(in) );
+
+            written = written + cansess_write( tx, &buf[written], sizeof(buf) - written );
+
+            for ( uint32_t i = 0; i < n; ++i )
+            {
+                assert( in[i] == buf[got + i] );
+            }
+
+            got = got + n;
+            bist_cansess_tick( tick );
+        }
+
+        assert( got == sizeof(buf) );
+    }
+
+    // The far end takes its session from the first frame and drops it once the near end has gone
+    {
+        bist_cansess_setup( 0 );
+
+        CANSESS * const tx = cansess_open( &bist_cansess_node[0].mux, 2 );
+        uint8_t const   hello[] = "hello";
+        uint8_t         in[sizeof(hello)];
+        uint32_t        tick = 0;
+
+        assert( cansess_find( &bist_cansess_node[1].mux, 1 ) == NULL );
+
+        cansess_write( tx, hello, sizeof(hello) );
+
+        for ( ; tick < 10; ++tick )
+        {
+            bist_cansess_tick( tick );
+        }
+
+        CANSESS * const rx = cansess_find( &bist_cansess_node[1].mux, 1 );
+
+        assert( (rx != NULL) && !rx->local );
+        assert( cansess_read( rx, in, sizeof(in) ) == sizeof(hello) );
+        assert( memcmp( in, hello, sizeof(hello) ) == 0 );
+        assert( tx->tx_acked == sizeof(hello) );
+
+        bist_cansess_node[0].alive = false;
+        cansess_write( rx, hello, sizeof(hello) );
+
+        for ( ; tick < (10 + ((CANSESS_TIMEOUT + 2) * CANSESS_RETRIES)); ++tick )
+        {
+            bist_cansess_tick( tick );
+        }
+
+        assert( cansess_find( &bist_cansess_node[1].mux, 1 ) == NULL );
+    }
+
+    // Remote disappears
+    {
+        bist_cansess_setup( 0 );
+
+        CANSESS * const tx = cansess_open( &bist_cansess_node[0].mux, 2 );
+
+        cansess_accept( &bist_cansess_node[1].mux, 1 );
+        bist_cansess_node[1].alive = false;
+
+        uint8_t const hello[] = "hello";
+
+        cansess_write( tx, hello, sizeof(hello) );
+
+        for ( uint32_t tick = 0; tick < ((CANSESS_TIMEOUT + 2) * CANSESS_RETRIES); ++tick )
+        {
+            bist_cansess_tick( tick );
+        }
+
+        assert( tx->failed );
+        assert( tx->tx_acked == 0 );
+
+        // Frames for a session that is not open are counted and ignored
+        cansess_close( &bist_cansess_node[0].mux, 2 );
+        cansess_receive( &bist_cansess_node[0].mux, CANSESS_FRAME_DATA, 2, hello, 3, 0 );
+        assert( bist_cansess_node[0].mux.unknown == 1 );
+    }
+
+    fprintf( stdout, "Finished CANSESS BIST\n" );
+}
@@ -0,0 +1,215 @@
+/*
+* Copyright 2021-2023 cod3b453
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its contributors
+*    may be used to endorse or promote products derived from this software
+*    without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "MESCdpwm.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+Host switching model
+
+One erev is split into PWM periods. A phase whose duty is at either rail does
+not switch in that period, otherwise it makes two transitions. Switching energy
+per transition is taken as proportional to Vbus * |I|, so the relative loss of
+a strategy is the sum of |I| over the transitions it makes, normalised to
+continuous SVPWM at the same operating point.
+*/
+#define BIST_DPWM_PERIODS 240
+
+static float const one_on_sqrt3 = 0.57735027f;
+static float const two_pi       = 6.28318531f;
+static float const deg          = 0.01745329f;
+
+struct BISTDPWMResult
+{
+    uint32_t events;
+    float    loss;
+};
+
+typedef struct BISTDPWMResult BISTDPWMResult;
+
+static BISTDPWMResult bist_dpwm_run( DPWM * const dp, DPWMType const type, float const m, float const phi )
+{
+    BISTDPWMResult res = { 0, 0.0f };
+    float const Vbus = 1.0f;
+    float const mag  = m * one_on_sqrt3 * Vbus;
+
+    dp->type = (uint8_t)type;
+    // Operating point at q axis voltage, current lagging by phi
+    dpwm_update( dp, m, 0.0f, mag, sinf( phi ), cosf( phi ) );
+
+    for ( uint32_t n = 0; n < BIST_DPWM_PERIODS; ++n )
+    {
+        float const theta = (two_pi * (float)n) / (float)BIST_DPWM_PERIODS;
+        float const Va    = mag * cosf( theta );
+        float const Vb    = mag * sinf( theta );
+        float V[3] =
+        {
+            mag * cosf( theta ),
+            mag * cosf( theta - (two_pi / 3.0f) ),
+            mag * cosf( theta + (two_pi / 3.0f) ),
+        };
+        float const I[3] =
+        {
+            cosf( theta - phi ),
+            cosf( theta - phi - (two_pi / 3.0f) ),
+            cosf( theta - phi + (two_pi / 3.0f) ),
+        };
+        float const Vuv = V[0] - V[1];
+        float const Vvw = V[1] - V[2];
+        uint32_t high;
+
+        if (!dpwm_apply( dp, Vbus, Va, Vb, V, &high ))
+        {
+            // Continuous midpoint clamp, as MESCpwm_Write
+            float const top    = fmaxf( V[0], fmaxf( V[1], V[2] ) );
+            float const bottom = fminf( V[0], fminf( V[1], V[2] ) );
+            float const mid    = 0.5f * (top + bottom);
+
+            V[0] = V[0] - mid;
+            V[1] = V[1] - mid;
+            V[2] = V[2] - mid;
+
+            high = DPWM_PHASE_NONE;
+        }
+
+        // Zero sequence must not disturb the line voltages
+        assert( fabsf( (V[0] - V[1]) - Vuv ) < 1.0e-4f );
+        assert( fabsf( (V[1] - V[2]) - Vvw ) < 1.0e-4f );
+
+        for ( uint32_t i = 0; i < 3; ++i )
+        {
+            float const duty = (V[i] / Vbus) + 0.5f;
+
+            assert( duty >= -1.0e-5f );
+            assert( duty <= (1.0f + 1.0e-5f) );
+
+            if ((duty > 1.0e-4f) && (duty < (1.0f - 1.0e-4f)))
+            {
+                res.events = res.events + 2;
+                res.loss   = res.loss + (2.0f * fabsf( I[i] ));
+
+                assert( i != high );
+            }
+        }
+    }
+
+    return res;
+}
+
+struct BISTDPWMCase
+{
+    DPWMType     type;
+    char const * name;
+};
+
+typedef struct BISTDPWMCase BISTDPWMCase;
+
+static BISTDPWMCase const bist_dpwm_case[] =
+{
+    { DPWM_TYPE_CONTINUOUS, "SVPWM"  },
+    { DPWM_TYPE_DPWM0     , "DPWM0"  },
+    { DPWM_TYPE_DPWM1     , "DPWM1"  },
+    { DPWM_TYPE_DPWM2     , "DPWM2"  },
+    { DPWM_TYPE_MAX       , "DPWMMAX"},
+    { DPWM_TYPE_MIN       , "DPWMMIN"},
+    { DPWM_TYPE_GDPWM     , "GDPWM"  },
+};
+
+#define BIST_DPWM_CASES (sizeof(bist_dpwm_case) / sizeof(bist_dpwm_case[0]))
+
+void bist_dpwm( void )
+{
+    fprintf( stdout, "Starting DPWM BIST\n" );
+
+    DPWM dp;
+
+    dpwm_init( &dp );
+
+    // Power factor angle is recovered from dq
+    dpwm_update( &dp, 1.0f, 0.0f, 1.0f, sinf( 20.0f * deg ), cosf( 20.0f * deg ) );
+    assert( fabsf( dp.phi - (20.0f * deg) ) < 1.0e-4f );
+    assert( dp.active == DPWM_TYPE_GDPWM );
+    assert( fabsf( dp.psi - (20.0f * deg) ) < 1.0e-4f );
+
+    // Regenerating folds back onto the same window
+    dpwm_update( &dp, 1.0f, 0.0f, 1.0f, -sinf( 20.0f * deg ), -cosf( 20.0f * deg ) );
+    assert( fabsf( dp.psi - (20.0f * deg) ) < 1.0e-4f );
+
+    // AUTO falls back to continuous at low modulation
+    dpwm_update( &dp, 0.5f * DPWM_M_MIN_DEFAULT, 0.0f, 1.0f, 0.0f, 1.0f );
+    assert( dp.active == DPWM_TYPE_CONTINUOUS );
+
+    float const m_list[]   = { 0.6f, 0.9f, 1.0f };
+    float const phi_list[] = { -30.0f, 0.0f, 30.0f, 60.0f };
+
+    for ( uint32_t im = 0; im < (sizeof(m_list) / sizeof(m_list[0])); ++im )
+    {
+        for ( uint32_t ip = 0; ip < (sizeof(phi_list) / sizeof(phi_list[0])); ++ip )
+        {
+            float const m   = m_list[im];
+            float const phi = phi_list[ip] * deg;
+
+            BISTDPWMResult res[BIST_DPWM_CASES];
+
+            fprintf( stdout, "    m %4.2f pf angle %5.1f\n", (double)m, (double)phi_list[ip] );
+
+            for ( uint32_t c = 0; c < BIST_DPWM_CASES; ++c )
+            {
+                res[c] = bist_dpwm_run( &dp, bist_dpwm_case[c].type, m, phi );
+
+                fprintf( stdout, "        %-8s events %4" PRIu32 " loss %5.3f\n",
+                    bist_dpwm_case[c].name, res[c].events, (double)(res[c].loss / res[0].loss) );
+            }
+
+            // Every discontinuous strategy removes a third of the transitions
+            for ( uint32_t c = 1; c < BIST_DPWM_CASES; ++c )
+            {
+                assert( res[c].events <= (((2 * res[0].events) / 3) + 6) );
+            }
+
+            // Clamping on the current peak is never worse than a fixed window
+            assert( res[6].loss <= (res[1].loss + 0.01f) );
+            assert( res[6].loss <= (res[2].loss + 0.01f) );
+            assert( res[6].loss <= (res[3].loss + 0.01f) );
+
+            // The 60 degree window spans |phi| <= 30 degrees; about half the loss
+            if (fabsf( phi_list[ip] ) <= 30.0f)
+            {
+                assert( res[6].loss < (0.55f * res[0].loss) );
+            }
+        }
+    }
+
+    fprintf( stdout, "Finished DPWM BIST\n" );
+}
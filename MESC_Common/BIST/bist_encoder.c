@@ -0,0 +1,480 @@
+/*
+* Copyright 2021-2023 cod3b453
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its contributors
+*    may be used to endorse or promote products derived from this software
+*    without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "MESCencoder.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+
+static float const bist_encoder_T = 50.0e-6f;
+static float const counts_to_deg  = 360.0f / 65536.0f;
+
+static double bist_encoder_frac( double const x )
+{
+    return x - floor( x );
+}
+
+// Electrical error, degrees
+static float bist_encoder_err( uint16_t const angle, double const truth )
+{
+    double const t = bist_encoder_frac( truth ) * 65536.0;
+
+    return (float)(int16_t)(angle - (uint16_t)(uint32_t)lround( t )) * counts_to_deg;
+}
+
+/*
+Pole pair ratio
+
+Exact for counts that do not divide 65536, against the legacy 65536/counts
+integer ratio.
+*/
+static void bist_encoder_ratio( void )
+{
+    uint32_t const counts[] = { 4096, 10000, 32768, 65536 };
+    uint8_t  const pp[]     = { 1, 7, 15, 21 };
+
+    ENCODER enc;
+
+    for ( size_t c = 0; c < (sizeof(counts) / sizeof(counts[0])); ++c )
+    {
+        for ( size_t p = 0; p < (sizeof(pp) / sizeof(pp[0])); ++p )
+        {
+            encoder_init( &enc );
+            encoder_config( &enc, counts[c], pp[p] );
+
+            float err = 0.0f;
+            float err_legacy = 0.0f;
+
+            for ( uint32_t pos = 0; pos < counts[c]; pos = pos + 1 + (counts[c] / 8192) )
+            {
+                double const truth = (double)pos * (double)pp[p] / (double)counts[c];
+                uint16_t const legacy = (uint16_t)(pp[p] * (uint16_t)((65536 / counts[c]) * pos));
+
+                err = fmaxf( err, fabsf( bist_encoder_err( encoder_elec( &enc, pos ), truth ) ) );
+                err_legacy = fmaxf( err_legacy, fabsf( bist_encoder_err( legacy, truth ) ) );
+
+                enc.invert = true;
+                assert( fabsf( bist_encoder_err( encoder_elec( &enc, pos ), -truth ) ) < (2.0f * counts_to_deg) );
+                enc.invert = false;
+            }
+
+            assert( err < (1.0f * counts_to_deg) );
+
+            if ((counts[c] == 10000) && (pp[p] == 7))
+            {
+                fprintf( stdout, "    10000 counts 7pp  max error %5.3f deg (legacy %6.1f deg)\n", (double)err, (double)err_legacy );
+                assert( err_legacy > 10.0f );
+            }
+        }
+    }
+}
+
+/*
+Synthetic ABI stream
+
+The rotor turns at a constant rate; the timer counts its quadrature edges into
+a 16 bit counter from an arbitrary start and captures the counter on CCR3 at
+each index. Errors are against the true electrical angle at the PWM centre.
+*/
+struct BISTEncoderABI
+{
+    double   x;     // counts, unwrapped
+    double   v;     // counts/s
+    uint32_t cnt0;  // Counter at x = 0
+    int32_t  lost;  // Edges the counter missed
+    uint16_t idx;
+};
+
+typedef struct BISTEncoderABI BISTEncoderABI;
+
+static void bist_encoder_abi_step( BISTEncoderABI * const r, uint32_t const counts, double const T )
+{
+    double const x = r->x + (r->v * T);
+
+    if (floor( x / counts ) > floor( r->x / counts ))
+    {
+        r->idx = (uint16_t)(r->cnt0 + ((uint32_t)floor( x / counts ) * counts) - (uint32_t)r->lost);
+    }
+
+    r->x = x;
+}
+
+static uint16_t bist_encoder_abi_cnt( BISTEncoderABI const * const r )
+{
+    return (uint16_t)(r->cnt0 + (uint32_t)floor( r->x ) - (uint32_t)r->lost);
+}
+
+static void bist_encoder_abi( void )
+{
+    uint32_t const counts = 4000;
+    uint8_t  const pp     = 7;
+
+    ENCODER enc;
+
+    encoder_init( &enc );
+    encoder_config( &enc, counts, pp );
+
+    BISTEncoderABI r = { 0.3, 50.0 * counts, 61000, 0, 0 }; // 50 rev/s, 350 eHz
+
+    float rms = 0.0f;
+    float rms_raw = 0.0f;
+    uint32_t n = 0;
+
+    for ( uint32_t i = 0; i < 40000; ++i )
+    {
+        bist_encoder_abi_step( &r, counts, bist_encoder_T );
+
+        // Two counts lost half way through the run
+        if (i == 20000)
+        {
+            r.lost = 2;
+        }
+
+        encoder_abi( &enc, bist_encoder_abi_cnt( &r ), r.idx );
+        uint16_t const angle = encoder_run( &enc, bist_encoder_T );
+
+        if ((i > 4000) && (i < 20000))
+        {
+            double const centre = (r.x + (r.v * enc.advance * bist_encoder_T)) * pp / counts;
+            float const e = bist_encoder_err( angle, centre );
+            float const e_raw = bist_encoder_err( encoder_elec( &enc, enc.pos ), centre );
+
+            rms = rms + (e * e);
+            rms_raw = rms_raw + (e_raw * e_raw);
+            n++;
+        }
+    }
+
+    rms = sqrtf( rms / (float)n );
+    rms_raw = sqrtf( rms_raw / (float)n );
+
+    fprintf( stdout, "    ABI 350 eHz       rms %5.2f deg (uncompensated %5.2f) eHz %6.1f\n", (double)rms, (double)rms_raw, (double)enc.eHz );
+    assert( enc.indexed );
+    assert( rms < 0.5f );
+    assert( rms < (0.25f * rms_raw) );
+    assert( fabsf( enc.eHz - 350.0f ) < 1.0f );
+
+    // The lost counts show at the next index, which puts the position back
+    fprintf( stdout, "    ABI lost counts   index errors %u\n", (unsigned)enc.index_errors );
+    assert( enc.index_errors == 1 );
+    assert( enc.pos == (uint32_t)fmod( floor( r.x ), counts ) );
+}
+
+/*
+Absolute encoder read at 1kHz with a 100us sensor delay, as the PWM encoder,
+against the 20kHz fastloop.
+*/
+static float bist_encoder_abs_rms( float const eHz, float const delay, bool const use_delay )
+{
+    uint32_t const counts = 65536;
+    uint8_t  const pp     = 5;
+    double   const v      = (double)eHz / pp;     // rev/s
+
+    ENCODER enc;
+
+    encoder_init( &enc );
+    encoder_config( &enc, counts, pp );
+    enc.offset = 12000;
+    enc.delay = use_delay ? delay : 0.0f;
+
+    float rms = 0.0f;
+    uint32_t n = 0;
+
+    for ( uint32_t i = 0; i < 20000; ++i )
+    {
+        double const t = i * (double)bist_encoder_T;
+
+        if ((i % 20) == 0)
+        {
+            encoder_abs( &enc, (uint32_t)(bist_encoder_frac( v * (t - delay) ) * counts) );
+        }
+
+        uint16_t const angle = encoder_run( &enc, bist_encoder_T );
+
+        if (i > 4000)
+        {
+            double const centre = (v * (t + (enc.advance * bist_encoder_T)) * pp) + (12000.0 / 65536.0);
+            float const e = bist_encoder_err( angle, centre );
+
+            rms = rms + (e * e);
+            n++;
+        }
+    }
+
+    assert( encoder_ok( &enc ) );
+
+    return sqrtf( rms / (float)n );
+}
+
+static void bist_encoder_abs( void )
+{
+    float const rms = bist_encoder_abs_rms( 100.0f, 100.0e-6f, true );
+    float const rms_nodelay = bist_encoder_abs_rms( 100.0f, 100.0e-6f, false );
+
+    fprintf( stdout, "    1kHz abs 100 eHz  rms %5.2f deg (delay not compensated %5.2f)\n", (double)rms, (double)rms_nodelay );
+    assert( rms < 0.5f );
+    assert( rms_nodelay > 3.0f );
+
+    // Faults and timeouts
+    ENCODER enc;
+
+    encoder_init( &enc );
+    encoder_config( &enc, 16384, 1 );
+    assert( !encoder_ok( &enc ) );
+    encoder_abs( &enc, 100 );
+    encoder_run( &enc, bist_encoder_T );
+    assert( encoder_ok( &enc ) );
+
+    for ( uint32_t i = 0; i < ENCODER_ERR_MAX; ++i )
+    {
+        encoder_fault( &enc );
+        encoder_abs( &enc, 100 );
+        encoder_run( &enc, bist_encoder_T );
+    }
+
+    assert( encoder_ok( &enc ) );
+
+    for ( uint32_t i = 0; i < ENCODER_ERR_MAX; ++i )
+    {
+        encoder_fault( &enc );
+        encoder_run( &enc, bist_encoder_T );
+    }
+
+    assert( !encoder_ok( &enc ) );
+    encoder_abs( &enc, 100 );
+    encoder_run( &enc, bist_encoder_T );
+    assert( encoder_ok( &enc ) );
+
+    for ( float t = 0.0f; t < (2.0f * ENCODER_TIMEOUT); t = t + bist_encoder_T )
+    {
+        encoder_run( &enc, bist_encoder_T );
+    }
+
+    assert( !encoder_ok( &enc ) );
+    assert( enc.errors == (2 * ENCODER_ERR_MAX) );
+}
+
+/*
+Calibration
+
+The rotor follows the d axis current to within a friction band either side
+and the encoder, counting backwards from an unknown zero, has a once per rev
+eccentricity and a twice per rev nonlinearity. The encoder starts out
+configured for 1 pole pair.
+*/
+struct BISTEncoderRotor
+{
+    double   e;      // erev, unwrapped
+    double   cmd;    // erev, unwrapped
+    uint16_t last;   // Last command
+    double   band;   // erev
+    uint32_t zero;   // Encoder counts at rotor 0
+    double   ecc;    // counts, sin of the mechanical angle
+    double   nl;     // counts, at twice the mechanical angle
+    bool     stuck;
+};
+
+typedef struct BISTEncoderRotor BISTEncoderRotor;
+
+static uint32_t bist_encoder_rotor_raw( BISTEncoderRotor const * const r, uint32_t const counts, uint8_t const pp )
+{
+    double const mech = r->e / pp;
+    double const x = (double)r->zero - (mech * counts) + (r->ecc * sin( 6.28318531 * mech )) + (r->nl * cos( (12.5663706 * mech) + 0.7 ));
+
+    return (uint32_t)fmod( fmod( floor( x + 0.5 ), counts ) + counts, counts );
+}
+
+static void bist_encoder_rotor_step( BISTEncoderRotor * const r, uint16_t const cmd )
+{
+    r->cmd = r->cmd + ((int16_t)(cmd - r->last) / 65536.0);
+    r->last = cmd;
+
+    if (!r->stuck)
+    {
+        r->e = fmin( fmax( r->e, r->cmd - r->band ), r->cmd + r->band );
+    }
+}
+
+static ENCODERCal bist_encoder_cal_run( ENCODER * const enc, BISTEncoderRotor * const r, uint32_t const counts, uint8_t const pp )
+{
+    encoder_init( enc );
+    encoder_config( enc, counts, 1 );
+    encoder_abs( enc, bist_encoder_rotor_raw( r, counts, pp ) );
+    encoder_run( enc, bist_encoder_T );
+    encoder_cal_start( enc );
+
+    uint32_t n = 0;
+
+    while (enc->cal.phase != ENCODER_CAL_DONE)
+    {
+        encoder_abs( enc, bist_encoder_rotor_raw( r, counts, pp ) );
+        encoder_run( enc, bist_encoder_T );
+        bist_encoder_rotor_step( r, encoder_cal_run( enc, bist_encoder_T ) );
+
+        n++;
+        assert( n < 2000000 );
+    }
+
+    return enc->cal;
+}
+
+// Max error over a mechanical rev, the rotor still at each point
+static float bist_encoder_spin_max( ENCODER * const enc, BISTEncoderRotor * const r, uint32_t const counts, uint8_t const pp )
+{
+    float emax = 0.0f;
+
+    for ( uint32_t i = 0; i < 2000; ++i )
+    {
+        r->e = i * (pp / 2000.0);
+        enc->primed = false; // Still
+        encoder_abs( enc, bist_encoder_rotor_raw( r, counts, pp ) );
+        emax = fmaxf( emax, fabsf( bist_encoder_err( encoder_run( enc, bist_encoder_T ), r->e ) ) );
+    }
+
+    return emax;
+}
+
+static void bist_encoder_cal( void )
+{
+    uint32_t const counts = 4096;
+    uint8_t  const pp     = 7;
+
+    ENCODER enc;
+    BISTEncoderRotor r = { 0.2, 0.0, 0, 0.03, 1234, 3.0, 0.0, false };
+
+    ENCODERCal const cal = bist_encoder_cal_run( &enc, &r, counts, pp );
+
+    // Counting backwards the electrical angle is pp (mech - zero)
+    uint16_t const offset = (uint16_t)lround( bist_encoder_frac( (double)pp * r.zero / counts ) * 65536.0 );
+    float const err = (float)(int16_t)(enc.offset - offset) * counts_to_deg;
+
+    fprintf( stdout, "    Calibration       pp %u invert %u offset error %5.2f deg lag %5.2f deg\n",
+             (unsigned)enc.pole_pairs, (unsigned)enc.invert, (double)err, (double)(cal.lag * counts_to_deg) );
+    assert( cal.result == ENCODER_CAL_OK );
+    assert( enc.pole_pairs == pp );
+    assert( enc.invert );
+    assert( fabsf( err ) < 0.5f );
+    assert( fabsf( (cal.lag / 65536.0f) - (float)r.band ) < 0.005f );
+
+    // Spun on the calibrated encoder, the angle follows the rotor with the eccentricity taken out
+    encoder_config( &enc, counts, pp );
+    float const emax = bist_encoder_spin_max( &enc, &r, counts, pp );
+
+    fprintf( stdout, "    Calibrated angle  max error %5.2f deg\n", (double)emax );
+    assert( emax < (fabsf( err ) + 0.5f) );
+
+    // A rotor that does not turn
+    BISTEncoderRotor stuck = { 0.0, 0.0, 0, 0.03, 0, 0.0, 0.0, true };
+
+    assert( bist_encoder_cal_run( &enc, &stuck, counts, pp ).result == ENCODER_CAL_NO_MOTION );
+}
+
+/*
+Harmonic compensation
+
+Applied, a hand set harm against the correction it stands for. Fitted, the
+calibration against an encoder with 1.5 deg of eccentricity and 0.6 deg of
+nonlinearity at twice per rev, each spun over a rev with and without the
+compensation.
+*/
+static void bist_encoder_harm( void )
+{
+    uint32_t const counts = 16384;
+    uint8_t  const pp     = 7;
+
+    ENCODER enc;
+
+    // Applied
+    encoder_init( &enc );
+    enc.harm[0][0] = 20.0f;
+    enc.harm[2][1] = -8.0f;
+
+    for ( uint32_t inv = 0; inv < 2; ++inv )
+    {
+        enc.invert = (inv != 0);
+        encoder_config( &enc, counts, pp );
+        assert( enc.comp_on );
+
+        float const k = (enc.invert ? -65536.0f : 65536.0f) * pp / counts;
+        float err = 0.0f;
+
+        for ( uint32_t pos = 0; pos < counts; pos = pos + 7 )
+        {
+            double const th = 6.28318531 * pos / counts;
+            double const c = k * ((20.0 * cos( th )) - (8.0 * sin( 3.0 * th )));
+
+            err = fmaxf( err, fabsf( (float)(encoder_comp( &enc, pos ) - c) ) );
+        }
+
+        assert( err < 4.0f );
+    }
+
+    encoder_init( &enc );
+    encoder_config( &enc, counts, pp );
+    assert( !enc.comp_on );
+
+    // Fitted
+    BISTEncoderRotor r = { 0.2, 0.0, 0, 0.03, 555, 68.0, 27.0, false };
+
+    ENCODERCal const cal = bist_encoder_cal_run( &enc, &r, counts, pp );
+
+    assert( cal.result == ENCODER_CAL_OK );
+
+    float const h1 = hypotf( enc.harm[0][0], enc.harm[0][1] );
+    float const h2 = hypotf( enc.harm[1][0], enc.harm[1][1] );
+
+    fprintf( stdout, "    Harmonics fitted  %5.1f %5.1f counts (set %4.1f %4.1f)\n", (double)h1, (double)h2, r.ecc, r.nl );
+    assert( fabsf( h1 - (float)r.ecc ) < 2.0f );
+    assert( fabsf( h2 - (float)r.nl ) < 2.0f );
+
+    encoder_config( &enc, counts, pp );
+    float const emax = bist_encoder_spin_max( &enc, &r, counts, pp );
+
+    enc.comp_on = false;
+    float const emax_raw = bist_encoder_spin_max( &enc, &r, counts, pp );
+
+    fprintf( stdout, "    Compensated angle max error %5.2f deg (uncompensated %5.2f)\n", (double)emax, (double)emax_raw );
+    assert( emax < 0.5f );
+    assert( emax < (0.1f * emax_raw) );
+}
+
+void bist_encoder( void )
+{
+    fprintf( stdout, "Starting ENCODER BIST\n" );
+
+    bist_encoder_ratio();
+    bist_encoder_abi();
+    bist_encoder_abs();
+    bist_encoder_cal();
+    bist_encoder_harm();
+
+    fprintf( stdout, "Finished ENCODER BIST\n" );
+}
@@ -0,0 +1,206 @@
+/*
+* Copyright 2021-2023 cod3b453
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its contributors
+*    may be used to endorse or promote products derived from this software
+*    without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "MESCfsched.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+PLL as run at the end of fastLoop, in angle counts (65536 per erev) per PWM cycle
+*/
+struct BISTPLL
+{
+    uint32_t angle;
+    float    kp;
+    float    ki;
+    float    integral;
+    float    error;
+};
+
+typedef struct BISTPLL BISTPLL;
+
+static float bist_fsched_pll_step( BISTPLL * const pll, uint16_t const theta, float const f )
+{
+    pll->angle    = pll->angle + (uint32_t)(int32_t)((int16_t)pll->integral + (int16_t)pll->error);
+    pll->error    = pll->kp * (float)(int16_t)(theta - (uint16_t)(pll->angle & 0xFFFF));
+    pll->integral = pll->integral + (pll->ki * pll->error);
+
+    return pll->integral * f * 0.00001526f;
+}
+
+/*
+Track a rotor accelerating through `eHz0` -> `eHz1` over `T` seconds. The
+PWM frequency follows the scheduler (updated at the slow loop rate) when
+schedule is set, otherwise it stays at f0. The speed estimate at each slow
+loop tick is recorded.
+*/
+#define BIST_FSCHED_TICKS 200 // 2 s at 100 Hz
+
+static void bist_fsched_run( float const f0, float const eHz0, float const eHz1, int const schedule,
+                             float eHz_est[BIST_FSCHED_TICKS], float f_log[BIST_FSCHED_TICKS] )
+{
+    FSCHED  fs;
+    BISTPLL pll = { 0, 0.5f, 0.02f, 0.0f, 0.0f };
+    double  theta = 0.0;
+    double  t     = 0.0;
+    float   f     = f0;
+    float   eHz   = 0.0f;
+
+    fsched_init( &fs, f0 );
+
+    for ( uint32_t tick = 0; tick < BIST_FSCHED_TICKS; ++tick )
+    {
+        double const t_end = 0.01 * (double)(tick + 1);
+
+        while (t < t_end)
+        {
+            double const T  = 1.0 / (double)f;
+            double const wt = (double)eHz0 + (((double)eHz1 - (double)eHz0) * t / 2.0);
+
+            theta = theta + (65536.0 * wt * T);
+            t     = t + T;
+
+            eHz = bist_fsched_pll_step( &pll, (uint16_t)(uint32_t)fmod( theta, 65536.0 ), f );
+        }
+
+        eHz_est[tick] = eHz;
+        f_log[tick]   = f;
+
+        if (schedule)
+        {
+            float const f_new = fsched_update( &fs, f, eHz, 25.0f, 0.15f * f0 );
+
+            if (f_new != f)
+            {
+                float const eHz_before = pll.integral * f * 0.00001526f;
+
+                fsched_rescale_pll( f, f_new, &pll.kp, &pll.ki, &pll.integral, &pll.error );
+                f = f_new;
+
+                // Speed estimate is unchanged by the rescale
+                assert( fabsf( (pll.integral * f * 0.00001526f) - eHz_before ) < 1.0e-3f );
+            }
+        }
+    }
+}
+
+void bist_fsched( void )
+{
+    fprintf( stdout, "Starting FSCHED BIST\n" );
+
+    FSCHED fs;
+
+    fsched_init( &fs, 20000.0f );
+
+    // Standstill runs at the minimum
+    fsched_update( &fs, 10000.0f, 0.0f, 25.0f, 0.0f );
+    assert( fs.f_target == fs.f_min );
+
+    // Full speed at full frequency
+    fsched_update( &fs, 20000.0f, 1000.0f, 25.0f, 0.0f );
+    assert( fs.f_target == fs.f_max );
+
+    // Hot switches derate, but the erev floor still holds
+    fsched_update( &fs, 20000.0f, 1000.0f, 200.0f, 0.0f );
+    assert( fs.f_target == fmaxf( fs.f_min, FSCHED_SAMPLES_PER_EREV * 1000.0f ) );
+
+    // Bandwidth floor
+    fsched_update( &fs, 20000.0f, 0.0f, 25.0f, 9000.0f );
+    assert( fs.f_target == (FSCHED_BW_RATIO * 9000.0f) );
+
+    // Above 1 kHz eHz the erev floor asks for more than f_max; f_max wins and is flagged
+    assert( fsched_update( &fs, 20000.0f, 1500.0f, 25.0f, 0.0f ) == 20000.0f );
+    assert( fs.f_target == fs.f_max );
+    assert( fs.floor_limited );
+
+    fsched_update( &fs, 20000.0f, 1500.0f, 25.0f, 15000.0f );
+    assert( fs.f_req <= fs.f_max );
+    assert( fs.floor_limited );
+
+    fsched_update( &fs, 20000.0f, 1000.0f, 25.0f, 0.0f );
+    assert( !fs.floor_limited );
+
+    // Hysteresis and slew
+    assert( fsched_update( &fs, 16000.0f, 300.0f, 25.0f, 0.0f ) == 16000.0f );
+    assert( fsched_update( &fs, 19500.0f, 1000.0f, 25.0f, 0.0f ) == 20000.0f );
+    assert( fsched_update( &fs, 10000.0f, 1000.0f, 25.0f, 0.0f ) == 11000.0f );
+
+    // Continuity; the PLL speed estimate with the scheduler switching
+    // frequency through the speed ramp must follow the fixed frequency one
+    float eHz_fixed[BIST_FSCHED_TICKS];
+    float eHz_sched[BIST_FSCHED_TICKS];
+    float f_fixed[BIST_FSCHED_TICKS];
+    float f_sched[BIST_FSCHED_TICKS];
+
+    bist_fsched_run( 20000.0f, 0.0f, 600.0f, 0, eHz_fixed, f_fixed );
+    bist_fsched_run( 20000.0f, 0.0f, 600.0f, 1, eHz_sched, f_sched );
+
+    uint32_t changes = 0;
+    float    err_max = 0.0f;
+    float    f_low   = f_sched[0];
+
+    for ( uint32_t tick = 0; tick < BIST_FSCHED_TICKS; ++tick )
+    {
+        float const err = fabsf( eHz_sched[tick] - eHz_fixed[tick] );
+
+        if ((tick > 0) && (f_sched[tick] != f_sched[tick - 1]))
+        {
+            ++changes;
+        }
+
+        if (f_sched[tick] < f_low)
+        {
+            f_low = f_sched[tick];
+        }
+
+        if (err > err_max)
+        {
+            err_max = err;
+        }
+
+        if ((tick % 20) == 0)
+        {
+            fprintf( stdout, "    t %4.2f f %7.1f eHz %7.2f (fixed %7.2f)\n",
+                (double)(0.01f * (float)tick), (double)f_sched[tick], (double)eHz_sched[tick], (double)eHz_fixed[tick] );
+        }
+    }
+
+    fprintf( stdout, "    %u frequency changes, largest speed estimate difference %.3f Hz\n", (unsigned)changes, (double)err_max );
+
+    assert( changes > 3 );
+    // Dropped at low speed and came back up
+    assert( f_low <= (0.5f * 20000.0f) );
+    assert( f_sched[BIST_FSCHED_TICKS - 1] == 20000.0f );
+    assert( err_max < 1.0f );
+
+    fprintf( stdout, "Finished FSCHED BIST\n" );
+}
@@ -0,0 +1,293 @@
+/*
+* Copyright 2021-2023 cod3b453
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its contributors
+*    may be used to endorse or promote products derived from this software
+*    without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "MESChallest.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+Synthetic hall stream
+
+The six boundaries sit at 60 degree spacing plus a known misplacement and the
+sensors switch with a small hysteresis either side of each boundary. The
+estimator starts from the nominal table and has to learn the real edges.
+*/
+static int   const bist_hallest_order[HALLEST_STATES] = { 1, 3, 2, 6, 4, 5 };
+static float const bist_hallest_mis[HALLEST_STATES]   = { 6.0f, -4.0f, 3.0f, -7.0f, 5.0f, -3.0f }; // degrees
+static float const bist_hallest_hyst = 2.0f; // degrees
+static float const bist_hallest_T    = 50.0e-6f;
+static float const deg_to_counts     = 65536.0f / 360.0f;
+
+struct BISTHallRotor
+{
+    double theta; // degrees, unwrapped
+    int    k;     // Index into bist_hallest_order
+};
+
+typedef struct BISTHallRotor BISTHallRotor;
+
+static float bist_hallest_boundary( int const k )
+{
+    return (60.0f * (float)k) + bist_hallest_mis[k];
+}
+
+static float bist_hallest_wrap_deg( float x )
+{
+    while (x >= 180.0f)
+    {
+        x = x - 360.0f;
+    }
+
+    while (x < -180.0f)
+    {
+        x = x + 360.0f;
+    }
+
+    return x;
+}
+
+static int bist_hallest_sense( BISTHallRotor * const r )
+{
+    float const th = (float)fmod( fmod( r->theta, 360.0 ) + 360.0, 360.0 );
+
+    for ( int i = 0; i < 2; ++i )
+    {
+        int   const kn  = (r->k + 1) % HALLEST_STATES;
+        float const up  = bist_hallest_boundary( kn ) + (0.5f * bist_hallest_hyst);
+        float const dn  = bist_hallest_boundary( r->k ) - (0.5f * bist_hallest_hyst);
+
+        if ((bist_hallest_wrap_deg( th - up ) >= 0.0f) && (bist_hallest_wrap_deg( th - up ) < 30.0f))
+        {
+            r->k = kn;
+        }
+        else if ((bist_hallest_wrap_deg( th - dn ) < 0.0f) && (bist_hallest_wrap_deg( th - dn ) > -30.0f))
+        {
+            r->k = (r->k + HALLEST_STATES - 1) % HALLEST_STATES;
+        }
+    }
+
+    return bist_hallest_order[r->k];
+}
+
+static void bist_hallest_nominal( uint16_t table[HALLEST_STATES][4], float const offset )
+{
+    for ( int k = 0; k < HALLEST_STATES; ++k )
+    {
+        int const s = bist_hallest_order[k] - 1;
+
+        table[s][0] = (uint16_t)(((60.0f * (float)k) + offset) * deg_to_counts);
+        table[s][1] = (uint16_t)(((60.0f * (float)(k + 1)) + offset) * deg_to_counts);
+        table[s][2] = (uint16_t)(((60.0f * (float)k) + 30.0f + offset) * deg_to_counts);
+        table[s][3] = (uint16_t)(60.0f * deg_to_counts);
+    }
+}
+
+/*
+Legacy style reference; nominal table edges, fixed step from the last period
+*/
+struct BISTHallLegacy
+{
+    int   state;
+    float t;
+    float dt;
+    float edge;
+};
+
+typedef struct BISTHallLegacy BISTHallLegacy;
+
+static float bist_hallest_legacy( BISTHallLegacy * const l, uint16_t table[HALLEST_STATES][4], int const state )
+{
+    if (state != l->state)
+    {
+        l->state = state;
+        l->dt    = l->t;
+        l->t     = 0.0f;
+        l->edge  = (float)table[state - 1][0];
+    }
+
+    l->t = l->t + bist_hallest_T;
+
+    float f = l->t / l->dt;
+
+    if (f > 1.0f)
+    {
+        f = 1.0f;
+    }
+
+    return l->edge + (f * (float)table[state - 1][3]);
+}
+
+/*
+Run for `time` seconds from eHz0 to eHz1, returning the RMS angle error
+(degrees) over the last half of the run for the estimator and the legacy
+reference.
+*/
+static void bist_hallest_run( HALLEST * const he, BISTHallRotor * const r, uint16_t table[HALLEST_STATES][4],
+                              float const time, float const eHz0, float const eHz1, bool const observe,
+                              float * const rms, float * const rms_legacy )
+{
+    BISTHallLegacy l = { 0, 0.0f, 1.0f, 0.0f };
+    uint32_t const n = (uint32_t)(time / bist_hallest_T);
+    double e2  = 0.0;
+    double e2l = 0.0;
+    uint32_t count = 0;
+
+    for ( uint32_t i = 0; i < n; ++i )
+    {
+        float const f = (float)i / (float)n;
+        float const w = eHz0 + ((eHz1 - eHz0) * f);
+
+        r->theta = r->theta + (360.0 * (double)w * (double)bist_hallest_T);
+
+        int const state = bist_hallest_sense( r );
+        float const est = (float)hallest_run( he, state, bist_hallest_T ) / deg_to_counts;
+        float const leg = bist_hallest_legacy( &l, table, state ) / deg_to_counts;
+
+        if (observe)
+        {
+            hallest_observe( he, (uint16_t)(uint32_t)(fmod( r->theta + 720000.0, 360.0 ) * (double)deg_to_counts) );
+        }
+
+        if (i > (n / 2))
+        {
+            float const e  = bist_hallest_wrap_deg( est - (float)r->theta );
+            float const el = bist_hallest_wrap_deg( leg - (float)r->theta );
+
+            e2  = e2  + (double)(e * e);
+            e2l = e2l + (double)(el * el);
+            ++count;
+        }
+    }
+
+    *rms        = (float)sqrt( e2  / (double)count );
+    *rms_legacy = (float)sqrt( e2l / (double)count );
+}
+
+/*
+Largest edge placement error (degrees). Timing alone cannot see an offset
+common to all six edges, so that can optionally be excluded.
+*/
+static float bist_hallest_edge_error( HALLEST const * const he, uint32_t const dir, bool const spacing_only )
+{
+    float e[HALLEST_STATES];
+    float mean = 0.0f;
+    float err  = 0.0f;
+
+    for ( int k = 0; k < HALLEST_STATES; ++k )
+    {
+        int   const s = bist_hallest_order[(dir == HALLEST_DIR_FWD) ? k : ((k + HALLEST_STATES - 1) % HALLEST_STATES)] - 1;
+        float const h = (dir == HALLEST_DIR_FWD) ? (0.5f * bist_hallest_hyst) : (-0.5f * bist_hallest_hyst);
+
+        e[k] = bist_hallest_wrap_deg( (he->enter[dir][s] / deg_to_counts) - (bist_hallest_boundary( k ) + h) );
+        mean = mean + (e[k] / (float)HALLEST_STATES);
+    }
+
+    for ( int k = 0; k < HALLEST_STATES; ++k )
+    {
+        float const ek = fabsf( spacing_only ? (e[k] - mean) : e[k] );
+
+        if (ek > err)
+        {
+            err = ek;
+        }
+    }
+
+    return err;
+}
+
+void bist_hallest( void )
+{
+    fprintf( stdout, "Starting HALLEST BIST\n" );
+
+    uint16_t table[HALLEST_STATES][4];
+    HALLEST he;
+    BISTHallRotor r = { 30.0, 0 };
+    float rms;
+    float rms_legacy;
+
+    bist_hallest_nominal( table, 0.0f );
+    hallest_init( &he, table );
+
+    // Successors follow the table order
+    for ( int k = 0; k < HALLEST_STATES; ++k )
+    {
+        assert( he.next[bist_hallest_order[k] - 1] == (bist_hallest_order[(k + 1) % HALLEST_STATES] - 1) );
+    }
+
+    fprintf( stdout, "    Initial forward edge error %5.2f deg\n", (double)bist_hallest_edge_error( &he, HALLEST_DIR_FWD, true ) );
+
+    // Steady speed; timing calibration learns the spacing
+    bist_hallest_run( &he, &r, table, 3.0f, 20.0f, 20.0f, false, &rms, &rms_legacy );
+    fprintf( stdout, "    20 eHz steady     rms %5.2f deg (legacy %5.2f) edge error %5.2f deg\n",
+        (double)rms, (double)rms_legacy, (double)bist_hallest_edge_error( &he, HALLEST_DIR_FWD, true ) );
+    assert( bist_hallest_edge_error( &he, HALLEST_DIR_FWD, true ) < 1.0f );
+    // Includes the half hysteresis common offset that timing cannot see
+    assert( rms < 1.5f );
+    assert( rms < (0.5f * rms_legacy) );
+
+    // Accelerating; the model carries the acceleration across edges
+    bist_hallest_run( &he, &r, table, 1.0f, 20.0f, 80.0f, false, &rms, &rms_legacy );
+    fprintf( stdout, "    20-80 eHz ramp    rms %5.2f deg (legacy %5.2f)\n", (double)rms, (double)rms_legacy );
+    assert( rms < 1.5f );
+    assert( rms < rms_legacy );
+
+    // Reverse; the backward edges are learned separately
+    bist_hallest_run( &he, &r, table, 0.2f, 0.0f, 0.0f, false, &rms, &rms_legacy );
+    bist_hallest_run( &he, &r, table, 3.0f, -20.0f, -20.0f, false, &rms, &rms_legacy );
+    fprintf( stdout, "    -20 eHz steady    rms %5.2f deg backward edge error %5.2f deg\n",
+        (double)rms, (double)bist_hallest_edge_error( &he, HALLEST_DIR_BWD, true ) );
+    assert( bist_hallest_edge_error( &he, HALLEST_DIR_BWD, true ) < 1.0f );
+    assert( rms < 1.5f );
+
+    // Stopped; sits in the middle of the state
+    bist_hallest_run( &he, &r, table, 0.3f, 0.0f, 0.0f, false, &rms, &rms_legacy );
+    assert( hallest_eHz( &he ) == 0.0f );
+    fprintf( stdout, "    Stopped           rms %5.2f deg\n", (double)rms );
+    assert( rms < 35.0f );
+
+    // Timing cannot see a common offset, a trusted reference can
+    BISTHallRotor r2 = { 30.0, 0 };
+
+    bist_hallest_nominal( table, 8.0f );
+    hallest_init( &he, table );
+    bist_hallest_run( &he, &r2, table, 4.0f, 40.0f, 40.0f, true, &rms, &rms_legacy );
+    fprintf( stdout, "    Observer learning rms %5.2f deg edge error %5.2f deg\n",
+        (double)rms, (double)bist_hallest_edge_error( &he, HALLEST_DIR_FWD, false ) );
+    assert( bist_hallest_edge_error( &he, HALLEST_DIR_FWD, false ) < 1.0f );
+
+    // Blend
+    assert( hallest_blend( &he, 0.0f ) == 0.0f );
+    assert( hallest_blend( &he, -1000.0f ) == 1.0f );
+    assert( fabsf( hallest_blend( &he, 0.5f * (he.eHz_lo + he.eHz_hi) ) - 0.5f ) < 1.0e-6f );
+
+    fprintf( stdout, "Finished HALLEST BIST\n" );
+}
@@ -0,0 +1,123 @@
+/*
+* Copyright 2021-2023 cod3b453
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its contributors
+*    may be used to endorse or promote products derived from this software
+*    without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "MESChealth.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+void bist_health( void )
+{
+    fprintf( stdout, "Starting HEALTH BIST\n" );
+
+    HEALTH     h;
+    HEALTH_ISR isr[2];
+
+    health_init( &h );
+    health_isr_reset( &isr[0] );
+    health_isr_reset( &isr[1] );
+
+    uint32_t const budget = 8400; // 168MHz at 20kHz
+
+    // Quiet system
+    for ( uint32_t i = 0; i < 1000; ++i )
+    {
+        health_isr_sample( &isr[0], 3000 + (i % 7), budget );
+        health_isr_sample( &isr[1], 1200, budget );
+    }
+
+    health_task_sample( &h, "tskCLI", 120 );
+    health_task_sample( &h, "task_led", 60 );
+
+    assert( health_check( &h, isr, 2, budget ) == 0 );
+    assert( h.isr_worst == 3006 );
+    assert( h.overruns == 0 );
+    assert( isr[0].samples == 1000 );
+
+    // High water marks only go down, and are matched by name
+    health_task_sample( &h, "tskCLI", 200 );
+    health_task_sample( &h, "tskCLI", 80 );
+    assert( h.task_count == 2 );
+    assert( h.task[0].stack_min == 80 );
+    assert( strcmp( health_lowest_stack( &h )->name, "task_led" ) == 0 );
+
+    // Stack dips under the threshold
+    health_task_sample( &h, "task_led", 20 );
+    assert( health_check( &h, isr, 2, budget ) == HEALTH_WARN_STACK );
+
+    // A task that has gone away is not held against us
+    health_task_sample( &h, "tskCLI", 80 );
+    assert( health_check( &h, isr, 2, budget ) == 0 );
+
+    // Near the budget, then over it
+    health_isr_sample( &isr[1], 8000, budget );
+    assert( health_check( &h, isr, 2, budget ) == HEALTH_WARN_ISR );
+
+    health_isr_sample( &isr[0], 9000, budget );
+    health_isr_sample( &isr[0], 8500, budget );
+    assert( health_check( &h, isr, 2, budget ) == (HEALTH_WARN_ISR | HEALTH_WARN_OVERRUN) );
+    assert( h.overruns_new == 2 );
+    assert( h.isr_worst == 9000 );
+
+    // Overruns are counted per check, tolerate a few if configured
+    h.overrun_warn = 1;
+    health_isr_sample( &isr[0], 9000, budget );
+    assert( (health_check( &h, isr, 2, budget ) & HEALTH_WARN_OVERRUN) == 0 );
+    assert( h.overruns == 3 );
+
+    // Resetting the worst case clears the warning
+    health_isr_reset( &isr[0] );
+    health_isr_reset( &isr[1] );
+    assert( health_check( &h, isr, 2, budget ) == 0 );
+
+    // A reset asked for from a task is done by the ISR at its next sample
+    health_isr_sample( &isr[0], 9000, budget );
+    health_isr_request_reset( &isr[0] );
+    assert( isr[0].worst == 9000 );
+    health_isr_sample( &isr[0], 1000, budget );
+    assert( !isr[0].reset_req );
+    assert( (isr[0].worst == 1000) && (isr[0].overruns == 0) && (isr[0].samples == 1) );
+
+    // Tasks beyond the table are flagged, long names are cut
+    char name[HEALTH_NAME_LEN + 8];
+
+    for ( uint32_t i = 0; i < (HEALTH_MAX_TASKS + 2); ++i )
+    {
+        snprintf( name, sizeof(name), "t%02u_long_task_name", (unsigned)i );
+        health_task_sample( &h, name, 100 );
+    }
+
+    assert( h.task_count == HEALTH_MAX_TASKS );
+    assert( strlen( h.task[2].name ) == (HEALTH_NAME_LEN - 1) );
+    assert( health_check( &h, isr, 2, budget ) == HEALTH_WARN_TASKS );
+
+    fprintf( stdout, "Finished HEALTH BIST\n" );
+}
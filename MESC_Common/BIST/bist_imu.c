@@ -0,0 +1,643 @@
+/*
+* Copyright 2021-2023 cod3b453
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its contributors
+*    may be used to endorse or promote products derived from this software
+*    without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "MESCimu.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BIST_IMU_PI      3.14159265f
+#define BIST_IMU_DEG     (BIST_IMU_PI / 180.0f)
+#define BIST_IMU_LATENCY 300 // us from starting a read to its DMA complete
+#define BIST_IMU_RAMP    (16.0f * 500.0f / 32.8f * BIST_IMU_DEG) // rad/s per s
+
+/*
+Motion the simulated sensor sees at time t, s: pitch and roll in rad, their
+rates in rad/s, and a specific force along x in g on top of gravity.
+*/
+struct BISTImuMotion
+{
+    float pitch;
+    float roll;
+    float pitch_rate;
+    float roll_rate;
+    float ax;
+};
+
+typedef struct BISTImuMotion BISTImuMotion;
+
+typedef BISTImuMotion (*BISTImuPath)( float const t );
+
+/*
+MPU6050 on the bus: a register file, a byte FIFO that drops its oldest byte
+when full as the part does, and one transfer in flight.
+*/
+struct BISTImuSim
+{
+    uint8_t     reg[128];
+    uint8_t     fifo[MPU_FIFO_SIZE];
+    uint32_t    fifo_n;
+    uint32_t    generated;   // Frames
+    uint32_t    t_next;      // us, next sample
+    BISTImuPath path;
+    float       gyr_bias;    // rad/s on y
+
+    bool        busy;
+    uint8_t     rreg;
+    uint8_t *   dst;
+    uint16_t    len;
+    uint32_t    t_done;      // us
+    bool        fail_read;
+    uint32_t    writes;
+};
+
+typedef struct BISTImuSim BISTImuSim;
+
+static int bist_imu_bus_read( void * ctx, uint8_t reg, uint8_t * buf, uint16_t len )
+{
+    BISTImuSim * const sim = (BISTImuSim *)ctx;
+
+    if (sim->fail_read || sim->busy)
+    {
+        return -1;
+    }
+
+    sim->busy = true;
+    sim->rreg = reg;
+    sim->dst = buf;
+    sim->len = len;
+
+    return 0;
+}
+
+static int bist_imu_bus_write( void * ctx, uint8_t reg, uint8_t val )
+{
+    BISTImuSim * const sim = (BISTImuSim *)ctx;
+
+    sim->writes++;
+
+    if ((reg == MPU_REG_USER_CTRL) && (val & 0x04))
+    {
+        sim->fifo_n = 0;
+        val &= (uint8_t)~0x04;
+    }
+
+    sim->reg[reg & 0x7F] = val;
+
+    return 0;
+}
+
+static void bist_imu_sim_init( BISTImuSim * const sim, IMU * const imu, BISTImuPath const path )
+{
+    memset( sim, 0, sizeof(*sim) );
+    sim->path = path;
+
+    IMUBus const bus = { bist_imu_bus_read, bist_imu_bus_write, sim };
+
+    imu_init( imu, &bus );
+}
+
+static void bist_imu_put16( uint8_t * const p, float const x )
+{
+    float const r = fminf( fmaxf( roundf( x ), -32768.0f ), 32767.0f );
+    int16_t const v = (int16_t)r;
+
+    p[0] = (uint8_t)((uint16_t)v >> 8);
+    p[1] = (uint8_t)((uint16_t)v & 0xFF);
+}
+
+static void bist_imu_fifo_push( BISTImuSim * const sim, uint8_t const * const frame )
+{
+    for (uint32_t i = 0; i < IMU_FRAME; i++)
+    {
+        if (sim->fifo_n == MPU_FIFO_SIZE)
+        {
+            memmove( sim->fifo, sim->fifo + 1, MPU_FIFO_SIZE - 1 );
+            sim->fifo_n--;
+        }
+
+        sim->fifo[sim->fifo_n++] = frame[i];
+    }
+}
+
+/*
+Sample the motion into the FIFO up to now, us, at the configured rate.
+*/
+static void bist_imu_sim_run( BISTImuSim * const sim, uint32_t const now )
+{
+    uint32_t const period = 1000u * ((uint32_t)sim->reg[MPU_REG_SMPLRT_DIV] + 1u);
+
+    while ((int32_t)(now - sim->t_next) >= 0)
+    {
+        if ((sim->reg[MPU_REG_USER_CTRL] & 0x40) && (sim->reg[MPU_REG_FIFO_EN] == 0x78) && (sim->path != NULL))
+        {
+            BISTImuMotion const m = sim->path( (float)sim->t_next * 1.0e-6f );
+            uint8_t frame[IMU_FRAME];
+            float const cp = cosf( m.pitch );
+
+            bist_imu_put16( &frame[0],  4096.0f * (m.ax - sinf( m.pitch )) );
+            bist_imu_put16( &frame[2],  4096.0f * sinf( m.roll ) * cp );
+            bist_imu_put16( &frame[4],  4096.0f * cosf( m.roll ) * cp );
+            bist_imu_put16( &frame[6],  32.8f * m.roll_rate / BIST_IMU_DEG );
+            bist_imu_put16( &frame[8],  32.8f * (m.pitch_rate * cosf( m.roll ) + sim->gyr_bias) / BIST_IMU_DEG );
+            bist_imu_put16( &frame[10], 32.8f * -m.pitch_rate * sinf( m.roll ) / BIST_IMU_DEG );
+
+            bist_imu_fifo_push( sim, frame );
+            sim->generated++;
+        }
+
+        sim->t_next += period;
+    }
+}
+
+/*
+Finish the transfer in flight at now, us, as the DMA complete interrupt would.
+*/
+static bool bist_imu_sim_complete( BISTImuSim * const sim, IMU * const imu, uint32_t const now )
+{
+    if (!sim->busy)
+    {
+        return false;
+    }
+
+    bist_imu_sim_run( sim, now );
+    sim->busy = false;
+
+    if (sim->rreg == MPU_REG_FIFO_COUNTH)
+    {
+        sim->dst[0] = (uint8_t)(sim->fifo_n >> 8);
+        sim->dst[1] = (uint8_t)(sim->fifo_n & 0xFF);
+    }
+    else if (sim->rreg == MPU_REG_FIFO_R_W)
+    {
+        uint32_t const n = (sim->len < sim->fifo_n) ? sim->len : sim->fifo_n;
+
+        memcpy( sim->dst, sim->fifo, n );
+        memmove( sim->fifo, sim->fifo + n, sim->fifo_n - n );
+        sim->fifo_n -= n;
+    }
+
+    imu_rx_done( imu );
+
+    return true;
+}
+
+/*
+One burst at now: start, then the count and data reads each complete
+BIST_IMU_LATENCY later.
+*/
+static void bist_imu_poll( BISTImuSim * const sim, IMU * const imu, uint32_t const now )
+{
+    bist_imu_sim_run( sim, now );
+
+    if (!imu_start( imu, now ))
+    {
+        return;
+    }
+
+    uint32_t t = now;
+
+    do
+    {
+        t += BIST_IMU_LATENCY;
+    } while (bist_imu_sim_complete( sim, imu, t ));
+}
+
+static BISTImuMotion bist_imu_still( float const t )
+{
+    BISTImuMotion m = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+
+    (void)t;
+
+    return m;
+}
+
+static void bist_imu_config( void )
+{
+    BISTImuSim sim;
+    IMU imu;
+
+    bist_imu_sim_init( &sim, &imu, NULL );
+
+    assert( imu_config( &imu, 500.0f ) == 0 );
+    assert( sim.reg[MPU_REG_SMPLRT_DIV] == 1 );
+    assert( sim.reg[MPU_REG_CONFIG] == 0x03 );
+    assert( sim.reg[MPU_REG_GYRO_CONFIG] == 0x10 );
+    assert( sim.reg[MPU_REG_ACCEL_CONFIG] == 0x10 );
+    assert( sim.reg[MPU_REG_FIFO_EN] == 0x78 );
+    assert( sim.reg[MPU_REG_USER_CTRL] == 0x40 );
+    assert( imu.odr == 500.0f );
+
+    // Rounded to a divider of 1kHz
+    assert( imu_config( &imu, 300.0f ) == 0 );
+    assert( sim.reg[MPU_REG_SMPLRT_DIV] == 2 );
+    assert( fabsf( imu.odr - 333.333f ) < 0.01f );
+
+    assert( imu_config( &imu, 1.0f ) == 0 );
+    assert( sim.reg[MPU_REG_SMPLRT_DIV] == 255 );
+
+    assert( imu_config( &imu, 2000.0f ) == 0 );
+    assert( sim.reg[MPU_REG_SMPLRT_DIV] == 0 );
+    assert( imu.odr == 1000.0f );
+
+    fprintf( stdout, "    Configuration written, 300Hz gives %.1fHz\n", (double)(1000.0f / 3.0f) );
+}
+
+static void bist_imu_parse( void )
+{
+    BISTImuSim sim;
+    IMU imu;
+    IMUSample s;
+    uint8_t data[4 * IMU_FRAME];
+
+    bist_imu_sim_init( &sim, &imu, NULL );
+    imu.odr = 500.0f;
+
+    // Full scale and sign
+    float const acc[3] = { 4096.0f, -4096.0f, 2048.0f };
+    float const gyr[3] = { 328.0f, -328.0f, 3280.0f };
+
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        for (uint32_t k = 0; k < 3; k++)
+        {
+            bist_imu_put16( &data[i * IMU_FRAME + 2 * k], acc[k] );
+            bist_imu_put16( &data[i * IMU_FRAME + 6 + 2 * k], gyr[k] * (float)(i + 1) );
+        }
+    }
+
+    // The newest at t, one period apart before it
+    imu_parse( &imu, data, 3, 10000 );
+    assert( imu_available( &imu ) == 3 );
+
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        assert( imu_pop( &imu, &s ) );
+        assert( s.t == (6000 + 2000 * i) );
+        assert( s.acc[0] == 1.0f );
+        assert( s.acc[1] == -1.0f );
+        assert( s.acc[2] == 0.5f );
+        assert( fabsf( s.gyr[0] - (float)(i + 1) * 10.0f * BIST_IMU_DEG ) < 1.0e-5f );
+        assert( fabsf( s.gyr[1] + (float)(i + 1) * 10.0f * BIST_IMU_DEG ) < 1.0e-5f );
+        assert( fabsf( s.gyr[2] - (float)(i + 1) * 100.0f * BIST_IMU_DEG ) < 1.0e-4f );
+    }
+
+    assert( !imu_pop( &imu, &s ) );
+
+    // On time, held to the sample clock
+    imu_parse( &imu, data, 2, 14100 );
+    assert( imu_pop( &imu, &s ) && (s.t == 12000) );
+    assert( imu_pop( &imu, &s ) && (s.t == 14000) );
+
+    // Fewer samples than the time allows; the newest is within a period of t
+    imu_parse( &imu, data, 2, 21000 );
+    assert( imu_pop( &imu, &s ) && (s.t == 16500) );
+    assert( imu_pop( &imu, &s ) && (s.t == 19000) );
+
+    // More samples than the time allows; squeezed in, none after t
+    uint32_t last = 19000;
+
+    imu_parse( &imu, data, 4, 25000 );
+
+    while (imu_pop( &imu, &s ))
+    {
+        assert( (int32_t)(s.t - last) > 0 );
+        last = s.t;
+    }
+
+    assert( last == 25000 );
+
+    fprintf( stdout, "    Frames parsed to g and rad/s, stamps monotonic on the sample clock\n" );
+}
+
+static void bist_imu_ring( void )
+{
+    BISTImuSim sim;
+    IMU imu;
+    IMUSample s;
+    uint8_t data[IMU_FRAME];
+
+    bist_imu_sim_init( &sim, &imu, NULL );
+    imu.odr = 1000.0f;
+
+    // Ordinal in the x accel
+    for (uint32_t i = 0; i < 100; i++)
+    {
+        memset( data, 0, sizeof(data) );
+        bist_imu_put16( &data[0], (float)i );
+        imu_parse( &imu, data, 1, 1000 * i );
+    }
+
+    assert( imu_available( &imu ) == IMU_RING );
+    assert( imu.dropped == (100 - IMU_RING) );
+
+    // The newest are kept
+    for (uint32_t i = 100 - IMU_RING; i < 100; i++)
+    {
+        assert( imu_pop( &imu, &s ) );
+        assert( s.acc[0] == ((float)i * imu.acc_scale) );
+    }
+
+    fprintf( stdout, "    Ring keeps the newest %d, %u dropped\n", IMU_RING, (unsigned)imu.dropped );
+}
+
+static BISTImuMotion bist_imu_ramp( float const t )
+{
+    // A ramp of 16 LSB per sample at 500Hz, so order, loss and time show in the gyro
+    BISTImuMotion m = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+
+    m.roll_rate = BIST_IMU_RAMP * t;
+
+    return m;
+}
+
+static void bist_imu_bursts( void )
+{
+    BISTImuSim sim;
+    IMU imu;
+    IMUSample s;
+
+    bist_imu_sim_init( &sim, &imu, bist_imu_ramp );
+    assert( imu_config( &imu, 500.0f ) == 0 );
+
+    uint32_t const period = 2000;
+    uint32_t popped = 0;
+    float prev = -1.0f;
+    uint32_t prev_t = 0;
+    int32_t err_max = 0;
+    uint32_t bursts = 0;
+
+    // 10ms polls out of step with the samples, then one late by 50ms, then on again
+    for (uint32_t now = 10700; now <= 2000000; now += 10000)
+    {
+        if ((now > 1000000) && (now < 1050000))
+        {
+            continue;
+        }
+
+        bist_imu_poll( &sim, &imu, now );
+        bursts++;
+
+        while (imu_pop( &imu, &s ))
+        {
+            // Stamp within a period before the true sample time, which is the ordinal
+            float const t_true = s.gyr[0] / BIST_IMU_RAMP * 1.0e6f;
+            int32_t const err = (int32_t)s.t - (int32_t)lroundf( t_true );
+
+            assert( s.gyr[0] >= prev );
+            assert( (popped == 0) || ((int32_t)(s.t - prev_t) > 0) );
+
+            if ((popped > 10) && (abs( err ) > err_max))
+            {
+                err_max = abs( err );
+            }
+
+            prev = s.gyr[0];
+            prev_t = s.t;
+            popped++;
+        }
+    }
+
+    bist_imu_poll( &sim, &imu, 2000700 + 5 * 10000 ); // Drain what the backlog left
+
+    while (imu_pop( &imu, &s ))
+    {
+        popped++;
+    }
+
+    fprintf( stdout, "    %u bursts, %u of %u frames, stamp error %d us\n",
+             (unsigned)bursts, (unsigned)popped, (unsigned)(sim.generated - sim.fifo_n / IMU_FRAME), (int)err_max );
+
+    assert( popped == (sim.generated - sim.fifo_n / IMU_FRAME) );
+    assert( imu.overflows == 0 );
+    assert( imu.errors == 0 );
+    assert( imu.dropped == 0 );
+    assert( err_max < (int32_t)period );
+}
+
+static void bist_imu_overflow( void )
+{
+    BISTImuSim sim;
+    IMU imu;
+    IMUSample s;
+
+    bist_imu_sim_init( &sim, &imu, bist_imu_still );
+    assert( imu_config( &imu, 1000.0f ) == 0 );
+
+    // Left for over a second at 1kHz, the FIFO wraps and loses frame alignment
+    bist_imu_poll( &sim, &imu, 1500000 );
+    assert( imu.overflows == 1 );
+    assert( imu_available( &imu ) == 0 );
+
+    // Then runs on from the reset
+    bist_imu_poll( &sim, &imu, 1505000 );
+    assert( imu_available( &imu ) == 5 );
+
+    while (imu_pop( &imu, &s ))
+    {
+        assert( s.acc[2] == 1.0f );
+    }
+
+    // A count that is not whole frames resets too
+    sim.fifo_n = 30;
+    sim.t_next = 0xFFFFFFF0u;
+    assert( imu_start( &imu, 1506000 ) );
+    assert( bist_imu_sim_complete( &sim, &imu, 1506000 ) );
+    assert( imu.overflows == 2 );
+    assert( imu.phase == IMU_IDLE );
+
+    fprintf( stdout, "    Overflow and misaligned counts reset the FIFO\n" );
+}
+
+static void bist_imu_errors( void )
+{
+    BISTImuSim sim;
+    IMU imu;
+
+    bist_imu_sim_init( &sim, &imu, bist_imu_still );
+    assert( imu_config( &imu, 500.0f ) == 0 );
+
+    // A read that does not start
+    sim.fail_read = true;
+    assert( !imu_start( &imu, 10000 ) );
+    assert( imu.errors == 1 );
+    assert( imu.phase == IMU_IDLE );
+    sim.fail_read = false;
+
+    // One in flight blocks the next start
+    assert( imu_start( &imu, 20000 ) );
+    assert( !imu_start( &imu, 20100 ) );
+
+    // A bus error mid burst abandons it
+    assert( bist_imu_sim_complete( &sim, &imu, 20300 ) );
+    assert( imu.phase == IMU_DATA );
+    sim.busy = false;
+    imu_rx_error( &imu );
+    assert( imu.errors == 2 );
+    assert( imu.phase == IMU_IDLE );
+
+    // And the next one runs
+    bist_imu_poll( &sim, &imu, 30000 );
+    assert( imu_available( &imu ) > 0 );
+
+    fprintf( stdout, "    Bus errors abandon the burst, the next one runs\n" );
+}
+
+/*
+Drive the sensor with path for duration, s, polling every 10ms and running the
+filter on each burst. Returns the largest pitch and roll error after settle, rad.
+*/
+static float bist_imu_track( BISTImuPath const path, float const bias, float const duration, float const settle, float * const roll_err )
+{
+    BISTImuSim sim;
+    IMU imu;
+
+    bist_imu_sim_init( &sim, &imu, path );
+    assert( imu_config( &imu, 500.0f ) == 0 );
+    sim.gyr_bias = bias;
+
+    float err = 0.0f;
+
+    *roll_err = 0.0f;
+
+    for (uint32_t now = 10000; now <= (uint32_t)(duration * 1.0e6f); now += 10000)
+    {
+        bist_imu_poll( &sim, &imu, now );
+
+        if (imu_process( &imu ) == 0)
+        {
+            continue;
+        }
+
+        // Against the motion at the newest sample, whose true time is sample_count / odr
+        float const t = (float)(sim.generated - 1) * 2.0e-3f;
+        BISTImuMotion const m = path( t );
+
+        if (t > settle)
+        {
+            err = fmaxf( err, fabsf( imu.att.pitch - m.pitch ) );
+            *roll_err = fmaxf( *roll_err, fabsf( imu.att.roll - m.roll ) );
+        }
+    }
+
+    return err;
+}
+
+static BISTImuMotion bist_imu_tilt( float const t )
+{
+    BISTImuMotion m = { 20.0f * BIST_IMU_DEG, -10.0f * BIST_IMU_DEG, 0.0f, 0.0f, 0.0f };
+
+    (void)t;
+
+    return m;
+}
+
+static BISTImuMotion bist_imu_wheelie( float const t )
+{
+    // Front up at 0.5Hz, to 25deg and back
+    BISTImuMotion m = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+    float const w = 2.0f * BIST_IMU_PI * 0.5f;
+
+    m.pitch = 12.5f * BIST_IMU_DEG * (1.0f - cosf( w * t ));
+    m.pitch_rate = 12.5f * BIST_IMU_DEG * w * sinf( w * t );
+
+    return m;
+}
+
+static BISTImuMotion bist_imu_launch( float const t )
+{
+    // Level, accelerating at 0.3g for a second; to the accelerometer alone that is 17deg
+    BISTImuMotion m = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+
+    if ((t > 1.0f) && (t < 2.0f))
+    {
+        m.ax = 0.3f;
+    }
+
+    return m;
+}
+
+static BISTImuMotion bist_imu_lean( float const t )
+{
+    // Rolled 15deg, pitching as the wheelie
+    BISTImuMotion m = bist_imu_wheelie( t );
+
+    m.roll = 15.0f * BIST_IMU_DEG;
+
+    return m;
+}
+
+static void bist_imu_attitude( void )
+{
+    float roll = 0.0f;
+    float pitch = 0.0f;
+
+    pitch = bist_imu_track( bist_imu_tilt, 0.0f, 2.0f, 0.0f, &roll );
+    fprintf( stdout, "    Static tilt error pitch %.2f roll %.2f deg\n", (double)(pitch / BIST_IMU_DEG), (double)(roll / BIST_IMU_DEG) );
+    assert( pitch < (0.5f * BIST_IMU_DEG) );
+    assert( roll < (0.5f * BIST_IMU_DEG) );
+
+    pitch = bist_imu_track( bist_imu_tilt, 0.02f, 20.0f, 0.0f, &roll );
+    fprintf( stdout, "    Static tilt, 1.1deg/s gyro bias, error %.2f deg\n", (double)(pitch / BIST_IMU_DEG) );
+    assert( pitch < (2.0f * BIST_IMU_DEG) );
+
+    pitch = bist_imu_track( bist_imu_wheelie, 0.0f, 6.0f, 0.0f, &roll );
+    fprintf( stdout, "    Wheelie to 25deg at 0.5Hz, error %.2f deg\n", (double)(pitch / BIST_IMU_DEG) );
+    assert( pitch < (1.0f * BIST_IMU_DEG) );
+
+    pitch = bist_imu_track( bist_imu_lean, 0.0f, 6.0f, 0.0f, &roll );
+    fprintf( stdout, "    Wheelie leaned 15deg, error pitch %.2f roll %.2f deg\n", (double)(pitch / BIST_IMU_DEG), (double)(roll / BIST_IMU_DEG) );
+    assert( pitch < (1.0f * BIST_IMU_DEG) );
+    assert( roll < (1.0f * BIST_IMU_DEG) );
+
+    pitch = bist_imu_track( bist_imu_launch, 0.0f, 3.0f, 0.0f, &roll );
+    fprintf( stdout, "    0.3g launch for 1s, error %.2f deg against 16.7 from the accelerometer\n", (double)(pitch / BIST_IMU_DEG) );
+    // The correction slews at 2 beta, so a second of it costs 5.7deg at most
+    assert( pitch < (2.0f * IMU_BETA_DEFAULT * 1.05f) );
+}
+
+void bist_imu( void )
+{
+    fprintf( stdout, "Starting IMU BIST\n" );
+
+    bist_imu_config();
+    bist_imu_parse();
+    bist_imu_ring();
+    bist_imu_bursts();
+    bist_imu_overflow();
+    bist_imu_errors();
+    bist_imu_attitude();
+
+    fprintf( stdout, "Finished IMU BIST\n" );
+}
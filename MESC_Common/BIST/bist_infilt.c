@@ -0,0 +1,330 @@
+/*
+* Copyright 2021-2023 cod3b453
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its contributors
+*    may be used to endorse or promote products derived from this software
+*    without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "MESCinfilt.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define BIST_INFILT_T 0.01f // s, 100Hz input collection
+
+/*
+Thumb throttle on ADC1 at 100Hz in counts, 12 bit, as MESCinput scales it with
+adc1_MIN 1200 and adc1_MAX 2700: resting with noise, a switching spike, a
+squeeze to full, a wobble at part throttle and the release.
+*/
+static uint16_t const bist_infilt_adc_trace[] =
+{
+    1187, 1203, 1195, 1212, 1190, 1206, 1199, 1218, 1184, 1201,
+    1196, 1209, 1193, 1205, 3980, 1198, 1207, 1191, 1203, 1197,
+    1262, 1431, 1702, 2034, 2351, 2580, 2688, 2702, 2699, 2705,
+    2696, 2703, 2698, 2704, 2699, 2701, 2697, 2702, 2700, 2698,
+    2310, 1985, 1962, 2008, 1951, 2003, 1969, 1998, 1957, 2011,
+    1960, 2002, 1955, 2009, 1964, 1997, 1961, 2006, 1958, 2004,
+    1733, 1402, 1230, 1205, 1193, 1208, 1197, 1211, 1189, 1202,
+};
+
+#define BIST_INFILT_TRACE_LEN (sizeof( bist_infilt_adc_trace ) / sizeof( bist_infilt_adc_trace[0] ))
+
+static float bist_infilt_adc( uint16_t const raw )
+{
+    float const n = ((float)raw - 1200.0f) / (2700.0f - 1200.0f);
+
+    return fminf( fmaxf( n, 0.0f ), 1.0f );
+}
+
+static void bist_infilt_median( void )
+{
+    INFILT f;
+
+    infilt_init( &f );
+    f.median = true;
+
+    // A lone spike does not pass
+    float const x[] = { 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f };
+
+    for (uint32_t i = 0; i < (sizeof( x ) / sizeof( x[0] )); i++)
+    {
+        assert( infilt_run( &f, x[i], true, BIST_INFILT_T ) == 0.0f );
+    }
+
+    // A step passes one sample late
+    assert( infilt_run( &f, 0.5f, true, BIST_INFILT_T ) == 0.0f );
+    assert( infilt_run( &f, 0.5f, true, BIST_INFILT_T ) == 0.5f );
+
+    fprintf( stdout, "    Median drops single sample spikes, one sample of delay\n" );
+}
+
+static void bist_infilt_iir( void )
+{
+    INFILT f;
+
+    infilt_init( &f );
+    f.tau = 0.1f;
+
+    // Close to 1 - 1/e after one time constant
+    float y = 0.0f;
+
+    for (uint32_t i = 0; i < 10; i++)
+    {
+        y = infilt_run( &f, 1.0f, true, BIST_INFILT_T );
+    }
+
+    fprintf( stdout, "    IIR tau 0.1 s step after 0.1 s %.3f\n", (double)y );
+
+    assert( fabsf( y - 0.632f ) < 0.03f );
+}
+
+static void bist_infilt_deadband( void )
+{
+    INFILT f;
+
+    infilt_init( &f );
+    f.deadband = 0.05f;
+
+    assert( infilt_run( &f,  0.04f, true, BIST_INFILT_T ) == 0.0f );
+    assert( infilt_run( &f, -0.04f, true, BIST_INFILT_T ) == 0.0f );
+    assert( infilt_run( &f,  1.0f,  true, BIST_INFILT_T ) == 1.0f );
+    assert( infilt_run( &f, -1.0f,  true, BIST_INFILT_T ) == -1.0f );
+    // Continuous from the edge of the band
+    assert( fabsf( infilt_run( &f, 0.525f, true, BIST_INFILT_T ) - 0.5f ) < 1.0e-6f );
+
+    fprintf( stdout, "    Deadband zero inside the band, full scale at 1\n" );
+}
+
+static void bist_infilt_rate( void )
+{
+    INFILT f;
+
+    infilt_init( &f );
+    f.rate_up   = 2.0f;
+    f.rate_down = 10.0f;
+
+    uint32_t n_up = 0;
+
+    while (infilt_run( &f, 1.0f, true, BIST_INFILT_T ) < 1.0f)
+    {
+        n_up++;
+        assert( n_up < 1000 );
+    }
+
+    uint32_t n_down = 0;
+
+    while (infilt_run( &f, 0.0f, true, BIST_INFILT_T ) > 0.0f)
+    {
+        n_down++;
+        assert( n_down < 1000 );
+    }
+
+    // Reversing takes the shrinking rate to zero and the growing one after
+    infilt_run( &f, 0.5f, true, 1.0f );
+
+    float const r = infilt_run( &f, -0.5f, true, 0.04f );
+
+    fprintf( stdout, "    Rate 0 to 1 in %u samples, 1 to 0 in %u, reversal step %.2f\n",
+             (unsigned)(n_up + 1), (unsigned)(n_down + 1), (double)r );
+
+    // Less a sample of float rounding
+    assert( ((n_up + 1) >= 50) && ((n_up + 1) <= 51) );
+    assert( ((n_down + 1) >= 10) && ((n_down + 1) <= 11) );
+    assert( fabsf( r - 0.1f ) < 1.0e-5f );
+}
+
+static void bist_infilt_timeout( void )
+{
+    INFILT f;
+
+    infilt_init( &f );
+    f.timeout = 0.05f;
+
+    assert( infilt_run( &f, 0.6f, true, BIST_INFILT_T ) == 0.6f );
+
+    // Held through a short dropout
+    for (uint32_t i = 0; i < 4; i++)
+    {
+        assert( infilt_run( &f, 0.0f, false, BIST_INFILT_T ) == 0.6f );
+        assert( !f.fault );
+    }
+
+    assert( infilt_run( &f, 0.0f, false, BIST_INFILT_T ) == 0.0f );
+    assert( f.fault );
+
+    // The signal coming back at part throttle stays at zero
+    assert( infilt_run( &f, 0.6f, true, BIST_INFILT_T ) == 0.0f );
+    assert( f.fault );
+
+    // Released through zero
+    assert( infilt_run( &f, 0.0f, true, BIST_INFILT_T ) == 0.0f );
+    assert( !f.fault );
+    assert( infilt_run( &f, 0.6f, true, BIST_INFILT_T ) == 0.6f );
+
+    fprintf( stdout, "    Timeout holds for 0.05 s, faults and releases through zero\n" );
+}
+
+static void bist_infilt_complementary( void )
+{
+    bool valid = false;
+
+    assert( infilt_complementary( 0.0f, 1.0f, &valid ) == 0.0f );
+    assert( valid );
+    assert( infilt_complementary( 1.0f, 0.0f, &valid ) == 1.0f );
+    assert( valid );
+    assert( fabsf( infilt_complementary( 0.55f, 0.5f, &valid ) - 0.525f ) < 1.0e-6f );
+    assert( valid );
+
+    // One track open or shorted
+    infilt_complementary( 0.5f, 0.0f, &valid );
+    assert( !valid );
+    infilt_complementary( 1.0f, 1.0f, &valid );
+    assert( !valid );
+
+    fprintf( stdout, "    Complementary tracks checked against their sum\n" );
+}
+
+static void bist_infilt_arbitrate( void )
+{
+    INFILT f[INFILT_SOURCES];
+
+    for (uint32_t i = 0; i < INFILT_SOURCES; i++)
+    {
+        infilt_init( &f[i] );
+    }
+
+    assert( infilt_arbitrate( f, INFILT_SOURCES ) == -1 );
+
+    f[INFILT_SRC_ADC1].priority  = 1;
+    f[INFILT_SRC_RCPWM].priority = 2;
+
+    infilt_run( &f[INFILT_SRC_ADC1], 0.3f, true, BIST_INFILT_T );
+    assert( infilt_arbitrate( f, INFILT_SOURCES ) == INFILT_SRC_ADC1 );
+
+    infilt_run( &f[INFILT_SRC_RCPWM], 0.2f, true, BIST_INFILT_T );
+    assert( infilt_arbitrate( f, INFILT_SOURCES ) == INFILT_SRC_RCPWM );
+
+    // A faulted source drops out
+    f[INFILT_SRC_RCPWM].timeout = BIST_INFILT_T;
+    infilt_run( &f[INFILT_SRC_RCPWM], 0.0f, false, BIST_INFILT_T );
+    assert( infilt_arbitrate( f, INFILT_SOURCES ) == INFILT_SRC_ADC1 );
+
+    // Ties to the lower index
+    infilt_run( &f[INFILT_SRC_ADC2], 0.4f, true, BIST_INFILT_T );
+    f[INFILT_SRC_ADC2].priority = 1;
+    assert( infilt_arbitrate( f, INFILT_SOURCES ) == INFILT_SRC_ADC1 );
+
+    fprintf( stdout, "    Priority arbitration\n" );
+}
+
+typedef struct
+{
+    float    max_idle;   // Largest output before the squeeze
+    uint32_t t90;        // Samples from the squeeze to 90%
+    float    ripple;     // Peak to peak through the part throttle wobble
+} BISTInfiltTrace;
+
+static BISTInfiltTrace bist_infilt_trace( INFILT * const f )
+{
+    BISTInfiltTrace res = { 0.0f, 0, 0.0f };
+
+    float    lo = 1.0f;
+    float    hi = 0.0f;
+    uint32_t i90 = 0;
+
+    for (uint32_t i = 0; i < BIST_INFILT_TRACE_LEN; i++)
+    {
+        float const y = infilt_run( f, bist_infilt_adc( bist_infilt_adc_trace[i] ), true, BIST_INFILT_T );
+
+        if (i < 20)
+        {
+            res.max_idle = fmaxf( res.max_idle, y );
+        }
+        else if ((i90 == 0) && (y >= 0.9f))
+        {
+            i90 = i;
+        }
+
+        if ((i >= 48) && (i < 60))
+        {
+            lo = fminf( lo, y );
+            hi = fmaxf( hi, y );
+        }
+    }
+
+    res.t90    = i90 - 20;
+    res.ripple = hi - lo;
+
+    return res;
+}
+
+static void bist_infilt_traces( void )
+{
+    INFILT f;
+
+    infilt_init( &f );
+
+    BISTInfiltTrace const raw = bist_infilt_trace( &f );
+
+    fprintf( stdout, "    Trace unfiltered          idle max %.3f  t90 %2u samples  ripple %.3f\n",
+             (double)raw.max_idle, (unsigned)raw.t90, (double)raw.ripple );
+
+    // The spike lands as full throttle
+    assert( raw.max_idle > 0.9f );
+
+    infilt_init( &f );
+    f.median   = true;
+    f.tau      = 0.01f;
+    f.deadband = 0.02f;
+
+    BISTInfiltTrace const tuned = bist_infilt_trace( &f );
+
+    fprintf( stdout, "    Trace median, IIR, band   idle max %.3f  t90 %2u samples  ripple %.3f\n",
+             (double)tuned.max_idle, (unsigned)tuned.t90, (double)tuned.ripple );
+
+    assert( tuned.max_idle == 0.0f );
+    assert( tuned.t90 <= (raw.t90 + 3) );
+    assert( tuned.ripple < (0.5f * raw.ripple) );
+}
+
+void bist_infilt( void )
+{
+    fprintf( stdout, "Starting Input filter BIST\n" );
+
+    bist_infilt_median();
+    bist_infilt_iir();
+    bist_infilt_deadband();
+    bist_infilt_rate();
+    bist_infilt_timeout();
+    bist_infilt_complementary();
+    bist_infilt_arbitrate();
+    bist_infilt_traces();
+
+    fprintf( stdout, "Finished Input filter BIST\n" );
+}
@@ -0,0 +1,287 @@
+/*
+* Copyright 2021-2023 cod3b453
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its contributors
+*    may be used to endorse or promote products derived from this software
+*    without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "MESCmt6816.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define BIST_MT_PERIOD 1000 // us
+
+/*
+MT6816 replies for an angle in counts: the low two bits of register 0x04 are
+no magnet and a parity bit that makes the 16 bits even.
+*/
+static void bist_mt_frames( uint16_t const angle, bool const no_mag, uint16_t * const rx_h, uint16_t * const rx_l )
+{
+    uint16_t const word = (uint16_t)(angle << 2);
+    uint32_t ones = 0;
+
+    for (uint32_t b = 0; b < 16; b++)
+    {
+        ones += (word >> b) & 1U;
+    }
+
+    *rx_h = (uint16_t)(0xA500 | (word >> 8));
+    *rx_l = (uint16_t)(0xA500 | (word & 0xFCU) | (no_mag ? 0x02U : 0U) | (ones & 1U));
+}
+
+static uint16_t bist_mt_counts( float const angle )
+{
+    float a = fmodf( angle, (float)MT6816_COUNTS );
+
+    if (a < 0.0f)
+    {
+        a = a + (float)MT6816_COUNTS;
+    }
+
+    return (uint16_t)((uint32_t)a % MT6816_COUNTS);
+}
+
+static void bist_mt_parity( void )
+{
+    fprintf( stdout, "    Parity table\n" );
+
+    for (uint32_t x = 0; x < 65536; x++)
+    {
+        uint32_t ones = 0;
+
+        for (uint32_t b = 0; b < 16; b++)
+        {
+            ones += (x >> b) & 1U;
+        }
+
+        assert( mt6816_even_parity( (uint16_t)x ) == ((ones & 1U) ? 0 : 1) );
+    }
+}
+
+static void bist_mt_decode( void )
+{
+    fprintf( stdout, "    Decode\n" );
+
+    uint16_t rx_h;
+    uint16_t rx_l;
+
+    for (uint32_t a = 0; a < MT6816_COUNTS; a++)
+    {
+        bist_mt_frames( (uint16_t)a, false, &rx_h, &rx_l );
+
+        mt6816_t const d = mt6816_decode( rx_h, rx_l );
+
+        assert( d.error == MT6816_OK );
+        assert( d.status == 0 );
+        assert( d.angle == a );
+
+        // Any one bit flipped in the angle is caught
+        mt6816_t const f = mt6816_decode( (uint16_t)(rx_h ^ (1U << (a % 8))), rx_l );
+
+        assert( f.error == MT6816_ERROR );
+        assert( f.status == MT6816_PARITY_ERROR );
+        assert( f.angle == 0 );
+    }
+
+    bist_mt_frames( 1234, true, &rx_h, &rx_l );
+
+    mt6816_t const m = mt6816_decode( rx_h, rx_l );
+
+    assert( m.error == MT6816_ERROR );
+    assert( m.status & MT6816_NO_MAG );
+    assert( m.angle == 0 );
+}
+
+static void bist_mt_velocity( void )
+{
+    MT6816 enc;
+    MT6816Sample s;
+    uint16_t rx_h;
+    uint16_t rx_l;
+
+    mt6816_init( &enc );
+
+    // 3 rev/s both ways, through the wrap; differencing raw samples is the baseline
+    float const revs[2] = { 3.0f, -3.0f };
+
+    for (uint32_t k = 0; k < 2; k++)
+    {
+        float const v = revs[k] * (float)MT6816_COUNTS;
+        float err_loop = 0.0f;
+        float err_diff = 0.0f;
+        uint16_t prev = 0;
+        uint32_t n = 0;
+
+        mt6816_init( &enc );
+
+        for (uint32_t i = 0; i < 1000; i++)
+        {
+            uint32_t const t = i * BIST_MT_PERIOD;
+            // Quantised to whole counts with a little jitter, as the part gives it
+            float const jitter = (float)((int32_t)((i * 7919U) % 5U) - 2);
+            uint16_t const a = bist_mt_counts( 5000.0f + (v * (float)t * 1.0e-6f) + jitter );
+
+            bist_mt_frames( a, false, &rx_h, &rx_l );
+            assert( mt6816_push( &enc, rx_h, rx_l, t ) );
+
+            if (i > 300)
+            {
+                float d = (float)a - (float)prev;
+
+                d = d - ((float)MT6816_COUNTS * roundf( d / (float)MT6816_COUNTS ));
+
+                err_loop = err_loop + fabsf( enc.vel - v );
+                err_diff = err_diff + fabsf( (d / ((float)BIST_MT_PERIOD * 1.0e-6f)) - v );
+                n++;
+            }
+
+            prev = a;
+        }
+
+        err_loop = err_loop / (float)n;
+        err_diff = err_diff / (float)n;
+
+        mt6816_read( &enc, &s );
+        assert( fabsf( s.vel - v ) < (0.01f * fabsf( v )) );
+        assert( err_loop < (0.1f * err_diff) );
+
+        fprintf( stdout, "    %+.0f rev/s: mean velocity error %.0f counts/s, %.0f differencing\n",
+                 (double)revs[k], (double)err_loop, (double)err_diff );
+    }
+}
+
+static void bist_mt_outliers( void )
+{
+    fprintf( stdout, "    Outlier rejection\n" );
+
+    MT6816 enc;
+    MT6816Sample s;
+    uint16_t rx_h;
+    uint16_t rx_l;
+    uint32_t t = 0;
+
+    mt6816_init( &enc );
+
+    for (uint32_t i = 0; i < 100; i++, t += BIST_MT_PERIOD)
+    {
+        bist_mt_frames( 8000, false, &rx_h, &rx_l );
+        assert( mt6816_push( &enc, rx_h, rx_l, t ) );
+    }
+
+    uint32_t const seq = mt6816_read( &enc, &s );
+
+    // Two bits slipped: the parity still checks out, the jump does not
+    bist_mt_frames( 8000 ^ 0x1100, false, &rx_h, &rx_l );
+    assert( !mt6816_push( &enc, rx_h, rx_l, t ) );
+    t += BIST_MT_PERIOD;
+
+    assert( enc.outliers == 1 );
+    assert( mt6816_read( &enc, &s ) == seq );
+    assert( s.enc.angle == 8000 );
+
+    bist_mt_frames( 8001, false, &rx_h, &rx_l );
+    assert( mt6816_push( &enc, rx_h, rx_l, t ) );
+    t += BIST_MT_PERIOD;
+    assert( fabsf( enc.vel ) < 100.0f );
+
+    // A real step: held past reject_max, the loop restarts on it
+    uint32_t accepted = 0;
+
+    for (uint32_t i = 0; i < (MT6816_REJECT_DEFAULT + 1U); i++, t += BIST_MT_PERIOD)
+    {
+        bist_mt_frames( 2000, false, &rx_h, &rx_l );
+        accepted += mt6816_push( &enc, rx_h, rx_l, t ) ? 1U : 0U;
+    }
+
+    assert( accepted == 1 );
+    assert( enc.outliers == (1U + MT6816_REJECT_DEFAULT + 1U) );
+    mt6816_read( &enc, &s );
+    assert( s.enc.angle == 2000 );
+    assert( s.vel == 0.0f );
+
+    // A gap in the samples restarts it too
+    t += 20U * BIST_MT_PERIOD;
+    bist_mt_frames( 9000, false, &rx_h, &rx_l );
+    assert( mt6816_push( &enc, rx_h, rx_l, t ) );
+    assert( enc.pos == 9000.0f );
+}
+
+static void bist_mt_buffer( void )
+{
+    fprintf( stdout, "    Double buffer\n" );
+
+    MT6816 enc;
+    MT6816Sample s;
+    uint16_t rx_h;
+    uint16_t rx_l;
+
+    mt6816_init( &enc );
+
+    assert( mt6816_read( &enc, &s ) == 0 );
+
+    for (uint32_t i = 0; i < 5; i++)
+    {
+        bist_mt_frames( (uint16_t)(100 + i), false, &rx_h, &rx_l );
+        mt6816_push( &enc, rx_h, rx_l, i * BIST_MT_PERIOD );
+
+        assert( mt6816_read( &enc, &s ) == (i + 1U) );
+        assert( s.enc.angle == (100 + i) );
+        assert( s.t == (i * BIST_MT_PERIOD) );
+    }
+
+    // Errors are published, the loop is left alone
+    float const pos = enc.pos;
+
+    bist_mt_frames( 104, true, &rx_h, &rx_l );
+    assert( !mt6816_push( &enc, rx_h, rx_l, 5U * BIST_MT_PERIOD ) );
+    assert( mt6816_read( &enc, &s ) == 6 );
+    assert( s.enc.error == MT6816_ERROR );
+    assert( enc.no_mag == 1 );
+    assert( enc.pos == pos );
+
+    bist_mt_frames( 104, false, &rx_h, &rx_l );
+    rx_l ^= 1U;
+    assert( !mt6816_push( &enc, rx_h, rx_l, 6U * BIST_MT_PERIOD ) );
+    assert( enc.parity_errors == 1 );
+    assert( enc.samples == 7 );
+}
+
+void bist_mt6816( void )
+{
+    fprintf( stdout, "Starting MT6816 BIST\n" );
+
+    bist_mt_parity();
+    bist_mt_decode();
+    bist_mt_velocity();
+    bist_mt_outliers();
+    bist_mt_buffer();
+
+    fprintf( stdout, "Finished MT6816 BIST\n" );
+}
@@ -0,0 +1,420 @@
+/*
+* Copyright 2021-2023 cod3b453
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its contributors
+*    may be used to endorse or promote products derived from this software
+*    without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "TTerm_fnv.h"
+#include "TTerm_nvm.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "virt_flash.h"
+
+#define BIST_NVM_VARS  8
+#define BIST_NVM_LEN   16
+#define BIST_NVM_LOOPS 2000
+
+// Mirror of FlashVariable in TTerm_var.c
+struct BIST_NVM_VARIABLE
+{
+    void *                     variable;
+    uint32_t                   type;
+    uint16_t                   typeSize;
+    char const *               name;
+    uint32_t                   nameLength;
+    uint32_t                   flags;
+    struct BIST_NVM_VARIABLE * nextVar;
+} __attribute__((packed));
+
+typedef struct BIST_NVM_VARIABLE BIST_NVM_VARIABLE;
+
+static char      bist_nvm_name[BIST_NVM_VARS][BIST_NVM_LEN];
+static uint8_t * bist_nvm_base = NULL;
+static uint32_t  bist_nvm_size = 0;
+
+static void bist_nvm_erase( uint8_t const fill )
+{
+    memset( bist_nvm_base, fill, bist_nvm_size );
+}
+
+static void bist_nvm_write( void const * data, uint8_t const * at, uint32_t const length )
+{
+    VirtFlashStatus const ret = virt_flash_write( data, (uint32_t)(at - bist_nvm_base), length );
+
+    assert( ret == VIRT_FLASH_STATUS_COMMIT_SUCCESS );
+    (void)ret;
+}
+
+// CMD_varSave, optionally without the index slot (older firmware) or footer (torn write)
+static uint32_t bist_nvm_save( float const seed, bool const slot, bool const footer )
+{
+    uint32_t n_bytes = sizeof(TTERM_NVM_HEADER) + (BIST_NVM_VARS * sizeof(BIST_NVM_VARIABLE)) + sizeof(TTERM_NVM_FOOTER);
+
+    for ( uint32_t i = 0; i < BIST_NVM_VARS; ++i )
+    {
+        n_bytes += (uint32_t)(strlen( bist_nvm_name[i] ) + 1 + sizeof(float));
+    }
+
+    uint32_t revision;
+    uint32_t offset = TTERM_nvm_next_free( bist_nvm_base, bist_nvm_size, &revision );
+
+    if (TTERM_nvm_fits( bist_nvm_base, bist_nvm_size, offset, n_bytes ) == false)
+    {
+        offset = 0;
+        bist_nvm_erase( 0xFF );
+    }
+
+    uint32_t const slot_number = TTERM_nvm_index_count( bist_nvm_base, bist_nvm_size );
+    uint8_t * const header_section = &bist_nvm_base[offset];
+    BIST_NVM_VARIABLE * var_section = (BIST_NVM_VARIABLE *)(header_section + sizeof(TTERM_NVM_HEADER));
+    uint8_t * curr_data = (uint8_t *)&var_section[BIST_NVM_VARS];
+
+    TTERM_NVM_HEADER const header =
+    {
+        .start       = TTERM_NVM_HEADER_START,
+        .num_entries = BIST_NVM_VARS,
+        .size        = n_bytes,
+        .version     = TTERM_NVM_HEADER_VERSION,
+        .revision    = revision,
+    };
+
+    bist_nvm_write( &header, header_section, sizeof(header) );
+
+    uint8_t * data = curr_data;
+
+    for ( uint32_t i = 0; i < BIST_NVM_VARS; ++i )
+    {
+        uint32_t const name_len = (uint32_t)strlen( bist_nvm_name[i] );
+        BIST_NVM_VARIABLE v;
+
+        memset( &v, 0, sizeof(v) );
+
+        v.name       = (char const *)data;
+        v.nameLength = name_len;
+        v.variable   = data + name_len + 1;
+        v.type       = 4;
+        v.typeSize   = sizeof(float);
+        v.nextVar    = ((i + 1) < BIST_NVM_VARS) ? &var_section[i + 1] : NULL;
+
+        bist_nvm_write( &v, (uint8_t const *)&var_section[i], sizeof(v) );
+
+        data = data + name_len + 1 + sizeof(float);
+    }
+
+    for ( uint32_t i = 0; i < BIST_NVM_VARS; ++i )
+    {
+        uint32_t const name_len = (uint32_t)strlen( bist_nvm_name[i] );
+        float const    value    = seed + (float)i;
+
+        bist_nvm_write( bist_nvm_name[i], curr_data, (name_len + 1) );
+        bist_nvm_write( &value, (curr_data + name_len + 1), sizeof(value) );
+
+        curr_data = curr_data + name_len + 1 + sizeof(float);
+    }
+
+    if (slot)
+    {
+        TTERM_NVM_SLOT const s = TTERM_nvm_index_make( offset, revision );
+
+        bist_nvm_write( &s, (uint8_t const *)TTERM_nvm_index_slot( bist_nvm_base, bist_nvm_size, slot_number ), sizeof(s) );
+    }
+
+    if (footer)
+    {
+        TTERM_NVM_FOOTER f =
+        {
+            .end = TTERM_NVM_FOOTER_END,
+            .crc = 0,
+        };
+
+        bist_nvm_write( &f, curr_data, sizeof(f) );
+
+        f.crc = TTERM_nvm_crc( (TTERM_NVM_HEADER const *)header_section );
+
+        bist_nvm_write( &f, curr_data, sizeof(f) );
+    }
+
+    return revision;
+}
+
+// find_last_active_header as it was, walking every header
+static TTERM_NVM_HEADER const * bist_nvm_legacy_newest( void )
+{
+    TTERM_NVM_HEADER const * header_ptr = (TTERM_NVM_HEADER const *)bist_nvm_base;
+    uint32_t size_last = 0;
+    uint8_t const * header_section = bist_nvm_base;
+
+    while ((header_ptr->start == TTERM_NVM_HEADER_START) && (header_section < (bist_nvm_base + bist_nvm_size)))
+    {
+        header_section += header_ptr->size;
+        size_last = header_ptr->size;
+        header_ptr = (TTERM_NVM_HEADER const *)header_section;
+    }
+
+    return (TTERM_NVM_HEADER const *)(header_section - size_last);
+}
+
+// validate as it was, following the descriptor and name pointers
+static uint32_t bist_nvm_legacy_validate( TTERM_NVM_HEADER const * const header )
+{
+    BIST_NVM_VARIABLE const * curr = (BIST_NVM_VARIABLE const *)(header + 1);
+
+    uint32_t crc = TTERM_fnv1a_init();
+    crc = TTERM_fnv1a_process_data( crc, header, sizeof(TTERM_NVM_HEADER) );
+
+    for ( uint32_t i = 0; i < header->num_entries; ++i )
+    {
+        crc = TTERM_fnv1a_process_data( crc, curr, sizeof(BIST_NVM_VARIABLE) );
+        curr = curr->nextVar;
+    }
+
+    curr = (BIST_NVM_VARIABLE const *)(header + 1);
+
+    for ( uint32_t i = 0; i < header->num_entries; ++i )
+    {
+        crc = TTERM_fnv1a_process_data( crc, curr->name, (curr->nameLength + 1 + curr->typeSize) );
+        curr = curr->nextVar;
+    }
+
+    return TTERM_fnv1a_process_data( crc, TTERM_nvm_footer( header ), (sizeof(TTERM_NVM_FOOTER) - sizeof(uint32_t)) );
+}
+
+static TTERM_NVM_HEADER const * bist_nvm_legacy_load( void )
+{
+    TTERM_NVM_HEADER const * const header = bist_nvm_legacy_newest();
+
+    if ((header->start != TTERM_NVM_HEADER_START) || (TTERM_nvm_footer( header )->end != TTERM_NVM_FOOTER_END))
+    {
+        return NULL;
+    }
+
+    if (bist_nvm_legacy_validate( header ) != TTERM_nvm_footer( header )->crc)
+    {
+        return NULL;
+    }
+
+    return header;
+}
+
+static uint32_t bist_nvm_newest( void )
+{
+    TTERM_NVM_HEADER const * const header = TTERM_nvm_find_newest( bist_nvm_base, bist_nvm_size );
+
+    assert( header != NULL );
+
+    return header->revision;
+}
+
+static float bist_nvm_value( TTERM_NVM_HEADER const * const header, uint32_t const i )
+{
+    BIST_NVM_VARIABLE const * const v = &((BIST_NVM_VARIABLE const *)(header + 1))[i];
+    float value;
+
+    memcpy( &value, v->variable, sizeof(value) );
+
+    return value;
+}
+
+static double bist_nvm_us( clock_t const start )
+{
+    return (1.0e6 * (double)(clock() - start)) / (double)CLOCKS_PER_SEC;
+}
+
+void bist_nvm( void )
+{
+    fprintf( stdout, "Starting NVM BIST\n" );
+
+    for ( uint32_t i = 0; i < BIST_NVM_VARS; ++i )
+    {
+        snprintf( bist_nvm_name[i], BIST_NVM_LEN, "var_%02" PRIu32, i );
+    }
+
+    virt_flash_init();
+    virt_flash_configure( true, false );
+
+    bist_nvm_size = VIRT_FLASH_SIZE;
+    bist_nvm_base = virt_flash_map( 0, bist_nvm_size );
+
+    assert( bist_nvm_base != NULL );
+
+    // Blank store, both erased and zeroed
+    for ( uint32_t k = 0; k < 2; ++k )
+    {
+        uint32_t revision = 1;
+
+        bist_nvm_erase( (k == 0) ? 0xFF : 0x00 );
+
+        assert( TTERM_nvm_index_count( bist_nvm_base, bist_nvm_size ) == 0 );
+        assert( TTERM_nvm_find_newest( bist_nvm_base, bist_nvm_size ) == NULL );
+        assert( TTERM_nvm_next_free( bist_nvm_base, bist_nvm_size, &revision ) == 0 );
+        assert( revision == 0 );
+    }
+
+    // Indexed datasets
+    bist_nvm_erase( 0xFF );
+
+    assert( bist_nvm_save( 0.0f, true, true ) == 0 );
+    assert( bist_nvm_save( 10.0f, true, true ) == 1 );
+    assert( bist_nvm_save( 20.0f, true, true ) == 2 );
+
+    assert( TTERM_nvm_index_count( bist_nvm_base, bist_nvm_size ) == 3 );
+    assert( bist_nvm_newest() == 2 );
+    assert( bist_nvm_value( TTERM_nvm_find_newest( bist_nvm_base, bist_nvm_size ), 3 ) == 23.0f );
+    assert( TTERM_nvm_find_revision( bist_nvm_base, bist_nvm_size, 1 )->revision == 1 );
+    assert( TTERM_nvm_find_revision( bist_nvm_base, bist_nvm_size, 7 ) == NULL );
+
+    // The single pass checksum matches the one computed entry by entry
+    {
+        TTERM_NVM_HEADER const * const header = TTERM_nvm_find_newest( bist_nvm_base, bist_nvm_size );
+
+        assert( TTERM_nvm_crc( header ) == bist_nvm_legacy_validate( header ) );
+        assert( TTERM_nvm_crc( header ) == TTERM_nvm_footer( header )->crc );
+    }
+
+    // Damage to the newest dataset falls back to the one before
+    {
+        uint8_t * const p = (uint8_t *)TTERM_nvm_find_newest( bist_nvm_base, bist_nvm_size ) + sizeof(TTERM_NVM_HEADER) + 3;
+
+        *p = *p ^ 0x10;
+        assert( bist_nvm_newest() == 1 );
+        *p = *p ^ 0x10;
+        assert( bist_nvm_newest() == 2 );
+    }
+
+    // Torn write, slot present but no footer
+    assert( bist_nvm_save( 30.0f, true, false ) == 3 );
+    assert( TTERM_nvm_index_count( bist_nvm_base, bist_nvm_size ) == 4 );
+    assert( bist_nvm_newest() == 2 );
+
+    // Slots that do not lead to their header end the index, the walk covers the rest
+    for ( uint32_t i = 2; i < 4; ++i )
+    {
+        TTERM_NVM_SLOT * const s = (TTERM_NVM_SLOT *)TTERM_nvm_index_slot( bist_nvm_base, bist_nvm_size, i );
+
+        s->revision = s->revision ^ 1;
+    }
+
+    assert( TTERM_nvm_index_count( bist_nvm_base, bist_nvm_size ) == 2 );
+    assert( bist_nvm_newest() == 2 );
+
+    for ( uint32_t i = 2; i < 4; ++i )
+    {
+        TTERM_NVM_SLOT * const s = (TTERM_NVM_SLOT *)TTERM_nvm_index_slot( bist_nvm_base, bist_nvm_size, i );
+
+        s->revision = s->revision ^ 1;
+    }
+
+    assert( TTERM_nvm_index_count( bist_nvm_base, bist_nvm_size ) == 4 );
+
+    // Datasets without slots, as written before the index existed
+    bist_nvm_erase( 0xFF );
+
+    assert( bist_nvm_save( 0.0f, false, true ) == 0 );
+    assert( bist_nvm_save( 10.0f, false, true ) == 1 );
+    assert( TTERM_nvm_index_count( bist_nvm_base, bist_nvm_size ) == 0 );
+    assert( bist_nvm_newest() == 1 );
+
+    assert( bist_nvm_save( 20.0f, true, true ) == 2 );
+    assert( TTERM_nvm_index_count( bist_nvm_base, bist_nvm_size ) == 1 );
+    assert( bist_nvm_newest() == 2 );
+
+    // Older firmware appending after an indexed dataset
+    assert( bist_nvm_save( 30.0f, false, true ) == 3 );
+    assert( bist_nvm_newest() == 3 );
+
+    // Filling the store erases it and restarts the index
+    bist_nvm_erase( 0xFF );
+
+    uint32_t capacity = 0;
+
+    for ( uint32_t r = 0; ; ++r )
+    {
+        bist_nvm_save( (float)r, true, true );
+
+        uint32_t const count = TTERM_nvm_index_count( bist_nvm_base, bist_nvm_size );
+
+        assert( bist_nvm_newest() == r );
+
+        if (count <= r)
+        {
+            assert( count == 1 );
+            assert( (uint8_t const *)TTERM_nvm_find_newest( bist_nvm_base, bist_nvm_size ) == bist_nvm_base );
+            break;
+        }
+
+        capacity = count;
+    }
+
+    fprintf( stdout, "INFO: %" PRIu32 " datasets of %u variables in %u bytes\n", capacity, (unsigned)BIST_NVM_VARS, (unsigned)bist_nvm_size );
+
+    assert( capacity > 1 );
+
+    // Load time against the number of revisions held
+    for ( uint32_t revisions = 1; revisions <= capacity; revisions = revisions * 2 )
+    {
+        bist_nvm_erase( 0xFF );
+
+        for ( uint32_t r = 0; r < revisions; ++r )
+        {
+            bist_nvm_save( (float)r, true, true );
+        }
+
+        assert( bist_nvm_legacy_load() == TTERM_nvm_find_newest( bist_nvm_base, bist_nvm_size ) );
+
+        volatile uintptr_t sink = 0;
+        clock_t            t0   = clock();
+
+        for ( uint32_t k = 0; k < BIST_NVM_LOOPS; ++k )
+        {
+            sink = sink + (uintptr_t)bist_nvm_legacy_load();
+        }
+
+        double const legacy_us = bist_nvm_us( t0 );
+
+        t0 = clock();
+
+        for ( uint32_t k = 0; k < BIST_NVM_LOOPS; ++k )
+        {
+            sink = sink + (uintptr_t)TTERM_nvm_find_newest( bist_nvm_base, bist_nvm_size );
+        }
+
+        double const index_us = bist_nvm_us( t0 );
+
+        fprintf( stdout, "INFO: %3" PRIu32 " revisions: walk + validate %8.3f us index + validate %8.3f us\n",
+            revisions, legacy_us / BIST_NVM_LOOPS, index_us / BIST_NVM_LOOPS );
+    }
+
+    virt_flash_free();
+
+    fprintf( stdout, "Finished NVM BIST\n" );
+}
@@ -0,0 +1,209 @@
+/*
+* Copyright 2021-2023 cod3b453
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its contributors
+*    may be used to endorse or promote products derived from this software
+*    without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "MESCovermod.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+Evaluate the modulator over one erev for a requested vector magnitude of r
+times the linear limit (Vbus = 1).
+
+fund   - fundamental of the applied phase voltage relative to the linear limit
+ripple - current ripple figure; sum of V_n / n over the 5th and above, which is
+         proportional to the harmonic current for a fixed inductance and speed
+*/
+#define BIST_OVERMOD_ANGLES     360
+#define BIST_OVERMOD_HARMONICS  25
+
+static float const one_on_sqrt3 = 0.57735027f;
+static float const two_pi       = 6.28318531f;
+
+static void bist_overmod_eval( OVERMOD * const om, OVERMODType const type, float const r,
+                               float * const fund, float * const ripple )
+{
+    float u[BIST_OVERMOD_ANGLES];
+
+    for ( uint32_t n = 0; n < BIST_OVERMOD_ANGLES; ++n )
+    {
+        float const theta = (two_pi * (float)n) / (float)BIST_OVERMOD_ANGLES;
+        float const mag   = r * one_on_sqrt3;
+        float V[3] =
+        {
+            mag * cosf( theta ),
+            mag * cosf( theta - (two_pi / 3.0f) ),
+            mag * cosf( theta + (two_pi / 3.0f) ),
+        };
+
+        if (!overmod_apply( om, type, 1.0f, V ))
+        {
+            // Linear; apply the SVPWM midpoint clamp as MESCpwm_Write would
+            assert( r <= 1.0001f );
+
+            float const top    = fmaxf( V[0], fmaxf( V[1], V[2] ) );
+            float const bottom = fminf( V[0], fminf( V[1], V[2] ) );
+            float const mid    = 0.5f * (top + bottom);
+
+            V[0] = V[0] - mid;
+            V[1] = V[1] - mid;
+            V[2] = V[2] - mid;
+        }
+
+        assert( V[0] <=  0.50001f );
+        assert( V[0] >= -0.50001f );
+
+        // Remove zero sequence, the motor neutral never sees it
+        u[n] = V[0] - ((V[0] + V[1] + V[2]) / 3.0f);
+    }
+
+    *fund   = 0.0f;
+    *ripple = 0.0f;
+
+    for ( uint32_t h = 1; h <= BIST_OVERMOD_HARMONICS; h = h + 2 )
+    {
+        float a = 0.0f;
+        float b = 0.0f;
+
+        for ( uint32_t n = 0; n < BIST_OVERMOD_ANGLES; ++n )
+        {
+            float const theta = (two_pi * (float)(h * n)) / (float)BIST_OVERMOD_ANGLES;
+
+            a = a + (u[n] * cosf( theta ));
+            b = b + (u[n] * sinf( theta ));
+        }
+
+        float const Vh = (2.0f * sqrtf( (a * a) + (b * b) )) / (float)BIST_OVERMOD_ANGLES;
+
+        if (h == 1)
+        {
+            *fund = Vh / one_on_sqrt3;
+        }
+        else
+        {
+            *ripple = *ripple + (Vh / (float)h);
+        }
+    }
+}
+
+static void bist_overmod_type( OVERMOD * const om, OVERMODType const type, char const * const name )
+{
+    float fund_prev = 0.0f;
+
+    fprintf( stdout, "    %s\n", name );
+    fprintf( stdout, "        request fundamental ripple\n" );
+
+    for ( uint32_t i = 0; i <= 30; ++i )
+    {
+        float const r = 0.9f + ((OVERMOD_SIX_STEP_RATIO - 0.9f) * (float)i / 30.0f);
+        float fund;
+        float ripple;
+
+        bist_overmod_eval( om, type, r, &fund, &ripple );
+
+        fprintf( stdout, "        %7.4f %11.4f %6.4f\n", (double)r, (double)fund, (double)ripple );
+
+        // Never lose fundamental as the request rises (allow for quadrature error)
+        assert( fund >= (fund_prev - 0.001f) );
+        fund_prev = fund;
+
+        if ((type == OVERMOD_TYPE_SIX_STEP) || (r <= 1.0f))
+        {
+            // Six-step tracks the request all the way
+            assert( fabsf( fund - r ) < 0.002f );
+        }
+
+        if (r <= 1.0f)
+        {
+            // Linear region is undistorted
+            assert( ripple < 0.002f );
+        }
+    }
+
+    // Continuity across the linear limit
+    float fund_lo;
+    float fund_hi;
+    float ripple_lo;
+    float ripple_hi;
+
+    bist_overmod_eval( om, type, 0.9999f, &fund_lo, &ripple_lo );
+    bist_overmod_eval( om, type, 1.0020f, &fund_hi, &ripple_hi );
+
+    assert( fabsf( fund_hi - fund_lo ) < 0.005f );
+    assert( fabsf( ripple_hi - ripple_lo ) < 0.005f );
+}
+
+void bist_overmod( void )
+{
+    fprintf( stdout, "Starting Overmodulation BIST\n" );
+
+    OVERMOD om;
+
+    overmod_init( &om );
+
+    // Gain table must be monotonic for the inverse to be single valued
+    assert( overmod_gain[0] >= 0.999f );
+
+    for ( uint32_t t = 1; t < OVERMOD_TABLE_SIZE; ++t )
+    {
+        assert( overmod_gain[t] >= overmod_gain[t - 1] );
+    }
+
+    // and still invert the clip, should the modulator change without the table being regenerated
+    for ( uint32_t t = 0; t < (OVERMOD_TABLE_SIZE - 1); ++t )
+    {
+        float const rt = 1.0f + (((OVERMOD_SIX_STEP_RATIO - 1.0f) * (float)t) / (float)(OVERMOD_TABLE_SIZE - 1));
+
+        assert( fabsf( overmod_fundamental( overmod_gain[t] ) - rt ) < 1.0e-4f );
+    }
+
+    bist_overmod_type( &om, OVERMOD_TYPE_MIN_PHASE, "Minimum phase error" );
+    bist_overmod_type( &om, OVERMOD_TYPE_SIX_STEP , "Six-step" );
+
+    // Full request must reach six-step
+    float fund;
+    float ripple;
+
+    bist_overmod_eval( &om, OVERMOD_TYPE_SIX_STEP, OVERMOD_SIX_STEP_RATIO, &fund, &ripple );
+    assert( fund >= (0.99f * OVERMOD_SIX_STEP_RATIO) );
+
+    // Harmonic current compensation must remove itself in the linear region
+    float Id = 1.0f;
+    float Iq = 2.0f;
+
+    overmod_set_error( &om, 0.1f, 0.1f );
+    om.k = 0.0f;
+    overmod_compensate( &om, 50.0e-6f, 1000.0f, 10.0e-6f, 10.0e-6f, &Id, &Iq );
+    assert( Id == 1.0f );
+    assert( Iq == 2.0f );
+
+    fprintf( stdout, "Finished Overmodulation BIST\n" );
+}
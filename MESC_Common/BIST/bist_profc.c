@@ -0,0 +1,307 @@
+/*
+* Copyright 2021-2023 cod3b453
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its contributors
+*    may be used to endorse or promote products derived from this software
+*    without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "profile_compiler.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*
+Reference images were produced by MESCgen.js itself, driving its make and plot
+functions with the same form values as the descriptions below and taking the
+output of gen().
+*/
+
+#define BIST_PROFC_FLEET 10000
+
+static char const bist_profc_defaults[] =
+    "entry battery\n"
+    "entry motor\n"
+    "entry speed\n"
+    "entry temperature\n"
+    "entry throttle\n"
+    "entry brake\n"
+    "entry button\n"
+    "entry indicator\n"
+    "entry screen\n";
+
+static char const bist_profc_custom[] =
+    "# Sparse slots, scaled and wrapped values, derived Steinhart-Hart\n"
+    "timestamp = 202311301200\n"
+    "githash = 0123456789abcdefFEDCBA9876543210a5a5c3c3\n"
+    "entry motor 3\n"
+    "name = Hub 48V\n"
+    "mtr-imax = 120.5\n"
+    "mtr-pp = 23\n"
+    "mtr-dir = 1\n"
+    "mtr-ind-d = 0.145\n"
+    "mtr-ind-q = 0.21\n"
+    "mtr-res = 38.5\n"
+    "mtr-flxlnk = 0.0312\n"
+    "mtr-rpmmax = -1\n"
+    "entry battery\n"
+    "name = 20s4p Molice\n"
+    "cell-cmax = 4500\n"
+    "cell-cmid = 850.5\n"
+    "bat-esr = 37.25\n"
+    "bat-p = 260\n"
+    "bat-s = 20\n"
+    "bat-disp = 1\n"
+    "entry temperature 17\n"
+    "temp-rd = 1\n"
+    "temp-schema = 1\n"
+    "temp-beta = 3950\n"
+    "temp-r0 = 47000\n"
+    "temp-t0 = 298.15\n"
+    "entry speed 31\n"
+    "spd-enc-off = 123.9\n"
+    "spd-hall-max5 = 70000\n"
+    "spd-d = 27.5\n"
+    "spd-disp = 1\n"
+    "entry throttle 0\n"
+    "thr-imax = 1e2\n"
+    "thr-adc-min = -5\n"
+    "entry brake 9\n"
+    "brk-imax = 35\n"
+    "entry screen\n"
+    "scrn-w = 21.7\n"
+    "scrn-h = 8\n";
+
+// F 05B0 FB4CA293
+static char const bist_profc_defaults_hex[] =
+    "4D45534300010040BACA1720FFFFABAAAAAAAAAA700500007F973FB732303232303230363134343600000000837ADDF0DD130AD367D05C7B0593D19BC5F8904F"
+    "4D504548002007426174746572790000000000004D42504534000000400400004D5045480020054D6F746F7200000000000000004D4D50452400000074040000"
+    "4D504548002005537065656400000000000000004D5350452C000000980400004D50454800200B54656D706572617475726500004D5450453C000000C4040000"
+    "4D5045480020085468726F74746C6500000000004D55504520000000000500004D504548002007452D4272616B650000000000004D5550452000000020050000"
+    "4D504548002006427574746F6E000000000000004D55504520000000400500004D504548002009496E64696361746F72000000004D5550452000000060050000"
+    "4D50454800200653637265656E000000000000004D55504520000000800500000000000000000000000000000000000000000000000000000000000000000000"
+    "00000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000"
+    "00000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000"
+    "00000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000"
+    "00000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000"
+    "00000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000"
+    "00000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000"
+    "00000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000"
+    "00000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000"
+    "00000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000"
+    "00000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000"
+    "00000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000"
+    "0000F04166668640666686409A9959403333333FCDCC4C400000003F333333400000484200007A43CDCCCC3D0214000000000000000070420000C84200007A43"
+    "FA0000000600000000000000000000000000000000007A440000C84200409C450000803F0000803F6400000000009124922423492449B56DB66D48924992DAB6"
+    "DBB66CDB01000000010000000000D04100000000000000003333534000E0924500100000000000000000000083FAC7417B7F98390000000000E05645151DC93D"
+    "0000C84100401C4600002041000048420000000064000000FF070000000000002C0100000000A041E8030000D00700000100000064000000FF07000000000000"
+    "FF0700000000204100000000000000000200000000000000E8B7C40400000000000000000000000000000000000000000300000000000000D0BBC40400000000"
+    "000000000000000000000000000000000400000000000000B8BFC4041000000004000000000000000000000000000000";
+
+// F 0570 00527D0B
+static char const bist_profc_custom_hex[] =
+    "4D45534300010040C44196E7EBABBEAAAEAAAAEA300500001ACC3DAD323032333131333031323030000000000123456789ABCDEFFEDCBA9876543210A5A5C3C3"
+    "4D5045480020085468726F74746C6500000000004D55504520000000400400000000000000000000000000000000000000000000000000000000000000000000"
+    "00000000000000000000000000000000000000000000000000000000000000004D504548002007487562203438560000000000004D4D50452400000060040000"
+    "4D50454800200C3230733470204D6F6C696365004D42504534000000840400000000000000000000000000000000000000000000000000000000000000000000"
+    "00000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000"
+    "00000000000000000000000000000000000000000000000000000000000000004D504548002007452D4272616B650000000000004D55504520000000B8040000"
+    "4D50454800200653637265656E000000000000004D55504520000000D80400000000000000000000000000000000000000000000000000000000000000000000"
+    "00000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000"
+    "00000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000"
+    "00000000000000000000000000000000000000000000000000000000000000004D50454800200B54656D706572617475726500004D5450453C000000F8040000"
+    "00000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000"
+    "00000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000"
+    "00000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000"
+    "00000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000"
+    "00000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000"
+    "00000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000"
+    "00000000000000000000000000000000000000000000000000000000000000004D504548002005537065656400000000000000004D5350452C00000034050000"
+    "00000000FBFFFFFFFF070000000000002C0100000000C842E8030000D00700000000F1420000C84200007A43FFFFFFFF17010000240B183972335C392DB21D3D"
+    "2497FF3C0000C84200409C450000803F0000803F0000F04166668640000090409A9959405EBA593FCDCC4C400000003F333333400000484200007A437593183D"
+    "04140000010000000100000064000000FF07000000000000FF07000000000C4200000000000000000400000000000000B8BFC404150000000800000000000000"
+    "0000000000000000010000003333534000E09245001000000000000001000000DA1295432CBB84390000000000E07645151DC93D331395430098374700002041"
+    "000048427B00000000009124922423492449B56DB66D48924992DAB6DBB6701101000000010000000000DC410000803F";
+
+struct BISTProfcVector
+{
+    char const * text;
+    char const * command;
+    char const * hex;
+};
+
+typedef struct BISTProfcVector BISTProfcVector;
+
+static BISTProfcVector const bist_profc_vector[] =
+{
+    { bist_profc_defaults, "F 05B0 FB4CA293", bist_profc_defaults_hex },
+    { bist_profc_custom,   "F 0570 00527D0B", bist_profc_custom_hex   },
+    { "",                  "F 0440 23A4771B", NULL                    },
+};
+
+struct BISTProfcReject
+{
+    char const * text;
+    PROFCError   error;
+    uint32_t     line;
+};
+
+typedef struct BISTProfcReject BISTProfcReject;
+
+static BISTProfcReject const bist_profc_reject[] =
+{
+    { "entry battery\nname = thirteen_char\n",      PROFC_ERR_NAME,   2 },
+    { "entry battery\nname = tab\there\n",          PROFC_ERR_NAME,   2 },
+    { "entry battery\nmtr-imax = 60\n",             PROFC_ERR_KEY,    2 },
+    { "cell-imax = 30\n",                           PROFC_ERR_KEY,    1 },
+    { "entry battery\ncell-imax = 30A\n",           PROFC_ERR_VALUE,  2 },
+    { "entry battery\ncell-imax = 0x1E\n",          PROFC_ERR_VALUE,  2 },
+    { "entry battery\ncell-imax = 1e\n",            PROFC_ERR_VALUE,  2 },
+    { "entry battery\nbat-s = 2.5\n",               PROFC_ERR_VALUE,  2 },
+    { "entry battery\ncell-imax =\n",               PROFC_ERR_VALUE,  2 },
+    { "entry motor\nmtr-dir = 2\n",                 PROFC_ERR_VALUE,  2 },
+    { "entry battery\nentry temperature\ntemp-r0 = -1\n", PROFC_ERR_VALUE, 2 }, // log(R0) is NaN
+    { "\n\nentry capacitor\n",                      PROFC_ERR_TYPE,   3 },
+    { "entry battery 32\n",                         PROFC_ERR_INDEX,  1 },
+    { "entry battery 3\nentry motor 3\n",           PROFC_ERR_INDEX,  2 },
+    { "entry battery 31\nentry motor\n",            PROFC_ERR_INDEX,  2 },
+    { "entry battery\nthis line is nonsense\n",     PROFC_ERR_SYNTAX, 2 },
+    { "timestamp = 2023\n",                         PROFC_ERR_VALUE,  1 },
+    { "githash = 0123456789abcdef\n",               PROFC_ERR_VALUE,  1 },
+    { "githash = 0123456789abcdefFEDCBA9876543210a5a5c3cg\n", PROFC_ERR_VALUE, 1 },
+};
+
+static uint8_t bist_profc_image[PROFC_IMAGE_MAX];
+static char    bist_profc_hex[(2 * PROFC_IMAGE_MAX) + 1];
+
+static void bist_profc_check( BISTProfcVector const * const v )
+{
+    uint32_t length = 0;
+    uint32_t line   = 0;
+    char     command[PROFC_COMMAND_SIZE];
+
+    assert( profc_compile( v->text, strlen( v->text ), bist_profc_image, sizeof(bist_profc_image), &length, &line ) == PROFC_OK );
+
+    profc_command( bist_profc_image, length, command );
+    profc_hex( bist_profc_image, length, bist_profc_hex );
+
+    if (v->hex != NULL)
+    {
+        size_t const n = strlen( v->hex );
+
+        for ( size_t i = 0; i < n; ++i )
+        {
+            if (bist_profc_hex[i] != v->hex[i])
+            {
+                fprintf( stdout, "ERROR: first difference at byte %zu (0x%zX)\n", (i / 2), (i / 2) );
+                break;
+            }
+        }
+
+        assert( strcmp( bist_profc_hex, v->hex ) == 0 );
+    }
+
+    assert( strcmp( command, v->command ) == 0 );
+
+    fprintf( stdout, "INFO: %s (%" PRIu32 " bytes) matches MESCgen.js\n", command, length );
+}
+
+void bist_profc( void )
+{
+    fprintf( stdout, "Starting Profile Compiler BIST\n" );
+
+    for ( size_t i = 0; i < (sizeof(bist_profc_vector) / sizeof(*bist_profc_vector)); ++i )
+    {
+        bist_profc_check( &bist_profc_vector[i] );
+    }
+
+    // Line endings and whitespace do not change the image
+    {
+        char const text[] = "\r\n  # comment\r\n\tentry   battery \r\n  entry motor\r\nentry speed\nentry temperature\n"
+                            "entry throttle\nentry brake\nentry button\nentry indicator\nentry screen";
+        BISTProfcVector const v = { text, bist_profc_vector[0].command, bist_profc_vector[0].hex };
+
+        bist_profc_check( &v );
+    }
+
+    for ( size_t i = 0; i < (sizeof(bist_profc_reject) / sizeof(*bist_profc_reject)); ++i )
+    {
+        BISTProfcReject const * const r = &bist_profc_reject[i];
+        uint32_t length = 0;
+        uint32_t line   = 0;
+
+        assert( profc_compile( r->text, strlen( r->text ), bist_profc_image, sizeof(bist_profc_image), &length, &line ) == r->error );
+        assert( line == r->line );
+    }
+
+    // Output bound
+    {
+        uint32_t length = 0;
+        uint32_t line   = 0;
+
+        assert( profc_compile( bist_profc_defaults, strlen( bist_profc_defaults ), bist_profc_image, 0x5AF, &length, &line ) == PROFC_ERR_SPACE );
+        assert( profc_compile( bist_profc_defaults, strlen( bist_profc_defaults ), bist_profc_image, 0x5B0, &length, &line ) == PROFC_OK );
+        assert( length == 0x5B0 );
+    }
+
+    // Fleet batch, one description per vehicle
+    {
+        static char text[1024];
+        clock_t const start = clock();
+
+        for ( uint32_t i = 0; i < BIST_PROFC_FLEET; ++i )
+        {
+            int const n = snprintf( text, sizeof(text),
+                "entry battery\nname = veh%05" PRIu32 "\ncell-cmax = %" PRIu32 "\nbat-s = %" PRIu32 "\nbat-esr = %" PRIu32 ".5\n"
+                "entry motor\nmtr-pp = %" PRIu32 "\nmtr-res = %" PRIu32 ".25\n"
+                "entry speed\nspd-d = %" PRIu32 ".%" PRIu32 "\n"
+                "entry temperature\ntemp-beta = %" PRIu32 "\n"
+                "entry throttle\nthr-imax = %" PRIu32 "\n",
+                i, (2000 + (i % 3000)), (10 + (i % 14)), (20 + (i % 80)),
+                (4 + (i % 20)), (10 + (i % 90)),
+                (16 + (i % 14)), (i % 10),
+                (3000 + (i % 1000)),
+                (10 + (i % 90)) );
+
+            uint32_t length = 0;
+            uint32_t line   = 0;
+
+            assert( (n > 0) && ((size_t)n < sizeof(text)) );
+            assert( profc_compile( text, (size_t)n, bist_profc_image, sizeof(bist_profc_image), &length, &line ) == PROFC_OK );
+        }
+
+        double const s = (double)(clock() - start) / (double)CLOCKS_PER_SEC;
+
+        fprintf( stdout, "INFO: %u fleet profiles compiled in %.3f s (%.0f/s)\n",
+            (unsigned)BIST_PROFC_FLEET, s, (s > 0.0) ? ((double)BIST_PROFC_FLEET / s) : 0.0 );
+    }
+
+    fprintf( stdout, "Finished Profile Compiler BIST\n" );
+}
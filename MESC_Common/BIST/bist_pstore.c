@@ -0,0 +1,355 @@
+/*
+* Copyright 2021-2023 cod3b453
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its contributors
+*    may be used to endorse or promote products derived from this software
+*    without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "MESCpstore.h"
+
+#include "MESCfnv.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "virt_flash.h"
+
+#define BIST_PSTORE_ENTRIES 40
+#define BIST_PSTORE_TYPES   4
+#define BIST_PSTORE_DATA    64
+#define BIST_PSTORE_LOOPS   20000
+
+static uint32_t const bist_pstore_type[BIST_PSTORE_TYPES] =
+{
+    UINT32_C(0x5441424D), // "MBAT"
+    UINT32_C(0x544F4D4D), // "MMOT"
+    UINT32_C(0x5053454D), // "MESP"
+    UINT32_C(0x504D544D), // "MTMP"
+};
+
+static char       bist_pstore_name[PSTORE_MAX_ENTRIES][PSTORE_NAME_LENGTH + 1];
+static uint8_t    bist_pstore_data[PSTORE_MAX_ENTRIES][BIST_PSTORE_DATA];
+static PSTOREItem bist_pstore_item[PSTORE_MAX_ENTRIES];
+static uint32_t   bist_pstore_image[16384 / sizeof(uint32_t)];
+
+static void bist_pstore_items( uint32_t const count, uint32_t const data_length )
+{
+    for ( uint32_t i = 0; i < count; ++i )
+    {
+        snprintf( bist_pstore_name[i], sizeof(bist_pstore_name[i]), "entry_%03" PRIu32, i );
+
+        for ( uint32_t b = 0; b < BIST_PSTORE_DATA; ++b )
+        {
+            bist_pstore_data[i][b] = (uint8_t)((i * 31) + b);
+        }
+
+        bist_pstore_item[i].type   = bist_pstore_type[(i * 3) % BIST_PSTORE_TYPES];
+        bist_pstore_item[i].name   = bist_pstore_name[i];
+        bist_pstore_item[i].data   = bist_pstore_data[i];
+        bist_pstore_item[i].length = (data_length > 0) ? data_length : (1 + ((i * 7) % BIST_PSTORE_DATA));
+    }
+}
+
+// Every item can be found and maps onto its own data
+static void bist_pstore_check_all( PSTORE * const ps, uint32_t const count )
+{
+    for ( uint32_t i = 0; i < count; ++i )
+    {
+        void const * data   = NULL;
+        uint32_t     length = 0;
+
+        assert( pstore_get( ps, bist_pstore_item[i].type, bist_pstore_item[i].name, &data, &length ) == PSTORE_OK );
+        assert( length == bist_pstore_item[i].length );
+        assert( memcmp( data, bist_pstore_item[i].data, length ) == 0 );
+        assert( ((uintptr_t)data % PSTORE_ALIGN) == 0 );
+    }
+}
+
+// What a whole-image parse costs: every entry read until the match
+static uint32_t bist_pstore_linear( PSTORE const * const ps, uint32_t const type, char const * const name )
+{
+    for ( uint32_t i = 0; i < ps->entries; ++i )
+    {
+        PSTOREEntry const * const e = &ps->directory[i];
+
+        if ((e->type == type) && (strncmp( e->name, name, PSTORE_NAME_LENGTH ) == 0))
+        {
+            return i;
+        }
+    }
+
+    return UINT32_MAX;
+}
+
+static double bist_pstore_us( clock_t const start )
+{
+    return (1.0e6 * (double)(clock() - start)) / (double)CLOCKS_PER_SEC;
+}
+
+void bist_pstore( void )
+{
+    fprintf( stdout, "Starting PSTORE BIST\n" );
+
+    PSTORE   ps;
+    uint32_t length = 0;
+
+    bist_pstore_items( PSTORE_MAX_ENTRIES, 0 );
+
+    // Build and read back through virt_flash, mapped rather than copied
+    assert( pstore_build( bist_pstore_image, sizeof(bist_pstore_image), bist_pstore_item, BIST_PSTORE_ENTRIES, 7, &length ) == PSTORE_OK );
+
+    virt_flash_init();
+    virt_flash_configure( true, false );
+
+    assert( length <= VIRT_FLASH_SIZE );
+    assert( virt_flash_write( bist_pstore_image, 0, length ) == VIRT_FLASH_STATUS_COMMIT_SUCCESS );
+
+    uint8_t * const flash = virt_flash_map( 0, length );
+
+    assert( flash != NULL );
+    assert( pstore_open( &ps, flash, length ) == PSTORE_OK );
+    assert( ps.entries == BIST_PSTORE_ENTRIES );
+    assert( ps.header->generation == 7 );
+
+    fprintf( stdout, "INFO: %u entries in %" PRIu32 " bytes\n", (unsigned)BIST_PSTORE_ENTRIES, length );
+
+    bist_pstore_check_all( &ps, BIST_PSTORE_ENTRIES );
+
+    // By type alone, entries of one type are contiguous
+    {
+        uint32_t total = 0;
+
+        for ( uint32_t t = 0; t < BIST_PSTORE_TYPES; ++t )
+        {
+            uint32_t index = 0;
+            uint32_t const n = pstore_count( &ps, bist_pstore_type[t] );
+
+            assert( n > 0 );
+            assert( pstore_find( &ps, bist_pstore_type[t], NULL, &index ) == PSTORE_OK );
+
+            for ( uint32_t k = 0; k < n; ++k )
+            {
+                assert( pstore_entry( &ps, (index + k) )->type == bist_pstore_type[t] );
+            }
+
+            total = total + n;
+        }
+
+        assert( total == BIST_PSTORE_ENTRIES );
+    }
+
+    {
+        uint32_t index = 0;
+
+        assert( pstore_find( &ps, UINT32_C(0x12345678), NULL, &index ) == PSTORE_ERR_NOT_FOUND );
+        assert( pstore_find( &ps, bist_pstore_type[0], "missing", &index ) == PSTORE_ERR_NOT_FOUND );
+        assert( pstore_find( &ps, bist_pstore_type[0], "name_too_long_", &index ) == PSTORE_ERR_NOT_FOUND );
+        assert( pstore_count( &ps, UINT32_C(0x12345678) ) == 0 );
+    }
+
+    // Builder refuses what the store cannot hold
+    {
+        PSTOREItem bad[2] = { bist_pstore_item[0], bist_pstore_item[0] };
+
+        assert( pstore_build( bist_pstore_image, sizeof(bist_pstore_image), bad, 2, 0, &length ) == PSTORE_ERR_NAME );
+
+        bad[1].name = "name_too_long_";
+        assert( pstore_build( bist_pstore_image, sizeof(bist_pstore_image), bad, 2, 0, &length ) == PSTORE_ERR_NAME );
+
+        assert( pstore_build( bist_pstore_image, 256, bist_pstore_item, BIST_PSTORE_ENTRIES, 0, &length ) == PSTORE_ERR_FULL );
+        assert( pstore_build( bist_pstore_image, sizeof(bist_pstore_image), bist_pstore_item, (PSTORE_MAX_ENTRIES + 1), 0, &length ) == PSTORE_ERR_FULL );
+    }
+
+    // Corruption sweep, one bit in every byte of the image
+    {
+        PSTOREEntry const * const directory = (PSTOREEntry const *)(flash + sizeof(PSTOREHeader));
+        uint32_t const directory_end = sizeof(PSTOREHeader) + (BIST_PSTORE_ENTRIES * sizeof(PSTOREEntry));
+        uint32_t caught_header = 0;
+        uint32_t caught_entry  = 0;
+        uint32_t padding       = 0;
+
+        length = ((PSTOREHeader const *)flash)->image_length;
+
+        for ( uint32_t b = 0; b < length; ++b )
+        {
+            flash[b] ^= 0x04;
+
+            PSTOREError const ret = pstore_open( &ps, flash, length );
+
+            if (b < directory_end)
+            {
+                // Header and directory damage refuses the whole store
+                assert( ret != PSTORE_OK );
+                caught_header++;
+            }
+            else
+            {
+                // Data damage is confined to the entry it hits
+                uint32_t hit = UINT32_MAX;
+
+                assert( ret == PSTORE_OK );
+
+                for ( uint32_t i = 0; i < BIST_PSTORE_ENTRIES; ++i )
+                {
+                    if ((directory[i].offset <= b) && (b < (directory[i].offset + directory[i].length)))
+                    {
+                        hit = i;
+                    }
+                }
+
+                for ( uint32_t i = 0; i < BIST_PSTORE_ENTRIES; ++i )
+                {
+                    void const * data = NULL;
+                    uint32_t     len  = 0;
+
+                    assert( pstore_map( &ps, i, &data, &len ) == ((i == hit) ? PSTORE_ERR_ENTRY : PSTORE_OK) );
+                }
+
+                if (hit == UINT32_MAX)
+                {
+                    padding++;
+                }
+                else
+                {
+                    caught_entry++;
+                }
+            }
+
+            flash[b] ^= 0x04;
+        }
+
+        assert( pstore_open( &ps, flash, length ) == PSTORE_OK );
+        bist_pstore_check_all( &ps, BIST_PSTORE_ENTRIES );
+
+        fprintf( stdout, "INFO: corruption caught %" PRIu32 " header/directory, %" PRIu32 " entry, %" PRIu32 " alignment padding\n",
+            caught_header, caught_entry, padding );
+    }
+
+    // Truncated or misplaced images
+    assert( pstore_open( &ps, flash, (length - 1) ) == PSTORE_ERR_SIZE );
+    assert( pstore_open( &ps, (flash + 1), (length - 1) ) == PSTORE_ERR_SIZE );
+    assert( pstore_open( &ps, flash, 8 ) == PSTORE_ERR_SIZE );
+
+    virt_flash_free();
+
+    // Lookup cost against the number of entries, directory bisection and a linear scan
+    for ( uint32_t n = 8; n <= PSTORE_MAX_ENTRIES; n = n * 2 )
+    {
+        assert( pstore_build( bist_pstore_image, sizeof(bist_pstore_image), bist_pstore_item, n, 0, &length ) == PSTORE_OK );
+        assert( pstore_open( &ps, bist_pstore_image, length ) == PSTORE_OK );
+
+        uint32_t max_probes = 0;
+
+        for ( uint32_t i = 0; i < n; ++i )
+        {
+            uint32_t index = 0;
+
+            assert( pstore_find( &ps, bist_pstore_item[i].type, bist_pstore_item[i].name, &index ) == PSTORE_OK );
+            assert( index == bist_pstore_linear( &ps, bist_pstore_item[i].type, bist_pstore_item[i].name ) );
+
+            if (ps.probes > max_probes)
+            {
+                max_probes = ps.probes;
+            }
+        }
+
+        // ceil(log2(n + 1))
+        uint32_t bound = 0;
+
+        while ((UINT32_C(1) << bound) < (n + 1))
+        {
+            bound++;
+        }
+
+        assert( max_probes <= bound );
+
+        volatile uint32_t sink = 0;
+        clock_t           t0   = clock();
+
+        for ( uint32_t k = 0; k < BIST_PSTORE_LOOPS; ++k )
+        {
+            uint32_t const i = k % n;
+            uint32_t       index;
+
+            pstore_find( &ps, bist_pstore_item[i].type, bist_pstore_item[i].name, &index );
+            sink = sink + index;
+        }
+
+        double const find_us = bist_pstore_us( t0 );
+
+        t0 = clock();
+
+        for ( uint32_t k = 0; k < BIST_PSTORE_LOOPS; ++k )
+        {
+            uint32_t const i = k % n;
+
+            sink = sink + bist_pstore_linear( &ps, bist_pstore_item[i].type, bist_pstore_item[i].name );
+        }
+
+        double const linear_us = bist_pstore_us( t0 );
+
+        fprintf( stdout, "INFO: %3" PRIu32 " entries: find %6.3f us (<= %" PRIu32 " probes) linear %6.3f us\n",
+            n, find_us / BIST_PSTORE_LOOPS, max_probes, linear_us / BIST_PSTORE_LOOPS );
+    }
+
+    // Opening does not read entry data, its cost is independent of the payload size
+    for ( uint32_t d = 4; d <= BIST_PSTORE_DATA; d = d * 4 )
+    {
+        bist_pstore_items( 64, d );
+
+        assert( pstore_build( bist_pstore_image, sizeof(bist_pstore_image), bist_pstore_item, 64, 0, &length ) == PSTORE_OK );
+
+        volatile uint32_t sink = 0;
+        clock_t           t0   = clock();
+
+        for ( uint32_t k = 0; k < BIST_PSTORE_LOOPS; ++k )
+        {
+            sink = sink + (uint32_t)pstore_open( &ps, bist_pstore_image, length );
+        }
+
+        double const open_us = bist_pstore_us( t0 );
+
+        t0 = clock();
+
+        for ( uint32_t k = 0; k < BIST_PSTORE_LOOPS; ++k )
+        {
+            sink = sink + fnv1a_data( bist_pstore_image, length );
+        }
+
+        double const image_us = bist_pstore_us( t0 );
+
+        fprintf( stdout, "INFO: 64 entries of %2" PRIu32 " bytes, image %5" PRIu32 " bytes: open %6.3f us whole image checksum %6.3f us\n",
+            d, length, open_us / BIST_PSTORE_LOOPS, image_us / BIST_PSTORE_LOOPS );
+    }
+
+    fprintf( stdout, "Finished PSTORE BIST\n" );
+}
@@ -0,0 +1,299 @@
+/*
+* Copyright 2021-2023 cod3b453
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its contributors
+*    may be used to endorse or promote products derived from this software
+*    without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "MESCsixstep.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define BIST_SIXSTEP_PI   3.14159265
+#define BIST_SIXSTEP_PWM  30000.0 // Hz
+#define BIST_SIXSTEP_VBUS 48.0    // V
+#define BIST_SIXSTEP_K    0.02    // V per eHz, line to neutral peak
+
+/*
+Simulated BEMF
+
+The rotor turns at an imposed speed while the engine commutates. The driven
+pair sits at the duty averaged rail voltages, the neutral follows the driven
+pair's BEMF and the floating terminal adds its own. After each commutation
+the off going phase is held on a rail for demag of a sector while its current
+decays through the diodes. Terminals carry uniform noise.
+*/
+struct BISTSixstepSim
+{
+    double theta;   // deg electrical
+    double eHz;
+    bool   sine;    // Sinusoidal rather than trapezoidal BEMF
+    double demag;   // Fraction of a sector
+    double noise;   // V peak
+    double t_comm;  // s since the last commutation
+    uint8_t prev_high;
+    uint32_t rng;
+};
+
+typedef struct BISTSixstepSim BISTSixstepSim;
+
+static double bist_sixstep_noise( BISTSixstepSim * const sim )
+{
+    sim->rng = (sim->rng * 1103515245u) + 12345u;
+
+    return sim->noise * ((((double)((sim->rng >> 8) & 0xFFFF)) / 32768.0) - 1.0);
+}
+
+// Phase BEMF shape, +-1, following -sin
+static double bist_sixstep_shape( BISTSixstepSim const * const sim, double const x_deg )
+{
+    double x = fmod( x_deg, 360.0 );
+
+    if (x < 0.0)
+    {
+        x = x + 360.0;
+    }
+
+    if (sim->sine)
+    {
+        return -sin( (x * BIST_SIXSTEP_PI) / 180.0 );
+    }
+
+    // Ramps of 60 degrees through 0 and 180, flat between
+    double const f = (x <= 180.0) ? fmin( fmin( (x / 30.0), ((180.0 - x) / 30.0) ), 1.0 )
+                                  : -fmin( fmin( ((x - 180.0) / 30.0), ((360.0 - x) / 30.0) ), 1.0 );
+
+    return -f;
+}
+
+static void bist_sixstep_terminals( BISTSixstepSim * const sim, uint8_t const sector, float V[3] )
+{
+    double const E = BIST_SIXSTEP_K * fabs( sim->eHz ) * ((sim->eHz >= 0.0) ? 1.0 : -1.0);
+    double e[3];
+
+    for ( uint32_t i = 0; i < 3; ++i )
+    {
+        e[i] = E * bist_sixstep_shape( sim, (sim->theta - (120.0 * i)) );
+    }
+
+    // Backwards, the pair is swapped to motor
+    uint8_t const h = (sim->eHz >= 0.0) ? sixstep_high[sector] : sixstep_low[sector];
+    uint8_t const l = (sim->eHz >= 0.0) ? sixstep_low[sector]  : sixstep_high[sector];
+    uint8_t const f = sixstep_float[sector];
+
+    double const Vh = fmin( ((2.0 * fabs( E )) + 2.0), BIST_SIXSTEP_VBUS );
+    double const Vl = 0.0;
+    double const Vn = (0.5 * (Vh + Vl)) - (0.5 * (e[h] + e[l]));
+    double       Vf = Vn + e[f];
+
+    // The current decays in no more than 200us
+    double const t_sector = 1.0 / (6.0 * fmax( fabs( sim->eHz ), 1.0 ));
+
+    if (sim->t_comm < fmin( (sim->demag * t_sector), 200.0e-6 ))
+    {
+        Vf = (f == sim->prev_high) ? 0.0 : BIST_SIXSTEP_VBUS; // Freewheeling diode
+    }
+
+    V[h] = (float)(Vh + bist_sixstep_noise( sim ));
+    V[l] = (float)(Vl + bist_sixstep_noise( sim ));
+    V[f] = (float)(Vf + bist_sixstep_noise( sim ));
+}
+
+struct BISTSixstepResult
+{
+    double err_max;   // deg, commutation angle error
+    double err_mean;
+    uint32_t commutations;
+    bool   locked;
+    double angle_err; // deg, worst sixstep_angle error
+};
+
+typedef struct BISTSixstepResult BISTSixstepResult;
+
+static double bist_sixstep_wrap( double const deg )
+{
+    return deg - (360.0 * floor( ((deg + 180.0) / 360.0) ));
+}
+
+/*
+Start at sim->theta and eHz0, ramping linearly to eHz1 over ramp seconds and
+holding there until duration.
+*/
+static BISTSixstepResult bist_sixstep_run( SIXSTEP * const ss, BISTSixstepSim * const sim,
+                                           double const eHz0, double const eHz1, double const ramp, double const duration )
+{
+    double const T = 1.0 / BIST_SIXSTEP_PWM;
+
+    BISTSixstepResult res = { 0.0, 0.0, 0, false, 0.0 };
+
+    sim->eHz    = eHz0;
+    sim->t_comm = 1.0;
+
+    sixstep_start( ss, (uint16_t)(int32_t)lrint( (sim->theta * 65536.0) / 360.0 ), (float)eHz0 );
+
+    sim->prev_high = (eHz0 >= 0.0) ? sixstep_high[ss->sector] : sixstep_low[ss->sector];
+
+    double err_sum = 0.0;
+
+    for ( double t = 0.0; t < duration; t = t + T )
+    {
+        sim->eHz   = eHz0 + (((eHz1 - eHz0) * fmin( t, ramp )) / ramp);
+        sim->theta = sim->theta + (360.0 * sim->eHz * T);
+        sim->t_comm = sim->t_comm + T;
+
+        float V[3];
+        uint8_t const sector = ss->sector;
+
+        bist_sixstep_terminals( sim, sector, V );
+
+        if (sixstep_run( ss, V[0], V[1], V[2], (float)T ))
+        {
+            // Ideal: the new sector entered 30 degrees, plus advance, before its centre
+            double const sigma  = (sim->eHz >= 0.0) ? 1.0 : -1.0;
+            double const centre = 120.0 - (60.0 * ss->sector);
+            double const ideal  = centre - (sigma * (30.0 + ((ss->advance * 180.0) / BIST_SIXSTEP_PI)));
+            double const err    = sigma * bist_sixstep_wrap( sim->theta - ideal );
+
+            res.err_max = fmax( res.err_max, fabs( err ) );
+            err_sum     = err_sum + err;
+            res.commutations++;
+
+            sim->prev_high = (sim->eHz >= 0.0) ? sixstep_high[sector] : sixstep_low[sector];
+            sim->t_comm    = 0.0;
+        }
+        else if ((ss->t > (0.5 * ss->period)) && (ss->t < (0.6 * ss->period)))
+        {
+            double const est = ((double)sixstep_angle( ss ) * 360.0) / 65536.0;
+
+            res.angle_err = fmax( res.angle_err, fabs( bist_sixstep_wrap( est - sim->theta ) ) );
+        }
+    }
+
+    res.err_mean = (res.commutations > 0) ? (err_sum / res.commutations) : 0.0;
+    res.locked   = ss->locked;
+
+    return res;
+}
+
+static void bist_sixstep_print( char const * const name, BISTSixstepResult const * const res )
+{
+    fprintf( stdout, "    %-26s %5u commutations error mean %6.2f max %6.2f deg angle %6.2f deg%s\n",
+        name, (unsigned)res->commutations, res->err_mean, res->err_max, res->angle_err, (res->locked ? "" : " LOST") );
+}
+
+static BISTSixstepResult bist_sixstep_case( char const * const name, SIXSTEPMode const mode, bool const sine,
+                                            double const eHz0, double const eHz1, double const advance_deg, float const blank )
+{
+    SIXSTEP        ss;
+    BISTSixstepSim sim = { .theta = 17.0, .sine = sine, .demag = 0.15, .noise = 0.2, .rng = 1 };
+
+    float const flux_linkage = (float)(BIST_SIXSTEP_K / (2.0 * BIST_SIXSTEP_PI));
+
+    sixstep_init( &ss, flux_linkage );
+    ss.mode    = mode;
+    ss.advance = (float)((advance_deg * BIST_SIXSTEP_PI) / 180.0);
+    ss.blank   = blank;
+
+    if (!sine)
+    {
+        ss.flux_th = (float)(BIST_SIXSTEP_K / 24.0); // Trapezoid ramp, 30 degrees
+    }
+
+    BISTSixstepResult const res = bist_sixstep_run( &ss, &sim, eHz0, eHz1, 0.5, 0.6 );
+
+    bist_sixstep_print( name, &res );
+
+    return res;
+}
+
+void bist_sixstep( void )
+{
+    fprintf( stdout, "Starting Six-step BIST\n" );
+
+    // Tables: each sector drives and floats all three phases, the floating phase is next driven
+    for ( uint8_t k = 0; k < 6; ++k )
+    {
+        assert( (sixstep_high[k] + sixstep_low[k] + sixstep_float[k]) == 3 );
+        assert( (sixstep_high[k] != sixstep_low[k]) && (sixstep_float[k] != sixstep_high[k]) );
+        assert( (sixstep_float[k] == sixstep_high[(k + 1) % 6]) || (sixstep_float[k] == sixstep_low[(k + 1) % 6]) );
+    }
+
+    // Pick up: the sector holding the rotor, with the period from the speed
+    SIXSTEP ss;
+
+    sixstep_init( &ss, 0.01f );
+    sixstep_start( &ss, (uint16_t)((65536 * 120) / 360), 100.0f );
+    assert( (ss.sector == 0) && (ss.direction == -1) && ss.locked );
+    assert( fabsf( (ss.t / ss.period) - 0.5f ) < 0.01f );
+    assert( fabsf( sixstep_eHz( &ss ) - 100.0f ) < 0.01f );
+    sixstep_start( &ss, 0, -100.0f );
+    assert( (ss.sector == 2) && (ss.direction == 1) );
+    assert( fabsf( sixstep_eHz( &ss ) + 100.0f ) < 0.01f );
+
+    fprintf( stdout, "  Trapezoidal BEMF, %.0f kHz PWM, 15%% demag, %.1f V noise\n", BIST_SIXSTEP_PWM / 1000.0, 0.2 );
+
+    BISTSixstepResult r;
+
+    // Errors are bounded by the noise over the BEMF slope at low speed and by half a PWM period at high speed
+    r = bist_sixstep_case( "ZC 100 eHz",                SIXSTEP_MODE_ZC,        false,  100.0,  100.0,  0.0, SIXSTEP_BLANK );
+    assert( r.locked && (r.err_max < 6.0) && (r.angle_err < 10.0) );
+    r = bist_sixstep_case( "ZC 1000 eHz",               SIXSTEP_MODE_ZC,        false, 1000.0, 1000.0,  0.0, SIXSTEP_BLANK );
+    assert( r.locked && (r.err_max < 7.0) );
+    r = bist_sixstep_case( "ZC -400 eHz",               SIXSTEP_MODE_ZC,        false, -400.0, -400.0,  0.0, SIXSTEP_BLANK );
+    assert( r.locked && (r.err_max < 4.0) );
+    r = bist_sixstep_case( "ZC 400 eHz 15deg advance",  SIXSTEP_MODE_ZC,        false,  400.0,  400.0, 15.0, SIXSTEP_BLANK );
+    assert( r.locked && (r.err_max < 4.0) );
+    r = bist_sixstep_case( "ZC ramp 200-1000 eHz",      SIXSTEP_MODE_ZC,        false,  200.0, 1000.0,  0.0, SIXSTEP_BLANK );
+    assert( r.locked && (r.err_max < 10.0) );
+    r = bist_sixstep_case( "INT 100 eHz",               SIXSTEP_MODE_INTEGRATE, false,  100.0,  100.0,  0.0, SIXSTEP_BLANK );
+    assert( r.locked && (r.err_max < 4.0) && (r.angle_err < 10.0) );
+    r = bist_sixstep_case( "INT 1000 eHz",              SIXSTEP_MODE_INTEGRATE, false, 1000.0, 1000.0,  0.0, SIXSTEP_BLANK );
+    assert( r.locked && (r.err_max < 7.0) );
+    r = bist_sixstep_case( "INT ramp 200-1000 eHz",     SIXSTEP_MODE_INTEGRATE, false,  200.0, 1000.0,  0.0, SIXSTEP_BLANK );
+    assert( r.locked && (r.err_max < 10.0) );
+    r = bist_sixstep_case( "INT 400 eHz 15deg advance", SIXSTEP_MODE_INTEGRATE, false,  400.0,  400.0, 15.0, SIXSTEP_BLANK );
+    assert( r.locked && (r.err_max < 4.0) );
+
+    // The demag spike reads as past the crossing, so is ignored even without blanking
+    r = bist_sixstep_case( "ZC 400 eHz no blanking",    SIXSTEP_MODE_ZC,        false,  400.0,  400.0,  0.0, 0.0f );
+    assert( r.locked && (r.err_max < 4.0) );
+
+    // Stopping, the BEMF sinks into the noise and sync is given up once stood still
+    r = bist_sixstep_case( "ZC ramp 400-0 eHz",         SIXSTEP_MODE_ZC,        false,  400.0,    0.0,  0.0, SIXSTEP_BLANK );
+    assert( !r.locked );
+
+    fprintf( stdout, "  Sinusoidal BEMF, default integration threshold\n" );
+
+    r = bist_sixstep_case( "INT 400 eHz",               SIXSTEP_MODE_INTEGRATE, true,   400.0,  400.0,  0.0, SIXSTEP_BLANK );
+    assert( r.locked && (r.err_max < 4.0) );
+    r = bist_sixstep_case( "ZC 400 eHz",                SIXSTEP_MODE_ZC,        true,   400.0,  400.0,  0.0, SIXSTEP_BLANK );
+    assert( r.locked && (r.err_max < 4.0) );
+
+    fprintf( stdout, "Finished Six-step BIST\n" );
+}
@@ -0,0 +1,326 @@
+/*
+* Copyright 2021-2023 cod3b453
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its contributors
+*    may be used to endorse or promote products derived from this software
+*    without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "MESCspeedloop.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define BIST_SPEEDLOOP_PI    3.14159265f
+#define BIST_SPEEDLOOP_PWM   20000.0f // Hz, fastloop
+#define BIST_SPEEDLOOP_SLOW  200      // Fastloop cycles per 100Hz slowloop
+#define BIST_SPEEDLOOP_I_MAX 20.0f    // A
+
+/*
+Host motor simulator
+
+A rigid rotor with viscous friction and a load torque behind the current loop,
+taken as first order at the default current bandwidth (0.15*PWM_FREQUENCY
+rad/s), measured through a 1ms lag standing in for the PLL. Everything steps
+at the PWM frequency.
+*/
+struct BISTSpeedPlant
+{
+    float Iq;       // A, current loop output
+    float omega;    // rad/s mechanical
+    float eHz;      // Measured
+    float T_load;   // Nm
+};
+
+typedef struct BISTSpeedPlant BISTSpeedPlant;
+
+static float const bist_speedloop_J   = 2.0e-4f; // kg m^2
+static float const bist_speedloop_B   = 1.0e-4f; // Nm/(rad/s)
+static float const bist_speedloop_pp  = 7.0f;
+static float const bist_speedloop_psi = 0.005f;  // Wb
+static float const bist_speedloop_tau = 0.001f;  // s, speed measurement lag
+
+static float bist_speedloop_Kt( void )
+{
+    return 1.5f * bist_speedloop_pp * bist_speedloop_psi;
+}
+
+// A per eHz/s, as RunSpeedControl derives it from the inertia
+static float bist_speedloop_Kacc( void )
+{
+    return (bist_speedloop_J * 2.0f * BIST_SPEEDLOOP_PI) / (bist_speedloop_pp * bist_speedloop_Kt());
+}
+
+static void bist_speedloop_plant( BISTSpeedPlant * const p, float const Iq_req )
+{
+    float const T  = 1.0f / BIST_SPEEDLOOP_PWM;
+    float const bw = 0.15f * BIST_SPEEDLOOP_PWM;
+
+    p->Iq    = p->Iq + ((Iq_req - p->Iq) * (1.0f - expf( -bw * T )));
+    p->omega = p->omega + ((((bist_speedloop_Kt() * p->Iq) - (bist_speedloop_B * p->omega) - p->T_load) / bist_speedloop_J) * T);
+
+    float const eHz = (p->omega * bist_speedloop_pp) / (2.0f * BIST_SPEEDLOOP_PI);
+
+    p->eHz = p->eHz + ((eHz - p->eHz) * (T / bist_speedloop_tau));
+}
+
+/*
+RunSpeedControl as it was, every slowloop with the integral clamped.
+*/
+struct BISTSpeedLegacy
+{
+    float kp;
+    float ki;       // Per call
+    float integral;
+};
+
+typedef struct BISTSpeedLegacy BISTSpeedLegacy;
+
+static float bist_speedloop_legacy( BISTSpeedLegacy * const l, float const req, float const eHz )
+{
+    float const I = BIST_SPEEDLOOP_I_MAX;
+    float const P = fminf( fmaxf( (l->kp * (req - eHz)), -I ), I );
+
+    l->integral = fminf( fmaxf( (l->integral + (P * l->ki)), -I ), I );
+
+    return fminf( fmaxf( (l->integral + P), -I ), I );
+}
+
+enum BISTSpeedCtl
+{
+    BIST_SPEED_LEGACY,
+    BIST_SPEED_PI,       // No anti-windup
+    BIST_SPEED_AW,
+    BIST_SPEED_AW_FF,    // Both feedforwards
+};
+
+typedef enum BISTSpeedCtl BISTSpeedCtl;
+
+struct BISTSpeedResult
+{
+    float rise;      // s to 90% of the step, negative without one
+    float overshoot; // eHz, or the excursion either way without a step
+    float settle;    // s to stay within the band
+    float I_peak;    // A
+};
+
+typedef struct BISTSpeedResult BISTSpeedResult;
+
+#define BIST_SPEEDLOOP_BAND 2.0f // eHz
+
+/*
+Run a controller from req0 to req1 at t = 0, applying T_load at t = t_load.
+The result covers whichever event comes last.
+*/
+static BISTSpeedResult bist_speedloop_run( BISTSpeedCtl const ctl, float const req0, float const req1,
+                                           float const T_load, float const t_load, float const t_end )
+{
+    BISTSpeedPlant  p = { 0.0f, 0.0f, 0.0f, 0.0f };
+    BISTSpeedLegacy l = { 0.05f, 0.05f, 0.0f };
+    SPEEDLOOP       sl;
+
+    speedloop_init( &sl );
+    sl.kp          = 0.5f;
+    sl.ki          = 50.0f;
+    sl.aw          = (ctl == BIST_SPEED_PI) ? 0.0f : 1.0f;
+    sl.Kacc        = bist_speedloop_Kacc();
+    sl.use_acc_ff  = (ctl == BIST_SPEED_AW_FF);
+    sl.use_load_ff = (ctl == BIST_SPEED_AW_FF);
+    speedloop_limit( &sl, -BIST_SPEEDLOOP_I_MAX, BIST_SPEEDLOOP_I_MAX, 0.0f );
+
+    // Start at req0 with the friction already carried
+    p.omega = (req0 * 2.0f * BIST_SPEEDLOOP_PI) / bist_speedloop_pp;
+    p.eHz   = req0;
+    p.Iq    = (bist_speedloop_B * p.omega) / bist_speedloop_Kt();
+    l.integral  = p.Iq;
+    sl.integral = p.Iq;
+    speedloop_reset( &sl, req0 );
+    sl.integral = p.Iq;
+    sl.Iq       = p.Iq;
+
+    float const T      = 1.0f / BIST_SPEEDLOOP_PWM;
+    float const t_from = fmaxf( 0.0f, t_load );
+    float const target = req1;
+
+    BISTSpeedResult res = { .rise = -1.0f };
+
+    float    Iq = p.Iq;
+    uint32_t n  = 0;
+
+    for ( float t = -0.01f; t < t_end; t = t + T, ++n )
+    {
+        float const req = (t < 0.0f) ? req0 : req1;
+
+        p.T_load = (t < t_load) ? 0.0f : T_load;
+
+        if (ctl == BIST_SPEED_LEGACY)
+        {
+            if ((n % BIST_SPEEDLOOP_SLOW) == 0)
+            {
+                Iq = bist_speedloop_legacy( &l, req, p.eHz );
+            }
+        }
+        else if (speedloop_tick( &sl ))
+        {
+            Iq = speedloop_run( &sl, req, p.eHz, (float)sl.decimation * T );
+
+            assert( (Iq <= BIST_SPEEDLOOP_I_MAX) && (Iq >= -BIST_SPEEDLOOP_I_MAX) );
+        }
+
+        bist_speedloop_plant( &p, Iq );
+
+        if (t < t_from)
+        {
+            continue;
+        }
+
+        float const error = p.eHz - target;
+
+        if ((res.rise < 0.0f) && (req1 != req0) && (fabsf( error ) <= (0.1f * fabsf( req1 - req0 ))))
+        {
+            res.rise = t;
+        }
+
+        if (fabsf( error ) > BIST_SPEEDLOOP_BAND)
+        {
+            res.settle = t - t_from + T;
+        }
+
+        // With no step, the largest excursion either way
+        float const excursion = (req1 > req0) ? error : ((req1 < req0) ? -error : fabsf( error ));
+
+        res.overshoot = fmaxf( res.overshoot, excursion );
+        res.I_peak    = fmaxf( res.I_peak, fabsf( Iq ) );
+    }
+
+    return res;
+}
+
+static void bist_speedloop_print( char const * const name, BISTSpeedResult const * const res )
+{
+    if (res->rise < 0.0f)
+    {
+        fprintf( stdout, "    %-16s                excursion %6.1f eHz settle %6.3f s peak %5.2f A\n",
+            name, res->overshoot, res->settle, res->I_peak );
+        return;
+    }
+
+    fprintf( stdout, "    %-16s rise %6.3f s overshoot %6.1f eHz settle %6.3f s peak %5.2f A\n",
+        name, res->rise, res->overshoot, res->settle, res->I_peak );
+}
+
+void bist_speedloop( void )
+{
+    fprintf( stdout, "Starting Speed loop BIST\n" );
+
+    // Decimation
+    SPEEDLOOP sl;
+
+    speedloop_init( &sl );
+    sl.decimation = 4;
+
+    uint32_t fired = 0;
+
+    for ( uint32_t i = 0; i < 40; ++i )
+    {
+        fired = fired + (speedloop_tick( &sl ) ? 1 : 0);
+    }
+
+    assert( fired == 10 );
+
+    // The limit chain only tightens the side it clamped
+    sl.Iq_chain = 15.0f;
+    speedloop_limit( &sl, -20.0f, 20.0f, 12.0f );
+    assert( (sl.I_max == 12.0f) && (sl.I_min == -20.0f) );
+    speedloop_limit( &sl, -20.0f, 20.0f, 15.0f );
+    assert( sl.I_max == 20.0f );
+    sl.Iq_chain = -15.0f;
+    speedloop_limit( &sl, -10.0f, 20.0f, -8.0f );
+    assert( (sl.I_max == 20.0f) && (sl.I_min == -8.0f) );
+
+    // Back calculation holds the integral at the limit
+    speedloop_init( &sl );
+    speedloop_limit( &sl, -5.0f, 5.0f, 0.0f );
+
+    for ( uint32_t i = 0; i < 1000; ++i )
+    {
+        speedloop_run( &sl, 100.0f, 0.0f, 0.001f );
+    }
+
+    assert( sl.Iq == 5.0f );
+    assert( sl.integral < 5.0f );
+
+    // Launch, 0 to 300 eHz into the current limit
+    fprintf( stdout, "  Launch 0 to 300 eHz, %.0f A limit\n", (double)BIST_SPEEDLOOP_I_MAX );
+
+    BISTSpeedResult const launch_legacy = bist_speedloop_run( BIST_SPEED_LEGACY, 0.0f, 300.0f, 0.0f, 0.0f, 2.0f );
+    BISTSpeedResult const launch_pi     = bist_speedloop_run( BIST_SPEED_PI,     0.0f, 300.0f, 0.0f, 0.0f, 2.0f );
+    BISTSpeedResult const launch_aw     = bist_speedloop_run( BIST_SPEED_AW,     0.0f, 300.0f, 0.0f, 0.0f, 2.0f );
+    BISTSpeedResult const launch_ff     = bist_speedloop_run( BIST_SPEED_AW_FF,  0.0f, 300.0f, 0.0f, 0.0f, 2.0f );
+
+    bist_speedloop_print( "100Hz PI",         &launch_legacy );
+    bist_speedloop_print( "2kHz PI",          &launch_pi     );
+    bist_speedloop_print( "2kHz PI+AW",       &launch_aw     );
+    bist_speedloop_print( "2kHz PI+AW+FF",    &launch_ff     );
+
+    assert( launch_aw.overshoot < launch_pi.overshoot );
+    assert( launch_aw.overshoot < launch_legacy.overshoot );
+    assert( launch_aw.settle < launch_legacy.settle );
+    assert( launch_ff.overshoot <= launch_aw.overshoot );
+
+    // Small step, inside the current limit
+    fprintf( stdout, "  Step 200 to 210 eHz\n" );
+
+    BISTSpeedResult const step_legacy = bist_speedloop_run( BIST_SPEED_LEGACY, 200.0f, 210.0f, 0.0f, 0.0f, 2.0f );
+    BISTSpeedResult const step_aw     = bist_speedloop_run( BIST_SPEED_AW,     200.0f, 210.0f, 0.0f, 0.0f, 2.0f );
+
+    bist_speedloop_print( "100Hz PI",   &step_legacy );
+    bist_speedloop_print( "2kHz PI+AW", &step_aw     );
+
+    assert( step_aw.rise < step_legacy.rise );
+    assert( step_aw.settle < step_legacy.settle );
+
+    // Disturbance, a load step of half the current limit at 200 eHz
+    float const T_load = 0.5f * BIST_SPEEDLOOP_I_MAX * bist_speedloop_Kt();
+
+    fprintf( stdout, "  Load step %.3f Nm at 200 eHz\n", (double)T_load );
+
+    BISTSpeedResult const load_legacy = bist_speedloop_run( BIST_SPEED_LEGACY, 200.0f, 200.0f, T_load, 0.1f, 2.0f );
+    BISTSpeedResult const load_aw     = bist_speedloop_run( BIST_SPEED_AW,     200.0f, 200.0f, T_load, 0.1f, 2.0f );
+    BISTSpeedResult const load_ff     = bist_speedloop_run( BIST_SPEED_AW_FF,  200.0f, 200.0f, T_load, 0.1f, 2.0f );
+
+    bist_speedloop_print( "100Hz PI",      &load_legacy );
+    bist_speedloop_print( "2kHz PI+AW",    &load_aw     );
+    bist_speedloop_print( "2kHz PI+AW+FF", &load_ff     );
+
+    assert( load_aw.overshoot < load_legacy.overshoot );
+    assert( load_aw.settle < load_legacy.settle );
+    assert( load_ff.overshoot <= load_aw.overshoot );
+    assert( load_ff.settle <= load_aw.settle );
+
+    fprintf( stdout, "Finished Speed loop BIST\n" );
+}
@@ -0,0 +1,250 @@
+/*
+* Copyright 2021-2023 cod3b453
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its contributors
+*    may be used to endorse or promote products derived from this software
+*    without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "MESCthermal.h"
+
+#include "conversions.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define BIST_THERMAL_T    0.01f  // s, slow loop period
+#define BIST_THERMAL_TEND 1200.0f
+
+/*
+Synthetic thermal plant
+
+The motor is three masses (winding, stator, housing) and the FETs two, none
+matching the two node model defaults, with the NTCs lagging the node they are
+fixed to. Ambient sits 5 K above the board reading the model is seeded from.
+*/
+struct BISTThermalPlant
+{
+    // Motor, K
+    float Tw;
+    float Ts;
+    float Th;
+    float Tw_sensor;
+
+    // FETs, K
+    float Tj;
+    float Tc;
+    float Tc_sensor;
+
+    float T_amb;
+};
+
+typedef struct BISTThermalPlant BISTThermalPlant;
+
+static float const bist_thermal_R     = 0.05f;   // Ohm phase at 25C
+static float const bist_thermal_Rds   = 0.004f;  // Ohm at 25C
+static float const bist_thermal_t_sw  = 120e-9f; // s
+static float const bist_thermal_Vbus  = 60.0f;
+static float const bist_thermal_f_pwm = 20000.0f;
+static float const bist_thermal_Imax  = 120.0f;
+
+static void bist_thermal_plant_step( BISTThermalPlant * const p, float const I, float const T )
+{
+    float const P_motor = 1.5f * I * I * bist_thermal_R * (1.0f + (THERMAL_ALPHA_CU * (p->Tw - THERMAL_T_REF)));
+    float const P_fet   = (1.5f * I * I * bist_thermal_Rds * (1.0f + (THERMAL_ALPHA_RDS * (p->Tj - THERMAL_T_REF))))
+                        + (3.0f * 0.63662f * bist_thermal_Vbus * bist_thermal_t_sw * bist_thermal_f_pwm * I);
+
+    float const q_ws = (p->Tw - p->Ts) / 0.35f;
+    float const q_sh = (p->Ts - p->Th) / 0.1f;
+    float const q_ha = (p->Th - p->T_amb) / 0.55f;
+
+    p->Tw = p->Tw + ((T * (P_motor - q_ws)) / 180.0f);
+    p->Ts = p->Ts + ((T * (q_ws - q_sh)) / 1500.0f);
+    p->Th = p->Th + ((T * (q_sh - q_ha)) / 800.0f);
+    p->Tw_sensor = p->Tw_sensor + ((T / 25.0f) * (p->Tw - p->Tw_sensor));
+
+    float const q_jc = (p->Tj - p->Tc) / 0.25f;
+    float const q_ca = (p->Tc - p->T_amb) / 0.9f;
+
+    p->Tj = p->Tj + ((T * (P_fet - q_jc)) / 4.0f);
+    p->Tc = p->Tc + ((T * (q_jc - q_ca)) / 120.0f);
+    p->Tc_sensor = p->Tc_sensor + ((T / 6.0f) * (p->Tc - p->Tc_sensor));
+}
+
+// The sensor taper in ThrottleTemperature
+static float bist_thermal_legacy( float const T, TEMP const * const temp )
+{
+    float const k = 1.0f - ((T - temp->limit.Thot) / (temp->limit.Tmax - temp->limit.Thot));
+
+    return fminf( fmaxf( k, 0.0f ), 1.0f );
+}
+
+struct BISTThermalResult
+{
+    float Tw_max;     // K, true winding peak
+    float Tj_max;     // K, true junction peak
+    float Ah;         // Charge delivered, a measure of the torque allowed
+    float Tw_err;     // K RMS, winding model (or sensor) error
+    float Tj_err;     // K RMS, junction model (or sensor) error
+};
+
+typedef struct BISTThermalResult BISTThermalResult;
+
+/*
+Full current for 60 s then 30% for 60 s, repeated, limited by the sensors
+alone or also by the model prediction.
+*/
+static BISTThermalResult bist_thermal_run( bool const predictive, TEMP const * const motor_temp, TEMP const * const fet_temp )
+{
+    BISTThermalPlant p;
+    THERMAL th;
+
+    float const T_board = CVT_CELSIUS_TO_KELVIN_F( 25.0f );
+
+    p.T_amb = T_board + 5.0f;
+    p.Tw = p.Ts = p.Th = p.Tw_sensor = T_board;
+    p.Tj = p.Tc = p.Tc_sensor = T_board;
+
+    thermal_init( &th );
+    th.Rds_on = 0.0035f; // From the datasheet, a little under the real part
+
+    BISTThermalResult res = { .Tw_max = 0.0f };
+
+    float I = 0.0f;
+    uint32_t n = 0;
+
+    for ( float t = 0.0f; (t < BIST_THERMAL_TEND); t = t + BIST_THERMAL_T )
+    {
+        thermal_update( &th, 0.0f, I, bist_thermal_R, bist_thermal_Vbus, bist_thermal_f_pwm, p.Tw_sensor, p.Tc_sensor, BIST_THERMAL_T );
+
+        float k = fminf( bist_thermal_legacy( p.Tw_sensor, motor_temp ), bist_thermal_legacy( p.Tc_sensor, fet_temp ) );
+
+        if (predictive)
+        {
+            k = fminf( k, thermal_rollback( &th, bist_thermal_Imax, motor_temp, fet_temp ) );
+        }
+
+        float const demand = (fmodf( t, 120.0f ) < 60.0f) ? 1.0f : 0.3f;
+
+        I = fminf( demand, k ) * bist_thermal_Imax;
+
+        bist_thermal_plant_step( &p, I, BIST_THERMAL_T );
+
+        res.Tw_max = fmaxf( res.Tw_max, p.Tw );
+        res.Tj_max = fmaxf( res.Tj_max, p.Tj );
+
+        res.Ah = res.Ah + ((I * BIST_THERMAL_T) / 3600.0f);
+
+        float const ew = (predictive ? th.motor.T_fast : p.Tw_sensor) - p.Tw;
+        float const ej = (predictive ? th.fet.T_fast   : p.Tc_sensor) - p.Tj;
+
+        res.Tw_err = res.Tw_err + (ew * ew);
+        res.Tj_err = res.Tj_err + (ej * ej);
+        ++n;
+    }
+
+    res.Tw_err = sqrtf( res.Tw_err / (float)n );
+    res.Tj_err = sqrtf( res.Tj_err / (float)n );
+
+    return res;
+}
+
+static void bist_thermal_print( char const * const name, BISTThermalResult const * const res )
+{
+    fprintf( stdout, "    %-10s winding %6.1f C junction %6.1f C %6.2f Ah error winding %5.1f K junction %5.1f K\n",
+        name, CVT_KELVIN_TO_CELSIUS_F( res->Tw_max ), CVT_KELVIN_TO_CELSIUS_F( res->Tj_max ), res->Ah, res->Tw_err, res->Tj_err );
+}
+
+void bist_thermal( void )
+{
+    fprintf( stdout, "Starting Thermal BIST\n" );
+
+    TEMP motor_temp;
+    TEMP fet_temp;
+
+    motor_temp.limit.Tmin = CVT_CELSIUS_TO_KELVIN_F( -15.0f );
+    motor_temp.limit.Thot = CVT_CELSIUS_TO_KELVIN_F( 100.0f );
+    motor_temp.limit.Tmax = CVT_CELSIUS_TO_KELVIN_F( 120.0f );
+
+    fet_temp.limit.Tmin = CVT_CELSIUS_TO_KELVIN_F( -15.0f );
+    fet_temp.limit.Thot = CVT_CELSIUS_TO_KELVIN_F(  80.0f );
+    fet_temp.limit.Tmax = CVT_CELSIUS_TO_KELVIN_F( 100.0f );
+
+    TEMP cool;
+
+    cool.limit.Tmin = CVT_CELSIUS_TO_KELVIN_F( -15.0f );
+    cool.limit.Thot = CVT_CELSIUS_TO_KELVIN_F( 300.0f );
+    cool.limit.Tmax = CVT_CELSIUS_TO_KELVIN_F( 320.0f );
+
+    // Winding bound, the FET limits out of the way
+    fprintf( stdout, "  Motor\n" );
+
+    BISTThermalResult const m_legacy = bist_thermal_run( false, &motor_temp, &cool );
+    BISTThermalResult const m_model  = bist_thermal_run( true,  &motor_temp, &cool );
+
+    bist_thermal_print( "sensors",    &m_legacy );
+    bist_thermal_print( "predictive", &m_model  );
+
+    // The lagging sensor lets the winding run well past Tmax
+    assert( m_legacy.Tw_max > (motor_temp.limit.Tmax + 10.0f) );
+
+    // The prediction holds it near Tmax despite a 15% error in the winding parameters
+    assert( m_model.Tw_max < (motor_temp.limit.Tmax + 5.0f) );
+
+    // The model tracks the winding better than the sensor
+    assert( m_model.Tw_err < (0.5f * m_legacy.Tw_err) );
+
+    // Without giving up current the sensor allowed
+    assert( m_model.Ah > (0.9f * m_legacy.Ah) );
+
+    // Junction bound
+    fprintf( stdout, "  FETs\n" );
+
+    BISTThermalResult const f_legacy = bist_thermal_run( false, &cool, &fet_temp );
+    BISTThermalResult const f_model  = bist_thermal_run( true,  &cool, &fet_temp );
+
+    bist_thermal_print( "sensors",    &f_legacy );
+    bist_thermal_print( "predictive", &f_model  );
+
+    assert( f_legacy.Tj_max > (fet_temp.limit.Tmax + 10.0f) );
+    assert( f_model.Tj_max  < (fet_temp.limit.Tmax + 5.0f) );
+    assert( f_model.Tj_err  < (0.7f * f_legacy.Tj_err) );
+    assert( f_model.Ah      > (0.9f * f_legacy.Ah) );
+
+    // Limit edges
+    THERMAL th;
+
+    thermal_init( &th );
+    thermal_update( &th, 0.0f, 0.0f, bist_thermal_R, bist_thermal_Vbus, bist_thermal_f_pwm, 0.0f, CVT_CELSIUS_TO_KELVIN_F( 25.0f ), BIST_THERMAL_T );
+    assert( thermal_rollback( &th, 10.0f, &motor_temp, &fet_temp ) == 1.0f );
+
+    thermal_init( &th );
+    thermal_update( &th, 0.0f, 0.0f, bist_thermal_R, bist_thermal_Vbus, bist_thermal_f_pwm, 0.0f, fet_temp.limit.Tmax, BIST_THERMAL_T );
+    assert( thermal_rollback( &th, 10.0f, &motor_temp, &fet_temp ) == 0.0f );
+
+    fprintf( stdout, "Finished Thermal BIST\n" );
+}
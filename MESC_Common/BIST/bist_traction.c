@@ -0,0 +1,458 @@
+/*
+* Copyright 2021-2023 cod3b453
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its contributors
+*    may be used to endorse or promote products derived from this software
+*    without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "MESCimu.h"
+#include "MESCtraction.h"
+#include "MESCvehicle.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define BIST_TC_PI   3.14159265f
+#define BIST_TC_DEG  (BIST_TC_PI / 180.0f)
+#define BIST_TC_G    9.80665f
+#define BIST_TC_DT   0.0001f // s, dynamics step, short for the stiff tyre at low speed
+#define BIST_TC_T    0.01f   // s, slowloop
+#define BIST_TC_ODR  500.0f  // Hz, IMU
+#define BIST_TC_START 1.0f   // s standing still before the throttle opens
+
+#define BIST_TC_I_MAX 150.0f // A, par_i_max
+#define BIST_TC_KT    1.7f   // Nm/A at the wheel, hub motor
+#define BIST_TC_PP    15.0f  // Pole pairs
+#define BIST_TC_SLIP_PEAK 0.12f // Just past the peak of the tyre curve
+
+/*
+Rear wheel drive bike: point mass at a ahead of and h above the rear contact,
+rigid wheel on a Pacejka style tyre. On the ground the rear takes the load
+transfer; once that lifts the front, the frame pitches about the rear contact.
+*/
+struct BISTTcBike
+{
+    float m;        // kg
+    float L;        // m, wheelbase
+    float a;        // m
+    float h;        // m
+    float r;        // m, wheel radius
+    float J;        // kg m^2, wheel and rotor
+    float mu;       // Peak friction
+
+    float v;        // m/s
+    float w;        // rad/s, wheel
+    float pitch;    // rad
+    float pitch_rate;
+    float ax;       // m/s^2
+    float slip;
+};
+
+typedef struct BISTTcBike BISTTcBike;
+
+static void bist_tc_bike_init( BISTTcBike * const b, float const mu )
+{
+    memset( b, 0, sizeof(*b) );
+    b->m = 100.0f;
+    b->L = 1.2f;
+    b->a = 0.5f;
+    b->h = 0.7f;
+    b->r = 0.3f;
+    b->J = 1.0f;
+    b->mu = mu;
+}
+
+static float bist_tc_mu( float const mu, float const slip )
+{
+    return mu * sinf( 1.9f * atanf( 10.0f * slip ) );
+}
+
+static void bist_tc_bike_step( BISTTcBike * const b, float const torque )
+{
+    float const vw = b->w * b->r;
+
+    b->slip = (vw - b->v) / fmaxf( fmaxf( fabsf( vw ), fabsf( b->v ) ), 0.5f );
+
+    float const mu = bist_tc_mu( b->mu, b->slip );
+    float const mg = b->m * BIST_TC_G;
+    float Nr = mg;
+
+    if (b->pitch <= 0.0f)
+    {
+        // Load transfer with the front down, Nr = N0 + Fx h / L
+        float const N0 = mg * (b->L - b->a) / b->L;
+        float const d = 1.0f - (mu * b->h / b->L);
+
+        Nr = (d > 0.0f) ? fminf( N0 / d, mg ) : mg;
+    }
+
+    float const Fx = mu * Nr;
+
+    b->ax = Fx / b->m;
+    b->w = b->w + ((torque - (Fx * b->r)) / b->J * BIST_TC_DT);
+    b->v = b->v + (b->ax * BIST_TC_DT);
+
+    // Pitch about the rear contact: thrust lifts through the height of the mass, gravity pulls down through its reach
+    float const c = cosf( b->pitch );
+    float const s = sinf( b->pitch );
+    float const xc = (b->a * c) - (b->h * s);
+    float const zc = (b->a * s) + (b->h * c);
+    float const Ip = b->m * ((b->a * b->a) + (b->h * b->h));
+    float const alpha = ((b->m * b->ax * zc) - (mg * xc)) / Ip;
+
+    if ((b->pitch > 0.0f) || (alpha > 0.0f))
+    {
+        b->pitch_rate = b->pitch_rate + (alpha * BIST_TC_DT);
+        b->pitch = b->pitch + (b->pitch_rate * BIST_TC_DT);
+    }
+
+    if (b->pitch < 0.0f)
+    {
+        b->pitch = 0.0f; // Front lands
+        b->pitch_rate = 0.0f;
+    }
+}
+
+static uint32_t bist_tc_noise_state = 12345;
+
+static float bist_tc_noise( float const amp )
+{
+    bist_tc_noise_state = (bist_tc_noise_state * 1664525u) + 1013904223u;
+
+    return amp * (((float)(bist_tc_noise_state >> 8) / 8388608.0f) - 1.0f);
+}
+
+static void bist_tc_put16( uint8_t * const p, float const x )
+{
+    float const r = fminf( fmaxf( roundf( x ), -32768.0f ), 32767.0f );
+    int16_t const v = (int16_t)r;
+
+    p[0] = (uint8_t)((uint16_t)v >> 8);
+    p[1] = (uint8_t)((uint16_t)v & 0xFF);
+}
+
+/*
+One MPU6050 FIFO frame of what the frame mounted IMU sees, with vibration.
+*/
+static void bist_tc_frame( BISTTcBike const * const b, uint8_t * const f, float const vib )
+{
+    float const c = cosf( b->pitch );
+    float const s = sinf( b->pitch );
+
+    memset( f, 0, IMU_FRAME );
+    bist_tc_put16( &f[0], 4096.0f * ((((b->ax * c) - (BIST_TC_G * s)) / BIST_TC_G) + bist_tc_noise( vib )) );
+    bist_tc_put16( &f[2], 4096.0f * bist_tc_noise( vib ) );
+    bist_tc_put16( &f[4], 4096.0f * ((((b->ax * s) + (BIST_TC_G * c)) / BIST_TC_G) + bist_tc_noise( vib )) );
+    bist_tc_put16( &f[8], 32.8f * b->pitch_rate / BIST_TC_DEG );
+}
+
+static int bist_tc_bus_read( void * ctx, uint8_t reg, uint8_t * buf, uint16_t len )
+{
+    (void)ctx; (void)reg; (void)buf; (void)len;
+
+    return -1;
+}
+
+static int bist_tc_bus_write( void * ctx, uint8_t reg, uint8_t val )
+{
+    (void)ctx; (void)reg; (void)val;
+
+    return 0;
+}
+
+/*
+Surface along the run: friction against time.
+*/
+typedef float (*BISTTcSurface)( float const t );
+
+struct BISTTcRun
+{
+    float v_end;      // m/s
+    float pitch_max;  // rad
+    float slip_max;   // After the first 0.3s
+    float slip_mean;  // After the first 0.3s
+    float scale_min;
+    float latency;    // s from the true slip passing the tyre peak to the first cut, -1 if it never did
+};
+
+typedef struct BISTTcRun BISTTcRun;
+
+/*
+Throttle into the vehicle state machine, its request through traction
+control into the q current, the current as torque into the bike, and the
+bike back through the IMU FIFO and filter into traction control.
+*/
+static BISTTcRun bist_tc_run( BISTTcSurface const surface, float const throttle, bool const tc_on,
+                              float const duration, float const vib )
+{
+    BISTTcRun res = { 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, -1.0f };
+    BISTTcBike b;
+    VEHICLE veh;
+    TRACTION tc;
+    IMU imu;
+    IMUBus const bus = { bist_tc_bus_read, bist_tc_bus_write, NULL };
+    uint8_t frames[IMU_RING * IMU_FRAME];
+    uint32_t nframes = 0;
+
+    bist_tc_bike_init( &b, surface( 0.0f ) );
+    vehicle_init( &veh );
+    veh.mode = 2; // Sport, the full request
+    traction_init( &tc );
+    tc.m_per_eHz = 2.0f * BIST_TC_PI * b.r / BIST_TC_PP;
+    imu_init( &imu, &bus );
+    imu.odr = BIST_TC_ODR;
+
+    // Unpark with the throttle closed
+    vehicle_update( &veh, 0, 0.0f, 0.0f, false, BIST_TC_T );
+    assert( veh.state == VEH_STATE_DRIVE );
+
+    uint32_t const steps = (uint32_t)lroundf( duration / BIST_TC_DT );
+    uint32_t const per_frame = (uint32_t)lroundf( 1.0f / (BIST_TC_ODR * BIST_TC_DT) );
+    uint32_t const per_tick = (uint32_t)lroundf( BIST_TC_T / BIST_TC_DT );
+    float Iq = 0.0f;
+    float slip_sum = 0.0f;
+    uint32_t slip_n = 0;
+    float t_slip = -1.0f;
+
+    for (uint32_t i = 1; i <= steps; i++)
+    {
+        float const t = (float)i * BIST_TC_DT;
+
+        b.mu = surface( t );
+        bist_tc_bike_step( &b, BIST_TC_KT * Iq );
+
+        if ((i % per_frame) == 0)
+        {
+            bist_tc_frame( &b, &frames[nframes * IMU_FRAME], vib );
+            nframes++;
+        }
+
+        res.pitch_max = fmaxf( res.pitch_max, b.pitch );
+
+        if (t > (BIST_TC_START + 0.3f))
+        {
+            res.slip_max = fmaxf( res.slip_max, b.slip );
+            slip_sum = slip_sum + b.slip;
+            slip_n++;
+        }
+
+        if ((t_slip < 0.0f) && (b.slip > BIST_TC_SLIP_PEAK) && (t > (BIST_TC_START + 0.3f)))
+        {
+            t_slip = t;
+        }
+
+        if ((i % per_tick) != 0)
+        {
+            continue;
+        }
+
+        // Slowloop: the burst read at this tick, the filter, the app
+        uint32_t const now = (uint32_t)lroundf( t * 1.0e6f );
+
+        imu_parse( &imu, frames, nframes, now );
+        nframes = 0;
+        imu_process( &imu );
+
+        float const eHz = b.w * BIST_TC_PP / (2.0f * BIST_TC_PI);
+
+        vehicle_update( &veh, 0, (t > BIST_TC_START) ? throttle : 0.0f, eHz, false, BIST_TC_T );
+
+        float const req = vehicle_request( &veh );
+        float scale = 1.0f;
+
+        if (tc_on)
+        {
+            scale = traction_run( &tc, eHz, traction_imu_accel( imu.last.acc, imu.att.pitch ), imu.att.pitch,
+                                  imu.last.gyr[1], BIST_TC_T );
+            imu.a_fwd = traction_vehicle_accel( &tc );
+        }
+
+        Iq = (req > 0.0f) ? (req * BIST_TC_I_MAX * scale) : 0.0f;
+
+        res.scale_min = fminf( res.scale_min, scale );
+
+        if ((t_slip >= 0.0f) && (res.latency < 0.0f) && (scale < 0.9f))
+        {
+            res.latency = t - t_slip;
+        }
+    }
+
+    res.v_end = b.v;
+    res.slip_mean = (slip_n > 0) ? (slip_sum / (float)slip_n) : 0.0f;
+
+    return res;
+}
+
+static float bist_tc_dry( float const t )
+{
+    (void)t;
+
+    return 1.0f;
+}
+
+static float bist_tc_wet( float const t )
+{
+    (void)t;
+
+    return 0.3f;
+}
+
+static float bist_tc_ice( float const t )
+{
+    // A patch of ice on a dry road
+    return ((t > 2.0f) && (t < 2.5f)) ? 0.1f : 1.0f;
+}
+
+static void bist_tc_print( char const * const name, BISTTcRun const * const r )
+{
+    fprintf( stdout, "    %-22s %5.1f m/s, pitch %5.1f deg, slip max %4.2f mean %4.2f, factor min %4.2f",
+             name, (double)r->v_end, (double)(r->pitch_max / BIST_TC_DEG), (double)r->slip_max, (double)r->slip_mean,
+             (double)r->scale_min );
+
+    if (r->latency >= 0.0f)
+    {
+        fprintf( stdout, ", cut %.0f ms after the slip", (double)(r->latency * 1000.0f) );
+    }
+
+    fprintf( stdout, "\n" );
+}
+
+static void bist_tc_units( void )
+{
+    TRACTION tc;
+
+    // Level, the specific force is the acceleration; pitched and still, it is only gravity
+    float const level[3] = { 0.3f, 0.0f, 1.0f };
+    float const pitched[3] = { -sinf( 0.3f ), 0.0f, cosf( 0.3f ) };
+
+    assert( fabsf( traction_imu_accel( level, 0.0f ) - (0.3f * BIST_TC_G) ) < 1.0e-4f );
+    assert( fabsf( traction_imu_accel( pitched, 0.3f ) ) < 1.0e-4f );
+
+    traction_init( &tc );
+    tc.m_per_eHz = 0.1f;
+
+    // Wheel and vehicle together
+    float eHz = 0.0f;
+
+    for (uint32_t i = 0; i < 100; i++)
+    {
+        eHz = eHz + (20.0f * BIST_TC_T);
+        assert( traction_run( &tc, eHz, 2.0f, 0.0f, 0.0f, BIST_TC_T ) == 1.0f );
+    }
+
+    // The wheel spins up at 10 m/s^2 more than the vehicle; cut within two ticks, at most halved per tick
+    float prev = 1.0f;
+    uint32_t first = 0;
+
+    for (uint32_t i = 1; i <= 10; i++)
+    {
+        eHz = eHz + (120.0f * BIST_TC_T);
+
+        float const scale = traction_run( &tc, eHz, 2.0f, 0.0f, 0.0f, BIST_TC_T );
+
+        assert( scale >= (0.5f * prev) - 1.0e-6f );
+
+        if ((first == 0) && (scale < 1.0f))
+        {
+            first = i;
+        }
+
+        prev = scale;
+    }
+
+    assert( (first > 0) && (first <= 2) );
+    assert( tc.slipping );
+
+    // Grip again; back to full at recover per s
+    traction_reset( &tc, eHz );
+    tc.scale = 0.2f;
+
+    uint32_t n = 0;
+
+    while (traction_run( &tc, eHz, 0.0f, 0.0f, 0.0f, BIST_TC_T ) < 1.0f)
+    {
+        n++;
+    }
+
+    // 40 ticks at 0.02, give or take rounding on the last
+    assert( (n >= 39) && (n <= 40) );
+
+    // Pitch rising fast towards the limit is cut before it gets there
+    traction_reset( &tc, eHz );
+    assert( traction_run( &tc, eHz, 0.0f, 0.15f, 0.8f, BIST_TC_T ) < 1.0f );
+    assert( tc.wheelie );
+
+    fprintf( stdout, "    Cut within %u tick of a spin, recovers in %.2f s\n", (unsigned)first, (double)((float)(n + 1) * BIST_TC_T) );
+}
+
+void bist_traction( void )
+{
+    fprintf( stdout, "Starting Traction BIST\n" );
+
+    bist_tc_units();
+
+    float const duration = BIST_TC_START + 3.0f;
+    BISTTcRun off;
+    BISTTcRun on;
+
+    // Dry, full throttle: without it the bike loops
+    off = bist_tc_run( bist_tc_dry, 1.0f, false, duration, 0.05f );
+    on = bist_tc_run( bist_tc_dry, 1.0f, true, duration, 0.05f );
+    bist_tc_print( "Dry, off", &off );
+    bist_tc_print( "Dry, on", &on );
+    assert( off.pitch_max > (90.0f * BIST_TC_DEG) );
+    assert( on.pitch_max < (0.26f + (2.0f * BIST_TC_DEG)) );
+    assert( on.v_end > 8.0f );
+
+    // Wet, full throttle: without it the wheel spins and drives poorly
+    off = bist_tc_run( bist_tc_wet, 1.0f, false, duration, 0.05f );
+    on = bist_tc_run( bist_tc_wet, 1.0f, true, duration, 0.05f );
+    bist_tc_print( "Wet, off", &off );
+    bist_tc_print( "Wet, on", &on );
+    assert( off.slip_mean > 0.8f );
+    assert( on.slip_mean < 0.15f );
+    assert( on.v_end > (1.5f * off.v_end) );
+
+    // Ice patch at part throttle: the cut lands within two slowloop ticks
+    off = bist_tc_run( bist_tc_ice, 0.5f, false, duration, 0.05f );
+    on = bist_tc_run( bist_tc_ice, 0.5f, true, duration, 0.05f );
+    bist_tc_print( "Ice patch, off", &off );
+    bist_tc_print( "Ice patch, on", &on );
+    assert( off.slip_max > 0.5f );
+    assert( on.slip_max < 0.3f );
+    assert( (on.latency >= 0.0f) && (on.latency <= (2.0f * BIST_TC_T)) );
+    assert( on.v_end > off.v_end );
+
+    // Dry, part throttle, with vibration: left alone
+    on = bist_tc_run( bist_tc_dry, 0.4f, true, duration, 0.05f );
+    bist_tc_print( "Dry, part throttle, on", &on );
+    assert( on.scale_min == 1.0f );
+
+    fprintf( stdout, "Finished Traction BIST\n" );
+}
@@ -0,0 +1,329 @@
+/*
+* Copyright 2021-2023 cod3b453
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its contributors
+*    may be used to endorse or promote products derived from this software
+*    without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "MESCtraj.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define BIST_TRAJ_PI    3.14159265f
+#define BIST_TRAJ_DT    1.0e-4f // s, profile check sample
+#define BIST_TRAJ_LOOP  0.01f   // s, slow loop
+#define BIST_TRAJ_SUB   100     // Plant steps per loop
+#define BIST_TRAJ_TEND  4.0f    // s
+
+struct BISTTrajCase
+{
+    uint32_t from;
+    int32_t  move;  // counts
+    float    v_max;
+    float    a_max;
+    float    j_max;
+};
+
+typedef struct BISTTrajCase BISTTrajCase;
+
+static BISTTrajCase const bist_traj_case[] =
+{
+    { 0,                   655360,  50.0f,  500.0f, 10000.0f }, // Cruise
+    { 1000,               -655360,  50.0f,  500.0f, 10000.0f }, // Backwards
+    { UINT32_C(0xFFFF0000), 131072, 50.0f,  500.0f, 10000.0f }, // Across the wrap, no cruise
+    { 0,                     4000,  50.0f,  500.0f, 10000.0f }, // Acceleration limit not reached
+    { 0,                  6553600, 100.0f, 2000.0f,  5000.0f }, // Speed reached before the acceleration limit
+    { 0,                        1,  50.0f,  500.0f, 10000.0f }, // One count
+};
+
+/*
+Sample the plan finely and check it against the limits, for continuity and
+that it lands on the target at rest.
+*/
+static void bist_traj_profile( BISTTrajCase const * const c )
+{
+    TRAJ tr;
+
+    traj_init( &tr, c->from );
+    tr.v_max = c->v_max;
+    tr.a_max = c->a_max;
+    tr.j_max = c->j_max;
+
+    uint32_t const target = c->from + (uint32_t)c->move;
+
+    traj_move( &tr, target );
+
+    float const duration = tr.duration;
+    float const dir      = (c->move < 0) ? -1.0f : 1.0f;
+
+    float v_peak = 0.0f;
+    float a_peak = 0.0f;
+    float j_peak = 0.0f;
+    float dp_err = 0.0f;
+    bool  back   = false;
+
+    uint32_t p_last = tr.p_ref;
+    float    a_last = 0.0f;
+    float    v_last = 0.0f;
+
+    for ( float t = 0.0f; (t < (duration + (10.0f * BIST_TRAJ_DT))); t = t + BIST_TRAJ_DT )
+    {
+        traj_sample( &tr, BIST_TRAJ_DT );
+
+        float const dp = (float)(int32_t)(tr.p_ref - p_last);
+
+        v_peak = fmaxf( v_peak, fabsf( tr.v_ref ) );
+        a_peak = fmaxf( a_peak, fabsf( tr.a_ref ) );
+        j_peak = fmaxf( j_peak, (fabsf( tr.a_ref - a_last ) / BIST_TRAJ_DT) );
+
+        // Position steps match the mean speed over the step
+        dp_err = fmaxf( dp_err, fabsf( dp - (0.5f * (tr.v_ref + v_last) * TRAJ_COUNTS * BIST_TRAJ_DT) ) );
+
+        back = back || ((dir * dp) < 0.0f);
+
+        p_last = tr.p_ref;
+        a_last = tr.a_ref;
+        v_last = tr.v_ref;
+    }
+
+    fprintf( stdout, "    %8d counts %6.3f s peak %6.1f eHz %7.1f eHz/s %8.0f eHz/s^2 step error %4.1f counts\n",
+        c->move, duration, v_peak, a_peak, j_peak, dp_err );
+
+    assert( v_peak <= (c->v_max * 1.001f) );
+    assert( a_peak <= (c->a_max * 1.001f) );
+    assert( j_peak <= (c->j_max * 1.01f) );
+    assert( dp_err < 4.0f ); // Float resolution on the longer moves
+    assert( !back );
+
+    assert( !tr.active );
+    assert( tr.p_ref == target );
+    assert( tr.v_ref == 0.0f );
+    assert( tr.a_ref == 0.0f );
+
+    // Time optimal with all limits reached: D/V + V/A + A/J
+    if (c->move == 655360)
+    {
+        float const D = (float)c->move / TRAJ_COUNTS;
+        float const T = (D / c->v_max) + (c->v_max / c->a_max) + (c->a_max / c->j_max);
+
+        assert( fabsf( duration - T ) < 1.0e-4f );
+    }
+}
+
+/*
+Simulated inertia
+
+A rigid rotor with viscous and Coulomb friction behind an ideal current loop,
+measured through the PLL scale (counts, eHz). The controllers run every
+slow loop.
+*/
+struct BISTTrajPlant
+{
+    double theta;   // rad mechanical
+    double omega;   // rad/s mechanical
+};
+
+typedef struct BISTTrajPlant BISTTrajPlant;
+
+static float const bist_traj_J   = 2.0e-4f; // kg m^2
+static float const bist_traj_B   = 1.0e-4f; // Nm/(rad/s)
+static float const bist_traj_Tc  = 0.01f;   // Nm
+static float const bist_traj_pp  = 7.0f;
+static float const bist_traj_psi = 0.005f;  // Wb
+
+static float bist_traj_Kt( void )
+{
+    return 1.5f * bist_traj_pp * bist_traj_psi;
+}
+
+static void bist_traj_plant( BISTTrajPlant * const p, float const Iq, float const T )
+{
+    double const dt = (double)T / BIST_TRAJ_SUB;
+
+    for ( uint32_t i = 0; i < BIST_TRAJ_SUB; ++i )
+    {
+        double const friction = (bist_traj_B * p->omega) + ((p->omega > 0.0) ? bist_traj_Tc : ((p->omega < 0.0) ? -bist_traj_Tc : 0.0));
+        double const torque   = (bist_traj_Kt() * Iq) - friction;
+
+        if ((p->omega == 0.0) && (fabs( bist_traj_Kt() * Iq ) <= bist_traj_Tc))
+        {
+            continue; // Stiction
+        }
+
+        double const omega = p->omega + ((torque / bist_traj_J) * dt);
+
+        // Friction stops, it does not reverse
+        p->omega = ((omega * p->omega) < 0.0) ? 0.0 : omega;
+        p->theta = p->theta + (p->omega * dt);
+    }
+}
+
+static uint32_t bist_traj_counts( BISTTrajPlant const * const p )
+{
+    double const counts = (p->theta * bist_traj_pp * TRAJ_COUNTS) / (2.0 * BIST_TRAJ_PI);
+
+    return (uint32_t)(int64_t)floor( counts );
+}
+
+static float bist_traj_eHz( BISTTrajPlant const * const p )
+{
+    return (float)((p->omega * bist_traj_pp) / (2.0 * BIST_TRAJ_PI));
+}
+
+struct BISTTrajResult
+{
+    float settle;    // s to stay within the band
+    float overshoot; // counts
+    float I_peak;    // A
+    float t_sat;     // s at the current limit
+};
+
+typedef struct BISTTrajResult BISTTrajResult;
+
+#define BIST_TRAJ_BAND 200.0f // counts, about 1 degree electrical
+
+/*
+The PID formerly in RunPosControl, stepped to the target, with its defaults.
+*/
+static float bist_traj_legacy( float * const integral, uint32_t * const last, uint32_t const target, uint32_t const position, float const I_max )
+{
+    float const Kp = 0.0002f;
+    float const Ki = 0.1f;
+    float const Kd = 0.002f;
+
+    float const error = (float)(int32_t)(target - position);
+    float const p = Kp * error;
+
+    *integral = fminf( fmaxf( (*integral + (Ki * p)), -I_max ), I_max );
+
+    float const d = -Kd * (float)(int32_t)(position - *last);
+
+    *last = position;
+
+    return fminf( fmaxf( (p + *integral + d), -I_max ), I_max );
+}
+
+static BISTTrajResult bist_traj_settle( bool const planned, int32_t const move )
+{
+    BISTTrajPlant p = { 0.0, 0.0 };
+    TRAJ tr;
+
+    uint32_t const start  = bist_traj_counts( &p );
+    uint32_t const target = start + (uint32_t)move;
+
+    traj_init( &tr, start );
+    tr.speed_kp = 0.2f;
+    tr.speed_ki = 0.1f;
+    tr.Kp       = 15.0f;
+    tr.Kff      = (bist_traj_J * 2.0f * BIST_TRAJ_PI) / (bist_traj_pp * bist_traj_Kt()); // A per eHz/s
+
+    float    integral = 0.0f;
+    uint32_t last     = start;
+
+    BISTTrajResult res = { .settle = 0.0f };
+
+    if (planned)
+    {
+        traj_move( &tr, target );
+    }
+
+    for ( float t = 0.0f; (t < BIST_TRAJ_TEND); t = t + BIST_TRAJ_LOOP )
+    {
+        uint32_t const position = bist_traj_counts( &p );
+
+        float const Iq = planned ? traj_run( &tr, position, bist_traj_eHz( &p ), BIST_TRAJ_LOOP )
+                                 : bist_traj_legacy( &integral, &last, target, position, tr.I_max );
+
+        bist_traj_plant( &p, Iq, BIST_TRAJ_LOOP );
+
+        float const error = (float)(int32_t)(target - bist_traj_counts( &p ));
+
+        if (fabsf( error ) > BIST_TRAJ_BAND)
+        {
+            res.settle = t + BIST_TRAJ_LOOP;
+        }
+
+        res.overshoot = fmaxf( res.overshoot, ((move > 0) ? -error : error) );
+        res.I_peak    = fmaxf( res.I_peak, fabsf( Iq ) );
+
+        if (fabsf( Iq ) >= tr.I_max)
+        {
+            res.t_sat = res.t_sat + BIST_TRAJ_LOOP;
+        }
+    }
+
+    return res;
+}
+
+static void bist_traj_print( char const * const name, BISTTrajResult const * const res )
+{
+    fprintf( stdout, "    %-8s settle %5.2f s overshoot %7.0f counts peak %5.2f A saturated %5.2f s\n",
+        name, res->settle, res->overshoot, res->I_peak, res->t_sat );
+}
+
+void bist_traj( void )
+{
+    fprintf( stdout, "Starting Trajectory BIST\n" );
+
+    for ( uint32_t i = 0; i < (sizeof(bist_traj_case) / sizeof(*bist_traj_case)); ++i )
+    {
+        bist_traj_profile( &bist_traj_case[i] );
+    }
+
+    // Queued move starts where the first ends
+    TRAJ tr;
+
+    traj_init( &tr, 0 );
+    traj_move( &tr, 65536 );
+    traj_move( &tr, 0 );
+    assert( tr.end == 65536 );
+
+    float const t_first = tr.duration;
+
+    for ( float t = 0.0f; (t < (3.0f * t_first)); t = t + BIST_TRAJ_LOOP )
+    {
+        traj_sample( &tr, BIST_TRAJ_LOOP );
+    }
+
+    assert( !tr.active && (tr.p_ref == 0) );
+
+    // Settling on a simulated inertia, 5 erev
+    BISTTrajResult const legacy  = bist_traj_settle( false, 327680 );
+    BISTTrajResult const planned = bist_traj_settle( true,  327680 );
+
+    bist_traj_print( "step PID", &legacy  );
+    bist_traj_print( "S-curve",  &planned );
+
+    assert( legacy.t_sat > 0.0f );
+    assert( planned.t_sat == 0.0f );
+    assert( planned.overshoot < BIST_TRAJ_BAND );
+    assert( planned.settle < legacy.settle );
+
+    fprintf( stdout, "Finished Trajectory BIST\n" );
+}
@@ -0,0 +1,294 @@
+/*
+* Copyright 2021-2023 cod3b453
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its contributors
+*    may be used to endorse or promote products derived from this software
+*    without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "TTerm_trie.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BIST_TRIE_NAMES 400
+#define BIST_TRIE_LEN   24
+#define BIST_TRIE_LOOPS 200
+
+// Mirror of the TTerm command list, sorted and scanned with strncmp
+struct BIST_TRIE_ENTRY
+{
+    char const *             name;
+    uint32_t                 len;
+    struct BIST_TRIE_ENTRY * next;
+};
+
+typedef struct BIST_TRIE_ENTRY BIST_TRIE_ENTRY;
+
+static char            bist_trie_name[BIST_TRIE_NAMES][BIST_TRIE_LEN];
+static BIST_TRIE_ENTRY bist_trie_entry[BIST_TRIE_NAMES];
+static void *          bist_trie_buff[BIST_TRIE_NAMES];
+
+static uint32_t bist_trie_alloc_count = 0;
+
+static void * bist_trie_alloc( size_t size )
+{
+    bist_trie_alloc_count++;
+    return malloc( size );
+}
+
+static void * bist_trie_fail( size_t size )
+{
+    (void)size;
+    return NULL;
+}
+
+static BIST_TRIE_ENTRY * bist_trie_list_add( BIST_TRIE_ENTRY * head, BIST_TRIE_ENTRY * item )
+{
+    BIST_TRIE_ENTRY ** link = &head;
+
+    while ((*link != NULL) && (strcmp( (*link)->name, item->name ) < 0))
+    {
+        link = &(*link)->next;
+    }
+
+    item->next = *link;
+    *link = item;
+
+    return head;
+}
+
+static BIST_TRIE_ENTRY * bist_trie_list_find( BIST_TRIE_ENTRY * head, char const * name, uint32_t len )
+{
+    for ( BIST_TRIE_ENTRY * e = head; e != NULL; e = e->next )
+    {
+        if ((e->len == len) && (strncmp( name, e->name, len ) == 0))
+        {
+            return e;
+        }
+    }
+
+    return NULL;
+}
+
+static uint32_t bist_trie_list_complete( BIST_TRIE_ENTRY * head, char const * prefix, uint32_t len, void ** buff )
+{
+    uint32_t found = 0;
+
+    for ( BIST_TRIE_ENTRY * e = head; e != NULL; e = e->next )
+    {
+        if (strncmp( prefix, e->name, len ) == 0)
+        {
+            buff[found] = e;
+            found++;
+        }
+        else if (found > 0)
+        {
+            break;
+        }
+    }
+
+    return found;
+}
+
+static double bist_trie_us( clock_t const start )
+{
+    return (1.0e6 * (double)(clock() - start)) / (double)CLOCKS_PER_SEC;
+}
+
+void bist_trie( void )
+{
+    fprintf( stdout, "Starting TRIE BIST\n" );
+
+    // Names shaped like the MESC variables, many sharing long prefixes
+    static char const * const family[] =
+    {
+        "motor_", "pll_", "hall_", "hall_est_", "opt_", "can_", "curr_", "fw_",
+        "ramp_", "speed_", "temp_", "bat_", "adc", "pwm_", "health_", "sl_",
+    };
+    static char const * const field[] =
+    {
+        "min", "max", "gain", "kp", "ki", "bw", "lim", "offset", "type", "mode",
+        "rate", "filter", "hold", "trip", "scale",
+    };
+    uint32_t const families = sizeof(family) / sizeof(family[0]);
+    uint32_t const fields   = sizeof(field) / sizeof(field[0]);
+
+    TTERM_TRIE        trie;
+    BIST_TRIE_ENTRY * head = NULL;
+
+    TTERM_trie_init( &trie, bist_trie_alloc );
+
+    uint32_t n = 0;
+
+    for ( uint32_t i = 0; (i < BIST_TRIE_NAMES); ++i )
+    {
+        // Shuffle the registration order, the list insert sorts as TTerm does
+        uint32_t const j = (i * 7919) % BIST_TRIE_NAMES;
+        uint32_t const f = j % families;
+        uint32_t const g = (j / families) % fields;
+        uint32_t const r = j / (families * fields);
+
+        if (r == 0)
+        {
+            snprintf( bist_trie_name[n], BIST_TRIE_LEN, "%s%s", family[f], field[g] );
+        }
+        else
+        {
+            snprintf( bist_trie_name[n], BIST_TRIE_LEN, "%s%s%u", family[f], field[g], (unsigned)r );
+        }
+
+        bist_trie_entry[n].name = bist_trie_name[n];
+        bist_trie_entry[n].len  = (uint32_t)strlen( bist_trie_name[n] );
+        head = bist_trie_list_add( head, &bist_trie_entry[n] );
+        assert( TTERM_trie_insert( &trie, bist_trie_entry[n].name, bist_trie_entry[n].len, &bist_trie_entry[n] ) );
+        n++;
+    }
+
+    assert( trie.root.count == n );
+    assert( trie.failed == false );
+
+    // Every name resolves to itself, prefixes and extensions of names do not
+    for ( uint32_t i = 0; i < n; ++i )
+    {
+        BIST_TRIE_ENTRY const * const e = &bist_trie_entry[i];
+
+        assert( TTERM_trie_find( &trie, e->name, e->len ) == e );
+        assert( TTERM_trie_find( &trie, e->name, e->len - 1 ) == bist_trie_list_find( head, e->name, e->len - 1 ) );
+    }
+
+    assert( TTERM_trie_find( &trie, "motor_kp1x", 10 ) == NULL );
+    assert( TTERM_trie_find( &trie, "", 0 ) == NULL );
+    assert( TTERM_trie_find( &trie, "zzz", 3 ) == NULL );
+
+    // Completion matches the list, in the same order, for every short prefix
+    static void * ref[BIST_TRIE_NAMES];
+
+    for ( uint32_t i = 0; i < n; ++i )
+    {
+        for ( uint32_t l = 0; l <= 4; ++l )
+        {
+            uint32_t const cnt = bist_trie_list_complete( head, bist_trie_name[i], l, ref );
+
+            assert( TTERM_trie_count( &trie, bist_trie_name[i], l ) == cnt );
+            assert( TTERM_trie_complete( &trie, bist_trie_name[i], l, bist_trie_buff, BIST_TRIE_NAMES ) == cnt );
+            assert( memcmp( ref, bist_trie_buff, cnt * sizeof(void *) ) == 0 );
+        }
+    }
+
+    assert( TTERM_trie_count( &trie, "", 0 ) == n );
+    assert( TTERM_trie_complete( &trie, "hall_", 5, bist_trie_buff, 3 ) == 3 );
+    assert( TTERM_trie_complete( &trie, "hallx", 5, bist_trie_buff, BIST_TRIE_NAMES ) == 0 );
+
+    // Registering a name again replaces it without changing the counts
+    static BIST_TRIE_ENTRY dup;
+
+    dup = bist_trie_entry[0];
+    assert( TTERM_trie_insert( &trie, dup.name, dup.len, &dup ) );
+    assert( TTERM_trie_find( &trie, dup.name, dup.len ) == &dup );
+    assert( trie.root.count == n );
+    assert( TTERM_trie_insert( &trie, dup.name, dup.len, &bist_trie_entry[0] ) );
+
+    fprintf( stdout, "INFO: %u names, %u nodes, %u bytes in %u allocations\n",
+        (unsigned)n, (unsigned)trie.nodes, (unsigned)trie.bytes, (unsigned)bist_trie_alloc_count );
+
+    // Dispatch, every name looked up as a typed command would be
+    volatile uintptr_t sink = 0;
+    clock_t            t0   = clock();
+
+    for ( uint32_t k = 0; k < BIST_TRIE_LOOPS; ++k )
+    {
+        for ( uint32_t i = 0; i < n; ++i )
+        {
+            sink = sink + (uintptr_t)bist_trie_list_find( head, bist_trie_entry[i].name, bist_trie_entry[i].len );
+        }
+    }
+
+    double const list_find = bist_trie_us( t0 );
+
+    t0 = clock();
+
+    for ( uint32_t k = 0; k < BIST_TRIE_LOOPS; ++k )
+    {
+        for ( uint32_t i = 0; i < n; ++i )
+        {
+            sink = sink + (uintptr_t)TTERM_trie_find( &trie, bist_trie_entry[i].name, bist_trie_entry[i].len );
+        }
+    }
+
+    double const trie_find = bist_trie_us( t0 );
+
+    // Completion after each keystroke of every name
+    t0 = clock();
+
+    for ( uint32_t k = 0; k < (BIST_TRIE_LOOPS / 10); ++k )
+    {
+        for ( uint32_t i = 0; i < n; ++i )
+        {
+            for ( uint32_t l = 1; l <= bist_trie_entry[i].len; ++l )
+            {
+                sink = sink + bist_trie_list_complete( head, bist_trie_name[i], l, bist_trie_buff );
+            }
+        }
+    }
+
+    double const list_comp = bist_trie_us( t0 );
+
+    t0 = clock();
+
+    for ( uint32_t k = 0; k < (BIST_TRIE_LOOPS / 10); ++k )
+    {
+        for ( uint32_t i = 0; i < n; ++i )
+        {
+            for ( uint32_t l = 1; l <= bist_trie_entry[i].len; ++l )
+            {
+                sink = sink + TTERM_trie_complete( &trie, bist_trie_name[i], l, bist_trie_buff, BIST_TRIE_NAMES );
+            }
+        }
+    }
+
+    double const trie_comp = bist_trie_us( t0 );
+
+    fprintf( stdout, "INFO: lookup     list %8.3f us trie %8.3f us (x%.1f)\n",
+        list_find / (BIST_TRIE_LOOPS * n), trie_find / (BIST_TRIE_LOOPS * n), list_find / trie_find );
+    fprintf( stdout, "INFO: completion list %8.3f s  trie %8.3f s  (x%.1f)\n",
+        list_comp * 1.0e-6, trie_comp * 1.0e-6, list_comp / trie_comp );
+
+    assert( trie_find < list_find );
+    assert( trie_comp < list_comp );
+
+    // Out of memory leaves the tree marked so the caller can fall back to scanning
+    TTERM_TRIE small;
+
+    TTERM_trie_init( &small, bist_trie_fail );
+    assert( TTERM_trie_insert( &small, "set", 3, &dup ) == false );
+    assert( small.failed );
+    assert( TTERM_trie_find( &small, "set", 3 ) == NULL );
+
+    fprintf( stdout, "Finished TRIE BIST\n" );
+}
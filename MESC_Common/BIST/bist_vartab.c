@@ -0,0 +1,331 @@
+/*
+* Copyright 2021-2023 cod3b453
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its contributors
+*    may be used to endorse or promote products derived from this software
+*    without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BIST_VARTAB_VARS  96
+#define BIST_VARTAB_LEN   20
+#define BIST_VARTAB_LOOPS 2000
+
+// Mirrors of the TTerm variable registry, before and after the split into
+// a const info table and a RAM list node
+
+typedef void (* bist_vartab_cb)( void * var );
+
+// Heap allocated descriptor, one per TERM_addVar call
+struct BIST_VARTAB_HEAP
+{
+    void *                    variable;
+    uint32_t                  type;
+    uint16_t                  typeSize;
+    char const *              prefix;
+    char const *              name;
+    uint32_t                  nameLength;
+    char const *              variableDescription;
+    uint32_t                  min;
+    uint32_t                  max;
+    uint8_t                   rw;
+    uint32_t                  flags;
+    bist_vartab_cb            cb;
+    struct BIST_VARTAB_HEAP * nextVar;
+};
+
+typedef struct BIST_VARTAB_HEAP BIST_VARTAB_HEAP;
+
+// TermVariableInfo
+struct BIST_VARTAB_INFO
+{
+    void *         variable;
+    uint32_t       type;
+    uint16_t       typeSize;
+    char const *   prefix;
+    char const *   name;
+    uint32_t       nameLength;
+    char const *   variableDescription;
+    uint32_t       min;
+    uint32_t       max;
+    uint8_t        rw;
+    uint32_t       flags;
+    bist_vartab_cb cb;
+};
+
+typedef struct BIST_VARTAB_INFO BIST_VARTAB_INFO;
+
+// TermVariableDescriptor
+struct BIST_VARTAB_NODE
+{
+    BIST_VARTAB_INFO const *  info;
+    uint32_t                  flags;
+    struct BIST_VARTAB_NODE * nextVar;
+};
+
+typedef struct BIST_VARTAB_NODE BIST_VARTAB_NODE;
+
+static char             bist_vartab_name[BIST_VARTAB_VARS][BIST_VARTAB_LEN];
+static float            bist_vartab_value[BIST_VARTAB_VARS];
+static BIST_VARTAB_INFO bist_vartab_info[BIST_VARTAB_VARS];
+static BIST_VARTAB_NODE bist_vartab_node[BIST_VARTAB_VARS];
+
+static uint32_t bist_vartab_heap_bytes = 0;
+static uint32_t bist_vartab_heap_count = 0;
+
+// Charge each allocation the header and alignment of the FreeRTOS heap_4 allocator
+static void * bist_vartab_alloc( size_t const size )
+{
+    size_t const header = 2 * sizeof(void *);
+
+    bist_vartab_heap_bytes += (uint32_t)((size + header + 7) & ~(size_t)7);
+    bist_vartab_heap_count++;
+
+    return malloc( size );
+}
+
+// TERM_VAR_isSorted, on the name and length alone
+static bool bist_vartab_sorted( char const * a, uint32_t const la, char const * b, uint32_t const lb )
+{
+    for ( uint32_t i = 0; (i < la) && (i < lb); ++i )
+    {
+        if (a[i] != b[i])
+        {
+            return (a[i] > b[i]);
+        }
+    }
+
+    return (la >= lb);
+}
+
+static void bist_vartab_heap_add( BIST_VARTAB_HEAP ** const head, BIST_VARTAB_HEAP * const item )
+{
+    BIST_VARTAB_HEAP ** link = head;
+
+    while ((*link != NULL) && !bist_vartab_sorted( (*link)->name, (*link)->nameLength, item->name, item->nameLength ))
+    {
+        link = &(*link)->nextVar;
+    }
+
+    item->nextVar = *link;
+    *link = item;
+}
+
+static void bist_vartab_node_add( BIST_VARTAB_NODE ** const head, BIST_VARTAB_NODE * const item )
+{
+    BIST_VARTAB_NODE ** link = head;
+
+    while ((*link != NULL) && !bist_vartab_sorted( (*link)->info->name, (*link)->info->nameLength, item->info->name, item->info->nameLength ))
+    {
+        link = &(*link)->nextVar;
+    }
+
+    item->nextVar = *link;
+    *link = item;
+}
+
+// TERM_addVar for every variable in turn
+static BIST_VARTAB_HEAP * bist_vartab_boot_heap( void )
+{
+    BIST_VARTAB_HEAP * head = NULL;
+
+    for ( uint32_t i = 0; i < BIST_VARTAB_VARS; ++i )
+    {
+        BIST_VARTAB_HEAP * const v = bist_vartab_alloc( sizeof(BIST_VARTAB_HEAP) );
+
+        assert( v != NULL );
+
+        v->variable            = &bist_vartab_value[i];
+        v->type                = 4;
+        v->typeSize            = sizeof(float);
+        v->prefix              = NULL;
+        v->name                = bist_vartab_name[i];
+        v->nameLength          = (uint32_t)strlen( bist_vartab_name[i] );
+        v->variableDescription = "description";
+        v->min                 = 0;
+        v->max                 = 0;
+        v->rw                  = 3;
+        v->flags               = 0;
+        v->cb                  = NULL;
+
+        bist_vartab_heap_add( &head, v );
+    }
+
+    return head;
+}
+
+static void bist_vartab_free_heap( BIST_VARTAB_HEAP * head )
+{
+    while (head != NULL)
+    {
+        BIST_VARTAB_HEAP * const next = head->nextVar;
+
+        free( head );
+        head = next;
+    }
+}
+
+// TERM_addVarTable
+static BIST_VARTAB_NODE * bist_vartab_boot_table( void )
+{
+    BIST_VARTAB_NODE * head = NULL;
+
+    for ( uint32_t i = 0; i < BIST_VARTAB_VARS; ++i )
+    {
+        bist_vartab_node[i].info  = &bist_vartab_info[i];
+        bist_vartab_node[i].flags = bist_vartab_info[i].flags;
+
+        bist_vartab_node_add( &head, &bist_vartab_node[i] );
+    }
+
+    return head;
+}
+
+static double bist_vartab_us( clock_t const start )
+{
+    return (1.0e6 * (double)(clock() - start)) / (double)CLOCKS_PER_SEC;
+}
+
+void bist_vartab( void )
+{
+    fprintf( stdout, "Starting VARTAB BIST\n" );
+
+    static char const * const family[] =
+    {
+        "par_", "FOC_", "opt_", "pll_", "hall_", "fsched_", "meas_", "adc",
+    };
+    static char const * const field[] =
+    {
+        "max", "min", "gain", "bw", "type", "lo", "hi", "curr", "volt", "pol", "kp", "ki",
+    };
+    uint32_t const families = sizeof(family) / sizeof(family[0]);
+    uint32_t const fields   = sizeof(field) / sizeof(field[0]);
+
+    // Registration order shuffled the way populate_vars is, not sorted
+    for ( uint32_t i = 0; i < BIST_VARTAB_VARS; ++i )
+    {
+        uint32_t const j = (i * 37) % BIST_VARTAB_VARS;
+
+        snprintf( bist_vartab_name[i], BIST_VARTAB_LEN, "%s%s", family[j % families], field[(j / families) % fields] );
+
+        bist_vartab_info[i].variable            = &bist_vartab_value[i];
+        bist_vartab_info[i].type                = 4;
+        bist_vartab_info[i].typeSize            = sizeof(float);
+        bist_vartab_info[i].name                = bist_vartab_name[i];
+        bist_vartab_info[i].nameLength          = (uint32_t)strlen( bist_vartab_name[i] );
+        bist_vartab_info[i].variableDescription = "description";
+        bist_vartab_info[i].rw                  = 3;
+        bist_vartab_info[i].flags               = ((i % 10) == 0) ? 1 : 0;
+    }
+
+    // Both registries hold the same variables in the same order
+    bist_vartab_heap_bytes = 0;
+    bist_vartab_heap_count = 0;
+
+    BIST_VARTAB_HEAP * const heap  = bist_vartab_boot_heap();
+    BIST_VARTAB_NODE * const table = bist_vartab_boot_table();
+
+    uint32_t const heap_bytes = bist_vartab_heap_bytes;
+    uint32_t const heap_count = bist_vartab_heap_count;
+
+    {
+        BIST_VARTAB_HEAP const * a = heap;
+        BIST_VARTAB_NODE const * b = table;
+        uint32_t                 n = 0;
+
+        while ((a != NULL) && (b != NULL))
+        {
+            assert( strcmp( a->name, b->info->name ) == 0 );
+            assert( a->variable == b->info->variable );
+
+            if (b->nextVar != NULL)
+            {
+                assert( strcmp( b->info->name, b->nextVar->info->name ) < 0 );
+            }
+
+            a = a->nextVar;
+            b = b->nextVar;
+            n++;
+        }
+
+        assert( (a == NULL) && (b == NULL) );
+        assert( n == BIST_VARTAB_VARS );
+    }
+
+    // Initial flags come from the table, and changing them leaves the table alone
+    for ( uint32_t i = 0; i < BIST_VARTAB_VARS; ++i )
+    {
+        assert( bist_vartab_node[i].flags == bist_vartab_info[i].flags );
+    }
+
+    bist_vartab_node[1].flags |= 1;
+    assert( bist_vartab_info[1].flags == 0 );
+
+    // RAM: every heap descriptor against one node each, the table itself is const
+    uint32_t const table_ram = (uint32_t)sizeof(bist_vartab_node);
+    uint32_t const table_rom = (uint32_t)sizeof(bist_vartab_info);
+
+    fprintf( stdout, "INFO: %u variables, heap %u bytes in %u allocations, table %u bytes RAM + %u bytes const\n",
+        (unsigned)BIST_VARTAB_VARS, (unsigned)heap_bytes, (unsigned)heap_count, (unsigned)table_ram, (unsigned)table_rom );
+
+    assert( heap_count == BIST_VARTAB_VARS );
+    assert( (3 * table_ram) < heap_bytes );
+
+    bist_vartab_free_heap( heap );
+
+    // Boot time, the whole registry built from scratch
+    volatile uintptr_t sink = 0;
+    clock_t            t0   = clock();
+
+    for ( uint32_t k = 0; k < BIST_VARTAB_LOOPS; ++k )
+    {
+        BIST_VARTAB_HEAP * const h = bist_vartab_boot_heap();
+
+        sink = sink + (uintptr_t)h;
+        bist_vartab_free_heap( h );
+    }
+
+    double const heap_us = bist_vartab_us( t0 );
+
+    t0 = clock();
+
+    for ( uint32_t k = 0; k < BIST_VARTAB_LOOPS; ++k )
+    {
+        sink = sink + (uintptr_t)bist_vartab_boot_table();
+    }
+
+    double const table_us = bist_vartab_us( t0 );
+
+    fprintf( stdout, "INFO: registration heap %8.3f us table %8.3f us (x%.2f)\n",
+        heap_us / BIST_VARTAB_LOOPS, table_us / BIST_VARTAB_LOOPS, heap_us / table_us );
+
+    fprintf( stdout, "Finished VARTAB BIST\n" );
+}
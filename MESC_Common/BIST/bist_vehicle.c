@@ -0,0 +1,439 @@
+/*
+* Copyright 2021-2023 cod3b453
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its contributors
+*    may be used to endorse or promote products derived from this software
+*    without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "MESCvehicle.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define BIST_VEHICLE_T 0.01f // s, slowloop
+
+/*
+Context for the guards, one bit each so every combination can be tried.
+*/
+#define BIST_VEH_STAND     (1u << 0)
+#define BIST_VEH_BRAKE     (1u << 1)
+#define BIST_VEH_REVERSE   (1u << 2)
+#define BIST_VEH_THROTTLE  (1u << 3)
+#define BIST_VEH_MOVING    (1u << 4)
+#define BIST_VEH_CRUISABLE (1u << 5)
+#define BIST_VEH_MOMENTARY (1u << 6)
+#define BIST_VEH_BRAKEDRV  (1u << 7)
+#define BIST_VEH_FAULTED   (1u << 8)
+#define BIST_VEH_CONTEXTS  (1u << 9)
+
+static void bist_vehicle_context( VEHICLE * const veh, VEHState const state, uint32_t const c )
+{
+    vehicle_init( veh );
+
+    veh->state             = state;
+    veh->in                = ((c & BIST_VEH_STAND) ? VEH_IN_STAND : 0u)
+                           | ((c & BIST_VEH_BRAKE) ? VEH_IN_BRAKE : 0u)
+                           | ((c & BIST_VEH_REVERSE) ? VEH_IN_REVERSE : 0u);
+    veh->throttle_on       = ((c & BIST_VEH_THROTTLE) != 0);
+    veh->moving            = ((c & BIST_VEH_MOVING) != 0);
+    veh->eHz               = (c & BIST_VEH_CRUISABLE) ? (2.0f * veh->eHz_cruise) : (0.5f * veh->eHz_cruise);
+    veh->momentary_reverse = ((c & BIST_VEH_MOMENTARY) != 0);
+    veh->brake_to_drive    = ((c & BIST_VEH_BRAKEDRV) != 0);
+    veh->faulted           = ((c & BIST_VEH_FAULTED) != 0);
+}
+
+/*
+The intended behaviour written out longhand, independent of the table.
+*/
+static VEHState bist_vehicle_expect( VEHState const s, VEHEvent const ev, uint32_t const c )
+{
+    bool const stand     = ((c & BIST_VEH_STAND) != 0);
+    bool const brake     = ((c & BIST_VEH_BRAKE) != 0);
+    bool const reverse   = ((c & BIST_VEH_REVERSE) != 0);
+    bool const throttle  = ((c & BIST_VEH_THROTTLE) != 0);
+    bool const moving    = ((c & BIST_VEH_MOVING) != 0);
+    bool const cruisable = ((c & BIST_VEH_CRUISABLE) != 0);
+    bool const momentary = ((c & BIST_VEH_MOMENTARY) != 0);
+    bool const brakedrv  = ((c & BIST_VEH_BRAKEDRV) != 0);
+    bool const faulted   = ((c & BIST_VEH_FAULTED) != 0);
+
+    if ((ev == VEH_EV_FAULT) && (s != VEH_STATE_ERROR))
+    {
+        return VEH_STATE_ERROR;
+    }
+
+    switch (s)
+    {
+        case VEH_STATE_PARKED:
+            if (((ev == VEH_EV_START) || (ev == VEH_EV_THROTTLE_OFF)) && !brakedrv && !stand && !throttle)
+            {
+                return VEH_STATE_DRIVE;
+            }
+            if ((ev == VEH_EV_BRAKE_ON) && !stand && !throttle)
+            {
+                return VEH_STATE_DRIVE;
+            }
+            if ((ev == VEH_EV_STAND_UP) && (brake || !brakedrv) && !throttle)
+            {
+                return VEH_STATE_DRIVE;
+            }
+            return s;
+
+        case VEH_STATE_DRIVE:
+            if ((ev == VEH_EV_STAND_DOWN) || (ev == VEH_EV_PARK_TIMER))
+            {
+                return VEH_STATE_PARKED;
+            }
+            if ((ev == VEH_EV_REVERSE_ON) && !moving)
+            {
+                return VEH_STATE_REVERSE;
+            }
+            if ((ev == VEH_EV_STOPPED) && !momentary && reverse)
+            {
+                return VEH_STATE_REVERSE;
+            }
+            if ((ev == VEH_EV_CRUISE) && throttle && cruisable)
+            {
+                return VEH_STATE_CRUISE;
+            }
+            return s;
+
+        case VEH_STATE_REVERSE:
+            if ((ev == VEH_EV_STAND_DOWN) || (ev == VEH_EV_PARK_TIMER))
+            {
+                return VEH_STATE_PARKED;
+            }
+            if ((ev == VEH_EV_REVERSE_OFF) && !moving)
+            {
+                return VEH_STATE_DRIVE;
+            }
+            if ((ev == VEH_EV_STOPPED) && !momentary && !reverse)
+            {
+                return VEH_STATE_DRIVE;
+            }
+            return s;
+
+        case VEH_STATE_CRUISE:
+            if (ev == VEH_EV_STAND_DOWN)
+            {
+                return VEH_STATE_PARKED;
+            }
+            if ((ev == VEH_EV_BRAKE_ON) || (ev == VEH_EV_CRUISE) || (ev == VEH_EV_THROTTLE_ON) || (ev == VEH_EV_STOPPED))
+            {
+                return VEH_STATE_DRIVE;
+            }
+            return s;
+
+        case VEH_STATE_ERROR:
+            if ((ev == VEH_EV_FAULT_CLEAR) && !throttle)
+            {
+                return VEH_STATE_PARKED;
+            }
+            if ((ev == VEH_EV_THROTTLE_OFF) && !faulted)
+            {
+                return VEH_STATE_PARKED;
+            }
+            return s;
+
+        default:
+            return s;
+    }
+}
+
+static void bist_vehicle_table( void )
+{
+    uint32_t n     = 0;
+    uint32_t moves = 0;
+
+    for (uint32_t s = 0; s < VEH_STATES; s++)
+    {
+        for (uint32_t e = 0; e < VEH_EVENTS; e++)
+        {
+            for (uint32_t c = 0; c < BIST_VEH_CONTEXTS; c++)
+            {
+                VEHICLE veh;
+
+                bist_vehicle_context( &veh, (VEHState)s, c );
+
+                uint8_t const mode = veh.mode;
+                bool    const hit  = vehicle_dispatch( &veh, (VEHEvent)e );
+
+                VEHState const expect = bist_vehicle_expect( (VEHState)s, (VEHEvent)e, c );
+
+                if (veh.state != expect)
+                {
+                    fprintf( stdout, "    state %u event %u context 0x%03X: %u expected %u\n",
+                             (unsigned)s, (unsigned)e, (unsigned)c, (unsigned)veh.state, (unsigned)expect );
+                }
+
+                assert( veh.state == expect );
+
+                // Only the mode button changes the mode, only with the throttle closed, never in cruise or error
+                bool const mode_change = (e == VEH_EV_MODE) && !(c & BIST_VEH_THROTTLE)
+                                      && (s != VEH_STATE_CRUISE) && (s != VEH_STATE_ERROR);
+
+                assert( veh.mode == (mode_change ? ((mode + 1) % VEH_MODES) : mode) );
+                assert( hit == ((expect != (VEHState)s) || mode_change) );
+
+                n++;
+                moves += (expect != (VEHState)s) ? 1u : 0u;
+            }
+        }
+    }
+
+    fprintf( stdout, "    Transition table: %u state, event and guard combinations, %u transitions\n",
+             (unsigned)n, (unsigned)moves );
+}
+
+static void bist_vehicle_tick( VEHICLE * const veh, uint32_t const in, float const throttle, float const eHz, uint32_t const n )
+{
+    for (uint32_t i = 0; i < n; i++)
+    {
+        vehicle_update( veh, in, throttle, eHz, false, BIST_VEHICLE_T );
+    }
+}
+
+static void bist_vehicle_edges( void )
+{
+    VEHICLE veh;
+
+    // Without a brake input, drive from power up with the stand up
+    vehicle_init( &veh );
+    bist_vehicle_tick( &veh, 0, 0.0f, 0.0f, 1 );
+    assert( veh.state == VEH_STATE_DRIVE );
+    assert( !vehicle_locked( &veh ) );
+
+    // Stand down parks on the tick it happens
+    bist_vehicle_tick( &veh, VEH_IN_STAND, 0.0f, 0.0f, 1 );
+    assert( veh.state == VEH_STATE_PARKED );
+    assert( vehicle_locked( &veh ) );
+    assert( vehicle_request( &veh ) == 0.0f );
+
+    // Bounce on the stand switch inside the debounce is ignored
+    bist_vehicle_tick( &veh, 0, 0.0f, 0.0f, 1 );
+    assert( veh.state == VEH_STATE_PARKED );
+    bist_vehicle_tick( &veh, VEH_IN_STAND, 0.0f, 0.0f, 1 );
+
+    // Brake to drive: raising the stand alone stays parked, the brake drives
+    vehicle_init( &veh );
+    veh.brake_to_drive = true;
+    bist_vehicle_tick( &veh, VEH_IN_STAND, 0.0f, 0.0f, 1 );
+    assert( veh.state == VEH_STATE_PARKED );
+    bist_vehicle_tick( &veh, 0, 0.0f, 0.0f, 10 );
+    assert( veh.state == VEH_STATE_PARKED );
+    bist_vehicle_tick( &veh, VEH_IN_BRAKE, 0.0f, 0.0f, 1 );
+    assert( veh.state == VEH_STATE_DRIVE );
+
+    // The brake lever cuts the throttle
+    bist_vehicle_tick( &veh, VEH_IN_BRAKE, 1.0f, 50.0f, 1 );
+    assert( vehicle_request( &veh ) == 0.0f );
+
+    fprintf( stdout, "    Edges act on the tick they arrive, bounce inside %.0f ms ignored\n", (double)(veh.debounce * 1000.0f) );
+}
+
+static void bist_vehicle_reverse( void )
+{
+    VEHICLE veh;
+
+    // Throttle open at power up stays parked until it closes
+    vehicle_init( &veh );
+    bist_vehicle_tick( &veh, 0, 0.3f, 0.0f, 5 );
+    assert( veh.state == VEH_STATE_PARKED );
+    bist_vehicle_tick( &veh, 0, 0.0f, 0.0f, 1 );
+    assert( veh.state == VEH_STATE_DRIVE );
+    bist_vehicle_tick( &veh, 0, 0.3f, 100.0f, 5 );
+
+    // Switched into reverse on the move, nothing until stopped
+    bist_vehicle_tick( &veh, VEH_IN_REVERSE, 0.0f, 100.0f, 10 );
+    assert( veh.state == VEH_STATE_DRIVE );
+    bist_vehicle_tick( &veh, VEH_IN_REVERSE, 0.0f, 0.0f, 1 );
+    assert( veh.state == VEH_STATE_REVERSE );
+
+    float const r = vehicle_request( &veh );
+
+    bist_vehicle_tick( &veh, VEH_IN_REVERSE, 1.0f, 0.0f, 1 );
+    assert( vehicle_request( &veh ) < 0.0f );
+    assert( fabsf( vehicle_request( &veh ) + (veh.reverse_scale * veh.modes[veh.mode].I_max) ) < 1.0e-6f );
+    assert( r == 0.0f );
+
+    bist_vehicle_tick( &veh, 0, 0.0f, 0.0f, 1 );
+    assert( veh.state == VEH_STATE_DRIVE );
+
+    // A momentary button toggles, stood still only
+    vehicle_init( &veh );
+    veh.momentary_reverse = true;
+    bist_vehicle_tick( &veh, 0, 0.0f, 0.0f, 1 );
+    bist_vehicle_tick( &veh, VEH_IN_REVERSE, 0.0f, 0.0f, 1 );
+    assert( veh.state == VEH_STATE_REVERSE );
+    bist_vehicle_tick( &veh, 0, 0.0f, 0.0f, 10 );
+    assert( veh.state == VEH_STATE_REVERSE );
+    bist_vehicle_tick( &veh, 0, 0.2f, 30.0f, 1 );
+    bist_vehicle_tick( &veh, VEH_IN_REVERSE, 0.2f, 30.0f, 1 );
+    assert( veh.state == VEH_STATE_REVERSE );
+    bist_vehicle_tick( &veh, 0, 0.0f, 0.0f, 10 );
+    bist_vehicle_tick( &veh, VEH_IN_REVERSE, 0.0f, 0.0f, 1 );
+    assert( veh.state == VEH_STATE_DRIVE );
+
+    fprintf( stdout, "    Reverse waits for a stop, switch or button\n" );
+}
+
+static void bist_vehicle_cruise( void )
+{
+    VEHICLE veh;
+
+    vehicle_init( &veh );
+    bist_vehicle_tick( &veh, 0, 0.0f, 0.0f, 1 );
+    bist_vehicle_tick( &veh, 0, 0.5f, 200.0f, 5 );
+    bist_vehicle_tick( &veh, VEH_IN_CRUISE, 0.5f, 200.0f, 1 );
+    assert( veh.state == VEH_STATE_CRUISE );
+    assert( veh.cruise_eHz == 200.0f );
+    assert( vehicle_request( &veh ) == 0.0f );
+    assert( !vehicle_locked( &veh ) );
+
+    // Releasing the throttle holds, opening it again takes over
+    bist_vehicle_tick( &veh, 0, 0.0f, 200.0f, 10 );
+    assert( veh.state == VEH_STATE_CRUISE );
+    bist_vehicle_tick( &veh, 0, 0.6f, 200.0f, 1 );
+    assert( veh.state == VEH_STATE_DRIVE );
+
+    // The brake cancels
+    bist_vehicle_tick( &veh, VEH_IN_CRUISE, 0.6f, 200.0f, 1 );
+    assert( veh.state == VEH_STATE_CRUISE );
+    bist_vehicle_tick( &veh, VEH_IN_BRAKE, 0.0f, 200.0f, 1 );
+    assert( veh.state == VEH_STATE_DRIVE );
+
+    // Too slow to engage
+    bist_vehicle_tick( &veh, 0, 0.5f, 20.0f, 10 );
+    bist_vehicle_tick( &veh, VEH_IN_CRUISE, 0.5f, 20.0f, 1 );
+    assert( veh.state == VEH_STATE_DRIVE );
+
+    fprintf( stdout, "    Cruise engages above %.0f eHz, throttle or brake cancels\n", (double)veh.eHz_cruise );
+}
+
+static void bist_vehicle_park_timer( void )
+{
+    VEHICLE veh;
+
+    vehicle_init( &veh );
+    veh.park_time = 1.0f;
+
+    bist_vehicle_tick( &veh, 0, 0.0f, 0.0f, 99 );
+    assert( veh.state == VEH_STATE_DRIVE );
+
+    // A blip of throttle restarts the timer
+    bist_vehicle_tick( &veh, 0, 0.2f, 0.0f, 1 );
+    bist_vehicle_tick( &veh, 0, 0.0f, 0.0f, 99 );
+    assert( veh.state == VEH_STATE_DRIVE );
+    bist_vehicle_tick( &veh, 0, 0.0f, 0.0f, 2 );
+    assert( veh.state == VEH_STATE_PARKED );
+
+    fprintf( stdout, "    Parks after %.1f s still with the throttle closed\n", (double)veh.park_time );
+}
+
+static void bist_vehicle_faults( void )
+{
+    VEHICLE veh;
+
+    vehicle_init( &veh );
+    bist_vehicle_tick( &veh, 0, 0.0f, 0.0f, 1 );
+    bist_vehicle_tick( &veh, 0, 0.5f, 100.0f, 1 );
+    vehicle_update( &veh, 0, 0.5f, 100.0f, true, BIST_VEHICLE_T );
+    assert( veh.state == VEH_STATE_ERROR );
+    assert( vehicle_request( &veh ) == 0.0f );
+
+    // Clearing with the throttle open waits for it to close
+    vehicle_update( &veh, 0, 0.5f, 100.0f, false, BIST_VEHICLE_T );
+    assert( veh.state == VEH_STATE_ERROR );
+    vehicle_update( &veh, 0, 0.0f, 100.0f, false, BIST_VEHICLE_T );
+    assert( veh.state == VEH_STATE_PARKED );
+
+    fprintf( stdout, "    Faults lock until cleared with the throttle closed\n" );
+}
+
+static void bist_vehicle_modes( void )
+{
+    VEHICLE veh;
+
+    vehicle_init( &veh );
+    bist_vehicle_tick( &veh, 0, 0.0f, 0.0f, 1 );
+
+    float req[VEH_MODES];
+
+    for (uint32_t m = 0; m < VEH_MODES; m++)
+    {
+        bist_vehicle_tick( &veh, 0, 0.5f, 100.0f, 1 );
+        req[veh.mode] = vehicle_request( &veh );
+        assert( fabsf( req[veh.mode] - (veh.modes[veh.mode].I_max * veh.modes[veh.mode].map[2]) ) < 1.0e-6f );
+
+        // Modes only change with the throttle closed
+        uint8_t const mode = veh.mode;
+
+        bist_vehicle_tick( &veh, VEH_IN_MODE, 0.5f, 100.0f, 1 );
+        assert( veh.mode == mode );
+        bist_vehicle_tick( &veh, 0, 0.0f, 100.0f, 10 );
+        bist_vehicle_tick( &veh, VEH_IN_MODE, 0.0f, 100.0f, 1 );
+        assert( veh.mode == ((mode + 1) % VEH_MODES) );
+        bist_vehicle_tick( &veh, 0, 0.0f, 100.0f, 10 );
+    }
+
+    assert( (req[0] < req[1]) && (req[1] < req[2]) );
+
+    // Speed limit tapers motoring over the 10% above it, braking is kept
+    veh.modes[veh.mode].eHz_max = 100.0f;
+    bist_vehicle_tick( &veh, 0, 1.0f, 100.0f, 1 );
+    float const at = vehicle_request( &veh );
+    bist_vehicle_tick( &veh, 0, 1.0f, 105.0f, 1 );
+    float const mid = vehicle_request( &veh );
+    bist_vehicle_tick( &veh, 0, 1.0f, 110.0f, 1 );
+    float const over = vehicle_request( &veh );
+    bist_vehicle_tick( &veh, 0, -0.5f, 110.0f, 1 );
+    float const brake = vehicle_request( &veh );
+
+    fprintf( stdout, "    Half throttle by mode %.3f %.3f %.3f, speed limit %.2f %.2f %.2f, brake %.2f\n",
+             (double)req[0], (double)req[1], (double)req[2], (double)at, (double)mid, (double)over, (double)brake );
+
+    assert( fabsf( at - veh.modes[veh.mode].I_max ) < 1.0e-6f );
+    assert( fabsf( mid - (0.5f * at) ) < 1.0e-3f );
+    assert( over == 0.0f );
+    assert( fabsf( brake + (0.5f * veh.modes[veh.mode].I_brake) ) < 1.0e-6f );
+}
+
+void bist_vehicle( void )
+{
+    fprintf( stdout, "Starting Vehicle BIST\n" );
+
+    bist_vehicle_table();
+    bist_vehicle_edges();
+    bist_vehicle_reverse();
+    bist_vehicle_cruise();
+    bist_vehicle_park_timer();
+    bist_vehicle_faults();
+    bist_vehicle_modes();
+
+    fprintf( stdout, "Finished Vehicle BIST\n" );
+}
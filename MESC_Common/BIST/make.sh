@@ -29,4 +29,4 @@
 
 ENVCC=${CC:-gcc}
 echo "INFO: Using ${ENVCC}"
-${ENVCC} -Wall -Wextra -pedantic -std=c11 -g -ggdb3 -O0 -I../Inc/ -I../Gen -I./virt/ ../Src/MESCbat.c ../Src/MESCcli.c ../Src/MESCfnv.c ../Src/MESCprofile.c ../Src/MESCspeed.c ../Src/MESCtemp.c ../Src/MESCui.c ../Gen/ntc.c bist*.c gen_profile.c virt*.c -lm -o bist
+${ENVCC} -Wall -Wextra -pedantic -std=c11 -g -ggdb3 -O0 -I../Inc/ -I../Gen -I../../MESC_RTOS/AXIS/ -I../../MESC_RTOS/Tasks/ -I../../MESC_RTOS/TTerm/Core/include/ -I./virt/ ../Src/MESCapll.c ../Src/MESCbat.c ../Src/MESCbatch.c ../Src/MESCcli.c ../Src/MESCdpwm.c ../Src/MESCencoder.c ../Src/MESCfnv.c ../Src/MESCfsched.c ../Src/MESChallest.c ../Src/MESChealth.c ../Src/MESCimu.c ../Src/MESCinfilt.c ../Src/MESCovermod.c ../Src/MESCprofile.c ../Src/MESCpstore.c ../Src/MESCsixstep.c ../Src/MESCspeed.c ../Src/MESCspeedloop.c ../Src/MESCtemp.c ../Src/MESCthermal.c ../Src/MESCtraction.c ../Src/MESCtraj.c ../Src/MESCui.c ../Src/MESCvehicle.c ../../MESC_RTOS/AXIS/MESCmt6816.c ../../MESC_RTOS/Tasks/MESCcansess.c ../../MESC_RTOS/TTerm/Core/TTerm_fnv.c ../../MESC_RTOS/TTerm/Core/TTerm_nvm.c ../../MESC_RTOS/TTerm/Core/TTerm_trie.c ../Gen/ntc.c ../Gen/profile_compiler.c bist*.c gen_profile.c virt*.c -lm -o bist
@@ -29,6 +29,7 @@
 
 #include "virt_flash.h"
 
+#include <assert.h>
 #include <inttypes.h>
 #include <stdbool.h>
 #include <stdio.h>
@@ -83,7 +84,7 @@ void virt_flash_corrupt( char const * name, uint32_t const offset, uint32_t cons
     corrupt_length = length;
 }
 
-ProfileStatus virt_flash_read( void * data, uint32_t const address, uint32_t const length )
+VirtFlashStatus virt_flash_read( void * data, uint32_t const address, uint32_t const length )
 {
     read_buffer = data;
 
@@ -100,7 +101,7 @@ ProfileStatus virt_flash_read( void * data, uint32_t const address, uint32_t con
 
         if (ret != 0)
         {
-            return PROFILE_STATUS_ERROR_DATA_OFFSET;
+            return VIRT_FLASH_STATUS_ERROR_OFFSET;
         }
 
         size_t const len = fread( data, 1, length, f );
@@ -109,12 +110,12 @@ ProfileStatus virt_flash_read( void * data, uint32_t const address, uint32_t con
 
         if (len != length)
         {
-            return PROFILE_STATUS_ERROR_STORAGE_READ;
+            return VIRT_FLASH_STATUS_ERROR_READ;
         }
 
         virt_flash_apply_corruption();
 
-        return PROFILE_STATUS_SUCCESS;
+        return VIRT_FLASH_STATUS_SUCCESS;
     }
 
     if (use_mem_not_fs)
@@ -123,12 +124,12 @@ ProfileStatus virt_flash_read( void * data, uint32_t const address, uint32_t con
 
         virt_flash_apply_corruption();
 
-        return PROFILE_STATUS_SUCCESS;
+        return VIRT_FLASH_STATUS_SUCCESS;
     }
 
     if (read_zero_on_error == false)
     {
-        return PROFILE_STATUS_ERROR_STORAGE_READ;
+        return VIRT_FLASH_STATUS_ERROR_READ;
     }
     else
     {
@@ -136,11 +137,11 @@ ProfileStatus virt_flash_read( void * data, uint32_t const address, uint32_t con
 
         virt_flash_apply_corruption();
 
-        return PROFILE_STATUS_SUCCESS;
+        return VIRT_FLASH_STATUS_SUCCESS;
     }
 }
 
-ProfileStatus virt_flash_write( void const * data, uint32_t const address, uint32_t const length )
+VirtFlashStatus virt_flash_write( void const * data, uint32_t const address, uint32_t const length )
 {
     write_buffer = data;
 
@@ -157,7 +158,7 @@ ProfileStatus virt_flash_write( void const * data, uint32_t const address, uint3
 
         if (ret != 0)
         {
-            return PROFILE_STATUS_ERROR_DATA_OFFSET;
+            return VIRT_FLASH_STATUS_ERROR_OFFSET;
         }
 
         size_t const len = fwrite( data, 1, length, f );
@@ -166,30 +167,45 @@ ProfileStatus virt_flash_write( void const * data, uint32_t const address, uint3
 
         if (len != length)
         {
-            return PROFILE_STATUS_ERROR_STORAGE_WRITE;
+            return VIRT_FLASH_STATUS_ERROR_WRITE;
         }
 
-        return PROFILE_STATUS_COMMIT_SUCCESS;
+        return VIRT_FLASH_STATUS_COMMIT_SUCCESS;
     }
 
     if (use_mem_not_fs)
     {
         memcpy( &mem[address], data, length );
 
-        return PROFILE_STATUS_COMMIT_SUCCESS;
+        return VIRT_FLASH_STATUS_COMMIT_SUCCESS;
     }
 
-    return PROFILE_STATUS_ERROR_STORAGE_WRITE;
+    return VIRT_FLASH_STATUS_ERROR_WRITE;
 }
 
-ProfileStatus virt_flash_begin( void )
+uint8_t * virt_flash_map( uint32_t const address, uint32_t const length )
 {
-    return PROFILE_STATUS_SUCCESS;
+    if ((use_mem_not_fs == false) || (mem == NULL))
+    {
+        return NULL;
+    }
+
+    if ((address > VIRT_FLASH_SIZE) || (length > (VIRT_FLASH_SIZE - address)))
+    {
+        return NULL;
+    }
+
+    return &mem[address];
+}
+
+VirtFlashStatus virt_flash_begin( void )
+{
+    return VIRT_FLASH_STATUS_SUCCESS;
 }
 
-ProfileStatus virt_flash_end( void )
+VirtFlashStatus virt_flash_end( void )
 {
-    return PROFILE_STATUS_SUCCESS;
+    return VIRT_FLASH_STATUS_SUCCESS;
 }
 
 void virt_flash_reset( void )
@@ -202,7 +218,7 @@ void virt_flash_reset( void )
 
 void virt_flash_init( void )
 {
-    mem = calloc( PROFILE_MAX_SIZE, 1 );
+    mem = calloc( VIRT_FLASH_SIZE, 1 );
 }
 
 void virt_flash_free( void )
@@ -27,21 +27,45 @@
 * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
-#include "MESCprofile.h"
+#ifndef VIRT_FLASH_H
+#define VIRT_FLASH_H
 
-extern void          virt_flash_configure( bool const use_mem_not_fs, bool const read_zero_on_error );
+#include <stdbool.h>
+#include <stdint.h>
 
-extern void          virt_flash_apply_corruption( void );
-extern void          virt_flash_corrupt( char const * name, uint32_t const offset, uint32_t const length );
+// Backing size; one 128kB storage sector as on the F405
+#define VIRT_FLASH_SIZE (128 * 1024)
 
-extern ProfileStatus virt_flash_read(  void       * data, uint32_t const address, uint32_t const length );
+enum VirtFlashStatus
+{
+    VIRT_FLASH_STATUS_SUCCESS,
+    VIRT_FLASH_STATUS_COMMIT_SUCCESS,
 
-extern ProfileStatus virt_flash_write( void const * data, uint32_t const address, uint32_t const length );
-extern ProfileStatus virt_flash_begin( void );
-extern ProfileStatus virt_flash_end(   void );
+    VIRT_FLASH_STATUS_ERROR_OFFSET,
+    VIRT_FLASH_STATUS_ERROR_READ,
+    VIRT_FLASH_STATUS_ERROR_WRITE,
+};
 
-extern void          virt_flash_reset( void );
+typedef enum VirtFlashStatus VirtFlashStatus;
 
-extern void          virt_flash_init(  void );
+extern void            virt_flash_configure( bool const use_mem_not_fs, bool const read_zero_on_error );
 
-extern void          virt_flash_free(  void );
+extern void            virt_flash_apply_corruption( void );
+extern void            virt_flash_corrupt( char const * name, uint32_t const offset, uint32_t const length );
+
+extern VirtFlashStatus virt_flash_read(  void       * data, uint32_t const address, uint32_t const length );
+
+extern VirtFlashStatus virt_flash_write( void const * data, uint32_t const address, uint32_t const length );
+
+// Direct view of the memory backing, for code that reads flash memory mapped
+extern uint8_t *       virt_flash_map(   uint32_t const address, uint32_t const length );
+extern VirtFlashStatus virt_flash_begin( void );
+extern VirtFlashStatus virt_flash_end(   void );
+
+extern void            virt_flash_reset( void );
+
+extern void            virt_flash_init(  void );
+
+extern void            virt_flash_free(  void );
+
+#endif
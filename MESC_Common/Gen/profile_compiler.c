@@ -0,0 +1,884 @@
+/*
+* Copyright 2021-2023 cod3b453
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its contributors
+*    may be used to endorse or promote products derived from this software
+*    without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "profile_compiler.h"
+
+#include "MESCfnv.h"
+
+#include <inttypes.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+Every number goes through the same steps as in the browser: the form string is
+parsed to a double (parseFloat or parseInt), scaled in double, and only then
+narrowed by the dump_c_* helpers (setFloat32 or ToUint32 & mask). Doing the
+arithmetic in float here would differ in the last bit.
+*/
+
+#define PROFC_FIELDS_MAX    20
+#define PROFC_LINE_MAX      128
+
+#define PROFC_TIMESTAMP_LENGTH  12
+#define PROFC_GITHASH_LENGTH    20
+
+// Mirrors fingerprint.js
+static char const profc_timestamp[]       = "202202061446";
+static char const profc_githash_default[] = "837addf0dd130ad367d05c7b0593d19bc5f8904f";
+
+enum ProfcParse
+{
+    PROFC_FLOAT,    // parseFloat
+    PROFC_INT,      // parseInt
+    PROFC_FLAG,     // Checkbox, 0 or 1
+};
+
+enum ProfcStore
+{
+    PROFC_F32,      // dump_c_float
+    PROFC_U8,       // dump_c_uint8_t
+    PROFC_U16,      // dump_c_uint16_t
+    PROFC_U32,      // dump_c_uint32_t and dump_c_int
+};
+
+struct ProfcField
+{
+    char const * key;       // NULL for constants, padding and derived values
+    uint8_t      parse;
+    uint8_t      store;
+    double       divisor;   // Form unit to profile unit
+    double       def;       // Form default
+};
+
+typedef struct ProfcField ProfcField;
+
+struct ProfcType
+{
+    char const *        keyword;
+    char const *        name;       // Form default
+    char const *        signature;
+    uint32_t            length;     // As declared in the entry header
+    ProfcField const *  field;
+    uint32_t            fields;
+    void             (* derive)( double * value );
+};
+
+typedef struct ProfcType ProfcType;
+
+struct ProfcEntry
+{
+    ProfcType const *   type;
+    uint32_t            line;
+    uint32_t            name_length;
+    char                name[PROFC_NAME_LENGTH];
+    double              value[PROFC_FIELDS_MAX];
+};
+
+typedef struct ProfcEntry ProfcEntry;
+
+// MESCbat.js
+static ProfcField const profc_battery[] =
+{
+    { "cell-imax", PROFC_FLOAT, PROFC_F32,    1.0,   30.0 },
+    { "cell-vmax", PROFC_FLOAT, PROFC_F32,    1.0,    4.2 },
+    { "cell-cmax", PROFC_FLOAT, PROFC_F32, 1000.0, 4200.0 },
+    { "cell-vmid", PROFC_FLOAT, PROFC_F32,    1.0,    3.4 },
+    { "cell-cmid", PROFC_FLOAT, PROFC_F32, 1000.0,  700.0 },
+    { "cell-vlow", PROFC_FLOAT, PROFC_F32,    1.0,    3.2 },
+    { "cell-clow", PROFC_FLOAT, PROFC_F32, 1000.0,  500.0 },
+    { "cell-vmin", PROFC_FLOAT, PROFC_F32,    1.0,    2.8 },
+    { "bat-imax",  PROFC_FLOAT, PROFC_F32,    1.0,   50.0 },
+    { "bat-pmax",  PROFC_FLOAT, PROFC_F32,    1.0,  250.0 },
+    { "bat-esr",   PROFC_FLOAT, PROFC_F32, 1000.0,  100.0 },
+    { "bat-p",     PROFC_INT,   PROFC_U8,     1.0,    2.0 },
+    { "bat-s",     PROFC_INT,   PROFC_U8,     1.0,   20.0 },
+    { NULL,        PROFC_INT,   PROFC_U8,     1.0,    0.0 },
+    { NULL,        PROFC_INT,   PROFC_U8,     1.0,    0.0 },
+    { "bat-disp",  PROFC_INT,   PROFC_U32,    1.0,    0.0 },
+};
+
+// MESCmotor.js
+static ProfcField const profc_motor[] =
+{
+    { "mtr-imax",        PROFC_FLOAT, PROFC_F32,    1.0,   60.0 },
+    { "mtr-vmax",        PROFC_FLOAT, PROFC_F32,    1.0,  100.0 },
+    { "mtr-pmax",        PROFC_FLOAT, PROFC_F32,    1.0,  250.0 },
+    { "mtr-rpmmax",      PROFC_INT,   PROFC_U32,    1.0,  250.0 },
+    { "mtr-pp",          PROFC_INT,   PROFC_U8,     1.0,    6.0 },
+    { "mtr-dir",         PROFC_FLAG,  PROFC_U8,     1.0,    0.0 },
+    { NULL,              PROFC_INT,   PROFC_U8,     1.0,    0.0 },
+    { NULL,              PROFC_INT,   PROFC_U8,     1.0,    0.0 },
+    { "mtr-ind-d",       PROFC_FLOAT, PROFC_F32, 1000.0,    0.0 },
+    { "mtr-ind-q",       PROFC_FLOAT, PROFC_F32, 1000.0,    0.0 },
+    { "mtr-res",         PROFC_FLOAT, PROFC_F32, 1000.0,    0.0 },
+    { "mtr-flxlnk",      PROFC_FLOAT, PROFC_F32,    1.0, 1000.0 },
+    { "mtr-flxlnk-min",  PROFC_FLOAT, PROFC_F32,    1.0,  100.0 },
+    { "mtr-flxlnk-max",  PROFC_FLOAT, PROFC_F32,    1.0, 5000.0 },
+    { "mtr-flxlnk-gain", PROFC_FLOAT, PROFC_F32,    1.0,    1.0 },
+    { "mtr-nlcg",        PROFC_FLOAT, PROFC_F32,    1.0,    1.0 },
+};
+
+// MESCspeed.js (hall defaults are the form's ((65535 / 7) * i).toFixed(0))
+static ProfcField const profc_speed[] =
+{
+    { "spd-enc-off",   PROFC_FLOAT, PROFC_U16, 1.0,   100.0 },
+    { NULL,            PROFC_INT,   PROFC_U16, 1.0,     0.0 },
+    { "spd-hall-min0", PROFC_INT,   PROFC_U16, 1.0,     0.0 },
+    { "spd-hall-max0", PROFC_INT,   PROFC_U16, 1.0,  9361.0 },
+    { "spd-hall-min1", PROFC_INT,   PROFC_U16, 1.0,  9362.0 },
+    { "spd-hall-max1", PROFC_INT,   PROFC_U16, 1.0, 18723.0 },
+    { "spd-hall-min2", PROFC_INT,   PROFC_U16, 1.0, 18724.0 },
+    { "spd-hall-max2", PROFC_INT,   PROFC_U16, 1.0, 28085.0 },
+    { "spd-hall-min3", PROFC_INT,   PROFC_U16, 1.0, 28086.0 },
+    { "spd-hall-max3", PROFC_INT,   PROFC_U16, 1.0, 37448.0 },
+    { "spd-hall-min4", PROFC_INT,   PROFC_U16, 1.0, 37449.0 },
+    { "spd-hall-max4", PROFC_INT,   PROFC_U16, 1.0, 46810.0 },
+    { "spd-hall-min5", PROFC_INT,   PROFC_U16, 1.0, 46811.0 },
+    { "spd-hall-max5", PROFC_INT,   PROFC_U16, 1.0, 56172.0 },
+    { "spd-gm",        PROFC_INT,   PROFC_U32, 1.0,     1.0 },
+    { "spd-gw",        PROFC_INT,   PROFC_U32, 1.0,     1.0 },
+    { "spd-d",         PROFC_FLOAT, PROFC_F32, 1.0,    26.0 },
+    { "spd-disp",      PROFC_FLOAT, PROFC_F32, 1.0,     0.0 },
+};
+
+// MESCtemp.js
+enum
+{
+    PROFC_TEMP_SH_A    = 6,
+    PROFC_TEMP_SH_B    = 7,
+    PROFC_TEMP_SH_C    = 8,
+    PROFC_TEMP_SH_BETA = 9,
+    PROFC_TEMP_SH_T0   = 11,
+    PROFC_TEMP_SH_R0   = 12,
+};
+
+static ProfcField const profc_temperature[] =
+{
+    { "temp-rd",     PROFC_INT,   PROFC_U32, 1.0,     0.0    },
+    { "temp-v",      PROFC_FLOAT, PROFC_F32, 1.0,     3.3    },
+    { "temp-rf",     PROFC_FLOAT, PROFC_F32, 1.0,  4700.0    },
+    { "temp-adcrng", PROFC_INT,   PROFC_U32, 1.0,  4096.0    },
+    { NULL,          PROFC_INT,   PROFC_U32, 1.0,     0.0    }, // TEMP_METHOD_STEINHART_HART_BETA_R
+    { "temp-schema", PROFC_INT,   PROFC_U32, 1.0,     0.0    },
+    { NULL,          PROFC_FLOAT, PROFC_F32, 1.0,     0.0    }, // A
+    { NULL,          PROFC_FLOAT, PROFC_F32, 1.0,     0.0    }, // B
+    { NULL,          PROFC_FLOAT, PROFC_F32, 1.0,     0.0    }, // C
+    { "temp-beta",   PROFC_FLOAT, PROFC_F32, 1.0,  3438.0    },
+    { "temp-r",      PROFC_FLOAT, PROFC_F32, 1.0,     0.0982 },
+    { "temp-t0",     PROFC_FLOAT, PROFC_F32, 1.0,    25.0    },
+    { "temp-r0",     PROFC_FLOAT, PROFC_F32, 1.0, 10000.0    },
+    { "temp-min",    PROFC_FLOAT, PROFC_F32, 1.0,    10.0    },
+    { "temp-max",    PROFC_FLOAT, PROFC_F32, 1.0,    50.0    },
+};
+
+// TEMP_derive_SteinhartHart_ABC_from_Beta
+static void profc_derive_temperature( double * value )
+{
+    value[PROFC_TEMP_SH_C] = 0.0;
+    value[PROFC_TEMP_SH_B] = (1.0 / value[PROFC_TEMP_SH_BETA]);
+    value[PROFC_TEMP_SH_A] = (value[PROFC_TEMP_SH_T0] - (value[PROFC_TEMP_SH_B] * log( value[PROFC_TEMP_SH_R0] )));
+}
+
+// MESCui.js
+static ProfcField const profc_throttle[] =
+{
+    { NULL,              PROFC_INT,   PROFC_U32, 1.0,    0.0 }, // UI_PROFILE_THROTTLE
+    { "thr-adc-min",     PROFC_INT,   PROFC_U32, 1.0,  100.0 },
+    { "thr-adc-max",     PROFC_INT,   PROFC_U32, 1.0, 2047.0 },
+    { "thr-rsp",         PROFC_INT,   PROFC_U32, 1.0,    0.0 },
+    { "thr-adc-trig",    PROFC_INT,   PROFC_U32, 1.0,  300.0 },
+    { "thr-imax",        PROFC_FLOAT, PROFC_F32, 1.0,   20.0 },
+    { "thr-rcpwm-t-min", PROFC_INT,   PROFC_U32, 1.0, 1000.0 },
+    { "thr-rcpwm-t-max", PROFC_INT,   PROFC_U32, 1.0, 2000.0 },
+};
+
+static ProfcField const profc_brake[] =
+{
+    { NULL,           PROFC_INT, PROFC_U32, 1.0,    1.0 }, // UI_PROFILE_BRAKE
+    { "brk-adc-min",  PROFC_INT, PROFC_U32, 1.0,  100.0 },
+    { "brk-adc-max",  PROFC_INT, PROFC_U32, 1.0, 2047.0 },
+    { "brk-rsp",      PROFC_INT, PROFC_U32, 1.0,    0.0 },
+    { "brk-adc-trig", PROFC_INT, PROFC_U32, 1.0, 2047.0 },
+    { "brk-imax",     PROFC_INT, PROFC_F32, 1.0,   10.0 }, // parseInt in plotBrake
+    { NULL,           PROFC_INT, PROFC_U32, 1.0,    0.0 },
+    { NULL,           PROFC_INT, PROFC_U32, 1.0,    0.0 },
+};
+
+static ProfcField const profc_button[] =
+{
+    { NULL,     PROFC_INT, PROFC_U32, 1.0,        2.0 }, // UI_PROFILE_BUTTON
+    { "btn-if", PROFC_INT, PROFC_U32, 1.0,        0.0 },
+    { "btn-a",  PROFC_INT, PROFC_U32, 1.0, 80001000.0 }, // Decimal, as parseInt reads the form text
+    { "btn-id", PROFC_INT, PROFC_U32, 1.0,        0.0 },
+    { NULL,     PROFC_INT, PROFC_U32, 1.0,        0.0 },
+    { NULL,     PROFC_INT, PROFC_U32, 1.0,        0.0 },
+    { NULL,     PROFC_INT, PROFC_U32, 1.0,        0.0 },
+    { NULL,     PROFC_INT, PROFC_U32, 1.0,        0.0 },
+};
+
+static ProfcField const profc_indicator[] =
+{
+    { NULL,      PROFC_INT, PROFC_U32, 1.0,        3.0 }, // UI_PROFILE_INDICATOR
+    { "ind-if",  PROFC_INT, PROFC_U32, 1.0,        0.0 },
+    { "ind-a",   PROFC_INT, PROFC_U32, 1.0, 80002000.0 },
+    { "ind-id",  PROFC_INT, PROFC_U32, 1.0,        0.0 },
+    { "ind-act", PROFC_INT, PROFC_U32, 1.0,        0.0 },
+    { NULL,      PROFC_INT, PROFC_U32, 1.0,        0.0 },
+    { NULL,      PROFC_INT, PROFC_U32, 1.0,        0.0 },
+    { NULL,      PROFC_INT, PROFC_U32, 1.0,        0.0 },
+};
+
+static ProfcField const profc_screen[] =
+{
+    { NULL,      PROFC_INT,   PROFC_U32, 1.0,        4.0 }, // UI_PROFILE_SCREEN
+    { "scrn-if", PROFC_INT,   PROFC_U32, 1.0,        0.0 },
+    { "scrn-a",  PROFC_INT,   PROFC_U32, 1.0, 80003000.0 },
+    { "scrn-w",  PROFC_FLOAT, PROFC_U32, 1.0,       16.0 },
+    { "scrn-h",  PROFC_FLOAT, PROFC_U32, 1.0,        4.0 },
+    { NULL,      PROFC_INT,   PROFC_U32, 1.0,        0.0 },
+    { NULL,      PROFC_INT,   PROFC_U32, 1.0,        0.0 },
+    { NULL,      PROFC_INT,   PROFC_U32, 1.0,        0.0 },
+};
+
+#define PROFC_FIELDS(f) (f), (uint32_t)(sizeof(f) / sizeof(*(f)))
+
+/*
+MOTOR_PROFILE_SIZE is 36 while dump_MOTORProfile writes 52 bytes; the entry
+header and later data offsets use the declared size and the data is written in
+full, so that is kept as is to stay byte identical.
+*/
+static ProfcType const profc_type[] =
+{
+    { "battery",     "Battery",     "MBPE", 0x34, PROFC_FIELDS(profc_battery    ), NULL                     },
+    { "motor",       "Motor",       "MMPE",   36, PROFC_FIELDS(profc_motor      ), NULL                     },
+    { "speed",       "Speed",       "MSPE",   44, PROFC_FIELDS(profc_speed      ), NULL                     },
+    { "temperature", "Temperature", "MTPE",   60, PROFC_FIELDS(profc_temperature), profc_derive_temperature },
+    { "throttle",    "Throttle",    "MUPE",   32, PROFC_FIELDS(profc_throttle   ), NULL                     },
+    { "brake",       "E-Brake",     "MUPE",   32, PROFC_FIELDS(profc_brake      ), NULL                     },
+    { "button",      "Button",      "MUPE",   32, PROFC_FIELDS(profc_button     ), NULL                     },
+    { "indicator",   "Indicator",   "MUPE",   32, PROFC_FIELDS(profc_indicator  ), NULL                     },
+    { "screen",      "Screen",      "MUPE",   32, PROFC_FIELDS(profc_screen     ), NULL                     },
+};
+
+#undef PROFC_FIELDS
+
+#define PROFC_TYPES (sizeof(profc_type) / sizeof(*profc_type))
+
+static uint32_t profc_store_size( uint8_t const store )
+{
+    switch (store)
+    {
+        case PROFC_U8:
+            return 1;
+        case PROFC_U16:
+            return 2;
+        case PROFC_F32:
+        case PROFC_U32:
+        default:
+            return 4;
+    }
+}
+
+static uint32_t profc_data_size( ProfcType const * const type )
+{
+    uint32_t size = 0;
+
+    for ( uint32_t f = 0; f < type->fields; ++f )
+    {
+        size = size + profc_store_size( type->field[f].store );
+    }
+
+    return size;
+}
+
+// ECMAScript ToUint32, as applied by (value & mask)
+static uint32_t profc_to_uint32( double const value )
+{
+    if (!isfinite( value ))
+    {
+        return 0;
+    }
+
+    double v = fmod( trunc( value ), 4294967296.0 );
+
+    if (v < 0.0)
+    {
+        v = v + 4294967296.0;
+    }
+
+    return (uint32_t)v;
+}
+
+static uint8_t * profc_put_u32( uint8_t * p, uint32_t const value )
+{
+    p[0] = (uint8_t)( value        & 0xFF);
+    p[1] = (uint8_t)((value >>  8) & 0xFF);
+    p[2] = (uint8_t)((value >> 16) & 0xFF);
+    p[3] = (uint8_t)((value >> 24) & 0xFF);
+
+    return (p + 4);
+}
+
+static uint8_t * profc_put( uint8_t * p, uint8_t const store, double const value )
+{
+    switch (store)
+    {
+        case PROFC_F32:
+        {
+            float const f = (float)value;
+            uint32_t    u;
+
+            memcpy( &u, &f, sizeof(u) );
+
+            return profc_put_u32( p, u );
+        }
+        case PROFC_U8:
+            p[0] = (uint8_t)(profc_to_uint32( value ) & 0xFF);
+            return (p + 1);
+        case PROFC_U16:
+        {
+            uint32_t const u = profc_to_uint32( value );
+
+            p[0] = (uint8_t)( u       & 0xFF);
+            p[1] = (uint8_t)((u >> 8) & 0xFF);
+
+            return (p + 2);
+        }
+        case PROFC_U32:
+        default:
+            return profc_put_u32( p, profc_to_uint32( value ) );
+    }
+}
+
+/*
+Only plain decimal numbers are accepted; where the browser would quietly read a
+prefix ("12abc") or a hex literal as zero the description is rejected instead.
+PROFC_INT and PROFC_FLAG fields additionally refuse a fraction or exponent
+rather than have parseInt drop it.
+*/
+static bool profc_number( char const * s, uint8_t const parse, double * value )
+{
+    char const * p = s;
+    uint32_t digits = 0;
+
+    if ((*p == '+') || (*p == '-'))
+    {
+        p++;
+    }
+
+    for ( ; ((*p >= '0') && (*p <= '9')); p++ )
+    {
+        digits++;
+    }
+
+    if (parse == PROFC_FLOAT)
+    {
+        if (*p == '.')
+        {
+            for ( p++; ((*p >= '0') && (*p <= '9')); p++ )
+            {
+                digits++;
+            }
+        }
+
+        if ((digits > 0) && ((*p == 'e') || (*p == 'E')))
+        {
+            uint32_t exponent = 0;
+
+            p++;
+
+            if ((*p == '+') || (*p == '-'))
+            {
+                p++;
+            }
+
+            for ( ; ((*p >= '0') && (*p <= '9')); p++ )
+            {
+                exponent++;
+            }
+
+            if (exponent == 0)
+            {
+                return false;
+            }
+        }
+    }
+
+    if ((digits == 0) || (*p != '\0'))
+    {
+        return false;
+    }
+
+    *value = strtod( s, NULL );
+
+    return ((parse != PROFC_FLAG) || (*value == 0.0) || (*value == 1.0));
+}
+
+static bool profc_printable( char const * s, size_t const length )
+{
+    for ( size_t i = 0; i < length; ++i )
+    {
+        if ((s[i] < 0x20) || (s[i] > 0x7E))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static int profc_nybble( char const c )
+{
+    if ((c >= '0') && (c <= '9'))
+    {
+        return (c - '0');
+    }
+
+    if ((c >= 'a') && (c <= 'f'))
+    {
+        return (10 + (c - 'a'));
+    }
+
+    if ((c >= 'A') && (c <= 'F'))
+    {
+        return (10 + (c - 'A'));
+    }
+
+    return -1;
+}
+
+static bool profc_githash( char const * s, uint8_t githash[PROFC_GITHASH_LENGTH] )
+{
+    if (strlen( s ) != (2 * PROFC_GITHASH_LENGTH))
+    {
+        return false;
+    }
+
+    for ( uint32_t i = 0; i < PROFC_GITHASH_LENGTH; ++i )
+    {
+        int const hi = profc_nybble( s[(2 * i) + 0] );
+        int const lo = profc_nybble( s[(2 * i) + 1] );
+
+        if ((hi < 0) || (lo < 0))
+        {
+            return false;
+        }
+
+        githash[i] = (uint8_t)((hi << 4) | lo);
+    }
+
+    return true;
+}
+
+static char * profc_trim( char * s )
+{
+    while ((*s == ' ') || (*s == '\t'))
+    {
+        s++;
+    }
+
+    size_t n = strlen( s );
+
+    while ((n > 0) && ((s[n - 1] == ' ') || (s[n - 1] == '\t') || (s[n - 1] == '\r')))
+    {
+        n--;
+    }
+
+    s[n] = '\0';
+
+    return s;
+}
+
+static void profc_entry_init( ProfcEntry * const entry, ProfcType const * const type )
+{
+    entry->type        = type;
+    entry->name_length = (uint32_t)strlen( type->name );
+
+    memset( entry->name, 0, sizeof(entry->name) );
+    memcpy( entry->name, type->name, entry->name_length );
+
+    for ( uint32_t f = 0; f < type->fields; ++f )
+    {
+        entry->value[f] = (type->field[f].def / type->field[f].divisor);
+    }
+}
+
+static PROFCError profc_entry_set( ProfcEntry * const entry, char const * key, char const * value )
+{
+    if (strcmp( key, "name" ) == 0)
+    {
+        size_t const length = strlen( value );
+
+        if ((length > PROFC_NAME_LENGTH) || !profc_printable( value, length ))
+        {
+            return PROFC_ERR_NAME;
+        }
+
+        entry->name_length = (uint32_t)length;
+
+        memset( entry->name, 0, sizeof(entry->name) );
+        memcpy( entry->name, value, length );
+
+        return PROFC_OK;
+    }
+
+    ProfcType const * const type = entry->type;
+
+    for ( uint32_t f = 0; f < type->fields; ++f )
+    {
+        ProfcField const * const field = &type->field[f];
+
+        if ((field->key != NULL) && (strcmp( key, field->key ) == 0))
+        {
+            double v;
+
+            if (!profc_number( value, field->parse, &v ))
+            {
+                return PROFC_ERR_VALUE;
+            }
+
+            entry->value[f] = (v / field->divisor);
+
+            return PROFC_OK;
+        }
+    }
+
+    return PROFC_ERR_KEY;
+}
+
+static uint8_t * profc_put_entry( uint8_t * p, ProfcEntry const * const entry, uint32_t const offset )
+{
+    memcpy( p, "MPEH", 4 );
+    p[4] = 0;
+    p[5] = PROFC_ENTRY_SIZE;
+    p[6] = (uint8_t)entry->name_length;
+    memcpy( &p[7], entry->name, PROFC_NAME_LENGTH );
+    p[7 + PROFC_NAME_LENGTH] = 0;
+    memcpy( &p[8 + PROFC_NAME_LENGTH], entry->type->signature, 4 );
+
+    p = profc_put_u32( &p[12 + PROFC_NAME_LENGTH], entry->type->length );
+    p = profc_put_u32( p, offset );
+
+    return p;
+}
+
+static uint8_t * profc_put_data( uint8_t * p, ProfcEntry const * const entry )
+{
+    for ( uint32_t f = 0; f < entry->type->fields; ++f )
+    {
+        p = profc_put( p, entry->type->field[f].store, entry->value[f] );
+    }
+
+    return p;
+}
+
+static PROFCError profc_emit( ProfcEntry const entry[PROFC_ENTRIES], bool const used[PROFC_ENTRIES],
+                              char const * timestamp, uint8_t const githash[PROFC_GITHASH_LENGTH],
+                              uint8_t * image, size_t const capacity, uint32_t * length )
+{
+    uint32_t total = PROFC_HEADER_SIZE + (PROFC_ENTRIES * PROFC_ENTRY_SIZE);
+
+    for ( uint32_t i = 0; i < PROFC_ENTRIES; ++i )
+    {
+        if (used[i])
+        {
+            total = total + profc_data_size( entry[i].type );
+        }
+    }
+
+    if (total > capacity)
+    {
+        return PROFC_ERR_SPACE;
+    }
+
+    uint8_t * const header = image;
+    uint8_t * const body   = &image[PROFC_HEADER_SIZE];
+    uint8_t *       p      = body;
+    uint8_t         map[PROFC_ENTRIES / 4];
+    uint32_t        offset = PROFC_HEADER_SIZE + (PROFC_ENTRIES * PROFC_ENTRY_SIZE);
+
+    memset( map, 0xAA, sizeof(map) ); // PROFILE_ENTRY_FREE throughout
+
+    for ( uint32_t i = 0; i < PROFC_ENTRIES; ++i )
+    {
+        if (used[i])
+        {
+            map[i / 4] = (uint8_t)(map[i / 4] | (3 << (2 * (i % 4)))); // PROFILE_ENTRY_USED
+
+            p = profc_put_entry( p, &entry[i], offset );
+            offset = offset + entry[i].type->length;
+        }
+        else
+        {
+            memset( p, 0, PROFC_ENTRY_SIZE );
+            p = p + PROFC_ENTRY_SIZE;
+        }
+    }
+
+    for ( uint32_t i = 0; i < PROFC_ENTRIES; ++i )
+    {
+        if (used[i])
+        {
+            p = profc_put_data( p, &entry[i] );
+        }
+    }
+
+    uint32_t const body_length = (uint32_t)(p - body);
+
+    // The header checksum is taken with the signature standing in for itself
+    memcpy( &header[0], "MESC", 4 );
+    header[4] = 0;
+    header[5] = 1; // PROFILE_VERSION_MAJOR
+    header[6] = 0; // PROFILE_VERSION_MINOR
+    header[7] = PROFC_HEADER_SIZE;
+    memcpy( &header[8], "MESC", 4 );
+    memcpy( &header[12], map, sizeof(map) );
+    profc_put_u32( &header[20], body_length );
+    profc_put_u32( &header[24], fnv1a_data( body, body_length ) );
+    memcpy( &header[28], timestamp, PROFC_TIMESTAMP_LENGTH );
+    memset( &header[40], 0, 4 );
+    memcpy( &header[44], githash, PROFC_GITHASH_LENGTH );
+
+    profc_put_u32( &header[8], fnv1a_data( header, PROFC_HEADER_SIZE ) );
+
+    *length = total;
+
+    return PROFC_OK;
+}
+
+PROFCError profc_compile( char const * text, size_t const text_length,
+                          uint8_t * image, size_t const capacity,
+                          uint32_t * length, uint32_t * line )
+{
+    ProfcEntry   entry[PROFC_ENTRIES];
+    bool         used[PROFC_ENTRIES] = { false };
+    ProfcEntry * current = NULL;
+    uint32_t     next    = 0;
+    char         timestamp[PROFC_TIMESTAMP_LENGTH + 1];
+    uint8_t      githash[PROFC_GITHASH_LENGTH];
+
+    memcpy( timestamp, profc_timestamp, sizeof(timestamp) );
+    profc_githash( profc_githash_default, githash );
+
+    *line = 0;
+
+    for ( size_t pos = 0; pos < text_length; )
+    {
+        char   buf[PROFC_LINE_MAX];
+        size_t n = 0;
+
+        (*line)++;
+
+        for ( ; ((pos < text_length) && (text[pos] != '\n')); pos++, n++ )
+        {
+            if (n < (sizeof(buf) - 1))
+            {
+                buf[n] = text[pos];
+            }
+        }
+
+        pos++; // '\n'
+
+        if (n >= sizeof(buf))
+        {
+            return PROFC_ERR_SYNTAX;
+        }
+
+        buf[n] = '\0';
+
+        char * s = profc_trim( buf );
+
+        if ((*s == '\0') || (*s == '#'))
+        {
+            continue;
+        }
+
+        if ((strncmp( s, "entry", 5 ) == 0) && ((s[5] == ' ') || (s[5] == '\t') || (s[5] == '\0')))
+        {
+            char *   keyword = profc_trim( &s[5] );
+            char *   index   = strpbrk( keyword, " \t" );
+            uint32_t slot    = next;
+
+            if (index != NULL)
+            {
+                double v;
+
+                *index = '\0';
+                index  = profc_trim( &index[1] );
+
+                if (!profc_number( index, PROFC_INT, &v ) || (v < 0.0) || (v >= PROFC_ENTRIES))
+                {
+                    return PROFC_ERR_INDEX;
+                }
+
+                slot = (uint32_t)v;
+            }
+
+            ProfcType const * type = NULL;
+
+            for ( uint32_t t = 0; t < PROFC_TYPES; ++t )
+            {
+                if (strcmp( keyword, profc_type[t].keyword ) == 0)
+                {
+                    type = &profc_type[t];
+                    break;
+                }
+            }
+
+            if (type == NULL)
+            {
+                return PROFC_ERR_TYPE;
+            }
+
+            if ((slot >= PROFC_ENTRIES) || used[slot])
+            {
+                return PROFC_ERR_INDEX;
+            }
+
+            used[slot] = true;
+            current    = &entry[slot];
+            next       = slot + 1;
+
+            profc_entry_init( current, type );
+            current->line = *line;
+            continue;
+        }
+
+        char * eq = strchr( s, '=' );
+
+        if (eq == NULL)
+        {
+            return PROFC_ERR_SYNTAX;
+        }
+
+        *eq = '\0';
+
+        char const * key   = profc_trim( s );
+        char const * value = profc_trim( &eq[1] );
+
+        if (current != NULL)
+        {
+            PROFCError const ret = profc_entry_set( current, key, value );
+
+            if (ret != PROFC_OK)
+            {
+                return ret;
+            }
+        }
+        else if (strcmp( key, "timestamp" ) == 0)
+        {
+            if ((strlen( value ) != PROFC_TIMESTAMP_LENGTH) || !profc_printable( value, PROFC_TIMESTAMP_LENGTH ))
+            {
+                return PROFC_ERR_VALUE;
+            }
+
+            memcpy( timestamp, value, sizeof(timestamp) );
+        }
+        else if (strcmp( key, "githash" ) == 0)
+        {
+            if (!profc_githash( value, githash ))
+            {
+                return PROFC_ERR_VALUE;
+            }
+        }
+        else
+        {
+            return PROFC_ERR_KEY;
+        }
+    }
+
+    /*
+    A NaN can only come out of a derivation (e.g. a negative R0) and its bit
+    pattern after setFloat32 is left to the JS engine, so there is no single
+    image to match; the entry is refused instead.
+    */
+    for ( uint32_t i = 0; i < PROFC_ENTRIES; ++i )
+    {
+        if (!used[i])
+        {
+            continue;
+        }
+
+        if (entry[i].type->derive != NULL)
+        {
+            entry[i].type->derive( entry[i].value );
+        }
+
+        for ( uint32_t f = 0; f < entry[i].type->fields; ++f )
+        {
+            if (isnan( entry[i].value[f] ))
+            {
+                *line = entry[i].line;
+                return PROFC_ERR_VALUE;
+            }
+        }
+    }
+
+    *line = 0;
+
+    return profc_emit( entry, used, timestamp, githash, image, capacity, length );
+}
+
+void profc_command( uint8_t const * image, uint32_t const length, char command[PROFC_COMMAND_SIZE] )
+{
+    snprintf( command, PROFC_COMMAND_SIZE, "F %04" PRIX32 " %08" PRIX32, length, fnv1a_data( image, length ) );
+}
+
+void profc_hex( uint8_t const * image, uint32_t const length, char * hex )
+{
+    static char const nybble[] = "0123456789ABCDEF";
+
+    for ( uint32_t i = 0; i < length; ++i )
+    {
+        hex[(2 * i) + 0] = nybble[image[i] >> 4];
+        hex[(2 * i) + 1] = nybble[image[i] & 0xF];
+    }
+
+    hex[2 * length] = '\0';
+}
+
+char const * profc_error( PROFCError const error )
+{
+    switch (error)
+    {
+        case PROFC_OK:          return "OK";
+        case PROFC_ERR_SYNTAX:  return "syntax error";
+        case PROFC_ERR_TYPE:    return "unknown entry type";
+        case PROFC_ERR_KEY:     return "unknown key";
+        case PROFC_ERR_VALUE:   return "invalid value";
+        case PROFC_ERR_NAME:    return "invalid name";
+        case PROFC_ERR_INDEX:   return "invalid entry slot";
+        case PROFC_ERR_SPACE:   return "image too large";
+    }
+
+    return "unknown error";
+}
@@ -0,0 +1,103 @@
+/*
+* Copyright 2021-2023 cod3b453
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its contributors
+*    may be used to endorse or promote products derived from this software
+*    without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef MESC_PROFILE_COMPILER_H
+#define MESC_PROFILE_COMPILER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+Native equivalent of the MESCgen.js profile tool
+
+A text description is compiled into the same image, byte for byte, that the
+browser tool emits for the same form values. The description is line based,
+with whole-line comments starting with #:
+
+    # Optional fingerprint, before the first entry
+    timestamp = 202202061446
+    githash   = 837addf0dd130ad367d05c7b0593d19bc5f8904f
+
+    # Next slot after the previous entry
+    entry battery
+    name      = Pack
+    cell-cmax = 3000
+
+    # Explicit slot
+    entry motor 4
+
+Entry types are battery, motor, speed, temperature, throttle, brake, button,
+indicator and screen. Keys are the MESCgen.js form field ids without the
+e-<index>- prefix and take the same units as the form; anything left out takes
+the form default.
+*/
+
+#define PROFC_HEADER_SIZE   64
+#define PROFC_ENTRIES       32
+#define PROFC_ENTRY_SIZE    32
+#define PROFC_DATA_MAX      60
+#define PROFC_NAME_LENGTH   12
+
+#define PROFC_IMAGE_MAX     (PROFC_HEADER_SIZE + (PROFC_ENTRIES * (PROFC_ENTRY_SIZE + PROFC_DATA_MAX)))
+
+#define PROFC_COMMAND_SIZE  20 // "F LLLLLLLL HHHHHHHH" + NUL
+
+enum PROFCError
+{
+    PROFC_OK,
+    PROFC_ERR_SYNTAX,   // Line is neither an entry, a key/value pair nor a comment
+    PROFC_ERR_TYPE,     // Unknown entry type
+    PROFC_ERR_KEY,      // Key not valid for this entry type (or outside an entry)
+    PROFC_ERR_VALUE,    // Value does not parse for its field
+    PROFC_ERR_NAME,     // Name too long or not printable
+    PROFC_ERR_INDEX,    // Slot out of range or already in use
+    PROFC_ERR_SPACE,    // Output buffer too small
+};
+
+typedef enum PROFCError PROFCError;
+
+/*
+Compile text (text_length bytes) into image
+
+On success length holds the image size. On failure line holds the 1-based line
+of the offending input (0 when the error is not tied to a line).
+*/
+PROFCError profc_compile( char const * text, size_t const text_length,
+                          uint8_t * image, size_t const capacity,
+                          uint32_t * length, uint32_t * line );
+
+// The serial command MESCgen.js shows for an image ("F <length> <hash>")
+void profc_command( uint8_t const * image, uint32_t const length, char command[PROFC_COMMAND_SIZE] );
+
+// The upper case hex dump MESCgen.js shows for an image (2 * length + 1 bytes)
+void profc_hex( uint8_t const * image, uint32_t const length, char * hex );
+
+char const * profc_error( PROFCError const error );
+
+#endif
@@ -0,0 +1,105 @@
+/*
+* Copyright 2021-2023 cod3b453
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its contributors
+*    may be used to endorse or promote products derived from this software
+*    without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "MESCovermod.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define OVERMOD_TABLE_ITER     24    // Bisection steps per table entry
+#define OVERMOD_GAIN_SIX_STEP  10000.0f
+
+/*
+The six-step clip gain for each normalised request 1.0 ... OVERMOD_SIX_STEP_RATIO.
+The fundamental is monotonic in the gain, so each entry is found by bisection on
+log(gain).
+*/
+static void derive_overmod_gain( void )
+{
+    float const lg_max = logf( OVERMOD_GAIN_SIX_STEP );
+
+    fprintf( stderr, "Code Generation\n"
+                     "STARTING------------------------------------------------------------------------\n" );
+
+    fprintf( stdout, "float const overmod_gain[OVERMOD_TABLE_SIZE] =\n"
+                     "{\n" );
+
+    for ( uint32_t t = 0; t < OVERMOD_TABLE_SIZE; ++t )
+    {
+        float g;
+
+        if (t == 0)
+        {
+            g = 1.0f;
+        }
+        else if (t == (OVERMOD_TABLE_SIZE - 1))
+        {
+            g = OVERMOD_GAIN_SIX_STEP;
+        }
+        else
+        {
+            float const rt = 1.0f + (((OVERMOD_SIX_STEP_RATIO - 1.0f) * (float)t) / (float)(OVERMOD_TABLE_SIZE - 1));
+            float lo = 0.0f;
+            float hi = lg_max;
+
+            for ( uint32_t i = 0; i < OVERMOD_TABLE_ITER; ++i )
+            {
+                float const lg = 0.5f * (lo + hi);
+
+                if (overmod_fundamental( expf( lg ) ) < rt)
+                {
+                    lo = lg;
+                }
+                else
+                {
+                    hi = lg;
+                }
+            }
+
+            g = expf( 0.5f * (lo + hi) );
+        }
+
+        fprintf( stdout, "%s%.6ff,%s", (((t % 4) == 0) ? "    " : ""), (double)g, (((t % 4) == 3) ? "\n" : " ") );
+    }
+
+    fprintf( stdout, "};\n" );
+
+    fprintf( stderr, "FINISHED------------------------------------------------------------------------\n" );
+}
+
+int main ( int argc, char ** argv )
+{
+    derive_overmod_gain();
+
+    return EXIT_SUCCESS;
+    (void)argc;
+    (void)argv;
+}
@@ -0,0 +1,131 @@
+/*
+* Copyright 2021-2023 cod3b453
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its contributors
+*    may be used to endorse or promote products derived from this software
+*    without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "profile_compiler.h"
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+util_profile [-q] description...
+
+Compiles each description and prints the command and data that MESCgen.js
+would show for it, one pair of lines per file. With -q only errors are
+reported, which is enough to validate a batch.
+*/
+
+#define UTIL_PROFILE_TEXT_MAX (64 * 1024)
+
+static char    text[UTIL_PROFILE_TEXT_MAX];
+static uint8_t image[PROFC_IMAGE_MAX];
+static char    hex[(2 * PROFC_IMAGE_MAX) + 1];
+
+static bool compile_file( char const * path, bool const quiet )
+{
+    FILE * f = fopen( path, "rb" );
+
+    if (f == NULL)
+    {
+        fprintf( stderr, "%s: cannot open\n", path );
+        return false;
+    }
+
+    size_t const n = fread( text, 1, sizeof(text), f );
+    bool const   truncated = (n == sizeof(text));
+
+    fclose( f );
+
+    if (truncated)
+    {
+        fprintf( stderr, "%s: too large\n", path );
+        return false;
+    }
+
+    uint32_t         length = 0;
+    uint32_t         line   = 0;
+    PROFCError const ret    = profc_compile( text, n, image, sizeof(image), &length, &line );
+
+    if (ret != PROFC_OK)
+    {
+        fprintf( stderr, "%s:%" PRIu32 ": %s\n", path, line, profc_error( ret ) );
+        return false;
+    }
+
+    if (!quiet)
+    {
+        char command[PROFC_COMMAND_SIZE];
+
+        profc_command( image, length, command );
+        profc_hex( image, length, hex );
+
+        fprintf( stdout, "%s\n%s\n", command, hex );
+    }
+
+    return true;
+}
+
+int main( int argc, char ** argv )
+{
+    bool quiet = false;
+    int  a     = 1;
+
+    if ((argc > 1) && (strcmp( argv[1], "-q" ) == 0))
+    {
+        quiet = true;
+        a++;
+    }
+
+    if (a >= argc)
+    {
+        fprintf( stderr, "usage: %s [-q] description...\n", argv[0] );
+        return EXIT_FAILURE;
+    }
+
+    uint32_t failed = 0;
+
+    for ( ; a < argc; ++a )
+    {
+        if (!compile_file( argv[a], quiet ))
+        {
+            failed++;
+        }
+    }
+
+    if (failed > 0)
+    {
+        fprintf( stderr, "%" PRIu32 " of %d failed\n", failed, (argc - 1 - (quiet ? 1 : 0)) );
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -39,22 +39,13 @@
 #define INC_MESCAPP_H_
 
 #include "MESCfoc.h"
+#include "MESCvehicle.h"
+#include "MESCimu.h"
 
-enum VEHICLE_STATE
-{
-	VEHICLE_IDLE = 0,
-	VEHICLE_PARKED = 1,
-	VEHICLE_DRIVE = 2,
-	VEHICLE_x = 3,
-	VEHICLE_y = 4,
-	VEHICLE_ERROR = 5
-};
-enum VEHICLE_DIRECTION
-{
-	VEHICLE_FORWARD = 0,
-	VEHICLE_REVERSE = 1,
-};
+extern VEHICLE vehicle;
+extern IMU *vehicle_imu; //Set by the board once the IMU is running, for traction control; the board also reads and processes it
 
+void Vehicle_init(void);
 void No_app(MESC_motor_typedef *_motor);
 void Vehicle_app(MESC_motor_typedef *_motor);
 
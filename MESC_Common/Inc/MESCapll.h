@@ -0,0 +1,110 @@
+/*
+ **
+ ******************************************************************************
+ * @file           : MESCapll.h
+ * @brief          : Adaptive bandwidth angle and speed tracker
+ ******************************************************************************
+ * @attention
+ *
+ * <h2><center>&copy; Copyright (c) 2020 David Molony.
+ * All rights reserved.</center></h2>
+ *
+ * This software component is licensed under BSD 3-Clause license,
+ * the "License"; You may not use this file except in compliance with the
+ * License. You may obtain a copy of the License at:
+ *                        opensource.org/licenses/BSD-3-Clause
+ *
+ ******************************************************************************
+ *In addition to the usual 3 BSD clauses, it is explicitly noted that you
+ *do NOT have the right to take sections of this code for other projects
+ *without attribution and credit to the source. Specifically, if you copy into
+ *copyleft licenced code without attribution and retention of the permissive BSD
+ *3 clause licence, you grant a perpetual licence to do the same regarding turning sections of your code
+ *permissive, and lose any rights to use of this code previously granted or assumed.
+ *
+ *This code is intended to remain permissively licensed wherever it goes,
+ *maintaining the freedom to distribute compiled binaries WITHOUT a requirement to supply source.
+ *
+ *This is to ensure this code can at any point be used commercially, on products that may require
+ *such restriction to meet regulatory requirements, or to avoid damage to hardware, or to ensure
+ *warranties can reasonably be honoured.
+ ******************************************************************************
+ */
+
+
+#ifndef MESC_APLL_H
+#define MESC_APLL_H
+
+#include <stdint.h>
+
+/*
+Angles are in the usual 65536 counts per erev and speeds in counts per
+sample, so the result drops straight into PLL_angle and PLL_int.
+
+The loop poles are all placed at exp(-bw*T) (a fading memory filter), which
+gives critically damped tracking for any bandwidth, so the bandwidth can be
+moved every sample without retuning anything else.
+*/
+#define APLL_QUALITY_MIN  0.2f   // Noise never pulls the bandwidth below this fraction
+#define APLL_STAT_RATE    0.002f // Innovation statistics filter, per sample
+#define APLL_BWT_MAX      0.5f   // Bandwidth ceiling relative to the sample rate
+
+enum APLLType
+{
+    APLL_TYPE_NONE,    // Fixed gain PLL in fastLoop, PLL_kp and PLL_ki
+    APLL_TYPE_PI,      // Angle and speed, speed lags under acceleration
+    APLL_TYPE_KALMAN,  // Angle, speed and acceleration, no lag on a ramp
+};
+
+typedef enum APLLType APLLType;
+
+struct APLL
+{
+    uint8_t  type;       // APLLType, uint8_t so it can be set from the terminal
+
+    float    f;          // Sample frequency, Hz
+
+    // Bandwidth is ratio * the electrical speed in rad/s, limited to bw_min..bw_max
+    float    bw_min;     // rad/s
+    float    bw_max;     // rad/s
+    float    bw_ratio;
+
+    // Innovation noise (counts RMS) at which the bandwidth is halved
+    float    noise_ref;
+
+    uint32_t angle;      // Multi turn, as PLL_angle
+    float    frac;       // Fractional part of angle
+    float    omega;      // counts/sample
+    float    alpha;      // counts/sample^2, KALMAN only
+    float    err;        // Last proportional correction, counts
+
+    float    e_avg;
+    float    e2_avg;
+
+    float    quality;    // 0...1, 1 = noise free
+    float    bw;         // Bandwidth applied last sample, rad/s
+};
+
+typedef struct APLL APLL;
+
+void apll_init( APLL * const ap, float const f );
+
+/*
+Clear the state and restart from angle at standstill.
+*/
+void apll_reset( APLL * const ap, uint32_t const angle );
+
+/*
+Change the sample frequency, speed and acceleration are rescaled so the
+estimate in Hz is unchanged.
+*/
+void apll_set_frequency( APLL * const ap, float const f );
+
+/*
+Track one sample of measured angle.
+*/
+void apll_run( APLL * const ap, uint16_t const theta );
+
+float apll_eHz( APLL const * const ap );
+
+#endif
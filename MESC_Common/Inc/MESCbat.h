@@ -0,0 +1,178 @@
+/*
+* Copyright 2021-2023 cod3b453
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its contributors
+*    may be used to endorse or promote products derived from this software
+*    without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef MESC_BAT_H
+#define MESC_BAT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define BAT_PROFILE_SIGNATURE UINT32_C(0x4550424D) // "MBPE"
+
+enum BATDisplay
+{
+    BAT_DISPLAY_PERCENT,
+    BAT_DISPLAY_AMPHOUR,
+};
+
+typedef enum BATDisplay BATDisplay;
+
+/*
+Battery profile, as generated by MESCbat.js
+
+The open circuit voltage curve of a cell is given as the charge held (Ah) at
+four voltages; Vmin holds none. The curve is taken as linear between them.
+*/
+struct BATProfile
+{
+    struct
+    {
+    float       Imax;       // A
+    float       Vmax;       // V
+    float       Cmax;       // Ah
+    float       Vmid;       // V
+    float       Cmid;       // Ah
+    float       Vlow;       // V
+    float       Clow;       // Ah
+    float       Vmin;       // V
+    }           cell;
+
+    struct
+    {
+    float       Imax;       // A (fuse)
+    float       Pmax;       // W
+    float       ESR;        // Ohm, whole pack
+    uint8_t     parallel;
+    uint8_t     series;
+    uint8_t     _zero[2];
+    }           battery;
+
+    BATDisplay  display;
+};
+
+typedef struct BATProfile BATProfile;
+
+/*
+Battery engine
+
+Tracks the pack from its terminal voltage and current (positive discharging):
+
+- charge held by coulomb counting, pulled towards the open circuit voltage
+  curve by a scalar Kalman gain that falls where the curve is flat and when
+  the current (and with it the polarisation) is large
+- internal resistance by recursive least squares on sample to sample steps in
+  voltage and current, which cancels the slowly moving open circuit voltage
+- the EMF behind that resistance, E = V + I*R, from which the discharge and
+  charge currents that put the terminals at the profile Vmin and Vmax follow
+
+The discharge limit is also held under the current of maximum power transfer
+and the profile power and current limits.
+*/
+
+#define BAT_OCV_POINTS      4
+
+#define BAT_I_BIAS          0.5f    // A of current sensor error, grows the charge uncertainty
+#define BAT_V_SIGMA_CELL    0.01f   // V per cell of open circuit voltage uncertainty at rest
+#define BAT_V_MARGIN_CELL   0.02f   // V per cell kept clear of Vmin and Vmax by the limits
+#define BAT_R_FORGET        0.999f  // Resistance RLS forgetting factor per update
+#define BAT_R_STEP          0.02f   // Least current step, as a fraction of Imax, used for resistance
+#define BAT_K_EMF           0.2f    // EMF low pass per update
+#define BAT_T_REST          60.0f   // s, time constant of the current that sets the polarisation allowance
+#define BAT_T_CORR          60.0f   // s over which open circuit voltage errors are taken as correlated
+#define BAT_C_SEED          0.1f    // Charge uncertainty, as a fraction of Cmax, when seeded from the voltage
+
+struct BAT
+{
+    // Pack open circuit voltage curve, ascending
+    float       ocv_V[BAT_OCV_POINTS];  // V
+    float       ocv_C[BAT_OCV_POINTS];  // Ah held
+
+    float       Cmax;       // Ah
+    float       Vmin;       // V, with margin
+    float       Vmax;       // V, with margin
+    float       V_sigma;    // V, open circuit voltage uncertainty at rest
+    float       Imax;       // A
+    float       Pmax;       // W
+    float       R0;         // Ohm from the profile
+
+    // Estimates
+    float       C;          // Ah held
+    float       C_sd;       // Ah standard deviation
+    float       R;          // Ohm
+    float       R_P;        // RLS covariance
+    float       R_P0;       // RLS covariance limit
+    float       E;          // V behind R
+    float       I_rest;     // A, recent mean of |I|
+    float       V_last;
+    float       I_last;
+    bool        primed;
+
+    // Outputs
+    float       Idis;       // A discharge limit
+    float       Ichg;       // A charge limit, positive
+};
+
+typedef struct BAT BAT;
+
+/*
+Select the profile for the level functions and bat_get_profile; NULL selects
+the MESCbat.js defaults.
+*/
+void bat_init( BATProfile const * const profile );
+
+// Rebuild the curve after the selected profile has been changed
+void bat_notify_profile_update( void );
+
+BATProfile const * bat_get_profile( void );
+
+/*
+Charge level from the terminal voltage and current, in the units of the
+profile display setting (% or Ah).
+*/
+float bat_get_charge_level( float const V, float const I );
+
+// Open circuit voltage at a charge level in display units
+float bat_get_level_voltage( float const L );
+
+/*
+Reset the engine for a pack; NULL uses bat_get_profile. The charge is seeded
+from the voltage on the first update.
+*/
+void bat_reset( BAT * const bat, BATProfile const * const profile );
+
+/*
+Advance the engine by T seconds with the terminal voltage V and current I,
+positive discharging.
+*/
+void bat_update( BAT * const bat, float const V, float const I, float const T );
+
+// State of charge, 0..1
+float bat_get_soc( BAT const * const bat );
+
+#endif
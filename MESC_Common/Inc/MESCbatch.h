@@ -0,0 +1,217 @@
+/*
+ **
+ ******************************************************************************
+ * @file           : MESCbatch.h
+ * @brief          : Atomic multi-variable get/set transactions
+ ******************************************************************************
+ * @attention
+ *
+ * <h2><center>&copy; Copyright (c) 2020 David Molony.
+ * All rights reserved.</center></h2>
+ *
+ * This software component is licensed under BSD 3-Clause license,
+ * the "License"; You may not use this file except in compliance with the
+ * License. You may obtain a copy of the License at:
+ *                        opensource.org/licenses/BSD-3-Clause
+ *
+ ******************************************************************************
+ *In addition to the usual 3 BSD clauses, it is explicitly noted that you
+ *do NOT have the right to take sections of this code for other projects
+ *without attribution and credit to the source. Specifically, if you copy into
+ *copyleft licenced code without attribution and retention of the permissive BSD
+ *3 clause licence, you grant a perpetual licence to do the same regarding turning sections of your code
+ *permissive, and lose any rights to use of this code previously granted or assumed.
+ *
+ *This code is intended to remain permissively licensed wherever it goes,
+ *maintaining the freedom to distribute compiled binaries WITHOUT a requirement to supply source.
+ *
+ *This is to ensure this code can at any point be used commercially, on products that may require
+ *such restriction to meet regulatory requirements, or to avoid damage to hardware, or to ensure
+ *warranties can reasonably be honoured.
+ ******************************************************************************
+ */
+
+
+#ifndef MESC_BATCH_H
+#define MESC_BATCH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+A batch is a list of variable reads and writes that is validated as a whole by
+the terminal (or whichever task received it) and then handed to the slow loop,
+which applies every entry in one go between two of its iterations. The control
+code therefore never sees a half updated setup, and the change callbacks
+(calculateGains and friends) run once per batch rather than once per variable.
+
+    IDLE -> STAGING -> PENDING -> APPLIED
+      ^                                |
+      +--------------------------------+
+
+Text form, whitespace, ',' or ';' separated:
+
+    par_r=0.05 par_ld=80u par_lq=120u FOC_curr_BW=2k ehz
+
+Tokens with a value are writes, bare names are reads. Float values accept the
+same u/m/k/M suffixes as set.
+
+Frame form, records back to back:
+
+    [0x80 if read | name length][name][value, 4 bytes little endian, writes only]
+
+The value is an int32, uint32 or float according to the target variable.
+*/
+
+#define BATCH_MAX_ENTRIES 32
+#define BATCH_NAME_MAX    0x7F
+#define BATCH_FRAME_READ  0x80
+
+enum BATCHType
+{
+    BATCH_TYPE_UINT,
+    BATCH_TYPE_INT,
+    BATCH_TYPE_FLOAT,
+    BATCH_TYPE_BOOL,
+};
+
+typedef enum BATCHType BATCHType;
+
+enum BATCHError
+{
+    BATCH_OK,
+    BATCH_ERR_SYNTAX,   // Malformed token or record
+    BATCH_ERR_UNKNOWN,  // No variable by that name
+    BATCH_ERR_ACCESS,   // Not writable (or readable) from here
+    BATCH_ERR_TYPE,     // Strings and arrays cannot be batched
+    BATCH_ERR_RANGE,    // Value outside the variable's limits
+    BATCH_ERR_FULL,     // More than BATCH_MAX_ENTRIES
+    BATCH_ERR_BUSY,     // A previous batch has not been applied yet
+};
+
+typedef enum BATCHError BATCHError;
+
+enum BATCHState
+{
+    BATCH_STATE_IDLE,
+    BATCH_STATE_STAGING,
+    BATCH_STATE_PENDING,
+    BATCH_STATE_APPLIED,
+};
+
+typedef enum BATCHState BATCHState;
+
+union BATCH_VALUE
+{
+    uint32_t u;
+    int32_t  i;
+    float    f;
+};
+
+typedef union BATCH_VALUE BATCH_VALUE;
+
+// Filled in by the lookup callback
+struct BATCH_VAR
+{
+    void *      ptr;
+    uint8_t     type;
+    uint8_t     size;       // 1, 2 or 4 bytes (floats 4 only)
+    bool        readable;
+    bool        writable;
+    BATCH_VALUE min;
+    BATCH_VALUE max;
+    uintptr_t   group;      // Written entries sharing a non-zero group need one completion call
+    void *      tag;        // Opaque, handed back to the completion
+};
+
+typedef struct BATCH_VAR BATCH_VAR;
+
+/*
+Resolve name[0..len) into var. Return BATCH_OK, BATCH_ERR_UNKNOWN or
+BATCH_ERR_TYPE.
+*/
+typedef BATCHError (* batch_lookup)( void * ctx, char const * name, uint32_t len, BATCH_VAR * var );
+
+struct BATCH_ENTRY
+{
+    void *      ptr;
+    void *      tag;
+    uintptr_t   group;
+    BATCH_VALUE value;
+    uint8_t     type;
+    uint8_t     size;
+    bool        write;
+};
+
+typedef struct BATCH_ENTRY BATCH_ENTRY;
+
+struct BATCH;
+
+typedef void (* batch_complete)( struct BATCH * batch );
+
+struct BATCH
+{
+    BATCH_ENTRY       entry[BATCH_MAX_ENTRIES];
+    uint32_t          count;
+
+    volatile uint32_t state;
+    uint32_t          applied; // Batches applied so far
+
+    // Called by batch_apply once every entry has been written
+    batch_complete    complete;
+
+    // First failing token or record, for reporting
+    BATCHError        error;
+    uint32_t          error_index;
+};
+
+typedef struct BATCH BATCH;
+
+void batch_init( BATCH * const batch, batch_complete const complete );
+
+/*
+Start staging a new batch, discarding the results of the last one. Fails with
+BATCH_ERR_BUSY while a batch is pending.
+*/
+BATCHError batch_begin( BATCH * const batch );
+
+/*
+Stage a write of value (in the variable's own type) or a read. A second write
+to the same variable replaces the first.
+*/
+BATCHError batch_stage( BATCH * const batch, BATCH_VAR const * const var, bool const write, BATCH_VALUE const value );
+
+// Stage a single "name=value" or "name" token
+BATCHError batch_parse_token( BATCH * const batch, char const * const token, uint32_t const len, batch_lookup const lookup, void * const ctx );
+
+/*
+Begin a batch and stage all of text or frame. On any error nothing is staged,
+the batch returns to IDLE and error/error_index describe the problem.
+*/
+BATCHError batch_parse_text( BATCH * const batch, char const * const text, batch_lookup const lookup, void * const ctx );
+BATCHError batch_parse_frame( BATCH * const batch, uint8_t const * const data, uint32_t const len, batch_lookup const lookup, void * const ctx );
+
+// Hand the staged batch to batch_apply
+BATCHError batch_commit( BATCH * const batch );
+
+// Abandon a batch that has not been committed
+void batch_abort( BATCH * const batch );
+
+/*
+Called from the slow loop. Applies a pending batch, then the completion.
+Returns the number of entries processed (0 when nothing was pending).
+*/
+uint32_t batch_apply( BATCH * const batch );
+
+BATCHState batch_state( BATCH const * const batch );
+
+// True for the first entry of its group, the one the completion should act on
+bool batch_first_of_group( BATCH const * const batch, uint32_t const index );
+
+/*
+Reply frame: [error][error_index][count] then the 4 byte value of every entry
+after the batch was applied. Returns the length written or 0 if it does not fit.
+*/
+uint32_t batch_reply( BATCH const * const batch, uint8_t * const buf, uint32_t const max );
+
+#endif
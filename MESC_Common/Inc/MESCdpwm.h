@@ -0,0 +1,104 @@
+/*
+ **
+ ******************************************************************************
+ * @file           : MESCdpwm.h
+ * @brief          : Discontinuous PWM strategies
+ ******************************************************************************
+ * @attention
+ *
+ * <h2><center>&copy; Copyright (c) 2020 David Molony.
+ * All rights reserved.</center></h2>
+ *
+ * This software component is licensed under BSD 3-Clause license,
+ * the "License"; You may not use this file except in compliance with the
+ * License. You may obtain a copy of the License at:
+ *                        opensource.org/licenses/BSD-3-Clause
+ *
+ ******************************************************************************
+ *In addition to the usual 3 BSD clauses, it is explicitly noted that you
+ *do NOT have the right to take sections of this code for other projects
+ *without attribution and credit to the source. Specifically, if you copy into
+ *copyleft licenced code without attribution and retention of the permissive BSD
+ *3 clause licence, you grant a perpetual licence to do the same regarding turning sections of your code
+ *permissive, and lose any rights to use of this code previously granted or assumed.
+ *
+ *This code is intended to remain permissively licensed wherever it goes,
+ *maintaining the freedom to distribute compiled binaries WITHOUT a requirement to supply source.
+ *
+ *This is to ensure this code can at any point be used commercially, on products that may require
+ *such restriction to meet regulatory requirements, or to avoid damage to hardware, or to ensure
+ *warranties can reasonably be honoured.
+ ******************************************************************************
+ */
+
+#ifndef MESC_DPWM_H
+#define MESC_DPWM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define DPWM_PHASE_NONE 3 // Matches N in HighPhase_e; no phase is held on the top rail
+
+/*
+Below this modulation index (relative to the linear limit) the clamped phase
+would sit at the rail for most of the 60 degree window with tiny neighbouring
+duties; ripple rises faster than the switching loss falls, so AUTO reverts to
+continuous SVPWM.
+*/
+#define DPWM_M_MIN_DEFAULT 0.5f
+
+enum DPWMType
+{
+    DPWM_TYPE_DPWM0, // 60 degree clamps leading the voltage peak by 30 degrees (leading pf)
+    DPWM_TYPE_DPWM1, // 60 degree clamps centred on the voltage peak (unity pf)
+    DPWM_TYPE_DPWM2, // 60 degree clamps lagging the voltage peak by 30 degrees (lagging pf)
+    DPWM_TYPE_MAX,   // 120 degree clamps to the top rail
+    DPWM_TYPE_MIN,   // 120 degree clamps to the bottom rail, as PWM_BOTTOM_CLAMP
+    DPWM_TYPE_GDPWM, // 60 degree clamps centred on the current peak, psi from the measured pf
+    DPWM_TYPE_AUTO,  // GDPWM above m_min, continuous below
+
+    DPWM_TYPE_CONTINUOUS, // Not selectable; the active strategy when AUTO is below m_min
+};
+
+typedef enum DPWMType DPWMType;
+
+struct DPWM
+{
+    uint8_t  type;   // Requested DPWMType, sized for the terminal variable list
+    DPWMType active; // Strategy in use, resolved by dpwm_update
+
+    float    m_min;  // AUTO threshold, relative to the linear limit
+
+    // Clamp window shift (rad, positive = lagging the voltage)
+    float    psi;
+    float    cos_psi;
+    float    sin_psi;
+
+    // Load power factor angle (rad, current lagging voltage) from the last update
+    float    phi;
+};
+
+typedef struct DPWM DPWM;
+
+void dpwm_init( DPWM * const dp );
+
+/*
+Resolve the active strategy and clamp shift from the modulation index m and
+the dq voltage and current. Intended for the slow loop.
+*/
+void dpwm_update( DPWM * const dp, float const m,
+                  float const Vd, float const Vq, float const Id, float const Iq );
+
+/*
+Add the zero sequence to the three zero-sequence free phase voltages V[]
+(Volts) so that the selected phase is held on a rail. Va/Vb are the Clark
+components of the same request.
+
+Returns false (and leaves V[] untouched) when the active strategy is
+continuous. On success V[] is centred on zero within +/-Vbus/2 and *high is
+the phase index held on the top rail, or DPWM_PHASE_NONE.
+*/
+bool dpwm_apply( DPWM const * const dp, float const Vbus, float const Va, float const Vb,
+                 float V[3], uint32_t * const high );
+
+#endif
@@ -0,0 +1,260 @@
+/*
+ **
+ ******************************************************************************
+ * @file           : MESCencoder.h
+ * @brief          : Encoder angle and speed for the FOC angle path
+ ******************************************************************************
+ * @attention
+ *
+ * <h2><center>&copy; Copyright (c) 2020 David Molony.
+ * All rights reserved.</center></h2>
+ *
+ * This software component is licensed under BSD 3-Clause license,
+ * the "License"; You may not use this file except in compliance with the
+ * License. You may obtain a copy of the License at:
+ *                        opensource.org/licenses/BSD-3-Clause
+ *
+ ******************************************************************************
+ *In addition to the usual 3 BSD clauses, it is explicitly noted that you
+ *do NOT have the right to take sections of this code for other projects
+ *without attribution and credit to the source. Specifically, if you copy into
+ *copyleft licenced code without attribution and retention of the permissive BSD
+ *3 clause licence, you grant a perpetual licence to do the same regarding turning sections of your code
+ *permissive, and lose any rights to use of this code previously granted or assumed.
+ *
+ *This code is intended to remain permissively licensed wherever it goes,
+ *maintaining the freedom to distribute compiled binaries WITHOUT a requirement to supply source.
+ *
+ *This is to ensure this code can at any point be used commercially, on products that may require
+ *such restriction to meet regulatory requirements, or to avoid damage to hardware, or to ensure
+ *warranties can reasonably be honoured.
+ ******************************************************************************
+ */
+
+
+
+#ifndef MESC_ENCODER_H
+#define MESC_ENCODER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+The position is kept in the encoder's own counts, 0..counts-1 per mechanical
+rev, whatever the source:
+  - ABI: the timer counter in encoder mode, 16 bit and free running, with the
+    index captured on CCR3. Counts are taken as deltas, so counts need not
+    divide 65536, and the position is counted from the last index. An index
+    that disagrees with the count kept since the one before is a lost count,
+    counted in index_errors. Until the first index the position is only
+    relative, so without an index the offset has to be found at every start.
+  - Absolute (SPI, PWM): the angle read, in counts.
+
+The electrical angle is pole_pairs times the position, taken modulo counts
+before scaling to 65536 per erev, so it is exact for any count and pole pair
+number, plus offset. invert runs the position backwards.
+
+Speed comes from a second order tracking loop on the position at bw Hz,
+corrected on each new sample. The angle is the last sample carried forward
+at that speed over its age, the sensor delay, and advance PWM periods. The
+fastloop uses one angle for the current and the voltage transforms, the
+currents sampled at the top of the period and the voltage centred on the
+next, so the default advance is half way between.
+
+Calibration drags the rotor round with d axis current:
+  ALIGN   hold angle 0 for settle s
+  PROBE   sweep forward erevs; the travel gives the direction and pole pairs
+  FWD     sweep one mechanical rev forward
+  BWD     and back
+The offset is the mean of command less encoder over FWD and BWD; a whole
+mechanical rev takes out the eccentricity and the two directions the lag,
+which is kept as lag.
+
+What is left of command less encoder over the rev is the encoder's own error,
+magnet eccentricity at once per rev and sensor nonlinearity at twice and
+above. FWD and BWD average it into ENCODER_CAL_BINS bins of the position,
+leaving out the first ENCODER_CAL_TURN erev of each sweep while the rotor
+turns round and takes up the lag. The lag is taken out of each bin by how
+many of its samples came from each direction, and the first
+ENCODER_HARMONICS harmonics of the bins are fitted into harm, a correction to
+the position in counts, so it still holds if pole_pairs changes.
+encoder_comp_build turns harm into comp, the electrical correction at
+ENCODER_COMP_SIZE points of the rev, and the angle adds comp interpolated at
+the position.
+*/
+
+#define ENCODER_BW_DEFAULT      200.0f // Hz
+#define ENCODER_ADVANCE_DEFAULT 0.5f   // PWM periods
+#define ENCODER_TIMEOUT         0.01f  // s without a sample before the encoder is failed
+#define ENCODER_ERR_MAX         8      // Bad reads in a row before the encoder is failed
+#define ENCODER_INDEX_TOL       1      // counts an index may disagree before it is a lost count
+
+#define ENCODER_CAL_SPEED       2.0f   // erev/s
+#define ENCODER_CAL_EREVS       4.0f   // erev, probe sweep
+#define ENCODER_CAL_SETTLE      0.5f   // s
+#define ENCODER_PP_MAX          255
+
+#define ENCODER_HARMONICS       4      // Mechanical harmonics in the compensation
+#define ENCODER_COMP_SIZE       64     // Compensation points per mechanical rev, a power of 2
+#define ENCODER_CAL_BINS        32     // Error bins per mechanical rev in the calibration
+#define ENCODER_CAL_TURN        0.25f  // erev at the start of a sweep left out of the bins
+
+enum EncoderSource
+{
+    ENCODER_SOURCE_NONE,
+    ENCODER_SOURCE_ABI,      // Timer in encoder mode, index on CCR3
+    ENCODER_SOURCE_ABSOLUTE, // SPI or PWM absolute angle
+};
+
+typedef enum EncoderSource EncoderSource;
+
+enum EncoderCalPhase
+{
+    ENCODER_CAL_IDLE,
+    ENCODER_CAL_ALIGN,
+    ENCODER_CAL_PROBE,
+    ENCODER_CAL_FWD,
+    ENCODER_CAL_BWD,
+    ENCODER_CAL_DONE,
+};
+
+typedef enum EncoderCalPhase EncoderCalPhase;
+
+enum EncoderCalResult
+{
+    ENCODER_CAL_OK,
+    ENCODER_CAL_NO_MOTION,   // The encoder barely moved in the probe
+    ENCODER_CAL_POLES,       // Pole pairs out of range, or the sweep was not one mechanical rev
+    ENCODER_CAL_FAULT,       // The encoder failed during the sweep
+    ENCODER_CAL_GAPS,        // Part of the rev was never seen, so no harmonics
+};
+
+typedef enum EncoderCalResult EncoderCalResult;
+
+struct ENCODERCal
+{
+    // Configuration
+    float    speed;      // erev/s
+    float    erevs;      // Probe sweep, erev
+    float    settle;     // s
+
+    uint8_t  phase;      // EncoderCalPhase
+    uint8_t  result;     // EncoderCalResult
+    float    t;          // s in this phase
+    float    swept;      // erev swept in this phase
+    float    angle;      // erev, command
+    uint32_t pos_last;
+    int32_t  travel;     // counts, this sweep
+    int32_t  d0;         // First command less encoder, counts
+    int64_t  sum[2];     // FWD, BWD, command less encoder less d0
+    uint32_t n[2];
+    float    lag;        // counts, half the FWD to BWD difference
+    int32_t  bin_sum[ENCODER_CAL_BINS];    // Command less encoder less d0, FWD and BWD
+    uint32_t bin_n[2][ENCODER_CAL_BINS];   // FWD, BWD
+};
+
+typedef struct ENCODERCal ENCODERCal;
+
+struct ENCODER
+{
+    // Configuration
+    uint8_t  source;     // EncoderSource
+    uint32_t counts;     // Per mechanical rev, up to 65536
+    uint8_t  pole_pairs;
+    bool     invert;
+    uint16_t offset;     // Electrical angle at position 0, 65536 per erev
+    float    bw;         // Hz, speed tracking
+    float    delay;      // s, from the sensor seeing the angle to the sample
+    float    advance;    // PWM periods
+    float    harm[ENCODER_HARMONICS][2]; // counts, cos and sin of each mechanical harmonic of the position correction
+
+    // Position
+    uint32_t pos;        // counts
+    uint16_t cnt_last;   // ABI counter
+    uint16_t idx_last;   // ABI index capture
+    bool     counting;   // cnt_last and idx_last are set
+    bool     indexed;
+    bool     fresh;      // A sample not yet taken into the loop
+    bool     primed;
+
+    // Tracking
+    float    theta;      // counts
+    float    omega;      // counts/s, mechanical
+    float    age;        // s since the sample
+    float    since;      // s since the sample before
+
+    // Compensation
+    int16_t  comp[ENCODER_COMP_SIZE]; // Electrical, harm at each point
+    bool     comp_on;
+
+    // Output
+    uint16_t angle;      // Electrical, 65536 per erev
+    float    eHz;
+
+    uint32_t samples;
+    uint32_t errors;
+    uint32_t err_run;
+    uint32_t index_errors;
+
+    ENCODERCal cal;
+};
+
+typedef struct ENCODER ENCODER;
+
+void encoder_init( ENCODER * const enc );
+
+/*
+Set the counts per mechanical rev and the pole pairs; the tracking restarts
+if either changed. The compensation is rebuilt.
+*/
+void encoder_config( ENCODER * const enc, uint32_t const counts, uint8_t const pole_pairs );
+
+/*
+New ABI sample: the timer counter and the count captured at the last index.
+*/
+void encoder_abi( ENCODER * const enc, uint16_t const cnt, uint16_t const idx );
+
+/*
+New absolute sample, counts.
+*/
+void encoder_abs( ENCODER * const enc, uint32_t const raw );
+
+/*
+A read failed or timed out.
+*/
+void encoder_fault( ENCODER * const enc );
+
+/*
+Advance by T seconds, one PWM period, and return the electrical angle at the
+PWM centre.
+*/
+uint16_t encoder_run( ENCODER * const enc, float const T );
+
+bool encoder_ok( ENCODER const * const enc );
+
+/*
+Electrical angle of position pos, without the offset.
+*/
+uint16_t encoder_elec( ENCODER const * const enc, uint32_t const pos );
+
+/*
+Build comp from harm, pole_pairs and invert.
+*/
+void encoder_comp_build( ENCODER * const enc );
+
+/*
+Electrical correction at position pos.
+*/
+int16_t encoder_comp( ENCODER const * const enc, uint32_t const pos );
+
+void encoder_cal_start( ENCODER * const enc );
+
+/*
+Advance the calibration by T seconds after encoder_run and return the angle
+to hold the d axis current at. At ENCODER_CAL_DONE the result is in
+cal.result and, if ENCODER_CAL_OK, invert, pole_pairs, offset and harm are
+set and comp built.
+*/
+uint16_t encoder_cal_run( ENCODER * const enc, float const T );
+
+#endif
@@ -83,9 +83,12 @@ struct MESC_log_vars
 #define ERROR_INPUT_OOR 27
 #define ERROR_STARTUP 28
 #define ERROR_APP 29
+#define ERROR_HEALTH 30 //Warning only, does not stop the motor
+#define ERROR_ENCODER 31
 
 
 void handleError(MESC_motor_typedef *_motor, uint32_t error_code);
+void handleWarning(uint32_t error_code);
 void clearErrors();
 
 #endif /* INC_MESCERROR_H_ */
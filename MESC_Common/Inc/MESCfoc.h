@@ -42,6 +42,21 @@
 #include "stm32fxxx_hal.h"
 #include "MESCmotor_state.h"
 #include "MESCtemp.h"
+#include "MESCovermod.h"
+#include "MESCdpwm.h"
+#include "MESCfsched.h"
+#include "MESChallest.h"
+#include "MESCapll.h"
+#include "MESChealth.h"
+#include "MESCbatch.h"
+#include "MESCbat.h"
+#include "MESCthermal.h"
+#include "MESCtraj.h"
+#include "MESCspeedloop.h"
+#include "MESCsixstep.h"
+#include "MESCtraction.h"
+#include "MESCinfilt.h"
+#include "MESCencoder.h"
 
 //#include "MESCposition.h"
 #define LOGGING
@@ -77,6 +92,7 @@
 #define MAX_MODULATION 0.95f //default is 0.95f, can allow higher or lower. up to
 							//1.1 stable with 5 sector switching,
 							//1.05 is advised as max for low side shunts
+							//With overmodulation enabled, up to OVERMOD_SIX_STEP_RATIO (1.1027) which is full six-step
 #endif
 
 #ifndef MIN_HALL_FLUX_VOLTS
@@ -139,6 +155,9 @@
 #ifndef DEFAULT_SPEED_KI
 #define DEFAULT_SPEED_KI 0.1f //Amps per eHz per slowloop period... ToDo make it per second. At 100Hz slowloop, 0.1f corresponds to a 10Hz integral.
 #endif
+#ifndef DEFAULT_INERTIA
+#define DEFAULT_INERTIA 0.0f //kg m^2 at the rotor, 0 disables the acceleration and load feedforwards
+#endif
 
 #ifndef ADC_OFFSET_DEFAULT
 #define ADC_OFFSET_DEFAULT 2048.0f
@@ -159,16 +178,11 @@
 #endif
 
 #ifndef POS_KP
-#define POS_KP 0.0002f
-#endif
-#ifndef POS_KI
-#define POS_KI 0.1f
-#endif
-#ifndef POS_KD
-#define POS_KD 0.002f
+#define POS_KP 10.0f //Position error to speed, 1/s
 #endif
 
 
+
 #ifndef DEFAULT_CONTROL_MODE
 #define DEFAULT_CONTROL_MODE MOTOR_CONTROL_MODE_TORQUE
 #endif
@@ -306,18 +320,12 @@ typedef struct {
   uint32_t encoder_pulse;
   uint32_t encoder_OK;
   uint16_t enc_angle;
+  uint16_t enc_offset; //As stored, in the convention of the encoder source, see encoderConfig
+  uint16_t encoder_polarity_invert;
   float FOC_advance;
 
-  uint16_t enc_period_count;//For PWM encoder interpolation
-  uint16_t enc_ratio;//For ABI encoder PPR to uint16_t conversion
-  uint16_t last_enc_period;
-  uint16_t last_enc_angle;
-  int16_t enc_pwm_step;
-
-  uint16_t enc_offset;
   float encsin;
   float enccos;
-  uint16_t encoder_polarity_invert;
   int enc_obs_angle;
   uint16_t parkangle;
   float park_current;
@@ -352,7 +360,7 @@ typedef struct {
   float speed_req;
   float speed_kp;
   float speed_ki;
-  float speed_error_int;
+  float inertia;								//kg m^2 at the rotor, for the position and speed loop feedforwards
 
   //Observer parameters
   float Ia_last;
@@ -433,6 +441,7 @@ typedef struct {
   float IIR[2];
   uint32_t cycles_fastloop;
   uint32_t cycles_pwmloop;
+  uint32_t cycles_budget; //CPU cycles in one PWM period
 } MESCfoc_s;
 
 extern MESCfoc_s foc_vars;
@@ -536,17 +545,8 @@ typedef struct{
 
 /////////////Position controller data
 typedef struct{
-	float Kp;
-	float Ki;
-	float Kd;
-	float error;
-	uint32_t last_pll_pos;
-	float d_pos;
-	float p_error;
-	float d_error;
-	float int_error;
-	uint32_t set_position;
-	int32_t deadzone;
+	TRAJ traj; //Planner and position/speed loop, see MESCtraj.h
+	uint32_t set_position; //Target, counts (65536 per erev) on the PLL_angle scale
 }MESCPos_s;
 
 //Logging
@@ -614,10 +614,15 @@ typedef struct {
 
 
 	uint8_t remote_ADC_can_id;
+	float remote_ADC1_raw; //As received, the _req are after filtering
+	float remote_ADC2_raw;
 	float remote_ADC1_req;
 	float remote_ADC2_req;
 	int32_t remote_ADC_timeout;
 
+	INFILT filt[INFILT_SOURCES]; //Per source filter chain, see MESCinfilt.h
+	uint8_t arb_mode; //INFILT_ARB_SUM or INFILT_ARB_PRIORITY
+
 
 	uint16_t nKillswitch;
 	uint16_t invert_killswitch;
@@ -700,7 +705,8 @@ enum PWM_TYPE
 	PWM_SVPWM = 0,
 	PWM_SIN = 1,
 	PWM_BOTTOM_CLAMP = 2,
-	PWM_SIN_BOTTOM = 3
+	PWM_SIN_BOTTOM = 3,
+	PWM_DPWM = 4
 };
 enum APP_TYPE
 {
@@ -727,6 +733,13 @@ typedef struct {
 	uint8_t sqrt_circle_lim;
 	uint8_t observer_type;
 	uint8_t pwm_type;
+	uint8_t overmod_type;
+	bool use_pwm_scheduler;
+	bool use_hall_estimator;
+	bool use_bat_limits;
+	bool use_thermal_model;
+	bool use_sixstep;
+	bool use_traction;
 	uint8_t app_type;
 } MESCoptionFlags_s;
 
@@ -750,7 +763,11 @@ typedef struct{
 	MESC_offset_typedef offset;
 	MESCfoc_s FOC;
 	MESCPos_s pos;
+	SPEEDLOOP speedloop;
 	MESCBLDC_s BLDC;
+	SIXSTEP sixstep;
+	TRACTION traction;
+	ENCODER encoder;
 	MOTORProfile m;
 	MESCmeas_s meas;
 	MESChall_s hall;
@@ -760,6 +777,16 @@ typedef struct{
 	MESCtest_s test_vals;
 	input_vars_t input_vars;
 	MESClrobs_s lrobs;
+	OVERMOD overmod;
+	DPWM dpwm;
+	FSCHED fsched;
+	HALLEST hallest;
+	APLL apll;
+	HEALTH_ISR health_fastloop;
+	HEALTH_ISR health_pwmloop;
+	BATCH batch;
+	BAT bat;
+	THERMAL thermal;
 	MESCoptionFlags_s options;
 	bool conf_is_valid;
 }MESC_motor_typedef;
@@ -833,6 +860,7 @@ void hallAngleEstimator();  // Going to attempt to make a similar hall angle
                             // angle from hall offsets.
 float fast_atan2(float y, float x);
 void angleObserver(MESC_motor_typedef *_motor);
+void hallEstimatorRun(MESC_motor_typedef *_motor); //Learned edge hall estimator, blends into the flux observer with speed
 void OLGenerateAngle(MESC_motor_typedef *_motor);  // For open loop FOC startup, just use this to generate
                          // an angle and velocity ramp, then keep the phase
                          // currents at the requested value without really
@@ -845,8 +873,11 @@ void MESCFOC(MESC_motor_typedef *_motor);  // Field and quadrature current contr
 
 
 void calculateGains(MESC_motor_typedef *_motor);
+void calculatePWMTiming(MESC_motor_typedef *_motor);
+void setPWMFrequency(MESC_motor_typedef *_motor, float f);
 void calculateVoltageGain(MESC_motor_typedef *_motor);
 void calculateFlux(MESC_motor_typedef *_motor);
+float calculateAccelerationGain(MESC_motor_typedef *_motor);
 
 //void MESCmeasure_DoublePulseTest(MESC_motor_typedef *_motor);
 
@@ -859,6 +890,9 @@ void deadshort(MESC_motor_typedef *_motor);
 void tle5012(MESC_motor_typedef *_motor);
 void HallFluxMonitor(MESC_motor_typedef *_motor);
 void getIncEncAngle(MESC_motor_typedef *_motor);
+void encoderConfig(MESC_motor_typedef *_motor); //Encoder source and counts from the board and the motor profile
+void encoderStore(MESC_motor_typedef *_motor); //Offset and polarity from the encoder back to the stored settings, after a calibration
+void encoderRun(MESC_motor_typedef *_motor); //Sample the encoder and project its angle to the PWM centre, see MESCencoder.h
 void logVars(MESC_motor_typedef *_motor);
 void printSamples(UART_HandleTypeDef *uart, DMA_HandleTypeDef *dma);
 void RunMTPA(MESC_motor_typedef *_motor);
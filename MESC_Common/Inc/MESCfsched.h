@@ -0,0 +1,92 @@
+/*
+ **
+ ******************************************************************************
+ * @file           : MESCfsched.h
+ * @brief          : Variable PWM frequency scheduler
+ ******************************************************************************
+ * @attention
+ *
+ * <h2><center>&copy; Copyright (c) 2020 David Molony.
+ * All rights reserved.</center></h2>
+ *
+ * This software component is licensed under BSD 3-Clause license,
+ * the "License"; You may not use this file except in compliance with the
+ * License. You may obtain a copy of the License at:
+ *                        opensource.org/licenses/BSD-3-Clause
+ *
+ ******************************************************************************
+ *In addition to the usual 3 BSD clauses, it is explicitly noted that you
+ *do NOT have the right to take sections of this code for other projects
+ *without attribution and credit to the source. Specifically, if you copy into
+ *copyleft licenced code without attribution and retention of the permissive BSD
+ *3 clause licence, you grant a perpetual licence to do the same regarding turning sections of your code
+ *permissive, and lose any rights to use of this code previously granted or assumed.
+ *
+ *This code is intended to remain permissively licensed wherever it goes,
+ *maintaining the freedom to distribute compiled binaries WITHOUT a requirement to supply source.
+ *
+ *This is to ensure this code can at any point be used commercially, on products that may require
+ *such restriction to meet regulatory requirements, or to avoid damage to hardware, or to ensure
+ *warranties can reasonably be honoured.
+ ******************************************************************************
+ */
+
+#ifndef MESC_FSCHED_H
+#define MESC_FSCHED_H
+
+#include <stdint.h>
+
+/*
+Anything counted in PWM cycles (the PLL, open loop steps, hall tick counts)
+must be rescaled when the frequency changes; anything in seconds (observer
+integration, PI integral gains) only needs pwm_period updating. The current
+loop bandwidth is in rad/s and is left alone, the scheduler instead refuses
+to go below FSCHED_BW_RATIO * Current_bandwidth.
+*/
+#define FSCHED_BW_RATIO          2.0f   // Hz of PWM per rad/s of current loop bandwidth
+#define FSCHED_SAMPLES_PER_EREV  20.0f  // Never fewer PWM cycles than this per erev
+#define FSCHED_HYSTERESIS        0.05f  // Ignore target changes smaller than this fraction
+#define FSCHED_SLEW              0.10f  // Largest fractional step per update
+
+struct FSCHED
+{
+    float f_min;      // Hz
+    float f_max;      // Hz
+
+    // Speed schedule; f_min at or below eHz_lo rising linearly to f_max at eHz_hi
+    float eHz_lo;
+    float eHz_hi;
+
+    // Thermal derate; f_max at or below T_lo falling linearly to f_min at T_hi
+    float T_lo;
+    float T_hi;
+
+    float f_target;   // Unslewed result of the last update
+    float f_req;      // Frequency the fast loop should be running at
+
+    uint8_t floor_limited; // Set when a floor is above f_max; f_max is used and the floor is not met
+};
+
+typedef struct FSCHED FSCHED;
+
+void fsched_init( FSCHED * const fs, float const f_nominal );
+
+/*
+Compute the requested frequency from the electrical speed, the hottest
+switch temperature and the current loop bandwidth (rad/s). f_now is the
+frequency presently running. The result never exceeds f_max, even when the
+erev or bandwidth floor asks for more; fs->floor_limited reports that case.
+Returns fs->f_req.
+*/
+float fsched_update( FSCHED * const fs, float const f_now,
+                     float const eHz, float const T, float const bandwidth );
+
+/*
+Rescale the PLL for a change from f_old to f_new so that its continuous
+time bandwidth, damping and speed estimate are unchanged.
+*/
+void fsched_rescale_pll( float const f_old, float const f_new,
+                         float * const kp, float * const ki,
+                         float * const integral, float * const error );
+
+#endif
@@ -0,0 +1,120 @@
+/*
+ **
+ ******************************************************************************
+ * @file           : MESChallest.h
+ * @brief          : Hall sensor angle estimator with learned edges
+ ******************************************************************************
+ * @attention
+ *
+ * <h2><center>&copy; Copyright (c) 2020 David Molony.
+ * All rights reserved.</center></h2>
+ *
+ * This software component is licensed under BSD 3-Clause license,
+ * the "License"; You may not use this file except in compliance with the
+ * License. You may obtain a copy of the License at:
+ *                        opensource.org/licenses/BSD-3-Clause
+ *
+ ******************************************************************************
+ *In addition to the usual 3 BSD clauses, it is explicitly noted that you
+ *do NOT have the right to take sections of this code for other projects
+ *without attribution and credit to the source. Specifically, if you copy into
+ *copyleft licenced code without attribution and retention of the permissive BSD
+ *3 clause licence, you grant a perpetual licence to do the same regarding turning sections of your code
+ *permissive, and lose any rights to use of this code previously granted or assumed.
+ *
+ *This code is intended to remain permissively licensed wherever it goes,
+ *maintaining the freedom to distribute compiled binaries WITHOUT a requirement to supply source.
+ *
+ *This is to ensure this code can at any point be used commercially, on products that may require
+ *such restriction to meet regulatory requirements, or to avoid damage to hardware, or to ensure
+ *warranties can reasonably be honoured.
+ ******************************************************************************
+ */
+
+#ifndef MESC_HALLEST_H
+#define MESC_HALLEST_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define HALLEST_STATES        6
+
+#define HALLEST_DIR_FWD       0
+#define HALLEST_DIR_BWD       1
+
+#define HALLEST_TIMEOUT       0.1f  // s without an edge before the rotor is taken as stopped
+#define HALLEST_K_TIMING      0.1f  // Edge learning gain from erev timing
+#define HALLEST_K_OBSERVER    0.02f // Edge learning gain from the flux observer
+#define HALLEST_EREV_SPREAD   0.1f  // Largest erev to erev period change accepted for timing calibration
+
+struct HALLEST
+{
+    // Angle (counts, 65536 per erev) at which each hall state (index state-1)
+    // is entered, going forwards and backwards. These differ by the sensor
+    // hysteresis and both are learned.
+    float    enter[2][HALLEST_STATES];
+
+    // Forward successor of each state (index state-1), -1 if unknown
+    int8_t   next[HALLEST_STATES];
+
+    // Motion model, anchored at the last edge
+    float    t;          // s since the last edge
+    float    dt;         // s between the last two edges
+    float    theta_edge; // counts
+    float    omega;      // counts/s at the last edge, signed
+    float    alpha;      // counts/s^2, signed
+    float    omega_avg;  // Mean speed over the last interval, signed
+    uint32_t edges;      // Consecutive same direction edges in the model
+
+    int      state;
+    uint32_t dir;
+    float    T;          // Last call period, s
+    float    angle;      // counts, output
+
+    // Edge seen on this call, for hallest_observe
+    bool     edge_now;
+    uint32_t edge_dir;
+    int      edge_state;
+
+    // Timing calibration over one erev
+    int      cal_state[HALLEST_STATES];
+    float    cal_time[HALLEST_STATES];
+    uint32_t cal_n;
+    float    cal_t;
+    float    cal_T_prev;
+
+    // Blend into the flux observer; all hall below eHz_lo, all observer above eHz_hi
+    float    eHz_lo;
+    float    eHz_hi;
+};
+
+typedef struct HALLEST HALLEST;
+
+/*
+Seed the edges from the measured hall table (start, end, centre, width).
+*/
+void hallest_init( HALLEST * const he, uint16_t table[HALLEST_STATES][4] );
+
+/*
+Advance the estimator by T seconds with the current hall state (1..6) and
+return the electrical angle. Invalid states leave the estimate unchanged.
+*/
+uint16_t hallest_run( HALLEST * const he, int const hall_state, float const T );
+
+/*
+Electrical speed in Hz from the motion model.
+*/
+float hallest_eHz( HALLEST const * const he );
+
+/*
+Weight of the flux observer in the output angle; 0 = hall only, 1 = observer only.
+*/
+float hallest_blend( HALLEST const * const he, float const eHz );
+
+/*
+Refine the edge just crossed (if any) against a trusted angle, e.g. the flux
+observer at speed. Call after hallest_run.
+*/
+void hallest_observe( HALLEST * const he, uint16_t const angle );
+
+#endif
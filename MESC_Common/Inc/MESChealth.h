@@ -0,0 +1,131 @@
+/*
+ **
+ ******************************************************************************
+ * @file           : MESChealth.h
+ * @brief          : Stack and ISR budget health statistics
+ ******************************************************************************
+ * @attention
+ *
+ * <h2><center>&copy; Copyright (c) 2020 David Molony.
+ * All rights reserved.</center></h2>
+ *
+ * This software component is licensed under BSD 3-Clause license,
+ * the "License"; You may not use this file except in compliance with the
+ * License. You may obtain a copy of the License at:
+ *                        opensource.org/licenses/BSD-3-Clause
+ *
+ ******************************************************************************
+ *In addition to the usual 3 BSD clauses, it is explicitly noted that you
+ *do NOT have the right to take sections of this code for other projects
+ *without attribution and credit to the source. Specifically, if you copy into
+ *copyleft licenced code without attribution and retention of the permissive BSD
+ *3 clause licence, you grant a perpetual licence to do the same regarding turning sections of your code
+ *permissive, and lose any rights to use of this code previously granted or assumed.
+ *
+ *This code is intended to remain permissively licensed wherever it goes,
+ *maintaining the freedom to distribute compiled binaries WITHOUT a requirement to supply source.
+ *
+ *This is to ensure this code can at any point be used commercially, on products that may require
+ *such restriction to meet regulatory requirements, or to avoid damage to hardware, or to ensure
+ *warranties can reasonably be honoured.
+ ******************************************************************************
+ */
+
+
+#ifndef MESC_HEALTH_H
+#define MESC_HEALTH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define HEALTH_MAX_TASKS     16
+#define HEALTH_NAME_LEN      16
+
+#define HEALTH_WARN_STACK    (1u << 0) // A task has dipped below stack_warn words free
+#define HEALTH_WARN_ISR      (1u << 1) // Worst ISR duration above isr_warn of the budget
+#define HEALTH_WARN_OVERRUN  (1u << 2) // More than overrun_warn new overruns since the last check
+#define HEALTH_WARN_TASKS    (1u << 3) // More tasks than HEALTH_MAX_TASKS, some are not watched
+
+/*
+Kept per interrupt, written from the interrupt itself so it must stay cheap.
+Only the interrupt writes the counters; anything else asks for a reset and the
+interrupt clears them at its next sample.
+*/
+struct HEALTH_ISR
+{
+    uint32_t last;      // cycles
+    uint32_t worst;     // cycles, since reset
+    uint32_t overruns;  // samples longer than the budget
+    uint32_t samples;
+    volatile bool reset_req;
+};
+
+typedef struct HEALTH_ISR HEALTH_ISR;
+
+struct HEALTH_TASK
+{
+    char     name[HEALTH_NAME_LEN];
+    uint32_t stack_min;  // Lowest high water mark seen, words
+    bool     seen;       // Reported since the last check
+};
+
+typedef struct HEALTH_TASK HEALTH_TASK;
+
+struct HEALTH
+{
+    HEALTH_TASK task[HEALTH_MAX_TASKS];
+    uint32_t    task_count;
+    bool        task_overflow;
+
+    // Thresholds
+    uint32_t    stack_warn;     // words
+    float       isr_warn;       // fraction of the budget
+    uint32_t    overrun_warn;   // per check
+
+    // Summary of the last check
+    uint32_t    budget;         // cycles
+    uint32_t    isr_worst;      // cycles
+    uint32_t    overruns;       // total
+    uint32_t    overruns_new;   // since the previous check
+    uint32_t    warnings;       // HEALTH_WARN_*
+    uint32_t    checks;
+};
+
+typedef struct HEALTH HEALTH;
+
+void health_init( HEALTH * const h );
+
+/*
+Clear the record. Only for when the interrupt cannot run, at init.
+*/
+void health_isr_reset( HEALTH_ISR * const isr );
+
+/*
+Ask the interrupt to clear its record at its next sample; safe from a task.
+*/
+void health_isr_request_reset( HEALTH_ISR * const isr );
+
+/*
+Record one interrupt duration against the cycles available to it, after
+clearing the record if a reset was asked for.
+*/
+void health_isr_sample( HEALTH_ISR * const isr, uint32_t const cycles, uint32_t const budget );
+
+/*
+Record a task stack high water mark (words never used). Tasks are tracked by
+name so ones that come and go (terminal programs) keep their history.
+*/
+void health_task_sample( HEALTH * const h, char const * const name, uint32_t const free_words );
+
+/*
+Evaluate the thresholds over the tasks sampled and the interrupts given.
+Returns the warnings raised, which are also left in h->warnings.
+*/
+uint32_t health_check( HEALTH * const h, HEALTH_ISR const * const isr, uint32_t const isr_count, uint32_t const budget );
+
+/*
+Task with the least stack to spare, NULL before any sample.
+*/
+HEALTH_TASK const * health_lowest_stack( HEALTH const * const h );
+
+#endif
@@ -0,0 +1,221 @@
+/*
+ **
+ ******************************************************************************
+ * @file           : MESCimu.h
+ * @brief          : MPU6050 FIFO burst driver and attitude filter
+ ******************************************************************************
+ * @attention
+ *
+ * <h2><center>&copy; Copyright (c) 2020 David Molony.
+ * All rights reserved.</center></h2>
+ *
+ * This software component is licensed under BSD 3-Clause license,
+ * the "License"; You may not use this file except in compliance with the
+ * License. You may obtain a copy of the License at:
+ *                        opensource.org/licenses/BSD-3-Clause
+ *
+ ******************************************************************************
+ *In addition to the usual 3 BSD clauses, it is explicitly noted that you
+ *do NOT have the right to take sections of this code for other projects
+ *without attribution and credit to the source. Specifically, if you copy into
+ *copyleft licenced code without attribution and retention of the permissive BSD
+ *3 clause licence, you grant a perpetual licence to do the same regarding turning sections of your code
+ *permissive, and lose any rights to use of this code previously granted or assumed.
+ *
+ *This code is intended to remain permissively licensed wherever it goes,
+ *maintaining the freedom to distribute compiled binaries WITHOUT a requirement to supply source.
+ *
+ *This is to ensure this code can at any point be used commercially, on products that may require
+ *such restriction to meet regulatory requirements, or to avoid damage to hardware, or to ensure
+ *warranties can reasonably be honoured.
+ ******************************************************************************
+ */
+
+
+
+#ifndef MESC_IMU_H
+#define MESC_IMU_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+The MPU6050 samples into its own FIFO at odr, so nothing is lost to the timing
+of the reads; the host only has to empty it now and then, in bursts:
+
+  imu_start      -> read FIFO_COUNT          (async, DMA)
+  imu_rx_done    -> read up to IMU_BURST frames of FIFO_R_W
+  imu_rx_done    -> parse, timestamp, push into the ring
+
+The bus read only starts the transfer; the DMA complete interrupt calls
+imu_rx_done, so neither the caller nor the interrupt waits on the I2C. A count
+that is not whole frames, or a full FIFO, means samples were lost; the FIFO is
+reset and counted in overflows.
+
+A burst does not say when its samples were taken. The newest frame was in the
+FIFO when the count was read, so it is stamped with the time imu_start was
+called, less a period for each frame the burst left behind, and the rest one
+period apart before it, never earlier than the last stamp already in the ring.
+
+The ring keeps the newest IMU_RING samples; when the consumer falls behind the
+oldest are dropped. imu_process empties it through a Madgwick filter, a
+gradient descent on the gravity direction correcting the integrated gyro at
+rate beta, and keeps pitch and roll. A sustained acceleration looks like a tilt
+to it, so what is known of the vehicle acceleration can be set in a_fwd and is
+taken out of the accelerometer first.
+*/
+
+#ifndef IMU_RING
+#define IMU_RING  64  // Samples, a power of 2
+#endif
+#ifndef IMU_BURST
+#define IMU_BURST 10  // Frames per read, 12 bytes each
+#endif
+#define IMU_FRAME 12  // Accel XYZ then gyro XYZ, 16 bit big endian
+
+#define IMU_ODR_DEFAULT   500.0f // Hz
+#define IMU_BETA_DEFAULT  0.05f  // rad/s, Madgwick gain
+
+// MPU6050 registers
+#define MPU_REG_SMPLRT_DIV   0x19
+#define MPU_REG_CONFIG       0x1A
+#define MPU_REG_GYRO_CONFIG  0x1B
+#define MPU_REG_ACCEL_CONFIG 0x1C
+#define MPU_REG_FIFO_EN      0x23
+#define MPU_REG_INT_ENABLE   0x38
+#define MPU_REG_USER_CTRL    0x6A
+#define MPU_REG_PWR_MGMT_1   0x6B
+#define MPU_REG_FIFO_COUNTH  0x72
+#define MPU_REG_FIFO_R_W     0x74
+#define MPU_REG_WHO_AM_I     0x75
+
+#define MPU_FIFO_SIZE        1024
+
+enum IMUPhase
+{
+    IMU_IDLE,
+    IMU_COUNT, // FIFO_COUNT read in flight
+    IMU_DATA,  // FIFO_R_W read in flight
+};
+
+typedef enum IMUPhase IMUPhase;
+
+/*
+read starts an asynchronous read of len bytes from reg, returning 0 once it is
+under way; its completion calls imu_rx_done. write is blocking and only used
+for configuration and FIFO resets.
+*/
+struct IMUBus
+{
+    int  (*read)( void * ctx, uint8_t reg, uint8_t * buf, uint16_t len );
+    int  (*write)( void * ctx, uint8_t reg, uint8_t val );
+    void * ctx;
+};
+
+typedef struct IMUBus IMUBus;
+
+struct IMUSample
+{
+    uint32_t t;      // us
+    float    acc[3]; // g
+    float    gyr[3]; // rad/s
+};
+
+typedef struct IMUSample IMUSample;
+
+struct IMUAtt
+{
+    float    beta;  // rad/s
+    float    q[4];  // Sensor to earth quaternion, w x y z
+    float    roll;  // rad, about x
+    float    pitch; // rad, about y
+    bool     init;  // Seeded from the accelerometer
+};
+
+typedef struct IMUAtt IMUAtt;
+
+struct IMU
+{
+    IMUBus   bus;
+
+    // Configuration
+    float    odr;         // Hz, set to what the divider gives by imu_config
+    float    acc_scale;   // g per LSB
+    float    gyr_scale;   // rad/s per LSB
+    float    gyr_bias[3]; // rad/s, subtracted in imu_process
+    float    a_fwd;       // m/s^2, known acceleration along x, taken out before the attitude filter
+
+    // Driver
+    IMUPhase phase;
+    uint8_t  buf[IMU_BURST*IMU_FRAME];
+    uint16_t pending;     // Bytes in the data read
+    uint16_t behind;      // Frames left in the FIFO after this burst
+    uint32_t t_req;       // us, imu_start of this burst
+    uint32_t t_last;      // us, newest stamp
+    bool     stamped;
+
+    uint32_t samples;
+    uint32_t overflows;
+    uint32_t errors;
+    uint32_t dropped;
+
+    // Ring
+    IMUSample ring[IMU_RING];
+    uint32_t head;        // Next write
+    uint32_t tail;        // Next read
+
+    // Consumer
+    IMUSample last;
+    IMUAtt   att;
+};
+
+typedef struct IMU IMU;
+
+void imu_init( IMU * const imu, IMUBus const * const bus );
+
+/*
+Write the MPU6050 configuration: gyro clock, 1kHz internal rate with a 44Hz
+DLPF, +-8g, +-1000deg/s, accel and gyro into the FIFO. odr is rounded to a
+divider of 1kHz. Returns 0 on success.
+*/
+int imu_config( IMU * const imu, float const odr );
+
+/*
+Start a burst at time now, us. Returns false if one is still in flight.
+*/
+bool imu_start( IMU * const imu, uint32_t const now );
+
+/*
+The read started by the bus completed.
+*/
+void imu_rx_done( IMU * const imu );
+
+/*
+The read started by the bus failed; the burst is abandoned.
+*/
+void imu_rx_error( IMU * const imu );
+
+uint32_t imu_available( IMU const * const imu );
+
+bool imu_pop( IMU * const imu, IMUSample * const s );
+
+/*
+Parse n frames of FIFO data, stamping the newest t and the rest one period
+apart before it.
+*/
+void imu_parse( IMU * const imu, uint8_t const * const data, uint32_t const n, uint32_t const t );
+
+void imu_att_init( IMUAtt * const att, float const beta );
+
+/*
+One Madgwick step with the sample s, dt seconds after the last.
+*/
+void imu_att_update( IMUAtt * const att, IMUSample const * const s, float const dt );
+
+/*
+Run everything in the ring through the attitude filter. Returns the number of
+samples used.
+*/
+uint32_t imu_process( IMU * const imu );
+
+#endif
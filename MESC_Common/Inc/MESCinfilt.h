@@ -0,0 +1,136 @@
+/*
+ **
+ ******************************************************************************
+ * @file           : MESCinfilt.h
+ * @brief          : Per source input filtering and arbitration
+ ******************************************************************************
+ * @attention
+ *
+ * <h2><center>&copy; Copyright (c) 2020 David Molony.
+ * All rights reserved.</center></h2>
+ *
+ * This software component is licensed under BSD 3-Clause license,
+ * the "License"; You may not use this file except in compliance with the
+ * License. You may obtain a copy of the License at:
+ *                        opensource.org/licenses/BSD-3-Clause
+ *
+ ******************************************************************************
+ *In addition to the usual 3 BSD clauses, it is explicitly noted that you
+ *do NOT have the right to take sections of this code for other projects
+ *without attribution and credit to the source. Specifically, if you copy into
+ *copyleft licenced code without attribution and retention of the permissive BSD
+ *3 clause licence, you grant a perpetual licence to do the same regarding turning sections of your code
+ *permissive, and lose any rights to use of this code previously granted or assumed.
+ *
+ *This code is intended to remain permissively licensed wherever it goes,
+ *maintaining the freedom to distribute compiled binaries WITHOUT a requirement to supply source.
+ *
+ *This is to ensure this code can at any point be used commercially, on products that may require
+ *such restriction to meet regulatory requirements, or to avoid damage to hardware, or to ensure
+ *warranties can reasonably be honoured.
+ ******************************************************************************
+ */
+
+
+#ifndef MESC_INFILT_H
+#define MESC_INFILT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+Each input source runs its normalised request (-1..1) through the same chain of
+stages, each of which is off at its zero setting:
+
+  validity -> median of 3 -> IIR -> deadband -> rate limit
+
+The source decides whether a sample is valid (pulse width in the window, ADC
+below OOR, remote ADC not timed out...). An invalid sample holds the output for
+up to timeout, riding through a glitch; past that the source faults and outputs
+zero, and stays faulted until a valid sample inside the deadband releases it,
+so a returning signal can not jump straight back to torque.
+
+The median takes out single sample spikes for one sample of delay; the IIR
+smooths noise with a time constant tau; the deadband is taken after the
+filters so noise around zero does not get through, and the output is rescaled
+so it still reaches 1. The rate limit applies separately to the request growing
+and shrinking in magnitude.
+
+With INFILT_ARB_PRIORITY, only the valid, nonzero source of highest priority
+passes; INFILT_ARB_SUM adds them all as before.
+*/
+
+#ifndef INFILT_TIMEOUT
+#define INFILT_TIMEOUT 0.1f // s an invalid input is held before faulting
+#endif
+#ifndef INFILT_DIFF_TOL
+#define INFILT_DIFF_TOL 0.15f // Complementary track mismatch before the pair is invalid
+#endif
+
+enum INFILTSource
+{
+    INFILT_SRC_ADC1,
+    INFILT_SRC_ADC2,
+    INFILT_SRC_RCPWM,
+    INFILT_SRC_REMOTE1,
+    INFILT_SRC_REMOTE2,
+    INFILT_SRC_DIFF,
+
+    INFILT_SOURCES,
+};
+
+typedef enum INFILTSource INFILTSource;
+
+enum INFILTArb
+{
+    INFILT_ARB_SUM,
+    INFILT_ARB_PRIORITY,
+};
+
+typedef enum INFILTArb INFILTArb;
+
+struct INFILT
+{
+    // Configuration
+    bool     median;
+    float    tau;       // s, IIR time constant
+    float    deadband;  // Fraction of full scale
+    float    rate_up;   // Full scale per s, magnitude growing
+    float    rate_down; // Full scale per s, magnitude shrinking
+    float    timeout;   // s
+    uint8_t  priority;  // Higher wins
+
+    // State
+    float    hist[3];
+    uint8_t  n;         // Samples in hist
+    float    y;         // IIR output
+    float    out;
+    float    age;       // s since the last valid sample
+    bool     fault;
+};
+
+typedef struct INFILT INFILT;
+
+void infilt_init( INFILT * const f );
+
+void infilt_reset( INFILT * const f );
+
+/*
+Run one sample x, valid or not, T seconds after the last. Returns the output.
+*/
+float infilt_run( INFILT * const f, float const x, bool const valid, float const T );
+
+/*
+Request from complementary throttle tracks n1 rising and n2 falling, both
+normalised 0..1; their sum should stay at 1. valid is cleared when it is off
+by more than INFILT_DIFF_TOL.
+*/
+float infilt_complementary( float const n1, float const n2, bool * const valid );
+
+/*
+Index of the source that passes under INFILT_ARB_PRIORITY, or -1 for none.
+Ties go to the lower index.
+*/
+int32_t infilt_arbitrate( INFILT const * const f, uint32_t const n );
+
+#endif
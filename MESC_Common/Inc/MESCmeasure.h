@@ -41,6 +41,7 @@ void MESCmeasure_GetkV(MESC_motor_typedef *_motor);
 float MESCmeasure_DetectHFI(MESC_motor_typedef *_motor);
 void MESCmeasure_GetDeadtime(MESC_motor_typedef *_motor);
 void MESCmeasure_GetHallTable(MESC_motor_typedef *_motor);
+void MESCmeasure_EncoderCal(MESC_motor_typedef *_motor);
 void MESCmeasure_DoublePulseTest(MESC_motor_typedef *_motor);
 
 #endif /* INC_MESCMEASURE_H_ */
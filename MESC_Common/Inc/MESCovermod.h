@@ -0,0 +1,113 @@
+/*
+ **
+ ******************************************************************************
+ * @file           : MESCovermod.h
+ * @brief          : Overmodulation and transition into six-step
+ ******************************************************************************
+ * @attention
+ *
+ * <h2><center>&copy; Copyright (c) 2020 David Molony.
+ * All rights reserved.</center></h2>
+ *
+ * This software component is licensed under BSD 3-Clause license,
+ * the "License"; You may not use this file except in compliance with the
+ * License. You may obtain a copy of the License at:
+ *                        opensource.org/licenses/BSD-3-Clause
+ *
+ ******************************************************************************
+ *In addition to the usual 3 BSD clauses, it is explicitly noted that you
+ *do NOT have the right to take sections of this code for other projects
+ *without attribution and credit to the source. Specifically, if you copy into
+ *copyleft licenced code without attribution and retention of the permissive BSD
+ *3 clause licence, you grant a perpetual licence to do the same regarding turning sections of your code
+ *permissive, and lose any rights to use of this code previously granted or assumed.
+ *
+ *This code is intended to remain permissively licensed wherever it goes,
+ *maintaining the freedom to distribute compiled binaries WITHOUT a requirement to supply source.
+ *
+ *This is to ensure this code can at any point be used commercially, on products that may require
+ *such restriction to meet regulatory requirements, or to avoid damage to hardware, or to ensure
+ *warranties can reasonably be honoured.
+ ******************************************************************************
+ */
+
+#ifndef MESC_OVERMOD_H
+#define MESC_OVERMOD_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+Ratio of the six-step fundamental (2/pi * Vbus) to the linear SVPWM limit
+(Vbus/sqrt3); this is the highest modulation index that can be requested.
+*/
+#define OVERMOD_SIX_STEP_RATIO 1.1026578f
+
+#define OVERMOD_TABLE_SIZE     32
+
+enum OVERMODType
+{
+    OVERMOD_TYPE_NONE,      // Linear only, the circle limiter caps the request
+    OVERMOD_TYPE_MIN_PHASE, // Minimum phase error, clamp onto the hexagon keeping the angle
+    OVERMOD_TYPE_SIX_STEP,  // Gain-and-clip, continuous transition into six-step
+};
+
+typedef enum OVERMODType OVERMODType;
+
+/*
+Six-step clip gain indexed by normalised request (1.0 ... OVERMOD_SIX_STEP_RATIO),
+generated offline by Gen/util_overmod.
+*/
+extern float const overmod_gain[OVERMOD_TABLE_SIZE];
+
+struct OVERMOD
+{
+    // 0 = linear ... 1 = six-step
+    float   k;
+
+    // Applied minus requested voltage in the dq frame, from the last PWM write
+    float   dVd;
+    float   dVq;
+
+    // Predicted harmonic current, integrated and high passed in the dq frame
+    float   Id_int;
+    float   Iq_int;
+    float   Id_avg;
+    float   Iq_avg;
+    float   Id_h;
+    float   Iq_h;
+};
+
+typedef struct OVERMOD OVERMOD;
+
+void overmod_init( OVERMOD * const om );
+
+/*
+Fundamental of the six-step clipped output relative to the linear limit, for
+clip gain g. This is what overmod_gain inverts.
+*/
+float overmod_fundamental( float const g );
+
+/*
+Modify the three zero-sequence free phase voltages V[] (Volts) in place such
+that they are centred on zero and lie within +/-Vbus/2.
+
+Returns false (and leaves V[] untouched) when the request is within the linear
+region and the normal modulator should be used.
+*/
+bool overmod_apply( OVERMOD * const om, OVERMODType const type, float const Vbus, float V[3] );
+
+/*
+Record the voltage error (applied minus requested) already rotated into the dq frame.
+*/
+void overmod_set_error( OVERMOD * const om, float const dVd, float const dVq );
+
+/*
+Remove the predicted harmonic ripple from the measured currents, so that the
+current controller does not fight the deliberate voltage distortion.
+*/
+void overmod_compensate( OVERMOD * const om, float const T, float const we,
+                         float const Ld, float const Lq,
+                         float * const Id, float * const Iq );
+
+#endif
@@ -0,0 +1,174 @@
+/*
+* Copyright 2021-2023 cod3b453
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its contributors
+*    may be used to endorse or promote products derived from this software
+*    without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef MESC_PSTORE_H
+#define MESC_PSTORE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+Profile store
+
+A read-only image, normally memory mapped from flash, holding any number of
+typed entries behind a sorted directory:
+
+    PSTOREHeader
+    PSTOREEntry[entries]   sorted by (type, name_hash, name)
+    data                   each entry 4 byte aligned
+
+Opening the store checks the header and the directory only, the entry data is
+not read. An entry is found by bisection and handed out as a pointer into the
+image; its own checksum is checked the first time it is mapped, so damage to
+one entry leaves the rest usable and boot time does not grow with the data.
+
+All values are little endian.
+*/
+
+#define PSTORE_SIGNATURE     UINT32_C(0x3253504D) // "MPS2"
+#define PSTORE_VERSION_MAJOR 2
+#define PSTORE_VERSION_MINOR 0
+
+#define PSTORE_MAX_ENTRIES   128
+#define PSTORE_NAME_LENGTH   12
+#define PSTORE_ALIGN         4
+
+struct PSTOREHeader
+{
+    uint32_t signature;          // PSTORE_SIGNATURE
+    uint8_t  _zero_signature;    // Must be zero
+    uint8_t  version_major;
+    uint8_t  version_minor;
+    uint8_t  size;               // sizeof(PSTOREHeader)
+
+    uint16_t entries;
+    uint8_t  entry_size;         // sizeof(PSTOREEntry)
+    uint8_t  _zero;              // Must be zero
+
+    uint32_t image_length;       // Header, directory and data
+    uint32_t directory_checksum; // FNV over the directory
+    uint32_t generation;         // Incremented by each rebuild
+    uint32_t reserved;
+
+    uint32_t checksum;           // FNV over the preceding header fields
+};
+
+typedef struct PSTOREHeader PSTOREHeader;
+
+struct PSTOREEntry
+{
+    uint32_t type;                     // Data signature, e.g. BAT_PROFILE_SIGNATURE
+    uint32_t name_hash;                // FNV over name, orders entries of one type
+    char     name[PSTORE_NAME_LENGTH]; // Not terminated when full length
+    uint32_t offset;                   // From the start of the image
+    uint32_t length;
+    uint32_t checksum;                 // FNV over the data
+};
+
+typedef struct PSTOREEntry PSTOREEntry;
+
+enum PSTOREError
+{
+    PSTORE_OK,
+    PSTORE_ERR_SIGNATURE, // Not a store, or zero fields set
+    PSTORE_ERR_VERSION,
+    PSTORE_ERR_SIZE,      // Header, entry or image size inconsistent
+    PSTORE_ERR_CHECKSUM,  // Header checksum
+    PSTORE_ERR_DIRECTORY, // Directory checksum, order or bounds
+    PSTORE_ERR_NOT_FOUND,
+    PSTORE_ERR_ENTRY,     // Entry data checksum
+    PSTORE_ERR_NAME,      // Name too long (build)
+    PSTORE_ERR_FULL,      // Too many entries or image too large (build)
+};
+
+typedef enum PSTOREError PSTOREError;
+
+#define PSTORE_MAP_WORDS ((PSTORE_MAX_ENTRIES + 31) / 32)
+
+struct PSTORE
+{
+    uint8_t const *      image;
+    PSTOREHeader const * header;
+    PSTOREEntry const *  directory;
+    uint32_t             entries;
+
+    // Entry checksums, checked on first use
+    uint32_t             checked[PSTORE_MAP_WORDS];
+    uint32_t             damaged[PSTORE_MAP_WORDS];
+
+    // Statistics
+    uint32_t             probes; // Directory entries compared by the last lookup
+};
+
+typedef struct PSTORE PSTORE;
+
+// Data to be placed in a store by pstore_build
+struct PSTOREItem
+{
+    uint32_t     type;
+    char const * name;
+    void const * data;
+    uint32_t     length;
+};
+
+typedef struct PSTOREItem PSTOREItem;
+
+/*
+Check the header and directory of the image at image[0..size). The image must
+stay in place while the store is open.
+*/
+PSTOREError pstore_open( PSTORE * const ps, void const * const image, uint32_t const size );
+
+/*
+Find the entry of the given type and name; with name NULL the first entry of
+that type. Entries of one type are contiguous, index + 1 is the next.
+*/
+PSTOREError pstore_find( PSTORE * const ps, uint32_t const type, char const * const name, uint32_t * const index );
+
+// Number of entries of the given type
+uint32_t pstore_count( PSTORE * const ps, uint32_t const type );
+
+PSTOREEntry const * pstore_entry( PSTORE const * const ps, uint32_t const index );
+
+/*
+Point data at the entry contents within the image, checking them against the
+entry checksum on first use.
+*/
+PSTOREError pstore_map( PSTORE * const ps, uint32_t const index, void const ** const data, uint32_t * const length );
+
+// pstore_find followed by pstore_map
+PSTOREError pstore_get( PSTORE * const ps, uint32_t const type, char const * const name, void const ** const data, uint32_t * const length );
+
+/*
+Lay out a store holding items[0..count) in image[0..size), giving the length
+used. Items may be in any order; names must be unique within a type.
+*/
+PSTOREError pstore_build( void * const image, uint32_t const size, PSTOREItem const * const items, uint32_t const count, uint32_t const generation, uint32_t * const length );
+
+#endif
@@ -0,0 +1,158 @@
+/*
+ **
+ ******************************************************************************
+ * @file           : MESCsixstep.h
+ * @brief          : Sensorless six-step commutation from the floating phase
+ ******************************************************************************
+ * @attention
+ *
+ * <h2><center>&copy; Copyright (c) 2020 David Molony.
+ * All rights reserved.</center></h2>
+ *
+ * This software component is licensed under BSD 3-Clause license,
+ * the "License"; You may not use this file except in compliance with the
+ * License. You may obtain a copy of the License at:
+ *                        opensource.org/licenses/BSD-3-Clause
+ *
+ ******************************************************************************
+ *In addition to the usual 3 BSD clauses, it is explicitly noted that you
+ *do NOT have the right to take sections of this code for other projects
+ *without attribution and credit to the source. Specifically, if you copy into
+ *copyleft licenced code without attribution and retention of the permissive BSD
+ *3 clause licence, you grant a perpetual licence to do the same regarding turning sections of your code
+ *permissive, and lose any rights to use of this code previously granted or assumed.
+ *
+ *This code is intended to remain permissively licensed wherever it goes,
+ *maintaining the freedom to distribute compiled binaries WITHOUT a requirement to supply source.
+ *
+ *This is to ensure this code can at any point be used commercially, on products that may require
+ *such restriction to meet regulatory requirements, or to avoid damage to hardware, or to ensure
+ *warranties can reasonably be honoured.
+ ******************************************************************************
+ */
+
+
+
+#ifndef MESC_SIXSTEP_H
+#define MESC_SIXSTEP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+The sectors are those BLDCCommute drives: in each one phase is pulled high,
+one low and the third floats. The floating phase BEMF is its terminal voltage
+less the mid point of the driven pair, which removes the PWM and the neutral
+shift, and crosses zero half way through the sector.
+
+Sector k holds the rotor around 120 - 60k degrees electrical (0 on the U axis,
+as FOCAngle), so positive eHz steps the sectors down. The floating phase falls
+through zero in even sectors and rises in odd ones, whichever way the rotor
+turns. The table drives positive torque; turning backwards, sector k+3 (the
+same floating phase, the pair swapped) motors.
+
+Two ways to time the commutation after the zero crossing (ZC):
+- SIXSTEP_MODE_ZC waits the rest of the half sector, less the advance, on the
+  ZC to ZC period. The crossing is interpolated between samples, so timing
+  holds at a few samples per sector.
+- SIXSTEP_MODE_INTEGRATE integrates the BEMF from the crossing up to a flux
+  threshold, which is speed independent and rides through acceleration.
+  flux_th is the integral at zero advance; advance scales it as 1 - cos.
+
+The off going phase demagnetises through a diode after each commutation, which
+holds the floating terminal on the rail that reads as past the crossing. A
+crossing is therefore only taken after a sample before it at least SIXSTEP_ARM
+of the expected BEMF, and samples in the first blank fraction of the sector,
+where the switching rings, are ignored. A sector with no crossing within 1.5
+periods is commutated on timing; after SIXSTEP_MISSES in a row, or once the
+crossings slow below eHz_min where the BEMF is lost in the noise, sync is lost.
+*/
+
+#define SIXSTEP_BLANK      0.25f  // Fraction of a sector ignored after commutation
+#define SIXSTEP_FILTER     0.25f  // Weight of the newest ZC to ZC period
+#define SIXSTEP_MISSES     6      // Sectors without a crossing before sync is lost
+#define SIXSTEP_ARM        0.05f  // BEMF before a crossing, as a fraction of the expected peak
+#define SIXSTEP_HYSTERESIS 0.2f   // Handover band either side of eHz_handover
+
+#ifndef SIXSTEP_HANDOVER_EHZ
+#define SIXSTEP_HANDOVER_EHZ 300.0f
+#endif
+#ifndef SIXSTEP_EHZ_MIN
+#define SIXSTEP_EHZ_MIN      50.0f
+#endif
+#ifndef SIXSTEP_ADVANCE
+#define SIXSTEP_ADVANCE      0.0f // rad electrical
+#endif
+
+enum SIXSTEPMode
+{
+    SIXSTEP_MODE_ZC,
+    SIXSTEP_MODE_INTEGRATE,
+};
+
+typedef enum SIXSTEPMode SIXSTEPMode;
+
+struct SIXSTEP
+{
+    // Configuration
+    SIXSTEPMode mode;
+    float    advance;      // rad electrical
+    float    blank;        // Fraction of a sector
+    float    flux_th;      // V s, ZC to commutation at zero advance
+    float    eHz_handover; // eHz
+    float    eHz_min;      // eHz, sync is lost below
+
+    // State
+    int8_t   direction;    // Sector step, -1 for positive eHz
+    uint8_t  sector;
+    bool     locked;
+    bool     zc_seen;
+    bool     armed;        // A sample past the blanking is held in s_last
+    uint8_t  misses;
+    float    t;            // s since commutation
+    float    t_zc;         // s since commutation at the crossing
+    float    t_since_zc;   // s since the last crossing
+    float    period;       // s per sector
+    float    s_last;       // BEMF signed to rise through the crossing
+    float    integral;     // V s since the crossing
+    float    bemf;         // V, last sample
+    uint32_t commutations;
+};
+
+typedef struct SIXSTEP SIXSTEP;
+
+/*
+Phases, 0=U 1=V 2=W, driven high, low and left floating in each sector.
+*/
+extern uint8_t const sixstep_high[6];
+extern uint8_t const sixstep_low[6];
+extern uint8_t const sixstep_float[6];
+
+/*
+flux_th for a sinusoidal motor of the given flux linkage (V s, phase peak).
+*/
+float sixstep_flux_threshold( float const flux_linkage );
+
+void sixstep_init( SIXSTEP * const ss, float const flux_linkage );
+
+/*
+Pick up a spinning rotor at angle (FOCAngle scale) and eHz, choosing the sector
+and how far through it the rotor is.
+*/
+void sixstep_start( SIXSTEP * const ss, uint16_t const angle, float const eHz );
+
+/*
+Run one PWM period of T seconds on the phase voltages. Returns true when it
+commutates; ss->sector is the sector to drive.
+*/
+bool sixstep_run( SIXSTEP * const ss, float const Vu, float const Vv, float const Vw, float const T );
+
+float sixstep_eHz( SIXSTEP const * const ss );
+
+/*
+Rotor angle (FOCAngle scale) interpolated through the sector, for the handover
+back to FOC.
+*/
+uint16_t sixstep_angle( SIXSTEP const * const ss );
+
+#endif
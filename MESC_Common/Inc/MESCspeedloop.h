@@ -0,0 +1,121 @@
+/*
+ **
+ ******************************************************************************
+ * @file           : MESCspeedloop.h
+ * @brief          : Decimated speed loop with anti-windup and feedforward
+ ******************************************************************************
+ * @attention
+ *
+ * <h2><center>&copy; Copyright (c) 2020 David Molony.
+ * All rights reserved.</center></h2>
+ *
+ * This software component is licensed under BSD 3-Clause license,
+ * the "License"; You may not use this file except in compliance with the
+ * License. You may obtain a copy of the License at:
+ *                        opensource.org/licenses/BSD-3-Clause
+ *
+ ******************************************************************************
+ *In addition to the usual 3 BSD clauses, it is explicitly noted that you
+ *do NOT have the right to take sections of this code for other projects
+ *without attribution and credit to the source. Specifically, if you copy into
+ *copyleft licenced code without attribution and retention of the permissive BSD
+ *3 clause licence, you grant a perpetual licence to do the same regarding turning sections of your code
+ *permissive, and lose any rights to use of this code previously granted or assumed.
+ *
+ *This code is intended to remain permissively licensed wherever it goes,
+ *maintaining the freedom to distribute compiled binaries WITHOUT a requirement to supply source.
+ *
+ *This is to ensure this code can at any point be used commercially, on products that may require
+ *such restriction to meet regulatory requirements, or to avoid damage to hardware, or to ensure
+ *warranties can reasonably be honoured.
+ ******************************************************************************
+ */
+
+
+
+#ifndef MESC_SPEEDLOOP_H
+#define MESC_SPEEDLOOP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+The speed PI runs from the fastloop every decimation cycles rather than in the
+100Hz slowloop, so its bandwidth is no longer bounded at a few Hz. The integral
+is held against the live current limits by back calculation: the amount the
+output was clamped by is fed back into the integral, so it tracks the limit
+during a launch rather than winding up past it.
+
+Two optional feedforward terms sit alongside the PI. The acceleration term is
+the slope of the speed request through the inertia; the load term is the
+torque a speed observer needs to explain the measured speed, which takes load
+steps off the integral. Both are in A and need Kacc, the current per eHz/s of
+acceleration, so both are off while the inertia is unknown.
+*/
+
+#ifndef SPEEDLOOP_DECIMATION
+#define SPEEDLOOP_DECIMATION 10      // Fastloop cycles per speed loop call
+#endif
+#ifndef SPEEDLOOP_AW
+#define SPEEDLOOP_AW         1.0f    // Back calculation gain relative to ki
+#endif
+#ifndef SPEEDLOOP_LOAD_BW
+#define SPEEDLOOP_LOAD_BW    400.0f  // rad/s, load observer bandwidth
+#endif
+
+struct SPEEDLOOP
+{
+    // Gains
+    float    kp;        // A/eHz
+    float    ki;        // 1/s, integral of the proportional term
+    float    aw;        // Back calculation gain relative to ki
+    float    Kacc;      // A per eHz/s, zero disables both feedforwards
+    float    load_bw;   // rad/s
+    bool     use_acc_ff;
+    bool     use_load_ff;
+
+    uint16_t decimation;
+    uint16_t count;
+
+    // Limits, live from the slowloop
+    float    I_max;     // A
+    float    I_min;     // A
+    float    Iq_chain;  // A, output handed to the slowloop limit chain
+
+    // State
+    float    req_last;  // eHz
+    float    integral;  // A
+    float    eHz_hat;   // eHz
+    float    I_load;    // A
+    float    I_ff;      // A
+    float    Iq;        // A
+};
+
+typedef struct SPEEDLOOP SPEEDLOOP;
+
+void speedloop_init( SPEEDLOOP * const sl );
+
+/*
+Clear the integral and observer, starting from the measured speed.
+*/
+void speedloop_reset( SPEEDLOOP * const sl, float const eHz );
+
+/*
+Call every fastloop cycle; true once every decimation cycles.
+*/
+bool speedloop_tick( SPEEDLOOP * const sl );
+
+/*
+Set the limits the output and integral work to. I_max and I_min are the
+request limits after any thermal rollback; I_out is what the rest of the limit
+chain made of Iq_chain, and tightens the limit on that side when it is smaller.
+*/
+void speedloop_limit( SPEEDLOOP * const sl, float const I_min, float const I_max, float const I_out );
+
+/*
+Run the loop over T seconds towards req (eHz) from the measured eHz. Returns the
+q current request.
+*/
+float speedloop_run( SPEEDLOOP * const sl, float const req, float const eHz, float const T );
+
+#endif
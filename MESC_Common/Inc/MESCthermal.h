@@ -0,0 +1,166 @@
+/*
+ **
+ ******************************************************************************
+ * @file           : MESCthermal.h
+ * @brief          : Lumped thermal model of the winding and FET junctions
+ ******************************************************************************
+ * @attention
+ *
+ * <h2><center>&copy; Copyright (c) 2020 David Molony.
+ * All rights reserved.</center></h2>
+ *
+ * This software component is licensed under BSD 3-Clause license,
+ * the "License"; You may not use this file except in compliance with the
+ * License. You may obtain a copy of the License at:
+ *                        opensource.org/licenses/BSD-3-Clause
+ *
+ ******************************************************************************
+ *In addition to the usual 3 BSD clauses, it is explicitly noted that you
+ *do NOT have the right to take sections of this code for other projects
+ *without attribution and credit to the source. Specifically, if you copy into
+ *copyleft licenced code without attribution and retention of the permissive BSD
+ *3 clause licence, you grant a perpetual licence to do the same regarding turning sections of your code
+ *permissive, and lose any rights to use of this code previously granted or assumed.
+ *
+ *This code is intended to remain permissively licensed wherever it goes,
+ *maintaining the freedom to distribute compiled binaries WITHOUT a requirement to supply source.
+ *
+ *This is to ensure this code can at any point be used commercially, on products that may require
+ *such restriction to meet regulatory requirements, or to avoid damage to hardware, or to ensure
+ *warranties can reasonably be honoured.
+ ******************************************************************************
+ */
+
+
+#ifndef MESC_THERMAL_H
+#define MESC_THERMAL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "MESCtemp.h"
+
+/*
+Each of the motor and the FETs is taken as two thermal masses in a chain to
+ambient: a fast node that takes the loss (winding, junctions) behind a slow
+node (stator and housing, heatsink). The sensor reads the node it is fixed to
+through a first order lag of its own. The loss comes from the FOC state:
+
+    motor  1.5*|Idq|^2*R, with R following the winding temperature
+    FETs   1.5*|Idq|^2*Rds_on, Rds_on following the junction temperature,
+           plus 3 legs * (2/pi)*|Idq|*Vbus*t_sw*f_pwm switching
+
+The model is run open loop and pulled onto the sensor by shifting all of its
+nodes with the sensor error, which takes out ambient and loss offsets.
+The fast node is then predicted a horizon ahead assuming the slow node holds,
+and the current limit is solved so that the prediction lands on the same
+Thot..Tmax linear taper ThrottleTemperature applies to the sensors.
+*/
+
+#ifndef THERMAL_MOTOR_R_FAST
+#define THERMAL_MOTOR_R_FAST     0.3f    // K/W winding to stator
+#endif
+#ifndef THERMAL_MOTOR_C_FAST
+#define THERMAL_MOTOR_C_FAST     200.0f  // J/K winding
+#endif
+#ifndef THERMAL_MOTOR_R_SLOW
+#define THERMAL_MOTOR_R_SLOW     0.5f    // K/W stator to ambient
+#endif
+#ifndef THERMAL_MOTOR_C_SLOW
+#define THERMAL_MOTOR_C_SLOW     2000.0f // J/K stator and housing
+#endif
+#ifndef THERMAL_MOTOR_TAU_SENSOR
+#define THERMAL_MOTOR_TAU_SENSOR 20.0f   // s, winding NTC
+#endif
+
+#ifndef THERMAL_FET_R_FAST
+#define THERMAL_FET_R_FAST       0.2f    // K/W junctions to heatsink
+#endif
+#ifndef THERMAL_FET_C_FAST
+#define THERMAL_FET_C_FAST       5.0f    // J/K junctions
+#endif
+#ifndef THERMAL_FET_R_SLOW
+#define THERMAL_FET_R_SLOW       1.0f    // K/W heatsink to ambient
+#endif
+#ifndef THERMAL_FET_C_SLOW
+#define THERMAL_FET_C_SLOW       100.0f  // J/K heatsink
+#endif
+#ifndef THERMAL_FET_TAU_SENSOR
+#define THERMAL_FET_TAU_SENSOR   5.0f    // s, board NTC on the heatsink
+#endif
+#ifndef THERMAL_FET_RDS_ON
+#define THERMAL_FET_RDS_ON       0.002f  // Ohm at 25C, one device
+#endif
+#ifndef THERMAL_FET_T_SW
+#define THERMAL_FET_T_SW         100e-9f // s per transition
+#endif
+
+#define THERMAL_ALPHA_CU         0.00393f // 1/K copper resistance
+#define THERMAL_ALPHA_RDS        0.006f   // 1/K Rds_on
+#define THERMAL_T_REF            298.15f  // K at which R and Rds_on are given
+#define THERMAL_HORIZON          10.0f    // s of prediction
+#define THERMAL_K_SENSOR         0.05f    // 1/s, sensor correction gain
+
+struct THERMAL_MODEL
+{
+    float R_fast;   // K/W
+    float C_fast;   // J/K
+    float R_slow;   // K/W
+    float C_slow;   // J/K
+    float tau;      // s, sensor
+
+    // K
+    float T_fast;
+    float T_slow;
+    float T_sensor;
+    float T_pred;   // Fast node at the horizon
+
+    float P;        // W, last loss
+    bool  sensed;   // Last update had a sensor reading
+};
+
+typedef struct THERMAL_MODEL THERMAL_MODEL;
+
+struct THERMAL
+{
+    THERMAL_MODEL motor;
+    THERMAL_MODEL fet;
+
+    float T_amb;    // K
+    float Rds_on;   // Ohm at THERMAL_T_REF
+    float t_sw;     // s
+    float horizon;  // s
+    float k_sensor; // 1/s
+
+    // Last inputs, for the limit
+    float R;        // Ohm, phase at THERMAL_T_REF
+    float Vbus;
+    float f_pwm;
+
+    float rollback; // Last current limit factor
+    bool  primed;
+};
+
+typedef struct THERMAL THERMAL;
+
+/*
+Load the default parameters; the nodes are seeded from the first sensor
+readings.
+*/
+void thermal_init( THERMAL * const th );
+
+/*
+Advance by T seconds with the dq current (A), phase resistance (Ohm at
+THERMAL_T_REF), bus voltage and PWM frequency. Sensor readings are in K; pass
+0 where there is no sensor.
+*/
+void thermal_update( THERMAL * const th, float const Id, float const Iq, float const R, float const Vbus, float const f_pwm,
+                     float const T_motor, float const T_fet, float const T );
+
+/*
+Current limit factor (0..1 of Imax) that keeps the predicted winding and
+junction temperatures on the linear taper between limit.Thot and limit.Tmax.
+*/
+float thermal_rollback( THERMAL * const th, float const Imax, TEMP const * const motor_temp, TEMP const * const fet_temp );
+
+#endif
@@ -0,0 +1,132 @@
+/*
+ **
+ ******************************************************************************
+ * @file           : MESCtraction.h
+ * @brief          : IMU based traction control and wheelie limiting
+ ******************************************************************************
+ * @attention
+ *
+ * <h2><center>&copy; Copyright (c) 2020 David Molony.
+ * All rights reserved.</center></h2>
+ *
+ * This software component is licensed under BSD 3-Clause license,
+ * the "License"; You may not use this file except in compliance with the
+ * License. You may obtain a copy of the License at:
+ *                        opensource.org/licenses/BSD-3-Clause
+ *
+ ******************************************************************************
+ *In addition to the usual 3 BSD clauses, it is explicitly noted that you
+ *do NOT have the right to take sections of this code for other projects
+ *without attribution and credit to the source. Specifically, if you copy into
+ *copyleft licenced code without attribution and retention of the permissive BSD
+ *3 clause licence, you grant a perpetual licence to do the same regarding turning sections of your code
+ *permissive, and lose any rights to use of this code previously granted or assumed.
+ *
+ *This code is intended to remain permissively licensed wherever it goes,
+ *maintaining the freedom to distribute compiled binaries WITHOUT a requirement to supply source.
+ *
+ *This is to ensure this code can at any point be used commercially, on products that may require
+ *such restriction to meet regulatory requirements, or to avoid damage to hardware, or to ensure
+ *warranties can reasonably be honoured.
+ ******************************************************************************
+ */
+
+
+
+#ifndef MESC_TRACTION_H
+#define MESC_TRACTION_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+Traction control scales the motoring request by a factor from 0 to 1.
+
+Wheel slip. The wheel speed comes from the motor, v_wheel = eHz * m_per_eHz.
+The IMU gives the vehicle acceleration along the ground, with gravity taken
+out using the pitch. Two checks compare them:
+  - acceleration: the wheel accelerating faster than the vehicle by more than
+    acc_excess. This sees a spin up within a few ms.
+  - slip ratio: the wheel against an estimated vehicle speed. The estimate
+    integrates the IMU acceleration and is pulled to the wheel speed while the
+    slip is under half of slip_max. This sees a slow, steady spin that the
+    acceleration check misses. If the factor has been held near zero for
+    a quarter second the wheel has long spun down, so any slip left is drift
+    in the estimate and it restarts from the wheel.
+
+Wheelie. The pitch is projected lookahead seconds ahead with the pitch rate,
+so the rate term damps the rise before it overshoots.
+
+While a check is over its limit the factor is divided each tick by 1 plus
+k_slip, or k_pitch per rad, times the overshoot, capped at halving per tick;
+otherwise it recovers at recover per s. The cut lands on the tick that sees
+the slip or the pitch, so the latency is one call period plus the age of the
+IMU data. Regen is not scaled.
+*/
+
+#ifndef TRACTION_M_PER_EHZ
+#define TRACTION_M_PER_EHZ 0.05f // m/s per eHz, 10" hub motor with 15 pole pairs
+#endif
+
+#define TRACTION_G 9.80665f // m/s^2
+
+struct TRACTION
+{
+    // Configuration
+    float    m_per_eHz;  // m/s per eHz
+    float    slip_max;   // Slip ratio allowed
+    float    acc_excess; // m/s^2, wheel over vehicle acceleration allowed
+    float    k_slip;     // Cut per unit of slip or acceleration error, in units of its limit
+    float    pitch_max;  // rad
+    float    lookahead;  // s
+    float    k_pitch;    // Cut per rad over pitch_max
+    float    recover;    // Per s
+    float    tau_acc;    // s, wheel acceleration filter
+    float    tau_v;      // s, vehicle speed estimate pulled to the wheel
+
+    // State
+    float    v_wheel;    // m/s
+    float    a_wheel;    // m/s^2
+    float    a_grip;     // m/s^2, wheel acceleration while it last gripped
+    float    v_est;      // m/s
+    float    a_imu;      // m/s^2
+    float    t_cut;      // s the factor has been held near zero
+    float    slip;       // Ratio
+    float    pitch_pred; // rad
+    float    scale;
+    bool     slipping;
+    bool     wheelie;
+    bool     primed;     // v_wheel has a previous value
+};
+
+typedef struct TRACTION TRACTION;
+
+void traction_init( TRACTION * const tc );
+
+/*
+Start over at a known wheel speed, in eHz.
+*/
+void traction_reset( TRACTION * const tc, float const eHz );
+
+/*
+Acceleration along the ground, in m/s^2, from the specific force acc in g and
+the pitch in rad. x is forward and z is up.
+*/
+float traction_imu_accel( float const * const acc, float const pitch );
+
+/*
+Vehicle acceleration for IMU a_fwd, m/s^2, so the attitude filter is not
+pulled by a long launch: the wheel while it grips, held at its last gripping
+value while it slips. The IMU ground acceleration depends on the pitch, so
+feeding it back would hold any pitch error.
+*/
+float traction_vehicle_accel( TRACTION const * const tc );
+
+/*
+Run once per control tick of T seconds. Takes the wheel speed in eHz, the
+ground acceleration in m/s^2, and the pitch and pitch rate in rad and rad/s.
+Returns the factor for the motoring request.
+*/
+float traction_run( TRACTION * const tc, float const eHz, float const a_imu, float const pitch, float const pitch_rate, float const T );
+
+#endif
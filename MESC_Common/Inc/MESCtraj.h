@@ -0,0 +1,154 @@
+/*
+ **
+ ******************************************************************************
+ * @file           : MESCtraj.h
+ * @brief          : Jerk limited trajectory planner and cascaded position loop
+ ******************************************************************************
+ * @attention
+ *
+ * <h2><center>&copy; Copyright (c) 2020 David Molony.
+ * All rights reserved.</center></h2>
+ *
+ * This software component is licensed under BSD 3-Clause license,
+ * the "License"; You may not use this file except in compliance with the
+ * License. You may obtain a copy of the License at:
+ *                        opensource.org/licenses/BSD-3-Clause
+ *
+ ******************************************************************************
+ *In addition to the usual 3 BSD clauses, it is explicitly noted that you
+ *do NOT have the right to take sections of this code for other projects
+ *without attribution and credit to the source. Specifically, if you copy into
+ *copyleft licenced code without attribution and retention of the permissive BSD
+ *3 clause licence, you grant a perpetual licence to do the same regarding turning sections of your code
+ *permissive, and lose any rights to use of this code previously granted or assumed.
+ *
+ *This code is intended to remain permissively licensed wherever it goes,
+ *maintaining the freedom to distribute compiled binaries WITHOUT a requirement to supply source.
+ *
+ *This is to ensure this code can at any point be used commercially, on products that may require
+ *such restriction to meet regulatory requirements, or to avoid damage to hardware, or to ensure
+ *warranties can reasonably be honoured.
+ ******************************************************************************
+ */
+
+
+#ifndef MESC_TRAJ_H
+#define MESC_TRAJ_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+Moves are planned from rest to rest as a seven segment S-curve: jerk up,
+constant acceleration, jerk down, cruise and the mirror image, each segment
+dropped or shortened when the move is too short to reach the limit. The plan
+is time optimal for the limits and is evaluated exactly at any time, so the
+references do not drift with the loop period.
+
+Positions are electrical angle counts (65536 per erev) on the wrapping
+uint32_t PLL_angle scale; the planner works in erev from the move start, so a
+single move keeps 1 count resolution up to 256 erev.
+
+The loop is position P into speed PI into the q current, with the planned
+speed fed forward to the speed loop and the planned acceleration, through the
+inertia, fed forward to the current.
+*/
+
+#define TRAJ_SEGMENTS 7
+#define TRAJ_COUNTS   65536.0f // Per erev
+
+#ifndef TRAJ_V_MAX
+#define TRAJ_V_MAX    50.0f    // eHz
+#endif
+#ifndef TRAJ_A_MAX
+#define TRAJ_A_MAX    500.0f   // eHz/s
+#endif
+#ifndef TRAJ_J_MAX
+#define TRAJ_J_MAX    10000.0f // eHz/s^2
+#endif
+#ifndef TRAJ_KP
+#define TRAJ_KP       10.0f    // 1/s
+#endif
+#ifndef TRAJ_I_MAX
+#define TRAJ_I_MAX    10.0f    // A
+#endif
+
+struct TRAJ
+{
+    // Limits, erev based
+    float    v_max;     // eHz
+    float    a_max;     // eHz/s
+    float    j_max;     // eHz/s^2
+
+    // Loop
+    float    Kp;        // 1/s, position error to speed
+    float    speed_kp;  // A/eHz
+    float    speed_ki;  // Fraction of the proportional term integrated per call
+    float    Kff;       // A per eHz/s, inertia feedforward
+    float    I_max;     // A
+
+    // Plan, erev from origin along dir
+    uint32_t origin;    // counts
+    uint32_t end;       // counts
+    float    dir;
+    float    D;         // erev
+    float    t_seg[TRAJ_SEGMENTS]; // s, segment start
+    float    p_seg[TRAJ_SEGMENTS];
+    float    v_seg[TRAJ_SEGMENTS];
+    float    a_seg[TRAJ_SEGMENTS];
+    float    j_seg[TRAJ_SEGMENTS];
+    float    duration;  // s
+    float    t;         // s into the move
+    float    p;         // erev into the move
+    bool     active;
+
+    uint32_t target;    // counts, next move once this one ends
+    bool     pending;
+
+    // References
+    uint32_t p_ref;     // counts
+    float    v_ref;     // eHz
+    float    a_ref;     // eHz/s
+
+    // Loop state
+    float    error;     // counts
+    float    integral;  // A
+    float    Iq;        // A
+};
+
+typedef struct TRAJ TRAJ;
+
+/*
+Load the limits and gains and hold at position.
+*/
+void traj_init( TRAJ * const tr, uint32_t const position );
+
+/*
+Stop any move and hold at position, clearing the loop state.
+*/
+void traj_hold( TRAJ * const tr, uint32_t const position );
+
+/*
+Plan a move from rest over D erev; the references follow on traj_sample.
+Returns the move duration in s.
+*/
+float traj_plan( TRAJ * const tr, float const D );
+
+/*
+Move to target. A move under way completes first and the new move starts
+from where it ends.
+*/
+void traj_move( TRAJ * const tr, uint32_t const target );
+
+/*
+Advance the plan by T seconds and update p_ref, v_ref and a_ref.
+*/
+void traj_sample( TRAJ * const tr, float const T );
+
+/*
+traj_sample then the cascaded loop against the measured position (counts) and
+speed (eHz), giving the q current request.
+*/
+float traj_run( TRAJ * const tr, uint32_t const position, float const eHz, float const T );
+
+#endif
@@ -0,0 +1,184 @@
+/*
+ **
+ ******************************************************************************
+ * @file           : MESCvehicle.h
+ * @brief          : Table driven vehicle state machine and ride modes
+ ******************************************************************************
+ * @attention
+ *
+ * <h2><center>&copy; Copyright (c) 2020 David Molony.
+ * All rights reserved.</center></h2>
+ *
+ * This software component is licensed under BSD 3-Clause license,
+ * the "License"; You may not use this file except in compliance with the
+ * License. You may obtain a copy of the License at:
+ *                        opensource.org/licenses/BSD-3-Clause
+ *
+ ******************************************************************************
+ *In addition to the usual 3 BSD clauses, it is explicitly noted that you
+ *do NOT have the right to take sections of this code for other projects
+ *without attribution and credit to the source. Specifically, if you copy into
+ *copyleft licenced code without attribution and retention of the permissive BSD
+ *3 clause licence, you grant a perpetual licence to do the same regarding turning sections of your code
+ *permissive, and lose any rights to use of this code previously granted or assumed.
+ *
+ *This code is intended to remain permissively licensed wherever it goes,
+ *maintaining the freedom to distribute compiled binaries WITHOUT a requirement to supply source.
+ *
+ *This is to ensure this code can at any point be used commercially, on products that may require
+ *such restriction to meet regulatory requirements, or to avoid damage to hardware, or to ensure
+ *warranties can reasonably be honoured.
+ ******************************************************************************
+ */
+
+
+#ifndef MESC_VEHICLE_H
+#define MESC_VEHICLE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+The vehicle app as a table of transitions: in a state, an event whose guard
+holds moves to the next state and runs the action. The first matching row
+wins, and an event with no matching row is dropped.
+
+Events come from the inputs on the tick their edge is seen. An accepted edge
+locks that input for the debounce time, so contact bounce is ignored without
+waiting to confirm the edge. Speed and throttle crossings and the park timer
+are events too, so nothing polls the levels.
+
+  PARKED  - locked; brake with the stand up and the throttle closed to drive,
+            or without brake_to_drive, just the stand up and throttle closed
+  DRIVE   - forward on the ride mode maps
+  REVERSE - backwards at reverse_scale of the mode current and speed
+  CRUISE  - holds the speed at engagement; brake, throttle or cruise cancel
+  ERROR   - locked until the fault clears with the throttle closed
+
+Stand down, or standing still with the throttle closed for park_time, parks.
+Reverse only engages or disengages stood still; a reverse switch moved on the
+move takes effect once stopped.
+*/
+
+#ifndef VEH_DEBOUNCE
+#define VEH_DEBOUNCE   0.05f  // s an input is locked after an edge
+#endif
+#ifndef VEH_PARK_TIME
+#define VEH_PARK_TIME  60.0f  // s stood still before parking
+#endif
+#define VEH_THROTTLE_ON   0.05f // Throttle crossings, with hysteresis
+#define VEH_THROTTLE_OFF  0.02f
+#define VEH_MODES         3
+#define VEH_MAP_POINTS    5     // Throttle map points from 0 to full
+
+enum VEHState
+{
+    VEH_STATE_PARKED,
+    VEH_STATE_DRIVE,
+    VEH_STATE_REVERSE,
+    VEH_STATE_CRUISE,
+    VEH_STATE_ERROR,
+
+    VEH_STATES,
+};
+
+typedef enum VEHState VEHState;
+
+enum VEHEvent
+{
+    VEH_EV_START,        // First update
+    VEH_EV_STAND_DOWN,
+    VEH_EV_STAND_UP,
+    VEH_EV_BRAKE_ON,
+    VEH_EV_BRAKE_OFF,
+    VEH_EV_REVERSE_ON,
+    VEH_EV_REVERSE_OFF,
+    VEH_EV_CRUISE,       // Cruise button pressed
+    VEH_EV_MODE,         // Ride mode button pressed
+    VEH_EV_THROTTLE_ON,
+    VEH_EV_THROTTLE_OFF,
+    VEH_EV_STOPPED,      // Speed fell below eHz_stop
+    VEH_EV_PARK_TIMER,
+    VEH_EV_FAULT,
+    VEH_EV_FAULT_CLEAR,
+
+    VEH_EVENTS,
+};
+
+typedef enum VEHEvent VEHEvent;
+
+// Inputs, set when active
+#define VEH_IN_STAND   (1u << 0) // Side stand down
+#define VEH_IN_BRAKE   (1u << 1)
+#define VEH_IN_REVERSE (1u << 2)
+#define VEH_IN_CRUISE  (1u << 3)
+#define VEH_IN_MODE    (1u << 4)
+#define VEH_INPUTS     5
+
+struct VEHMode
+{
+    float I_max;                  // Fraction of the max request at full throttle
+    float I_brake;                // Fraction of the min request at full brake
+    float eHz_max;                // eHz, motoring tapers to zero over the next 10%, 0 for none
+    float map[VEH_MAP_POINTS];    // Fraction of I_max at evenly spaced throttle
+};
+
+typedef struct VEHMode VEHMode;
+
+struct VEHICLE
+{
+    // Configuration
+    VEHMode  modes[VEH_MODES];
+    float    reverse_scale;  // Fraction of the mode current and speed in reverse
+    float    eHz_stop;       // eHz, stood still below
+    float    eHz_cruise;     // eHz, cruise engages above
+    float    debounce;       // s
+    float    park_time;      // s
+    bool     momentary_reverse; // A button toggling, rather than a switch
+    bool     brake_to_drive; // Unparking needs the brake, only with a brake input
+
+    // Inputs
+    uint32_t in;
+    float    throttle;       // -1..1, negative brakes
+    float    eHz;
+    bool     fault;
+
+    // State
+    VEHState state;
+    uint8_t  mode;
+    float    lock[VEH_INPUTS];
+    bool     throttle_on;
+    bool     moving;
+    bool     faulted;
+    bool     started;
+    float    t_still;        // s stood still with the throttle closed
+    float    cruise_eHz;
+    uint32_t events;         // Dispatched, for diagnostics
+};
+
+typedef struct VEHICLE VEHICLE;
+
+void vehicle_init( VEHICLE * const veh );
+
+/*
+Dispatch one event through the table. Returns true when a row matched.
+*/
+bool vehicle_dispatch( VEHICLE * const veh, VEHEvent const ev );
+
+/*
+Take the inputs for this tick, T seconds after the last, turning their edges
+into events.
+*/
+void vehicle_update( VEHICLE * const veh, uint32_t const in, float const throttle,
+                     float const eHz, bool const fault, float const T );
+
+/*
+q current request for the state, ride mode and throttle, as a fraction of the
+max request when positive and of the min request when negative. 0 while locked
+and in cruise, where the speed loop holds cruise_eHz.
+*/
+float vehicle_request( VEHICLE const * const veh );
+
+bool vehicle_locked( VEHICLE const * const veh );
+
+#endif
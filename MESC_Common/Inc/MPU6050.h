@@ -7,6 +7,8 @@
 #ifndef INC_MPU6050_H_
 #define INC_MPU6050_H_
 
+#include "MESCimu.h"
+
 typedef struct {
 	I2C_HandleTypeDef *MPU6050_I2C;
 	uint16_t MPU6050_address;
@@ -17,6 +19,7 @@ typedef struct {
 	int16_t XGYR;
 	int16_t YGYR;
 	int16_t ZGYR;
+	IMU imu; //FIFO burst reader, see MESCimu.h
 } MPU6050_data_t;
 
 
@@ -24,6 +27,20 @@ int MPU6050Init(I2C_HandleTypeDef *i2c_handle, uint16_t address, MPU6050_data_t
 
 int MPU6050GetData(MPU6050_data_t *MPU_instance);
 
+//Non blocking FIFO reads. Poll at a few ms, from a timer or the data ready interrupt, with a us timestamp;
+//the board passes its HAL_I2C_MemRxCpltCallback and HAL_I2C_ErrorCallback on to MPU6050RxCplt and
+//MPU6050Error. Process from the task that uses the attitude.
+int MPU6050InitDMA(I2C_HandleTypeDef *i2c_handle, uint16_t address, MPU6050_data_t *MPU_instance, float odr);
+
+void MPU6050Poll(MPU6050_data_t *MPU_instance, uint32_t now_us);
+
+uint32_t MPU6050Process(MPU6050_data_t *MPU_instance);
+
+//Return 1 if the transfer on hi2c was an IMU burst, 0 if it belongs to another user of the bus
+int MPU6050RxCplt(I2C_HandleTypeDef *hi2c);
+
+int MPU6050Error(I2C_HandleTypeDef *hi2c);
+
 
 
 
@@ -41,14 +41,8 @@
 #include "MESCerror.h"
 #include "stm32fxxx_hal.h"
 
-typedef struct {
-	uint32_t reverseState;
-	uint32_t sidestandState;
-	uint32_t brakeState;
-
-}Vehicle_s;
-
-Vehicle_s vehicle;
+VEHICLE vehicle;
+IMU *vehicle_imu = NULL;
 
 /////Macros to read inputs
 
@@ -70,18 +64,28 @@ Vehicle_s vehicle;
 	#define getBrakeState(...) (1) //Default no brake, vehicle moves
 #endif
 
-uint32_t vehicle_state = VEHICLE_IDLE;
-uint32_t vehicle_direction = VEHICLE_FORWARD;
-uint32_t debounce(uint32_t var, uint32_t input){
-	if((var>0) && (!input)){
-		 var = var-1;
-	}else if(var == 0){
-		var = 100; //Reset it to far from the threshold
-	}else if((var<100)){
-		var = var+1;
-	}
-	return var;
+#ifdef CRUISE_GPIO
+	#define getCruiseState(...) ((CRUISE_GPIO->IDR >> (CRUISE_IONO)) & 0x1)
+#else
+	#define getCruiseState(...) (1) //Default no cruise button
+#endif
+
+#ifdef MODE_GPIO
+	#define getModeState(...) ((MODE_GPIO->IDR >> (MODE_IONO)) & 0x1)
+#else
+	#define getModeState(...) (1) //Default no ride mode button
+#endif
+
+void Vehicle_init(void){
+	vehicle_init(&vehicle);
+#ifdef BRAKE_GPIO
+	vehicle.brake_to_drive = true; //Only ask for the brake to unpark when there is one
+#endif
+#ifdef MOMENTARY_REV
+	vehicle.momentary_reverse = true;
+#endif
 }
+
 void No_app(MESC_motor_typedef *_motor){
 	//Sum the inputs
 	  //We just scale and sum the input current requests
@@ -94,68 +98,73 @@ void No_app(MESC_motor_typedef *_motor){
 	  _motor->FOC.Idq_prereq.q = clamp(_motor->FOC.Idq_prereq.q, _motor->input_vars.min_request_Idq.q, _motor->input_vars.max_request_Idq.q);
 }
 
-void Vehicle_app(MESC_motor_typedef *_motor){
-	//Sum the inputs
-	  //We just scale and sum the input current requests
-	  _motor->FOC.Idq_prereq.q = 	_motor->input_vars.UART_req +
-	  	  	  	  	  	  	  	  	_motor->input_vars.max_request_Idq.q * (_motor->input_vars.ADC1_req + _motor->input_vars.ADC2_req +
-	  	  	  	  	  	  	  	  	_motor->input_vars.RCPWM_req + _motor->input_vars.ADC12_diff_req +
-									_motor->input_vars.remote_ADC1_req + _motor->input_vars.remote_ADC2_req );
+//Per motor, the mode each one was in before cruise took it over
+static bool cruising[NUM_MOTORS];
+static motor_control_mode_e cruise_prev_mode[NUM_MOTORS];
 
-	  //Clamp the Q component; d component is not directly requested
-	  _motor->FOC.Idq_prereq.q = clamp(_motor->FOC.Idq_prereq.q, _motor->input_vars.min_request_Idq.q, _motor->input_vars.max_request_Idq.q);
-	  vehicle.sidestandState = getSidestandState();
-#ifdef MOMENTARY_REV
-//	  vehicle.reverseState = getReverseState();
-	  vehicle.reverseState = debounce(vehicle.reverseState, getReverseState());
-	  if((!vehicle.reverseState)&&(fabsf(_motor->FOC.Idq_prereq.q)<5.0f)){
-		  vehicle_direction = vehicle_direction+1;
-		  vehicle_direction = vehicle_direction & 0x1;
-	  }
-	  if(vehicle_direction){
-		  //Nothing
-	  }else{
-		  _motor->FOC.Idq_prereq.q *= -1.0f;
-	  }
-#else
-	  vehicle.reverseState = getReverseState();
-	  if(vehicle.reverseState == 0){
-		  _motor->FOC.Idq_prereq.q *= -1.0f;
-	  }
-#endif
-	  vehicle.brakeState = getBrakeState();
-
-/////////////////////////////Vehicle State Machine
-	switch(vehicle_state){
-	case VEHICLE_IDLE:
-		_motor->key_bits |= APP_KEY; //Set the bit; lock the motor from current
-		//HACK
-		vehicle_state = VEHICLE_DRIVE; //Move direct to drive for testing, otherwise it will lock the vehicle...
-//Add state machine logics
-		break;
-	case VEHICLE_PARKED:
-		_motor->key_bits |= APP_KEY; //Set the bit; lock the motor from current
-//Add state machine logics
-
-		break;
-	case VEHICLE_DRIVE:
-		_motor->key_bits &= ~APP_KEY; //Clear the bit; allow motor current
-//Add state machine logics
-
-		break;
-	case VEHICLE_x:
-		break;
-	case VEHICLE_y:
-		break;
-	default:
-		handleError(_motor,ERROR_APP);
-		_motor->key_bits |= APP_KEY; //Set the bit; lock the motor from current
+void Vehicle_app(MESC_motor_typedef *_motor){
+	uint32_t const m = (uint32_t)(_motor - mtr);
+
+	//There is one vehicle; it steps once per tick on the inputs of the first motor and every motor follows it
+	if(_motor == &mtr[0]){
+		  //Sum the inputs into a throttle, -1..1 across the request range
+		  float req = 	_motor->input_vars.UART_req +
+		  	  	  	  	_motor->input_vars.max_request_Idq.q * (_motor->input_vars.ADC1_req + _motor->input_vars.ADC2_req +
+		  	  	  	  	_motor->input_vars.RCPWM_req + _motor->input_vars.ADC12_diff_req +
+						_motor->input_vars.remote_ADC1_req + _motor->input_vars.remote_ADC2_req );
+		  req = clamp(req, _motor->input_vars.min_request_Idq.q, _motor->input_vars.max_request_Idq.q);
+		  float throttle = 0.0f;
+		  if((req > 0.0f) && (_motor->input_vars.max_request_Idq.q > 0.0f)){
+			  throttle = req/_motor->input_vars.max_request_Idq.q;
+		  }else if((req < 0.0f) && (_motor->input_vars.min_request_Idq.q < 0.0f)){
+			  throttle = -req/_motor->input_vars.min_request_Idq.q;
+		  }
+
+		  //The switches are active low
+		  uint32_t in = 0;
+		  if(!getSidestandState()){in |= VEH_IN_STAND;}
+		  if(!getBrakeState()){in |= VEH_IN_BRAKE;}
+		  if(!getReverseState()){in |= VEH_IN_REVERSE;}
+		  if(!getCruiseState()){in |= VEH_IN_CRUISE;}
+		  if(!getModeState()){in |= VEH_IN_MODE;}
+
+		  //Edges become events on this tick, see MESCvehicle.h
+		  vehicle_update(&vehicle, in, throttle, _motor->FOC.eHz, (_motor->MotorState == MOTOR_STATE_ERROR), 1.0f/(float)SLOW_LOOP_FREQUENCY);
 	}
 
-//	_motor->key_bits;
-
-// 	_motor->key_bits |= APP_KEY; Set the bit; lock the motor from current
-//	_motor->key_bits &= ~APP_KEY; Clear the bit - allow current
+	  float r = vehicle_request(&vehicle);
+	  _motor->FOC.Idq_prereq.q = (r >= 0.0f) ? r*_motor->input_vars.max_request_Idq.q : -r*_motor->input_vars.min_request_Idq.q;
+
+	  //Traction control scales the motoring request on wheel slip and wheelie, see MESCtraction.h
+	  //The board reads and processes the IMU with its own timestamps ahead of the slow loop
+	  if(_motor->options.use_traction && (vehicle_imu != NULL)){
+		  float scale = traction_run(&_motor->traction, _motor->FOC.eHz,
+				  traction_imu_accel(vehicle_imu->last.acc, vehicle_imu->att.pitch),
+				  vehicle_imu->att.pitch, vehicle_imu->last.gyr[1], 1.0f/(float)SLOW_LOOP_FREQUENCY);
+		  vehicle_imu->a_fwd = traction_vehicle_accel(&_motor->traction);
+		  if(_motor->FOC.Idq_prereq.q > 0.0f){
+			  _motor->FOC.Idq_prereq.q = _motor->FOC.Idq_prereq.q*scale;
+		  }
+	  }
 
+	  //Cruise hands the q request to the speed loop, starting from the current it was engaged at
+	  if(vehicle.state == VEH_STATE_CRUISE){
+		  if(!cruising[m]){
+			  cruising[m] = true;
+			  cruise_prev_mode[m] = _motor->ControlMode;
+			  speedloop_reset(&_motor->speedloop, _motor->FOC.eHz);
+			  _motor->speedloop.integral = _motor->FOC.Idq_req.q;
+			  _motor->FOC.speed_req = vehicle.cruise_eHz;
+			  _motor->ControlMode = MOTOR_CONTROL_MODE_SPEED;
+		  }
+	  }else if(cruising[m]){
+		  cruising[m] = false;
+		  _motor->ControlMode = cruise_prev_mode[m];
+	  }
 
+	  if(vehicle_locked(&vehicle)){
+		  _motor->key_bits |= APP_KEY; //Set the bit; lock the motor from current
+	  }else{
+		  _motor->key_bits &= ~APP_KEY; //Clear the bit; allow motor current
+	  }
 }
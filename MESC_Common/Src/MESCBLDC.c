@@ -297,67 +297,26 @@ void BLDCCommute(MESC_motor_typedef *_motor){
 			_motor->BLDC.I_error = 0.05f*_motor->BLDC.int_I_error;
 		}
 	}
+	if(_motor->BLDC.V_bldc < 0.0f){
+		_motor->BLDC.V_bldc = 0.0f;
+		if(_motor->BLDC.int_I_error < 0.0f){
+			_motor->BLDC.int_I_error = 0.0f;
+		}
+	}
 	//Determine the conversion from volts to PWM
 	_motor->BLDC.V_bldc_to_PWM = _motor->mtimer->Instance->ARR/_motor->Conv.Vbus;
 	//Convert to PWM value
 	_motor->BLDC.BLDC_PWM = _motor->BLDC.V_bldc*_motor->BLDC.V_bldc_to_PWM;
 
 
-//////Integrate and determine if commutation ready, VBEMF = Vbldc-2*I*Rphase
-	_motor->BLDC.flux_integral = _motor->BLDC.flux_integral + (_motor->BLDC.V_bldc - _motor->BLDC.I_meas * 2.0f*_motor->m.R)* _motor->BLDC.PWM_period; //Volt seconds
-
-	//FUDGED
-	_motor->BLDC.closed_loop = 1;
-	if(_motor->BLDC.closed_loop){
-		//If the flux reaches a limit  then commute
-		if(_motor->BLDC.flux_integral<0.0f){_motor->BLDC.flux_integral = 0.0f;}
-		if(_motor->BLDC.flux_integral>_motor->BLDC.com_flux){
-			_motor->BLDC.V_meas_sect[_motor->BLDC.sector] = _motor->BLDC.V_meas;
-
-			_motor->BLDC.sector = _motor->BLDC.sector + _motor->BLDC.direction;
-			_motor->BLDC.last_flux_integral = _motor->BLDC.flux_integral;
-			_motor->BLDC.flux_integral = 0.0f; //Reset the integrator
-			_motor->BLDC.last_p_error = _motor->BLDC.I_error;
-			//Run a vague tuning mechanism, needs a lot of work.
-			if((_motor->BLDC.int_I_error>_motor->Conv.Vbus*0.4f) && (_motor->BLDC.int_I_error<_motor->Conv.Vbus*0.9f)){
-				if(_motor->BLDC.I_error>0.05f*_motor->BLDC.int_I_error){
-					_motor->BLDC.com_flux = _motor->BLDC.com_flux*1.005f;
-				}
-				if(_motor->BLDC.I_error<0.05f*_motor->BLDC.int_I_error){
-					_motor->BLDC.com_flux = _motor->BLDC.com_flux*0.99f;
-				}
-			}
-
-//			_motor->BLDC.rising_int_st =_motor->BLDC.rising_int;
-//			_motor->BLDC.rising_int = 0.0f;
-//			_motor->BLDC.falling_int_st = _motor->BLDC.falling_int;
-//			_motor->BLDC.falling_int = 0.0f;
-//			if(_motor->BLDC.falling_int_st > _motor->BLDC.falling_int_st){
-//				_motor->BLDC.com_flux = _motor->BLDC.com_flux * 1.01f;
-//			}else{
-//				_motor->BLDC.com_flux = _motor->BLDC.com_flux * 0.99f;
-//			}
-//
-//			if(_motor->BLDC.com_flux<0.018f){_motor->BLDC.com_flux=0.018f;}
-//			if(_motor->BLDC.com_flux>0.022f){_motor->BLDC.com_flux=0.022f;}
-
-		}
-	}else{
-		_motor->BLDC.OL_countdown--;
-		if(_motor->BLDC.OL_countdown == 0){
-			_motor->BLDC.OL_countdown =_motor->BLDC.OL_periods;
-			_motor->BLDC.sector++;
-			_motor->BLDC.last_flux_integral = _motor->BLDC.flux_integral;
-			_motor->BLDC.flux_integral = 0.0f; //Reset the integrator
-		}
-	}
-
-//////Wrap the sector
-	if(_motor->BLDC.sector>5){
-		_motor->BLDC.sector = 0;
-	}else if(_motor->BLDC.sector<0){
-		_motor->BLDC.sector = 5;
-	}
+//////Commutate on the floating phase BEMF, see MESCsixstep.h
+	sixstep_run(&_motor->sixstep, _motor->Conv.Vu, _motor->Conv.Vv, _motor->Conv.Vw, _motor->BLDC.PWM_period);
+	_motor->BLDC.direction = _motor->sixstep.direction;
+	_motor->BLDC.V_meas = _motor->sixstep.bemf;
+	//Turning backwards, the swapped pair three sectors on motors
+	_motor->BLDC.sector = (_motor->sixstep.direction < 0) ? _motor->sixstep.sector : ((_motor->sixstep.sector + 3) % 6);
+	//The PLL follows this through the sectors, keeping eHz and the angle current for the handover back
+	_motor->FOC.FOCAngle = sixstep_angle(&_motor->sixstep);
 
 //////Write PWMs
 	switch (_motor->BLDC.sector){
@@ -0,0 +1,181 @@
+/*
+ **
+ ******************************************************************************
+ * @file           : MESCapll.c
+ * @brief          : Adaptive bandwidth angle and speed tracker
+ ******************************************************************************
+ * @attention
+ *
+ * <h2><center>&copy; Copyright (c) 2020 David Molony.
+ * All rights reserved.</center></h2>
+ *
+ * This software component is licensed under BSD 3-Clause license,
+ * the "License"; You may not use this file except in compliance with the
+ * License. You may obtain a copy of the License at:
+ *                        opensource.org/licenses/BSD-3-Clause
+ *
+ ******************************************************************************
+ *In addition to the usual 3 BSD clauses, it is explicitly noted that you
+ *do NOT have the right to take sections of this code for other projects
+ *without attribution and credit to the source. Specifically, if you copy into
+ *copyleft licenced code without attribution and retention of the permissive BSD
+ *3 clause licence, you grant a perpetual licence to do the same regarding turning sections of your code
+ *permissive, and lose any rights to use of this code previously granted or assumed.
+ *
+ *This code is intended to remain permissively licensed wherever it goes,
+ *maintaining the freedom to distribute compiled binaries WITHOUT a requirement to supply source.
+ *
+ *This is to ensure this code can at any point be used commercially, on products that may require
+ *such restriction to meet regulatory requirements, or to avoid damage to hardware, or to ensure
+ *warranties can reasonably be honoured.
+ ******************************************************************************
+ */
+
+
+#include "MESCapll.h"
+
+#include <math.h>
+
+/*
+PI
+    predict   angle += omega
+    correct   angle += a.e     omega += b.e
+    a = 1 - p^2, b = (1 - p)^2
+
+KALMAN
+    predict   angle += omega + alpha/2     omega += alpha
+    correct   angle += a.e     omega += b.e     alpha += c.e
+    a = 1 - p^3, b = 1.5 (1 - p)^2 (1 + p), c = (1 - p)^3
+
+These are the steady state Kalman gains for a constant velocity (or
+acceleration) model at one particular ratio of process to measurement
+noise; scheduling p moves along that family instead of running the
+covariance update in the fast loop.
+*/
+
+#define APLL_TWO_PI 6.28318531f
+
+void apll_init( APLL * const ap, float const f )
+{
+    ap->type      = APLL_TYPE_NONE;
+    ap->f         = f;
+    ap->bw_min    = 1000.0f;
+    ap->bw_max    = 6000.0f;
+    ap->bw_ratio  = 2.0f;
+    ap->noise_ref = 500.0f;
+
+    apll_reset( ap, 0 );
+}
+
+void apll_reset( APLL * const ap, uint32_t const angle )
+{
+    ap->angle   = angle;
+    ap->frac    = 0.0f;
+    ap->omega   = 0.0f;
+    ap->alpha   = 0.0f;
+    ap->err     = 0.0f;
+    ap->e_avg   = 0.0f;
+    ap->e2_avg  = 0.0f;
+    ap->quality = 1.0f;
+    ap->bw      = ap->bw_min;
+}
+
+void apll_set_frequency( APLL * const ap, float const f )
+{
+    if ((ap->f > 0.0f) && (f > 0.0f))
+    {
+        float const ratio = ap->f / f;
+
+        ap->omega = ap->omega * ratio;
+        ap->alpha = ap->alpha * ratio * ratio;
+    }
+
+    ap->f = f;
+}
+
+void apll_run( APLL * const ap, uint16_t const theta )
+{
+    if (ap->f <= 0.0f)
+    {
+        return;
+    }
+
+    // Predict
+    float step = ap->omega;
+
+    if (ap->type == APLL_TYPE_KALMAN)
+    {
+        step = step + (0.5f * ap->alpha);
+        ap->omega = ap->omega + ap->alpha;
+    }
+
+    float p = ap->frac + step;
+    float n = floorf( p );
+
+    ap->angle = ap->angle + (uint32_t)(int32_t)n;
+    ap->frac  = p - n;
+
+    float const e = (float)(int16_t)(theta - (uint16_t)(ap->angle & 0xFFFF)) - ap->frac;
+
+    // Innovation statistics; a persistent offset is lag and wants more
+    // bandwidth, only the part that averages out is treated as noise
+    ap->e_avg  = ap->e_avg  + (APLL_STAT_RATE * (e - ap->e_avg));
+    ap->e2_avg = ap->e2_avg + (APLL_STAT_RATE * ((e * e) - ap->e2_avg));
+
+    float const var   = ap->e2_avg - (ap->e_avg * ap->e_avg);
+    float const noise = (var > 0.0f) ? sqrtf( var ) : 0.0f;
+
+    ap->quality = ap->noise_ref / (ap->noise_ref + noise);
+
+    // Schedule the bandwidth
+    float bw = ap->bw_ratio * APLL_TWO_PI * fabsf( apll_eHz( ap ) );
+
+    if (bw < ap->bw_min)
+    {
+        bw = ap->bw_min;
+    }
+    else if (bw > ap->bw_max)
+    {
+        bw = ap->bw_max;
+    }
+
+    bw = bw * ((ap->quality > APLL_QUALITY_MIN) ? ap->quality : APLL_QUALITY_MIN);
+
+    if (bw > (APLL_BWT_MAX * ap->f))
+    {
+        bw = APLL_BWT_MAX * ap->f;
+    }
+
+    ap->bw = bw;
+
+    float const pole = expf( -bw / ap->f );
+    float const q    = 1.0f - pole;
+
+    // Correct
+    float a;
+
+    if (ap->type == APLL_TYPE_KALMAN)
+    {
+        a = 1.0f - (pole * pole * pole);
+        ap->omega = ap->omega + (1.5f * q * q * (1.0f + pole) * e);
+        ap->alpha = ap->alpha + (q * q * q * e);
+    }
+    else
+    {
+        a = 1.0f - (pole * pole);
+        ap->omega = ap->omega + (q * q * e);
+    }
+
+    ap->err = a * e;
+
+    p = ap->frac + ap->err;
+    n = floorf( p );
+
+    ap->angle = ap->angle + (uint32_t)(int32_t)n;
+    ap->frac  = p - n;
+}
+
+float apll_eHz( APLL const * const ap )
+{
+    return ap->omega * ap->f * (1.0f / 65536.0f);
+}
@@ -0,0 +1,318 @@
+/*
+* Copyright 2021-2023 cod3b453
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its contributors
+*    may be used to endorse or promote products derived from this software
+*    without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "MESCbat.h"
+
+#include <math.h>
+#include <stddef.h>
+
+_Static_assert( sizeof(BATProfile) == 0x34, "Malformed BATProfile" );
+
+// MESCbat.js defaults
+static BATProfile const bat_profile_default =
+{
+    .cell =
+    {
+        .Imax = 30.0f,
+        .Vmax =  4.2f,
+        .Cmax =  4.2f,
+        .Vmid =  3.4f,
+        .Cmid =  0.7f,
+        .Vlow =  3.2f,
+        .Clow =  0.5f,
+        .Vmin =  2.8f,
+    },
+    .battery =
+    {
+        .Imax     =  50.0f,
+        .Pmax     = 250.0f,
+        .ESR      =   0.1f,
+        .parallel =   2,
+        .series   =  20,
+    },
+    .display = BAT_DISPLAY_PERCENT,
+};
+
+static BATProfile const * bat_profile = &bat_profile_default;
+
+// Engine used for the level functions, only its curve and R0 are used
+static BAT bat_level;
+
+/*
+Charge held at voltage V, and the slope dV/dC of the curve there; outside the
+curve the end is held and the end segment slope given.
+*/
+static float bat_ocv_charge( BAT const * const bat, float const V, float * const slope )
+{
+    uint32_t i = 1;
+
+    while ((i < (BAT_OCV_POINTS - 1)) && (V > bat->ocv_V[i]))
+    {
+        ++i;
+    }
+
+    float const dV = bat->ocv_V[i] - bat->ocv_V[i - 1];
+    float const dC = bat->ocv_C[i] - bat->ocv_C[i - 1];
+
+    if (slope != NULL)
+    {
+        *slope = dV / dC;
+    }
+
+    if (V <= bat->ocv_V[0])
+    {
+        return bat->ocv_C[0];
+    }
+
+    if (V >= bat->ocv_V[BAT_OCV_POINTS - 1])
+    {
+        return bat->ocv_C[BAT_OCV_POINTS - 1];
+    }
+
+    return bat->ocv_C[i - 1] + ((V - bat->ocv_V[i - 1]) * dC / dV);
+}
+
+static float bat_ocv_voltage( BAT const * const bat, float const C )
+{
+    if (C <= bat->ocv_C[0])
+    {
+        return bat->ocv_V[0];
+    }
+
+    uint32_t i = 1;
+
+    while ((i < (BAT_OCV_POINTS - 1)) && (C > bat->ocv_C[i]))
+    {
+        ++i;
+    }
+
+    if (C >= bat->ocv_C[i])
+    {
+        return bat->ocv_V[i];
+    }
+
+    return bat->ocv_V[i - 1] + ((C - bat->ocv_C[i - 1]) * (bat->ocv_V[i] - bat->ocv_V[i - 1]) / (bat->ocv_C[i] - bat->ocv_C[i - 1]));
+}
+
+static float bat_clamp( float const x, float const lo, float const hi )
+{
+    return fminf( fmaxf( x, lo ), hi );
+}
+
+void bat_init( BATProfile const * const profile )
+{
+    bat_profile = ((profile != NULL) ? profile : &bat_profile_default);
+
+    bat_notify_profile_update();
+}
+
+void bat_notify_profile_update( void )
+{
+    bat_reset( &bat_level, bat_profile );
+}
+
+BATProfile const * bat_get_profile( void )
+{
+    return bat_profile;
+}
+
+float bat_get_charge_level( float const V, float const I )
+{
+    float const C = bat_ocv_charge( &bat_level, (V + (I * bat_level.R0)), NULL );
+
+    switch (bat_profile->display)
+    {
+        case BAT_DISPLAY_AMPHOUR:
+            return C;
+        case BAT_DISPLAY_PERCENT:
+        default:
+            return ((100.0f * C) / bat_level.Cmax);
+    }
+}
+
+float bat_get_level_voltage( float const L )
+{
+    switch (bat_profile->display)
+    {
+        case BAT_DISPLAY_AMPHOUR:
+            return bat_ocv_voltage( &bat_level, L );
+        case BAT_DISPLAY_PERCENT:
+        default:
+            return bat_ocv_voltage( &bat_level, ((L * bat_level.Cmax) / 100.0f) );
+    }
+}
+
+void bat_reset( BAT * const bat, BATProfile const * const profile )
+{
+    BATProfile const * const bp = ((profile != NULL) ? profile : bat_profile);
+
+    float const s = (float)bp->battery.series;
+    float const p = (float)bp->battery.parallel;
+
+    bat->ocv_V[0] = bp->cell.Vmin * s;
+    bat->ocv_C[0] = 0.0f;
+    bat->ocv_V[1] = bp->cell.Vlow * s;
+    bat->ocv_C[1] = bp->cell.Clow * p;
+    bat->ocv_V[2] = bp->cell.Vmid * s;
+    bat->ocv_C[2] = bp->cell.Cmid * p;
+    bat->ocv_V[3] = bp->cell.Vmax * s;
+    bat->ocv_C[3] = bp->cell.Cmax * p;
+
+    bat->Cmax    = bat->ocv_C[BAT_OCV_POINTS - 1];
+    bat->Vmin    = (bp->cell.Vmin + BAT_V_MARGIN_CELL) * s;
+    bat->Vmax    = (bp->cell.Vmax - BAT_V_MARGIN_CELL) * s;
+    bat->V_sigma = BAT_V_SIGMA_CELL * s;
+    bat->Imax    = fminf( (bp->cell.Imax * p), bp->battery.Imax );
+    bat->Pmax    = bp->battery.Pmax;
+    bat->R0      = ((bp->battery.ESR > 0.0f) ? bp->battery.ESR : (0.001f * s / p));
+
+    float const dI = BAT_R_STEP * bat->Imax;
+
+    bat->R_P0    = 1.0f / (dI * dI);
+
+    bat->C       = 0.5f * bat->Cmax;
+    bat->C_sd    = bat->Cmax;
+    bat->R       = bat->R0;
+    bat->R_P     = bat->R_P0;
+    bat->E       = 0.0f;
+    bat->I_rest  = 0.0f;
+    bat->V_last  = 0.0f;
+    bat->I_last  = 0.0f;
+    bat->primed  = false;
+
+    bat->Idis    = 0.0f;
+    bat->Ichg    = 0.0f;
+}
+
+static void bat_update_resistance( BAT * const bat, float const dV, float const dI )
+{
+    if (fabsf( dI ) < (BAT_R_STEP * bat->Imax))
+    {
+        return;
+    }
+
+    // Scalar RLS on -dV = R*dI
+    float const g = (bat->R_P * dI) / (BAT_R_FORGET + (bat->R_P * dI * dI));
+
+    bat->R   = bat->R + (g * (-dV - (bat->R * dI)));
+    bat->R_P = fminf( (((1.0f - (g * dI)) * bat->R_P) / BAT_R_FORGET), bat->R_P0 );
+
+    bat->R   = bat_clamp( bat->R, (0.1f * bat->R0), (10.0f * bat->R0) );
+}
+
+static void bat_update_charge( BAT * const bat, float const Em, float const I, float const T )
+{
+    // Coulomb count
+    bat->C    = bat->C - ((I * T) / 3600.0f);
+    bat->C_sd = bat->C_sd + ((BAT_I_BIAS * T) / 3600.0f);
+
+    /*
+    Correct towards the curve. Polarisation follows the recent current, and the
+    curve error persists between samples, so one sample only carries T/BAT_T_CORR
+    of an independent measurement.
+    */
+    float slope;
+    float const Cm = bat_ocv_charge( bat, Em, &slope );
+
+    float const sigma_V = bat->V_sigma + (bat->R * fmaxf( fabsf( I ), bat->I_rest ));
+    float const sigma_C = sigma_V / slope;
+
+    float const var = bat->C_sd * bat->C_sd;
+    float const K   = var / (var + ((sigma_C * sigma_C) * (BAT_T_CORR / T)));
+
+    bat->C    = bat_clamp( (bat->C + (K * (Cm - bat->C))), 0.0f, bat->Cmax );
+    bat->C_sd = sqrtf( (1.0f - K) * var );
+}
+
+static void bat_update_limits( BAT * const bat )
+{
+    float const E = bat->E;
+    float const R = bat->R;
+
+    // Terminals at Vmin
+    float Idis = (E - bat->Vmin) / R;
+
+    // Beyond E/2R more current gives less power
+    Idis = fminf( Idis, (E / (2.0f * R)) );
+
+    // Least current delivering Pmax, solving (E - I*R)*I = Pmax
+    if (bat->Pmax > 0.0f)
+    {
+        float const d = (E * E) - (4.0f * R * bat->Pmax);
+
+        if (d > 0.0f)
+        {
+            Idis = fminf( Idis, ((E - sqrtf( d )) / (2.0f * R)) );
+        }
+    }
+
+    bat->Idis = bat_clamp( Idis, 0.0f, bat->Imax );
+
+    // Terminals at Vmax
+    bat->Ichg = bat_clamp( ((bat->Vmax - E) / R), 0.0f, bat->Imax );
+}
+
+void bat_update( BAT * const bat, float const V, float const I, float const T )
+{
+    // No bus
+    if (V < (0.5f * bat->ocv_V[0]))
+    {
+        return;
+    }
+
+    float const Em = V + (I * bat->R);
+
+    if (!bat->primed)
+    {
+        bat->C      = bat_ocv_charge( bat, Em, NULL );
+        bat->C_sd   = BAT_C_SEED * bat->Cmax;
+        bat->E      = Em;
+        bat->primed = true;
+    }
+    else
+    {
+        bat_update_resistance( bat, (V - bat->V_last), (I - bat->I_last) );
+
+        bat->I_rest = bat->I_rest + ((fminf( (T / BAT_T_REST), 1.0f )) * (fabsf( I ) - bat->I_rest));
+
+        bat_update_charge( bat, (V + (I * bat->R)), I, T );
+
+        bat->E = bat->E + (BAT_K_EMF * ((V + (I * bat->R)) - bat->E));
+    }
+
+    bat->V_last = V;
+    bat->I_last = I;
+
+    bat_update_limits( bat );
+}
+
+float bat_get_soc( BAT const * const bat )
+{
+    return (bat->C / bat->Cmax);
+}
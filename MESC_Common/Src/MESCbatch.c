@@ -0,0 +1,614 @@
+/*
+ **
+ ******************************************************************************
+ * @file           : MESCbatch.c
+ * @brief          : Atomic multi-variable get/set transactions
+ ******************************************************************************
+ * @attention
+ *
+ * <h2><center>&copy; Copyright (c) 2020 David Molony.
+ * All rights reserved.</center></h2>
+ *
+ * This software component is licensed under BSD 3-Clause license,
+ * the "License"; You may not use this file except in compliance with the
+ * License. You may obtain a copy of the License at:
+ *                        opensource.org/licenses/BSD-3-Clause
+ *
+ ******************************************************************************
+ *In addition to the usual 3 BSD clauses, it is explicitly noted that you
+ *do NOT have the right to take sections of this code for other projects
+ *without attribution and credit to the source. Specifically, if you copy into
+ *copyleft licenced code without attribution and retention of the permissive BSD
+ *3 clause licence, you grant a perpetual licence to do the same regarding turning sections of your code
+ *permissive, and lose any rights to use of this code previously granted or assumed.
+ *
+ *This code is intended to remain permissively licensed wherever it goes,
+ *maintaining the freedom to distribute compiled binaries WITHOUT a requirement to supply source.
+ *
+ *This is to ensure this code can at any point be used commercially, on products that may require
+ *such restriction to meet regulatory requirements, or to avoid damage to hardware, or to ensure
+ *warranties can reasonably be honoured.
+ ******************************************************************************
+ */
+
+
+#include "MESCbatch.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Keep the entries ahead of the state change that publishes them
+#if defined(__GNUC__)
+#define BATCH_BARRIER() __asm__ volatile ( "" ::: "memory" )
+#else
+#define BATCH_BARRIER()
+#endif
+
+#define BATCH_VALUE_TEXT 32
+
+static bool batch_is_separator( char const c )
+{
+    return ((c == ' ') || (c == '\t') || (c == '\r') || (c == '\n') || (c == ',') || (c == ';'));
+}
+
+static void batch_store( BATCH_ENTRY const * const e )
+{
+    switch (e->type)
+    {
+        case BATCH_TYPE_BOOL:
+            *(bool *)e->ptr = (e->value.u != 0);
+            break;
+        case BATCH_TYPE_FLOAT:
+            *(float *)e->ptr = e->value.f;
+            break;
+        case BATCH_TYPE_INT:
+            switch (e->size)
+            {
+                case 1:  *(int8_t  *)e->ptr = (int8_t )e->value.i; break;
+                case 2:  *(int16_t *)e->ptr = (int16_t)e->value.i; break;
+                default: *(int32_t *)e->ptr = e->value.i;          break;
+            }
+            break;
+        case BATCH_TYPE_UINT:
+        default:
+            switch (e->size)
+            {
+                case 1:  *(uint8_t  *)e->ptr = (uint8_t )e->value.u; break;
+                case 2:  *(uint16_t *)e->ptr = (uint16_t)e->value.u; break;
+                default: *(uint32_t *)e->ptr = e->value.u;           break;
+            }
+            break;
+    }
+}
+
+static void batch_load( BATCH_ENTRY * const e )
+{
+    switch (e->type)
+    {
+        case BATCH_TYPE_BOOL:
+            e->value.u = (*(bool const *)e->ptr ? 1 : 0);
+            break;
+        case BATCH_TYPE_FLOAT:
+            e->value.f = *(float const *)e->ptr;
+            break;
+        case BATCH_TYPE_INT:
+            switch (e->size)
+            {
+                case 1:  e->value.i = *(int8_t  const *)e->ptr; break;
+                case 2:  e->value.i = *(int16_t const *)e->ptr; break;
+                default: e->value.i = *(int32_t const *)e->ptr; break;
+            }
+            break;
+        case BATCH_TYPE_UINT:
+        default:
+            switch (e->size)
+            {
+                case 1:  e->value.u = *(uint8_t  const *)e->ptr; break;
+                case 2:  e->value.u = *(uint16_t const *)e->ptr; break;
+                default: e->value.u = *(uint32_t const *)e->ptr; break;
+            }
+            break;
+    }
+}
+
+static BATCHError batch_check( BATCH_VAR const * const var, BATCH_VALUE const value )
+{
+    switch (var->type)
+    {
+        case BATCH_TYPE_BOOL:
+            return (value.u <= 1) ? BATCH_OK : BATCH_ERR_RANGE;
+        case BATCH_TYPE_FLOAT:
+            if (isnan( value.f ) || (value.f < var->min.f) || (value.f > var->max.f))
+            {
+                return BATCH_ERR_RANGE;
+            }
+            return BATCH_OK;
+        case BATCH_TYPE_INT:
+        {
+            int32_t const lim = (var->size == 1) ? INT8_MAX : ((var->size == 2) ? INT16_MAX : INT32_MAX);
+
+            if ((value.i < var->min.i) || (value.i > var->max.i) || (value.i > lim) || (value.i < (-lim - 1)))
+            {
+                return BATCH_ERR_RANGE;
+            }
+            return BATCH_OK;
+        }
+        case BATCH_TYPE_UINT:
+        {
+            uint32_t const lim = (var->size == 1) ? UINT8_MAX : ((var->size == 2) ? UINT16_MAX : UINT32_MAX);
+
+            if ((value.u < var->min.u) || (value.u > var->max.u) || (value.u > lim))
+            {
+                return BATCH_ERR_RANGE;
+            }
+            return BATCH_OK;
+        }
+        default:
+            return BATCH_ERR_TYPE;
+    }
+}
+
+static float batch_multiplier( char const c )
+{
+    switch (c)
+    {
+        case 'u': return 1e-6f;
+        case 'm': return 1e-3f;
+        case 'k': return 1e3f;
+        case 'M': return 1e6f;
+        default:  return 0.0f;
+    }
+}
+
+// text must be NUL terminated, and is consumed entirely or rejected
+static BATCHError batch_parse_value( BATCH_VAR const * const var, char const * const text, BATCH_VALUE * const value )
+{
+    char * end = NULL;
+
+    if (text[0] == '\0')
+    {
+        return BATCH_ERR_SYNTAX;
+    }
+
+    switch (var->type)
+    {
+        case BATCH_TYPE_BOOL:
+            if ((strcmp( text, "1" ) == 0) || (strcmp( text, "true" ) == 0) || (strcmp( text, "on" ) == 0))
+            {
+                value->u = 1;
+                return BATCH_OK;
+            }
+            if ((strcmp( text, "0" ) == 0) || (strcmp( text, "false" ) == 0) || (strcmp( text, "off" ) == 0))
+            {
+                value->u = 0;
+                return BATCH_OK;
+            }
+            return BATCH_ERR_SYNTAX;
+        case BATCH_TYPE_FLOAT:
+        {
+            float f = strtof( text, &end );
+
+            if (end == text)
+            {
+                return BATCH_ERR_SYNTAX;
+            }
+
+            if (*end != '\0')
+            {
+                float const m = batch_multiplier( *end );
+
+                if ((m == 0.0f) || (end[1] != '\0'))
+                {
+                    return BATCH_ERR_SYNTAX;
+                }
+
+                f = f * m;
+            }
+
+            value->f = f;
+            return BATCH_OK;
+        }
+        case BATCH_TYPE_INT:
+        {
+            long long const v = strtoll( text, &end, 0 );
+
+            if ((end == text) || (*end != '\0'))
+            {
+                return BATCH_ERR_SYNTAX;
+            }
+
+            if ((v < INT32_MIN) || (v > INT32_MAX))
+            {
+                return BATCH_ERR_RANGE;
+            }
+
+            value->i = (int32_t)v;
+            return BATCH_OK;
+        }
+        case BATCH_TYPE_UINT:
+        {
+            if (text[0] == '-')
+            {
+                return BATCH_ERR_RANGE;
+            }
+
+            unsigned long long const v = strtoull( text, &end, 0 );
+
+            if ((end == text) || (*end != '\0'))
+            {
+                return BATCH_ERR_SYNTAX;
+            }
+
+            if (v > UINT32_MAX)
+            {
+                return BATCH_ERR_RANGE;
+            }
+
+            value->u = (uint32_t)v;
+            return BATCH_OK;
+        }
+        default:
+            return BATCH_ERR_TYPE;
+    }
+}
+
+static BATCHError batch_fail( BATCH * const batch, BATCHError const error, uint32_t const index )
+{
+    batch_abort( batch );
+
+    batch->error       = error;
+    batch->error_index = index;
+
+    return error;
+}
+
+void batch_init( BATCH * const batch, batch_complete const complete )
+{
+    memset( batch, 0, sizeof(*batch) );
+
+    batch->complete = complete;
+    batch->state    = BATCH_STATE_IDLE;
+}
+
+BATCHError batch_begin( BATCH * const batch )
+{
+    if (batch->state == BATCH_STATE_PENDING)
+    {
+        return BATCH_ERR_BUSY;
+    }
+
+    batch->count       = 0;
+    batch->error       = BATCH_OK;
+    batch->error_index = 0;
+    batch->state       = BATCH_STATE_STAGING;
+
+    return BATCH_OK;
+}
+
+BATCHError batch_stage( BATCH * const batch, BATCH_VAR const * const var, bool const write, BATCH_VALUE const value )
+{
+    if (batch->state != BATCH_STATE_STAGING)
+    {
+        return BATCH_ERR_BUSY;
+    }
+
+    if ((var->ptr == NULL) || (var->type > BATCH_TYPE_BOOL)
+    || ((var->size != 1) && (var->size != 2) && (var->size != 4))
+    || ((var->type == BATCH_TYPE_FLOAT) && (var->size != 4)))
+    {
+        return BATCH_ERR_TYPE;
+    }
+
+    if (write ? !var->writable : !var->readable)
+    {
+        return BATCH_ERR_ACCESS;
+    }
+
+    if (write)
+    {
+        BATCHError const ret = batch_check( var, value );
+
+        if (ret != BATCH_OK)
+        {
+            return ret;
+        }
+    }
+
+    BATCH_ENTRY * e = NULL;
+
+    for ( uint32_t i = 0; i < batch->count; ++i )
+    {
+        if (batch->entry[i].ptr == var->ptr)
+        {
+            e = &batch->entry[i];
+            break;
+        }
+    }
+
+    if (e == NULL)
+    {
+        if (batch->count >= BATCH_MAX_ENTRIES)
+        {
+            return BATCH_ERR_FULL;
+        }
+
+        e = &batch->entry[batch->count];
+        batch->count++;
+
+        e->write = false;
+    }
+    else if (write == false)
+    {
+        // Already staged, a read of a staged write returns the new value anyway
+        return BATCH_OK;
+    }
+
+    e->ptr   = var->ptr;
+    e->tag   = var->tag;
+    e->group = var->group;
+    e->type  = var->type;
+    e->size  = var->size;
+    e->write = write;
+    e->value = value;
+
+    return BATCH_OK;
+}
+
+BATCHError batch_parse_token( BATCH * const batch, char const * const token, uint32_t const len, batch_lookup const lookup, void * const ctx )
+{
+    uint32_t name_len = 0;
+
+    while ((name_len < len) && (token[name_len] != '='))
+    {
+        name_len++;
+    }
+
+    if ((name_len == 0) || (name_len > BATCH_NAME_MAX))
+    {
+        return BATCH_ERR_SYNTAX;
+    }
+
+    BATCH_VAR        var;
+    BATCHError const ret = lookup( ctx, token, name_len, &var );
+
+    if (ret != BATCH_OK)
+    {
+        return ret;
+    }
+
+    BATCH_VALUE value;
+
+    value.u = 0;
+
+    if (name_len == len)
+    {
+        return batch_stage( batch, &var, false, value );
+    }
+
+    uint32_t const value_len = len - name_len - 1;
+    char           text[BATCH_VALUE_TEXT];
+
+    if (value_len >= BATCH_VALUE_TEXT)
+    {
+        return BATCH_ERR_SYNTAX;
+    }
+
+    memcpy( text, &token[name_len + 1], value_len );
+    text[value_len] = '\0';
+
+    BATCHError const err = batch_parse_value( &var, text, &value );
+
+    if (err != BATCH_OK)
+    {
+        return err;
+    }
+
+    return batch_stage( batch, &var, true, value );
+}
+
+BATCHError batch_parse_text( BATCH * const batch, char const * const text, batch_lookup const lookup, void * const ctx )
+{
+    BATCHError ret = batch_begin( batch );
+
+    if (ret != BATCH_OK)
+    {
+        return ret;
+    }
+
+    uint32_t index = 0;
+
+    for ( char const * p = text; *p != '\0'; )
+    {
+        if (batch_is_separator( *p ))
+        {
+            p++;
+            continue;
+        }
+
+        char const * const start = p;
+
+        while ((*p != '\0') && !batch_is_separator( *p ))
+        {
+            p++;
+        }
+
+        ret = batch_parse_token( batch, start, (uint32_t)(p - start), lookup, ctx );
+
+        if (ret != BATCH_OK)
+        {
+            return batch_fail( batch, ret, index );
+        }
+
+        index++;
+    }
+
+    return BATCH_OK;
+}
+
+BATCHError batch_parse_frame( BATCH * const batch, uint8_t const * const data, uint32_t const len, batch_lookup const lookup, void * const ctx )
+{
+    BATCHError ret = batch_begin( batch );
+
+    if (ret != BATCH_OK)
+    {
+        return ret;
+    }
+
+    uint32_t index = 0;
+
+    for ( uint32_t pos = 0; pos < len; index++ )
+    {
+        uint8_t  const hdr      = data[pos];
+        bool     const write    = ((hdr & BATCH_FRAME_READ) == 0);
+        uint32_t const name_len = (hdr & BATCH_NAME_MAX);
+        uint32_t const need     = 1 + name_len + (write ? 4 : 0);
+
+        if ((name_len == 0) || ((len - pos) < need))
+        {
+            return batch_fail( batch, BATCH_ERR_SYNTAX, index );
+        }
+
+        char const * const name = (char const *)&data[pos + 1];
+        BATCH_VAR          var;
+
+        ret = lookup( ctx, name, name_len, &var );
+
+        if (ret == BATCH_OK)
+        {
+            BATCH_VALUE value;
+
+            value.u = 0;
+
+            if (write)
+            {
+                uint8_t const * const v = &data[pos + 1 + name_len];
+
+                value.u = ((uint32_t)v[0]) | ((uint32_t)v[1] << 8) | ((uint32_t)v[2] << 16) | ((uint32_t)v[3] << 24);
+            }
+
+            ret = batch_stage( batch, &var, write, value );
+        }
+
+        if (ret != BATCH_OK)
+        {
+            return batch_fail( batch, ret, index );
+        }
+
+        pos = pos + need;
+    }
+
+    return BATCH_OK;
+}
+
+BATCHError batch_commit( BATCH * const batch )
+{
+    if (batch->state != BATCH_STATE_STAGING)
+    {
+        return BATCH_ERR_BUSY;
+    }
+
+    BATCH_BARRIER();
+
+    batch->state = BATCH_STATE_PENDING;
+
+    return BATCH_OK;
+}
+
+void batch_abort( BATCH * const batch )
+{
+    if (batch->state == BATCH_STATE_STAGING)
+    {
+        batch->count = 0;
+        batch->state = BATCH_STATE_IDLE;
+    }
+}
+
+uint32_t batch_apply( BATCH * const batch )
+{
+    if (batch->state != BATCH_STATE_PENDING)
+    {
+        return 0;
+    }
+
+    BATCH_BARRIER();
+
+    for ( uint32_t i = 0; i < batch->count; ++i )
+    {
+        if (batch->entry[i].write)
+        {
+            batch_store( &batch->entry[i] );
+        }
+    }
+
+    if (batch->complete != NULL)
+    {
+        batch->complete( batch );
+    }
+
+    // Reads see the result of the completion (e.g. derived gains) as well
+    for ( uint32_t i = 0; i < batch->count; ++i )
+    {
+        batch_load( &batch->entry[i] );
+    }
+
+    batch->applied++;
+
+    BATCH_BARRIER();
+
+    batch->state = BATCH_STATE_APPLIED;
+
+    return batch->count;
+}
+
+BATCHState batch_state( BATCH const * const batch )
+{
+    return (BATCHState)batch->state;
+}
+
+bool batch_first_of_group( BATCH const * const batch, uint32_t const index )
+{
+    uintptr_t const group = batch->entry[index].group;
+
+    if ((group == 0) || (batch->entry[index].write == false))
+    {
+        return false;
+    }
+
+    for ( uint32_t i = 0; i < index; ++i )
+    {
+        if (batch->entry[i].write && (batch->entry[i].group == group))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+uint32_t batch_reply( BATCH const * const batch, uint8_t * const buf, uint32_t const max )
+{
+    uint32_t const len = 3 + (4 * batch->count);
+
+    if (max < len)
+    {
+        return 0;
+    }
+
+    buf[0] = (uint8_t)batch->error;
+    buf[1] = (uint8_t)batch->error_index;
+    buf[2] = (uint8_t)batch->count;
+
+    for ( uint32_t i = 0; i < batch->count; ++i )
+    {
+        uint32_t const v = batch->entry[i].value.u;
+        uint8_t * const p = &buf[3 + (4 * i)];
+
+        p[0] = (uint8_t)(v);
+        p[1] = (uint8_t)(v >> 8);
+        p[2] = (uint8_t)(v >> 16);
+        p[3] = (uint8_t)(v >> 24);
+    }
+
+    return len;
+}
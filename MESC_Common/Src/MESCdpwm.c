@@ -0,0 +1,241 @@
+/*
+ **
+ ******************************************************************************
+ * @file           : MESCdpwm.c
+ * @brief          : Discontinuous PWM strategies
+ ******************************************************************************
+ * @attention
+ *
+ * <h2><center>&copy; Copyright (c) 2020 David Molony.
+ * All rights reserved.</center></h2>
+ *
+ * This software component is licensed under BSD 3-Clause license,
+ * the "License"; You may not use this file except in compliance with the
+ * License. You may obtain a copy of the License at:
+ *                        opensource.org/licenses/BSD-3-Clause
+ *
+ ******************************************************************************
+ *In addition to the usual 3 BSD clauses, it is explicitly noted that you
+ *do NOT have the right to take sections of this code for other projects
+ *without attribution and credit to the source. Specifically, if you copy into
+ *copyleft licenced code without attribution and retention of the permissive BSD
+ *3 clause licence, you grant a perpetual licence to do the same regarding turning sections of your code
+ *permissive, and lose any rights to use of this code previously granted or assumed.
+ *
+ *This code is intended to remain permissively licensed wherever it goes,
+ *maintaining the freedom to distribute compiled binaries WITHOUT a requirement to supply source.
+ *
+ *This is to ensure this code can at any point be used commercially, on products that may require
+ *such restriction to meet regulatory requirements, or to avoid damage to hardware, or to ensure
+ *warranties can reasonably be honoured.
+ ******************************************************************************
+ */
+
+
+#include "MESCdpwm.h"
+
+#include <math.h>
+
+/*
+All of the 60 degree strategies are special cases of Hava's generalised DPWM:
+the three phase references are rotated by -psi, the phase whose rotated
+reference has the largest magnitude is clamped to the rail of the same sign
+and the same zero sequence is added to the other two. With psi equal to the
+power factor angle the clamp window sits on the current peak, which is where
+not switching saves the most. psi is limited to +/-30 degrees, beyond that the
+clamp is no longer achievable across the whole linear range.
+*/
+
+#define DPWM_PI_ON_6        0.52359878f
+#define DPWM_PI_ON_2        1.57079633f
+#define DPWM_PI             3.14159265f
+#define DPWM_SQRT3_ON_2     0.86602540f
+
+static void dpwm_set_psi( DPWM * const dp, float const psi )
+{
+    dp->psi     = psi;
+    dp->cos_psi = cosf( psi );
+    dp->sin_psi = sinf( psi );
+}
+
+void dpwm_init( DPWM * const dp )
+{
+    dp->type   = DPWM_TYPE_AUTO;
+    dp->active = DPWM_TYPE_CONTINUOUS;
+    dp->m_min  = DPWM_M_MIN_DEFAULT;
+    dp->phi    = 0.0f;
+
+    dpwm_set_psi( dp, 0.0f );
+}
+
+void dpwm_update( DPWM * const dp, float const m,
+                  float const Vd, float const Vq, float const Id, float const Iq )
+{
+    float phi = atan2f( Vq, Vd ) - atan2f( Iq, Id );
+
+    if (phi > DPWM_PI)
+    {
+        phi = phi - (2.0f * DPWM_PI);
+    }
+    else if (phi < -DPWM_PI)
+    {
+        phi = phi + (2.0f * DPWM_PI);
+    }
+
+    dp->phi = phi;
+
+    // Regenerating is the same current peak with the sign flipped, fold onto +/-90 degrees
+    if (phi > DPWM_PI_ON_2)
+    {
+        phi = phi - DPWM_PI;
+    }
+    else if (phi < -DPWM_PI_ON_2)
+    {
+        phi = phi + DPWM_PI;
+    }
+
+    if (phi > DPWM_PI_ON_6)
+    {
+        phi = DPWM_PI_ON_6;
+    }
+    else if (phi < -DPWM_PI_ON_6)
+    {
+        phi = -DPWM_PI_ON_6;
+    }
+
+    dp->active = (DPWMType)dp->type;
+
+    switch (dp->type)
+    {
+        case DPWM_TYPE_DPWM0:
+            dpwm_set_psi( dp, -DPWM_PI_ON_6 );
+            break;
+        case DPWM_TYPE_DPWM1:
+            dpwm_set_psi( dp, 0.0f );
+            break;
+        case DPWM_TYPE_DPWM2:
+            dpwm_set_psi( dp, DPWM_PI_ON_6 );
+            break;
+        case DPWM_TYPE_AUTO:
+            if (m < dp->m_min)
+            {
+                dp->active = DPWM_TYPE_CONTINUOUS;
+                break;
+            }
+
+            dp->active = DPWM_TYPE_GDPWM;
+            // fallthrough
+        case DPWM_TYPE_GDPWM:
+            dpwm_set_psi( dp, phi );
+            break;
+        case DPWM_TYPE_MAX:
+        case DPWM_TYPE_MIN:
+            break;
+        case DPWM_TYPE_CONTINUOUS:
+        default:
+            dp->active = DPWM_TYPE_CONTINUOUS;
+            break;
+    }
+}
+
+bool dpwm_apply( DPWM const * const dp, float const Vbus, float const Va, float const Vb,
+                 float V[3], uint32_t * const high )
+{
+    float const half = 0.5f * Vbus;
+    float offset;
+
+    *high = DPWM_PHASE_NONE;
+
+    switch (dp->active)
+    {
+        case DPWM_TYPE_MAX:
+        {
+            uint32_t k = 0;
+
+            for ( uint32_t i = 1; i < 3; ++i )
+            {
+                if (V[i] > V[k])
+                {
+                    k = i;
+                }
+            }
+
+            offset = half - V[k];
+            *high  = k;
+            break;
+        }
+        case DPWM_TYPE_MIN:
+        {
+            uint32_t k = 0;
+
+            for ( uint32_t i = 1; i < 3; ++i )
+            {
+                if (V[i] < V[k])
+                {
+                    k = i;
+                }
+            }
+
+            offset = -half - V[k];
+            break;
+        }
+        case DPWM_TYPE_DPWM0:
+        case DPWM_TYPE_DPWM1:
+        case DPWM_TYPE_DPWM2:
+        case DPWM_TYPE_GDPWM:
+        {
+            // Rotate the reference back by psi and inverse Clark it
+            float const Ra = (dp->cos_psi * Va) + (dp->sin_psi * Vb);
+            float const Rb = (dp->cos_psi * Vb) - (dp->sin_psi * Va);
+            float const R[3] =
+            {
+                Ra,
+                (-0.5f * Ra) + (DPWM_SQRT3_ON_2 * Rb),
+                (-0.5f * Ra) - (DPWM_SQRT3_ON_2 * Rb),
+            };
+
+            uint32_t k = 0;
+
+            for ( uint32_t i = 1; i < 3; ++i )
+            {
+                if (fabsf( R[i] ) > fabsf( R[k] ))
+                {
+                    k = i;
+                }
+            }
+
+            if (R[k] >= 0.0f)
+            {
+                offset = half - V[k];
+                *high  = k;
+            }
+            else
+            {
+                offset = -half - V[k];
+            }
+
+            break;
+        }
+        case DPWM_TYPE_AUTO:
+        case DPWM_TYPE_CONTINUOUS:
+        default:
+            return false;
+    }
+
+    for ( uint32_t i = 0; i < 3; ++i )
+    {
+        V[i] = V[i] + offset;
+
+        // Only reachable at the very edge of the linear range with psi at its limit
+        if (V[i] > half)
+        {
+            V[i] = half;
+        }
+        else if (V[i] < -half)
+        {
+            V[i] = -half;
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,537 @@
+/*
+ **
+ ******************************************************************************
+ * @file           : MESCencoder.c
+ * @brief          : Encoder angle and speed for the FOC angle path
+ ******************************************************************************
+ * @attention
+ *
+ * <h2><center>&copy; Copyright (c) 2020 David Molony.
+ * All rights reserved.</center></h2>
+ *
+ * This software component is licensed under BSD 3-Clause license,
+ * the "License"; You may not use this file except in compliance with the
+ * License. You may obtain a copy of the License at:
+ *                        opensource.org/licenses/BSD-3-Clause
+ *
+ ******************************************************************************
+ *In addition to the usual 3 BSD clauses, it is explicitly noted that you
+ *do NOT have the right to take sections of this code for other projects
+ *without attribution and credit to the source. Specifically, if you copy into
+ *copyleft licenced code without attribution and retention of the permissive BSD
+ *3 clause licence, you grant a perpetual licence to do the same regarding turning sections of your code
+ *permissive, and lose any rights to use of this code previously granted or assumed.
+ *
+ *This code is intended to remain permissively licensed wherever it goes,
+ *maintaining the freedom to distribute compiled binaries WITHOUT a requirement to supply source.
+ *
+ *This is to ensure this code can at any point be used commercially, on products that may require
+ *such restriction to meet regulatory requirements, or to avoid damage to hardware, or to ensure
+ *warranties can reasonably be honoured.
+ ******************************************************************************
+ */
+
+
+
+
+
+#include "MESCencoder.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+#define ENCODER_PI     3.14159265f
+#define ENCODER_TWO_PI 6.28318531f
+
+static uint32_t encoder_wrap( ENCODER const * const enc, int32_t const x )
+{
+	int32_t const c = (int32_t)enc->counts;
+	int32_t r = x % c;
+
+	if (r < 0)
+	{
+		r = r + c;
+	}
+
+	return (uint32_t)r;
+}
+
+// a - b, counts, within half a rev
+static int32_t encoder_diff( ENCODER const * const enc, uint32_t const a, uint32_t const b )
+{
+	int32_t const c = (int32_t)enc->counts;
+	int32_t d = (int32_t)a - (int32_t)b;
+
+	if (d > (c / 2))
+	{
+		d = d - c;
+	}
+	else if (d < -(c / 2))
+	{
+		d = d + c;
+	}
+
+	return d;
+}
+
+static float encoder_wrapf( ENCODER const * const enc, float const x )
+{
+	float const c = (float)enc->counts;
+
+	return x - (c * floorf( x / c ));
+}
+
+static void encoder_reset( ENCODER * const enc )
+{
+	enc->pos = 0;
+	enc->counting = false;
+	enc->indexed = false;
+	enc->fresh = false;
+	enc->primed = false;
+	enc->theta = 0.0f;
+	enc->omega = 0.0f;
+	enc->age = 0.0f;
+	enc->since = 0.0f;
+	enc->eHz = 0.0f;
+	enc->err_run = 0;
+}
+
+void encoder_init( ENCODER * const enc )
+{
+	enc->source = ENCODER_SOURCE_NONE;
+	enc->counts = 4096; //Avoid div0
+	enc->pole_pairs = 1;
+	enc->invert = false;
+	enc->offset = 0;
+	enc->bw = ENCODER_BW_DEFAULT;
+	enc->delay = 0.0f;
+	enc->advance = ENCODER_ADVANCE_DEFAULT;
+
+	for (uint32_t h = 0; h < ENCODER_HARMONICS; h++)
+	{
+		enc->harm[h][0] = 0.0f;
+		enc->harm[h][1] = 0.0f;
+	}
+
+	enc->angle = 0;
+	enc->samples = 0;
+	enc->errors = 0;
+	enc->index_errors = 0;
+
+	enc->cal.speed = ENCODER_CAL_SPEED;
+	enc->cal.erevs = ENCODER_CAL_EREVS;
+	enc->cal.settle = ENCODER_CAL_SETTLE;
+	enc->cal.phase = ENCODER_CAL_IDLE;
+	enc->cal.result = ENCODER_CAL_OK;
+	enc->cal.lag = 0.0f;
+
+	encoder_reset( enc );
+	encoder_comp_build( enc );
+}
+
+void encoder_config( ENCODER * const enc, uint32_t const counts, uint8_t const pole_pairs )
+{
+	if ((counts == 0) || (counts > 65536) || (pole_pairs == 0))
+	{
+		return;
+	}
+
+	if ((counts != enc->counts) || (pole_pairs != enc->pole_pairs))
+	{
+		enc->counts = counts;
+		enc->pole_pairs = pole_pairs;
+		encoder_reset( enc );
+	}
+
+	encoder_comp_build( enc );
+}
+
+static void encoder_sampled( ENCODER * const enc )
+{
+	enc->fresh = true;
+	enc->err_run = 0;
+	enc->samples++;
+}
+
+void encoder_abi( ENCODER * const enc, uint16_t const cnt, uint16_t const idx )
+{
+	if (!enc->counting)
+	{
+		enc->pos = encoder_wrap( enc, (int16_t)(cnt - idx) );
+		enc->cnt_last = cnt;
+		enc->idx_last = idx;
+		enc->counting = true;
+		encoder_sampled( enc );
+		return;
+	}
+
+	enc->pos = encoder_wrap( enc, (int32_t)enc->pos + (int16_t)(cnt - enc->cnt_last) );
+	enc->cnt_last = cnt;
+
+	if (idx != enc->idx_last)
+	{
+		uint32_t const p = encoder_wrap( enc, (int16_t)(cnt - idx) );
+
+		if (enc->indexed && (abs( encoder_diff( enc, p, enc->pos ) ) > ENCODER_INDEX_TOL))
+		{
+			enc->index_errors++;
+		}
+
+		enc->pos = p;
+		enc->idx_last = idx;
+		enc->indexed = true;
+	}
+
+	encoder_sampled( enc );
+}
+
+void encoder_abs( ENCODER * const enc, uint32_t const raw )
+{
+	enc->pos = raw % enc->counts;
+	encoder_sampled( enc );
+}
+
+void encoder_fault( ENCODER * const enc )
+{
+	enc->errors++;
+	enc->err_run++;
+}
+
+uint16_t encoder_elec( ENCODER const * const enc, uint32_t const pos )
+{
+	uint32_t const p = enc->invert ? ((enc->counts - pos) % enc->counts) : pos;
+
+	// Modulo counts first, so a part rev of the rotor is exact for any count, then rounded
+	return (uint16_t)(((((p * enc->pole_pairs) % enc->counts) * 65536U) + (enc->counts / 2U)) / enc->counts);
+}
+
+void encoder_comp_build( ENCODER * const enc )
+{
+	// Electrical counts per position count
+	float const k = (enc->invert ? -65536.0f : 65536.0f) * (float)enc->pole_pairs / (float)enc->counts;
+
+	enc->comp_on = false;
+
+	for (uint32_t i = 0; i < ENCODER_COMP_SIZE; i++)
+	{
+		float const th = ENCODER_TWO_PI * (float)i / (float)ENCODER_COMP_SIZE;
+		float c = 0.0f;
+
+		for (uint32_t h = 0; h < ENCODER_HARMONICS; h++)
+		{
+			float const a = th * (float)(h + 1);
+
+			c = c + (enc->harm[h][0] * cosf( a )) + (enc->harm[h][1] * sinf( a ));
+		}
+
+		enc->comp[i] = (int16_t)lrintf( fminf( fmaxf( k * c, -32768.0f ), 32767.0f ) );
+
+		if (enc->comp[i] != 0)
+		{
+			enc->comp_on = true;
+		}
+	}
+}
+
+int16_t encoder_comp( ENCODER const * const enc, uint32_t const pos )
+{
+	uint32_t const u = pos * ENCODER_COMP_SIZE;
+	uint32_t const i = u / enc->counts;
+	uint32_t const j = (i + 1) & (ENCODER_COMP_SIZE - 1);
+	float const f = (float)(u % enc->counts) / (float)enc->counts;
+
+	return (int16_t)(enc->comp[i] + lrintf( f * (float)(enc->comp[j] - enc->comp[i]) ));
+}
+
+uint16_t encoder_run( ENCODER * const enc, float const T )
+{
+	enc->since = enc->since + T;
+
+	if (enc->primed)
+	{
+		enc->theta = encoder_wrapf( enc, enc->theta + (enc->omega * T) );
+	}
+
+	if (enc->fresh)
+	{
+		enc->fresh = false;
+		enc->age = 0.0f;
+
+		if (!enc->primed)
+		{
+			enc->theta = (float)enc->pos;
+			enc->omega = 0.0f;
+			enc->primed = true;
+		}
+		else
+		{
+			float const w = ENCODER_TWO_PI * enc->bw;
+			float const dt = enc->since;
+			float const kp = fminf( 2.0f * w * dt, 1.0f );
+			float const ki = w * w * dt;
+			float e = (float)enc->pos - enc->theta;
+			float const c = (float)enc->counts;
+
+			if (e > (0.5f * c))
+			{
+				e = e - c;
+			}
+			else if (e < (-0.5f * c))
+			{
+				e = e + c;
+			}
+
+			enc->theta = encoder_wrapf( enc, enc->theta + (kp * e) );
+			enc->omega = enc->omega + (ki * e);
+		}
+
+		enc->since = 0.0f;
+	}
+	else
+	{
+		enc->age = enc->age + T;
+	}
+
+	// Electrical counts per mechanical count
+	float const k = (enc->invert ? -65536.0f : 65536.0f) * (float)enc->pole_pairs / (float)enc->counts;
+	float const lead = enc->age + enc->delay + (enc->advance * T);
+
+	enc->eHz = enc->omega * k * (1.0f / 65536.0f);
+	enc->angle = (uint16_t)(encoder_elec( enc, enc->pos ) + enc->offset + (int32_t)(enc->omega * k * lead));
+
+	if (enc->comp_on)
+	{
+		enc->angle = (uint16_t)(enc->angle + encoder_comp( enc, enc->pos ));
+	}
+
+	return enc->angle;
+}
+
+bool encoder_ok( ENCODER const * const enc )
+{
+	return enc->primed && (enc->err_run < ENCODER_ERR_MAX) && (enc->age < ENCODER_TIMEOUT);
+}
+
+void encoder_cal_start( ENCODER * const enc )
+{
+	ENCODERCal * const cal = &enc->cal;
+
+	cal->phase = ENCODER_CAL_ALIGN;
+	cal->result = ENCODER_CAL_OK;
+	cal->t = 0.0f;
+	cal->swept = 0.0f;
+	cal->angle = 0.0f;
+	cal->pos_last = enc->pos;
+	cal->travel = 0;
+	cal->d0 = 0;
+	cal->sum[0] = 0;
+	cal->sum[1] = 0;
+	cal->n[0] = 0;
+	cal->n[1] = 0;
+	cal->lag = 0.0f;
+
+	for (uint32_t b = 0; b < ENCODER_CAL_BINS; b++)
+	{
+		cal->bin_sum[b] = 0;
+		cal->bin_n[0][b] = 0;
+		cal->bin_n[1][b] = 0;
+	}
+}
+
+static uint16_t encoder_cal_angle( ENCODERCal const * const cal )
+{
+	return (uint16_t)(uint32_t)(cal->angle * 65536.0f);
+}
+
+static void encoder_cal_next( ENCODERCal * const cal, EncoderCalPhase const phase )
+{
+	cal->phase = phase;
+	cal->t = 0.0f;
+	cal->swept = 0.0f;
+	cal->travel = 0;
+}
+
+static void encoder_cal_end( ENCODERCal * const cal, EncoderCalResult const result )
+{
+	cal->result = result;
+	encoder_cal_next( cal, ENCODER_CAL_DONE );
+}
+
+static void encoder_cal_step( ENCODERCal * const cal, float const s )
+{
+	cal->angle = cal->angle + s;
+	cal->angle = cal->angle - floorf( cal->angle );
+	cal->swept = cal->swept + fabsf( s );
+}
+
+static void encoder_cal_collect( ENCODER * const enc, uint32_t const dir )
+{
+	ENCODERCal * const cal = &enc->cal;
+	int32_t const d = (int16_t)(encoder_cal_angle( cal ) - encoder_elec( enc, enc->pos ));
+
+	if ((cal->n[0] + cal->n[1]) == 0)
+	{
+		cal->d0 = d;
+	}
+
+	cal->sum[dir] = cal->sum[dir] + (int16_t)(d - cal->d0);
+	cal->n[dir]++;
+
+	// The rotor is still taking up the lag from the last sweep
+	if (cal->swept < ENCODER_CAL_TURN)
+	{
+		return;
+	}
+
+	uint32_t const b = (enc->pos * ENCODER_CAL_BINS) / enc->counts;
+
+	cal->bin_sum[b] = cal->bin_sum[b] + (int16_t)(d - cal->d0);
+	cal->bin_n[dir][b]++;
+}
+
+// Harmonics of command less encoder over the rev, into harm
+static bool encoder_cal_fit( ENCODER * const enc )
+{
+	ENCODERCal const * const cal = &enc->cal;
+	float m[ENCODER_CAL_BINS];
+
+	for (uint32_t b = 0; b < ENCODER_CAL_BINS; b++)
+	{
+		uint32_t const nf = cal->bin_n[0][b];
+		uint32_t const nb = cal->bin_n[1][b];
+
+		if ((nf + nb) == 0)
+		{
+			return false;
+		}
+
+		// FWD samples are lag ahead and BWD lag behind
+		m[b] = ((float)cal->bin_sum[b] - (cal->lag * ((float)nf - (float)nb))) / (float)(nf + nb);
+	}
+
+	// Position counts per electrical count
+	float const k = (enc->invert ? -1.0f : 1.0f) * (float)enc->counts / (65536.0f * (float)enc->pole_pairs);
+
+	for (uint32_t h = 0; h < ENCODER_HARMONICS; h++)
+	{
+		// A bin is the mean over its width, which scales the harmonic by sin(x)/x
+		float const x = ENCODER_PI * (float)(h + 1) / (float)ENCODER_CAL_BINS;
+		float const g = 2.0f * k * x / (sinf( x ) * (float)ENCODER_CAL_BINS);
+		float c = 0.0f;
+		float s = 0.0f;
+
+		for (uint32_t b = 0; b < ENCODER_CAL_BINS; b++)
+		{
+			float const a = ENCODER_TWO_PI * (float)(h + 1) * ((float)b + 0.5f) / (float)ENCODER_CAL_BINS;
+
+			c = c + (m[b] * cosf( a ));
+			s = s + (m[b] * sinf( a ));
+		}
+
+		enc->harm[h][0] = g * c;
+		enc->harm[h][1] = g * s;
+	}
+
+	return true;
+}
+
+uint16_t encoder_cal_run( ENCODER * const enc, float const T )
+{
+	ENCODERCal * const cal = &enc->cal;
+
+	if ((cal->phase == ENCODER_CAL_IDLE) || (cal->phase == ENCODER_CAL_DONE))
+	{
+		return encoder_cal_angle( cal );
+	}
+
+	if (!encoder_ok( enc ))
+	{
+		encoder_cal_end( cal, ENCODER_CAL_FAULT );
+		return encoder_cal_angle( cal );
+	}
+
+	float const s = cal->speed * T;
+
+	cal->t = cal->t + T;
+	cal->travel = cal->travel + encoder_diff( enc, enc->pos, cal->pos_last );
+	cal->pos_last = enc->pos;
+
+	switch (cal->phase)
+	{
+		case ENCODER_CAL_ALIGN:
+			if (cal->t >= cal->settle)
+			{
+				encoder_cal_next( cal, ENCODER_CAL_PROBE );
+			}
+			break;
+		case ENCODER_CAL_PROBE:
+			encoder_cal_step( cal, s );
+
+			if (cal->swept >= cal->erevs)
+			{
+				float const a = fabsf( (float)cal->travel );
+				float const expect = cal->erevs * (float)enc->counts;
+
+				if ((2.0f * (float)ENCODER_PP_MAX * a) < expect)
+				{
+					encoder_cal_end( cal, ENCODER_CAL_NO_MOTION );
+					break;
+				}
+
+				long const pp = lrintf( expect / a );
+
+				if ((pp < 1) || (pp > ENCODER_PP_MAX))
+				{
+					encoder_cal_end( cal, ENCODER_CAL_POLES );
+					break;
+				}
+
+				enc->invert = (cal->travel < 0);
+				enc->pole_pairs = (uint8_t)pp;
+				encoder_cal_next( cal, ENCODER_CAL_FWD );
+			}
+			break;
+		case ENCODER_CAL_FWD:
+			encoder_cal_collect( enc, 0 );
+			encoder_cal_step( cal, s );
+
+			if (cal->swept >= (float)enc->pole_pairs)
+			{
+				// One mechanical rev, or the pole pairs are wrong
+				if ((2 * enc->pole_pairs * abs( abs( cal->travel ) - (int32_t)enc->counts )) > (int32_t)enc->counts)
+				{
+					encoder_cal_end( cal, ENCODER_CAL_POLES );
+					break;
+				}
+
+				encoder_cal_next( cal, ENCODER_CAL_BWD );
+			}
+			break;
+		case ENCODER_CAL_BWD:
+			encoder_cal_collect( enc, 1 );
+			encoder_cal_step( cal, -s );
+
+			if (cal->swept >= (float)enc->pole_pairs)
+			{
+				float const fwd = (float)cal->sum[0] / (float)cal->n[0];
+				float const bwd = (float)cal->sum[1] / (float)cal->n[1];
+
+				cal->lag = 0.5f * (fwd - bwd);
+
+				if (!encoder_cal_fit( enc ))
+				{
+					encoder_cal_end( cal, ENCODER_CAL_GAPS );
+					break;
+				}
+
+				enc->offset = (uint16_t)(cal->d0 + lrintf( 0.5f * (fwd + bwd) ));
+				encoder_comp_build( enc );
+				encoder_cal_end( cal, ENCODER_CAL_OK );
+			}
+			break;
+		default:
+			break;
+	}
+
+	return encoder_cal_angle( cal );
+}
@@ -66,8 +66,8 @@ const char * error_string[32] = {
 		"Input",
 		"Startup",
 		"Not used",
-		"Not used",
-		"Not used",
+		"Health warning",
+		"Encoder",
 		"Not used"
 };
 
@@ -101,6 +101,8 @@ const char * error_string[32] = {
 //#define ERROR_INPUT_OOR 27
 //#define ERROR_STARTUP 28
 //#define ERROR_APP 29
+//#define ERROR_HEALTH 30
+//#define ERROR_ENCODER 31
 
 
 //externs
@@ -132,6 +134,16 @@ void handleError(MESC_motor_typedef *_motor, uint32_t error_code){
 	MESC_all_errors |= MESC_errors;
 }
 
+void handleWarning(uint32_t error_code){
+	//Flag it for the LED and terminal, but leave the motor running. Called from
+	//tasks while handleError writes the same words from the ISRs, so masked
+	uint32_t const primask = __get_PRIMASK();
+	__disable_irq();
+	MESC_errors|= (0b01<<(error_code-1));
+	MESC_all_errors |= MESC_errors;
+	__set_PRIMASK(primask);
+}
+
 void clearErrors(){
 	MESC_errors = 0;
 	error_log.count = 0;
@@ -233,39 +233,89 @@ void MESCfoc_Init(MESC_motor_typedef *_motor) {
 	_motor->options.pwm_type = PWM_SIN_BOTTOM;
 #endif
 
+	_motor->options.overmod_type = OVERMOD_TYPE_NONE;//Default to linear modulation only
+#ifdef USE_OVERMODULATION
+	_motor->options.overmod_type = OVERMOD_TYPE_SIX_STEP;
+#endif
+	overmod_init(&_motor->overmod); //The request->clip gain table is const, this only clears the harmonic compensation
+	dpwm_init(&_motor->dpwm); //Only used with PWM_DPWM, defaults to auto selection by modulation and pf
+
+	_motor->options.use_pwm_scheduler = false;
+#ifdef USE_PWM_SCHEDULER
+	_motor->options.use_pwm_scheduler = true;
+#endif
+	fsched_init(&_motor->fsched, PWM_FREQUENCY); //Half frequency at standstill up to PWM_FREQUENCY
+
+	health_isr_reset(&_motor->health_fastloop);
+	health_isr_reset(&_motor->health_pwmloop);
+
+	_motor->options.use_hall_estimator = false;
+#ifdef USE_HALL_ESTIMATOR
+	_motor->options.use_hall_estimator = true;
+#endif
+
+	_motor->options.use_bat_limits = false;
+#ifdef USE_BAT_LIMITS
+	_motor->options.use_bat_limits = true;
+#endif
+	bat_reset(&_motor->bat, NULL); //Pack from the battery profile, charge seeded from Vbus on the first slow loop
+
+	_motor->options.use_thermal_model = false;
+#ifdef USE_THERMAL_MODEL
+	_motor->options.use_thermal_model = true;
+#endif
+	thermal_init(&_motor->thermal); //Default parameters, see MESCthermal.h; seeded from the NTCs on the first slow loop
+
 	_motor->options.app_type = APP_NONE;//Default to no app
 #ifdef APP_VEHICLE
 	_motor->options.app_type = APP_VEHICLE;
 #endif
+	Vehicle_init(); //Ride modes and switch options, see MESCvehicle.h
+	traction_init(&_motor->traction);
+	_motor->options.use_traction = false;
+#ifdef USE_TRACTION
+	_motor->options.use_traction = true; //Needs vehicle_imu set by the board, see MESCtraction.h
+#endif
 
 
-	//PWM Encoder
+	//Encoder, see encoderConfig for the source
+	_motor->m.enc_counts = 4096;//ABI counts per rev. Default to this, common for many motors. Avoid div0.
+	encoder_init(&_motor->encoder);
 	_motor->FOC.enc_offset = ENCODER_E_OFFSET;
 	_motor->FOC.encoder_polarity_invert = DEFAULT_ENCODER_POLARITY;
-	_motor->FOC.enc_period_count = 1; //Avoid /0s
-
-	//ABI Incremental encoder
-	_motor->m.enc_counts = 4096;//Default to this, common for many motors. Avoid div0.
-	_motor->FOC.enc_ratio = 65536/_motor->m.enc_counts;
+#ifdef ENCODER_DIR_REVERSED
+	_motor->FOC.encoder_polarity_invert = 1;
+#endif
+	encoderConfig(_motor);
 
 
 	_motor->hall.hall_error = 0;
 	//Init the BLDC
 	_motor->BLDC.com_flux = _motor->m.flux_linkage*1.65f;//0.02f;
 	_motor->BLDC.direction = -1;
+	sixstep_init(&_motor->sixstep, _motor->m.flux_linkage);
+	_motor->options.use_sixstep = false;
+#ifdef USE_SIXSTEP
+	_motor->options.use_sixstep = true; //Hand over to six-step above sixstep.eHz_handover in torque mode
+#endif
 
 	//Init the speed controller
 	_motor->FOC.speed_kp = DEFAULT_SPEED_KP; //0.01 = 10A/1000eHz
 	_motor->FOC.speed_ki = DEFAULT_SPEED_KI; //Trickier to set since we want this to be proportional to the ramp speed? Not intuitive? Try 0.1; ramp in 1/10 of a second @100Hz.
+	_motor->FOC.inertia = DEFAULT_INERTIA;
+	speedloop_init(&_motor->speedloop);
 	//Init the Duty controller
 	_motor->FOC.Duty_scaler = 1.0f; //We want this to be 1.0f for everything except duty control mode.
 	//Init the PLL values
 	_motor->FOC.PLL_kp = PLL_KP;
 	_motor->FOC.PLL_ki = PLL_KI;
+	apll_init(&_motor->apll, _motor->FOC.pwm_frequency);
+#ifdef USE_ADAPTIVE_PLL
+	_motor->apll.type = APLL_TYPE_KALMAN;
+#endif
 	//	//Init the POS values
-	_motor->pos.Kp = POS_KP;
-	_motor->pos.Ki = POS_KI;
-	_motor->pos.Kd = POS_KD;
+	traj_init(&_motor->pos.traj, 0);
+	_motor->pos.traj.Kp = POS_KP;
 
 	//init the PLL observer
 	_motor->FOC.BEMF_kp = -0.25;
@@ -349,14 +399,13 @@ while(_motor->MotorState == MOTOR_STATE_INITIALISING){
 }
 	calculateGains(_motor);
 	calculateVoltageGain(_motor);
+	hallest_init(&_motor->hallest, _motor->m.hall_table); //Seed the learned edges from the stored hall table
 
 #ifdef LOGGING
   _motor->logging.lognow = 1;
 #endif
 
-#ifdef USE_SPI_ENCODER
-  _motor->FOC.enc_offset = ENCODER_E_OFFSET;
-#endif
+  encoderConfig(_motor); //Pick up a changed profile
 	//  __HAL_TIM_ENABLE_IT(_motor->stimer, TIM_IT_UPDATE);
 
   	  //Start the slowloop timer
@@ -437,6 +486,9 @@ void fastLoop(MESC_motor_typedef *_motor) {
   // First thing we ever want to do is convert the ADC values
   // to real, useable numbers.
   ADCConversion(_motor);
+  if(_motor->encoder.source != ENCODER_SOURCE_NONE){
+	  encoderRun(_motor);
+  }
 
   switch (_motor->MotorState) {
 
@@ -471,22 +523,20 @@ void fastLoop(MESC_motor_typedef *_motor) {
 				break;
 			case MOTOR_SENSOR_MODE_HALL:
 				_motor->HFI.inject = 0;
-				hallAngleEstimator();
-				angleObserver(_motor);
+				if(_motor->options.use_hall_estimator){
+					hallEstimatorRun(_motor);
+				}else{
+					hallAngleEstimator();
+					angleObserver(_motor);
+				}
 				MESCFOC(_motor);
 				break;
 			case MOTOR_SENSOR_MODE_OPENLOOP:
-				getIncEncAngle(_motor); //Add this for setting up encoder
 				OLGenerateAngle(_motor);
 				MESCFOC(_motor);
 				break;
 			case MOTOR_SENSOR_MODE_ABSOLUTE_ENCODER:
-				_motor->FOC.enc_period_count++;
-				_motor->FOC.FOCAngle = _motor->FOC.enc_angle + (uint16_t)((float)(_motor->FOC.enc_period_count) * (float)_motor->FOC.enc_pwm_step);
-				MESCFOC(_motor);
-				break;
 			case MOTOR_SENSOR_MODE_INCREMENTAL_ENCODER:
-				getIncEncAngle(_motor);
 				_motor->FOC.FOCAngle = _motor->FOC.enc_angle;
 				MESCFOC(_motor);
 				break;
@@ -502,8 +552,12 @@ void fastLoop(MESC_motor_typedef *_motor) {
 		  MESCTrack(_motor);
 		  switch(_motor->MotorSensorMode){
 		  	  case MOTOR_SENSOR_MODE_HALL:
-		  		  hallAngleEstimator(_motor);
-		  		  angleObserver(_motor);
+		  		  if(_motor->options.use_hall_estimator){
+		  			  hallEstimatorRun(_motor);
+		  		  }else{
+		  			  hallAngleEstimator(_motor);
+		  			  angleObserver(_motor);
+		  		  }
 		  		  break;
 		  	  case MOTOR_SENSOR_MODE_SENSORLESS:
 				  MESCfluxobs_run(_motor);
@@ -512,10 +566,7 @@ void fastLoop(MESC_motor_typedef *_motor) {
 				  }
 		  		  break;
 		  	  case MOTOR_SENSOR_MODE_ABSOLUTE_ENCODER:
-		  		  _motor->FOC.FOCAngle = _motor->FOC.enc_angle;
-		  		  break;
 		  	  case MOTOR_SENSOR_MODE_INCREMENTAL_ENCODER:
-		  		  getIncEncAngle(_motor);
 		  		  _motor->FOC.FOCAngle = _motor->FOC.enc_angle;
 		  		  break;
 		  	  default:
@@ -577,9 +628,8 @@ void fastLoop(MESC_motor_typedef *_motor) {
     case MOTOR_STATE_ERROR:
       MESCpwm_generateBreak(_motor);  // Generate a break state (software disabling all PWM)
                         // Now panic and freak out
-      //Get the encoder angle still; we would like to continue tracking angle, there is no harm in it...
-	  getIncEncAngle(_motor);
-	  if(_motor->MotorSensorMode == MOTOR_SENSOR_MODE_INCREMENTAL_ENCODER){
+      //The encoder angle is still tracked; we would like to continue tracking angle, there is no harm in it...
+	  if((_motor->MotorSensorMode == MOTOR_SENSOR_MODE_INCREMENTAL_ENCODER)||(_motor->MotorSensorMode == MOTOR_SENSOR_MODE_ABSOLUTE_ENCODER)){
 		  _motor->FOC.FOCAngle = _motor->FOC.enc_angle;
 	  }else{
 	  //Do the same for the flux observer...
@@ -592,7 +642,8 @@ void fastLoop(MESC_motor_typedef *_motor) {
       break;
 
     case MOTOR_STATE_ALIGN:
-      // Turn on at a given voltage at electricalangle0;
+      // Drag the rotor round on d axis current to find the encoder offset, direction and pole pairs
+      MESCmeasure_EncoderCal(_motor);
       break;
 
     case MOTOR_STATE_TEST:
@@ -632,7 +683,6 @@ void fastLoop(MESC_motor_typedef *_motor) {
     	  //We use "0", since this corresponds to all high side FETs off, always, and all low side ones on, always.
     	  //This means that current measurement can continue on low side and phase shunts, so over current protection remains active.
     	  if(_motor->MotorSensorMode ==MOTOR_SENSOR_MODE_INCREMENTAL_ENCODER){
-    		  getIncEncAngle(_motor);
     		  _motor->FOC.FOCAngle = _motor->FOC.enc_angle;
 //     		  if((_motor->FOC.parkangle-_motor->FOC.FOCAngle)>16384){
 //     			  if((_motor->FOC.parkangle-_motor->FOC.FOCAngle)>32768){
@@ -682,6 +732,9 @@ void fastLoop(MESC_motor_typedef *_motor) {
     	getRawADCVph(_motor);
     	ADCPhaseConversion(_motor);
     	BLDCCommute(_motor);
+    	//Stand in for the Park transform so the smoothed current and the thermal model follow the six-step current
+    	_motor->FOC.Idq.d = 0.0f;
+    	_motor->FOC.Idq.q = (_motor->FOC.eHz < 0.0f) ? -_motor->BLDC.I_meas : _motor->BLDC.I_meas;
 		__NOP();
     	break;
 
@@ -699,16 +752,35 @@ void fastLoop(MESC_motor_typedef *_motor) {
 		  MESClrobs_Collect(_motor);
 	}
 
-#ifdef USE_SPI_ENCODER
-      tle5012(_motor);
-#endif
-
 //RunPLL for all angle options
-	_motor->FOC.PLL_angle = _motor->FOC.PLL_angle + (int16_t)_motor->FOC.PLL_int + (int16_t)_motor->FOC.PLL_error;
-//We add the proportional error here since we did not add it last iteration
-	_motor->FOC.PLL_error = _motor->FOC.PLL_kp * (int16_t)(_motor->FOC.FOCAngle - (_motor->FOC.PLL_angle & 0xFFFF));
-	_motor->FOC.PLL_int = _motor->FOC.PLL_int + _motor->FOC.PLL_ki * _motor->FOC.PLL_error;
-	_motor->FOC.eHz = _motor->FOC.PLL_int * _motor->FOC.pwm_frequency*0.00001526f;//1/65536
+	if(_motor->apll.type == APLL_TYPE_NONE){
+		_motor->FOC.PLL_angle = _motor->FOC.PLL_angle + (int16_t)_motor->FOC.PLL_int + (int16_t)_motor->FOC.PLL_error;
+		//We add the proportional error here since we did not add it last iteration
+		_motor->FOC.PLL_error = _motor->FOC.PLL_kp * (int16_t)(_motor->FOC.FOCAngle - (_motor->FOC.PLL_angle & 0xFFFF));
+		_motor->FOC.PLL_int = _motor->FOC.PLL_int + _motor->FOC.PLL_ki * _motor->FOC.PLL_error;
+		_motor->FOC.eHz = _motor->FOC.PLL_int * _motor->FOC.pwm_frequency*0.00001526f;//1/65536
+		//Keep the adaptive one following so it can be switched in without a jump
+		_motor->apll.angle = _motor->FOC.PLL_angle;
+		_motor->apll.omega = _motor->FOC.PLL_int;
+	}else{
+		//Bandwidth scheduled with speed and angle noise, results land in the same places as the fixed PLL
+		apll_run(&_motor->apll, _motor->FOC.FOCAngle);
+		_motor->FOC.PLL_angle = _motor->apll.angle;
+		_motor->FOC.PLL_int = _motor->apll.omega;
+		_motor->FOC.PLL_error = _motor->apll.err;
+		_motor->FOC.eHz = apll_eHz(&_motor->apll);
+	}
+
+	//Speed loop at a decimation of the fastloop, it owns the q request in speed mode
+	if((_motor->ControlMode == MOTOR_CONTROL_MODE_SPEED) && (_motor->MotorState == MOTOR_STATE_RUN) && speedloop_tick(&_motor->speedloop)){
+		_motor->FOC.Idq_req.q = speedloop_run(&_motor->speedloop, _motor->FOC.speed_req, _motor->FOC.eHz,
+				(float)_motor->speedloop.decimation*_motor->FOC.pwm_period);
+	}
+
+	//Frequency changes requested by the slowloop scheduler are applied here so nothing sees a half updated set of gains
+	if(_motor->options.use_pwm_scheduler && (_motor->fsched.f_req != _motor->FOC.pwm_frequency)){
+		setPWMFrequency(_motor, _motor->fsched.f_req);
+	}
 
 #ifdef LOGGING
 	if(_motor->logging.lognow){
@@ -731,6 +803,7 @@ void fastLoop(MESC_motor_typedef *_motor) {
 	}
 #endif
    _motor->FOC.cycles_fastloop = CPU_CYCLES - cycles;
+   health_isr_sample(&_motor->health_fastloop, _motor->FOC.cycles_fastloop, _motor->FOC.cycles_budget);
 }
 
 // The hyperloop runs at PWM timer bottom, when the PWM is in V7 (all high)
@@ -874,6 +947,13 @@ void ADCConversion(MESC_motor_typedef *_motor) {
                      _motor->FOC.sincosangle.sin * _motor->FOC.Iab.b;
     _motor->FOC.Idq.q = _motor->FOC.sincosangle.cos * _motor->FOC.Iab.b -
                      _motor->FOC.sincosangle.sin * _motor->FOC.Iab.a;
+
+    //When overmodulating, the 5th and 7th harmonics we deliberately apply show up as a 6th harmonic
+    //ripple on Idq. Remove the predicted ripple so the PI does not try to cancel it.
+    if(_motor->options.overmod_type != OVERMOD_TYPE_NONE){
+    	overmod_compensate(&_motor->overmod, _motor->FOC.pwm_period, 6.28318f*_motor->FOC.eHz,
+    			_motor->m.L_D, _motor->m.L_Q, &_motor->FOC.Idq.d, &_motor->FOC.Idq.q);
+    }
 }
 
 void ADCPhaseConversion(MESC_motor_typedef *_motor) {
@@ -1018,6 +1098,38 @@ void hallAngleEstimator(MESC_motor_typedef *_motor) {  // Implementation using t
     }
   }
 
+  void hallEstimatorRun(MESC_motor_typedef *_motor) {
+	//Hall edges are learned and the angle extrapolated with a speed and acceleration
+	//fitted across edges. Above hallest.eHz_lo the flux observer is run and faded in,
+	//and once it has fully taken over it is used to refine the edge angles.
+	if (_motor->hall.current_hall_state == 0) {
+		_motor->MotorState = MOTOR_STATE_ERROR;
+		MotorError = MOTOR_ERROR_HALL0;
+		return;
+	} else if (_motor->hall.current_hall_state == 7) {
+		_motor->MotorState = MOTOR_STATE_ERROR;
+		MotorError = MOTOR_ERROR_HALL7;
+		return;
+	}
+	uint16_t hall_angle = hallest_run(&_motor->hallest, _motor->hall.current_hall_state, _motor->FOC.pwm_period);
+	float w = hallest_blend(&_motor->hallest, hallest_eHz(&_motor->hallest));
+
+	if(w > 0.0f){
+		MESCfluxobs_run(_motor); //Leaves the observer angle in FOCAngle
+		if(w >= 1.0f){
+			hallest_observe(&_motor->hallest, _motor->FOC.FOCAngle);
+		}
+		_motor->FOC.FOCAngle = hall_angle + (int16_t)(w * (float)(int16_t)(_motor->FOC.FOCAngle - hall_angle));
+	}else{
+		//Keep the observer preloaded on the hall angle so the crossover starts aligned
+		float s, c;
+		sin_cos_fast(hall_angle, &s, &c);
+		_motor->FOC.flux_a = _motor->m.flux_linkage * c;
+		_motor->FOC.flux_b = _motor->m.flux_linkage * s;
+		_motor->FOC.FOCAngle = hall_angle;
+	}
+  }
+
   void OLGenerateAngle(MESC_motor_typedef *_motor) {
 	//_motor->FOC.PLL_int = 0.5f*_motor->FOC.openloop_step;
     _motor->FOC.FOCAngle = _motor->FOC.FOCAngle + _motor->FOC.openloop_step;
@@ -1214,10 +1326,21 @@ case SQRT_CIRCLE_LIM_VD:
 	  _motor->m.flux_linkage_min = 0.5f*_motor->m.flux_linkage;
 	  _motor->m.flux_linkage_gain = 10.0f * sqrtf(_motor->m.flux_linkage);
 	  _motor->m.non_linear_centering_gain = NON_LINEAR_CENTERING_GAIN;
+	  _motor->sixstep.flux_th = sixstep_flux_threshold(_motor->m.flux_linkage);
   }
 
-  void calculateGains(MESC_motor_typedef *_motor) {
+  //Amps per eHz/s of acceleration, Iq = J*alpha/Kt with alpha in rad/s^2 of the rotor. Zero while the inertia is unknown.
+  float calculateAccelerationGain(MESC_motor_typedef *_motor) {
+	  float Kt = 1.5f*(float)_motor->m.pole_pairs*_motor->m.flux_linkage;
+	  if((Kt <= 0.0f)||(_motor->FOC.inertia <= 0.0f)){
+		  return 0.0f;
+	  }
+	  return _motor->FOC.inertia*6.2831853f/((float)_motor->m.pole_pairs*Kt);
+  }
+
+  void calculatePWMTiming(MESC_motor_typedef *_motor) {
     _motor->FOC.pwm_period = 1.0f/_motor->FOC.pwm_frequency;
+    _motor->mtimer->Instance->CR1 |= TIM_CR1_ARPE; //Preload ARR so a frequency change lands on the update event, not mid count
     _motor->mtimer->Instance->ARR = HAL_RCC_GetHCLKFreq()/(((float)_motor->mtimer->Instance->PSC + 1.0f) * 2*_motor->FOC.pwm_frequency);
     _motor->mtimer->Instance->CCR4 = _motor->mtimer->Instance->ARR-5; //Just short of dead center (dead center will not actually trigger the conversion)
     #ifdef SINGLE_ADC
@@ -1226,6 +1349,29 @@ case SQRT_CIRCLE_LIM_VD:
     _motor->FOC.PWMmid = _motor->mtimer->Instance->ARR * 0.5f;
 
     _motor->FOC.ADC_duty_threshold = _motor->mtimer->Instance->ARR * 0.90f;
+    _motor->FOC.cycles_budget = HAL_RCC_GetHCLKFreq() / (uint32_t)_motor->FOC.pwm_frequency;
+  }
+
+  void setPWMFrequency(MESC_motor_typedef *_motor, float f) {
+	//Called from the fastloop, between PWM writes
+	float f_old = _motor->FOC.pwm_frequency;
+	float ratio = f_old/f;
+	_motor->FOC.pwm_frequency = f;
+	calculatePWMTiming(_motor);
+	_motor->FOC.Vab_to_PWM = _motor->mtimer->Instance->ARR / _motor->Conv.Vbus;
+	//Anything in seconds (observers, PI integrals) just picks up the new pwm_period.
+	//Anything counted in PWM cycles has to be rescaled to keep its meaning.
+	fsched_rescale_pll(f_old, f, &_motor->FOC.PLL_kp, &_motor->FOC.PLL_ki, &_motor->FOC.PLL_int, &_motor->FOC.PLL_error);
+	apll_set_frequency(&_motor->apll, f);
+	_motor->FOC.openloop_step = (uint16_t)((float)_motor->FOC.openloop_step * ratio);
+	_motor->hall.angle_step = _motor->hall.angle_step * ratio;
+	_motor->hall.ticks_since_last_observer_change = _motor->hall.ticks_since_last_observer_change / ratio;
+	_motor->hall.last_observer_period = _motor->hall.last_observer_period / ratio;
+	_motor->hall.one_on_last_observer_period = _motor->hall.one_on_last_observer_period * ratio;
+  }
+
+  void calculateGains(MESC_motor_typedef *_motor) {
+	calculatePWMTiming(_motor);
     _motor->m.pole_angle = 65536/_motor->m.pole_pairs;
     calculateFlux(_motor);
 
@@ -1252,6 +1398,10 @@ case SQRT_CIRCLE_LIM_VD:
     // used by the SVPWM This is equal to
     // 0.5*Vbus*MAX_MODULATION*SVPWM_MULTIPLIER*Vd_MAX_PROPORTION
     if(_motor->ControlMode != MOTOR_CONTROL_MODE_DUTY){_motor->FOC.Duty_scaler = 1.0f;}
+    //Beyond six-step there is no more fundamental to be had, only distortion
+    if((_motor->options.overmod_type != OVERMOD_TYPE_NONE)&&(_motor->FOC.Modulation_max > OVERMOD_SIX_STEP_RATIO)){
+    	_motor->FOC.Modulation_max = OVERMOD_SIX_STEP_RATIO;
+    }
     _motor->FOC.Vmag_max = 0.5f * _motor->Conv.Vbus *
     		_motor->FOC.Modulation_max * SVPWM_MULTIPLIER * _motor->FOC.Duty_scaler;
     _motor->FOC.V_3Q_mag_max =  _motor->FOC.Vmag_max * 0.75f;
@@ -1331,6 +1481,7 @@ float  Square(float x){ return((x)*(x));}
 // for battery voltage change
 ///Process buttons for direction
 
+		batch_apply(&_motor->batch);	//Batched setup changes land here, between iterations, never part way through one
 		houseKeeping(_motor);	//General dross that keeps things ticking over, like nudging the observer
 		MESCinput_Collect(_motor); //Get all the throttle inputs
 		switch(_motor->options.app_type){
@@ -1389,6 +1540,7 @@ float  Square(float x){ return((x)*(x));}
 			_motor->FOC.PLL_ki = 0.0f;
 			_motor->FOC.PLL_ki = 0.0f;
 			_motor->FOC.PLL_error = 0.0f;
+			apll_reset(&_motor->apll, _motor->FOC.PLL_angle);
 
 			_motor->m.R =10.0f*_motor->FOC.Idq_smoothed.d /(_motor->FOC.Idq_smoothed.d*_motor->FOC.Idq_smoothed.d +
 					_motor->FOC.Idq_smoothed.q*_motor->FOC.Idq_smoothed.q);
@@ -1425,6 +1577,22 @@ float  Square(float x){ return((x)*(x));}
 	  if((_motor->key_bits)){
 		  _motor->FOC.Idq_prereq.q = 0.0f;
 		  _motor->FOC.Idq_prereq.d = 0.0f;
+	  }
+	  /////////////////Schedule the PWM frequency, the fastloop applies it
+	  //Not while measuring or injecting HFI; both are built around a fixed number of PWM cycles
+	  if(_motor->options.use_pwm_scheduler && (_motor->HFI.inject == 0) &&
+			  (_motor->MotorState != MOTOR_STATE_MEASURING) && (_motor->ControlMode != MOTOR_CONTROL_MODE_MEASURING)){
+		  float T_mos = fmaxf(_motor->Conv.MOSu_T, fmaxf(_motor->Conv.MOSv_T, _motor->Conv.MOSw_T));
+		  fsched_update(&_motor->fsched, _motor->FOC.pwm_frequency, _motor->FOC.eHz, T_mos, _motor->FOC.Current_bandwidth);
+	  }
+	  /////////////////Track the battery
+	  //All motors draw from one pack; Ibus is only calculated while running, FOC or six-step
+	  {
+		  float Ibat = 0.0f;
+		  for(int i = 0; i < NUM_MOTORS; i++){
+			  if((mtr[i].MotorState == MOTOR_STATE_RUN) || (mtr[i].MotorState == MOTOR_STATE_RUN_BLDC)){Ibat += mtr[i].FOC.Ibus;}
+		  }
+		  bat_update(&_motor->bat, _motor->Conv.Vbus, Ibat, 1.0f/(float)SLOW_LOOP_FREQUENCY);
 	  }
 		///////////////////////Run the state machine//////////////////////////////////
 	switch(_motor->MotorState){
@@ -1440,8 +1608,11 @@ float  Square(float x){ return((x)*(x));}
 					if(_motor->MotorControlType == MOTOR_CONTROL_TYPE_FOC){
 						_motor->MotorState = MOTOR_STATE_RUN;
 					}else if(_motor->MotorControlType == MOTOR_CONTROL_TYPE_BLDC){
+						//Pick up from the observer, which keeps running while tracking
+						sixstep_start(&_motor->sixstep, _motor->FOC.FOCAngle, _motor->FOC.eHz);
+						_motor->BLDC.int_I_error = 0.0f;
 						_motor->MotorState = MOTOR_STATE_RUN_BLDC;
-
+						break;
 					}
 					#else
 					_motor->MotorState = MOTOR_STATE_RECOVERING;
@@ -1479,6 +1650,7 @@ float  Square(float x){ return((x)*(x));}
 			if(_motor->options.MTPA_mode){
 				RunMTPA(_motor);//Process MTPA
 			}
+			float Iq_unlimited = _motor->FOC.Idq_prereq.q;
 
 			LimitFWCurrent(_motor);//Process FW -> Iq reduction
 			clampBatteryPower(_motor); //Prevent too much power being drawn from the battery
@@ -1486,14 +1658,35 @@ float  Square(float x){ return((x)*(x));}
 			if(_motor->options.use_lr_observer){
 				MESClrobs_Run(_motor);
 			}
+			if(_motor->options.pwm_type == PWM_DPWM){
+				//Pick the clamp window from the modulation index and where the current peak sits
+				dpwm_update(&_motor->dpwm, _motor->FOC.Voltage/(0.57735f*_motor->Conv.Vbus),
+						_motor->FOC.Vdq.d, _motor->FOC.Vdq.q, _motor->FOC.Idq_smoothed.d, _motor->FOC.Idq_smoothed.q);
+			}
 
 			//Assign the Idqreq to the PI input
-			_motor->FOC.Idq_req.q = _motor->FOC.Idq_prereq.q;
+			if(_motor->ControlMode == MOTOR_CONTROL_MODE_SPEED){
+				//The fastloop speed loop owns q; pass it the limits, tightened where FW or the battery clamped
+				float rollback = (_motor->key_bits) ? 0.0f : _motor->FOC.T_rollback;
+				_motor->speedloop.Iq_chain = Iq_unlimited;
+				speedloop_limit(&_motor->speedloop, rollback*_motor->input_vars.min_request_Idq.q,
+						rollback*_motor->input_vars.max_request_Idq.q, _motor->FOC.Idq_prereq.q);
+			}else{
+				_motor->FOC.Idq_req.q = _motor->FOC.Idq_prereq.q;
+			}
 			_motor->FOC.Idq_req.d = _motor->FOC.Idq_prereq.d;
 			if(_motor->input_vars.UART_dreq){_motor->FOC.Idq_req.d = _motor->input_vars.UART_dreq;}//Override the calcs if a specific d is requested
 			MESCpwm_generateEnable(_motor);
 			switch(_motor->ControlMode){
 				case MOTOR_CONTROL_MODE_TORQUE:
+					//Fast and motoring, hand over to six-step; the PI starts from the FOC voltage, line to line
+					if(_motor->options.use_sixstep && (_motor->FOC.Idq_prereq.q*_motor->FOC.eHz > 0.0f) &&
+							(fabsf(_motor->FOC.eHz) > _motor->sixstep.eHz_handover*(1.0f + SIXSTEP_HYSTERESIS))){
+						sixstep_start(&_motor->sixstep, _motor->FOC.FOCAngle, _motor->FOC.eHz);
+						_motor->BLDC.int_I_error = 1.732f*_motor->FOC.Voltage;
+						_motor->MotorState = MOTOR_STATE_RUN_BLDC;
+						break;
+					}
 					if(((fabsf(_motor->FOC.Idq_prereq.q)<0.1f))){//Request current small, FW not active
 						if((_motor->FOC.FW_current>-0.5f)){
 						_motor->MotorState = MOTOR_STATE_TRACKING;
@@ -1528,8 +1721,31 @@ float  Square(float x){ return((x)*(x));}
 			SlowStartup(_motor);
 			break;
 		case MOTOR_STATE_RUN_BLDC:
-			//Assign the Idqreq to the PI input
-			_motor->BLDC.I_set = _motor->FOC.Idq_prereq.q;
+			//Same temperature and battery limits as RUN; there is no d axis so no MTPA or FW
+			calculatePower(_motor);
+			ThrottleTemperature(_motor);
+			if(_motor->MotorState == MOTOR_STATE_ERROR){
+				break;
+			}
+			clampBatteryPower(_motor);
+			//Assign the Idqreq to the PI input; the drive sectors already carry the direction
+			_motor->BLDC.I_set = (_motor->FOC.eHz < 0.0f) ? -_motor->FOC.Idq_prereq.q : _motor->FOC.Idq_prereq.q;
+			if((!_motor->sixstep.locked) || (fabsf(_motor->FOC.Idq_prereq.q) < 0.1f)){
+				//Lost the crossings or released, coast and let the observer find the rotor again
+				MESCpwm_generateBreak(_motor);
+				_motor->MotorState = MOTOR_STATE_TRACKING;
+			}else if(_motor->options.use_sixstep && ((_motor->BLDC.I_set <= 0.0f) ||
+					(fabsf(_motor->FOC.eHz) < _motor->sixstep.eHz_handover*(1.0f - SIXSTEP_HYSTERESIS)))){
+				//Slowing or braking, back to FOC from the six-step angle and voltage
+				float s, c;
+				sin_cos_fast(_motor->FOC.FOCAngle, &s, &c);
+				_motor->FOC.flux_a = _motor->m.flux_linkage * c;
+				_motor->FOC.flux_b = _motor->m.flux_linkage * s;
+				_motor->FOC.Idq_int_err.d = 0.0f;
+				_motor->FOC.Idq_int_err.q = (_motor->FOC.eHz < 0.0f) ? -0.57735f*_motor->BLDC.V_bldc : 0.57735f*_motor->BLDC.V_bldc;
+				MESCpwm_generateEnable(_motor);
+				_motor->MotorState = MOTOR_STATE_RUN;
+			}
 			break;
 
 		case MOTOR_STATE_ERROR:
@@ -1778,11 +1994,7 @@ void MESCTrack(MESC_motor_typedef *_motor) {
 //      }
 
       pkt.angle = pkt.angle & 0x7fff;
-#ifdef ENCODER_DIR_REVERSED
-      	  _motor->FOC.enc_angle = -_motor->m.pole_pairs*((pkt.angle *2)%_motor->m.pole_angle)-_motor->FOC.enc_offset;
-#else
-      _motor->FOC.enc_angle = _motor->m.pole_pairs*((pkt.angle *2)%_motor->m.pole_angle)-_motor->FOC.enc_offset;
-#endif
+      encoder_abs(&_motor->encoder, pkt.angle); //15 bit, direction and offset are applied by the encoder
       HAL_GPIO_WritePin(GPIOB, GPIO_PIN_8, GPIO_PIN_SET);
       pkt.revolutions = pkt.revolutions&0b0000000111111111;
 #endif
@@ -1806,11 +2018,63 @@ void HallFluxMonitor(MESC_motor_typedef *_motor){
 	}
 }
 void getIncEncAngle(MESC_motor_typedef *_motor){
-	if(_motor->FOC.encoder_polarity_invert){
-		_motor->FOC.enc_angle = _motor->m.pole_pairs*(65536-(_motor->FOC.enc_ratio*(uint16_t)_motor->enctimer->Instance->CNT-_motor->FOC.enc_ratio*(uint16_t)_motor->enctimer->Instance->CCR3)) + _motor->FOC.enc_offset;
+	//The counter runs free over 16 bits with the index captured on CCR3; the encoder counts the deltas, so any PPR works
+	encoder_abi(&_motor->encoder, (uint16_t)_motor->enctimer->Instance->CNT, (uint16_t)_motor->enctimer->Instance->CCR3);
+}
 
-	}else{
-		_motor->FOC.enc_angle = _motor->m.pole_pairs*((_motor->FOC.enc_ratio*(uint16_t)_motor->enctimer->Instance->CNT-_motor->FOC.enc_ratio*(uint16_t)_motor->enctimer->Instance->CCR3)) + _motor->FOC.enc_offset;
+//The stored offset keeps the sign each source has always given it: the TLE5012
+//subtracts it, the PWM encoder inverts it along with the angle and ABI adds it.
+//The encoder always adds, so this maps one to the other, both ways.
+static uint16_t encoderOffset(MESC_motor_typedef *_motor, uint16_t offset){
+#if defined(USE_SPI_ENCODER)
+	return (uint16_t)(0u - offset);
+#elif defined(IC_TIMER_ENCODER)
+	return _motor->FOC.encoder_polarity_invert ? (uint16_t)(0u - offset) : offset;
+#else
+	(void)_motor;
+	return offset;
+#endif
+}
+
+void encoderStore(MESC_motor_typedef *_motor){
+	_motor->FOC.encoder_polarity_invert = _motor->encoder.invert ? 1 : 0;
+	_motor->FOC.enc_offset = encoderOffset(_motor, _motor->encoder.offset);
+}
+
+void encoderConfig(MESC_motor_typedef *_motor){
+	_motor->encoder.invert = (_motor->FOC.encoder_polarity_invert != 0);
+	_motor->encoder.offset = encoderOffset(_motor, _motor->FOC.enc_offset);
+
+	//A compiled in absolute encoder takes priority over the ABI timer
+#if defined(USE_SPI_ENCODER)
+	_motor->encoder.source = ENCODER_SOURCE_ABSOLUTE;
+	encoder_config(&_motor->encoder, 32768, _motor->m.pole_pairs);
+#elif defined(IC_TIMER_ENCODER)
+	_motor->encoder.source = ENCODER_SOURCE_ABSOLUTE;
+	encoder_config(&_motor->encoder, 65536, _motor->m.pole_pairs);
+#else
+	if(_motor->enctimer){
+		_motor->encoder.source = ENCODER_SOURCE_ABI;
+		encoder_config(&_motor->encoder, _motor->m.enc_counts, _motor->m.pole_pairs);
+	}
+#endif
+}
+
+void encoderRun(MESC_motor_typedef *_motor){
+	//Sampled at the top of the fastloop so the age of the angle is known, and carried forward to the PWM centre
+	if(_motor->encoder.source == ENCODER_SOURCE_ABI){
+		getIncEncAngle(_motor);
+	}
+#ifdef USE_SPI_ENCODER
+	tle5012(_motor);
+#endif
+	_motor->FOC.enc_angle = encoder_run(&_motor->encoder, _motor->FOC.pwm_period);
+	//For sensorless-PWM encoder combined mode
+	sin_cos_fast(_motor->FOC.enc_angle, &_motor->FOC.encsin, &_motor->FOC.enccos);
+
+	if((_motor->MotorState == MOTOR_STATE_RUN) && !encoder_ok(&_motor->encoder) &&
+			((_motor->MotorSensorMode == MOTOR_SENSOR_MODE_ABSOLUTE_ENCODER)||(_motor->MotorSensorMode == MOTOR_SENSOR_MODE_INCREMENTAL_ENCODER))){
+		handleError(_motor, ERROR_ENCODER);
 	}
 }
 
@@ -1910,10 +2174,21 @@ void RunMTPA(MESC_motor_typedef *_motor){
 	}
 }
 
+//The q voltage the power calcs use. Six-step puts V_bldc across the conducting pair, P = V_bldc*I,
+//written here as the 1.5*Vq*Iq of FOC; Vdq is left over from before the handover.
+static float powerVoltageQ(MESC_motor_typedef *_motor){
+	if(_motor->MotorState == MOTOR_STATE_RUN_BLDC){
+		return (_motor->FOC.eHz < 0.0f) ? -_motor->BLDC.V_bldc/1.5f : _motor->BLDC.V_bldc/1.5f;
+	}
+	return _motor->FOC.Vdq.q;
+}
+
 void calculatePower(MESC_motor_typedef *_motor){
 ////// Calculate the current power
-		_motor->FOC.currentPower.d = 1.5f*(_motor->FOC.Vdq.d*_motor->FOC.Idq_smoothed.d);
-		_motor->FOC.currentPower.q = 1.5f*(_motor->FOC.Vdq.q*_motor->FOC.Idq_smoothed.q);
+		//Six-step has no d axis; its bus current comes out as I_meas*V_bldc/Vbus
+		float const Vd = (_motor->MotorState == MOTOR_STATE_RUN_BLDC) ? 0.0f : _motor->FOC.Vdq.d;
+		_motor->FOC.currentPower.d = 1.5f*(Vd*_motor->FOC.Idq_smoothed.d);
+		_motor->FOC.currentPower.q = 1.5f*(powerVoltageQ(_motor)*_motor->FOC.Idq_smoothed.q);
 		_motor->FOC.Ibus = (_motor->FOC.currentPower.d + _motor->FOC.currentPower.q) /_motor->Conv.Vbus;
 }
 
@@ -1941,16 +2216,25 @@ void LimitFWCurrent(MESC_motor_typedef *_motor){
 void clampBatteryPower(MESC_motor_typedef *_motor){
 /////// Clamp the max power taken from the battery
 /////// This assumes no MTPA and no FW active. There is no (simple) closed form for FOC with D axis current.
-    _motor->FOC.reqPower = 1.5f*fabsf(_motor->FOC.Vdq.q * _motor->FOC.Idq_prereq.q);
+    float const Vq = powerVoltageQ(_motor);
+    _motor->FOC.reqPower = 1.5f*fabsf(Vq * _motor->FOC.Idq_prereq.q);
     float batt_power_max = _motor->m.IBatmax*_motor->Conv.Vbus; //Calculate the max battery power allowed at current voltage
     if(batt_power_max > _motor->m.Pmax){
     	batt_power_max = _motor->m.Pmax;		//Replace batt_power with the lower power limit
     }
+    if(_motor->options.use_bat_limits){
+    	//Dynamic limit from the pack model, keeps Vbus inside the cell range. Split between the motors.
+    	bool regen = ((Vq * _motor->FOC.Idq_prereq.q) < 0.0f);
+    	float bat_power_max = (regen ? _motor->bat.Ichg : _motor->bat.Idis)*_motor->Conv.Vbus/(float)NUM_MOTORS;
+    	if(batt_power_max > bat_power_max){
+    		batt_power_max = bat_power_max;
+    	}
+    }
     if (_motor->FOC.reqPower > batt_power_max) {
     	if(_motor->FOC.Idq_prereq.q > 0.0f){
-    		_motor->FOC.Idq_prereq.q = batt_power_max / (fabsf(_motor->FOC.Vdq.q)*1.5f);
+    		_motor->FOC.Idq_prereq.q = batt_power_max / (fabsf(Vq)*1.5f);
     	}else{
-    		_motor->FOC.Idq_prereq.q = -batt_power_max / (fabsf(_motor->FOC.Vdq.q)*1.5f);
+    		_motor->FOC.Idq_prereq.q = -batt_power_max / (fabsf(Vq)*1.5f);
     	}
     }
 }
@@ -1973,6 +2257,8 @@ void houseKeeping(MESC_motor_typedef *_motor){
 		//The PLL has run away locking on to aliases; 10000 implies 6.5 pwm periods per sin wave, which is ~3000eHz, 180kerpm at 20kHz PWM frequency.
 		//While it IS possible to run faster than this, it is not a sensible use case and will not be supported.
 		_motor->FOC.PLL_int = 0;
+		_motor->apll.omega = 0.0f;
+		_motor->apll.alpha = 0.0f;
 	}
 	//Translate the eHz to eRPM
 	if(_motor->m.pole_pairs>0){//avoid divide by zero
@@ -2040,6 +2326,18 @@ void ThrottleTemperature(MESC_motor_typedef *_motor){
 	if(_motor->FOC.T_rollback>1.0f){
 		_motor->FOC.T_rollback = 1.0f;
 	}
+	if(_motor->options.use_thermal_model){
+		//The winding and junctions run ahead of their sensors; taper on the model prediction as well
+		float T_mos = fmaxf(_motor->Conv.MOSu_T, fmaxf(_motor->Conv.MOSv_T, _motor->Conv.MOSw_T));
+		float T_motor = _motor->options.has_motor_temp_sensor ? _motor->Conv.Motor_T : 0.0f;
+		thermal_update(&_motor->thermal, _motor->FOC.Idq_smoothed.d, _motor->FOC.Idq_smoothed.q, _motor->m.R, _motor->Conv.Vbus,
+				_motor->FOC.pwm_frequency, T_motor, T_mos, 1.0f/(float)SLOW_LOOP_FREQUENCY);
+		float Imax = fmaxf(fabsf(_motor->input_vars.max_request_Idq.q), fabsf(_motor->input_vars.min_request_Idq.q));
+		float k = thermal_rollback(&_motor->thermal, Imax, &_motor->Raw.Motor_temp, &_motor->Raw.MOS_temp);
+		if(k < _motor->FOC.T_rollback){
+			_motor->FOC.T_rollback = k;
+		}
+	}
 	if(_motor->FOC.Idq_prereq.q>(_motor->FOC.T_rollback * _motor->input_vars.max_request_Idq.q)){_motor->FOC.Idq_prereq.q = _motor->FOC.T_rollback * _motor->input_vars.max_request_Idq.q;}
 	if(_motor->FOC.Idq_prereq.q<(_motor->FOC.T_rollback * _motor->input_vars.min_request_Idq.q)){_motor->FOC.Idq_prereq.q = _motor->FOC.T_rollback * _motor->input_vars.min_request_Idq.q;}
 }
@@ -2059,30 +2357,21 @@ void safeStart(MESC_motor_typedef *_motor){
 
 
 //Speed controller
+//The PI itself runs in the fastloop (see MESCspeedloop.h); here we load the gains and hand its output to the
+//slowloop limit chain, which sets the limits it winds back against once the chain has run.
 void RunSpeedControl(MESC_motor_typedef *_motor){
-	float speed_error;
+	SPEEDLOOP *sl = &_motor->speedloop;
+	sl->kp = _motor->FOC.speed_kp;
+	sl->ki = _motor->FOC.speed_ki*(float)SLOW_LOOP_FREQUENCY; //speed_ki stays per slowloop period so existing tunes hold
+	sl->Kacc = calculateAccelerationGain(_motor);
 	  if(_motor->MotorState == MOTOR_STATE_RUN){
-
-		speed_error = _motor->FOC.speed_kp*(_motor->FOC.speed_req - _motor->FOC.eHz);
-		//Bound the proportional term before we do anything with it
-		//We use the symetric terms here to allow fast PID ramps
-		speed_error = clamp(speed_error, -_motor->input_vars.max_request_Idq.q, _motor->input_vars.max_request_Idq.q);
-
-		_motor->FOC.speed_error_int = _motor->FOC.speed_error_int + speed_error * _motor->FOC.speed_ki;
-		//Bound the integral term...
-		//Again, using symmetric terms
-		_motor->FOC.speed_error_int = clamp(_motor->FOC.speed_error_int, -_motor->input_vars.max_request_Idq.q, _motor->input_vars.max_request_Idq.q);
-
-		//Apply the PID
-		_motor->FOC.Idq_prereq.q = _motor->FOC.speed_error_int + speed_error;
-		//Bound the overall...
-		//Now we use asymmetric terms to stop it regenerating too much
-		_motor->FOC.Idq_prereq.q = clamp(_motor->FOC.Idq_prereq.q, _motor->input_vars.min_request_Idq.q, _motor->input_vars.max_request_Idq.q);
-
+		  _motor->FOC.Idq_prereq.q = sl->Iq;
 	  } else {
-		  //Set zero
+		  //Set zero, and restart from wherever the rotor is
 		  _motor->FOC.Idq_prereq.q = 0.0f;
-		  _motor->FOC.speed_error_int = 0.0f;
+		  sl->Iq_chain = 0.0f;
+		  speedloop_reset(sl, _motor->FOC.eHz);
+		  speedloop_limit(sl, _motor->input_vars.min_request_Idq.q, _motor->input_vars.max_request_Idq.q, 0.0f);
 	  }
 }
 
@@ -2140,32 +2429,14 @@ void MESC_IC_IRQ_Handler(MESC_motor_typedef *_motor, uint32_t SR, uint32_t CCR1,
 		if(CCR2<16){//No error but need to stop it from underflowing the following math
 			CCR2 = 16;
 		}
-		uint16_t temp_enc_ang;
-		temp_enc_ang = _motor->FOC.enc_offset +
-						(uint16_t)(((65536*(CCR2-16))/(CCR1-24)*(uint32_t)_motor->m.pole_pairs)%65536);
-//Set the angles used and zero the counter
-		if(_motor->FOC.encoder_polarity_invert){
-			_motor->FOC.last_enc_period = _motor->FOC.enc_period_count;
-			_motor->FOC.enc_period_count = 0;
-			_motor->FOC.enc_angle = 65536 - temp_enc_ang;
-		} else{
-			_motor->FOC.last_enc_period = _motor->FOC.enc_period_count;
-			_motor->FOC.enc_angle = temp_enc_ang;
-			_motor->FOC.enc_period_count = 0;
-		}
-
-	//Calculate the deltas and steps
-		_motor->FOC.enc_pwm_step = 0.8f*_motor->FOC.enc_pwm_step +
-				0.2f*(((int16_t)(_motor->FOC.enc_angle - _motor->FOC.last_enc_angle))/(_motor->FOC.last_enc_period + 0.1f));
-		_motor->FOC.last_enc_angle = _motor->FOC.enc_angle;
+		//Mechanical angle, 65536 per rev; the encoder interpolates it to the fastloop
+		encoder_abs(&_motor->encoder, ((65536*(CCR2-16))/(CCR1-24))%65536);
 	}
-	//For sensorless-PWM encoder combined mode
-	//Calculate the sin and cos coefficients for future use in the flux observer
-	sin_cos_fast((_motor->FOC.enc_angle), &_motor->FOC.encsin, &_motor->FOC.enccos);
 
 	if(SR & 0x1||_motor->FOC.encoder_pulse<14||_motor->FOC.encoder_pulse>(_motor->FOC.encoder_duration-7)){
 		SRtemp3 = SR;
 		_motor->FOC.encoder_OK = 0;
+		encoder_fault(&_motor->encoder);
 	}
 #endif
 }
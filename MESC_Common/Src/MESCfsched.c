@@ -0,0 +1,152 @@
+/*
+ **
+ ******************************************************************************
+ * @file           : MESCfsched.c
+ * @brief          : Variable PWM frequency scheduler
+ ******************************************************************************
+ * @attention
+ *
+ * <h2><center>&copy; Copyright (c) 2020 David Molony.
+ * All rights reserved.</center></h2>
+ *
+ * This software component is licensed under BSD 3-Clause license,
+ * the "License"; You may not use this file except in compliance with the
+ * License. You may obtain a copy of the License at:
+ *                        opensource.org/licenses/BSD-3-Clause
+ *
+ ******************************************************************************
+ *In addition to the usual 3 BSD clauses, it is explicitly noted that you
+ *do NOT have the right to take sections of this code for other projects
+ *without attribution and credit to the source. Specifically, if you copy into
+ *copyleft licenced code without attribution and retention of the permissive BSD
+ *3 clause licence, you grant a perpetual licence to do the same regarding turning sections of your code
+ *permissive, and lose any rights to use of this code previously granted or assumed.
+ *
+ *This code is intended to remain permissively licensed wherever it goes,
+ *maintaining the freedom to distribute compiled binaries WITHOUT a requirement to supply source.
+ *
+ *This is to ensure this code can at any point be used commercially, on products that may require
+ *such restriction to meet regulatory requirements, or to avoid damage to hardware, or to ensure
+ *warranties can reasonably be honoured.
+ ******************************************************************************
+ */
+
+
+#include "MESCfsched.h"
+
+#include <math.h>
+
+void fsched_init( FSCHED * const fs, float const f_nominal )
+{
+    fs->f_min    = 0.5f * f_nominal;
+    fs->f_max    = f_nominal;
+
+    fs->eHz_lo   = 0.005f * f_nominal;
+    fs->eHz_hi   = 0.02f  * f_nominal;
+
+    fs->T_lo     = 80.0f;
+    fs->T_hi     = 110.0f;
+
+    fs->f_target = f_nominal;
+    fs->f_req    = f_nominal;
+
+    fs->floor_limited = 0;
+}
+
+static float fsched_lerp( float const x, float const x0, float const x1, float const y0, float const y1 )
+{
+    if ((x <= x0) || (x1 <= x0))
+    {
+        return y0;
+    }
+
+    if (x >= x1)
+    {
+        return y1;
+    }
+
+    return y0 + (((y1 - y0) * (x - x0)) / (x1 - x0));
+}
+
+float fsched_update( FSCHED * const fs, float const f_now,
+                     float const eHz, float const T, float const bandwidth )
+{
+    float const w = fabsf( eHz );
+
+    float f = fsched_lerp( w, fs->eHz_lo, fs->eHz_hi, fs->f_min, fs->f_max );
+    float const f_T = fsched_lerp( T, fs->T_lo, fs->T_hi, fs->f_max, fs->f_min );
+
+    if (f_T < f)
+    {
+        f = f_T;
+    }
+
+    // Hard floors win over the thermal derate; control has to stay possible
+    float const f_erev = FSCHED_SAMPLES_PER_EREV * w;
+    float const f_bw   = FSCHED_BW_RATIO * bandwidth;
+
+    if (f < fs->f_min)
+    {
+        f = fs->f_min;
+    }
+
+    if (f < f_erev)
+    {
+        f = f_erev;
+    }
+
+    if (f < f_bw)
+    {
+        f = f_bw;
+    }
+
+    // ...but not over f_max, which is what the switches and the fast loop can take
+    fs->floor_limited = (f > fs->f_max);
+
+    if (fs->floor_limited)
+    {
+        f = fs->f_max;
+    }
+
+    fs->f_target = f;
+
+    // Small moves are not worth the disturbance, except to settle onto the limits
+    if ((fabsf( f - f_now ) < (FSCHED_HYSTERESIS * f_now)) && (f != fs->f_min) && (f != fs->f_max))
+    {
+        fs->f_req = f_now;
+        return fs->f_req;
+    }
+
+    float const step = FSCHED_SLEW * f_now;
+
+    if (f > (f_now + step))
+    {
+        f = f_now + step;
+    }
+    else if (f < (f_now - step))
+    {
+        f = f_now - step;
+    }
+
+    fs->f_req = f;
+
+    return fs->f_req;
+}
+
+void fsched_rescale_pll( float const f_old, float const f_new,
+                         float * const kp, float * const ki,
+                         float * const integral, float * const error )
+{
+    /*
+    The PLL works in angle counts per PWM cycle. Its proportional path is
+    kp * f counts/s per count of error and its integral path ki * kp * f^2;
+    holding both constant needs kp and ki to scale with f_old/f_new, as do
+    the integral (the speed) and the pending proportional correction.
+    */
+    float const r = f_old / f_new;
+
+    *kp       = *kp       * r;
+    *ki       = *ki       * r;
+    *integral = *integral * r;
+    *error    = *error    * r;
+}
@@ -0,0 +1,431 @@
+/*
+ **
+ ******************************************************************************
+ * @file           : MESChallest.c
+ * @brief          : Hall sensor angle estimator with learned edges
+ ******************************************************************************
+ * @attention
+ *
+ * <h2><center>&copy; Copyright (c) 2020 David Molony.
+ * All rights reserved.</center></h2>
+ *
+ * This software component is licensed under BSD 3-Clause license,
+ * the "License"; You may not use this file except in compliance with the
+ * License. You may obtain a copy of the License at:
+ *                        opensource.org/licenses/BSD-3-Clause
+ *
+ ******************************************************************************
+ *In addition to the usual 3 BSD clauses, it is explicitly noted that you
+ *do NOT have the right to take sections of this code for other projects
+ *without attribution and credit to the source. Specifically, if you copy into
+ *copyleft licenced code without attribution and retention of the permissive BSD
+ *3 clause licence, you grant a perpetual licence to do the same regarding turning sections of your code
+ *permissive, and lose any rights to use of this code previously granted or assumed.
+ *
+ *This code is intended to remain permissively licensed wherever it goes,
+ *maintaining the freedom to distribute compiled binaries WITHOUT a requirement to supply source.
+ *
+ *This is to ensure this code can at any point be used commercially, on products that may require
+ *such restriction to meet regulatory requirements, or to avoid damage to hardware, or to ensure
+ *warranties can reasonably be honoured.
+ ******************************************************************************
+ */
+
+
+#include "MESChallest.h"
+
+#include <math.h>
+
+/*
+Each hall edge is a known angle (once learned) crossed at a measured time, so
+between edges the angle is extrapolated from a constant acceleration model
+fitted across the last edges rather than a fixed step from the last period.
+The extrapolation is held at the next edge so a decelerating rotor does not
+run ahead of the sensors.
+
+Edge angles are learned two ways:
+ - From timing. Over a complete erev at a steady speed each edge should be
+   crossed at the fraction of the erev period that matches its angle. The
+   mean is held so only the spacing is corrected.
+ - From a trusted reference angle (the flux observer at speed), which also
+   corrects the mean.
+*/
+
+#define HALLEST_EREV      65536.0f
+#define HALLEST_HALF_EREV 32768.0f
+
+static float hallest_wrap( float x )
+{
+    while (x >= HALLEST_HALF_EREV)
+    {
+        x = x - HALLEST_EREV;
+    }
+
+    while (x < -HALLEST_HALF_EREV)
+    {
+        x = x + HALLEST_EREV;
+    }
+
+    return x;
+}
+
+static float hallest_norm( float x )
+{
+    while (x >= HALLEST_EREV)
+    {
+        x = x - HALLEST_EREV;
+    }
+
+    while (x < 0.0f)
+    {
+        x = x + HALLEST_EREV;
+    }
+
+    return x;
+}
+
+void hallest_init( HALLEST * const he, uint16_t table[HALLEST_STATES][4] )
+{
+    for ( uint32_t s = 0; s < HALLEST_STATES; ++s )
+    {
+        he->enter[HALLEST_DIR_FWD][s] = (float)table[s][0];
+        he->enter[HALLEST_DIR_BWD][s] = (float)table[s][1];
+    }
+
+    // The forward successor is entered where this state ends
+    for ( uint32_t s = 0; s < HALLEST_STATES; ++s )
+    {
+        float best = HALLEST_EREV;
+
+        he->next[s] = -1;
+
+        for ( uint32_t n = 0; n < HALLEST_STATES; ++n )
+        {
+            float const d = fabsf( hallest_wrap( (float)table[n][0] - (float)table[s][1] ) );
+
+            if ((n != s) && (d < best))
+            {
+                best        = d;
+                he->next[s] = (int8_t)n;
+            }
+        }
+    }
+
+    he->t          = HALLEST_TIMEOUT;
+    he->dt         = HALLEST_TIMEOUT;
+    he->theta_edge = 0.0f;
+    he->omega      = 0.0f;
+    he->alpha      = 0.0f;
+    he->omega_avg  = 0.0f;
+    he->edges      = 0;
+
+    he->state      = -1;
+    he->T          = 0.0f;
+    he->dir        = HALLEST_DIR_FWD;
+    he->angle      = 0.0f;
+
+    he->edge_now   = false;
+    he->edge_dir   = HALLEST_DIR_FWD;
+    he->edge_state = 0;
+
+    he->cal_n      = 0;
+    he->cal_t      = 0.0f;
+    he->cal_T_prev = 0.0f;
+
+    he->eHz_lo     = 10.0f;
+    he->eHz_hi     = 30.0f;
+}
+
+static float hallest_centre( HALLEST const * const he, int const s )
+{
+    float const a = he->enter[HALLEST_DIR_FWD][s];
+    float const b = he->enter[HALLEST_DIR_BWD][s];
+
+    return hallest_norm( a + (0.5f * hallest_wrap( b - a )) );
+}
+
+static void hallest_calibrate( HALLEST * const he, uint32_t const dir )
+{
+    float const T = he->cal_t;
+
+    if (  (he->cal_T_prev > 0.0f)
+       && (fabsf( T - he->cal_T_prev ) < (HALLEST_EREV_SPREAD * T)))
+    {
+        // Constant acceleration across the erev from the change in period,
+        // with the initial speed chosen so one erev takes exactly T
+        float const w_this = HALLEST_EREV / T;
+        float const w_prev = HALLEST_EREV / he->cal_T_prev;
+        float const a      = (w_this - w_prev) / (0.5f * (T + he->cal_T_prev));
+        float const w0     = (HALLEST_EREV - (0.5f * a * T * T)) / T;
+        float const sign   = (dir == HALLEST_DIR_FWD) ? 1.0f : -1.0f;
+
+        float * const enter = he->enter[dir];
+        int   const   s0    = he->cal_state[0];
+
+        float r[HALLEST_STATES];
+        float r_mean = 0.0f;
+
+        for ( uint32_t k = 0; k < HALLEST_STATES; ++k )
+        {
+            float const tk = he->cal_time[k];
+            float const p  = enter[s0] + (sign * ((w0 * tk) + (0.5f * a * tk * tk)));
+
+            r[k]   = hallest_wrap( p - enter[he->cal_state[k]] );
+            r_mean = r_mean + r[k];
+        }
+
+        r_mean = r_mean / (float)HALLEST_STATES;
+
+        for ( uint32_t k = 0; k < HALLEST_STATES; ++k )
+        {
+            int const s = he->cal_state[k];
+
+            enter[s] = hallest_norm( enter[s] + (HALLEST_K_TIMING * (r[k] - r_mean)) );
+        }
+    }
+
+    he->cal_T_prev = T;
+}
+
+static void hallest_edge( HALLEST * const he, int const s )
+{
+    int const      last = he->state;
+    uint32_t       dir;
+
+    he->state = s;
+
+    if (last < 0)
+    {
+        he->edges = 0;
+        he->cal_n = 0;
+        he->t     = 0.0f;
+        he->angle = hallest_centre( he, s );
+        return;
+    }
+
+    if (he->next[last] == s)
+    {
+        dir = HALLEST_DIR_FWD;
+    }
+    else if (he->next[s] == last)
+    {
+        dir = HALLEST_DIR_BWD;
+    }
+    else
+    {
+        // Skipped a state; nothing can be trusted about the timing
+        he->edges = 0;
+        he->cal_n = 0;
+        he->t     = 0.0f;
+        he->angle = hallest_centre( he, s );
+        return;
+    }
+
+    float const theta = he->enter[dir][s];
+
+    he->edge_now   = true;
+    he->edge_dir   = dir;
+    he->edge_state = s;
+
+    if ((he->edges > 0) && (dir != he->dir))
+    {
+        // Reversal; the last edge is the same boundary, so no speed information
+        he->edges = 0;
+        he->cal_n = 0;
+    }
+
+    he->dir = dir;
+
+    if (he->edges == 0)
+    {
+        he->omega     = 0.0f;
+        he->alpha     = 0.0f;
+        he->omega_avg = 0.0f;
+    }
+    else
+    {
+        float const w = hallest_wrap( theta - he->theta_edge ) / he->t;
+
+        if (he->edges >= 2)
+        {
+            he->alpha = (w - he->omega_avg) / (0.5f * (he->t + he->dt));
+        }
+        else
+        {
+            he->alpha = 0.0f;
+        }
+
+        he->omega_avg = w;
+        he->omega     = w + (0.5f * he->alpha * he->t);
+    }
+
+    // Timing calibration, collect one erev of same direction edges
+    if (he->cal_n == 0)
+    {
+        he->cal_t = 0.0f;
+    }
+    else
+    {
+        he->cal_t = he->cal_t + he->t;
+    }
+
+    if ((he->cal_n == HALLEST_STATES) && (he->cal_state[0] == s))
+    {
+        hallest_calibrate( he, dir );
+        he->cal_n = 0;
+        he->cal_t = 0.0f;
+    }
+    else if (he->cal_n == HALLEST_STATES)
+    {
+        he->cal_n = 0;
+        he->cal_t = 0.0f;
+    }
+
+    he->cal_state[he->cal_n] = s;
+    he->cal_time[he->cal_n]  = he->cal_t;
+    he->cal_n = he->cal_n + 1;
+
+    he->edges      = he->edges + 1;
+    he->dt         = he->t;
+    he->t          = 0.0f;
+    he->theta_edge = theta;
+    he->angle      = theta;
+}
+
+uint16_t hallest_run( HALLEST * const he, int const hall_state, float const T )
+{
+    he->edge_now = false;
+    he->T        = T;
+
+    if ((hall_state < 1) || (hall_state > HALLEST_STATES))
+    {
+        return (uint16_t)he->angle;
+    }
+
+    int const s = hall_state - 1;
+
+    if (he->state != s)
+    {
+        if ((he->state < 0) || (he->state >= HALLEST_STATES))
+        {
+            he->state = -1;
+        }
+
+        hallest_edge( he, s );
+        return (uint16_t)he->angle;
+    }
+
+    he->t = he->t + T;
+
+    if (he->t > HALLEST_TIMEOUT)
+    {
+        // Stopped; sit in the middle of the state
+        he->t     = HALLEST_TIMEOUT;
+        he->edges = 0;
+        he->cal_n = 0;
+        he->omega = 0.0f;
+        he->alpha = 0.0f;
+        he->angle = hallest_centre( he, s );
+        return (uint16_t)he->angle;
+    }
+
+    if (he->edges < 2)
+    {
+        // One edge gives an angle but no speed yet
+        return (uint16_t)he->angle;
+    }
+
+    // Travel since the edge, held before the next edge
+    float const sign = (he->dir == HALLEST_DIR_FWD) ? 1.0f : -1.0f;
+    float const w    = sign * he->omega;
+    float const a    = sign * he->alpha;
+    float       t    = he->t;
+
+    if ((a < 0.0f) && ((w + (a * t)) < 0.0f))
+    {
+        t = -w / a;
+    }
+
+    float d = (w * t) + (0.5f * a * t * t);
+
+    // Next edge in the direction of travel
+    int exit = -1;
+
+    if (he->dir == HALLEST_DIR_FWD)
+    {
+        exit = he->next[s];
+    }
+    else
+    {
+        for ( int p = 0; p < HALLEST_STATES; ++p )
+        {
+            if (he->next[p] == s)
+            {
+                exit = p;
+            }
+        }
+    }
+
+    float width = HALLEST_EREV / (float)HALLEST_STATES;
+
+    if (exit >= 0)
+    {
+        width = hallest_wrap( he->enter[he->dir][exit] - he->theta_edge );
+    }
+
+    width = fabsf( width );
+
+    if (d > width)
+    {
+        d = width;
+    }
+    else if (d < 0.0f)
+    {
+        d = 0.0f;
+    }
+
+    he->angle = hallest_norm( he->theta_edge + (sign * d) );
+
+    return (uint16_t)he->angle;
+}
+
+float hallest_eHz( HALLEST const * const he )
+{
+    if (he->edges < 2)
+    {
+        return 0.0f;
+    }
+
+    return (he->omega + (he->alpha * he->t)) / HALLEST_EREV;
+}
+
+float hallest_blend( HALLEST const * const he, float const eHz )
+{
+    float const w = fabsf( eHz );
+
+    if (w <= he->eHz_lo)
+    {
+        return 0.0f;
+    }
+
+    if ((w >= he->eHz_hi) || (he->eHz_hi <= he->eHz_lo))
+    {
+        return 1.0f;
+    }
+
+    return (w - he->eHz_lo) / (he->eHz_hi - he->eHz_lo);
+}
+
+void hallest_observe( HALLEST * const he, uint16_t const angle )
+{
+    if (!he->edge_now)
+    {
+        return;
+    }
+
+    // The edge fell somewhere in the last period, on average half a period ago
+    float const   lag = 0.5f * he->omega_avg * he->T;
+    float * const e   = &he->enter[he->edge_dir][he->edge_state];
+
+    *e = hallest_norm( *e + (HALLEST_K_OBSERVER * hallest_wrap( ((float)angle - lag) - *e )) );
+}
@@ -0,0 +1,190 @@
+/*
+ **
+ ******************************************************************************
+ * @file           : MESChealth.c
+ * @brief          : Stack and ISR budget health statistics
+ ******************************************************************************
+ * @attention
+ *
+ * <h2><center>&copy; Copyright (c) 2020 David Molony.
+ * All rights reserved.</center></h2>
+ *
+ * This software component is licensed under BSD 3-Clause license,
+ * the "License"; You may not use this file except in compliance with the
+ * License. You may obtain a copy of the License at:
+ *                        opensource.org/licenses/BSD-3-Clause
+ *
+ ******************************************************************************
+ *In addition to the usual 3 BSD clauses, it is explicitly noted that you
+ *do NOT have the right to take sections of this code for other projects
+ *without attribution and credit to the source. Specifically, if you copy into
+ *copyleft licenced code without attribution and retention of the permissive BSD
+ *3 clause licence, you grant a perpetual licence to do the same regarding turning sections of your code
+ *permissive, and lose any rights to use of this code previously granted or assumed.
+ *
+ *This code is intended to remain permissively licensed wherever it goes,
+ *maintaining the freedom to distribute compiled binaries WITHOUT a requirement to supply source.
+ *
+ *This is to ensure this code can at any point be used commercially, on products that may require
+ *such restriction to meet regulatory requirements, or to avoid damage to hardware, or to ensure
+ *warranties can reasonably be honoured.
+ ******************************************************************************
+ */
+
+
+#include "MESChealth.h"
+
+#include <stddef.h>
+#include <string.h>
+
+void health_init( HEALTH * const h )
+{
+    memset( h, 0, sizeof(*h) );
+
+    h->stack_warn   = 32;
+    h->isr_warn     = 0.9f;
+    h->overrun_warn = 0;
+}
+
+void health_isr_reset( HEALTH_ISR * const isr )
+{
+    isr->last     = 0;
+    isr->worst    = 0;
+    isr->overruns = 0;
+    isr->samples  = 0;
+    isr->reset_req = false;
+}
+
+void health_isr_request_reset( HEALTH_ISR * const isr )
+{
+    isr->reset_req = true;
+}
+
+void health_isr_sample( HEALTH_ISR * const isr, uint32_t const cycles, uint32_t const budget )
+{
+    if (isr->reset_req)
+    {
+        health_isr_reset( isr );
+    }
+
+    isr->last = cycles;
+
+    if (cycles > isr->worst)
+    {
+        isr->worst = cycles;
+    }
+
+    // No budget until the PWM timing has been set up
+    if ((budget > 0) && (cycles > budget))
+    {
+        ++isr->overruns;
+    }
+
+    ++isr->samples;
+}
+
+void health_task_sample( HEALTH * const h, char const * const name, uint32_t const free_words )
+{
+    HEALTH_TASK * t = NULL;
+
+    for ( uint32_t i = 0; i < h->task_count; ++i )
+    {
+        if (strncmp( h->task[i].name, name, (HEALTH_NAME_LEN - 1) ) == 0)
+        {
+            t = &h->task[i];
+            break;
+        }
+    }
+
+    if (t == NULL)
+    {
+        if (h->task_count >= HEALTH_MAX_TASKS)
+        {
+            h->task_overflow = true;
+            return;
+        }
+
+        t = &h->task[h->task_count];
+        ++h->task_count;
+
+        strncpy( t->name, name, (HEALTH_NAME_LEN - 1) );
+        t->name[HEALTH_NAME_LEN - 1] = '\0';
+        t->stack_min = free_words;
+    }
+
+    if (free_words < t->stack_min)
+    {
+        t->stack_min = free_words;
+    }
+
+    t->seen = true;
+}
+
+uint32_t health_check( HEALTH * const h, HEALTH_ISR const * const isr, uint32_t const isr_count, uint32_t const budget )
+{
+    uint32_t warnings = 0;
+
+    for ( uint32_t i = 0; i < h->task_count; ++i )
+    {
+        if (h->task[i].seen && (h->task[i].stack_min < h->stack_warn))
+        {
+            warnings |= HEALTH_WARN_STACK;
+        }
+
+        h->task[i].seen = false;
+    }
+
+    if (h->task_overflow)
+    {
+        warnings |= HEALTH_WARN_TASKS;
+    }
+
+    uint32_t worst    = 0;
+    uint32_t overruns = 0;
+
+    for ( uint32_t i = 0; i < isr_count; ++i )
+    {
+        if (isr[i].worst > worst)
+        {
+            worst = isr[i].worst;
+        }
+
+        overruns = overruns + isr[i].overruns;
+    }
+
+    if ((budget > 0) && ((float)worst > (h->isr_warn * (float)budget)))
+    {
+        warnings |= HEALTH_WARN_ISR;
+    }
+
+    // Totals only grow unless an ISR record is reset underneath us
+    h->overruns_new = (overruns >= h->overruns) ? (overruns - h->overruns) : overruns;
+
+    if (h->overruns_new > h->overrun_warn)
+    {
+        warnings |= HEALTH_WARN_OVERRUN;
+    }
+
+    h->budget    = budget;
+    h->isr_worst = worst;
+    h->overruns  = overruns;
+    h->warnings  = warnings;
+    ++h->checks;
+
+    return warnings;
+}
+
+HEALTH_TASK const * health_lowest_stack( HEALTH const * const h )
+{
+    HEALTH_TASK const * lowest = NULL;
+
+    for ( uint32_t i = 0; i < h->task_count; ++i )
+    {
+        if ((lowest == NULL) || (h->task[i].stack_min < lowest->stack_min))
+        {
+            lowest = &h->task[i];
+        }
+    }
+
+    return lowest;
+}
@@ -0,0 +1,436 @@
+/*
+ **
+ ******************************************************************************
+ * @file           : MESCimu.c
+ * @brief          : MPU6050 FIFO burst driver and attitude filter
+ ******************************************************************************
+ * @attention
+ *
+ * <h2><center>&copy; Copyright (c) 2020 David Molony.
+ * All rights reserved.</center></h2>
+ *
+ * This software component is licensed under BSD 3-Clause license,
+ * the "License"; You may not use this file except in compliance with the
+ * License. You may obtain a copy of the License at:
+ *                        opensource.org/licenses/BSD-3-Clause
+ *
+ ******************************************************************************
+ *In addition to the usual 3 BSD clauses, it is explicitly noted that you
+ *do NOT have the right to take sections of this code for other projects
+ *without attribution and credit to the source. Specifically, if you copy into
+ *copyleft licenced code without attribution and retention of the permissive BSD
+ *3 clause licence, you grant a perpetual licence to do the same regarding turning sections of your code
+ *permissive, and lose any rights to use of this code previously granted or assumed.
+ *
+ *This code is intended to remain permissively licensed wherever it goes,
+ *maintaining the freedom to distribute compiled binaries WITHOUT a requirement to supply source.
+ *
+ *This is to ensure this code can at any point be used commercially, on products that may require
+ *such restriction to meet regulatory requirements, or to avoid damage to hardware, or to ensure
+ *warranties can reasonably be honoured.
+ ******************************************************************************
+ */
+
+
+
+
+
+#include "MESCimu.h"
+
+#include <math.h>
+#include <string.h>
+
+#define IMU_PI 3.14159265f
+#define IMU_G  9.80665f
+
+static float imu_invsqrt( float const x )
+{
+	return (x > 0.0f) ? (1.0f / sqrtf( x )) : 0.0f;
+}
+
+void imu_att_init( IMUAtt * const att, float const beta )
+{
+	att->beta = beta;
+	att->q[0] = 1.0f;
+	att->q[1] = 0.0f;
+	att->q[2] = 0.0f;
+	att->q[3] = 0.0f;
+	att->roll = 0.0f;
+	att->pitch = 0.0f;
+	att->init = false;
+}
+
+void imu_init( IMU * const imu, IMUBus const * const bus )
+{
+	memset( imu, 0, sizeof(*imu) );
+	imu->bus = *bus;
+	imu->odr = IMU_ODR_DEFAULT;
+	imu->acc_scale = 1.0f / 4096.0f;                   // +-8g
+	imu->gyr_scale = (IMU_PI / 180.0f) / 32.8f;         // +-1000deg/s
+	imu->phase = IMU_IDLE;
+	imu_att_init( &imu->att, IMU_BETA_DEFAULT );
+}
+
+int imu_config( IMU * const imu, float const odr )
+{
+	float div = roundf( (1000.0f / odr) - 1.0f );
+
+	if (div < 0.0f)
+	{
+		div = 0.0f;
+	}
+	else if (div > 255.0f)
+	{
+		div = 255.0f;
+	}
+
+	imu->odr = 1000.0f / (div + 1.0f);
+
+	uint8_t const reg[] = { MPU_REG_PWR_MGMT_1, MPU_REG_CONFIG, MPU_REG_SMPLRT_DIV, MPU_REG_GYRO_CONFIG,
+	                        MPU_REG_ACCEL_CONFIG, MPU_REG_FIFO_EN, MPU_REG_INT_ENABLE, MPU_REG_USER_CTRL };
+	uint8_t const val[] = { 0x01,                      // Clock from the X gyro PLL
+	                        0x03,                      // DLPF 44Hz, 1kHz internal rate
+	                        (uint8_t)div,
+	                        0x10,                      // +-1000deg/s
+	                        0x10,                      // +-8g
+	                        0x78,                      // Accel and XYZ gyro into the FIFO
+	                        0x01,                      // Data ready interrupt
+	                        0x44 };                    // FIFO enable and reset
+
+	for (uint32_t i = 0; i < sizeof(reg); i++)
+	{
+		int const ret = imu->bus.write( imu->bus.ctx, reg[i], val[i] );
+
+		if (ret != 0)
+		{
+			imu->errors++;
+			return ret;
+		}
+	}
+
+	imu->stamped = false;
+	imu->acc_scale = 1.0f / 4096.0f;
+	imu->gyr_scale = (IMU_PI / 180.0f) / 32.8f;
+
+	return 0;
+}
+
+static void imu_fifo_reset( IMU * const imu )
+{
+	imu->overflows++;
+	imu->stamped = false; // Samples were lost, so the next burst restarts the stamps
+
+	if (imu->bus.write( imu->bus.ctx, MPU_REG_USER_CTRL, 0x44 ) != 0)
+	{
+		imu->errors++;
+	}
+}
+
+bool imu_start( IMU * const imu, uint32_t const now )
+{
+	if (imu->phase != IMU_IDLE)
+	{
+		return false;
+	}
+
+	imu->t_req = now;
+	imu->phase = IMU_COUNT;
+
+	if (imu->bus.read( imu->bus.ctx, MPU_REG_FIFO_COUNTH, imu->buf, 2 ) != 0)
+	{
+		imu->phase = IMU_IDLE;
+		imu->errors++;
+		return false;
+	}
+
+	return true;
+}
+
+void imu_rx_done( IMU * const imu )
+{
+	switch (imu->phase)
+	{
+		case IMU_COUNT:
+		{
+			uint32_t const count = ((uint32_t)imu->buf[0] << 8) | imu->buf[1];
+
+			imu->phase = IMU_IDLE;
+
+			if ((count >= MPU_FIFO_SIZE) || ((count % IMU_FRAME) != 0))
+			{
+				// Full, or a frame was cut by an overflow
+				imu_fifo_reset( imu );
+				break;
+			}
+
+			uint32_t n = count / IMU_FRAME;
+
+			imu->behind = 0;
+
+			if (n > IMU_BURST)
+			{
+				imu->behind = (uint16_t)(n - IMU_BURST); // Still there for the next burst, and newer than these
+				n = IMU_BURST;
+			}
+
+			if (n == 0)
+			{
+				break;
+			}
+
+			imu->pending = (uint16_t)(n * IMU_FRAME);
+			imu->phase = IMU_DATA;
+
+			if (imu->bus.read( imu->bus.ctx, MPU_REG_FIFO_R_W, imu->buf, imu->pending ) != 0)
+			{
+				imu->phase = IMU_IDLE;
+				imu->errors++;
+			}
+			break;
+		}
+		case IMU_DATA:
+			imu->phase = IMU_IDLE;
+			imu_parse( imu, imu->buf, imu->pending / IMU_FRAME,
+			           imu->t_req - (uint32_t)lroundf( (float)imu->behind * 1.0e6f / imu->odr ) );
+			break;
+		case IMU_IDLE:
+		default:
+			break;
+	}
+}
+
+void imu_rx_error( IMU * const imu )
+{
+	imu->errors++;
+	imu->phase = IMU_IDLE;
+}
+
+uint32_t imu_available( IMU const * const imu )
+{
+	return imu->head - imu->tail;
+}
+
+bool imu_pop( IMU * const imu, IMUSample * const s )
+{
+	if (imu->head == imu->tail)
+	{
+		return false;
+	}
+
+	*s = imu->ring[imu->tail & (IMU_RING - 1)];
+	imu->tail++;
+
+	return true;
+}
+
+static int16_t imu_be16( uint8_t const * const p )
+{
+	return (int16_t)(((uint16_t)p[0] << 8) | p[1]);
+}
+
+void imu_parse( IMU * const imu, uint8_t const * const data, uint32_t const n, uint32_t const t )
+{
+	if (n == 0)
+	{
+		return;
+	}
+
+	float const period = 1.0e6f / imu->odr;
+	float newest = 0.0f; // us after base
+	float step = period;
+	uint32_t base = t;
+
+	if (imu->stamped)
+	{
+		// The newest frame was taken within a period before t; keep to the sample clock inside that
+		float const span = (float)(int32_t)(t - imu->t_last);
+
+		newest = (float)n * period;
+
+		if (newest > span)
+		{
+			newest = span;
+		}
+		else if (newest < (span - period))
+		{
+			newest = span - period;
+		}
+
+		base = imu->t_last;
+		step = newest / (float)n;
+	}
+
+	for (uint32_t i = 0; i < n; i++)
+	{
+		uint8_t const * const f = &data[i * IMU_FRAME];
+		IMUSample * const s = &imu->ring[imu->head & (IMU_RING - 1)];
+
+		if ((imu->head - imu->tail) >= IMU_RING)
+		{
+			imu->tail++; // Drop the oldest
+			imu->dropped++;
+		}
+
+		s->t = base + (uint32_t)(int32_t)lroundf( newest - (float)(n - 1 - i) * step );
+
+		for (uint32_t k = 0; k < 3; k++)
+		{
+			s->acc[k] = (float)imu_be16( &f[2 * k] ) * imu->acc_scale;
+			s->gyr[k] = (float)imu_be16( &f[6 + 2 * k] ) * imu->gyr_scale;
+		}
+
+		imu->head++;
+	}
+
+	imu->t_last = imu->ring[(imu->head - 1) & (IMU_RING - 1)].t;
+	imu->stamped = true;
+	imu->samples += n;
+}
+
+static void imu_att_seed( IMUAtt * const att, float const * const a )
+{
+	float const roll = atan2f( a[1], a[2] );
+	float const pitch = atan2f( -a[0], sqrtf( a[1] * a[1] + a[2] * a[2] ) );
+	float const cr = cosf( 0.5f * roll );
+	float const sr = sinf( 0.5f * roll );
+	float const cp = cosf( 0.5f * pitch );
+	float const sp = sinf( 0.5f * pitch );
+
+	att->q[0] = cr * cp;
+	att->q[1] = sr * cp;
+	att->q[2] = cr * sp;
+	att->q[3] = -sr * sp;
+	att->init = true;
+}
+
+void imu_att_update( IMUAtt * const att, IMUSample const * const s, float const dt )
+{
+	float ax = s->acc[0];
+	float ay = s->acc[1];
+	float az = s->acc[2];
+	float const gx = s->gyr[0];
+	float const gy = s->gyr[1];
+	float const gz = s->gyr[2];
+
+	float const anorm = imu_invsqrt( ax * ax + ay * ay + az * az );
+
+	if (!att->init && (anorm > 0.0f))
+	{
+		imu_att_seed( att, s->acc );
+	}
+
+	float q0 = att->q[0];
+	float q1 = att->q[1];
+	float q2 = att->q[2];
+	float q3 = att->q[3];
+
+	// Rate of change from the gyro
+	float qd0 = 0.5f * (-q1 * gx - q2 * gy - q3 * gz);
+	float qd1 = 0.5f * ( q0 * gx + q2 * gz - q3 * gy);
+	float qd2 = 0.5f * ( q0 * gy - q1 * gz + q3 * gx);
+	float qd3 = 0.5f * ( q0 * gz + q1 * gy - q2 * gx);
+
+	if (anorm > 0.0f)
+	{
+		ax *= anorm;
+		ay *= anorm;
+		az *= anorm;
+
+		// Gradient of the error between the measured and estimated gravity
+		float const _2q0 = 2.0f * q0;
+		float const _2q1 = 2.0f * q1;
+		float const _2q2 = 2.0f * q2;
+		float const _2q3 = 2.0f * q3;
+		float const _4q0 = 4.0f * q0;
+		float const _4q1 = 4.0f * q1;
+		float const _4q2 = 4.0f * q2;
+		float const _8q1 = 8.0f * q1;
+		float const _8q2 = 8.0f * q2;
+		float const q0q0 = q0 * q0;
+		float const q1q1 = q1 * q1;
+		float const q2q2 = q2 * q2;
+		float const q3q3 = q3 * q3;
+
+		float s0 = _4q0 * q2q2 + _2q2 * ax + _4q0 * q1q1 - _2q1 * ay;
+		float s1 = _4q1 * q3q3 - _2q3 * ax + 4.0f * q0q0 * q1 - _2q0 * ay - _4q1 + _8q1 * q1q1 + _8q1 * q2q2 + _4q1 * az;
+		float s2 = 4.0f * q0q0 * q2 + _2q0 * ax + _4q2 * q3q3 - _2q3 * ay - _4q2 + _8q2 * q1q1 + _8q2 * q2q2 + _4q2 * az;
+		float s3 = 4.0f * q1q1 * q3 - _2q1 * ax + 4.0f * q2q2 * q3 - _2q2 * ay;
+
+		float const snorm = imu_invsqrt( s0 * s0 + s1 * s1 + s2 * s2 + s3 * s3 );
+
+		qd0 -= att->beta * s0 * snorm;
+		qd1 -= att->beta * s1 * snorm;
+		qd2 -= att->beta * s2 * snorm;
+		qd3 -= att->beta * s3 * snorm;
+	}
+
+	q0 += qd0 * dt;
+	q1 += qd1 * dt;
+	q2 += qd2 * dt;
+	q3 += qd3 * dt;
+
+	float const qnorm = imu_invsqrt( q0 * q0 + q1 * q1 + q2 * q2 + q3 * q3 );
+
+	att->q[0] = q0 * qnorm;
+	att->q[1] = q1 * qnorm;
+	att->q[2] = q2 * qnorm;
+	att->q[3] = q3 * qnorm;
+
+	q0 = att->q[0];
+	q1 = att->q[1];
+	q2 = att->q[2];
+	q3 = att->q[3];
+
+	float sp = 2.0f * (q0 * q2 - q1 * q3);
+
+	if (sp > 1.0f)
+	{
+		sp = 1.0f;
+	}
+	else if (sp < -1.0f)
+	{
+		sp = -1.0f;
+	}
+
+	att->roll = atan2f( 2.0f * (q0 * q1 + q2 * q3), 1.0f - 2.0f * (q1 * q1 + q2 * q2) );
+	att->pitch = asinf( sp );
+}
+
+uint32_t imu_process( IMU * const imu )
+{
+	uint32_t n = 0;
+	IMUSample s;
+
+	while (imu_pop( imu, &s ))
+	{
+		float dt = 1.0f / imu->odr;
+
+		if (n > 0 || imu->att.init)
+		{
+			int32_t const d = (int32_t)(s.t - imu->last.t);
+
+			if ((d > 0) && ((float)d < 10.0e6f / imu->odr))
+			{
+				dt = (float)d * 1.0e-6f;
+			}
+		}
+
+		for (uint32_t k = 0; k < 3; k++)
+		{
+			s.gyr[k] -= imu->gyr_bias[k];
+		}
+
+		// The filter sees gravity alone; last keeps the specific force
+		IMUSample g = s;
+		float const a = imu->a_fwd / IMU_G;
+
+		g.acc[0] -= a * cosf( imu->att.pitch );
+		g.acc[2] -= a * sinf( imu->att.pitch );
+
+		imu_att_update( &imu->att, &g, dt );
+		imu->last = s;
+		n++;
+	}
+
+	return n;
+}
@@ -0,0 +1,189 @@
+/*
+ **
+ ******************************************************************************
+ * @file           : MESCinfilt.c
+ * @brief          : Per source input filtering and arbitration
+ ******************************************************************************
+ * @attention
+ *
+ * <h2><center>&copy; Copyright (c) 2020 David Molony.
+ * All rights reserved.</center></h2>
+ *
+ * This software component is licensed under BSD 3-Clause license,
+ * the "License"; You may not use this file except in compliance with the
+ * License. You may obtain a copy of the License at:
+ *                        opensource.org/licenses/BSD-3-Clause
+ *
+ ******************************************************************************
+ *In addition to the usual 3 BSD clauses, it is explicitly noted that you
+ *do NOT have the right to take sections of this code for other projects
+ *without attribution and credit to the source. Specifically, if you copy into
+ *copyleft licenced code without attribution and retention of the permissive BSD
+ *3 clause licence, you grant a perpetual licence to do the same regarding turning sections of your code
+ *permissive, and lose any rights to use of this code previously granted or assumed.
+ *
+ *This code is intended to remain permissively licensed wherever it goes,
+ *maintaining the freedom to distribute compiled binaries WITHOUT a requirement to supply source.
+ *
+ *This is to ensure this code can at any point be used commercially, on products that may require
+ *such restriction to meet regulatory requirements, or to avoid damage to hardware, or to ensure
+ *warranties can reasonably be honoured.
+ ******************************************************************************
+ */
+
+
+
+
+
+#include "MESCinfilt.h"
+
+#include <math.h>
+
+static float infilt_median3( float const a, float const b, float const c )
+{
+	return fmaxf( fminf( a, b ), fminf( fmaxf( a, b ), c ) );
+}
+
+static float infilt_deadband( float const x, float const d )
+{
+	if (d <= 0.0f)
+	{
+		return x;
+	}
+
+	float const m = fmaxf( (fabsf( x ) - d), 0.0f ) / (1.0f - d);
+
+	return (x < 0.0f) ? -m : m;
+}
+
+void infilt_init( INFILT * const f )
+{
+	f->median    = false;
+	f->tau       = 0.0f;
+	f->deadband  = 0.0f;
+	f->rate_up   = 0.0f;
+	f->rate_down = 0.0f;
+	f->timeout   = INFILT_TIMEOUT;
+	f->priority  = 0;
+
+	infilt_reset( f );
+}
+
+void infilt_reset( INFILT * const f )
+{
+	f->hist[0] = 0.0f;
+	f->hist[1] = 0.0f;
+	f->hist[2] = 0.0f;
+	f->n       = 0;
+	f->y       = 0.0f;
+	f->out     = 0.0f;
+	f->age     = 0.0f;
+	f->fault   = false;
+}
+
+float infilt_run( INFILT * const f, float const x, bool const valid, float const T )
+{
+	if (!valid)
+	{
+		f->age = f->age + T;
+
+		// On the sample nearest the timeout
+		if ((f->age + (0.5f * T)) >= f->timeout)
+		{
+			infilt_reset( f );
+			f->age   = f->timeout;
+			f->fault = true;
+		}
+
+		return f->out;
+	}
+
+	f->age = 0.0f;
+
+	float v = x;
+
+	if (f->median)
+	{
+		f->hist[2] = f->hist[1];
+		f->hist[1] = f->hist[0];
+		f->hist[0] = x;
+
+		if (f->n < 3)
+		{
+			f->n++;
+		}
+
+		// Until the history fills, the newest sample stands
+		if (f->n == 3)
+		{
+			v = infilt_median3( f->hist[0], f->hist[1], f->hist[2] );
+		}
+	}
+
+	if (f->tau > 0.0f)
+	{
+		f->y = f->y + ((T / (f->tau + T)) * (v - f->y));
+	}
+	else
+	{
+		f->y = v;
+	}
+
+	float const target = infilt_deadband( f->y, f->deadband );
+
+	if (f->fault)
+	{
+		// Released only through zero
+		if (target != 0.0f)
+		{
+			return f->out;
+		}
+
+		f->fault = false;
+	}
+
+	// Reversing counts as shrinking, all the way through zero
+	float const step    = target - f->out;
+	bool  const growing = ((target * f->out) >= 0.0f) && (fabsf( target ) > fabsf( f->out ));
+	float const rate    = growing ? f->rate_up : f->rate_down;
+
+	if (rate > 0.0f)
+	{
+		float const lim = rate * T;
+
+		f->out = f->out + fminf( fmaxf( step, -lim ), lim );
+	}
+	else
+	{
+		f->out = target;
+	}
+
+	return f->out;
+}
+
+float infilt_complementary( float const n1, float const n2, bool * const valid )
+{
+	*valid = (fabsf( (n1 + n2) - 1.0f ) <= INFILT_DIFF_TOL);
+
+	return fminf( fmaxf( (0.5f * ((n1 - n2) + 1.0f)), 0.0f ), 1.0f );
+}
+
+int32_t infilt_arbitrate( INFILT const * const f, uint32_t const n )
+{
+	int32_t best = -1;
+
+	for (uint32_t i = 0; i < n; i++)
+	{
+		if (f[i].fault || (f[i].out == 0.0f))
+		{
+			continue;
+		}
+
+		if ((best < 0) || (f[i].priority > f[best].priority))
+		{
+			best = (int32_t)i;
+		}
+	}
+
+	return best;
+}
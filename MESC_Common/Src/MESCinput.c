@@ -82,6 +82,13 @@ void MESCinput_Init(MESC_motor_typedef *_motor){
 	_motor->input_vars.RCPWM_req = 0.0f;
 	_motor->input_vars.ADC1_req = 0.0f;
 	_motor->input_vars.ADC2_req = 0.0f;
+
+	//Filter chains, kept when already configured since this reruns on every parameter change
+	for(int i = 0; i<INFILT_SOURCES; i++){
+		if(_motor->input_vars.filt[i].timeout <= 0.0f){
+			infilt_init(&_motor->input_vars.filt[i]);
+		}
+	}
 }
 
 void MESCinput_Collect(MESC_motor_typedef *_motor){
@@ -93,106 +100,101 @@ void MESCinput_Collect(MESC_motor_typedef *_motor){
 	  if(_motor->input_vars.remote_ADC_timeout > 0){
 		  _motor->input_vars.remote_ADC_timeout--;
 	  }else{
-		  _motor->input_vars.remote_ADC1_req = 0.0f;
-		  _motor->input_vars.remote_ADC2_req = 0.0f;
-	  }
-
-	  //Collect the requested throttle inputs
-
-	  //Remote ADC1 input
-	  if((_motor->input_vars.input_options & 0b100000)&&(_motor->input_vars.remote_ADC_can_id > 0)){
-		  	  //Do nothing. Already set
-	  }else{
-		  _motor->input_vars.remote_ADC1_req = 0.0f;//Set the input variable to zero
+		  _motor->input_vars.remote_ADC1_raw = 0.0f;
+		  _motor->input_vars.remote_ADC2_raw = 0.0f;
 	  }
 
-	  //Remote ADC2 input
-	  if((_motor->input_vars.input_options & 0b1000000)&&(_motor->input_vars.remote_ADC_can_id > 0)){
-		  //Do nothing, already set
-	  }else{
-		  _motor->input_vars.remote_ADC2_req = 0.0f;//Set the input variable to zero
-	  }
-
-	  //Differential ADC12 input
-	  if((_motor->input_vars.input_options & 0b10000000)){
-		  //TBC, Math and logic required
-		  //To be filled, as signal = ext1-ext2 with error check based on ext1+ext2
-	  }else{
-		  _motor->input_vars.ADC12_diff_req = 0.0f; //Set the input variable to zero
+	  //Collect the requested throttle inputs, each normalised with whether the sample can be trusted
+	  float x[INFILT_SOURCES] = {0.0f};
+	  bool valid[INFILT_SOURCES] = {false};
+	  bool enabled[INFILT_SOURCES] = {false};
+
+	  //Remote ADC inputs, set elsewhere from the CAN data received
+	  enabled[INFILT_SRC_REMOTE1] = (_motor->input_vars.input_options & 0b100000)&&(_motor->input_vars.remote_ADC_can_id > 0);
+	  enabled[INFILT_SRC_REMOTE2] = (_motor->input_vars.input_options & 0b1000000)&&(_motor->input_vars.remote_ADC_can_id > 0);
+	  x[INFILT_SRC_REMOTE1] = _motor->input_vars.remote_ADC1_raw;
+	  x[INFILT_SRC_REMOTE2] = _motor->input_vars.remote_ADC2_raw;
+	  valid[INFILT_SRC_REMOTE1] = (_motor->input_vars.remote_ADC_timeout > 0);
+	  valid[INFILT_SRC_REMOTE2] = (_motor->input_vars.remote_ADC_timeout > 0);
+
+	  //Differential ADC12 input, complementary tracks on ext1 rising and ext2 falling
+	  enabled[INFILT_SRC_DIFF] = (_motor->input_vars.input_options & 0b10000000);
+	  if(enabled[INFILT_SRC_DIFF]){
+		  float n1 = ((float)_motor->Raw.ADC_in_ext1-(float)_motor->input_vars.adc1_MIN)*_motor->input_vars.adc1_gain[1];
+		  float n2 = ((float)_motor->Raw.ADC_in_ext2-(float)_motor->input_vars.adc2_MIN)*_motor->input_vars.adc2_gain[1];
+		  x[INFILT_SRC_DIFF] = infilt_complementary(n1, n2, &valid[INFILT_SRC_DIFF]);
+		  if(!valid[INFILT_SRC_DIFF]){
+			  handleError(_motor, ERROR_INPUT_OOR);
+		  }
 	  }
 
-	  //UART input
+	  //UART input, in amps and not filtered; the terminal and measurements drive it directly
 	  if(0 == (_motor->input_vars.input_options & 0b1000)){
 		  _motor->input_vars.UART_req = 0.0f;
 	  }
 
 	  //RCPWM input
-	  if(_motor->input_vars.input_options & 0b0100){
-		  if(_motor->input_vars.pulse_recieved){
-			  if((_motor->input_vars.IC_duration > _motor->input_vars.IC_duration_MIN) && (_motor->input_vars.IC_duration < _motor->input_vars.IC_duration_MAX)){
-				  if(_motor->input_vars.IC_pulse>(_motor->input_vars.IC_pulse_MID + _motor->input_vars.IC_pulse_DEADZONE)){
-					  _motor->input_vars.RCPWM_req = (float)(_motor->input_vars.IC_pulse - (_motor->input_vars.IC_pulse_MID + _motor->input_vars.IC_pulse_DEADZONE))*_motor->input_vars.RCPWM_gain[0][1];
-					  if(fabsf(_motor->input_vars.RCPWM_req>1.1f)){
-						  handleError(_motor, ERROR_INPUT_OOR);
-					  }
-					  if(_motor->input_vars.RCPWM_req>1.0f){_motor->input_vars.RCPWM_req=1.0f;}
-					  if(_motor->input_vars.RCPWM_req<-1.0f){_motor->input_vars.RCPWM_req=-1.0f;}
-				  }
-				  else if(_motor->input_vars.IC_pulse<(_motor->input_vars.IC_pulse_MID - _motor->input_vars.IC_pulse_DEADZONE)){
-					  _motor->input_vars.RCPWM_req = ((float)_motor->input_vars.IC_pulse - (float)(_motor->input_vars.IC_pulse_MID - _motor->input_vars.IC_pulse_DEADZONE))*_motor->input_vars.RCPWM_gain[0][1];
-					  if(fabsf(_motor->input_vars.RCPWM_req>1.1f)){
-						  handleError(_motor, ERROR_INPUT_OOR);
-					  }
-					  if(_motor->input_vars.RCPWM_req>1.0f){_motor->input_vars.RCPWM_req=1.0f;}
-					  if(_motor->input_vars.RCPWM_req<-1.0f){_motor->input_vars.RCPWM_req=-1.0f;}
-				  } else{
-					  _motor->input_vars.RCPWM_req = 0.0f;
-				  }
-			  }	else {//The duration of the IC was wrong; trap it and write no current request
-				  //Todo maybe want to implement a timeout on this, allowing spurious pulses to not wiggle the current?
-				  _motor->input_vars.RCPWM_req = 0.0f;
-			  }
-		  } else {//No pulse received flag
-			  _motor->input_vars.RCPWM_req = 0.0f;
+	  enabled[INFILT_SRC_RCPWM] = (_motor->input_vars.input_options & 0b0100);
+	  if(enabled[INFILT_SRC_RCPWM]){
+		  valid[INFILT_SRC_RCPWM] = _motor->input_vars.pulse_recieved &&
+				  (_motor->input_vars.IC_duration > _motor->input_vars.IC_duration_MIN) && (_motor->input_vars.IC_duration < _motor->input_vars.IC_duration_MAX);
+		  if(_motor->input_vars.IC_pulse>(_motor->input_vars.IC_pulse_MID + _motor->input_vars.IC_pulse_DEADZONE)){
+			  x[INFILT_SRC_RCPWM] = (float)(_motor->input_vars.IC_pulse - (_motor->input_vars.IC_pulse_MID + _motor->input_vars.IC_pulse_DEADZONE))*_motor->input_vars.RCPWM_gain[0][0];
+		  }else if(_motor->input_vars.IC_pulse<(_motor->input_vars.IC_pulse_MID - _motor->input_vars.IC_pulse_DEADZONE)){
+			  x[INFILT_SRC_RCPWM] = ((float)_motor->input_vars.IC_pulse - (float)(_motor->input_vars.IC_pulse_MID - _motor->input_vars.IC_pulse_DEADZONE))*_motor->input_vars.RCPWM_gain[0][1];
+		  }
+		  if(valid[INFILT_SRC_RCPWM] && (fabsf(x[INFILT_SRC_RCPWM])>1.1f)){
+			  handleError(_motor, ERROR_INPUT_OOR);
 		  }
-	  } else{
-		  _motor->input_vars.RCPWM_req = 0.0f;
 	  }
 
 	  //ADC2 input
-	  if(_motor->input_vars.input_options & 0b0010){
-			  if(_motor->Raw.ADC_in_ext2>_motor->input_vars.adc2_MIN){
-				  _motor->input_vars.ADC2_req = ((float)_motor->Raw.ADC_in_ext2-(float)_motor->input_vars.adc2_MIN)*_motor->input_vars.adc2_gain[1]*_motor->input_vars.ADC2_polarity;
-				  if(_motor->Raw.ADC_in_ext2>_motor->input_vars.adc2_OOR){
-					  //input_vars.ADC2_req = 0.0f;
-					  handleError(_motor, ERROR_INPUT_OOR);
-				  }
-			  }
-			  else{
-				  _motor->input_vars.ADC2_req = 0.0f;
-			  }
-			  if(_motor->input_vars.ADC2_req>1.0f){_motor->input_vars.ADC2_req=1.0f;}
-			  if(_motor->input_vars.ADC2_req<-1.0f){_motor->input_vars.ADC2_req=-1.0f;}
-	  }else{
-		  _motor->input_vars.ADC2_req = 0.0f;
+	  enabled[INFILT_SRC_ADC2] = (_motor->input_vars.input_options & 0b0010);
+	  if(enabled[INFILT_SRC_ADC2]){
+		  if(_motor->Raw.ADC_in_ext2>_motor->input_vars.adc2_MIN){
+			  x[INFILT_SRC_ADC2] = ((float)_motor->Raw.ADC_in_ext2-(float)_motor->input_vars.adc2_MIN)*_motor->input_vars.adc2_gain[1]*_motor->input_vars.ADC2_polarity;
+		  }
+		  //Out of range is a broken wire or short, not full throttle
+		  valid[INFILT_SRC_ADC2] = (_motor->Raw.ADC_in_ext2<=_motor->input_vars.adc2_OOR);
+		  if(!valid[INFILT_SRC_ADC2]){
+			  handleError(_motor, ERROR_INPUT_OOR);
+		  }
 	  }
 
 	  //ADC1 input
-	  if(_motor->input_vars.input_options & 0b0001){
-			  if(_motor->Raw.ADC_in_ext1>_motor->input_vars.adc1_MIN){
-				  _motor->input_vars.ADC1_req = ((float)_motor->Raw.ADC_in_ext1-(float)_motor->input_vars.adc1_MIN)*_motor->input_vars.adc1_gain[1]*_motor->input_vars.ADC1_polarity;
-				  if(_motor->Raw.ADC_in_ext1>_motor->input_vars.adc1_OOR){
-					  //input_vars.ADC1_req = 0.0f;//If we set throttle to zero, it will immediately reset the error!
-					  handleError(_motor, ERROR_INPUT_OOR);
-				  }
-			  }
-			  else{
-				  _motor->input_vars.ADC1_req = 0.0f;
+	  enabled[INFILT_SRC_ADC1] = (_motor->input_vars.input_options & 0b0001);
+	  if(enabled[INFILT_SRC_ADC1]){
+		  if(_motor->Raw.ADC_in_ext1>_motor->input_vars.adc1_MIN){
+			  x[INFILT_SRC_ADC1] = ((float)_motor->Raw.ADC_in_ext1-(float)_motor->input_vars.adc1_MIN)*_motor->input_vars.adc1_gain[1]*_motor->input_vars.ADC1_polarity;
+		  }
+		  valid[INFILT_SRC_ADC1] = (_motor->Raw.ADC_in_ext1<=_motor->input_vars.adc1_OOR);
+		  if(!valid[INFILT_SRC_ADC1]){
+			  //The output is held then zeroed by the filter, rather than the error clearing itself on a zero throttle
+			  handleError(_motor, ERROR_INPUT_OOR);
+		  }
+	  }
+
+	  //Run each source through its filter chain
+	  float * const req[INFILT_SOURCES] = {
+			  &_motor->input_vars.ADC1_req, &_motor->input_vars.ADC2_req, &_motor->input_vars.RCPWM_req,
+			  &_motor->input_vars.remote_ADC1_req, &_motor->input_vars.remote_ADC2_req, &_motor->input_vars.ADC12_diff_req};
+	  for(int i = 0; i<INFILT_SOURCES; i++){
+		  if(enabled[i]){
+			  *req[i] = infilt_run(&_motor->input_vars.filt[i], clamp(x[i], -1.0f, 1.0f), valid[i], 1.0f/(float)SLOW_LOOP_FREQUENCY);
+		  }else{
+			  infilt_reset(&_motor->input_vars.filt[i]);
+			  *req[i] = 0.0f;
+		  }
+	  }
+
+	  //Arbitrate; the consumers sum the requests, so the losers are zeroed
+	  if(_motor->input_vars.arb_mode == INFILT_ARB_PRIORITY){
+		  int32_t winner = infilt_arbitrate(_motor->input_vars.filt, INFILT_SOURCES);
+		  for(int i = 0; i<INFILT_SOURCES; i++){
+			  if(i != winner){
+				  *req[i] = 0.0f;
 			  }
-		  if(_motor->input_vars.ADC1_req>1.0f){_motor->input_vars.ADC1_req=1.0f;}
-		  if(_motor->input_vars.ADC1_req<-1.0f){_motor->input_vars.ADC1_req=-1.0f;}
-	  }else{
-		  _motor->input_vars.ADC1_req = 0.0f;
+		  }
 	  }
 
 #ifdef KILLSWITCH_GPIO
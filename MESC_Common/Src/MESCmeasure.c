@@ -34,6 +34,7 @@
 #include "MESCmeasure.h"
 #include "MESCpwm.h"
 #include "MESCfluxobs.h"
+#include "MESCerror.h"
 
  void MESCmeasure_RL(MESC_motor_typedef *_motor) {
 	 switch(_motor->meas.state) {
@@ -41,6 +42,7 @@
 	 		_motor->meas.state = MEAS_STATE_INIT;
 	 		_motor->FOC.PLL_int = 0.0f;
 	 		_motor->FOC.PLL_angle = 0;
+	 		apll_reset(&_motor->apll, 0);
 	 		break;
 	 	 case MEAS_STATE_INIT:
 			_motor->meas.previous_HFI_type = _motor->HFI.Type;
@@ -503,6 +505,7 @@ void MESCmeasure_GetHallTable(MESC_motor_typedef *_motor) {
           _motor->m.hall_table[i][0] = _motor->m.hall_table[i][2]-_motor->m.hall_table[i][3]/2;//This is the start angle of the hall state
           _motor->m.hall_table[i][1] = _motor->m.hall_table[i][2]+_motor->m.hall_table[i][3]/2;//This is the end angle of the hall state
     }
+    hallest_init(&_motor->hallest, _motor->m.hall_table); //Restart the learned edges from the new table
     _motor->MotorState = MOTOR_STATE_TRACKING;
     _motor->FOC.Idq_req.d = 0;
     _motor->FOC.Idq_req.q = 0;
@@ -512,6 +515,33 @@ void MESCmeasure_GetHallTable(MESC_motor_typedef *_motor) {
   }
 }
 
+void MESCmeasure_EncoderCal(MESC_motor_typedef *_motor) {
+	//Started with encoder_cal_start and MOTOR_STATE_ALIGN; the d axis current drags the rotor
+	//round while the encoder works out its direction, pole pairs and offset, see MESCencoder.h
+	ENCODER * const enc = &_motor->encoder;
+
+	if ((enc->cal.phase == ENCODER_CAL_ALIGN) && (enc->cal.t == 0.0f)) {
+		MESCpwm_generateEnable(_motor);
+	}
+
+	_motor->FOC.FOCAngle = encoder_cal_run(enc, _motor->FOC.pwm_period);
+	_motor->FOC.Idq_req.d = _motor->meas.measure_current;
+	_motor->FOC.Idq_req.q = 0.0f;
+
+	if ((enc->cal.phase == ENCODER_CAL_DONE) || (enc->cal.phase == ENCODER_CAL_IDLE)) {
+		_motor->FOC.Idq_req.d = 0.0f;
+		if (enc->cal.result == ENCODER_CAL_OK) {
+			_motor->m.pole_pairs = enc->pole_pairs;
+			encoderStore(_motor);
+			_motor->MotorState = MOTOR_STATE_TRACKING;
+		} else {
+			handleError(_motor, ERROR_MEASUREMENT_FAIL);
+		}
+		return;
+	}
+	MESCFOC(_motor);
+}
+
 static volatile int dp_periods = 6;
 void MESCmeasure_DoublePulseTest(MESC_motor_typedef *_motor) {
 	static int dp_counter;
@@ -0,0 +1,287 @@
+/*
+ **
+ ******************************************************************************
+ * @file           : MESCovermod.c
+ * @brief          : Overmodulation and transition into six-step
+ ******************************************************************************
+ * @attention
+ *
+ * <h2><center>&copy; Copyright (c) 2020 David Molony.
+ * All rights reserved.</center></h2>
+ *
+ * This software component is licensed under BSD 3-Clause license,
+ * the "License"; You may not use this file except in compliance with the
+ * License. You may obtain a copy of the License at:
+ *                        opensource.org/licenses/BSD-3-Clause
+ *
+ ******************************************************************************
+ *In addition to the usual 3 BSD clauses, it is explicitly noted that you
+ *do NOT have the right to take sections of this code for other projects
+ *without attribution and credit to the source. Specifically, if you copy into
+ *copyleft licenced code without attribution and retention of the permissive BSD
+ *3 clause licence, you grant a perpetual licence to do the same regarding turning sections of your code
+ *permissive, and lose any rights to use of this code previously granted or assumed.
+ *
+ *This code is intended to remain permissively licensed wherever it goes,
+ *maintaining the freedom to distribute compiled binaries WITHOUT a requirement to supply source.
+ *
+ *This is to ensure this code can at any point be used commercially, on products that may require
+ *such restriction to meet regulatory requirements, or to avoid damage to hardware, or to ensure
+ *warranties can reasonably be honoured.
+ ******************************************************************************
+ */
+
+#include "MESCovermod.h"
+
+#include <math.h>
+#include <stddef.h>
+
+/*
+Two overmodulation schemes are offered:
+
+OVERMOD_TYPE_MIN_PHASE
+    The reference vector keeps its angle and is shortened onto the hexagon
+    wherever it pokes outside. Cheap and smooth, but it tops out at ~95% of the
+    six-step fundamental since the vertices are never held.
+
+OVERMOD_TYPE_SIX_STEP
+    The zero-sequence free phase voltages are amplified by a gain g >= 1, midpoint
+    clamped as SVPWM and then clipped to the rails. At g = 1 this is exactly SVPWM
+    at the linear limit, as g -> infinity every phase saturates and the output is
+    six-step. The fundamental is monotonic in g so a small table maps the requested
+    modulation onto g, giving a continuous transition all the way to full
+    six-step without any mode switch. This behaves like Bolognani's angle hold,
+    the vector dwells on the vertices for longer as the request rises.
+*/
+
+#define OVERMOD_ONE_ON_SQRT3   0.57735027f
+#define OVERMOD_TWO_PI         6.28318531f
+
+#define OVERMOD_TABLE_ANGLES   72    // Samples per erev used to find the fundamental, multiple of 6
+
+// Generated by Gen/util_overmod
+float const overmod_gain[OVERMOD_TABLE_SIZE] =
+{
+    1.000000f, 1.003613f, 1.007975f, 1.012383f,
+    1.017164f, 1.022781f, 1.028397f, 1.034014f,
+    1.041190f, 1.048818f, 1.056445f, 1.064073f,
+    1.075560f, 1.087101f, 1.098641f, 1.116391f,
+    1.138458f, 1.167805f, 1.217440f, 1.267073f,
+    1.316707f, 1.366510f, 1.456126f, 1.545743f,
+    1.635361f, 1.766198f, 1.955899f, 2.145610f,
+    2.520916f, 3.047258f, 4.561184f, 10000.000000f,
+};
+
+static void overmod_clip( float const Vbus, float const g, float V[3] )
+{
+    float const half = 0.5f * Vbus;
+
+    V[0] = g * V[0];
+    V[1] = g * V[1];
+    V[2] = g * V[2];
+
+    float top    = V[0];
+    float bottom = V[0];
+
+    for ( uint32_t i = 1; i < 3; ++i )
+    {
+        if (V[i] > top)
+        {
+            top = V[i];
+        }
+
+        if (V[i] < bottom)
+        {
+            bottom = V[i];
+        }
+    }
+
+    float const mid = 0.5f * (top + bottom);
+
+    for ( uint32_t i = 0; i < 3; ++i )
+    {
+        V[i] = V[i] - mid;
+
+        if (V[i] > half)
+        {
+            V[i] = half;
+        }
+        else if (V[i] < -half)
+        {
+            V[i] = -half;
+        }
+    }
+}
+
+// Fundamental of phase U relative to the linear limit, for clip gain g
+float overmod_fundamental( float const g )
+{
+    float r = 0.0f;
+
+    for ( uint32_t n = 0; n < OVERMOD_TABLE_ANGLES; ++n )
+    {
+        float const theta = (OVERMOD_TWO_PI * (float)n) / (float)OVERMOD_TABLE_ANGLES;
+        float const c     = cosf( theta );
+        float V[3] =
+        {
+            OVERMOD_ONE_ON_SQRT3 * c,
+            OVERMOD_ONE_ON_SQRT3 * cosf( theta - (OVERMOD_TWO_PI / 3.0f) ),
+            OVERMOD_ONE_ON_SQRT3 * cosf( theta + (OVERMOD_TWO_PI / 3.0f) ),
+        };
+
+        overmod_clip( 1.0f, g, V );
+
+        r = r + (V[0] * c);
+    }
+
+    return (2.0f * r) / ((float)OVERMOD_TABLE_ANGLES * OVERMOD_ONE_ON_SQRT3);
+}
+
+void overmod_init( OVERMOD * const om )
+{
+    om->k      = 0.0f;
+    om->dVd    = 0.0f;
+    om->dVq    = 0.0f;
+    om->Id_int = 0.0f;
+    om->Iq_int = 0.0f;
+    om->Id_avg = 0.0f;
+    om->Iq_avg = 0.0f;
+    om->Id_h   = 0.0f;
+    om->Iq_h   = 0.0f;
+}
+
+bool overmod_apply( OVERMOD * const om, OVERMODType const type, float const Vbus, float V[3] )
+{
+    if ((type == OVERMOD_TYPE_NONE) || (Vbus <= 0.0f))
+    {
+        om->k = 0.0f;
+        return false;
+    }
+
+    // Power variant Clark magnitude, valid since V[] has no zero sequence
+    float const mag2 = (2.0f / 3.0f) * ((V[0] * V[0]) + (V[1] * V[1]) + (V[2] * V[2]));
+    float const Vlin = OVERMOD_ONE_ON_SQRT3 * Vbus;
+
+    if (mag2 <= (Vlin * Vlin))
+    {
+        om->k = 0.0f;
+        return false;
+    }
+
+    float const r = sqrtf( mag2 ) / Vlin;
+    float       x = (r - 1.0f) / (OVERMOD_SIX_STEP_RATIO - 1.0f);
+
+    if (x > 1.0f)
+    {
+        x = 1.0f;
+    }
+
+    om->k = x;
+
+    switch (type)
+    {
+        case OVERMOD_TYPE_MIN_PHASE:
+        {
+            float top    = V[0];
+            float bottom = V[0];
+
+            for ( uint32_t i = 1; i < 3; ++i )
+            {
+                if (V[i] > top)
+                {
+                    top = V[i];
+                }
+
+                if (V[i] < bottom)
+                {
+                    bottom = V[i];
+                }
+            }
+
+            float const spread = top - bottom;
+            float const scale  = (spread > Vbus) ? (Vbus / spread) : 1.0f;
+            float const mid    = 0.5f * (top + bottom);
+
+            for ( uint32_t i = 0; i < 3; ++i )
+            {
+                V[i] = scale * (V[i] - mid);
+            }
+
+            break;
+        }
+        case OVERMOD_TYPE_SIX_STEP:
+        {
+            float const idx = x * (float)(OVERMOD_TABLE_SIZE - 1);
+            uint32_t const t = (uint32_t)idx;
+            float g;
+
+            if (t >= (OVERMOD_TABLE_SIZE - 1))
+            {
+                g = overmod_gain[OVERMOD_TABLE_SIZE - 1];
+            }
+            else
+            {
+                float const f = idx - (float)t;
+                g = overmod_gain[t] + (f * (overmod_gain[t + 1] - overmod_gain[t]));
+            }
+
+            // Table is built for a request sitting on the linear limit
+            overmod_clip( Vbus, g / r, V );
+
+            break;
+        }
+        case OVERMOD_TYPE_NONE:
+        default:
+            return false;
+    }
+
+    return true;
+}
+
+void overmod_set_error( OVERMOD * const om, float const dVd, float const dVq )
+{
+    om->dVd = dVd;
+    om->dVq = dVq;
+}
+
+void overmod_compensate( OVERMOD * const om, float const T, float const we,
+                         float const Ld, float const Lq,
+                         float * const Id, float * const Iq )
+{
+    if ((om->k <= 0.0f) || (Ld <= 0.0f) || (Lq <= 0.0f))
+    {
+        // Linear region; bleed out whatever is left so re-entry starts clean
+        om->Id_int = 0.0f;
+        om->Iq_int = 0.0f;
+        om->Id_avg = 0.0f;
+        om->Iq_avg = 0.0f;
+        om->Id_h   = 0.0f;
+        om->Iq_h   = 0.0f;
+        return;
+    }
+
+    // The distortion is at 6x electrical frequency in the dq frame. Anything
+    // at DC is a genuine shortfall in fundamental that the PI should still see,
+    // so it is removed with a low pass well below 6we and subtracted.
+    float w = fabsf( we );
+
+    if (w < 60.0f)
+    {
+        w = 60.0f;
+    }
+
+    float const a_avg  = 0.5f * w * T;
+    float const a_leak = 0.05f * w * T;
+
+    om->Id_int = om->Id_int + ((om->dVd / Ld) * T) - (a_leak * om->Id_int);
+    om->Iq_int = om->Iq_int + ((om->dVq / Lq) * T) - (a_leak * om->Iq_int);
+
+    om->Id_avg = om->Id_avg + (a_avg * (om->Id_int - om->Id_avg));
+    om->Iq_avg = om->Iq_avg + (a_avg * (om->Iq_int - om->Iq_avg));
+
+    om->Id_h = om->Id_int - om->Id_avg;
+    om->Iq_h = om->Iq_int - om->Iq_avg;
+
+    *Id = *Id - om->Id_h;
+    *Iq = *Iq - om->Iq_h;
+}
@@ -11,40 +11,23 @@
 #include <math.h>
 
 void RunPosControl(MESC_motor_typedef *_motor){
-	_motor->pos.set_position += 1;
-//	if(_motor->pos.set_position>200000){_motor->pos.set_position = 100000;}
-//	if(_motor->pos.set_position<200000){_motor->pos.set_position = _motor->pos.set_position+1500;}
-_motor->FOC.Idq_prereq.d = 2.0f;
+	TRAJ *tr = &_motor->pos.traj;
+//Hold wherever the rotor is until running, so enabling position mode does not jump
+	if(_motor->MotorState != MOTOR_STATE_RUN){
+		traj_hold(tr, _motor->FOC.PLL_angle);
+		_motor->pos.set_position = _motor->FOC.PLL_angle;
+		_motor->FOC.Idq_prereq.q = 0.0f;
+		return;
+	}
+	traj_move(tr, _motor->pos.set_position);
+//Share the speed loop gains with speed mode
+	tr->speed_kp = _motor->FOC.speed_kp;
+	tr->speed_ki = _motor->FOC.speed_ki;
+	tr->I_max = fmaxf(_motor->input_vars.max_request_Idq.q, -_motor->input_vars.min_request_Idq.q);
+	tr->Kff = calculateAccelerationGain(_motor);
 
-	_motor->pos.error = (float)(int)(_motor->pos.set_position - _motor->FOC.PLL_angle);
-	_motor->pos.p_error = _motor->pos.Kp * _motor->pos.error;
-	_motor->pos.int_error = _motor->pos.int_error + _motor->pos.Ki * _motor->pos.p_error;
-
-	_motor->pos.d_pos = (float)(int)(_motor->FOC.PLL_angle - _motor->pos.last_pll_pos);
-	_motor->pos.last_pll_pos = _motor->FOC.PLL_angle;
-	_motor->pos.d_error = -_motor->pos.Kd * _motor->pos.d_pos;
-//Clamp the integral
-	if(_motor->pos.int_error>_motor->input_vars.max_request_Idq.q){_motor->pos.int_error = _motor->input_vars.max_request_Idq.q;}
-	if(_motor->pos.int_error<_motor->input_vars.min_request_Idq.q){_motor->pos.int_error = _motor->input_vars.min_request_Idq.q;}
-//apply directional integral clamping
-//	if(_motor->pos.error>0.0f){
-//		if(_motor->pos.int_error<0.0f){
-//			_motor->pos.int_error=0.0f;
-//		}
-//	}
-//	if(_motor->pos.error<0.0f){
-//		if(_motor->pos.int_error>0.0f){
-//			_motor->pos.int_error=0.0f;
-//		}
-//	}
-//Apply the PID
-	if(fabsf(_motor->pos.error)>_motor->pos.deadzone)
-	{
-		_motor->FOC.Idq_prereq.q = _motor->pos.p_error + _motor->pos.int_error + _motor->pos.d_error;
-	}else{_motor->FOC.Idq_prereq.q = 0.0f;}
+	_motor->FOC.Idq_prereq.q = traj_run(tr, _motor->FOC.PLL_angle, _motor->FOC.eHz, 1.0f/(float)SLOW_LOOP_FREQUENCY);
 //Clamp the output
 	if(_motor->FOC.Idq_prereq.q>_motor->input_vars.max_request_Idq.q){_motor->FOC.Idq_prereq.q = _motor->input_vars.max_request_Idq.q;}
 	if(_motor->FOC.Idq_prereq.q<_motor->input_vars.min_request_Idq.q){_motor->FOC.Idq_prereq.q = _motor->input_vars.min_request_Idq.q;}
-
-	__NOP();
 }
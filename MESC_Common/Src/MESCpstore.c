@@ -0,0 +1,378 @@
+/*
+* Copyright 2021-2023 cod3b453
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its contributors
+*    may be used to endorse or promote products derived from this software
+*    without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "MESCpstore.h"
+
+#include "MESCfnv.h"
+
+#include <stddef.h>
+#include <string.h>
+
+_Static_assert( sizeof(PSTOREHeader) == 32, "Malformed PSTOREHeader" );
+_Static_assert( sizeof(PSTOREEntry) == 32, "Malformed PSTOREEntry" );
+
+static bool pstore_aligned( void const * const p )
+{
+    return ((((uintptr_t)p) & (PSTORE_ALIGN - 1)) == 0);
+}
+
+static uint32_t pstore_align( uint32_t const n )
+{
+    return ((n + (PSTORE_ALIGN - 1)) & ~(uint32_t)(PSTORE_ALIGN - 1));
+}
+
+static uint32_t pstore_name_hash( char const * const name )
+{
+    uint32_t hash = fnv1a_init();
+
+    for ( uint32_t i = 0; (i < PSTORE_NAME_LENGTH) && (name[i] != '\0'); ++i )
+    {
+        hash = fnv1a_process( hash, (uint8_t)name[i] );
+    }
+
+    return hash;
+}
+
+// Directory order, by type then name hash then name
+static int pstore_compare( PSTOREEntry const * const e, uint32_t const type, uint32_t const name_hash, char const * const name )
+{
+    if (e->type != type)
+    {
+        return ((e->type < type) ? -1 : 1);
+    }
+
+    if (name == NULL)
+    {
+        return 0;
+    }
+
+    if (e->name_hash != name_hash)
+    {
+        return ((e->name_hash < name_hash) ? -1 : 1);
+    }
+
+    return memcmp( e->name, name, PSTORE_NAME_LENGTH );
+}
+
+// First entry not ordered before the key
+static uint32_t pstore_lower_bound( PSTORE * const ps, uint32_t const type, uint32_t const name_hash, char const * const name )
+{
+    uint32_t lo = 0;
+    uint32_t hi = ps->entries;
+
+    ps->probes = 0;
+
+    while (lo < hi)
+    {
+        uint32_t const mid = lo + ((hi - lo) / 2);
+
+        ps->probes++;
+
+        if (pstore_compare( &ps->directory[mid], type, name_hash, name ) < 0)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+
+PSTOREError pstore_open( PSTORE * const ps, void const * const image, uint32_t const size )
+{
+    memset( ps, 0, sizeof(*ps) );
+
+    if ((size < sizeof(PSTOREHeader)) || !pstore_aligned( image ))
+    {
+        return PSTORE_ERR_SIZE;
+    }
+
+    PSTOREHeader const * const header = (PSTOREHeader const *)image;
+
+    if (    (header->signature != PSTORE_SIGNATURE)
+         || (header->_zero_signature != 0)
+         || (header->_zero != 0))
+    {
+        return PSTORE_ERR_SIGNATURE;
+    }
+
+    if (header->version_major != PSTORE_VERSION_MAJOR)
+    {
+        return PSTORE_ERR_VERSION;
+    }
+
+    if (fnv1a_data( header, offsetof(PSTOREHeader,checksum) ) != header->checksum)
+    {
+        return PSTORE_ERR_CHECKSUM;
+    }
+
+    uint32_t const directory_end = sizeof(PSTOREHeader) + (header->entries * sizeof(PSTOREEntry));
+
+    if (    (header->size != sizeof(PSTOREHeader))
+         || (header->entry_size != sizeof(PSTOREEntry))
+         || (header->entries > PSTORE_MAX_ENTRIES)
+         || (header->image_length > size)
+         || (header->image_length < directory_end))
+    {
+        return PSTORE_ERR_SIZE;
+    }
+
+    PSTOREEntry const * const directory = (PSTOREEntry const *)(header + 1);
+
+    if (fnv1a_data( directory, (header->entries * sizeof(PSTOREEntry)) ) != header->directory_checksum)
+    {
+        return PSTORE_ERR_DIRECTORY;
+    }
+
+    for ( uint32_t i = 0; i < header->entries; ++i )
+    {
+        PSTOREEntry const * const e = &directory[i];
+
+        if (    (e->offset < directory_end)
+             || (e->offset > header->image_length)
+             || (e->length > (header->image_length - e->offset))
+             || ((e->offset & (PSTORE_ALIGN - 1)) != 0))
+        {
+            return PSTORE_ERR_DIRECTORY;
+        }
+
+        // Strictly ascending, which also rules out duplicates
+        if ((i > 0) && (pstore_compare( &directory[i - 1], e->type, e->name_hash, e->name ) >= 0))
+        {
+            return PSTORE_ERR_DIRECTORY;
+        }
+    }
+
+    ps->image     = (uint8_t const *)image;
+    ps->header    = header;
+    ps->directory = directory;
+    ps->entries   = header->entries;
+
+    return PSTORE_OK;
+}
+
+PSTOREError pstore_find( PSTORE * const ps, uint32_t const type, char const * const name, uint32_t * const index )
+{
+    char     key[PSTORE_NAME_LENGTH];
+    uint32_t name_hash = 0;
+
+    if (name != NULL)
+    {
+        uint32_t const len = (uint32_t)strlen( name );
+
+        if (len > PSTORE_NAME_LENGTH)
+        {
+            return PSTORE_ERR_NOT_FOUND;
+        }
+
+        memset( key, 0, sizeof(key) );
+        memcpy( key, name, len );
+
+        name_hash = pstore_name_hash( key );
+    }
+
+    uint32_t const i = pstore_lower_bound( ps, type, name_hash, ((name != NULL) ? key : NULL) );
+
+    if ((i >= ps->entries) || (pstore_compare( &ps->directory[i], type, name_hash, ((name != NULL) ? key : NULL) ) != 0))
+    {
+        return PSTORE_ERR_NOT_FOUND;
+    }
+
+    *index = i;
+
+    return PSTORE_OK;
+}
+
+uint32_t pstore_count( PSTORE * const ps, uint32_t const type )
+{
+    uint32_t const first = pstore_lower_bound( ps, type, 0, NULL );
+    uint32_t       n     = 0;
+
+    while (((first + n) < ps->entries) && (ps->directory[first + n].type == type))
+    {
+        n++;
+    }
+
+    return n;
+}
+
+PSTOREEntry const * pstore_entry( PSTORE const * const ps, uint32_t const index )
+{
+    if (index >= ps->entries)
+    {
+        return NULL;
+    }
+
+    return &ps->directory[index];
+}
+
+PSTOREError pstore_map( PSTORE * const ps, uint32_t const index, void const ** const data, uint32_t * const length )
+{
+    if (index >= ps->entries)
+    {
+        return PSTORE_ERR_NOT_FOUND;
+    }
+
+    PSTOREEntry const * const e    = &ps->directory[index];
+    uint32_t const            word = index / 32;
+    uint32_t const            bit  = UINT32_C(1) << (index % 32);
+
+    if ((ps->checked[word] & bit) == 0)
+    {
+        if (fnv1a_data( &ps->image[e->offset], e->length ) != e->checksum)
+        {
+            ps->damaged[word] |= bit;
+        }
+
+        ps->checked[word] |= bit;
+    }
+
+    if ((ps->damaged[word] & bit) != 0)
+    {
+        return PSTORE_ERR_ENTRY;
+    }
+
+    *data   = &ps->image[e->offset];
+    *length = e->length;
+
+    return PSTORE_OK;
+}
+
+PSTOREError pstore_get( PSTORE * const ps, uint32_t const type, char const * const name, void const ** const data, uint32_t * const length )
+{
+    uint32_t          index;
+    PSTOREError const ret = pstore_find( ps, type, name, &index );
+
+    if (ret != PSTORE_OK)
+    {
+        return ret;
+    }
+
+    return pstore_map( ps, index, data, length );
+}
+
+PSTOREError pstore_build( void * const image, uint32_t const size, PSTOREItem const * const items, uint32_t const count, uint32_t const generation, uint32_t * const length )
+{
+    if (count > PSTORE_MAX_ENTRIES)
+    {
+        return PSTORE_ERR_FULL;
+    }
+
+    if (!pstore_aligned( image ))
+    {
+        return PSTORE_ERR_SIZE;
+    }
+
+    uint32_t const directory_end = sizeof(PSTOREHeader) + (count * sizeof(PSTOREEntry));
+
+    if (directory_end > size)
+    {
+        return PSTORE_ERR_FULL;
+    }
+
+    uint8_t * const     base      = (uint8_t *)image;
+    PSTOREHeader * const header   = (PSTOREHeader *)base;
+    PSTOREEntry * const directory = (PSTOREEntry *)(header + 1);
+    uint32_t            offset    = directory_end;
+
+    // Data in the order given, directory entries sorted by insertion
+    for ( uint32_t i = 0; i < count; ++i )
+    {
+        PSTOREItem const * const item = &items[i];
+        uint32_t const len = (uint32_t)strlen( item->name );
+
+        if (len > PSTORE_NAME_LENGTH)
+        {
+            return PSTORE_ERR_NAME;
+        }
+
+        if ((item->length > size) || (offset > (size - item->length)))
+        {
+            return PSTORE_ERR_FULL;
+        }
+
+        PSTOREEntry e;
+
+        memset( &e, 0, sizeof(e) );
+        memcpy( e.name, item->name, len );
+
+        e.type      = item->type;
+        e.name_hash = pstore_name_hash( e.name );
+        e.offset    = offset;
+        e.length    = item->length;
+        e.checksum  = fnv1a_data( item->data, item->length );
+
+        memcpy( &base[offset], item->data, item->length );
+
+        uint32_t const next = pstore_align( offset + item->length );
+
+        if (next > size)
+        {
+            return PSTORE_ERR_FULL;
+        }
+
+        memset( &base[offset + item->length], 0, (next - offset - item->length) );
+        offset = next;
+
+        uint32_t j = i;
+
+        while ((j > 0) && (pstore_compare( &directory[j - 1], e.type, e.name_hash, e.name ) > 0))
+        {
+            directory[j] = directory[j - 1];
+            j--;
+        }
+
+        if ((j > 0) && (pstore_compare( &directory[j - 1], e.type, e.name_hash, e.name ) == 0))
+        {
+            return PSTORE_ERR_NAME;
+        }
+
+        directory[j] = e;
+    }
+
+    memset( header, 0, sizeof(*header) );
+
+    header->signature          = PSTORE_SIGNATURE;
+    header->version_major      = PSTORE_VERSION_MAJOR;
+    header->version_minor      = PSTORE_VERSION_MINOR;
+    header->size               = sizeof(PSTOREHeader);
+    header->entries            = (uint16_t)count;
+    header->entry_size         = sizeof(PSTOREEntry);
+    header->image_length       = offset;
+    header->directory_checksum = fnv1a_data( directory, (count * sizeof(PSTOREEntry)) );
+    header->generation         = generation;
+    header->checksum           = fnv1a_data( header, offsetof(PSTOREHeader,checksum) );
+
+    *length = offset;
+
+    return PSTORE_OK;
+}
@@ -63,12 +63,52 @@ void MESC_PWM_IRQ_handler(MESC_motor_typedef *_motor) {
 		  MESCpwm_Write(_motor);
 	}
 	_motor->FOC.cycles_pwmloop = CPU_CYCLES - cycles;
+	health_isr_sample(&_motor->health_pwmloop, _motor->FOC.cycles_pwmloop, _motor->FOC.cycles_budget);
 
 #ifdef FASTLED
 	FASTLED->BSRR = FASTLEDIO<<16U;
 #endif
 }
 
+#ifndef STEPPER_MOTOR
+#ifdef DEADTIME_COMP
+//Dead time compensation
+// LICENCE NOTE:
+	  // This function deviates slightly from the BSD 3 clause licence.
+	  // The work here is entirely original to the MESC FOC project, and not based
+	  // on any appnotes, or borrowed from another project. This work is free to
+	  // use, as granted in BSD 3 clause, with the exception that this note must
+	  // be included in where this code is implemented/modified to use your
+	  // variable names, structures containing variables or other minor
+	  // rearrangements in place of the original names I have chosen, and credit
+	  // to David Molony as the original author must be noted.
+//The problem with dead time, is that it is essentially a voltage tie through the body diodes to VBus or ground, depending on the current direction.
+//If we know the direction of current, and the effective dead time length we can remove this error, by writing the corrected voltage.
+//This is observed to improve sinusoidalness of currents, but has a slight audible buzz
+//When the current is approximately zero, it is hard to resolve the direction, and therefore the compensation is ineffective.
+//However, no torque is generated when the current and voltage are close to zero, so no adverse performance except the buzz.
+//A phase held on a rail by the modulator does not switch, so has no dead time to make up,
+//and moving its compare past the rail would wrap the register.
+static void MESCpwm_deadtimePhase(volatile uint32_t *ccr, uint32_t arr, float I, uint16_t comp){
+	if((*ccr <= comp) || (*ccr >= (arr - comp))){
+		return;
+	}
+	if(I < -0.030f){*ccr = *ccr - comp;}
+	if(I > -0.030f){*ccr = *ccr + comp;}
+}
+#endif
+
+static void MESCpwm_deadtimeComp(MESC_motor_typedef *_motor){
+#ifdef DEADTIME_COMP
+	MESCpwm_deadtimePhase(&_motor->mtimer->Instance->CCR1, _motor->mtimer->Instance->ARR, _motor->Conv.Iu, _motor->FOC.deadtime_comp);
+	MESCpwm_deadtimePhase(&_motor->mtimer->Instance->CCR2, _motor->mtimer->Instance->ARR, _motor->Conv.Iv, _motor->FOC.deadtime_comp);
+	MESCpwm_deadtimePhase(&_motor->mtimer->Instance->CCR3, _motor->mtimer->Instance->ARR, _motor->Conv.Iw, _motor->FOC.deadtime_comp);
+#else
+	(void)_motor;
+#endif
+}
+#endif
+
 void MESCpwm_Write(MESC_motor_typedef *_motor) {
 	float mid_value = 0;
 	float top_value;
@@ -139,7 +179,48 @@ if((fabsf(_motor->FOC.eHz)>0.005f*_motor->FOC.pwm_frequency)&&(_motor->HFI.injec
         _motor->HighPhase = N; //Trigger the full clark transform
     }
 
+    //Overmodulation; if the request is outside the hexagon the modulator centres and clips the phases itself
+    if(overmod_apply(&_motor->overmod, _motor->options.overmod_type, _motor->Conv.Vbus, _motor->FOC.inverterVoltage)){
+	    _motor->mtimer->Instance->CCR1 =
+	    		(uint16_t)(_motor->FOC.Vab_to_PWM * _motor->FOC.inverterVoltage[0] + _motor->FOC.PWMmid);
+	    _motor->mtimer->Instance->CCR2 =
+	    		(uint16_t)(_motor->FOC.Vab_to_PWM * _motor->FOC.inverterVoltage[1] + _motor->FOC.PWMmid);
+	    _motor->mtimer->Instance->CCR3 =
+	    		(uint16_t)(_motor->FOC.Vab_to_PWM * _motor->FOC.inverterVoltage[2] + _motor->FOC.PWMmid);
+
+	    //Clark the applied voltage (zero sequence drops out) and Park the error against the request
+	    //so the current feedback can be compensated for the distortion next cycle
+	    float dVa = 0.66666f * (_motor->FOC.inverterVoltage[0] -
+	    		0.5f * (_motor->FOC.inverterVoltage[1] + _motor->FOC.inverterVoltage[2])) - _motor->FOC.Vab.a;
+	    float dVb = 0.57735f * (_motor->FOC.inverterVoltage[1] - _motor->FOC.inverterVoltage[2]) - _motor->FOC.Vab.b;
+	    overmod_set_error(&_motor->overmod,
+	    		_motor->FOC.sincosangle.cos * dVa + _motor->FOC.sincosangle.sin * dVb,
+	    		_motor->FOC.sincosangle.cos * dVb - _motor->FOC.sincosangle.sin * dVa);
+	    //The phases still switching carry the same dead time error as in the linear region
+	    MESCpwm_deadtimeComp(_motor);
+	    return;
+    }
+
     switch(_motor->options.pwm_type){
+    case PWM_DPWM:{
+    	//Discontinuous; hold one phase on a rail so it does not switch this cycle
+    	uint32_t dpwm_high;
+    	if(dpwm_apply(&_motor->dpwm, _motor->Conv.Vbus, _motor->FOC.Vab.a, _motor->FOC.Vab.b,
+    			_motor->FOC.inverterVoltage, &dpwm_high)){
+    		if(dpwm_high != DPWM_PHASE_NONE){
+    			_motor->HighPhase = (HighPhase_e)dpwm_high; //No low side conduction, so no current reading on this phase
+    		}
+    	    _motor->mtimer->Instance->CCR1 =
+    	    		(uint16_t)(_motor->FOC.Vab_to_PWM * _motor->FOC.inverterVoltage[0] + _motor->FOC.PWMmid);
+    	    _motor->mtimer->Instance->CCR2 =
+    	    		(uint16_t)(_motor->FOC.Vab_to_PWM * _motor->FOC.inverterVoltage[1] + _motor->FOC.PWMmid);
+    	    _motor->mtimer->Instance->CCR3 =
+    	    		(uint16_t)(_motor->FOC.Vab_to_PWM * _motor->FOC.inverterVoltage[2] + _motor->FOC.PWMmid);
+    	    MESCpwm_deadtimeComp(_motor); //The clamped phase is on a rail and skipped
+    		break;
+    	}
+    }
+    	//Continuous below the DPWM threshold, fallthrough to SVPWM
     case PWM_SVPWM:
     	   mid_value = _motor->FOC.PWMmid -
     	                0.5f * _motor->FOC.Vab_to_PWM * (top_value + bottom_value);
@@ -153,30 +234,7 @@ if((fabsf(_motor->FOC.eHz)>0.005f*_motor->FOC.pwm_frequency)&&(_motor->HFI.injec
     	    _motor->mtimer->Instance->CCR3 =
     	    		(uint16_t)(_motor->FOC.Vab_to_PWM * _motor->FOC.inverterVoltage[2] + mid_value);
 
-    	    //Dead time compensation
-    	#ifdef DEADTIME_COMP
-    	    // LICENCE NOTE:
-    	    	  // This function deviates slightly from the BSD 3 clause licence.
-    	    	  // The work here is entirely original to the MESC FOC project, and not based
-    	    	  // on any appnotes, or borrowed from another project. This work is free to
-    	    	  // use, as granted in BSD 3 clause, with the exception that this note must
-    	    	  // be included in where this code is implemented/modified to use your
-    	    	  // variable names, structures containing variables or other minor
-    	    	  // rearrangements in place of the original names I have chosen, and credit
-    	    	  // to David Molony as the original author must be noted.
-    	    //The problem with dead time, is that it is essentially a voltage tie through the body diodes to VBus or ground, depending on the current direction.
-    	    //If we know the direction of current, and the effective dead time length we can remove this error, by writing the corrected voltage.
-    	    //This is observed to improve sinusoidalness of currents, but has a slight audible buzz
-    	    //When the current is approximately zero, it is hard to resolve the direction, and therefore the compensation is ineffective.
-    	    //However, no torque is generated when the current and voltage are close to zero, so no adverse performance except the buzz.
-    	    if(_motor->Conv.Iu < -0.030f){_motor->mtimer->Instance->CCR1 = _motor->mtimer->Instance->CCR1-_motor->FOC.deadtime_comp;}
-    	    if(_motor->Conv.Iv < -0.030f){_motor->mtimer->Instance->CCR2 = _motor->mtimer->Instance->CCR2-_motor->FOC.deadtime_comp;}
-    	    if(_motor->Conv.Iw < -0.030f){_motor->mtimer->Instance->CCR3 = _motor->mtimer->Instance->CCR3-_motor->FOC.deadtime_comp;}
-    	    if(_motor->Conv.Iu > -0.030f){_motor->mtimer->Instance->CCR1 = _motor->mtimer->Instance->CCR1+_motor->FOC.deadtime_comp;}
-    	    if(_motor->Conv.Iv > -0.030f){_motor->mtimer->Instance->CCR2 = _motor->mtimer->Instance->CCR2+_motor->FOC.deadtime_comp;}
-    	    if(_motor->Conv.Iw > -0.030f){_motor->mtimer->Instance->CCR3 = _motor->mtimer->Instance->CCR3+_motor->FOC.deadtime_comp;}
-
-    	#endif
+    	    MESCpwm_deadtimeComp(_motor);
     	break;
     case PWM_SIN:
 
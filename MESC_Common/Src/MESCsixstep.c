@@ -0,0 +1,263 @@
+/*
+ **
+ ******************************************************************************
+ * @file           : MESCsixstep.c
+ * @brief          : Sensorless six-step commutation from the floating phase
+ ******************************************************************************
+ * @attention
+ *
+ * <h2><center>&copy; Copyright (c) 2020 David Molony.
+ * All rights reserved.</center></h2>
+ *
+ * This software component is licensed under BSD 3-Clause license,
+ * the "License"; You may not use this file except in compliance with the
+ * License. You may obtain a copy of the License at:
+ *                        opensource.org/licenses/BSD-3-Clause
+ *
+ ******************************************************************************
+ *In addition to the usual 3 BSD clauses, it is explicitly noted that you
+ *do NOT have the right to take sections of this code for other projects
+ *without attribution and credit to the source. Specifically, if you copy into
+ *copyleft licenced code without attribution and retention of the permissive BSD
+ *3 clause licence, you grant a perpetual licence to do the same regarding turning sections of your code
+ *permissive, and lose any rights to use of this code previously granted or assumed.
+ *
+ *This code is intended to remain permissively licensed wherever it goes,
+ *maintaining the freedom to distribute compiled binaries WITHOUT a requirement to supply source.
+ *
+ *This is to ensure this code can at any point be used commercially, on products that may require
+ *such restriction to meet regulatory requirements, or to avoid damage to hardware, or to ensure
+ *warranties can reasonably be honoured.
+ ******************************************************************************
+ */
+
+
+
+
+#include "MESCsixstep.h"
+
+#include <math.h>
+
+#define SIXSTEP_SECTOR_DEG 60.0f
+#define SIXSTEP_COUNTS_DEG (65536.0f / 360.0f)
+
+uint8_t const sixstep_high[6]  = { 2, 1, 1, 0, 0, 2 };
+uint8_t const sixstep_low[6]   = { 0, 0, 2, 2, 1, 1 };
+uint8_t const sixstep_float[6] = { 1, 2, 0, 1, 2, 0 };
+
+static float sixstep_deg( float const rad )
+{
+	return (rad * 180.0f) / 3.14159265f;
+}
+
+// Centre of sector k, degrees electrical
+static float sixstep_centre( uint8_t const k )
+{
+	return 120.0f - (SIXSTEP_SECTOR_DEG * (float)k);
+}
+
+// Integral from the crossing to the commutation, for the present advance
+static float sixstep_threshold( SIXSTEP const * const ss )
+{
+	float const phi = fmaxf( ((3.14159265f / 6.0f) - ss->advance), 0.0f );
+
+	return (ss->flux_th * (1.0f - cosf( phi ))) / (1.0f - cosf( 3.14159265f / 6.0f ));
+}
+
+// Time from the crossing to the commutation
+static float sixstep_delay( SIXSTEP const * const ss )
+{
+	return fmaxf( ((ss->period * (30.0f - sixstep_deg( ss->advance ))) / SIXSTEP_SECTOR_DEG), 0.0f );
+}
+
+float sixstep_flux_threshold( float const flux_linkage )
+{
+	// The floating terminal sees 1.5 times its own BEMF against the mid point
+	return 1.5f * flux_linkage * (1.0f - cosf( 3.14159265f / 6.0f ));
+}
+
+void sixstep_init( SIXSTEP * const ss, float const flux_linkage )
+{
+	ss->mode         = SIXSTEP_MODE_ZC;
+	ss->advance      = SIXSTEP_ADVANCE;
+	ss->blank        = SIXSTEP_BLANK;
+	ss->flux_th      = sixstep_flux_threshold( flux_linkage );
+	ss->eHz_handover = SIXSTEP_HANDOVER_EHZ;
+	ss->eHz_min      = SIXSTEP_EHZ_MIN;
+
+	ss->direction    = -1;
+	ss->sector       = 0;
+	ss->locked       = false;
+	ss->zc_seen      = false;
+	ss->armed        = false;
+	ss->misses       = 0;
+	ss->t            = 0.0f;
+	ss->t_zc         = 0.0f;
+	ss->t_since_zc   = 0.0f;
+	ss->period       = 1.0f;
+	ss->s_last       = 0.0f;
+	ss->integral     = 0.0f;
+	ss->bemf         = 0.0f;
+	ss->commutations = 0;
+}
+
+void sixstep_start( SIXSTEP * const ss, uint16_t const angle, float const eHz )
+{
+	float const sigma = (eHz >= 0.0f) ? 1.0f : -1.0f;
+	float const adv   = sixstep_deg( ss->advance );
+	float const theta = (float)angle / SIXSTEP_COUNTS_DEG;
+
+	// The sector window is centred adv ahead of the sector centre
+	int32_t k = (int32_t)lrintf( (120.0f - (theta + (sigma * adv))) / SIXSTEP_SECTOR_DEG );
+
+	k = ((k % 6) + 6) % 6;
+
+	float offset = (sigma * (theta - sixstep_centre( (uint8_t)k ))) + 30.0f + adv;
+
+	offset = offset - (360.0f * floorf( (offset + 150.0f) / 360.0f )); // Into -150..210
+	offset = fminf( fmaxf( offset, 0.0f ), SIXSTEP_SECTOR_DEG );
+
+	float const offset_zc = 30.0f + adv;
+
+	ss->direction  = (sigma > 0.0f) ? -1 : 1;
+	ss->sector     = (uint8_t)k;
+	ss->period     = 1.0f / (6.0f * fmaxf( fabsf( eHz ), 1.0f ));
+	ss->t          = (ss->period * offset) / SIXSTEP_SECTOR_DEG;
+	ss->zc_seen    = (offset >= offset_zc);
+	ss->armed      = false;
+	ss->misses     = 0;
+	ss->locked     = true;
+	ss->s_last     = 0.0f;
+	ss->t_zc       = (ss->period * offset_zc) / SIXSTEP_SECTOR_DEG;
+	ss->t_since_zc = (ss->period * (offset - offset_zc + (ss->zc_seen ? 0.0f : SIXSTEP_SECTOR_DEG))) / SIXSTEP_SECTOR_DEG;
+
+	float const phi = (3.14159265f / 180.0f) * fmaxf( (offset - offset_zc), 0.0f );
+
+	ss->integral   = ss->zc_seen ? ((ss->flux_th * (1.0f - cosf( phi ))) / (1.0f - cosf( 3.14159265f / 6.0f ))) : 0.0f;
+}
+
+static void sixstep_commutate( SIXSTEP * const ss, float const t_late )
+{
+	ss->sector       = (uint8_t)((ss->sector + ss->direction + 6) % 6);
+	ss->t            = t_late;
+	ss->zc_seen      = false;
+	ss->armed        = false;
+	ss->integral     = 0.0f;
+	ss->commutations = ss->commutations + 1;
+}
+
+bool sixstep_run( SIXSTEP * const ss, float const Vu, float const Vv, float const Vw, float const T )
+{
+	float const V[3] = { Vu, Vv, Vw };
+
+	ss->t          = ss->t + T;
+	ss->t_since_zc = ss->t_since_zc + T;
+	ss->bemf       = V[sixstep_float[ss->sector]] - (0.5f * (V[sixstep_high[ss->sector]] + V[sixstep_low[ss->sector]]));
+
+	// Signed so that it always rises through the crossing; either way round, odd sectors rise
+	bool  const rising = ((ss->sector & 1) != 0);
+	float const s      = rising ? ss->bemf : -ss->bemf;
+
+	// Noise must not pass for BEMF; flux_th scales to the peak at this speed
+	float const arm    = (SIXSTEP_ARM * ss->flux_th * 3.14159265f) / ((1.0f - cosf( 3.14159265f / 6.0f )) * 3.0f * ss->period);
+
+	if (!ss->zc_seen)
+	{
+		if (ss->t >= (ss->blank * ss->period))
+		{
+			if (ss->armed && (s >= 0.0f))
+			{
+				// Interpolate back to the crossing
+				float const ago = (T * s) / (s - ss->s_last);
+
+				ss->period     = ss->period + (SIXSTEP_FILTER * ((ss->t_since_zc - ago) - ss->period));
+				ss->t_zc       = ss->t - ago;
+				ss->t_since_zc = ago;
+				ss->integral   = 0.5f * s * ago;
+				ss->zc_seen    = true;
+				ss->misses     = 0;
+
+				if ((6.0f * ss->period * ss->eHz_min) > 1.0f)
+				{
+					ss->locked = false;
+				}
+			}
+			else if (s < -arm)
+			{
+				ss->armed = true;
+			}
+
+			ss->s_last = s;
+		}
+
+		if (!ss->zc_seen && (ss->t >= (1.5f * ss->period)))
+		{
+			ss->misses = ss->misses + 1;
+			ss->t_since_zc = ss->t_since_zc - ss->period; // Keep the next ZC to ZC on one sector
+
+			if (ss->misses >= SIXSTEP_MISSES)
+			{
+				ss->locked = false;
+			}
+
+			sixstep_commutate( ss, 0.0f );
+
+			return true;
+		}
+
+		if (!ss->zc_seen)
+		{
+			return false;
+		}
+	}
+	else
+	{
+		ss->integral = ss->integral + (s * T);
+	}
+
+	float const since = ss->t - ss->t_zc;
+	float const delay = sixstep_delay( ss );
+
+	if (ss->mode == SIXSTEP_MODE_ZC)
+	{
+		// Commutate on the sample nearest the due time
+		if ((since + (0.5f * T)) >= delay)
+		{
+			sixstep_commutate( ss, (since - delay) );
+			return true;
+		}
+	}
+	else
+	{
+		// Also on the sample nearest, the overshoot over the BEMF giving how late that is
+		float const over = ss->integral + (0.5f * s * T) - sixstep_threshold( ss );
+
+		if ((over >= 0.0f) && (s > 0.0f))
+		{
+			sixstep_commutate( ss, fminf( ((over / s) - (0.5f * T)), T ) );
+			return true;
+		}
+
+		if (since >= ss->period)
+		{
+			sixstep_commutate( ss, 0.0f );
+			return true;
+		}
+	}
+
+	return false;
+}
+
+float sixstep_eHz( SIXSTEP const * const ss )
+{
+	return ((ss->direction < 0) ? 1.0f : -1.0f) / (6.0f * ss->period);
+}
+
+uint16_t sixstep_angle( SIXSTEP const * const ss )
+{
+	float const sigma    = (ss->direction < 0) ? 1.0f : -1.0f;
+	float const progress = fminf( (ss->t / ss->period), 1.0f ) * SIXSTEP_SECTOR_DEG;
+	float const theta    = sixstep_centre( ss->sector ) + (sigma * (progress - 30.0f - sixstep_deg( ss->advance )));
+
+	return (uint16_t)(int32_t)lrintf( theta * SIXSTEP_COUNTS_DEG );
+}
@@ -0,0 +1,147 @@
+/*
+ **
+ ******************************************************************************
+ * @file           : MESCspeedloop.c
+ * @brief          : Decimated speed loop with anti-windup and feedforward
+ ******************************************************************************
+ * @attention
+ *
+ * <h2><center>&copy; Copyright (c) 2020 David Molony.
+ * All rights reserved.</center></h2>
+ *
+ * This software component is licensed under BSD 3-Clause license,
+ * the "License"; You may not use this file except in compliance with the
+ * License. You may obtain a copy of the License at:
+ *                        opensource.org/licenses/BSD-3-Clause
+ *
+ ******************************************************************************
+ *In addition to the usual 3 BSD clauses, it is explicitly noted that you
+ *do NOT have the right to take sections of this code for other projects
+ *without attribution and credit to the source. Specifically, if you copy into
+ *copyleft licenced code without attribution and retention of the permissive BSD
+ *3 clause licence, you grant a perpetual licence to do the same regarding turning sections of your code
+ *permissive, and lose any rights to use of this code previously granted or assumed.
+ *
+ *This code is intended to remain permissively licensed wherever it goes,
+ *maintaining the freedom to distribute compiled binaries WITHOUT a requirement to supply source.
+ *
+ *This is to ensure this code can at any point be used commercially, on products that may require
+ *such restriction to meet regulatory requirements, or to avoid damage to hardware, or to ensure
+ *warranties can reasonably be honoured.
+ ******************************************************************************
+ */
+
+
+
+
+#include "MESCspeedloop.h"
+
+#include <math.h>
+
+void speedloop_init( SPEEDLOOP * const sl )
+{
+	sl->kp          = 0.5f;
+	sl->ki          = 10.0f;
+	sl->aw          = SPEEDLOOP_AW;
+	sl->Kacc        = 0.0f;
+	sl->load_bw     = SPEEDLOOP_LOAD_BW;
+	sl->use_acc_ff  = false;
+	sl->use_load_ff = false;
+
+	sl->decimation  = SPEEDLOOP_DECIMATION;
+	sl->count       = 0;
+
+	sl->I_max       = 0.0f;
+	sl->I_min       = 0.0f;
+	sl->Iq_chain    = 0.0f;
+
+	speedloop_reset( sl, 0.0f );
+}
+
+void speedloop_reset( SPEEDLOOP * const sl, float const eHz )
+{
+	sl->req_last = eHz;
+	sl->integral = 0.0f;
+	sl->eHz_hat  = eHz;
+	sl->I_load   = 0.0f;
+	sl->I_ff     = 0.0f;
+	sl->Iq       = 0.0f;
+}
+
+bool speedloop_tick( SPEEDLOOP * const sl )
+{
+	sl->count++;
+
+	if (sl->count < sl->decimation)
+	{
+		return false;
+	}
+
+	sl->count = 0;
+
+	return true;
+}
+
+void speedloop_limit( SPEEDLOOP * const sl, float const I_min, float const I_max, float const I_out )
+{
+	float lo = I_min;
+	float hi = I_max;
+
+	// Field weakening and battery power clamp whichever side the request is on
+	if ((sl->Iq_chain > 0.0f) && (I_out < sl->Iq_chain))
+	{
+		hi = fminf( hi, fmaxf( I_out, 0.0f ) );
+	}
+
+	if ((sl->Iq_chain < 0.0f) && (I_out > sl->Iq_chain))
+	{
+		lo = fmaxf( lo, fminf( I_out, 0.0f ) );
+	}
+
+	sl->I_min = lo;
+	sl->I_max = hi;
+}
+
+float speedloop_run( SPEEDLOOP * const sl, float const req, float const eHz, float const T )
+{
+	// Observer against the current applied over the last period
+	if (sl->Kacc > 0.0f)
+	{
+		// Both poles at bw; the Euler step stays well damped while bw*T is under a half
+		float const bw = fminf( sl->load_bw, (0.5f / T) );
+		float const e  = eHz - sl->eHz_hat;
+
+		sl->eHz_hat = sl->eHz_hat + (T * (((sl->Iq - sl->I_load) / sl->Kacc) + (2.0f * bw * e)));
+		sl->I_load  = sl->I_load  - (T * bw * bw * sl->Kacc * e);
+	}
+	else
+	{
+		sl->eHz_hat = eHz;
+		sl->I_load  = 0.0f;
+	}
+
+	float const a_req = (req - sl->req_last) / T;
+	sl->req_last = req;
+
+	sl->I_ff = 0.0f;
+
+	if (sl->use_acc_ff)
+	{
+		sl->I_ff = sl->I_ff + (sl->Kacc * a_req);
+	}
+
+	if (sl->use_load_ff)
+	{
+		sl->I_ff = sl->I_ff + sl->I_load;
+	}
+
+	float const P = sl->kp * (req - eHz);
+	float const u = P + sl->integral + sl->I_ff;
+
+	sl->Iq = fminf( fmaxf( u, sl->I_min ), sl->I_max );
+
+	// Back calculation, the clamped excess bleeds out of the integral
+	sl->integral = sl->integral + (T * sl->ki * (P + (sl->aw * (sl->Iq - u))));
+
+	return sl->Iq;
+}
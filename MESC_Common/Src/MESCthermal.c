@@ -0,0 +1,223 @@
+/*
+ **
+ ******************************************************************************
+ * @file           : MESCthermal.c
+ * @brief          : Lumped thermal model of the winding and FET junctions
+ ******************************************************************************
+ * @attention
+ *
+ * <h2><center>&copy; Copyright (c) 2020 David Molony.
+ * All rights reserved.</center></h2>
+ *
+ * This software component is licensed under BSD 3-Clause license,
+ * the "License"; You may not use this file except in compliance with the
+ * License. You may obtain a copy of the License at:
+ *                        opensource.org/licenses/BSD-3-Clause
+ *
+ ******************************************************************************
+ *In addition to the usual 3 BSD clauses, it is explicitly noted that you
+ *do NOT have the right to take sections of this code for other projects
+ *without attribution and credit to the source. Specifically, if you copy into
+ *copyleft licenced code without attribution and retention of the permissive BSD
+ *3 clause licence, you grant a perpetual licence to do the same regarding turning sections of your code
+ *permissive, and lose any rights to use of this code previously granted or assumed.
+ *
+ *This code is intended to remain permissively licensed wherever it goes,
+ *maintaining the freedom to distribute compiled binaries WITHOUT a requirement to supply source.
+ *
+ *This is to ensure this code can at any point be used commercially, on products that may require
+ *such restriction to meet regulatory requirements, or to avoid damage to hardware, or to ensure
+ *warranties can reasonably be honoured.
+ ******************************************************************************
+ */
+
+
+
+#include "MESCthermal.h"
+
+#include <math.h>
+
+#define THERMAL_2_ON_PI 0.63662f
+
+static void thermal_model_init( THERMAL_MODEL * const tm, float const R_fast, float const C_fast, float const R_slow, float const C_slow, float const tau )
+{
+	tm->R_fast = R_fast;
+	tm->C_fast = C_fast;
+	tm->R_slow = R_slow;
+	tm->C_slow = C_slow;
+	tm->tau    = tau;
+
+	tm->T_fast   = THERMAL_T_REF;
+	tm->T_slow   = THERMAL_T_REF;
+	tm->T_sensor = THERMAL_T_REF;
+	tm->T_pred   = THERMAL_T_REF;
+	tm->P        = 0.0f;
+	tm->sensed   = false;
+}
+
+void thermal_init( THERMAL * const th )
+{
+	thermal_model_init( &th->motor, THERMAL_MOTOR_R_FAST, THERMAL_MOTOR_C_FAST, THERMAL_MOTOR_R_SLOW, THERMAL_MOTOR_C_SLOW, THERMAL_MOTOR_TAU_SENSOR );
+	thermal_model_init( &th->fet,   THERMAL_FET_R_FAST,   THERMAL_FET_C_FAST,   THERMAL_FET_R_SLOW,   THERMAL_FET_C_SLOW,   THERMAL_FET_TAU_SENSOR );
+
+	th->T_amb    = THERMAL_T_REF;
+	th->Rds_on   = THERMAL_FET_RDS_ON;
+	th->t_sw     = THERMAL_FET_T_SW;
+	th->horizon  = THERMAL_HORIZON;
+	th->k_sensor = THERMAL_K_SENSOR;
+
+	th->R        = 0.0f;
+	th->Vbus     = 0.0f;
+	th->f_pwm    = 0.0f;
+
+	th->rollback = 1.0f;
+	th->primed   = false;
+}
+
+static void thermal_model_seed( THERMAL_MODEL * const tm, float const T )
+{
+	tm->T_fast   = T;
+	tm->T_slow   = T;
+	tm->T_sensor = T;
+	tm->T_pred   = T;
+}
+
+static void thermal_model_run( THERMAL_MODEL * const tm, float const P, float const T_amb, float const T_meas, float const k_sensor, float const T )
+{
+	float const q_fast = (tm->T_fast - tm->T_slow) / tm->R_fast; // W into the slow node
+	float const q_slow = (tm->T_slow - T_amb) / tm->R_slow;      // W to ambient
+
+	tm->T_fast   = tm->T_fast   + ((T * (P - q_fast)) / tm->C_fast);
+	tm->T_slow   = tm->T_slow   + ((T * (q_fast - q_slow)) / tm->C_slow);
+	tm->T_sensor = tm->T_sensor + ((T / tm->tau) * (tm->T_fast - tm->T_sensor));
+	tm->P        = P;
+
+	// Shift the whole model onto the sensor
+	tm->sensed = (T_meas > 0.0f);
+
+	if (tm->sensed)
+	{
+		float const dT = k_sensor * T * (T_meas - tm->T_sensor);
+
+		tm->T_fast   = tm->T_fast   + dT;
+		tm->T_slow   = tm->T_slow   + dT;
+		tm->T_sensor = tm->T_sensor + dT;
+	}
+}
+
+/*
+The fast node at the horizon with the slow node held is
+    T_free + G*P
+so the prediction is linear in the loss.
+*/
+static void thermal_model_horizon( THERMAL_MODEL const * const tm, float const horizon, float * const T_free, float * const G )
+{
+	float const e = 1.0f - expf( -horizon / (tm->R_fast * tm->C_fast) );
+
+	*T_free = tm->T_fast + ((tm->T_slow - tm->T_fast) * e);
+	*G      = tm->R_fast * e;
+}
+
+static float thermal_motor_R( THERMAL const * const th )
+{
+	return th->R * (1.0f + (THERMAL_ALPHA_CU * (th->motor.T_fast - THERMAL_T_REF)));
+}
+
+static float thermal_fet_Rds( THERMAL const * const th )
+{
+	return th->Rds_on * (1.0f + (THERMAL_ALPHA_RDS * (th->fet.T_fast - THERMAL_T_REF)));
+}
+
+static float thermal_fet_k_sw( THERMAL const * const th )
+{
+	return 3.0f * THERMAL_2_ON_PI * th->Vbus * th->t_sw * th->f_pwm;
+}
+
+void thermal_update( THERMAL * const th, float const Id, float const Iq, float const R, float const Vbus, float const f_pwm,
+                     float const T_motor, float const T_fet, float const T )
+{
+	th->R     = R;
+	th->Vbus  = Vbus;
+	th->f_pwm = f_pwm;
+
+	if (!th->primed)
+	{
+		// Without a motor sensor the motor starts at the board temperature
+		float const T_board = (T_fet > 0.0f) ? T_fet : th->T_amb;
+
+		thermal_model_seed( &th->fet,   T_board );
+		thermal_model_seed( &th->motor, (T_motor > 0.0f) ? T_motor : T_board );
+		th->T_amb  = T_board;
+		th->primed = true;
+	}
+
+	float const I2 = (Id * Id) + (Iq * Iq);
+	float const I  = sqrtf( I2 );
+
+	float const P_motor = 1.5f * I2 * thermal_motor_R( th );
+	float const P_fet   = (1.5f * I2 * thermal_fet_Rds( th )) + (thermal_fet_k_sw( th ) * I);
+
+	thermal_model_run( &th->motor, P_motor, th->T_amb, T_motor, th->k_sensor, T );
+	thermal_model_run( &th->fet,   P_fet,   th->T_amb, T_fet,   th->k_sensor, T );
+
+	float T_free;
+	float G;
+
+	thermal_model_horizon( &th->motor, th->horizon, &T_free, &G );
+	th->motor.T_pred = T_free + (G * P_motor);
+
+	thermal_model_horizon( &th->fet, th->horizon, &T_free, &G );
+	th->fet.T_pred = T_free + (G * P_fet);
+}
+
+/*
+Largest k in 0..1 with A*k^2 + B*k + C <= 0, where A, B >= 0.
+*/
+static float thermal_solve( float const A, float const B, float const C )
+{
+	if (C >= 0.0f)
+	{
+		return 0.0f;
+	}
+
+	if ((A + B + C) <= 0.0f)
+	{
+		return 1.0f;
+	}
+
+	if (A < 1e-9f)
+	{
+		return -C / B;
+	}
+
+	return (sqrtf( (B * B) - (4.0f * A * C) ) - B) / (2.0f * A);
+}
+
+/*
+With the loss at k*Imax being a*k^2 + b*k, the prediction meets the taper
+Tmax - (Tmax - Thot)*k where
+    G*a*k^2 + (G*b + Tmax - Thot)*k + (T_free - Tmax) = 0
+*/
+static float thermal_model_rollback( THERMAL_MODEL const * const tm, float const horizon, float const a, float const b, TEMP const * const temp )
+{
+	float T_free;
+	float G;
+
+	thermal_model_horizon( tm, horizon, &T_free, &G );
+
+	float const D = temp->limit.Tmax - temp->limit.Thot;
+
+	return thermal_solve( (G * a), ((G * b) + D), (T_free - temp->limit.Tmax) );
+}
+
+float thermal_rollback( THERMAL * const th, float const Imax, TEMP const * const motor_temp, TEMP const * const fet_temp )
+{
+	float const I2 = Imax * Imax;
+
+	float const k_motor = thermal_model_rollback( &th->motor, th->horizon, (1.5f * I2 * thermal_motor_R( th )), 0.0f, motor_temp );
+	float const k_fet   = thermal_model_rollback( &th->fet,   th->horizon, (1.5f * I2 * thermal_fet_Rds( th )), (thermal_fet_k_sw( th ) * Imax), fet_temp );
+
+	th->rollback = fminf( k_motor, k_fet );
+
+	return th->rollback;
+}
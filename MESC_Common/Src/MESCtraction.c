@@ -0,0 +1,176 @@
+/*
+ **
+ ******************************************************************************
+ * @file           : MESCtraction.c
+ * @brief          : IMU based traction control and wheelie limiting
+ ******************************************************************************
+ * @attention
+ *
+ * <h2><center>&copy; Copyright (c) 2020 David Molony.
+ * All rights reserved.</center></h2>
+ *
+ * This software component is licensed under BSD 3-Clause license,
+ * the "License"; You may not use this file except in compliance with the
+ * License. You may obtain a copy of the License at:
+ *                        opensource.org/licenses/BSD-3-Clause
+ *
+ ******************************************************************************
+ *In addition to the usual 3 BSD clauses, it is explicitly noted that you
+ *do NOT have the right to take sections of this code for other projects
+ *without attribution and credit to the source. Specifically, if you copy into
+ *copyleft licenced code without attribution and retention of the permissive BSD
+ *3 clause licence, you grant a perpetual licence to do the same regarding turning sections of your code
+ *permissive, and lose any rights to use of this code previously granted or assumed.
+ *
+ *This code is intended to remain permissively licensed wherever it goes,
+ *maintaining the freedom to distribute compiled binaries WITHOUT a requirement to supply source.
+ *
+ *This is to ensure this code can at any point be used commercially, on products that may require
+ *such restriction to meet regulatory requirements, or to avoid damage to hardware, or to ensure
+ *warranties can reasonably be honoured.
+ ******************************************************************************
+ */
+
+
+
+
+
+#include "MESCtraction.h"
+
+#include <math.h>
+
+#define TRACTION_CUT      0.05f // Factor taken as the drive cut
+#define TRACTION_CUT_HOLD 0.25f // s
+#define TRACTION_V_MIN    2.0f  // m/s, slip ratio is taken against at least this
+
+void traction_init( TRACTION * const tc )
+{
+	tc->m_per_eHz = TRACTION_M_PER_EHZ;
+	tc->slip_max = 0.15f;
+	tc->acc_excess = 3.0f;
+	tc->k_slip = 1.0f;
+	tc->pitch_max = 0.26f; // 15deg
+	tc->lookahead = 0.25f;
+	tc->k_pitch = 5.0f;
+	tc->recover = 2.0f;
+	tc->tau_acc = 0.02f;
+	tc->tau_v = 0.5f;
+
+	traction_reset( tc, 0.0f );
+	tc->primed = false;
+}
+
+void traction_reset( TRACTION * const tc, float const eHz )
+{
+	tc->v_wheel = eHz * tc->m_per_eHz;
+	tc->a_wheel = 0.0f;
+	tc->a_grip = 0.0f;
+	tc->t_cut = 0.0f;
+	tc->v_est = tc->v_wheel;
+	tc->a_imu = 0.0f;
+	tc->slip = 0.0f;
+	tc->pitch_pred = 0.0f;
+	tc->scale = 1.0f;
+	tc->slipping = false;
+	tc->wheelie = false;
+	tc->primed = true;
+}
+
+float traction_imu_accel( float const * const acc, float const pitch )
+{
+	// Rotate the specific force back to the ground; gravity then only shows in z
+	return TRACTION_G * ((acc[0] * cosf( pitch )) + (acc[2] * sinf( pitch )));
+}
+
+float traction_vehicle_accel( TRACTION const * const tc )
+{
+	return tc->a_grip;
+}
+
+float traction_run( TRACTION * const tc, float const eHz, float const a_imu, float const pitch, float const pitch_rate, float const T )
+{
+	if (!tc->primed)
+	{
+		traction_reset( tc, eHz );
+	}
+
+	float const v = eHz * tc->m_per_eHz;
+	float const a_raw = (v - tc->v_wheel) / T;
+	float const dir = (v >= 0.0f) ? 1.0f : -1.0f;
+
+	tc->v_wheel = v;
+	tc->a_wheel = tc->a_wheel + ((a_raw - tc->a_wheel) * T / (tc->tau_acc + T));
+	tc->a_imu = a_imu;
+
+	// Vehicle speed from the IMU
+	tc->v_est = tc->v_est + (a_imu * T);
+
+	// Pulled to the wheel only while that is well inside the slip limit; a spinning wheel would drag it up
+	if (tc->slip < (0.5f * tc->slip_max))
+	{
+		tc->v_est = tc->v_est + ((v - tc->v_est) * T / (tc->tau_v + T));
+	}
+
+	// With the drive held cut the wheel spins down to the vehicle within a moment; still apart after
+	// that it is the estimate that drifted, and it restarts from the wheel rather than hold the cut
+	tc->t_cut = (tc->scale < TRACTION_CUT) ? (tc->t_cut + T) : 0.0f;
+
+	if (tc->t_cut > TRACTION_CUT_HOLD)
+	{
+		tc->v_est = v;
+		tc->t_cut = 0.0f;
+	}
+
+	// Under drive the wheel is never the slower
+	if ((dir * (tc->v_est - v)) > 0.0f)
+	{
+		tc->v_est = v;
+	}
+
+	tc->slip = dir * (v - tc->v_est) / fmaxf( fabsf( tc->v_est ), TRACTION_V_MIN );
+
+	// Slip error in units of each limit; while it lasts the factor keeps falling
+	float const excess = dir * (tc->a_wheel - a_imu);
+	float err = 0.0f;
+
+	if (tc->slip > tc->slip_max)
+	{
+		err = err + ((tc->slip - tc->slip_max) / tc->slip_max);
+	}
+
+	if (excess > tc->acc_excess)
+	{
+		err = err + ((excess - tc->acc_excess) / tc->acc_excess);
+	}
+
+	tc->slipping = (err > 0.0f);
+
+	// The wheel is the vehicle acceleration only while it grips; through a slip its last value stands
+	if (!tc->slipping)
+	{
+		tc->a_grip = tc->a_wheel;
+	}
+
+	float scale = fminf( tc->scale + (tc->recover * T), 1.0f );
+
+	if (tc->slipping)
+	{
+		scale = fminf( scale, tc->scale / (1.0f + (tc->k_slip * fminf( err, 1.0f ))) );
+	}
+
+	// Wheelie, on the pitch projected with its rate
+	tc->pitch_pred = pitch + (pitch_rate * tc->lookahead);
+
+	float const over = tc->pitch_pred - tc->pitch_max;
+
+	tc->wheelie = (over > 0.0f);
+
+	if (tc->wheelie)
+	{
+		scale = fminf( scale, tc->scale / (1.0f + fminf( tc->k_pitch * over, 1.0f )) );
+	}
+
+	tc->scale = scale;
+
+	return scale;
+}
@@ -0,0 +1,266 @@
+/*
+ **
+ ******************************************************************************
+ * @file           : MESCtraj.c
+ * @brief          : Jerk limited trajectory planner and cascaded position loop
+ ******************************************************************************
+ * @attention
+ *
+ * <h2><center>&copy; Copyright (c) 2020 David Molony.
+ * All rights reserved.</center></h2>
+ *
+ * This software component is licensed under BSD 3-Clause license,
+ * the "License"; You may not use this file except in compliance with the
+ * License. You may obtain a copy of the License at:
+ *                        opensource.org/licenses/BSD-3-Clause
+ *
+ ******************************************************************************
+ *In addition to the usual 3 BSD clauses, it is explicitly noted that you
+ *do NOT have the right to take sections of this code for other projects
+ *without attribution and credit to the source. Specifically, if you copy into
+ *copyleft licenced code without attribution and retention of the permissive BSD
+ *3 clause licence, you grant a perpetual licence to do the same regarding turning sections of your code
+ *permissive, and lose any rights to use of this code previously granted or assumed.
+ *
+ *This code is intended to remain permissively licensed wherever it goes,
+ *maintaining the freedom to distribute compiled binaries WITHOUT a requirement to supply source.
+ *
+ *This is to ensure this code can at any point be used commercially, on products that may require
+ *such restriction to meet regulatory requirements, or to avoid damage to hardware, or to ensure
+ *warranties can reasonably be honoured.
+ ******************************************************************************
+ */
+
+
+
+#include "MESCtraj.h"
+
+#include <math.h>
+
+static float traj_clamp( float const x, float const lim )
+{
+	return fminf( fmaxf( x, -lim ), lim );
+}
+
+void traj_init( TRAJ * const tr, uint32_t const position )
+{
+	tr->v_max    = TRAJ_V_MAX;
+	tr->a_max    = TRAJ_A_MAX;
+	tr->j_max    = TRAJ_J_MAX;
+
+	tr->Kp       = TRAJ_KP;
+	tr->speed_kp = 0.05f;
+	tr->speed_ki = 0.05f;
+	tr->Kff      = 0.0f;
+	tr->I_max    = TRAJ_I_MAX;
+
+	traj_hold( tr, position );
+}
+
+void traj_hold( TRAJ * const tr, uint32_t const position )
+{
+	tr->origin   = position;
+	tr->end      = position;
+	tr->target   = position;
+	tr->pending  = false;
+	tr->dir      = 1.0f;
+	tr->D        = 0.0f;
+	tr->duration = 0.0f;
+	tr->t        = 0.0f;
+	tr->p        = 0.0f;
+	tr->active   = false;
+
+	tr->p_ref    = position;
+	tr->v_ref    = 0.0f;
+	tr->a_ref    = 0.0f;
+
+	tr->error    = 0.0f;
+	tr->integral = 0.0f;
+	tr->Iq       = 0.0f;
+}
+
+/*
+Segment durations for a rest to rest move over d > 0:
+
+    Tj  jerk time, to the peak acceleration
+    Ta  acceleration phase, to the peak speed
+    Tv  cruise
+
+If the speed limit cannot be reached the peak speed v solves d = v*Ta, first
+with the acceleration limit reached, then without.
+*/
+static void traj_times( TRAJ const * const tr, float const d, float * const Tj, float * const Ta, float * const Tv )
+{
+	float const V = tr->v_max;
+	float const A = tr->a_max;
+	float const J = tr->j_max;
+
+	if ((V * J) >= (A * A))
+	{
+		*Tj = A / J;
+		*Ta = *Tj + (V / A);
+	}
+	else
+	{
+		*Tj = sqrtf( V / J );
+		*Ta = 2.0f * *Tj;
+	}
+
+	if (d >= (V * *Ta))
+	{
+		*Tv = (d - (V * *Ta)) / V;
+		return;
+	}
+
+	*Tv = 0.0f;
+
+	if (d >= ((2.0f * A * A * A) / (J * J)))
+	{
+		// d = v*(A/J + v/A)
+		float const b = A / J;
+		float const v = 0.5f * A * (sqrtf( (b * b) + ((4.0f * d) / A) ) - b);
+
+		*Tj = b;
+		*Ta = b + (v / A);
+	}
+	else
+	{
+		*Tj = cbrtf( d / (2.0f * J) );
+		*Ta = 2.0f * *Tj;
+	}
+}
+
+float traj_plan( TRAJ * const tr, float const D )
+{
+	tr->dir    = (D < 0.0f) ? -1.0f : 1.0f;
+	tr->D      = fabsf( D );
+	tr->t      = 0.0f;
+	tr->p      = 0.0f;
+	tr->active = false;
+	tr->duration = 0.0f;
+
+	if ((tr->D <= 0.0f) || !(tr->v_max > 0.0f) || !(tr->a_max > 0.0f) || !(tr->j_max > 0.0f))
+	{
+		return 0.0f;
+	}
+
+	float Tj;
+	float Ta;
+	float Tv;
+
+	traj_times( tr, tr->D, &Tj, &Ta, &Tv );
+
+	float const Tc = fmaxf( (Ta - (2.0f * Tj)), 0.0f );
+	float const J  = tr->j_max;
+
+	float const T_k[TRAJ_SEGMENTS] = { Tj,  Tc, Tj,   Tv, Tj,   Tc, Tj };
+	float const j_k[TRAJ_SEGMENTS] = { J, 0.0f, -J, 0.0f, -J, 0.0f, J  };
+
+	float t = 0.0f;
+	float p = 0.0f;
+	float v = 0.0f;
+	float a = 0.0f;
+
+	for ( uint32_t k = 0; k < TRAJ_SEGMENTS; ++k )
+	{
+		float const dt = T_k[k];
+		float const j  = j_k[k];
+
+		tr->t_seg[k] = t;
+		tr->p_seg[k] = p;
+		tr->v_seg[k] = v;
+		tr->a_seg[k] = a;
+		tr->j_seg[k] = j;
+
+		p = p + (v * dt) + (0.5f * a * dt * dt) + ((j * dt * dt * dt) / 6.0f);
+		v = v + (a * dt) + (0.5f * j * dt * dt);
+		a = a + (j * dt);
+		t = t + dt;
+	}
+
+	tr->duration = t;
+	tr->active   = true;
+
+	return t;
+}
+
+void traj_move( TRAJ * const tr, uint32_t const target )
+{
+	tr->target  = target;
+	tr->pending = (target != tr->end);
+
+	if (!tr->active && tr->pending)
+	{
+		tr->pending = false;
+		tr->origin  = tr->end;
+		tr->end     = target;
+		traj_plan( tr, ((float)(int32_t)(target - tr->origin) / TRAJ_COUNTS) );
+	}
+}
+
+void traj_sample( TRAJ * const tr, float const T )
+{
+	if (!tr->active)
+	{
+		tr->p_ref = tr->end;
+		tr->v_ref = 0.0f;
+		tr->a_ref = 0.0f;
+		return;
+	}
+
+	tr->t = tr->t + T;
+
+	if (tr->t >= tr->duration)
+	{
+		// Land exactly on the target and start any queued move
+		tr->active = false;
+		tr->p_ref  = tr->end;
+		tr->v_ref  = 0.0f;
+		tr->a_ref  = 0.0f;
+
+		if (tr->pending)
+		{
+			traj_move( tr, tr->target );
+		}
+		return;
+	}
+
+	uint32_t k = TRAJ_SEGMENTS - 1;
+
+	while ((k > 0) && (tr->t < tr->t_seg[k]))
+	{
+		--k;
+	}
+
+	float const dt = tr->t - tr->t_seg[k];
+	float const j  = tr->j_seg[k];
+	float const a  = tr->a_seg[k];
+	float const v  = tr->v_seg[k];
+	float const p  = tr->p_seg[k] + (v * dt) + (0.5f * a * dt * dt) + ((j * dt * dt * dt) / 6.0f);
+
+	// Rounding at the segment joins must not step the reference backwards
+	tr->p     = fminf( fmaxf( p, tr->p ), tr->D );
+	tr->p_ref = tr->origin + (uint32_t)(int32_t)lrintf( tr->dir * tr->p * TRAJ_COUNTS );
+	tr->v_ref = tr->dir * (v + (a * dt) + (0.5f * j * dt * dt));
+	tr->a_ref = tr->dir * (a + (j * dt));
+}
+
+float traj_run( TRAJ * const tr, uint32_t const position, float const eHz, float const T )
+{
+	traj_sample( tr, T );
+
+	tr->error = (float)(int32_t)(tr->p_ref - position);
+
+	// Position P, planned speed fed forward
+	float const speed = tr->v_ref + ((tr->Kp * tr->error) / TRAJ_COUNTS);
+
+	// Speed PI, in the form of RunSpeedControl
+	float const P = traj_clamp( (tr->speed_kp * (speed - eHz)), tr->I_max );
+
+	tr->integral = traj_clamp( (tr->integral + (tr->speed_ki * P)), tr->I_max );
+
+	// Planned acceleration through the inertia
+	tr->Iq = traj_clamp( ((tr->Kff * tr->a_ref) + tr->integral + P), tr->I_max );
+
+	return tr->Iq;
+}
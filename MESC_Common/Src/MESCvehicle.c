@@ -0,0 +1,414 @@
+/*
+ **
+ ******************************************************************************
+ * @file           : MESCvehicle.c
+ * @brief          : Table driven vehicle state machine and ride modes
+ ******************************************************************************
+ * @attention
+ *
+ * <h2><center>&copy; Copyright (c) 2020 David Molony.
+ * All rights reserved.</center></h2>
+ *
+ * This software component is licensed under BSD 3-Clause license,
+ * the "License"; You may not use this file except in compliance with the
+ * License. You may obtain a copy of the License at:
+ *                        opensource.org/licenses/BSD-3-Clause
+ *
+ ******************************************************************************
+ *In addition to the usual 3 BSD clauses, it is explicitly noted that you
+ *do NOT have the right to take sections of this code for other projects
+ *without attribution and credit to the source. Specifically, if you copy into
+ *copyleft licenced code without attribution and retention of the permissive BSD
+ *3 clause licence, you grant a perpetual licence to do the same regarding turning sections of your code
+ *permissive, and lose any rights to use of this code previously granted or assumed.
+ *
+ *This code is intended to remain permissively licensed wherever it goes,
+ *maintaining the freedom to distribute compiled binaries WITHOUT a requirement to supply source.
+ *
+ *This is to ensure this code can at any point be used commercially, on products that may require
+ *such restriction to meet regulatory requirements, or to avoid damage to hardware, or to ensure
+ *warranties can reasonably be honoured.
+ ******************************************************************************
+ */
+
+
+
+
+
+#include "MESCvehicle.h"
+
+#include <math.h>
+#include <stddef.h>
+
+typedef bool (*VEHGuard)( VEHICLE const * const veh );
+typedef void (*VEHAction)( VEHICLE * const veh );
+
+struct VEHTransition
+{
+    VEHState  state;
+    VEHEvent  event;
+    VEHGuard  guard;  // NULL always passes
+    VEHState  next;
+    VEHAction action; // NULL for none
+};
+
+typedef struct VEHTransition VEHTransition;
+
+static bool vehicle_g_closed( VEHICLE const * const veh )
+{
+	return !veh->throttle_on;
+}
+
+static bool vehicle_g_stopped( VEHICLE const * const veh )
+{
+	return !veh->moving;
+}
+
+// Brake pressed with the stand up and the throttle closed
+static bool vehicle_g_unpark_brake( VEHICLE const * const veh )
+{
+	return ((veh->in & VEH_IN_STAND) == 0) && !veh->throttle_on;
+}
+
+// Stand raised with the throttle closed, and the brake held where there is one
+static bool vehicle_g_unpark_stand( VEHICLE const * const veh )
+{
+	return (!veh->brake_to_drive || ((veh->in & VEH_IN_BRAKE) != 0)) && !veh->throttle_on;
+}
+
+// No brake input to wait for; the stand is up and the throttle closed
+static bool vehicle_g_unpark_ready( VEHICLE const * const veh )
+{
+	return !veh->brake_to_drive && ((veh->in & VEH_IN_STAND) == 0) && !veh->throttle_on;
+}
+
+// A reverse switch moved on the move
+static bool vehicle_g_reverse_held( VEHICLE const * const veh )
+{
+	return !veh->momentary_reverse && ((veh->in & VEH_IN_REVERSE) != 0);
+}
+
+static bool vehicle_g_reverse_released( VEHICLE const * const veh )
+{
+	return !veh->momentary_reverse && ((veh->in & VEH_IN_REVERSE) == 0);
+}
+
+static bool vehicle_g_cruise( VEHICLE const * const veh )
+{
+	return veh->throttle_on && (fabsf( veh->eHz ) >= veh->eHz_cruise);
+}
+
+static bool vehicle_g_fault_gone( VEHICLE const * const veh )
+{
+	return !veh->faulted;
+}
+
+static void vehicle_a_mode( VEHICLE * const veh )
+{
+	veh->mode = (uint8_t)((veh->mode + 1) % VEH_MODES);
+}
+
+static void vehicle_a_cruise( VEHICLE * const veh )
+{
+	veh->cruise_eHz = veh->eHz;
+}
+
+static VEHTransition const vehicle_table[] =
+{
+	{ VEH_STATE_PARKED,  VEH_EV_START,        vehicle_g_unpark_ready,     VEH_STATE_DRIVE,   NULL             },
+	{ VEH_STATE_PARKED,  VEH_EV_BRAKE_ON,     vehicle_g_unpark_brake,     VEH_STATE_DRIVE,   NULL             },
+	{ VEH_STATE_PARKED,  VEH_EV_STAND_UP,     vehicle_g_unpark_stand,     VEH_STATE_DRIVE,   NULL             },
+	{ VEH_STATE_PARKED,  VEH_EV_THROTTLE_OFF, vehicle_g_unpark_ready,     VEH_STATE_DRIVE,   NULL             },
+	{ VEH_STATE_PARKED,  VEH_EV_MODE,         vehicle_g_closed,           VEH_STATE_PARKED,  vehicle_a_mode   },
+	{ VEH_STATE_PARKED,  VEH_EV_FAULT,        NULL,                       VEH_STATE_ERROR,   NULL             },
+
+	{ VEH_STATE_DRIVE,   VEH_EV_STAND_DOWN,   NULL,                       VEH_STATE_PARKED,  NULL             },
+	{ VEH_STATE_DRIVE,   VEH_EV_PARK_TIMER,   NULL,                       VEH_STATE_PARKED,  NULL             },
+	{ VEH_STATE_DRIVE,   VEH_EV_REVERSE_ON,   vehicle_g_stopped,          VEH_STATE_REVERSE, NULL             },
+	{ VEH_STATE_DRIVE,   VEH_EV_STOPPED,      vehicle_g_reverse_held,     VEH_STATE_REVERSE, NULL             },
+	{ VEH_STATE_DRIVE,   VEH_EV_CRUISE,       vehicle_g_cruise,           VEH_STATE_CRUISE,  vehicle_a_cruise },
+	{ VEH_STATE_DRIVE,   VEH_EV_MODE,         vehicle_g_closed,           VEH_STATE_DRIVE,   vehicle_a_mode   },
+	{ VEH_STATE_DRIVE,   VEH_EV_FAULT,        NULL,                       VEH_STATE_ERROR,   NULL             },
+
+	{ VEH_STATE_REVERSE, VEH_EV_STAND_DOWN,   NULL,                       VEH_STATE_PARKED,  NULL             },
+	{ VEH_STATE_REVERSE, VEH_EV_PARK_TIMER,   NULL,                       VEH_STATE_PARKED,  NULL             },
+	{ VEH_STATE_REVERSE, VEH_EV_REVERSE_OFF,  vehicle_g_stopped,          VEH_STATE_DRIVE,   NULL             },
+	{ VEH_STATE_REVERSE, VEH_EV_STOPPED,      vehicle_g_reverse_released, VEH_STATE_DRIVE,   NULL             },
+	{ VEH_STATE_REVERSE, VEH_EV_MODE,         vehicle_g_closed,           VEH_STATE_REVERSE, vehicle_a_mode   },
+	{ VEH_STATE_REVERSE, VEH_EV_FAULT,        NULL,                       VEH_STATE_ERROR,   NULL             },
+
+	{ VEH_STATE_CRUISE,  VEH_EV_STAND_DOWN,   NULL,                       VEH_STATE_PARKED,  NULL             },
+	{ VEH_STATE_CRUISE,  VEH_EV_BRAKE_ON,     NULL,                       VEH_STATE_DRIVE,   NULL             },
+	{ VEH_STATE_CRUISE,  VEH_EV_CRUISE,       NULL,                       VEH_STATE_DRIVE,   NULL             },
+	{ VEH_STATE_CRUISE,  VEH_EV_THROTTLE_ON,  NULL,                       VEH_STATE_DRIVE,   NULL             },
+	{ VEH_STATE_CRUISE,  VEH_EV_STOPPED,      NULL,                       VEH_STATE_DRIVE,   NULL             },
+	{ VEH_STATE_CRUISE,  VEH_EV_FAULT,        NULL,                       VEH_STATE_ERROR,   NULL             },
+
+	{ VEH_STATE_ERROR,   VEH_EV_FAULT_CLEAR,  vehicle_g_closed,           VEH_STATE_PARKED,  NULL             },
+	{ VEH_STATE_ERROR,   VEH_EV_THROTTLE_OFF, vehicle_g_fault_gone,       VEH_STATE_PARKED,  NULL             },
+};
+
+#define VEH_TABLE_SIZE (sizeof( vehicle_table ) / sizeof( vehicle_table[0] ))
+
+void vehicle_init( VEHICLE * const veh )
+{
+	static VEHMode const modes[VEH_MODES] =
+	{
+		{ 0.5f, 0.5f, 0.0f, { 0.0f, 0.15f, 0.35f, 0.60f, 1.0f } }, // Eco, soft off the line
+		{ 0.8f, 0.8f, 0.0f, { 0.0f, 0.25f, 0.50f, 0.75f, 1.0f } }, // Normal
+		{ 1.0f, 1.0f, 0.0f, { 0.0f, 0.35f, 0.60f, 0.85f, 1.0f } }, // Sport
+	};
+
+	for (uint32_t i = 0; i < VEH_MODES; i++)
+	{
+		veh->modes[i] = modes[i];
+	}
+
+	veh->reverse_scale     = 0.3f;
+	veh->eHz_stop          = 5.0f;
+	veh->eHz_cruise        = 50.0f;
+	veh->debounce          = VEH_DEBOUNCE;
+	veh->park_time         = VEH_PARK_TIME;
+	veh->momentary_reverse = false;
+	veh->brake_to_drive    = false;
+
+	veh->in          = 0;
+	veh->throttle    = 0.0f;
+	veh->eHz         = 0.0f;
+	veh->fault       = false;
+
+	veh->state       = VEH_STATE_PARKED;
+	veh->mode        = 1;
+
+	for (uint32_t i = 0; i < VEH_INPUTS; i++)
+	{
+		veh->lock[i] = 0.0f;
+	}
+
+	veh->throttle_on = false;
+	veh->moving      = false;
+	veh->faulted     = false;
+	veh->started     = false;
+	veh->t_still     = 0.0f;
+	veh->cruise_eHz  = 0.0f;
+	veh->events      = 0;
+}
+
+bool vehicle_dispatch( VEHICLE * const veh, VEHEvent const ev )
+{
+	veh->events = veh->events + 1;
+
+	for (uint32_t i = 0; i < VEH_TABLE_SIZE; i++)
+	{
+		VEHTransition const * const tr = &vehicle_table[i];
+
+		if ((tr->state != veh->state) || (tr->event != ev))
+		{
+			continue;
+		}
+
+		if ((tr->guard != NULL) && !tr->guard( veh ))
+		{
+			continue;
+		}
+
+		veh->state = tr->next;
+
+		if (tr->action != NULL)
+		{
+			tr->action( veh );
+		}
+
+		return true;
+	}
+
+	return false;
+}
+
+// Event on the accepted edge of input i, none for a falling edge of a button
+static bool vehicle_edge_event( VEHICLE const * const veh, uint32_t const i, bool const rising, VEHEvent * const ev )
+{
+	switch (i)
+	{
+		case 0:
+			*ev = rising ? VEH_EV_STAND_DOWN : VEH_EV_STAND_UP;
+			return true;
+		case 1:
+			*ev = rising ? VEH_EV_BRAKE_ON : VEH_EV_BRAKE_OFF;
+			return true;
+		case 2:
+			if (veh->momentary_reverse)
+			{
+				*ev = (veh->state == VEH_STATE_REVERSE) ? VEH_EV_REVERSE_OFF : VEH_EV_REVERSE_ON;
+				return rising;
+			}
+			*ev = rising ? VEH_EV_REVERSE_ON : VEH_EV_REVERSE_OFF;
+			return true;
+		case 3:
+			*ev = VEH_EV_CRUISE;
+			return rising;
+		case 4:
+			*ev = VEH_EV_MODE;
+			return rising;
+		default:
+			return false;
+	}
+}
+
+void vehicle_update( VEHICLE * const veh, uint32_t const in, float const throttle,
+                     float const eHz, bool const fault, float const T )
+{
+	veh->throttle = throttle;
+	veh->eHz      = eHz;
+	veh->fault    = fault;
+
+	// Levels first, so the guards see this tick
+	bool const was_on     = veh->throttle_on;
+	bool const was_moving = veh->moving;
+
+	if (veh->throttle_on)
+	{
+		veh->throttle_on = (throttle >= VEH_THROTTLE_OFF);
+	}
+	else
+	{
+		veh->throttle_on = (throttle > VEH_THROTTLE_ON);
+	}
+
+	if (veh->moving)
+	{
+		veh->moving = (fabsf( eHz ) >= veh->eHz_stop);
+	}
+	else
+	{
+		veh->moving = (fabsf( eHz ) > (1.5f * veh->eHz_stop));
+	}
+
+	if (!veh->started)
+	{
+		veh->started = true;
+		vehicle_dispatch( veh, VEH_EV_START );
+	}
+
+	if (fault != veh->faulted)
+	{
+		veh->faulted = fault;
+		vehicle_dispatch( veh, (fault ? VEH_EV_FAULT : VEH_EV_FAULT_CLEAR) );
+	}
+
+	for (uint32_t i = 0; i < VEH_INPUTS; i++)
+	{
+		uint32_t const bit = (1u << i);
+
+		veh->lock[i] = fmaxf( (veh->lock[i] - T), 0.0f );
+
+		// A change inside the lockout waits; if it is still there after, it is the edge
+		if ((((in ^ veh->in) & bit) == 0) || (veh->lock[i] > 0.0f))
+		{
+			continue;
+		}
+
+		bool const rising = ((in & bit) != 0);
+		VEHEvent   ev;
+
+		veh->in      = (veh->in & ~bit) | (in & bit);
+		veh->lock[i] = veh->debounce;
+
+		if (vehicle_edge_event( veh, i, rising, &ev ))
+		{
+			vehicle_dispatch( veh, ev );
+		}
+	}
+
+	if (veh->throttle_on != was_on)
+	{
+		vehicle_dispatch( veh, (veh->throttle_on ? VEH_EV_THROTTLE_ON : VEH_EV_THROTTLE_OFF) );
+	}
+
+	if (was_moving && !veh->moving)
+	{
+		vehicle_dispatch( veh, VEH_EV_STOPPED );
+	}
+
+	if (((veh->state == VEH_STATE_DRIVE) || (veh->state == VEH_STATE_REVERSE)) && !veh->moving && !veh->throttle_on)
+	{
+		float const before = veh->t_still;
+
+		veh->t_still = veh->t_still + T;
+
+		if ((before < veh->park_time) && (veh->t_still >= veh->park_time))
+		{
+			vehicle_dispatch( veh, VEH_EV_PARK_TIMER );
+		}
+	}
+	else
+	{
+		veh->t_still = 0.0f;
+	}
+}
+
+static float vehicle_map( VEHMode const * const m, float const throttle )
+{
+	float const   pos  = fminf( fmaxf( throttle, 0.0f ), 1.0f ) * (float)(VEH_MAP_POINTS - 1);
+	uint32_t      i    = (uint32_t)pos;
+
+	if (i >= (VEH_MAP_POINTS - 1))
+	{
+		i = VEH_MAP_POINTS - 2;
+	}
+
+	float const   frac = pos - (float)i;
+
+	return m->map[i] + (frac * (m->map[i + 1] - m->map[i]));
+}
+
+static float vehicle_taper( float const eHz, float const eHz_max )
+{
+	if (eHz_max <= 0.0f)
+	{
+		return 1.0f;
+	}
+
+	return fminf( fmaxf( (((1.1f * eHz_max) - fabsf( eHz )) / (0.1f * eHz_max)), 0.0f ), 1.0f );
+}
+
+float vehicle_request( VEHICLE const * const veh )
+{
+	VEHMode const * const m = &veh->modes[veh->mode];
+
+	float scale;
+	float sign;
+
+	switch (veh->state)
+	{
+		case VEH_STATE_DRIVE:
+			scale = 1.0f;
+			sign  = 1.0f;
+			break;
+		case VEH_STATE_REVERSE:
+			scale = veh->reverse_scale;
+			sign  = -1.0f;
+			break;
+		default:
+			return 0.0f;
+	}
+
+	if (veh->throttle < 0.0f)
+	{
+		// Braking opposes the direction of travel
+		return sign * veh->throttle * m->I_brake;
+	}
+
+	if ((veh->in & VEH_IN_BRAKE) != 0)
+	{
+		// The brake lever cuts the throttle
+		return 0.0f;
+	}
+
+	return sign * scale * m->I_max * vehicle_map( m, veh->throttle ) * vehicle_taper( veh->eHz, (scale * m->eHz_max) );
+}
+
+bool vehicle_locked( VEHICLE const * const veh )
+{
+	return (veh->state == VEH_STATE_PARKED) || (veh->state == VEH_STATE_ERROR);
+}
@@ -48,3 +48,93 @@ int MPU6050GetData(MPU6050_data_t *MPU_instance){
 	__NOP();
 	return 0;
 }
+
+#define MPU6050_DMA_INSTANCES 2
+static MPU6050_data_t *MPU6050_dma[MPU6050_DMA_INSTANCES];
+
+static int MPU6050BusRead(void *ctx, uint8_t reg, uint8_t *buf, uint16_t len){
+	MPU6050_data_t *MPU_instance = (MPU6050_data_t *)ctx;
+	if(HAL_I2C_Mem_Read_DMA(MPU_instance->MPU6050_I2C, MPU_instance->MPU6050_address, reg, 1, buf, len) != HAL_OK){
+		return -1;
+	}
+	return 0;
+}
+
+static int MPU6050BusWrite(void *ctx, uint8_t reg, uint8_t val){
+	MPU6050_data_t *MPU_instance = (MPU6050_data_t *)ctx;
+	if(HAL_I2C_Mem_Write(MPU_instance->MPU6050_I2C, MPU_instance->MPU6050_address, reg, 1, &val, 1, 10) != HAL_OK){
+		return -1;
+	}
+	return 0;
+}
+
+int MPU6050InitDMA(I2C_HandleTypeDef *i2c_handle, uint16_t address, MPU6050_data_t *MPU_instance, float odr){
+
+	MPU_instance->MPU6050_I2C = i2c_handle;
+	MPU_instance->MPU6050_address = address;
+	uint8_t check = 0;
+	HAL_I2C_Mem_Read(MPU_instance->MPU6050_I2C, MPU_instance->MPU6050_address, MPU_REG_WHO_AM_I, 1, &check, 1,10);
+	if(check != 0x68){
+		return 0;
+	}
+
+	IMUBus const bus = {MPU6050BusRead, MPU6050BusWrite, MPU_instance};
+	imu_init(&MPU_instance->imu, &bus);
+	if(imu_config(&MPU_instance->imu, odr) != 0){
+		return 0;
+	}
+
+	for(int i = 0; i<MPU6050_DMA_INSTANCES; i++){
+		if((MPU6050_dma[i] == NULL) || (MPU6050_dma[i] == MPU_instance)){
+			MPU6050_dma[i] = MPU_instance;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+void MPU6050Poll(MPU6050_data_t *MPU_instance, uint32_t now_us){
+	imu_start(&MPU_instance->imu, now_us); //Does nothing while the last burst is in flight
+}
+
+uint32_t MPU6050Process(MPU6050_data_t *MPU_instance){
+	uint32_t n = imu_process(&MPU_instance->imu);
+	if(n){
+		//Keep the raw fields of the blocking reader current
+		MPU_instance->Xacc = (int16_t)(MPU_instance->imu.last.acc[0]/MPU_instance->imu.acc_scale);
+		MPU_instance->Yacc = (int16_t)(MPU_instance->imu.last.acc[1]/MPU_instance->imu.acc_scale);
+		MPU_instance->Zacc = (int16_t)(MPU_instance->imu.last.acc[2]/MPU_instance->imu.acc_scale);
+		MPU_instance->XGYR = (int16_t)(MPU_instance->imu.last.gyr[0]/MPU_instance->imu.gyr_scale);
+		MPU_instance->YGYR = (int16_t)(MPU_instance->imu.last.gyr[1]/MPU_instance->imu.gyr_scale);
+		MPU_instance->ZGYR = (int16_t)(MPU_instance->imu.last.gyr[2]/MPU_instance->imu.gyr_scale);
+	}
+	return n;
+}
+
+//Only one burst is in flight per bus, so the instance on that bus which is not idle is the one that finished
+static MPU6050_data_t *MPU6050Busy(I2C_HandleTypeDef *hi2c){
+	for(int i = 0; i<MPU6050_DMA_INSTANCES; i++){
+		if(MPU6050_dma[i] && (MPU6050_dma[i]->MPU6050_I2C == hi2c) && (MPU6050_dma[i]->imu.phase != IMU_IDLE)){
+			return MPU6050_dma[i];
+		}
+	}
+	return NULL;
+}
+
+int MPU6050RxCplt(I2C_HandleTypeDef *hi2c){
+	MPU6050_data_t *MPU_instance = MPU6050Busy(hi2c);
+	if(MPU_instance == NULL){
+		return 0;
+	}
+	imu_rx_done(&MPU_instance->imu);
+	return 1;
+}
+
+int MPU6050Error(I2C_HandleTypeDef *hi2c){
+	MPU6050_data_t *MPU_instance = MPU6050Busy(hi2c);
+	if(MPU_instance == NULL){
+		return 0;
+	}
+	imu_rx_error(&MPU_instance->imu);
+	return 1;
+}
@@ -27,6 +27,8 @@
 
 #define SLOWTIM_SCALER 2
 
+//#define USE_MPU6050 //IMU on I2C2 for the vehicle app; PB10/PB11 are taken from USART3
+
 //#define MISSING_UCURRSENSOR //You can run two current sensors ONLY if they are phase sensors.
 //#define MISSING_VCURRSENSOR //Running this with low side sensors may result in fire.
 //#define MISSING_WCURRSENSOR //Also requires that the third ADC is spoofed in the getRawADC(void) function in MESChw_setup.c to avoid trips
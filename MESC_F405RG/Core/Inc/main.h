@@ -61,6 +61,7 @@ void HAL_TIM_MspPostInit(TIM_HandleTypeDef *htim);
 void Error_Handler(void);
 
 /* USER CODE BEGIN EFP */
+void IMU_poll(void);
 
 /* USER CODE END EFP */
 
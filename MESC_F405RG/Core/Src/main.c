@@ -29,6 +29,7 @@
 
 #include "MESCmotor_state.h"
 #include "MPU6050.h"
+#include "MESCApp.h"
 
 #include "Tasks/init.h"
 
@@ -82,6 +83,7 @@ I2C_HandleTypeDef hi2c2;
 uint16_t MPU_present, MPU_present2;
 MPU6050_data_t MPU_instance_1, MPU_instance_2;
 #define MPU6050_ADDR 0xD0
+#define MPU6050_ODR 200.0f
 #define DAC_MEMORY_ADDRESS 0x40007400
 #define DAC_VALUE_ADDRESS 0x40007408
 
@@ -159,7 +161,15 @@ int main(void)
   MX_TIM3_Init();
   MX_CAN1_Init();
   /* USER CODE BEGIN 2 */
-  //MX_I2C2_Init();
+#ifdef USE_MPU6050
+  //PB10/PB11 are shared with USART3
+  HAL_UART_DeInit(&huart3);
+  MX_I2C2_Init();
+  MPU_present = MPU6050InitDMA(&hi2c2, MPU6050_ADDR, &MPU_instance_1, MPU6050_ODR);
+  if(MPU_present){
+	  vehicle_imu = &MPU_instance_1.imu; //Traction control reads the attitude IMU_poll keeps up to date
+  }
+#endif
 
 //
 #ifdef DAC_REF
@@ -1194,6 +1204,36 @@ static void MX_I2C2_Init(void)
   /* USER CODE END I2C2_Init 2 */
 
 }
+
+#ifdef USE_MPU6050
+//IMU timestamps in us from the cycle counter, wrapping at 2^32us like any other us counter
+static uint32_t IMU_us(void){
+	static uint32_t last_cycles = 0;
+	static uint32_t us = 0;
+	uint32_t const cycles_per_us = HAL_RCC_GetHCLKFreq()/1000000;
+	uint32_t const elapsed = (DWT->CYCCNT - last_cycles)/cycles_per_us;
+	last_cycles = last_cycles + elapsed*cycles_per_us;
+	us = us + elapsed;
+	return us;
+}
+
+//Called from the slow loop ahead of the motors; takes in the last burst, then starts the next
+void IMU_poll(void){
+	if(MPU_present){
+		MPU6050Process(&MPU_instance_1);
+		MPU6050Poll(&MPU_instance_1, IMU_us());
+	}
+}
+
+//Shared by every user of I2C; the IMU only takes its own bursts, add other users after it
+void HAL_I2C_MemRxCpltCallback(I2C_HandleTypeDef *hi2c){
+	MPU6050RxCplt(hi2c);
+}
+
+void HAL_I2C_ErrorCallback(I2C_HandleTypeDef *hi2c){
+	MPU6050Error(hi2c);
+}
+#endif
 /* USER CODE END 4 */
 
 /* USER CODE BEGIN Header_StartDefaultTask */
@@ -249,6 +249,9 @@ void TIM2_IRQHandler(void)
   /* USER CODE BEGIN TIM2_IRQn 0 */
 	__HAL_TIM_CLEAR_IT(&htim2, TIM_IT_UPDATE);
 
+#ifdef USE_MPU6050
+	IMU_poll();
+#endif
 	MESC_Slow_IRQ_handler(&mtr[0]);
 
   /* USER CODE END TIM2_IRQn 0 */
@@ -316,5 +319,33 @@ void OTG_FS_IRQHandler(void)
 }
 
 /* USER CODE BEGIN 1 */
+#ifdef USE_MPU6050
+extern I2C_HandleTypeDef hi2c2;
+extern DMA_HandleTypeDef hdma_i2c2_rx;
+
+/**
+  * @brief This function handles DMA1 stream2 global interrupt, I2C2 RX.
+  */
+void DMA1_Stream2_IRQHandler(void)
+{
+  HAL_DMA_IRQHandler(&hdma_i2c2_rx);
+}
+
+/**
+  * @brief This function handles I2C2 event interrupt.
+  */
+void I2C2_EV_IRQHandler(void)
+{
+  HAL_I2C_EV_IRQHandler(&hi2c2);
+}
+
+/**
+  * @brief This function handles I2C2 error interrupt.
+  */
+void I2C2_ER_IRQHandler(void)
+{
+  HAL_I2C_ER_IRQHandler(&hi2c2);
+}
+#endif
 
 /* USER CODE END 1 */
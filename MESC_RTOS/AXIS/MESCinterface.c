@@ -48,6 +48,7 @@
 #include <stdio.h>
 
 axis_vars_t axis_vars;
+MT6816 encoder;
 
 
 
@@ -73,6 +74,11 @@ void populate_vars(){
 	TERM_addVar(axis_vars.throttle_end			    , 0.0f		, 1.0f		, "span"		, "Throttle span"						, VAR_ACCESS_RW	, NULL		, &TERM_varList);
 	TERM_addVar(axis_vars.throttle_offset		    , 0.0f		, 1.0f		, "offset"		, "Throttle offset"						, VAR_ACCESS_RW	, NULL		, &TERM_varList);
 	TERM_addVar(axis_vars.throttle_threshold	    , 0.0f		, 1.0f		, "threshold"	, "Throttle threshold"					, VAR_ACCESS_RW	, NULL		, &TERM_varList);
+	TERM_addVar(encoder.bw						, 0.1f		, 200.0f	, "enc_bw"		, "Encoder velocity bandwidth [Hz]"		, VAR_ACCESS_RW	, NULL		, &TERM_varList);
+	TERM_addVar(encoder.jump_max					, 1			, 8192		, "enc_jump"	, "Encoder outlier [counts]"				, VAR_ACCESS_RW	, NULL		, &TERM_varList);
+	TERM_addVar(axis_vars.velocitySPI				, -1000.0f	, 1000.0f	, "enc_vel"		, "Encoder velocity [rev/s]"				, VAR_ACCESS_R	, NULL		, &TERM_varList);
+	TERM_addVar(encoder.outliers					, 0			, 0xFFFFFFFF, "enc_outliers", "Encoder samples rejected"				, VAR_ACCESS_R	, NULL		, &TERM_varList);
+	TERM_addVar(encoder.overruns					, 0			, 0xFFFFFFFF, "enc_overruns", "Encoder samples missed"					, VAR_ACCESS_R	, NULL		, &TERM_varList);
 
 
 }
@@ -102,71 +108,118 @@ extern TIM_HandleTypeDef htim2;
 extern TIM_HandleTypeDef htim15;
 
 
-HAL_StatusTypeDef SpiStatus;
+//The MT6816 sampled by DMA off a timer, see MESCmt6816.h
+static TIM_HandleTypeDef htim16;
+static DMA_HandleTypeDef hdma_spi1_rx;
+static DMA_HandleTypeDef hdma_spi1_tx;
 
+static uint16_t enc_cmd[2] = {MT6816_CMD_ANGLE_H, MT6816_CMD_ANGLE_L};
+static uint16_t enc_rx[2];
+static volatile uint8_t enc_frame = 0; //0 idle, else the frame in flight
+static uint32_t enc_time = 0; //us, advanced a period per timer tick
+static uint32_t enc_t = 0; //us, tick of the transfer in flight
 
+#define ENC_NSS_LOW()	HAL_GPIO_WritePin(GPIOA, GPIO_PIN_15, GPIO_PIN_RESET) //falling edge signals start of transmission
+#define ENC_NSS_HIGH()	HAL_GPIO_WritePin(GPIOA, GPIO_PIN_15, GPIO_PIN_SET) //Rising edge ends the transmission
 
-uint8_t has_even_parity(uint16_t x){
-	uint32_t count=0;
+static void encoder_frame_start(uint8_t frame){
+	enc_frame = frame;
+	ENC_NSS_LOW();
+	if(HAL_SPI_TransmitReceive_DMA(&hspi1, (uint8_t*)&enc_cmd[frame-1], (uint8_t*)&enc_rx[frame-1], 1) != HAL_OK){
+		ENC_NSS_HIGH();
+		enc_frame = 0;
+		encoder.spi_errors++;
+	}
+}
 
-	for(int i=0; i<16; i++){
-		if(x & (1 << i)){
-			count ++;
+void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim){
+	if(htim->Instance == TIM16){
+		enc_time += encoder.period;
+		if(enc_frame){
+			encoder.overruns++;
+			return;
 		}
+		enc_t = enc_time;
+		encoder_frame_start(1);
 	}
+}
 
-	if(count % 2){
-		return 0;
+void HAL_SPI_TxRxCpltCallback(SPI_HandleTypeDef *hspi){
+	if(hspi->Instance != SPI1) return;
+	ENC_NSS_HIGH();
+	if(enc_frame == 1){
+		encoder_frame_start(2);
 	}else{
-		return 1;
+		enc_frame = 0;
+		mt6816_push(&encoder, enc_rx[0], enc_rx[1], enc_t);
 	}
-
 }
 
-mt6816_t read_encoder(){
-
-	mt6816_t ret;
-
-	uint16_t SPITxData;
-	uint16_t SPIRxData;
-
-	ret.error = MT6816_OK;
-
-	//Generate an NSS
-	HAL_GPIO_WritePin(GPIOA, GPIO_PIN_15, GPIO_PIN_RESET); //falling edge signals start of transmission
-	SPITxData = 0x8300;
-	SPIRxData = 0xa5a5;
-	SpiStatus = HAL_SPI_TransmitReceive(&hspi1, (uint8_t*)&SPITxData, (uint8_t*)&SPIRxData, 1, 2);
-	HAL_GPIO_WritePin(GPIOA, GPIO_PIN_15, GPIO_PIN_SET);//Rising edge ends the transmission
-
-	ret.angle = 0;
-	ret.angle = (SPIRxData&0x00FF)<<8;
-
-	HAL_GPIO_WritePin(GPIOA, GPIO_PIN_15, GPIO_PIN_RESET);
-	SPITxData = 0x8400;
-	SPIRxData = 0xa5a5;
-	SpiStatus = HAL_SPI_TransmitReceive(&hspi1, (uint8_t*)&SPITxData, (uint8_t*)&SPIRxData, 1, 2);
+void HAL_SPI_ErrorCallback(SPI_HandleTypeDef *hspi){
+	if(hspi->Instance != SPI1) return;
+	ENC_NSS_HIGH();
+	enc_frame = 0;
+	encoder.spi_errors++;
+}
 
-	HAL_GPIO_WritePin(GPIOA, GPIO_PIN_15, GPIO_PIN_SET);
+void DMA1_Channel2_IRQHandler(void){
+	HAL_DMA_IRQHandler(&hdma_spi1_rx);
+}
 
-	ret.angle |= (SPIRxData & 0x00FF);
-	ret.angle = ret.angle>>2;
+void DMA1_Channel3_IRQHandler(void){
+	HAL_DMA_IRQHandler(&hdma_spi1_tx);
+}
 
-	uint8_t parity_bit = SPIRxData & 0b1;
+void SPI1_IRQHandler(void){
+	HAL_SPI_IRQHandler(&hspi1);
+}
 
-	ret.status = 0;
-	if(has_even_parity(ret.angle) == parity_bit){
-		ret.angle = 0;
-		ret.error = MT6816_ERROR;
-		ret.status |= MT6816_PARITY_ERROR;
-	}
-	if(SPIRxData & 0b10){  //Check no magnet bit
-		ret.angle = 0;
-		ret.error = MT6816_ERROR;
-		ret.status |= MT6816_NO_MAG;
-	}
+void TIM1_UP_TIM16_IRQHandler(void){
+	HAL_TIM_IRQHandler(&htim16);
+}
 
-	return ret;
+static void encoder_dma_init(void){
+	//SPI1 on DMA1 request 1, channel 2 RX and channel 3 TX
+	__HAL_RCC_DMA1_CLK_ENABLE();
+	hdma_spi1_rx.Instance = DMA1_Channel2;
+	hdma_spi1_rx.Init.Request = DMA_REQUEST_1;
+	hdma_spi1_rx.Init.Direction = DMA_PERIPH_TO_MEMORY;
+	hdma_spi1_rx.Init.PeriphInc = DMA_PINC_DISABLE;
+	hdma_spi1_rx.Init.MemInc = DMA_MINC_ENABLE;
+	hdma_spi1_rx.Init.PeriphDataAlignment = DMA_PDATAALIGN_HALFWORD;
+	hdma_spi1_rx.Init.MemDataAlignment = DMA_MDATAALIGN_HALFWORD;
+	hdma_spi1_rx.Init.Mode = DMA_NORMAL;
+	hdma_spi1_rx.Init.Priority = DMA_PRIORITY_HIGH;
+	HAL_DMA_Init(&hdma_spi1_rx);
+	__HAL_LINKDMA(&hspi1, hdmarx, hdma_spi1_rx);
+
+	hdma_spi1_tx.Instance = DMA1_Channel3;
+	hdma_spi1_tx.Init = hdma_spi1_rx.Init;
+	hdma_spi1_tx.Init.Direction = DMA_MEMORY_TO_PERIPH;
+	HAL_DMA_Init(&hdma_spi1_tx);
+	__HAL_LINKDMA(&hspi1, hdmatx, hdma_spi1_tx);
+
+	HAL_NVIC_SetPriority(DMA1_Channel2_IRQn, 5, 0);
+	HAL_NVIC_EnableIRQ(DMA1_Channel2_IRQn);
+	HAL_NVIC_SetPriority(DMA1_Channel3_IRQn, 5, 0);
+	HAL_NVIC_EnableIRQ(DMA1_Channel3_IRQn);
+	HAL_NVIC_SetPriority(SPI1_IRQn, 5, 0);
+	HAL_NVIC_EnableIRQ(SPI1_IRQn);
+
+	//TIM16 counts us and triggers a sample each period; its clock is twice PCLK2 when APB2 is divided
+	__HAL_RCC_TIM16_CLK_ENABLE();
+	htim16.Instance = TIM16;
+	htim16.Init.Prescaler = (HAL_RCC_GetPCLK2Freq() * ((RCC->CFGR & RCC_CFGR_PPRE2_2) ? 2 : 1)) / 1000000 - 1;
+	htim16.Init.CounterMode = TIM_COUNTERMODE_UP;
+	htim16.Init.Period = encoder.period - 1;
+	htim16.Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
+	htim16.Init.RepetitionCounter = 0;
+	htim16.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_DISABLE;
+	HAL_TIM_Base_Init(&htim16);
+
+	HAL_NVIC_SetPriority(TIM1_UP_TIM16_IRQn, 5, 0);
+	HAL_NVIC_EnableIRQ(TIM1_UP_TIM16_IRQn);
+	HAL_TIM_Base_Start_IT(&htim16);
 }
 
 
@@ -193,8 +246,9 @@ float utils_truncate_number(float number, float min, float max, float deadband)
 
 void task_encoder(void * argument){
 
-	//Init SPI to the encoder
+	//Init SPI to the encoder and start sampling it
 	HAL_SPI_Init(&hspi1);
+	encoder_dma_init();
 	//Init the PW in
 	HAL_TIM_IC_Start(&htim2, TIM_CHANNEL_1);
 	HAL_TIM_IC_Start(&htim2, TIM_CHANNEL_2);
@@ -210,20 +264,25 @@ void task_encoder(void * argument){
 	HAL_TIM_PWM_Start(&htim15, TIM_CHANNEL_1);
 	htim15.Instance->CCR1 = 0;
 
+	vTaskDelay(10);
+	MT6816Sample enc_sample;
+	uint32_t enc_seq = mt6816_read(&encoder, &enc_sample);
+
 	while(1){
 		bool error_state = false;
 
 		if(axis_vars.use_spi){
-			axis_vars.mt6816 = read_encoder();
-
-
-		//Process the data
+			//Latest sample from the DMA pipeline; none since the last pass means it stalled
+			uint32_t seq = mt6816_read(&encoder, &enc_sample);
+			axis_vars.mt6816 = enc_sample.enc;
+			axis_vars.velocitySPI = enc_sample.vel/(float)MT6816_COUNTS;
 
 			axis_vars.ratioSPI = (float)axis_vars.mt6816.angle/16384.0f;
 
-			if(axis_vars.mt6816.error){
+			if(axis_vars.mt6816.error || (seq == enc_seq)){
 				error_state=true;
 			}
+			enc_seq = seq;
 		}
 
 		if(axis_vars.use_pwm){
@@ -325,6 +384,7 @@ void MESCinterface_init(TERMINAL_HANDLE * handle){
 	if(is_init) return;
 	is_init=true;
 
+	mt6816_init(&encoder);
 	populate_vars();
 
 	axis_vars.check_pwm_vs_spi = true;
@@ -35,21 +35,17 @@
 
 #include "Tasks/task_cli.h"
 #include "Tasks/task_can.h"
+#include "MESCmt6816.h"
 
 
 #define CAN_NAME "THR_AXIS"
-typedef struct{
-	uint16_t angle;
-	uint8_t status;
-	uint8_t error;
-}mt6816_t;
-
 typedef struct{
 	bool check_pwm_vs_spi;
 	bool use_spi;
 	bool use_pwm;
 
 	mt6816_t mt6816;
+	float velocitySPI; //rev/s
 	float ratioPWM;
 	float ratioSPI;
 	uint32_t encoder_error_limit;
@@ -69,14 +65,6 @@ typedef struct{
 
 
 
-#define MT6816_OK 			0
-#define MT6816_NO_MAG 		1
-#define MT6816_ERROR 		1
-#define MT6816_PARITY_ERROR 2
-#define MT6816_SPI_ERROR 	3
-#define MT6816_OVERSPEED 	4
-
-
 extern axis_vars_t axis_vars;
 
 
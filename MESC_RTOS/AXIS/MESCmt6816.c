@@ -0,0 +1,221 @@
+/*
+ **
+ ******************************************************************************
+ * @file           : MESCmt6816.c
+ * @brief          : MT6816 angle decoding, outlier rejection and velocity tracking
+ ******************************************************************************
+ * @attention
+ *
+ * <h2><center>&copy; Copyright (c) 2022 Jens Kerrinnes.
+ * All rights reserved.</center></h2>
+ *
+ * This software component is licensed under BSD 3-Clause license,
+ * the "License"; You may not use this file except in compliance with the
+ * License. You may obtain a copy of the License at:
+ *                        opensource.org/licenses/BSD-3-Clause
+ ******************************************************************************
+ *In addition to the usual 3 BSD clauses, it is explicitly noted that you
+ *do NOT have the right to take sections of this code for other projects
+ *without attribution and credit to the source. Specifically, if you copy into
+ *copyleft licenced code without attribution and retention of the permissive BSD
+ *3 clause licence, you grant a perpetual licence to do the same regarding turning sections of your code
+ *permissive, and lose any rights to use of this code previously granted or assumed.
+ *
+ *This code is intended to remain permissively licensed wherever it goes,
+ *maintaining the freedom to distribute compiled binaries WITHOUT a requirement to supply source.
+ *
+ *This is to ensure this code can at any point be used commercially, on products that may require
+ *such restriction to meet regulatory requirements, or to avoid damage to hardware, or to ensure
+ *warranties can reasonably be honoured.
+ ******************************************************************************/
+
+
+
+
+#include "MESCmt6816.h"
+
+#include <math.h>
+#include <stdatomic.h>
+#include <string.h>
+
+#define MT6816_PI   3.14159265f
+#define MT6816_HALF ((float)(MT6816_COUNTS / 2))
+#define MT6816_GAP  8 // Periods without a good sample before the loop restarts
+
+// Odd parity of every byte, built up two bits at a time
+#define MT6816_P2(n) n, n ^ 1, n ^ 1, n
+#define MT6816_P4(n) MT6816_P2(n), MT6816_P2(n ^ 1), MT6816_P2(n ^ 1), MT6816_P2(n)
+#define MT6816_P6(n) MT6816_P4(n), MT6816_P4(n ^ 1), MT6816_P4(n ^ 1), MT6816_P4(n)
+
+static uint8_t const mt6816_odd[256] =
+{
+	MT6816_P6(0), MT6816_P6(1), MT6816_P6(1), MT6816_P6(0)
+};
+
+void mt6816_init( MT6816 * const enc )
+{
+	memset( enc, 0, sizeof(*enc) );
+
+	enc->period = MT6816_PERIOD_DEFAULT;
+	enc->bw = MT6816_BW_DEFAULT;
+	enc->jump_max = MT6816_JUMP_DEFAULT;
+	enc->reject_max = MT6816_REJECT_DEFAULT;
+}
+
+uint8_t mt6816_even_parity( uint16_t const x )
+{
+	return (uint8_t)(1U ^ mt6816_odd[x & 0xFFU] ^ mt6816_odd[x >> 8]);
+}
+
+mt6816_t mt6816_decode( uint16_t const rx_h, uint16_t const rx_l )
+{
+	mt6816_t ret;
+
+	ret.angle = (uint16_t)((((rx_h & 0x00FFU) << 8) | (rx_l & 0x00FFU)) >> 2);
+	ret.status = 0;
+	ret.error = MT6816_OK;
+
+	uint8_t const parity_bit = (uint8_t)(rx_l & 0x0001U);
+
+	if (mt6816_even_parity( ret.angle ) == parity_bit)
+	{
+		ret.angle = 0;
+		ret.error = MT6816_ERROR;
+		ret.status |= MT6816_PARITY_ERROR;
+	}
+
+	if (rx_l & 0x0002U) // No magnet bit
+	{
+		ret.angle = 0;
+		ret.error = MT6816_ERROR;
+		ret.status |= MT6816_NO_MAG;
+	}
+
+	return ret;
+}
+
+// Counts into -MT6816_HALF..MT6816_HALF
+static float mt6816_wrap( float x )
+{
+	x = fmodf( x, (float)MT6816_COUNTS );
+
+	if (x >= MT6816_HALF)
+	{
+		x = x - (float)MT6816_COUNTS;
+	}
+	else if (x < -MT6816_HALF)
+	{
+		x = x + (float)MT6816_COUNTS;
+	}
+
+	return x;
+}
+
+static void mt6816_publish( MT6816 * const enc, uint32_t const t, mt6816_t const d )
+{
+	MT6816Sample * const s = &enc->buf[(enc->seq + 1U) & 1U];
+
+	s->t = t;
+	s->enc = d;
+	s->vel = enc->vel;
+
+	// The slot is written before the reader can be sent to it
+	atomic_signal_fence( memory_order_release );
+	enc->seq = enc->seq + 1U;
+}
+
+static void mt6816_restart( MT6816 * const enc, float const angle, uint32_t const t )
+{
+	enc->pos = angle;
+	enc->vel = 0.0f;
+	enc->t_last = t;
+	enc->rejects = 0;
+	enc->primed = true;
+}
+
+bool mt6816_push( MT6816 * const enc, uint16_t const rx_h, uint16_t const rx_l, uint32_t const t )
+{
+	mt6816_t const d = mt6816_decode( rx_h, rx_l );
+
+	enc->samples++;
+
+	if (d.error != MT6816_OK)
+	{
+		if (d.status & MT6816_PARITY_ERROR)
+		{
+			enc->parity_errors++;
+		}
+
+		if (d.status & MT6816_NO_MAG)
+		{
+			enc->no_mag++;
+		}
+
+		mt6816_publish( enc, t, d );
+
+		return false;
+	}
+
+	float const angle = (float)d.angle;
+	uint32_t const elapsed = t - enc->t_last;
+
+	if (!enc->primed || (elapsed > (MT6816_GAP * enc->period)))
+	{
+		mt6816_restart( enc, angle, t );
+		mt6816_publish( enc, t, d );
+
+		return true;
+	}
+
+	float const dt = (float)elapsed * 1.0e-6f;
+	float const pred = enc->pos + (enc->vel * dt);
+	float const e = mt6816_wrap( angle - pred );
+
+	if (fabsf( e ) > (float)enc->jump_max)
+	{
+		enc->outliers++;
+		enc->rejects++;
+
+		if (enc->rejects <= enc->reject_max)
+		{
+			return false;
+		}
+
+		// Not a glitch; it did move
+		mt6816_restart( enc, angle, t );
+		mt6816_publish( enc, t, d );
+
+		return true;
+	}
+
+	// Critically damped second order loop
+	float const w = 2.0f * MT6816_PI * enc->bw;
+	float const kp = fminf( 2.0f * w * dt, 1.0f );
+
+	enc->pos = pred + (kp * e);
+	enc->pos = enc->pos - ((float)MT6816_COUNTS * floorf( enc->pos / (float)MT6816_COUNTS ));
+	enc->vel = enc->vel + (w * w * dt * e);
+	enc->t_last = t;
+	enc->rejects = 0;
+
+	mt6816_publish( enc, t, d );
+
+	return true;
+}
+
+uint32_t mt6816_read( MT6816 const * const enc, MT6816Sample * const s )
+{
+	uint32_t seq;
+
+	// Two more samples during the copy would have reused the slot
+	do
+	{
+		seq = enc->seq;
+		atomic_signal_fence( memory_order_acquire );
+		*s = enc->buf[seq & 1U];
+		atomic_signal_fence( memory_order_acquire );
+	}
+	while ((enc->seq - seq) >= 2U);
+
+	return seq;
+}
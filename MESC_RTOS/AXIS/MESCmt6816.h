@@ -0,0 +1,152 @@
+/*
+ **
+ ******************************************************************************
+ * @file           : MESCmt6816.h
+ * @brief          : MT6816 angle decoding, outlier rejection and velocity tracking
+ ******************************************************************************
+ * @attention
+ *
+ * <h2><center>&copy; Copyright (c) 2022 Jens Kerrinnes.
+ * All rights reserved.</center></h2>
+ *
+ * This software component is licensed under BSD 3-Clause license,
+ * the "License"; You may not use this file except in compliance with the
+ * License. You may obtain a copy of the License at:
+ *                        opensource.org/licenses/BSD-3-Clause
+ ******************************************************************************
+ *In addition to the usual 3 BSD clauses, it is explicitly noted that you
+ *do NOT have the right to take sections of this code for other projects
+ *without attribution and credit to the source. Specifically, if you copy into
+ *copyleft licenced code without attribution and retention of the permissive BSD
+ *3 clause licence, you grant a perpetual licence to do the same regarding turning sections of your code
+ *permissive, and lose any rights to use of this code previously granted or assumed.
+ *
+ *This code is intended to remain permissively licensed wherever it goes,
+ *maintaining the freedom to distribute compiled binaries WITHOUT a requirement to supply source.
+ *
+ *This is to ensure this code can at any point be used commercially, on products that may require
+ *such restriction to meet regulatory requirements, or to avoid damage to hardware, or to ensure
+ *warranties can reasonably be honoured.
+ ******************************************************************************/
+
+
+#ifndef MESC_MT6816_H
+#define MESC_MT6816_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+The MT6816 gives a 14 bit angle over SPI in two 16 bit frames, one per
+register, each a separate NSS cycle:
+
+  0x8300 -> 0x03: angle bits 13..6
+  0x8400 -> 0x04: angle bits 5..0, no magnet, parity
+
+A timer starts the first frame by DMA every period and the completion
+interrupt starts the second, so the CPU only ever sets up a transfer and the
+sample time is the timer tick, not whenever a task got to run. The second
+completion hands both frames to mt6816_push, which runs here on the host too.
+
+Parity comes from a 256 entry table, one lookup per byte. A parity or no
+magnet error is published as an error sample with angle 0, as the blocking
+read always did.
+
+A tracking loop follows the angle with a position and a velocity, bandwidth
+bw. A good sample that lands more than jump_max counts from the prediction is
+an outlier, a bit slip on the bus, and is dropped; more than reject_max in a row
+and the angle really has moved, so the loop restarts there. It also restarts
+after eight periods without a good sample.
+
+Samples are double buffered: the interrupt fills the slot the reader is not
+on and then bumps seq, and mt6816_read copies the newest and retries if two
+more landed meanwhile. The task sees the latest sample, never a torn one, and a
+seq that has not moved means the pipeline stalled.
+*/
+
+#define MT6816_COUNTS      16384
+#define MT6816_CMD_ANGLE_H 0x8300
+#define MT6816_CMD_ANGLE_L 0x8400
+
+#define MT6816_PERIOD_DEFAULT 1000  // us, 1kHz
+#define MT6816_BW_DEFAULT     20.0f // Hz
+#define MT6816_JUMP_DEFAULT   512   // counts, 11deg in one period
+#define MT6816_REJECT_DEFAULT 4
+
+#define MT6816_OK 			0
+#define MT6816_NO_MAG 		1
+#define MT6816_ERROR 		1
+#define MT6816_PARITY_ERROR 2
+#define MT6816_SPI_ERROR 	3
+#define MT6816_OVERSPEED 	4
+
+typedef struct{
+	uint16_t angle;
+	uint8_t status;
+	uint8_t error;
+}mt6816_t;
+
+struct MT6816Sample
+{
+    uint32_t t;   // us, timer tick that started the transfer
+    mt6816_t enc;
+    float    vel; // counts/s
+};
+
+typedef struct MT6816Sample MT6816Sample;
+
+struct MT6816
+{
+    // Configuration
+    uint32_t period;     // us
+    float    bw;         // Hz, tracking loop
+    uint16_t jump_max;   // counts off the prediction
+    uint8_t  reject_max; // Outliers in a row before restarting on the angle
+
+    // Tracking loop
+    float    pos;        // counts, 0..MT6816_COUNTS
+    float    vel;        // counts/s
+    uint32_t t_last;     // us
+    uint8_t  rejects;
+    bool     primed;
+
+    // Double buffer
+    MT6816Sample buf[2];
+    volatile uint32_t seq; // Samples published, the newest is buf[seq & 1]
+
+    // Statistics
+    uint32_t samples;
+    uint32_t parity_errors;
+    uint32_t no_mag;
+    uint32_t outliers;
+    uint32_t overruns;   // Timer ticks with the previous transfer still in flight
+    uint32_t spi_errors;
+};
+
+typedef struct MT6816 MT6816;
+
+void mt6816_init( MT6816 * const enc );
+
+/*
+1 when x has an even number of set bits.
+*/
+uint8_t mt6816_even_parity( uint16_t const x );
+
+/*
+Decode the replies to MT6816_CMD_ANGLE_H and MT6816_CMD_ANGLE_L.
+*/
+mt6816_t mt6816_decode( uint16_t const rx_h, uint16_t const rx_l );
+
+/*
+Decode, track and publish one sample taken at t us. Returns true when the
+angle was accepted.
+*/
+bool mt6816_push( MT6816 * const enc, uint16_t const rx_h, uint16_t const rx_l, uint32_t const t );
+
+/*
+Copy out the newest sample. Returns seq; unchanged since the last call means
+nothing new arrived.
+*/
+uint32_t mt6816_read( MT6816 const * const enc, MT6816Sample * const s );
+
+#endif
@@ -36,12 +36,15 @@
 #include "Tasks/task_overlay.h"
 #include "MESCmotor_state.h"
 #include "MESCmotor.h"
+#include "MESCApp.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
 #include <math.h>
 #include <MESC/MESCinterface.h>
 #include "MESCmeasure.h"
+#include "task_health.h"
+#include "semphr.h"
 
 void handleEscape(TERMINAL_HANDLE *handle){
 	MESC_motor_typedef * motor_curr = &mtr[0];
@@ -81,6 +84,7 @@ uint8_t CMD_measure(TERMINAL_HANDLE * handle, uint8_t argCount, char ** args){
 	bool measure_linkage = false;
 	bool measure_hfi = false;
 	bool measure_dt = false;
+	bool measure_enc = false;
 
 	if(argCount==0){
 		measure_RL = true;
@@ -113,6 +117,9 @@ uint8_t CMD_measure(TERMINAL_HANDLE * handle, uint8_t argCount, char ** args){
 		if(strcmp(args[i], "-d")==0){
 			measure_dt = true;
 		}
+		if(strcmp(args[i], "-e")==0){
+			measure_enc = true;
+		}
 		if(strcmp(args[i], "-?")==0){
 			ttprintf("Usage: measure [flags]\r\n");
 			ttprintf("Ensure you set the measure current and voltage below the max voltage\r\n");
@@ -122,6 +129,7 @@ uint8_t CMD_measure(TERMINAL_HANDLE * handle, uint8_t argCount, char ** args){
 			ttprintf("\t -g\t Measure flux linkage threshold v2\r\n");
 			ttprintf("\t -h\t Measure HFI threshold\r\n");
 			ttprintf("\t -d\t Measure deadtime compensation\r\n");
+			ttprintf("\t -e\t Calibrate encoder offset, direction and pole pairs\r\n");
 			ttprintf("\t -c\t Specify openloop current\r\n");
 			ttprintf("\t -v\t Specify HFI voltage\r\n");
 			return TERM_CMD_EXIT_SUCCESS;
@@ -444,133 +452,394 @@ uint8_t CMD_measure(TERMINAL_HANDLE * handle, uint8_t argCount, char ** args){
 		vTaskDelay(500);
 	}
 
+	if(measure_enc){
+		if(motor_curr->encoder.source == ENCODER_SOURCE_NONE){
+			ttprintf("No encoder configured\r\n");
+			return TERM_CMD_EXIT_SUCCESS;
+		}
+		ttprintf("Calibrating encoder\r\nWaiting for result");
+		encoder_cal_start(&motor_curr->encoder);
+		motor_curr->MotorState = MOTOR_STATE_ALIGN;
+		while(motor_curr->MotorState == MOTOR_STATE_ALIGN){
+			xSemaphoreGive(port->term_block);
+			vTaskDelay(200);
+			xQueueSemaphoreTake(port->term_block, portMAX_DELAY);
+			ttprintf(".");
+		}
+
+		TERM_sendVT100Code(handle,_VT100_ERASE_LINE, 0);
+		TERM_sendVT100Code(handle,_VT100_CURSOR_SET_COLUMN, 0);
+
+		switch(motor_curr->encoder.cal.result){
+			case ENCODER_CAL_OK:
+				ttprintf("Pole pairs = %u\r\nInverted = %u\r\nOffset = %u\r\nLag = %f deg\r\n",
+						motor_curr->encoder.pole_pairs, motor_curr->FOC.encoder_polarity_invert, motor_curr->FOC.enc_offset,
+						(double)(motor_curr->encoder.cal.lag * 360.0f / 65536.0f));
+				for(uint32_t h = 0; h < ENCODER_HARMONICS; h++){
+					ttprintf("Harmonic %u = %f counts\r\n", (unsigned)(h+1),
+							(double)sqrtf(motor_curr->encoder.harm[h][0]*motor_curr->encoder.harm[h][0] + motor_curr->encoder.harm[h][1]*motor_curr->encoder.harm[h][1]));
+				}
+				ttprintf("\r\n");
+				break;
+			case ENCODER_CAL_NO_MOTION:
+				ttprintf("Encoder did not move, check the wiring and meas_curr\r\n");
+				break;
+			case ENCODER_CAL_POLES:
+				ttprintf("Pole pairs out of range or not one turn per rev, check FOC_enc_PPR\r\n");
+				break;
+			case ENCODER_CAL_GAPS:
+				ttprintf("Part of the rev was never seen, check the encoder for missed counts\r\n");
+				break;
+			default:
+				ttprintf("Encoder fault during calibration\r\n");
+				break;
+		}
+		vTaskDelay(500);
+	}
+
 
     return TERM_CMD_EXIT_SUCCESS;
 }
 
 
 void callback(TermVariableDescriptor * var){
+	encoderConfig(&mtr[0]);
 	calculateFlux(&mtr[0]);
 	calculateGains(&mtr[0]);
 	calculateVoltageGain(&mtr[0]);
 	MESCinput_Init(&mtr[0]);
 }
 
-void populate_vars(){
-	//		   | Variable							| MIN		| MAX		| NAME			| DESCRIPTION																				| RW			| CALLBACK	| VAR LIST HANDLE
-	TERM_addVar(mtr[0].m.Pmax						, 0.0f		, 50000.0f	, "par_p_max"	, "Max power"																				, VAR_ACCESS_RW	, NULL		, &TERM_varList);
-	TERM_addVar(mtr[0].m.IBatmax					, 0.0f		, 1000.0f	, "par_ibat_max", "Max battery current power"																				, VAR_ACCESS_RW	, NULL		, &TERM_varList);
-	TERM_addVar(mtr[0].m.direction					, 0			, 1			, "par_dir"		, "Motor direction"																			, VAR_ACCESS_RW	, NULL		, &TERM_varList);
-	TERM_addVar(mtr[0].m.pole_pairs					, 0			, 255		, "par_pp"		, "Motor pole pairs"																		, VAR_ACCESS_RW	, NULL		, &TERM_varList);
-	TERM_addVar(mtr[0].m.RPMmax						, 0			, 300000	, "par_rpm_max"	, "Max RPM"																					, VAR_ACCESS_RW	, NULL		, &TERM_varList);
-	TERM_addVar(mtr[0].m.flux_linkage				, 0.0f		, 100.0f	, "par_flux"	, "Flux linkage"																			, VAR_ACCESS_RW	, callback	, &TERM_varList);
-	TERM_addVar(mtr[0].m.flux_linkage_gain			, 0.0f		, 100.0f	, "FOC_flux_gain"	, "Flux linkage gain"																	, VAR_ACCESS_RW	, NULL		, &TERM_varList);
-	TERM_addVar(mtr[0].m.non_linear_centering_gain	, 0.0f		, 10000.0f	, "FOC_flux_nlin"	, "Flux centering gain"																	, VAR_ACCESS_RW	, NULL		, &TERM_varList);
-	TERM_addVar(mtr[0].m.flux_linkage_gain			, 0.0f		, 100.0f	, "FOC_flux_gain"	, "Flux linkage gain"																	, VAR_ACCESS_RW	, NULL		, &TERM_varList);
-	TERM_addVar(mtr[0].FOC.ortega_gain				, 1.0f		, 100000000.0f	, "FOC_ortega_gain"	, "Ortega gain, typically 1M"														, VAR_ACCESS_RW	, NULL		, &TERM_varList);
-	TERM_addVar(mtr[0].options.observer_type		, 0			, 4			, "FOC_obs_type", "Observer type, 0=None, 1=MXLLambda, 2MXL, 3=OrtegaOrig, 4=PLL"						, VAR_ACCESS_RW	, NULL		, &TERM_varList);
-	TERM_addVar(mtr[0].m.R							, 0.0f		, 10.0f		, "par_r"		, "Phase resistance"																		, VAR_ACCESS_RW	, callback	, &TERM_varList);
-	TERM_addVar(mtr[0].m.L_D						, 0.0f		, 10.0f		, "par_ld"		, "Phase inductance"																		, VAR_ACCESS_RW	, callback	, &TERM_varList);
-	TERM_addVar(mtr[0].m.L_Q						, 0.0f		, 10.0f		, "par_lq"		, "Phase inductance"																		, VAR_ACCESS_RW	, callback  , &TERM_varList);
-	TERM_addVar(mtr[0].FOC.Current_bandwidth		, 200.0f	, 10000.0f	, "FOC_curr_BW"	, "Current Controller Bandwidth"															, VAR_ACCESS_RW	, callback	, &TERM_varList);
-	TERM_addVar(mtr[0].HFI.Type						, 0			, 3			, "FOC_hfi_type"	, "HFI type [0=None, 1=45deg, 2=d axis]"												, VAR_ACCESS_RW	, NULL		, &TERM_varList);
-	TERM_addVar(mtr[0].meas.hfi_voltage				, 0.0f		, 50.0f		, "FOC_hfi_volt"	, "HFI voltage"																			, VAR_ACCESS_RW	, NULL		, &TERM_varList);
-	//TERM_addVar(mtr[0].HFI.mod_didq					, 0.0f		, 2.0f		, "FOC_hfi_gain"	, "HFI gain"																			, VAR_ACCESS_RW	, NULL		, &TERM_varList);
-	TERM_addVar(mtr[0].HFI.toggle_eHz				, 0.0f		, 2000.0f	, "FOC_hfi_eHz"	, "HFI Max Frequency"																		, VAR_ACCESS_RW	, NULL		, &TERM_varList);
-	TERM_addVar(mtr[0].FOC.FW_curr_max				, 0.0f		, 300.0f	, "par_fw_curr"		, "Max field weakenning current"														, VAR_ACCESS_RW	, NULL		, &TERM_varList);
-	TERM_addVar(mtr[0].meas.measure_current			, 0.5f		, 100.0f	, "meas_curr"	, "Measuring current"																		, VAR_ACCESS_RW	, NULL		, &TERM_varList);
-	TERM_addVar(mtr[0].meas.measure_closedloop_current, 0.5f	, 100.0f	, "meas_cl_curr", "Measuring q closed loop current"															, VAR_ACCESS_RW	, NULL		, &TERM_varList);
-	TERM_addVar(mtr[0].meas.measure_voltage			, 0.5f		, 100.0f	, "meas_volt"	, "Measuring voltage"																		, VAR_ACCESS_RW	, NULL		, &TERM_varList);
-	TERM_addVar(mtr[0].input_vars.adc1_MAX			, 0			, 4096		, "adc1_max"	, "ADC1 max val"																			, VAR_ACCESS_RW	, NULL		, &TERM_varList);
-	TERM_addVar(mtr[0].input_vars.adc1_MIN			, 0			, 4096		, "adc1_min"	, "ADC1 min val"																			, VAR_ACCESS_RW	, NULL		, &TERM_varList);
-	TERM_addVar(mtr[0].input_vars.ADC1_polarity		, -1.0f		, 1.0f		, "adc1_pol"	, "ADC1 polarity"																			, VAR_ACCESS_RW	, NULL		, &TERM_varList);
-	TERM_addVar(mtr[0].input_vars.adc2_MAX			, 0			, 4096		, "adc2_max"	, "ADC2 max val"																			, VAR_ACCESS_RW	, NULL		, &TERM_varList);
-	TERM_addVar(mtr[0].input_vars.adc2_MIN			, 0			, 4096		, "adc2_min"	, "ADC2 min val"																			, VAR_ACCESS_RW	, NULL		, &TERM_varList);
-	TERM_addVar(mtr[0].input_vars.ADC2_polarity		, -1.0f		, 1.0f		, "adc2_pol"	, "ADC2 polarity"																			, VAR_ACCESS_RW	, NULL		, &TERM_varList);
-	TERM_addVar(mtr[0].input_vars.max_request_Idq.q	, 0.0f		, 1000.0f	, "par_i_max"	, "Max motor current"																		, VAR_ACCESS_RW	, callback	, &TERM_varList);
-	TERM_addVar(mtr[0].input_vars.min_request_Idq.q	, -1000.0f	, 0.0f		, "par_i_min"	, "Min motor current"																		, VAR_ACCESS_RW	, callback	, &TERM_varList);
-	TERM_addVar(mtr[0].FOC.pwm_frequency			, 0.0f		, 100000.0f	, "FOC_fpwm"	, "PWM frequency"																			, VAR_ACCESS_RW	, callback	, &TERM_varList);
-	TERM_addVar(mtr[0].FOC.Modulation_max			, 0.1f		, 1.12f	, 	"FOC_Max_Mod"	, "Max modulation index; typically 0.95, can over modulate to 1.12"							, VAR_ACCESS_RW	, callback	, &TERM_varList);
-	TERM_addVar(mtr[0].input_vars.UART_req			, -1000.0f	, 1000.0f	, "uart_req"	, "Uart input"																				, VAR_ACCESS_RW	, NULL		, &TERM_varList);
-	TERM_addVar(mtr[0].input_vars.UART_dreq			, -1000.0f	, 1000.0f	, "uart_dreq"	, "Uart input"																				, VAR_ACCESS_RW	, NULL		, &TERM_varList);
-	TERM_addVar(mtr[0].input_vars.input_options		, 0			, 128		, "input_opt"	, "Inputs [1=ADC1 2=ADC2 4=PPM 8=UART 16=Killswitch 32=CANADC1 64=CANADC2 128=ADC12DIFF]"	, VAR_ACCESS_RW	, callback	, &TERM_varList);
-	TERM_addVar(mtr[0].safe_start[0]				, 0			, 1000		, "safe_start"	, "Countdown before allowing throttle"														, VAR_ACCESS_RW	, NULL		, &TERM_varList);
-	TERM_addVar(mtr[0].safe_start[1]				, 0			, 1000		, "safe_count"	, "Live count before allowing throttle"														, VAR_ACCESS_R	, NULL		, &TERM_varList);
-	TERM_addVar(mtr[0].FOC.enc_offset				, 0			, 65535		, "FOC_enc_oset", "Encoder alignment angle"																	, VAR_ACCESS_RW	, NULL		, &TERM_varList);
-	TERM_addVar(mtr[0].FOC.FOCAngle					, 0			, 65535		, "FOC_angle"	, "FOC angle now"																			, VAR_ACCESS_RW	, NULL		, &TERM_varList);
-	TERM_addVar(mtr[0].FOC.enc_angle				, 0			, 65535		, "FOC_enc_ang"	, "Encoder angle now"																		, VAR_ACCESS_RW	, NULL		, &TERM_varList);
-	TERM_addVar(mtr[0].m.enc_counts					, 0			, 65535		, "FOC_enc_PPR"	, "Encoder ABI PPR"																			, VAR_ACCESS_RW	, callback	, &TERM_varList);
-	TERM_addVar(mtr[0].FOC.encoder_polarity_invert	, 0			, 1			, "FOC_enc_pol"	, "Encoder polarity"																		, VAR_ACCESS_RW	, NULL		, &TERM_varList);
-	TERM_addVar(mtr[0].MotorSensorMode				, 0			, 30		, "par_motor_sensor", "0=SL, 1=Hall, 2=OL, 3=ABSENC, 4=INC_ENC, 5=HFI"										, VAR_ACCESS_RW	, NULL		, &TERM_varList);
-	TERM_addVar(mtr[0].SLStartupSensor				, 0			, 30		, "par_SL_sensor"	, "0=OL, 1=Hall, 2=PWMENC, 3=HFI"														, VAR_ACCESS_RW	, NULL		, &TERM_varList);
-	TERM_addVar(mtr[0].FOC.openloop_step			, 0.0f		, 6000.0f	, "FOC_ol_step"	, "Angle per PWM period openloop (65535 per erev)"											, VAR_ACCESS_RW	, NULL		, &TERM_varList);
-	TERM_addVar(mtr[0].FOC.FW_ehz_max				, 0.0f		, 6000.0f	, "FOC_fw_ehz"	, "max eHz under field weakenning"															, VAR_ACCESS_RW	, callback	, &TERM_varList);
-	TERM_addVar(mtr[0].FOC.park_current				, 0.0f		, 300.0f	, "par_i_park"	, "Max current for handbrake"																, VAR_ACCESS_RW	, callback	, &TERM_varList);
-	TERM_addVar(mtr[0].FOC.hall_IIR					, 0.0f		, 1.0f		, "FOC_hall_iir", "Decay constant for hall preload (0-1.0)"													, VAR_ACCESS_RW	, callback	, &TERM_varList);
-	TERM_addVar(mtr[0].FOC.hall_transition_V		, 0.0f		, 100.0f	, "FOC_hall_Vt"	, "Hall transition voltage"																	, VAR_ACCESS_RW	, callback	, &TERM_varList);
-	TERM_addVar(mtr[0].FOC.hall_initialised			, 0			, 1			, "FOC_hall_array_ok"	, "Hall array OK flag (set to 0 to restart live hall cal process)"					, VAR_ACCESS_RW	, NULL		, &TERM_varList);
-	TERM_addVar(MESC_all_errors						, -HUGE_VAL	, HUGE_VAL	, "error_all"	, "All errors encountered"																	, VAR_ACCESS_R	, NULL		, &TERM_varList);
-	TERM_addVar(mtr[0].options.field_weakening		, 0			, 2			, "opt_fw"		, "Field weakening [0=OFF, 1=ON, 2=ON V2]"													, VAR_ACCESS_RW	, NULL		, &TERM_varList);
-	TERM_addVar(mtr[0].options.sqrt_circle_lim		, 0			, 2			, "opt_circ_lim", "Circle limiter [0=OFF, 1=ON, 2=ON Vd]"													, VAR_ACCESS_RW	, NULL		, &TERM_varList);
-	TERM_addVar(mtr[0].options.pwm_type				, 0			, 3			, "opt_pwm_type", "Modulator [0=SVPWM, 1=sinusoidal, 2=Bottom clamp, 3=Sin/bottom combo]"					, VAR_ACCESS_RW	, NULL		, &TERM_varList);
-	TERM_addVar(mtr[0].options.MTPA_mode			, 0			, 3			, "opt_mtpa"	, "MTPA type = 0=none, 1=setpoint, 2=magnitude, 3=iq"										, VAR_ACCESS_RW	, NULL		, &TERM_varList);
-	TERM_addVar(mtr[0].options.use_hall_start		, 0			, 1			, "opt_hall_start", "Use hall start"																		, VAR_ACCESS_RW	, NULL		, &TERM_varList);
-	TERM_addVar(mtr[0].options.use_phase_balancing	, 0			, 1			, "opt_phase_bal", "Use highhopes phase balancing"															, VAR_ACCESS_RW	, NULL		, &TERM_varList);
-	TERM_addVar(mtr[0].options.use_lr_observer		, 0			, 1			, "opt_lr_obs"  , "Use LR observer"																			, VAR_ACCESS_RW	, NULL		, &TERM_varList);
-	TERM_addVar(mtr[0].options.has_motor_temp_sensor, 0			, 1			, "opt_motor_temp"  , "Motor has temperature sensor"														, VAR_ACCESS_RW	, NULL		, &TERM_varList);
-	TERM_addVar(mtr[0].options.app_type				, 0			, 3			, "opt_app_type"  , "App type, 0=none, 1=Vehicle, 2,3 = undefined"											, VAR_ACCESS_RW	, NULL		, &TERM_varList);
-	TERM_addVar(mtr[0].ControlMode					, 0			, 4			, "opt_cont_type"  , "Cont type: 0=Torque, 1=Speed, 2=Duty, 3=Position, 4=Measuring, 5=Handbrake"			, VAR_ACCESS_RW	, NULL		, &TERM_varList);
-	TERM_addVar(mtr[0].FOC.FOC_advance				, -10.0f	, 10.0f		, "FOC_Advance"	, "FOC advance, proportion of 1 PWM cycle"													, VAR_ACCESS_RW	, callback	, &TERM_varList);
-	TERM_addVar(mtr[0].FOC.speed_kp					, 0.0f		, 6000000.0f, "speed_kp"	, "amps/Hz proportional gain"																, VAR_ACCESS_RW	, callback	, &TERM_varList);
-	TERM_addVar(mtr[0].FOC.speed_ki					, 0.0f		, 6000000.0f, "speed_ki"	, "amps/Hz integral gain"																	, VAR_ACCESS_RW	, callback	, &TERM_varList);
-	TERM_addVar(mtr[0].FOC.speed_req				, 0.0f		, 5000.0f	, "speed_req"	, "Hz"																						, VAR_ACCESS_RW	, callback	, &TERM_varList);
+//Kept in flash, only the list nodes below live in RAM
+static const TermVariableInfo mesc_vars[] = {
+	//		   | Variable							| MIN		| MAX		| NAME			| DESCRIPTION																				| RW			| CALLBACK	| FLAGS
+	TERM_VAR_FLOAT(mtr[0].m.Pmax						, 0.0f		, 50000.0f	, "par_p_max"	, "Max power"																				, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(mtr[0].m.IBatmax					, 0.0f		, 1000.0f	, "par_ibat_max", "Max battery current power"																				, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_UNSIGNED(mtr[0].m.direction					, 0			, 1			, "par_dir"		, "Motor direction"																			, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_UNSIGNED(mtr[0].m.pole_pairs					, 0			, 255		, "par_pp"		, "Motor pole pairs"																		, VAR_ACCESS_RW	, callback	, 0),
+	TERM_VAR_UNSIGNED(mtr[0].m.RPMmax						, 0			, 300000	, "par_rpm_max"	, "Max RPM"																					, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(mtr[0].m.flux_linkage				, 0.0f		, 100.0f	, "par_flux"	, "Flux linkage"																			, VAR_ACCESS_RW	, callback	, 0),
+	TERM_VAR_FLOAT(mtr[0].m.flux_linkage_gain			, 0.0f		, 100.0f	, "FOC_flux_gain"	, "Flux linkage gain"																	, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(mtr[0].m.non_linear_centering_gain	, 0.0f		, 10000.0f	, "FOC_flux_nlin"	, "Flux centering gain"																	, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(mtr[0].m.flux_linkage_gain			, 0.0f		, 100.0f	, "FOC_flux_gain"	, "Flux linkage gain"																	, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(mtr[0].FOC.ortega_gain				, 1.0f		, 100000000.0f	, "FOC_ortega_gain"	, "Ortega gain, typically 1M"														, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_UNSIGNED(mtr[0].options.observer_type		, 0			, 4			, "FOC_obs_type", "Observer type, 0=None, 1=MXLLambda, 2MXL, 3=OrtegaOrig, 4=PLL"						, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(mtr[0].m.R							, 0.0f		, 10.0f		, "par_r"		, "Phase resistance"																		, VAR_ACCESS_RW	, callback	, 0),
+	TERM_VAR_FLOAT(mtr[0].m.L_D						, 0.0f		, 10.0f		, "par_ld"		, "Phase inductance"																		, VAR_ACCESS_RW	, callback	, 0),
+	TERM_VAR_FLOAT(mtr[0].m.L_Q						, 0.0f		, 10.0f		, "par_lq"		, "Phase inductance"																		, VAR_ACCESS_RW	, callback  , 0),
+	TERM_VAR_FLOAT(mtr[0].FOC.Current_bandwidth		, 200.0f	, 10000.0f	, "FOC_curr_BW"	, "Current Controller Bandwidth"															, VAR_ACCESS_RW	, callback	, 0),
+	TERM_VAR_UNSIGNED(mtr[0].HFI.Type						, 0			, 3			, "FOC_hfi_type"	, "HFI type [0=None, 1=45deg, 2=d axis]"												, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(mtr[0].meas.hfi_voltage				, 0.0f		, 50.0f		, "FOC_hfi_volt"	, "HFI voltage"																			, VAR_ACCESS_RW	, NULL		, 0),
+	//TERM_VAR_FLOAT(mtr[0].HFI.mod_didq					, 0.0f		, 2.0f		, "FOC_hfi_gain"	, "HFI gain"																			, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(mtr[0].HFI.toggle_eHz				, 0.0f		, 2000.0f	, "FOC_hfi_eHz"	, "HFI Max Frequency"																		, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(mtr[0].FOC.FW_curr_max				, 0.0f		, 300.0f	, "par_fw_curr"		, "Max field weakenning current"														, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(mtr[0].meas.measure_current			, 0.5f		, 100.0f	, "meas_curr"	, "Measuring current"																		, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(mtr[0].meas.measure_closedloop_current, 0.5f	, 100.0f	, "meas_cl_curr", "Measuring q closed loop current"															, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(mtr[0].meas.measure_voltage			, 0.5f		, 100.0f	, "meas_volt"	, "Measuring voltage"																		, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_UNSIGNED(mtr[0].input_vars.adc1_MAX			, 0			, 4096		, "adc1_max"	, "ADC1 max val"																			, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_UNSIGNED(mtr[0].input_vars.adc1_MIN			, 0			, 4096		, "adc1_min"	, "ADC1 min val"																			, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(mtr[0].input_vars.ADC1_polarity		, -1.0f		, 1.0f		, "adc1_pol"	, "ADC1 polarity"																			, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_UNSIGNED(mtr[0].input_vars.adc2_MAX			, 0			, 4096		, "adc2_max"	, "ADC2 max val"																			, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_UNSIGNED(mtr[0].input_vars.adc2_MIN			, 0			, 4096		, "adc2_min"	, "ADC2 min val"																			, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(mtr[0].input_vars.ADC2_polarity		, -1.0f		, 1.0f		, "adc2_pol"	, "ADC2 polarity"																			, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(mtr[0].input_vars.max_request_Idq.q	, 0.0f		, 1000.0f	, "par_i_max"	, "Max motor current"																		, VAR_ACCESS_RW	, callback	, 0),
+	TERM_VAR_FLOAT(mtr[0].input_vars.min_request_Idq.q	, -1000.0f	, 0.0f		, "par_i_min"	, "Min motor current"																		, VAR_ACCESS_RW	, callback	, 0),
+	TERM_VAR_FLOAT(mtr[0].FOC.pwm_frequency			, 0.0f		, 100000.0f	, "FOC_fpwm"	, "PWM frequency"																			, VAR_ACCESS_RW	, callback	, 0),
+	TERM_VAR_FLOAT(mtr[0].FOC.Modulation_max			, 0.1f		, 1.12f	, 	"FOC_Max_Mod"	, "Max modulation index; typically 0.95, can over modulate to 1.12"							, VAR_ACCESS_RW	, callback	, 0),
+	TERM_VAR_FLOAT(mtr[0].input_vars.UART_req			, -1000.0f	, 1000.0f	, "uart_req"	, "Uart input"																				, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(mtr[0].input_vars.UART_dreq			, -1000.0f	, 1000.0f	, "uart_dreq"	, "Uart input"																				, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_UNSIGNED(mtr[0].input_vars.input_options		, 0			, 128		, "input_opt"	, "Inputs [1=ADC1 2=ADC2 4=PPM 8=UART 16=Killswitch 32=CANADC1 64=CANADC2 128=ADC12DIFF]"	, VAR_ACCESS_RW	, callback	, 0),
+	TERM_VAR_UNSIGNED(mtr[0].input_vars.arb_mode			, 0			, 1			, "in_arb"		, "Input arbitration [0=Sum, 1=Highest *_prio nonzero source]"				, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_BOOL(mtr[0].input_vars.filt[INFILT_SRC_ADC1].median		, 0			, 1			, "adc1_med"	, "ADC1 median of 3 filter, drops single sample spikes"						, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(mtr[0].input_vars.filt[INFILT_SRC_ADC1].tau		, 0.0f		, 10.0f		, "adc1_tau"	, "ADC1 filter time constant, s, 0=off"										, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(mtr[0].input_vars.filt[INFILT_SRC_ADC1].deadband	, 0.0f		, 0.5f		, "adc1_db"	, "ADC1 deadband after filtering, fraction of full scale"						, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(mtr[0].input_vars.filt[INFILT_SRC_ADC1].rate_up	, 0.0f		, 1000.0f	, "adc1_rup"	, "ADC1 rate limit rising, full scale/s, 0=off"								, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(mtr[0].input_vars.filt[INFILT_SRC_ADC1].rate_down	, 0.0f		, 1000.0f	, "adc1_rdn"	, "ADC1 rate limit falling, full scale/s, 0=off"								, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(mtr[0].input_vars.filt[INFILT_SRC_ADC1].timeout	, 0.01f		, 10.0f		, "adc1_tmo"	, "ADC1 invalid input held for, s"											, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_UNSIGNED(mtr[0].input_vars.filt[INFILT_SRC_ADC1].priority	, 0			, 255		, "adc1_prio"	, "ADC1 priority with in_arb=1, higher wins"									, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_BOOL(mtr[0].input_vars.filt[INFILT_SRC_ADC2].median		, 0			, 1			, "adc2_med"	, "ADC2 median of 3 filter, drops single sample spikes"						, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(mtr[0].input_vars.filt[INFILT_SRC_ADC2].tau		, 0.0f		, 10.0f		, "adc2_tau"	, "ADC2 filter time constant, s, 0=off"										, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(mtr[0].input_vars.filt[INFILT_SRC_ADC2].deadband	, 0.0f		, 0.5f		, "adc2_db"	, "ADC2 deadband after filtering, fraction of full scale"						, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(mtr[0].input_vars.filt[INFILT_SRC_ADC2].rate_up	, 0.0f		, 1000.0f	, "adc2_rup"	, "ADC2 rate limit rising, full scale/s, 0=off"								, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(mtr[0].input_vars.filt[INFILT_SRC_ADC2].rate_down	, 0.0f		, 1000.0f	, "adc2_rdn"	, "ADC2 rate limit falling, full scale/s, 0=off"								, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(mtr[0].input_vars.filt[INFILT_SRC_ADC2].timeout	, 0.01f		, 10.0f		, "adc2_tmo"	, "ADC2 invalid input held for, s"											, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_UNSIGNED(mtr[0].input_vars.filt[INFILT_SRC_ADC2].priority	, 0			, 255		, "adc2_prio"	, "ADC2 priority with in_arb=1, higher wins"									, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_BOOL(mtr[0].input_vars.filt[INFILT_SRC_RCPWM].median		, 0			, 1			, "ppm_med"	, "PPM median of 3 filter, drops single sample spikes"						, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(mtr[0].input_vars.filt[INFILT_SRC_RCPWM].tau		, 0.0f		, 10.0f		, "ppm_tau"	, "PPM filter time constant, s, 0=off"										, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(mtr[0].input_vars.filt[INFILT_SRC_RCPWM].rate_up	, 0.0f		, 1000.0f	, "ppm_rup"	, "PPM rate limit rising, full scale/s, 0=off"								, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(mtr[0].input_vars.filt[INFILT_SRC_RCPWM].rate_down	, 0.0f		, 1000.0f	, "ppm_rdn"	, "PPM rate limit falling, full scale/s, 0=off"								, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(mtr[0].input_vars.filt[INFILT_SRC_RCPWM].timeout	, 0.01f		, 10.0f		, "ppm_tmo"	, "PPM invalid input held for, s"											, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_UNSIGNED(mtr[0].input_vars.filt[INFILT_SRC_RCPWM].priority	, 0			, 255		, "ppm_prio"	, "PPM priority with in_arb=1, higher wins"									, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_SIGNED(mtr[0].safe_start[0]				, 0			, 1000		, "safe_start"	, "Countdown before allowing throttle"														, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_SIGNED(mtr[0].safe_start[1]				, 0			, 1000		, "safe_count"	, "Live count before allowing throttle"														, VAR_ACCESS_R	, NULL		, 0),
+	TERM_VAR_UNSIGNED(mtr[0].FOC.enc_offset				, 0			, 65535		, "FOC_enc_oset", "Encoder alignment angle"																	, VAR_ACCESS_RW	, callback	, 0),
+	TERM_VAR_UNSIGNED(mtr[0].FOC.FOCAngle					, 0			, 65535		, "FOC_angle"	, "FOC angle now"																			, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_UNSIGNED(mtr[0].FOC.enc_angle				, 0			, 65535		, "FOC_enc_ang"	, "Encoder angle now"																		, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_UNSIGNED(mtr[0].m.enc_counts					, 0			, 65535		, "FOC_enc_PPR"	, "Encoder ABI counts per rev"																, VAR_ACCESS_RW	, callback	, 0),
+	TERM_VAR_UNSIGNED(mtr[0].FOC.encoder_polarity_invert	, 0			, 1			, "FOC_enc_pol"	, "Encoder polarity"																		, VAR_ACCESS_RW	, callback	, 0),
+	TERM_VAR_FLOAT(mtr[0].encoder.bw					, 1.0f		, 5000.0f	, "enc_bw"		, "Encoder speed tracking bandwidth, Hz"													, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(mtr[0].encoder.delay				, 0.0f		, 0.01f		, "enc_delay"	, "Encoder sensor delay, s"																	, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(mtr[0].encoder.advance				, -2.0f		, 2.0f		, "enc_adv"		, "Encoder angle carried forward, PWM periods"												, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(mtr[0].encoder.eHz					, -10000.0f	, 10000.0f	, "enc_eHz"		, "Encoder speed, eHz"																		, VAR_ACCESS_R	, NULL		, 0),
+	TERM_VAR_UNSIGNED(mtr[0].encoder.errors				, 0			, UINT32_MAX	, "enc_err"		, "Encoder read errors"																		, VAR_ACCESS_R	, NULL		, 0),
+	TERM_VAR_UNSIGNED(mtr[0].encoder.index_errors			, 0			, UINT32_MAX	, "enc_idx_err"	, "Encoder index disagreed with the count"													, VAR_ACCESS_R	, NULL		, 0),
+	TERM_VAR_FLOAT(mtr[0].encoder.cal.speed			, 0.1f		, 20.0f		, "enc_cal_spd"	, "Encoder calibration sweep, erev/s"														, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_ARRAY_FLOAT(mtr[0].encoder.harm			, -1000.0f	, 1000.0f	, "enc_harm"	, "Encoder position correction, counts, cos and sin of each mechanical harmonic"		, VAR_ACCESS_RW	, callback	, 0),
+	TERM_VAR_UNSIGNED(mtr[0].MotorSensorMode				, 0			, 30		, "par_motor_sensor", "0=SL, 1=Hall, 2=OL, 3=ABSENC, 4=INC_ENC, 5=HFI"										, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_UNSIGNED(mtr[0].SLStartupSensor				, 0			, 30		, "par_SL_sensor"	, "0=OL, 1=Hall, 2=PWMENC, 3=HFI"														, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_UNSIGNED(mtr[0].FOC.openloop_step			, 0			, 6000		, "FOC_ol_step"	, "Angle per PWM period openloop (65535 per erev)"											, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(mtr[0].FOC.FW_ehz_max				, 0.0f		, 6000.0f	, "FOC_fw_ehz"	, "max eHz under field weakenning"															, VAR_ACCESS_RW	, callback	, 0),
+	TERM_VAR_FLOAT(mtr[0].FOC.park_current				, 0.0f		, 300.0f	, "par_i_park"	, "Max current for handbrake"																, VAR_ACCESS_RW	, callback	, 0),
+	TERM_VAR_FLOAT(mtr[0].FOC.hall_IIR					, 0.0f		, 1.0f		, "FOC_hall_iir", "Decay constant for hall preload (0-1.0)"													, VAR_ACCESS_RW	, callback	, 0),
+	TERM_VAR_FLOAT(mtr[0].FOC.hall_transition_V		, 0.0f		, 100.0f	, "FOC_hall_Vt"	, "Hall transition voltage"																	, VAR_ACCESS_RW	, callback	, 0),
+	TERM_VAR_UNSIGNED(mtr[0].FOC.hall_initialised			, 0			, 1			, "FOC_hall_array_ok"	, "Hall array OK flag (set to 0 to restart live hall cal process)"					, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_UNSIGNED(MESC_all_errors						, 0        	, UINT32_MAX	, "error_all"	, "All errors encountered"																	, VAR_ACCESS_R	, NULL		, 0),
+	TERM_VAR_UNSIGNED(mtr[0].options.field_weakening		, 0			, 2			, "opt_fw"		, "Field weakening [0=OFF, 1=ON, 2=ON V2]"													, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_UNSIGNED(mtr[0].options.sqrt_circle_lim		, 0			, 2			, "opt_circ_lim", "Circle limiter [0=OFF, 1=ON, 2=ON Vd]"													, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_UNSIGNED(mtr[0].options.pwm_type				, 0			, 4			, "opt_pwm_type", "Modulator [0=SVPWM, 1=sinusoidal, 2=Bottom clamp, 3=Sin/bottom combo, 4=DPWM]"			, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_UNSIGNED(mtr[0].dpwm.type					, 0			, 6			, "dpwm_type"	, "DPWM [0=DPWM0, 1=DPWM1, 2=DPWM2, 3=MAX, 4=MIN, 5=GDPWM, 6=Auto]"						, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(mtr[0].dpwm.m_min					, 0.0f		, 1.2f		, "dpwm_m_min"	, "Modulation index below which auto DPWM stays continuous"							, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_BOOL(mtr[0].options.use_pwm_scheduler	, 0			, 1			, "opt_fsched"	, "Schedule PWM frequency from speed and FET temperature"						, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(mtr[0].fsched.f_min					, 1000.0f	, 100000.0f	, "fsched_fmin"	, "Scheduler PWM frequency at standstill or hot"								, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(mtr[0].fsched.f_max					, 1000.0f	, 100000.0f	, "fsched_fmax"	, "Scheduler PWM frequency at speed"											, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(mtr[0].fsched.eHz_lo				, 0.0f		, 5000.0f	, "fsched_ehz_lo", "eHz below which fsched_fmin is used"											, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(mtr[0].fsched.eHz_hi				, 0.0f		, 5000.0f	, "fsched_ehz_hi", "eHz above which fsched_fmax is used"											, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(mtr[0].fsched.T_lo					, 0.0f		, 200.0f	, "fsched_t_lo"	, "FET temperature at which the frequency starts to derate"						, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(mtr[0].fsched.T_hi					, 0.0f		, 200.0f	, "fsched_t_hi"	, "FET temperature at which the frequency reaches fsched_fmin"					, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_UNSIGNED(health.stack_warn					, 0			, 4096		, "health_stack", "Warn when a task has fewer stack words than this left"						, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(health.isr_warn						, 0.0f		, 1.0f		, "health_isr"	, "Warn when the worst ISR takes this fraction of a PWM period"				, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_UNSIGNED(health.overrun_warn					, 0			, 100000	, "health_ovr"	, "Warn when more ISR overruns than this occur per check"						, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_UNSIGNED(mtr[0].apll.type					, 0			, 2			, "pll_type"	, "Speed tracker, 0=Fixed PLL, 1=Adaptive PI, 2=Adaptive with acceleration"		, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(mtr[0].apll.bw_min					, 10.0f		, 20000.0f	, "pll_bw_min"	, "Adaptive PLL bandwidth at standstill, rad/s"									, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(mtr[0].apll.bw_max					, 10.0f		, 20000.0f	, "pll_bw_max"	, "Adaptive PLL bandwidth limit, rad/s"											, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(mtr[0].apll.bw_ratio				, 0.0f		, 20.0f		, "pll_bw_ratio", "Adaptive PLL bandwidth per rad/s of electrical speed"						, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(mtr[0].apll.noise_ref				, 1.0f		, 10000.0f	, "pll_noise"	, "Angle noise (counts RMS) at which the adaptive PLL halves its bandwidth"		, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(mtr[0].apll.bw						, 0.0f		, 100000.0f	, "pll_bw"		, "Adaptive PLL bandwidth in use, rad/s"										, VAR_ACCESS_R	, NULL		, 0),
+	TERM_VAR_BOOL(mtr[0].options.use_hall_estimator	, 0			, 1			, "opt_hall_est", "Hall estimator with learned edges, blended into the observer"				, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(mtr[0].hallest.eHz_lo				, 0.0f		, 1000.0f	, "hall_est_lo"	, "eHz below which the hall estimator is used alone"							, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(mtr[0].hallest.eHz_hi				, 0.0f		, 1000.0f	, "hall_est_hi"	, "eHz above which the flux observer is used alone"								, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_BOOL(mtr[0].options.use_bat_limits		, 0			, 1			, "opt_bat_lim"	, "Limit battery current from the pack model to keep Vbus within the cell range"	, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(mtr[0].bat.C						, 0.0f		, 10000.0f	, "bat_ah"		, "Battery charge held, Ah"														, VAR_ACCESS_R	, NULL		, 0),
+	TERM_VAR_FLOAT(mtr[0].bat.R						, 0.0f		, 100.0f	, "bat_r"		, "Battery internal resistance estimate, ohm"									, VAR_ACCESS_R	, NULL		, 0),
+	TERM_VAR_FLOAT(mtr[0].bat.Idis						, 0.0f		, 10000.0f	, "bat_idis"	, "Battery discharge current limit, A"											, VAR_ACCESS_R	, NULL		, 0),
+	TERM_VAR_FLOAT(mtr[0].bat.Ichg						, 0.0f		, 10000.0f	, "bat_ichg"	, "Battery charge current limit, A"												, VAR_ACCESS_R	, NULL		, 0),
+	TERM_VAR_BOOL(mtr[0].options.use_thermal_model	, 0			, 1			, "opt_thermal"	, "Taper current on the predicted winding and junction temperatures"				, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(mtr[0].thermal.motor.R_fast			, 0.0001f	, 100.0f	, "th_mtr_r"	, "Winding to stator thermal resistance, K/W"									, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(mtr[0].thermal.motor.C_fast			, 0.01f		, 100000.0f	, "th_mtr_c"	, "Winding heat capacity, J/K"													, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(mtr[0].thermal.fet.R_fast			, 0.0001f	, 100.0f	, "th_fet_r"	, "FET junctions to heatsink thermal resistance, K/W"							, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(mtr[0].thermal.fet.C_fast			, 0.01f		, 100000.0f	, "th_fet_c"	, "FET junctions heat capacity, J/K"											, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(mtr[0].thermal.Rds_on				, 0.0f		, 1.0f		, "th_rds"		, "FET Rds_on at 25C, ohm"														, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(mtr[0].thermal.t_sw					, 0.0f		, 0.00001f	, "th_tsw"		, "FET switching time per transition, s"										, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(mtr[0].thermal.motor.T_fast			, 0.0f		, 1000.0f	, "th_winding"	, "Predicted winding temperature, K"											, VAR_ACCESS_R	, NULL		, 0),
+	TERM_VAR_FLOAT(mtr[0].thermal.fet.T_fast			, 0.0f		, 1000.0f	, "th_junction"	, "Predicted FET junction temperature, K"										, VAR_ACCESS_R	, NULL		, 0),
+	TERM_VAR_UNSIGNED(mtr[0].pos.set_position				, 0			, UINT32_MAX	, "pos_target"	, "Position target, counts (65536 per erev)"									, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(mtr[0].pos.traj.v_max				, 0.01f		, 10000.0f	, "pos_vmax"	, "Position move speed limit, eHz"												, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(mtr[0].pos.traj.a_max				, 0.01f		, 1000000.0f, "pos_amax"	, "Position move acceleration limit, eHz/s"										, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(mtr[0].pos.traj.j_max				, 0.01f		, 100000000.0f, "pos_jmax"	, "Position move jerk limit, eHz/s^2"											, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(mtr[0].pos.traj.Kp					, 0.0f		, 1000.0f	, "pos_kp"		, "Position error to speed gain, 1/s"											, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(mtr[0].FOC.inertia					, 0.0f		, 10.0f		, "par_inertia"	, "Rotor inertia for the position and speed feedforwards, kg m^2"				, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_UNSIGNED(mtr[0].speedloop.decimation			, 1			, 1000		, "spd_dec"		, "Fastloop cycles per speed loop call"											, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(mtr[0].speedloop.aw					, 0.0f		, 100.0f	, "spd_aw"		, "Speed loop back calculation anti-windup gain, relative to ki"				, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_BOOL(mtr[0].speedloop.use_acc_ff			, 0			, 1			, "spd_acc_ff"	, "Feed the speed request slope forward through par_inertia"					, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_BOOL(mtr[0].speedloop.use_load_ff			, 0			, 1			, "spd_load_ff"	, "Feed the observed load torque forward, needs par_inertia"					, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(mtr[0].speedloop.load_bw				, 1.0f		, 10000.0f	, "spd_load_bw"	, "Load observer bandwidth, rad/s"												, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(mtr[0].speedloop.I_load				, -1000.0f	, 1000.0f	, "spd_load"	, "Observed load, A of q current"												, VAR_ACCESS_R	, NULL		, 0),
+	TERM_VAR_BOOL(mtr[0].options.use_sixstep				, 0			, 1			, "opt_sixstep"	, "Hand over to sensorless six-step above ss_handover in torque mode"			, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_UNSIGNED(mtr[0].sixstep.mode					, 0			, 1			, "ss_mode"		, "Six-step commutation [0=ZC timing, 1=BEMF integration]"						, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(mtr[0].sixstep.advance					, 0.0f		, 0.5f		, "ss_adv"		, "Six-step timing advance, rad electrical"										, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(mtr[0].sixstep.eHz_handover			, 0.0f		, 10000.0f	, "ss_handover"	, "Six-step handover speed, eHz"												, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(mtr[0].sixstep.flux_th					, 0.0f		, 1.0f		, "ss_flux"		, "BEMF integral from ZC to commutation at zero advance, V s"					, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_UNSIGNED(mtr[0].sixstep.sector				, 0			, 5			, "ss_sector"	, "Six-step sector"																, VAR_ACCESS_R	, NULL		, 0),
+	TERM_VAR_BOOL(mtr[0].sixstep.locked					, 0			, 1			, "ss_locked"	, "Six-step synchronised to the BEMF crossings"									, VAR_ACCESS_R	, NULL		, 0),
+	TERM_VAR_UNSIGNED(mtr[0].options.overmod_type			, 0			, 2			, "opt_overmod"	, "Overmodulation [0=OFF, 1=Min phase error, 2=Into six-step] raise FOC_Max_Mod up to 1.1027"	, VAR_ACCESS_RW	, callback	, 0),
+	TERM_VAR_UNSIGNED(mtr[0].options.MTPA_mode			, 0			, 3			, "opt_mtpa"	, "MTPA type = 0=none, 1=setpoint, 2=magnitude, 3=iq"										, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_BOOL(mtr[0].options.use_hall_start		, 0			, 1			, "opt_hall_start", "Use hall start"																		, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_BOOL(mtr[0].options.use_phase_balancing	, 0			, 1			, "opt_phase_bal", "Use highhopes phase balancing"															, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_BOOL(mtr[0].options.use_lr_observer		, 0			, 1			, "opt_lr_obs"  , "Use LR observer"																			, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_BOOL(mtr[0].options.has_motor_temp_sensor, 0			, 1			, "opt_motor_temp"  , "Motor has temperature sensor"														, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_UNSIGNED(mtr[0].options.app_type				, 0			, 3			, "opt_app_type"  , "App type, 0=none, 1=Vehicle, 2,3 = undefined"											, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_UNSIGNED(vehicle.state						, 0			, 4			, "veh_state"	, "Vehicle [0=Parked, 1=Drive, 2=Reverse, 3=Cruise, 4=Error]"					, VAR_ACCESS_R	, NULL		, 0),
+	TERM_VAR_UNSIGNED(vehicle.mode						, 0			, 2			, "veh_mode"	, "Ride mode [0=Eco, 1=Normal, 2=Sport]"										, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(vehicle.reverse_scale					, 0.0f		, 1.0f		, "veh_rev_scale", "Reverse current and speed, fraction of the ride mode"						, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(vehicle.eHz_cruise						, 0.0f		, 10000.0f	, "veh_cruise"	, "Cruise engages above, eHz"													, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(vehicle.park_time						, 0.0f		, 3600.0f	, "veh_park_time", "Park after standing still with the throttle closed, s"						, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(vehicle.modes[0].I_max				, 0.0f		, 1.0f		, "veh_imax0"	, "Ride mode 0 motoring current, fraction of par_i_max"							, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(vehicle.modes[0].I_brake				, 0.0f		, 1.0f		, "veh_ibrk0"	, "Ride mode 0 braking current, fraction of par_i_min"							, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(vehicle.modes[0].eHz_max				, 0.0f		, 10000.0f	, "veh_ehz0"	, "Ride mode 0 speed limit, eHz, 0 for none"										, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_ARRAY_FLOAT(vehicle.modes[0].map			, 0.0f		, 1.0f		, "veh_map0"	, "Ride mode 0 throttle map, fraction of veh_imax0 at even throttle steps"		, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(vehicle.modes[1].I_max				, 0.0f		, 1.0f		, "veh_imax1"	, "Ride mode 1 motoring current, fraction of par_i_max"							, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(vehicle.modes[1].I_brake				, 0.0f		, 1.0f		, "veh_ibrk1"	, "Ride mode 1 braking current, fraction of par_i_min"							, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(vehicle.modes[1].eHz_max				, 0.0f		, 10000.0f	, "veh_ehz1"	, "Ride mode 1 speed limit, eHz, 0 for none"										, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_ARRAY_FLOAT(vehicle.modes[1].map			, 0.0f		, 1.0f		, "veh_map1"	, "Ride mode 1 throttle map, fraction of veh_imax1 at even throttle steps"		, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(vehicle.modes[2].I_max				, 0.0f		, 1.0f		, "veh_imax2"	, "Ride mode 2 motoring current, fraction of par_i_max"							, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(vehicle.modes[2].I_brake				, 0.0f		, 1.0f		, "veh_ibrk2"	, "Ride mode 2 braking current, fraction of par_i_min"							, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(vehicle.modes[2].eHz_max				, 0.0f		, 10000.0f	, "veh_ehz2"	, "Ride mode 2 speed limit, eHz, 0 for none"										, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_ARRAY_FLOAT(vehicle.modes[2].map			, 0.0f		, 1.0f		, "veh_map2"	, "Ride mode 2 throttle map, fraction of veh_imax2 at even throttle steps"		, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_BOOL(mtr[0].options.use_traction				, 0			, 1			, "opt_traction", "Traction control on wheel slip and wheelie, needs the IMU"					, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(mtr[0].traction.m_per_eHz				, 0.0f		, 1.0f		, "tc_m_per_ehz", "Wheel speed per eHz, m/s"										, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(mtr[0].traction.slip_max				, 0.0f		, 1.0f		, "tc_slip"		, "Slip ratio allowed"															, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(mtr[0].traction.acc_excess				, 0.0f		, 100.0f	, "tc_acc"		, "Wheel over vehicle acceleration allowed, m/s2"								, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(mtr[0].traction.pitch_max				, 0.0f		, 1.5f		, "tc_pitch"	, "Wheelie pitch limit, rad"													, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(mtr[0].traction.lookahead				, 0.0f		, 1.0f		, "tc_look"		, "Wheelie pitch projected ahead with its rate, s"								, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(mtr[0].traction.recover					, 0.0f		, 100.0f	, "tc_rec"		, "Traction factor recovery, per s"												, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(mtr[0].traction.scale					, 0.0f		, 1.0f		, "tc_scale"	, "Traction factor on the motoring request"										, VAR_ACCESS_R	, NULL		, 0),
+	TERM_VAR_FLOAT(mtr[0].traction.slip					, -10.0f	, 10.0f		, "tc_slipr"	, "Slip ratio against the estimated vehicle speed"								, VAR_ACCESS_R	, NULL		, 0),
+	TERM_VAR_FLOAT(mtr[0].traction.pitch_pred				, -3.2f		, 3.2f		, "tc_pitch_pred", "Projected pitch, rad"										, VAR_ACCESS_R	, NULL		, 0),
+	TERM_VAR_UNSIGNED(mtr[0].ControlMode					, 0			, 4			, "opt_cont_type"  , "Cont type: 0=Torque, 1=Speed, 2=Duty, 3=Position, 4=Measuring, 5=Handbrake"			, VAR_ACCESS_RW	, NULL		, 0),
+	TERM_VAR_FLOAT(mtr[0].FOC.FOC_advance				, -10.0f	, 10.0f		, "FOC_Advance"	, "FOC advance, proportion of 1 PWM cycle"													, VAR_ACCESS_RW	, callback	, 0),
+	TERM_VAR_FLOAT(mtr[0].FOC.speed_kp					, 0.0f		, 6000000.0f, "speed_kp"	, "amps/Hz proportional gain"																, VAR_ACCESS_RW	, callback	, 0),
+	TERM_VAR_FLOAT(mtr[0].FOC.speed_ki					, 0.0f		, 6000000.0f, "speed_ki"	, "amps/Hz integral gain"																	, VAR_ACCESS_RW	, callback	, 0),
+	TERM_VAR_FLOAT(mtr[0].FOC.speed_req				, 0.0f		, 5000.0f	, "speed_req"	, "Hz"																						, VAR_ACCESS_RW	, callback	, 0),
 
 
 
 
 //	_motor->FOC.FOC_advance
 
-	TERM_addVarArrayFloat(mtr[0].m.hall_flux, sizeof(mtr[0].m.hall_flux),  -10.0f, 10.0f, "Hall_flux", "hall start table", VAR_ACCESS_RW, NULL, &TERM_varList);
+	TERM_VAR_ARRAY_FLOAT(mtr[0].m.hall_flux, -10.0f, 10.0f, "Hall_flux", "hall start table", VAR_ACCESS_RW, NULL, 0),
 
 	#ifdef HAL_CAN_MODULE_ENABLED
-	TERM_addVar(can1.node_id						, 1			, 254		, "node_id"	    , "Node ID"																					, VAR_ACCESS_RW	, callback	, &TERM_varList);
-	TERM_addVar(mtr[0].input_vars.remote_ADC_can_id	, 0			, 254		, "can_adc"	    , "CAN ADC ID  0=disabled"																	, VAR_ACCESS_RW	, callback	, &TERM_varList);
+	TERM_VAR_UNSIGNED(can1.node_id						, 1			, 254		, "node_id"	    , "Node ID"																					, VAR_ACCESS_RW	, callback	, 0),
+	TERM_VAR_UNSIGNED(mtr[0].input_vars.remote_ADC_can_id	, 0			, 254		, "can_adc"	    , "CAN ADC ID  0=disabled"																	, VAR_ACCESS_RW	, callback	, 0),
 #endif
 
-	TermVariableDescriptor * desc;
-	desc = TERM_addVar(mtr[0].Conv.Vbus         	, 0.0f      , HUGE_VAL  , "vbus"        , "Read input voltage"                  													, VAR_ACCESS_TR , NULL      , &TERM_varList);
-	TERM_setFlag(desc, FLAG_TELEMETRY_ON);
+	TERM_VAR_FLOAT(mtr[0].Conv.Vbus         	, 0.0f      , HUGE_VAL  , "vbus"        , "Read input voltage"                  													, VAR_ACCESS_TR , NULL      , FLAG_TELEMETRY_ON),
+	TERM_VAR_FLOAT(mtr[0].FOC.eHz           	, -HUGE_VAL , HUGE_VAL  , "ehz"         , "Motor electrical hz"                 													, VAR_ACCESS_TR , NULL      , FLAG_TELEMETRY_ON),
+	TERM_VAR_FLOAT(mtr[0].FOC.Idq_smoothed.d 	, -HUGE_VAL , HUGE_VAL  , "id"      	, "Phase Idq_d smoothed"                   													, VAR_ACCESS_TR , NULL      , FLAG_TELEMETRY_ON),
+	TERM_VAR_FLOAT(mtr[0].FOC.Idq_smoothed.q 	, -HUGE_VAL , HUGE_VAL  , "iq"      	, "Phase Idq_q smoothed"                   													, VAR_ACCESS_TR , NULL      , FLAG_TELEMETRY_ON),
+	TERM_VAR_SIGNED(mtr[0].Raw.ADC_in_ext1    	, 0			, 4096      , "adc1"   		, "Raw ADC throttle"                    													, VAR_ACCESS_TR , NULL      , FLAG_TELEMETRY_ON),
+	TERM_VAR_FLOAT(mtr[0].Conv.MOSu_T        	, 0.0f		, 4096.0f   , "TMOS"   		, "MOSFET temp, kelvin"                     												, VAR_ACCESS_TR , NULL      , FLAG_TELEMETRY_ON),
+	TERM_VAR_FLOAT(mtr[0].Conv.Motor_T       	, 0.0f 		, 4096.0f   , "TMOT"   		, "Motor temp, kelvin"                      												, VAR_ACCESS_TR , NULL      , FLAG_TELEMETRY_ON),
+	TERM_VAR_UNSIGNED(MESC_errors          		, 0         , UINT32_MAX  , "error" 		, "System errors now"       																, VAR_ACCESS_TR , NULL		, FLAG_TELEMETRY_ON),
+	TERM_VAR_FLOAT(mtr[0].FOC.Vdq.q     		, -4096.0f 	, 4096.0f  	, "Vq"    		, "FOC_Vdq_q"     																			, VAR_ACCESS_TR , NULL      , FLAG_TELEMETRY_ON),
+	TERM_VAR_FLOAT(mtr[0].FOC.Vdq.d     		, -4096.0f 	, 4096.0f  	, "Vd"    		, "FOC_Vdq_d"     																			, VAR_ACCESS_TR , NULL      , FLAG_TELEMETRY_ON),
+	TERM_VAR_FLOAT(mtr[0].FOC.Idq_req.q 		, -4096.0f 	, 4096.0f  	, "iqreq" 		, "mtr[0].FOC.Idq_req.q"     																, VAR_ACCESS_TR , NULL      , FLAG_TELEMETRY_ON),
+};
+
+static TermVariableDescriptor mesc_var_nodes[TERM_VAR_TABLE_SIZE(mesc_vars)];
+
+void populate_vars(){
+	TERM_addVarTable(mesc_vars, mesc_var_nodes, TERM_VAR_TABLE_SIZE(mesc_vars), &TERM_varList);
+}
+
+static const char * const batch_error_string[] = {
+	"OK", "Syntax error", "Unknown variable", "No permission", "Type not supported", "Out of range", "Too many entries", "Busy",
+};
 
-	desc = TERM_addVar(mtr[0].FOC.eHz           	, -HUGE_VAL , HUGE_VAL  , "ehz"         , "Motor electrical hz"                 													, VAR_ACCESS_TR , NULL      , &TERM_varList);
-	TERM_setFlag(desc, FLAG_TELEMETRY_ON);
+static SemaphoreHandle_t batch_lock;
 
-	desc = TERM_addVar(mtr[0].FOC.Idq_smoothed.d 	, -HUGE_VAL , HUGE_VAL  , "id"      	, "Phase Idq_d smoothed"                   													, VAR_ACCESS_TR , NULL      , &TERM_varList);
-	TERM_setFlag(desc, FLAG_TELEMETRY_ON);
+static BATCHError batch_lookup_var(void * ctx, const char * name, uint32_t len, BATCH_VAR * var){
+	TERMINAL_HANDLE * handle = ctx;
+	char buffer[BATCH_NAME_MAX + 1];
 
-	desc = TERM_addVar(mtr[0].FOC.Idq_smoothed.q 	, -HUGE_VAL , HUGE_VAL  , "iq"      	, "Phase Idq_q smoothed"                   													, VAR_ACCESS_TR , NULL      , &TERM_varList);
-	TERM_setFlag(desc, FLAG_TELEMETRY_ON);
+	if(len > BATCH_NAME_MAX) return BATCH_ERR_UNKNOWN;
+	memcpy(buffer, name, len);
+	buffer[len] = 0;
 
-	desc = TERM_addVar(mtr[0].Raw.ADC_in_ext1    	, 0			, 4096      , "adc1"   		, "Raw ADC throttle"                    													, VAR_ACCESS_TR , NULL      , &TERM_varList);
-	TERM_setFlag(desc, FLAG_TELEMETRY_ON);
+	TermVariableDescriptor * desc = TERM_findVar(&TERM_varList, buffer);
+	if(desc == NULL) return BATCH_ERR_UNKNOWN;
 
-	desc = TERM_addVar(mtr[0].Conv.MOSu_T        	, 0.0f		, 4096.0f   , "TMOS"   		, "MOSFET temp, kelvin"                     												, VAR_ACCESS_TR , NULL      , &TERM_varList);
-	TERM_setFlag(desc, FLAG_TELEMETRY_ON);
+	switch(desc->info->type){
+		case TERM_VARIABLE_UINT:
+			var->type = BATCH_TYPE_UINT;
+			var->min.u = desc->info->min_unsigned;
+			var->max.u = desc->info->max_unsigned;
+			break;
+		case TERM_VARIABLE_INT:
+			var->type = BATCH_TYPE_INT;
+			var->min.i = desc->info->min_signed;
+			var->max.i = desc->info->max_signed;
+			break;
+		case TERM_VARIABLE_FLOAT:
+			var->type = BATCH_TYPE_FLOAT;
+			var->min.f = desc->info->min_float;
+			var->max.f = desc->info->max_float;
+			break;
+		case TERM_VARIABLE_BOOL:
+			var->type = BATCH_TYPE_BOOL;
+			var->min.u = 0;
+			var->max.u = 1;
+			break;
+		default:
+			return BATCH_ERR_TYPE;
+	}
 
-	desc = TERM_addVar(mtr[0].Conv.Motor_T       	, 0.0f 		, 4096.0f   , "TMOT"   		, "Motor temp, kelvin"                      												, VAR_ACCESS_TR , NULL      , &TERM_varList);
-	TERM_setFlag(desc, FLAG_TELEMETRY_ON);
+	var->ptr = desc->info->variable;
+	var->size = desc->info->typeSize;
+	var->readable = (desc->info->rw & VAR_ACCESS_R) != 0;
+	var->writable = (desc->info->rw & VAR_ACCESS_W) && TERM_check_protection(desc, handle->currPermissionLevel);
+	var->group = (uintptr_t)desc->info->cb;	//every variable sharing a callback needs it run only once
+	var->tag = desc;
+	return BATCH_OK;
+}
 
-	desc = TERM_addVar(MESC_errors          		, -HUGE_VAL , HUGE_VAL  , "error" 		, "System errors now"       																, VAR_ACCESS_TR , NULL		, &TERM_varList);
-	TERM_setFlag(desc, FLAG_TELEMETRY_ON);
+//Runs in the slow loop right after the values were written
+static void batch_complete_cb(BATCH * batch){
+	for(uint32_t i=0;i<batch->count;i++){
+		if(batch_first_of_group(batch, i)){
+			TermVariableDescriptor * desc = batch->entry[i].tag;
+			desc->info->cb(desc);
+		}
+	}
+}
 
-	desc = TERM_addVar(mtr[0].FOC.Vdq.q     		, -4096.0f 	, 4096.0f  	, "Vq"    		, "FOC_Vdq_q"     																			, VAR_ACCESS_TR , NULL      , &TERM_varList);
-	TERM_setFlag(desc, FLAG_TELEMETRY_ON);
+uint8_t CMD_batch(TERMINAL_HANDLE * handle, uint8_t argCount, char ** args){
+	BATCH * batch = &mtr[0].batch;
 
-	desc = TERM_addVar(mtr[0].FOC.Vdq.d     		, -4096.0f 	, 4096.0f  	, "Vd"    		, "FOC_Vdq_d"     																			, VAR_ACCESS_TR , NULL      , &TERM_varList);
-	TERM_setFlag(desc, FLAG_TELEMETRY_ON);
+	if(argCount == 0){
+		ttprintf("Usage: batch [name=value | name] ...\r\n");
+		ttprintf("Validates all pairs, then applies them together between two slow loop iterations\r\n");
+		return TERM_CMD_EXIT_SUCCESS;
+	}
 
-	desc = TERM_addVar(mtr[0].FOC.Idq_req.q 		, -4096.0f 	, 4096.0f  	, "iqreq" 		, "mtr[0].FOC.Idq_req.q"     																, VAR_ACCESS_TR , NULL      , &TERM_varList);
-	TERM_setFlag(desc, FLAG_TELEMETRY_ON);
+	xSemaphoreTake(batch_lock, portMAX_DELAY);
 
+	BATCHError ret = batch_begin(batch);
+	for(uint32_t i=0;i<argCount && ret == BATCH_OK;i++){
+		ret = batch_parse_token(batch, args[i], strlen(args[i]), batch_lookup_var, handle);
+		if(ret != BATCH_OK){
+			batch_abort(batch);
+			ttprintf("%s: %s, nothing applied\r\n", args[i], batch_error_string[ret]);
+		}
+	}
+	if(ret == BATCH_OK){
+		ret = batch_commit(batch);
+	}
+	if(ret != BATCH_OK){
+		if(ret == BATCH_ERR_BUSY) ttprintf("%s\r\n", batch_error_string[ret]);
+		xSemaphoreGive(batch_lock);
+		return TERM_CMD_EXIT_SUCCESS;
+	}
+
+	for(uint32_t i=0;i<100 && batch_state(batch) == BATCH_STATE_PENDING;i++){
+		vTaskDelay(1);
+	}
+	if(batch_state(batch) != BATCH_STATE_APPLIED){
+		ttprintf("Slow loop not running, batch left pending\r\n");
+		xSemaphoreGive(batch_lock);
+		return TERM_CMD_EXIT_SUCCESS;
+	}
+
+	//Values as captured in the slow loop, all from the same instant
+	for(uint32_t i=0;i<batch->count;i++){
+		BATCH_ENTRY * e = &batch->entry[i];
+		TermVariableDescriptor * desc = e->tag;
+		switch(e->type){
+			case BATCH_TYPE_FLOAT:
+				ttprintf("%s = %f\r\n", desc->info->name, e->value.f);
+				break;
+			case BATCH_TYPE_INT:
+				ttprintf("%s = %li\r\n", desc->info->name, e->value.i);
+				break;
+			default:
+				ttprintf("%s = %lu\r\n", desc->info->name, e->value.u);
+				break;
+		}
+	}
+	ttprintf("Applied %u variables\r\n", batch->count);
+
+	xSemaphoreGive(batch_lock);
+	return TERM_CMD_EXIT_SUCCESS;
 }
 
 #ifdef HAL_CAN_MODULE_ENABLED
@@ -600,8 +869,8 @@ void TASK_CAN_packet_cb(TASK_CAN_handle * handle, uint32_t id, uint8_t sender, u
 		case CAN_ID_ADC1_2_REQ:{
 			if(sender == motor_curr->input_vars.remote_ADC_can_id && motor_curr->input_vars.remote_ADC_can_id > 0){
 				motor_curr->input_vars.remote_ADC_timeout = REMOTE_ADC_TIMEOUT;
-				motor_curr->input_vars.remote_ADC1_req = PACK_buf_to_float(data);
-				motor_curr->input_vars.remote_ADC2_req = PACK_buf_to_float(data+4);
+				motor_curr->input_vars.remote_ADC1_raw = PACK_buf_to_float(data);
+				motor_curr->input_vars.remote_ADC2_raw = PACK_buf_to_float(data+4);
 			}
 			break;
 		}
@@ -697,6 +966,7 @@ void MESCinterface_init(TERMINAL_HANDLE * handle){
 		}
 	}
 
+	encoderConfig(&mtr[0]);
 	calculateGains(&mtr[0]);
 	calculateVoltageGain(&mtr[0]);
 	calculateFlux(&mtr[0]);
@@ -707,6 +977,11 @@ void MESCinterface_init(TERMINAL_HANDLE * handle){
 
 	TERM_addCommand(CMD_status, "status", "Realtime data", 0, &TERM_defaultList);
 
+	batch_lock = xSemaphoreCreateMutex();
+	batch_init(&mtr[0].batch, batch_complete_cb);
+	TermCommandDescriptor * batchAC = TERM_addCommand(CMD_batch, "batch", "Set/get several variables at once", 0, &TERM_defaultList);
+	TERM_addCommandAC(batchAC, TERM_varCompleter, null_handle.varHandle->varListHead);
+
 #ifdef HAL_CAN_MODULE_ENABLED
 	TERM_addCommand(CMD_nodes, "nodes", "Node info", 0, &TERM_defaultList);
 	TERM_addCommand(CMD_can_send, "can_send", "Send CAN message", 0, &TERM_defaultList);
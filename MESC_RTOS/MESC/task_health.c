@@ -0,0 +1,65 @@
+/*
+ * task_health.c
+ *
+ *  Stack and ISR budget monitor. Runs at idle priority for the life of the
+ *  system so the worst cases are caught whether or not anyone has top open.
+ */
+
+#include "task_health.h"
+
+#include "MESCfoc.h"
+#include "MESCerror.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+HEALTH health;
+
+//Static so that a low heap cannot stop the thing that reports it
+static TaskStatus_t health_tasks[HEALTH_MAX_TASKS];
+static HEALTH_ISR health_isr[2*NUM_MOTORS];
+
+static void task_health( void * pvParameters )
+{
+	TickType_t xLastWakeTime = xTaskGetTickCount ();
+
+	for( ;; )
+	{
+		vTaskDelayUntil( &xLastWakeTime, pdMS_TO_TICKS(HEALTH_PERIOD_MS) );
+
+		//Returns 0 if the table is too small to hold every task
+		UBaseType_t count = uxTaskGetSystemState( health_tasks, HEALTH_MAX_TASKS, NULL );
+		if (count == 0)
+		{
+			health.task_overflow = true;
+		}
+		for (UBaseType_t i = 0; i < count; i++)
+		{
+			health_task_sample( &health, health_tasks[i].pcTaskName, health_tasks[i].usStackHighWaterMark );
+		}
+
+		uint32_t budget = 0;
+		for (uint32_t i = 0; i < NUM_MOTORS; i++)
+		{
+			health_isr[2*i]   = mtr[i].health_fastloop;
+			health_isr[2*i+1] = mtr[i].health_pwmloop;
+			if ((budget == 0) || (mtr[i].FOC.cycles_budget < budget))
+			{
+				budget = mtr[i].FOC.cycles_budget;
+			}
+		}
+
+		if (health_check( &health, health_isr, 2*NUM_MOTORS, budget ))
+		{
+			handleWarning( ERROR_HEALTH );
+		}
+	}
+}
+
+void task_health_init( void )
+{
+	TaskHandle_t xHandle = NULL;
+	health_init( &health );
+	xTaskCreate( task_health, "task_health", 192, NULL, tskIDLE_PRIORITY, &xHandle );
+	configASSERT( xHandle );
+}
@@ -0,0 +1,18 @@
+/*
+ * task_health.h
+ *
+ *  Stack and ISR budget monitor
+ */
+
+#ifndef TASK_HEALTH_H_
+#define TASK_HEALTH_H_
+
+#include "MESChealth.h"
+
+#define HEALTH_PERIOD_MS 500
+
+extern HEALTH health;
+
+void task_health_init( void );
+
+#endif /* TASK_HEALTH_H_ */
@@ -41,9 +41,11 @@
 #include <TTerm/Core/include/TTerm_var.h>
 
 TermCommandDescriptor TERM_defaultList = {.nextCmd = 0, .commandLength = 0};
+TTERM_TRIE TERM_cmdTrie = TTERM_TRIE_INIT(pvPortMalloc);
 
 #if TERM_SUPPORT_VARIABLES
-TermVariableDescriptor TERM_varList = {.nextVar = 0, .nameLength = 0};
+TermVariableDescriptor TERM_varList = {.nextVar = 0, .count = 0};
+TTERM_TRIE TERM_varTrie = TTERM_TRIE_INIT(pvPortMalloc);
 #endif
 
 uint8_t TERM_baseCMDsAdded = 0;
@@ -677,6 +679,9 @@ TermCommandDescriptor * TERM_findCMD(TERMINAL_HANDLE * handle){
         cmdLength = (uint16_t) ((uint32_t) firstSpace - (uint32_t) handle->inputBuffer);
     }
     
+    TTERM_TRIE * trie = TERM_getCmdTrie(handle->cmdListHead);
+    if(trie != NULL) return TTERM_trie_find(trie, handle->inputBuffer, cmdLength);
+    
     TermCommandDescriptor * currCmd = handle->cmdListHead->nextCmd;
     for(;currPos < handle->cmdListHead->commandLength; currPos++){
         if(currCmd->commandLength == cmdLength && strncmp(handle->inputBuffer, currCmd->command, cmdLength) == 0) return currCmd;
@@ -825,9 +830,16 @@ TermCommandDescriptor * TERM_addCommand(TermCommandFunction function, const char
     newCMD->ACHandler = 0;
     
     TERM_LIST_add(newCMD, head);
+    if(head == &TERM_defaultList) TTERM_trie_insert(&TERM_cmdTrie, command, newCMD->commandLength, newCMD);
     return newCMD;
 }
 
+//only the default list is indexed, any other list (or a trie that ran out of memory) is scanned linearly
+TTERM_TRIE * TERM_getCmdTrie(TermCommandDescriptor * head){
+    if(head != &TERM_defaultList || TERM_cmdTrie.failed) return NULL;
+    return &TERM_cmdTrie;
+}
+
 void TERM_LIST_add(TermCommandDescriptor * item, TermCommandDescriptor * head){
     uint32_t currPos = 0;
     TermCommandDescriptor ** lastComp = &head->nextCmd;
@@ -59,6 +59,25 @@ uint8_t TERM_doAutoComplete(TERMINAL_HANDLE * handle){
         handle->autocompleteBufferLength = 0;
         return 0;
     }else{
+        TTERM_TRIE * trie = TERM_getCmdTrie(handle->cmdListHead);
+        if(trie != NULL){
+            uint32_t count = TTERM_trie_count(trie, handle->inputBuffer, handle->currBufferLength);
+            if(count > 0xff) count = 0xff;
+            
+            handle->autocompleteBuffer = pvPortMalloc(count * sizeof(char *));
+            handle->currAutocompleteCount = 0;
+            handle->autocompleteBufferLength = 0;
+            if(handle->autocompleteBuffer != NULL){
+                //the tree hands back the descriptors, swap them for their names in place
+                handle->autocompleteBufferLength = TTERM_trie_complete(trie, handle->inputBuffer, handle->currBufferLength, (void **) handle->autocompleteBuffer, count);
+                for(uint32_t currPos = 0; currPos < handle->autocompleteBufferLength; currPos++){
+                    handle->autocompleteBuffer[currPos] = (char *) ((TermCommandDescriptor *) handle->autocompleteBuffer[currPos])->command;
+                }
+            }
+            handle->autocompleteStart = 0;
+            return handle->autocompleteBufferLength;
+        }
+        
         handle->autocompleteBuffer = pvPortMalloc(handle->cmdListHead->commandLength * sizeof(char *));
         handle->currAutocompleteCount = 0;
         handle->autocompleteBufferLength = TERM_findMatchingCMDs(handle->inputBuffer, handle->currBufferLength, handle->autocompleteBuffer, handle->cmdListHead);
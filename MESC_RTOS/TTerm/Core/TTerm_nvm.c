@@ -0,0 +1,263 @@
+/*
+* Copyright 2021-2023 cod3b453
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its contributors
+*    may be used to endorse or promote products derived from this software
+*    without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "include/TTerm_nvm.h"
+#include "include/TTerm_fnv.h"
+
+#include <stddef.h>
+
+#define TTERM_NVM_MIN_DATASET (sizeof(TTERM_NVM_HEADER) + sizeof(TTERM_NVM_FOOTER))
+
+static TTERM_NVM_HEADER const * tterm_nvm_header( uint8_t const * const address, uint32_t const size, uint32_t const offset )
+{
+    if ((size < sizeof(TTERM_NVM_HEADER)) || (offset > (size - sizeof(TTERM_NVM_HEADER))))
+    {
+        return NULL;
+    }
+
+    TTERM_NVM_HEADER const * const header = (TTERM_NVM_HEADER const *)&address[offset];
+
+    if (header->start != TTERM_NVM_HEADER_START)
+    {
+        return NULL;
+    }
+
+    return header;
+}
+
+// Header that can be stepped over, the size must keep it inside the region
+static TTERM_NVM_HEADER const * tterm_nvm_header_sized( uint8_t const * const address, uint32_t const size, uint32_t const offset )
+{
+    TTERM_NVM_HEADER const * const header = tterm_nvm_header( address, size, offset );
+
+    if (    (header == NULL)
+         || (header->size < TTERM_NVM_MIN_DATASET)
+         || (header->size > (size - offset)))
+    {
+        return NULL;
+    }
+
+    return header;
+}
+
+TTERM_NVM_FOOTER const * TTERM_nvm_footer( TTERM_NVM_HEADER const * const header )
+{
+    return (TTERM_NVM_FOOTER const *)((uint8_t const *)header + header->size - sizeof(TTERM_NVM_FOOTER));
+}
+
+uint32_t TTERM_nvm_crc( TTERM_NVM_HEADER const * const header )
+{
+    // The crc field is the last word of the dataset and is not covered
+    return TTERM_fnv1a_data( header, (header->size - sizeof(uint32_t)) );
+}
+
+bool TTERM_nvm_valid( uint8_t const * const address, uint32_t const size, uint32_t const offset )
+{
+    TTERM_NVM_HEADER const * const header = tterm_nvm_header_sized( address, size, offset );
+
+    if ((header == NULL) || (header->version != TTERM_NVM_HEADER_VERSION))
+    {
+        return false;
+    }
+
+    TTERM_NVM_FOOTER const * const footer = TTERM_nvm_footer( header );
+
+    if (footer->end != TTERM_NVM_FOOTER_END)
+    {
+        return false;
+    }
+
+    return (TTERM_nvm_crc( header ) == footer->crc);
+}
+
+TTERM_NVM_SLOT const * TTERM_nvm_index_slot( uint8_t const * const address, uint32_t const size, uint32_t const i )
+{
+    return (TTERM_NVM_SLOT const *)&address[size - ((i + 1) * sizeof(TTERM_NVM_SLOT))];
+}
+
+TTERM_NVM_SLOT TTERM_nvm_index_make( uint32_t const offset, uint32_t const revision )
+{
+    TTERM_NVM_SLOT const slot =
+    {
+        .key      = (offset ^ TTERM_NVM_INDEX_KEY),
+        .revision = revision,
+    };
+
+    return slot;
+}
+
+// A slot is in use if it leads to a header of the same revision
+static TTERM_NVM_HEADER const * tterm_nvm_index_lookup( uint8_t const * const address, uint32_t const size, uint32_t const i )
+{
+    TTERM_NVM_SLOT const * const slot = TTERM_nvm_index_slot( address, size, i );
+    TTERM_NVM_HEADER const * const header = tterm_nvm_header( address, size, (slot->key ^ TTERM_NVM_INDEX_KEY) );
+
+    if ((header == NULL) || (header->revision != slot->revision))
+    {
+        return NULL;
+    }
+
+    return header;
+}
+
+uint32_t TTERM_nvm_index_count( uint8_t const * const address, uint32_t const size )
+{
+    // Every dataset costs at least this much, bounding the index
+    uint32_t lo = 0;
+    uint32_t hi = (size / (TTERM_NVM_MIN_DATASET + sizeof(TTERM_NVM_SLOT)));
+
+    while (lo < hi)
+    {
+        uint32_t const mid = lo + ((hi - lo) / 2);
+
+        if (tterm_nvm_index_lookup( address, size, mid ) != NULL)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+
+static TTERM_NVM_HEADER const * tterm_nvm_walk_newest( uint8_t const * const address, uint32_t const size )
+{
+    TTERM_NVM_HEADER const * newest = NULL;
+    uint32_t                 offset = 0;
+    TTERM_NVM_HEADER const * header;
+
+    while ((header = tterm_nvm_header_sized( address, size, offset )) != NULL)
+    {
+        if (TTERM_nvm_valid( address, size, offset ))
+        {
+            newest = header;
+        }
+
+        offset = offset + header->size;
+    }
+
+    return newest;
+}
+
+TTERM_NVM_HEADER const * TTERM_nvm_find_newest( uint8_t const * const address, uint32_t const size )
+{
+    uint32_t const count = TTERM_nvm_index_count( address, size );
+
+    for ( uint32_t k = 0; (k < count) && (k < TTERM_NVM_INDEX_RETRY); ++k )
+    {
+        TTERM_NVM_SLOT const * const slot = TTERM_nvm_index_slot( address, size, (count - 1 - k) );
+        uint32_t const offset = (slot->key ^ TTERM_NVM_INDEX_KEY);
+
+        if (TTERM_nvm_valid( address, size, offset ) == false)
+        {
+            continue;
+        }
+
+        TTERM_NVM_HEADER const * const header = (TTERM_NVM_HEADER const *)&address[offset];
+
+        // A dataset appended without a slot (by older firmware) supersedes it
+        if (tterm_nvm_header( address, size, (offset + header->size) ) != NULL)
+        {
+            break;
+        }
+
+        return header;
+    }
+
+    return tterm_nvm_walk_newest( address, size );
+}
+
+TTERM_NVM_HEADER const * TTERM_nvm_find_revision( uint8_t const * const address, uint32_t const size, uint32_t const revision )
+{
+    uint32_t                 offset = 0;
+    TTERM_NVM_HEADER const * header;
+
+    while ((header = tterm_nvm_header_sized( address, size, offset )) != NULL)
+    {
+        if (header->revision == revision)
+        {
+            return header;
+        }
+
+        offset = offset + header->size;
+    }
+
+    return NULL;
+}
+
+uint32_t TTERM_nvm_next_free( uint8_t const * const address, uint32_t const size, uint32_t * const revision )
+{
+    uint32_t const count = TTERM_nvm_index_count( address, size );
+    uint32_t       offset = 0;
+
+    // Start from the newest indexed dataset, anything after it is walked
+    if (count > 0)
+    {
+        offset = (TTERM_nvm_index_slot( address, size, (count - 1) )->key ^ TTERM_NVM_INDEX_KEY);
+    }
+
+    uint32_t                 last = UINT32_MAX;
+    TTERM_NVM_HEADER const * header;
+
+    while ((header = tterm_nvm_header_sized( address, size, offset )) != NULL)
+    {
+        last   = header->revision;
+        offset = offset + header->size;
+    }
+
+    // A header that cannot be stepped over leaves no usable free space
+    if (tterm_nvm_header( address, size, offset ) != NULL)
+    {
+        offset = size;
+    }
+
+    if (revision != NULL)
+    {
+        *revision = last + 1;
+    }
+
+    return offset;
+}
+
+bool TTERM_nvm_fits( uint8_t const * const address, uint32_t const size, uint32_t const offset, uint32_t const length )
+{
+    uint32_t const index = (TTERM_nvm_index_count( address, size ) + 1) * sizeof(TTERM_NVM_SLOT);
+
+    if (index > size)
+    {
+        return false;
+    }
+
+    uint32_t const limit = size - index;
+
+    return ((offset <= limit) && (length <= (limit - offset)));
+}
@@ -0,0 +1,282 @@
+/*
+* Copyright 2021-2022 cod3b453
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its contributors
+*    may be used to endorse or promote products derived from this software
+*    without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "include/TTerm_trie.h"
+
+#include <string.h>
+
+static uint8_t TTERM_trie_first( TTERM_TRIE_NODE const * const node )
+{
+    return (uint8_t)node->label[0];
+}
+
+static TTERM_TRIE_NODE * TTERM_trie_new( TTERM_TRIE * const trie )
+{
+    TTERM_TRIE_NODE * const node = trie->pool;
+
+    trie->pool = trie->pool + 1;
+    trie->pool_free--;
+    trie->nodes++;
+
+    memset( node, 0, sizeof(*node) );
+
+    return node;
+}
+
+// Find the child starting with c, or the link it would be inserted at
+static TTERM_TRIE_NODE ** TTERM_trie_link( TTERM_TRIE_NODE * const node, uint8_t const c )
+{
+    TTERM_TRIE_NODE ** link = &node->child;
+
+    while ((*link != NULL) && (TTERM_trie_first( *link ) < c))
+    {
+        link = &(*link)->next;
+    }
+
+    return link;
+}
+
+static TTERM_TRIE_NODE const * TTERM_trie_child( TTERM_TRIE_NODE const * const node, uint8_t const c )
+{
+    TTERM_TRIE_NODE const * child = node->child;
+
+    while ((child != NULL) && (TTERM_trie_first( child ) < c))
+    {
+        child = child->next;
+    }
+
+    if ((child == NULL) || (TTERM_trie_first( child ) != c))
+    {
+        return NULL;
+    }
+
+    return child;
+}
+
+// Node at which name[0..len) ends exactly, it need not hold a value
+static TTERM_TRIE_NODE * TTERM_trie_exact( TTERM_TRIE * const trie, char const * const name, uint32_t const len )
+{
+    TTERM_TRIE_NODE * node = &trie->root;
+    uint32_t          pos  = 0;
+
+    while (pos < len)
+    {
+        node = (TTERM_TRIE_NODE *)TTERM_trie_child( node, (uint8_t)name[pos] );
+
+        if ((node == NULL) || (node->len > (len - pos)) || (memcmp( node->label, &name[pos], node->len ) != 0))
+        {
+            return NULL;
+        }
+
+        pos = pos + node->len;
+    }
+
+    return node;
+}
+
+// Deepest node whose path starts with prefix, which may end part way along its label
+static TTERM_TRIE_NODE const * TTERM_trie_prefix( TTERM_TRIE const * const trie, char const * const prefix, uint32_t const len )
+{
+    TTERM_TRIE_NODE const * node = &trie->root;
+    uint32_t                pos  = 0;
+
+    while (pos < len)
+    {
+        node = TTERM_trie_child( node, (uint8_t)prefix[pos] );
+
+        if (node == NULL)
+        {
+            return NULL;
+        }
+
+        uint32_t const rem = len - pos;
+        uint32_t const n   = (node->len < rem) ? node->len : rem;
+
+        if (memcmp( node->label, &prefix[pos], n ) != 0)
+        {
+            return NULL;
+        }
+
+        pos = pos + n;
+    }
+
+    return node;
+}
+
+static uint32_t TTERM_trie_collect( TTERM_TRIE_NODE const * const node, void ** const buff, uint32_t const max, uint32_t found )
+{
+    if ((node->value != NULL) && (found < max))
+    {
+        buff[found] = node->value;
+        found++;
+    }
+
+    for ( TTERM_TRIE_NODE const * child = node->child; (child != NULL) && (found < max); child = child->next )
+    {
+        found = TTERM_trie_collect( child, buff, max, found );
+    }
+
+    return found;
+}
+
+void TTERM_trie_init( TTERM_TRIE * const trie, TTERM_trie_alloc const alloc )
+{
+    memset( trie, 0, sizeof(*trie) );
+
+    trie->alloc = alloc;
+}
+
+bool TTERM_trie_insert( TTERM_TRIE * const trie, char const * const name, uint32_t const len, void * const value )
+{
+    if (value == NULL)
+    {
+        return false;
+    }
+
+    // Re-registration only replaces the value and must not disturb the counts
+    TTERM_TRIE_NODE * node = TTERM_trie_exact( trie, name, len );
+
+    if ((node != NULL) && (node->value != NULL))
+    {
+        node->value = value;
+        return true;
+    }
+
+    // Reserve the worst case (one split plus the leaf chain) so the tree is never left half built
+    uint32_t const need = 2 + (len / TTERM_TRIE_LABEL_MAX);
+
+    if (need > TTERM_TRIE_CHUNK)
+    {
+        trie->failed = true;
+        return false;
+    }
+
+    if (trie->pool_free < need)
+    {
+        TTERM_TRIE_NODE * const pool = (trie->alloc != NULL) ? trie->alloc( TTERM_TRIE_CHUNK * sizeof(TTERM_TRIE_NODE) ) : NULL;
+
+        if (pool == NULL)
+        {
+            trie->failed = true;
+            return false;
+        }
+
+        trie->pool      = pool;
+        trie->pool_free = TTERM_TRIE_CHUNK;
+        trie->bytes     = trie->bytes + (TTERM_TRIE_CHUNK * sizeof(TTERM_TRIE_NODE));
+    }
+
+    node = &trie->root;
+
+    for ( uint32_t pos = 0; ; )
+    {
+        node->count++;
+
+        if (pos == len)
+        {
+            node->value = value;
+            return true;
+        }
+
+        uint8_t const            c     = (uint8_t)name[pos];
+        TTERM_TRIE_NODE ** const link  = TTERM_trie_link( node, c );
+        TTERM_TRIE_NODE *        child = *link;
+
+        if ((child == NULL) || (TTERM_trie_first( child ) != c))
+        {
+            uint32_t const rem  = len - pos;
+            TTERM_TRIE_NODE * const leaf = TTERM_trie_new( trie );
+
+            leaf->label = &name[pos];
+            leaf->len   = (uint8_t)((rem < TTERM_TRIE_LABEL_MAX) ? rem : TTERM_TRIE_LABEL_MAX);
+            leaf->next  = child;
+            *link       = leaf;
+
+            node = leaf;
+            pos  = pos + leaf->len;
+            continue;
+        }
+
+        uint32_t const rem = len - pos;
+        uint32_t       k   = 1;
+
+        while ((k < child->len) && (k < rem) && (child->label[k] == name[pos + k]))
+        {
+            k++;
+        }
+
+        if (k < child->len)
+        {
+            // Split the edge, the new node takes over the shared part of the label
+            TTERM_TRIE_NODE * const mid = TTERM_trie_new( trie );
+
+            mid->label = child->label;
+            mid->len   = (uint8_t)k;
+            mid->child = child;
+            mid->next  = child->next;
+            mid->count = child->count;
+
+            child->label = child->label + k;
+            child->len   = (uint8_t)(child->len - k);
+            child->next  = NULL;
+
+            *link = mid;
+            child = mid;
+        }
+
+        node = child;
+        pos  = pos + k;
+    }
+}
+
+void * TTERM_trie_find( TTERM_TRIE const * const trie, char const * const name, uint32_t const len )
+{
+    TTERM_TRIE_NODE const * const node = TTERM_trie_exact( (TTERM_TRIE *)trie, name, len );
+
+    return (node != NULL) ? node->value : NULL;
+}
+
+uint32_t TTERM_trie_count( TTERM_TRIE const * const trie, char const * const prefix, uint32_t const len )
+{
+    TTERM_TRIE_NODE const * const node = TTERM_trie_prefix( trie, prefix, len );
+
+    return (node != NULL) ? node->count : 0;
+}
+
+uint32_t TTERM_trie_complete( TTERM_TRIE const * const trie, char const * const prefix, uint32_t const len, void ** const buff, uint32_t const max )
+{
+    TTERM_TRIE_NODE const * const node = TTERM_trie_prefix( trie, prefix, len );
+
+    if (node == NULL)
+    {
+        return 0;
+    }
+
+    return TTERM_trie_collect( node, buff, max, 0 );
+}
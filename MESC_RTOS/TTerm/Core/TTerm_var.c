@@ -23,6 +23,7 @@
 
 #include "TTerm/Core/include/TTerm_var.h"
 #include "TTerm/Core/include/TTerm_fnv.h"
+#include "TTerm/Core/include/TTerm_nvm.h"
 #include "TTerm/Core/include/TTerm.h"
 
 #include <string.h>
@@ -31,9 +32,6 @@
 #include <stdio.h>
 
 
-#define HEADER_START 	0xDEADBEEF
-#define FOOTER_END   	0xDEADC0DE
-#define HEADER_VERSION	0x00000001
 
 const uint8_t null_data = 0;
 
@@ -58,7 +56,7 @@ uint16_t toLower(uint16_t c){
     }
 }
 
-static unsigned TERM_VAR_isSorted(TermVariableDescriptor * a, TermVariableDescriptor * b){
+static unsigned TERM_VAR_isSorted(const TermVariableInfo * a, const TermVariableInfo * b){
     uint8_t currPos = 0;
     //compare the lowercase ASCII values of each character in the command (They are alphabetically sorted)
     for(;currPos < a->nameLength && currPos < b->nameLength; currPos++){
@@ -113,22 +111,24 @@ TermVariableHandle * TERM_VAR_init(TERMINAL_HANDLE * handle, void * nvm_address,
 
 void TERM_VAR_LIST_add(TermVariableDescriptor * item, TermVariableDescriptor * head){
 
+    if(head == &TERM_varList) TTERM_trie_insert(&TERM_varTrie, item->info->name, item->info->nameLength, item);
+
     uint32_t currPos = 0;
     TermVariableDescriptor ** lastComp = &head->nextVar;
     TermVariableDescriptor * currComp = head->nextVar;
 
-    while(currPos < head->nameLength){
-        if(TERM_VAR_isSorted(currComp, item)){
+    while(currPos < head->count){
+        if(TERM_VAR_isSorted(currComp->info, item->info)){
             *lastComp = item;
             item->nextVar = currComp;
-            head->nameLength ++;
+            head->count ++;
 
             return;
         }
         if(currComp->nextVar == 0){
             item->nextVar = currComp->nextVar;
             currComp->nextVar = item;
-            head->nameLength ++;
+            head->count ++;
             return;
         }
         lastComp = &currComp->nextVar;
@@ -137,29 +137,77 @@ void TERM_VAR_LIST_add(TermVariableDescriptor * item, TermVariableDescriptor * h
 
     item->nextVar = 0;
     *lastComp = item;
-    head->nameLength ++;
+    head->count ++;
+}
+
+//only the default list is indexed, any other list (or a trie that ran out of memory) is scanned linearly
+static TTERM_TRIE * TERM_getVarTrie(TermVariableDescriptor * head){
+    if(head != &TERM_varList || TERM_varTrie.failed) return NULL;
+    return &TERM_varTrie;
+}
+
+TermVariableDescriptor * TERM_findVar(TermVariableDescriptor * head, const char * name){
+    TTERM_TRIE * trie = TERM_getVarTrie(head);
+    if(trie != NULL) return TTERM_trie_find(trie, name, strlen(name));
+
+    uint32_t currPos = 0;
+    TermVariableDescriptor * currVar = head->nextVar;
+    for(;currPos < head->count; currPos++){
+        if(strcmp(name, currVar->info->name)==0) return currVar;
+        currVar = currVar->nextVar;
+    }
+    return NULL;
+}
+
+
+//variables added at runtime carry their info in the same allocation as the list node
+typedef struct{
+    TermVariableDescriptor desc;
+    TermVariableInfo info;
+} TermVariableHeapItem;
+
+static TermVariableDescriptor * TERM_VAR_addHeapItem(TermVariableHeapItem * item, TermVariableDescriptor * head){
+    item->info.prefix = NULL;
+    item->info.flags = 0;
+    item->desc.info = &item->info;
+    item->desc.flags = 0;
+
+    TERM_VAR_LIST_add(&item->desc, head);
+    return &item->desc;
+}
+
+//links a const table without touching the heap, nodes has to hold count entries and stay valid
+uint32_t TERM_addVarTable(const TermVariableInfo * table, TermVariableDescriptor * nodes, uint32_t count, TermVariableDescriptor * head){
+    uint32_t currPos = 0;
+    for(;currPos < count; currPos++){
+        if(head->count == 0xff) break;
+
+        nodes[currPos].info = &table[currPos];
+        nodes[currPos].flags = table[currPos].flags;
+        TERM_VAR_LIST_add(&nodes[currPos], head);
+    }
+    return currPos;
 }
 
 
 TermVariableDescriptor * TERM_addVarUnsigned(void* variable, uint16_t typeSize, uint32_t min, uint32_t max, const char * name, const char * description, uint8_t rw, term_var_cb cb, TermVariableDescriptor * head){
     //if(head == NULL) head = TERM_defaultList;
-    if(head->nameLength == 0xff) return 0;
-
-    TermVariableDescriptor * newVAR = pvPortMalloc(sizeof(TermVariableDescriptor));
-
-    newVAR->variable = variable;
-    newVAR->min_unsigned = min;
-    newVAR->max_unsigned = max;
-    newVAR->type = TERM_VARIABLE_UINT;
-    newVAR->typeSize = typeSize;
-    newVAR->name = name;
-    newVAR->cb = cb;
-    newVAR->nameLength = strlen(name);
-    newVAR->variableDescription = description;
-    newVAR->rw = rw;
-
-    TERM_VAR_LIST_add(newVAR, head);
-    return newVAR;
+    if(head->count == 0xff) return 0;
+
+    TermVariableHeapItem * newVAR = pvPortMalloc(sizeof(TermVariableHeapItem));
+
+    newVAR->info.variable = variable;
+    newVAR->info.min_unsigned = min;
+    newVAR->info.max_unsigned = max;
+    newVAR->info.type = TERM_VARIABLE_UINT;
+    newVAR->info.typeSize = typeSize;
+    newVAR->info.name = name;
+    newVAR->info.cb = cb;
+    newVAR->info.nameLength = strlen(name);
+    newVAR->info.variableDescription = description;
+    newVAR->info.rw = rw;
+
+    return TERM_VAR_addHeapItem(newVAR, head);
 }
 
 void TERM_setFlag(TermVariableDescriptor * desc, TermFlagType flag){
@@ -190,128 +238,122 @@ void TERM_set_protection(TermVariableDescriptor * desc, uint8_t level){
 
 TermVariableDescriptor * TERM_addVarSigned(void* variable, uint16_t typeSize, int32_t min, int32_t max, const char * name, const char * description, uint8_t rw, term_var_cb cb, TermVariableDescriptor * head){
     //if(head == NULL) head = TERM_defaultList;
-    if(head->nameLength == 0xff) return 0;
-
-    TermVariableDescriptor * newVAR = pvPortMalloc(sizeof(TermVariableDescriptor));
-
-    newVAR->variable = variable;
-    newVAR->min_signed = min;
-    newVAR->max_signed = max;
-    newVAR->type = TERM_VARIABLE_INT;
-    newVAR->typeSize = typeSize;
-    newVAR->name = name;
-    newVAR->cb = cb;
-    newVAR->nameLength = strlen(name);
-    newVAR->variableDescription = description;
-    newVAR->rw = rw;
-
-    TERM_VAR_LIST_add(newVAR, head);
-    return newVAR;
+    if(head->count == 0xff) return 0;
+
+    TermVariableHeapItem * newVAR = pvPortMalloc(sizeof(TermVariableHeapItem));
+
+    newVAR->info.variable = variable;
+    newVAR->info.min_signed = min;
+    newVAR->info.max_signed = max;
+    newVAR->info.type = TERM_VARIABLE_INT;
+    newVAR->info.typeSize = typeSize;
+    newVAR->info.name = name;
+    newVAR->info.cb = cb;
+    newVAR->info.nameLength = strlen(name);
+    newVAR->info.variableDescription = description;
+    newVAR->info.rw = rw;
+
+    return TERM_VAR_addHeapItem(newVAR, head);
 }
 
 TermVariableDescriptor * TERM_addVarFloat(void* variable, uint16_t typeSize, float min, float max, const char * name, const char * description, uint8_t rw, term_var_cb cb, TermVariableDescriptor * head){
     //if(head == NULL) head = TERM_defaultList;
-    if(head->nameLength == 0xff) return 0;
-
-    TermVariableDescriptor * newVAR = pvPortMalloc(sizeof(TermVariableDescriptor));
-
-    newVAR->variable = variable;
-    newVAR->min_float = min;
-    newVAR->max_float = max;
-    newVAR->type = TERM_VARIABLE_FLOAT;
-    newVAR->typeSize = typeSize;
-    newVAR->name = name;
-    newVAR->cb = cb;
-    newVAR->nameLength = strlen(name);
-    newVAR->variableDescription = description;
-    newVAR->rw = rw;
-
-    TERM_VAR_LIST_add(newVAR, head);
-    return newVAR;
+    if(head->count == 0xff) return 0;
+
+    TermVariableHeapItem * newVAR = pvPortMalloc(sizeof(TermVariableHeapItem));
+
+    newVAR->info.variable = variable;
+    newVAR->info.min_float = min;
+    newVAR->info.max_float = max;
+    newVAR->info.type = TERM_VARIABLE_FLOAT;
+    newVAR->info.typeSize = typeSize;
+    newVAR->info.name = name;
+    newVAR->info.cb = cb;
+    newVAR->info.nameLength = strlen(name);
+    newVAR->info.variableDescription = description;
+    newVAR->info.rw = rw;
+
+    return TERM_VAR_addHeapItem(newVAR, head);
 }
 
 TermVariableDescriptor * TERM_addVarArrayFloat(void* variable, uint32_t size,  float min, float max, const char * name, const char * description, uint8_t rw, term_var_cb cb, TermVariableDescriptor * head){
     //if(head == NULL) head = TERM_defaultList;
-    if(head->nameLength == 0xff) return 0;
-
-    TermVariableDescriptor * newVAR = pvPortMalloc(sizeof(TermVariableDescriptor));
-
-    newVAR->variable = variable;
-    newVAR->min_float = min;
-    newVAR->max_float = max;
-    newVAR->type = TERM_VARIABLE_FLOAT_ARRAY;
-    newVAR->typeSize = size;
-    newVAR->name = name;
-    newVAR->cb = cb;
-    newVAR->nameLength = strlen(name);
-    newVAR->variableDescription = description;
-    newVAR->rw = rw;
-
-    TERM_VAR_LIST_add(newVAR, head);
-    return newVAR;
+    if(head->count == 0xff) return 0;
+
+    TermVariableHeapItem * newVAR = pvPortMalloc(sizeof(TermVariableHeapItem));
+
+    newVAR->info.variable = variable;
+    newVAR->info.min_float = min;
+    newVAR->info.max_float = max;
+    newVAR->info.type = TERM_VARIABLE_FLOAT_ARRAY;
+    newVAR->info.typeSize = size;
+    newVAR->info.name = name;
+    newVAR->info.cb = cb;
+    newVAR->info.nameLength = strlen(name);
+    newVAR->info.variableDescription = description;
+    newVAR->info.rw = rw;
+
+    return TERM_VAR_addHeapItem(newVAR, head);
 }
 
 TermVariableDescriptor * TERM_addVarString(void* variable, uint16_t typeSize, uint32_t min, uint32_t max, const char * name, const char * description, uint8_t rw, term_var_cb cb, TermVariableDescriptor * head){
     //if(head == NULL) head = TERM_defaultList;
-    if(head->nameLength == 0xff) return 0;
-
-    TermVariableDescriptor * newVAR = pvPortMalloc(sizeof(TermVariableDescriptor));
-
-    newVAR->variable = variable;
-    newVAR->min_unsigned = 0;
-    newVAR->max_unsigned = 0;
-    newVAR->type = TERM_VARIABLE_STRING;
-    newVAR->typeSize = typeSize;
-    newVAR->name = name;
-    newVAR->cb = cb;
-    newVAR->nameLength = strlen(name);
-    newVAR->variableDescription = description;
-    newVAR->rw = rw;
-
-    TERM_VAR_LIST_add(newVAR, head);
-    return newVAR;
+    if(head->count == 0xff) return 0;
+
+    TermVariableHeapItem * newVAR = pvPortMalloc(sizeof(TermVariableHeapItem));
+
+    newVAR->info.variable = variable;
+    newVAR->info.min_unsigned = 0;
+    newVAR->info.max_unsigned = 0;
+    newVAR->info.type = TERM_VARIABLE_STRING;
+    newVAR->info.typeSize = typeSize;
+    newVAR->info.name = name;
+    newVAR->info.cb = cb;
+    newVAR->info.nameLength = strlen(name);
+    newVAR->info.variableDescription = description;
+    newVAR->info.rw = rw;
+
+    return TERM_VAR_addHeapItem(newVAR, head);
 }
 
 TermVariableDescriptor * TERM_addVarChar(void* variable, uint16_t typeSize, uint32_t min, uint32_t max, const char * name, const char * description, uint8_t rw, term_var_cb cb, TermVariableDescriptor * head){
     //if(head == NULL) head = TERM_defaultList;
-    if(head->nameLength == 0xff) return 0;
-
-    TermVariableDescriptor * newVAR = pvPortMalloc(sizeof(TermVariableDescriptor));
-
-    newVAR->variable = variable;
-    newVAR->min_unsigned = 0;
-    newVAR->max_unsigned = 0;
-    newVAR->type = TERM_VARIABLE_CHAR;
-    newVAR->typeSize = 1;
-    newVAR->name = name;
-    newVAR->cb = cb;
-    newVAR->nameLength = strlen(name);
-    newVAR->variableDescription = description;
-    newVAR->rw = rw;
-
-    TERM_VAR_LIST_add(newVAR, head);
-    return newVAR;
+    if(head->count == 0xff) return 0;
+
+    TermVariableHeapItem * newVAR = pvPortMalloc(sizeof(TermVariableHeapItem));
+
+    newVAR->info.variable = variable;
+    newVAR->info.min_unsigned = 0;
+    newVAR->info.max_unsigned = 0;
+    newVAR->info.type = TERM_VARIABLE_CHAR;
+    newVAR->info.typeSize = 1;
+    newVAR->info.name = name;
+    newVAR->info.cb = cb;
+    newVAR->info.nameLength = strlen(name);
+    newVAR->info.variableDescription = description;
+    newVAR->info.rw = rw;
+
+    return TERM_VAR_addHeapItem(newVAR, head);
 }
 
 TermVariableDescriptor * TERM_addVarBool(void* variable, uint16_t typeSize, uint32_t min, uint32_t max, const char * name, const char * description, uint8_t rw, term_var_cb cb, TermVariableDescriptor * head){
     //if(head == NULL) head = TERM_defaultList;
-    if(head->nameLength == 0xff) return 0;
-
-    TermVariableDescriptor * newVAR = pvPortMalloc(sizeof(TermVariableDescriptor));
-
-    newVAR->variable = variable;
-    newVAR->min_unsigned = 0;
-    newVAR->max_unsigned = 1;
-    newVAR->type = TERM_VARIABLE_BOOL;
-    newVAR->typeSize = sizeof(bool);
-    newVAR->name = name;
-    newVAR->cb = cb;
-    newVAR->nameLength = strlen(name);
-    newVAR->variableDescription = description;
-    newVAR->rw = rw;
-
-    TERM_VAR_LIST_add(newVAR, head);
-    return newVAR;
+    if(head->count == 0xff) return 0;
+
+    TermVariableHeapItem * newVAR = pvPortMalloc(sizeof(TermVariableHeapItem));
+
+    newVAR->info.variable = variable;
+    newVAR->info.min_unsigned = 0;
+    newVAR->info.max_unsigned = 1;
+    newVAR->info.type = TERM_VARIABLE_BOOL;
+    newVAR->info.typeSize = sizeof(bool);
+    newVAR->info.name = name;
+    newVAR->info.cb = cb;
+    newVAR->info.nameLength = strlen(name);
+    newVAR->info.variableDescription = description;
+    newVAR->info.rw = rw;
+
+    return TERM_VAR_addHeapItem(newVAR, head);
 }
 
 static uint8_t TERM_doVarListAC(TermVariableDescriptor * head, char * currInput, uint8_t length, char ** buff){
@@ -320,10 +362,10 @@ static uint8_t TERM_doVarListAC(TermVariableDescriptor * head, char * currInput,
     //UART_print("\r\nStart scan\r\n", buff[commandsFound], commandsFound+1);
 
     TermVariableDescriptor * curr = head->nextVar;
-	for(;currPos < head->nameLength; currPos++){
-		if(strncmp(currInput, curr->name, length) == 0){
-			if(strlen(curr->name) >= length){
-				buff[commandsFound] = (char*)curr->name;
+	for(;currPos < head->count; currPos++){
+		if(strncmp(currInput, curr->info->name, length) == 0){
+			if(strlen(curr->info->name) >= length){
+				buff[commandsFound] = (char*)curr->info->name;
 				commandsFound ++;
 				//UART_print("found %s (count is now %d)\r\n", buff[commandsFound], commandsFound);
 			}
@@ -350,11 +392,31 @@ uint8_t TERM_varCompleter(TERMINAL_HANDLE * handle, void * params){
 
     TermVariableDescriptor * head = handle->varHandle->varListHead;
 
+    TTERM_TRIE * trie = TERM_getVarTrie(head);
+    if(trie != NULL){
+        uint32_t count = TTERM_trie_count(trie, buff, len);
+        if(count > 0xff) count = 0xff;
+
+        handle->autocompleteBuffer = pvPortMalloc(count * sizeof(char *));
+        handle->currAutocompleteCount = 0;
+        handle->autocompleteBufferLength = 0;
+        if(handle->autocompleteBuffer != NULL){
+            //the tree hands back the descriptors, swap them for their names in place
+            handle->autocompleteBufferLength = TTERM_trie_complete(trie, buff, len, (void **) handle->autocompleteBuffer, count);
+            for(uint32_t currPos = 0; currPos < handle->autocompleteBufferLength; currPos++){
+                handle->autocompleteBuffer[currPos] = (char *) ((TermVariableDescriptor *) handle->autocompleteBuffer[currPos])->info->name;
+            }
+        }
+
+        vPortFree(buff);
+        return handle->autocompleteBufferLength;
+    }
+
     //TODO use a reasonable size here
-    handle->autocompleteBuffer = pvPortMalloc(head->nameLength * sizeof(char *));
+    handle->autocompleteBuffer = pvPortMalloc(head->count * sizeof(char *));
     handle->currAutocompleteCount = 0;
 
-    handle->autocompleteBufferLength = head->nameLength;
+    handle->autocompleteBufferLength = head->count;
     handle->autocompleteBufferLength = TERM_doVarListAC(head, buff, len, handle->autocompleteBuffer);
 
     vPortFree(buff);
@@ -414,7 +476,8 @@ static void print_var_header_update(TERMINAL_HANDLE * handle){
 }
 
 
-uint32_t TERM_var2str(TERMINAL_HANDLE * handle, TermVariableDescriptor * var, char * buffer, int32_t len ){
+uint32_t TERM_var2str(TERMINAL_HANDLE * handle, TermVariableDescriptor * desc, char * buffer, int32_t len ){
+	const TermVariableInfo * var = desc->info;
 
     uint32_t u_temp_buffer = 0;
     int32_t i_temp_buffer = 0;
@@ -500,7 +563,8 @@ uint32_t TERM_var2str(TERMINAL_HANDLE * handle, TermVariableDescriptor * var, ch
 }
 
 
-void print_var_helperfunc(TERMINAL_HANDLE * handle, TermVariableDescriptor * var, HelperFlagType flag ){
+void print_var_helperfunc(TERMINAL_HANDLE * handle, TermVariableDescriptor * desc, HelperFlagType flag ){
+	const TermVariableInfo * var = desc->info;
 
     uint32_t u_temp_buffer=0;
     int32_t i_temp_buffer=0;
@@ -671,10 +735,10 @@ uint8_t CMD_varList(TERMINAL_HANDLE * handle, uint8_t argCount, char ** args){
 
 	TermVariableDescriptor * head = handle->varHandle->varListHead;
 	TermVariableDescriptor * currVar = handle->varHandle->varListHead->nextVar;
-    for(;currPos < head->nameLength; currPos++){
+    for(;currPos < head->count; currPos++){
     	if(TERM_check_protection(currVar, handle->currPermissionLevel)){
 			if(argCount && args[0] != NULL){
-				if(strstr(currVar->name, args[0])){
+				if(strstr(currVar->info->name, args[0])){
 					print_var_helperfunc(handle, currVar, flag);
 				}
 			}else{
@@ -702,7 +766,8 @@ static float getMul(char mul){
 	}
 }
 
-static bool set_value(TermVariableDescriptor * var, char* value){
+static bool set_value(TermVariableDescriptor * desc, char* value){
+	const TermVariableInfo * var = desc->info;
 	bool truncated = false;
     uint32_t u_temp_buffer=0;
     int32_t i_temp_buffer=0;
@@ -832,78 +897,66 @@ static bool set_value(TermVariableDescriptor * var, char* value){
 
 uint8_t CMD_varSet(TERMINAL_HANDLE * handle, uint8_t argCount, char ** args){
 
-	uint32_t currPos = 0;
 	if(argCount<2){
 		ttprintf("Usage: set [name] [value]");
 		return TERM_CMD_EXIT_SUCCESS;
 	}
 
-	TermVariableDescriptor * head = handle->varHandle->varListHead;
-	TermVariableDescriptor * currVar = handle->varHandle->varListHead->nextVar;
+	TermVariableDescriptor * currVar = TERM_findVar(handle->varHandle->varListHead, args[0]);
 
-    for(;currPos < head->nameLength; currPos++){
-    	if(strcmp(args[0], currVar->name)==0){
-    		if(currVar->rw & VAR_ACCESS_W){
-    			if(TERM_check_protection(currVar, handle->currPermissionLevel) == false){
-    				ttprintf("No permission\r\n");
-    				return TERM_CMD_EXIT_SUCCESS;
-    			}
-
-				bool truncated = set_value(currVar, args[1]);
-				if(currVar->cb != NULL){
-					currVar->cb(currVar);
-				}
-				print_var_header(handle);
-				print_var_helperfunc(handle, currVar, HELPER_FLAG_DETAIL);
-				if(truncated){
-					TERM_sendVT100Code(handle, _VT100_CURSOR_SET_COLUMN, COL_B);
-					TERM_sendVT100Code(handle, _VT100_FOREGROUND_COLOR, _VT100_RED);
-					ttprintf("  Value truncated\r\n");
-					TERM_sendVT100Code(handle, _VT100_FOREGROUND_COLOR, _VT100_WHITE);
-				}
+	if(currVar != NULL){
+		if(currVar->info->rw & VAR_ACCESS_W){
+			if(TERM_check_protection(currVar, handle->currPermissionLevel) == false){
+				ttprintf("No permission\r\n");
 				return TERM_CMD_EXIT_SUCCESS;
-    		}else{
-    			ttprintf("  Variable not writable\r\n");
-    			return TERM_CMD_EXIT_SUCCESS;
-    		}
-    	}
+			}
 
-        currVar = currVar->nextVar;
-    }
+			bool truncated = set_value(currVar, args[1]);
+			if(currVar->info->cb != NULL){
+				currVar->info->cb(currVar);
+			}
+			print_var_header(handle);
+			print_var_helperfunc(handle, currVar, HELPER_FLAG_DETAIL);
+			if(truncated){
+				TERM_sendVT100Code(handle, _VT100_CURSOR_SET_COLUMN, COL_B);
+				TERM_sendVT100Code(handle, _VT100_FOREGROUND_COLOR, _VT100_RED);
+				ttprintf("  Value truncated\r\n");
+				TERM_sendVT100Code(handle, _VT100_FOREGROUND_COLOR, _VT100_WHITE);
+			}
+			return TERM_CMD_EXIT_SUCCESS;
+		}else{
+			ttprintf("  Variable not writable\r\n");
+			return TERM_CMD_EXIT_SUCCESS;
+		}
+	}
 
 	return TERM_CMD_EXIT_SUCCESS;
 }
 
 uint8_t CMD_varChown(TERMINAL_HANDLE * handle, uint8_t argCount, char ** args){
 
-	uint32_t currPos = 0;
 	if(argCount<2){
 		ttprintf("Usage: chown [name] [level]");
 		return TERM_CMD_EXIT_SUCCESS;
 	}
 
-	TermVariableDescriptor * head = handle->varHandle->varListHead;
-	TermVariableDescriptor * currVar = handle->varHandle->varListHead->nextVar;
+	TermVariableDescriptor * currVar = TERM_findVar(handle->varHandle->varListHead, args[0]);
 
-    for(;currPos < head->nameLength; currPos++){
-    	if(strcmp(args[0], currVar->name)==0){
-    			if(TERM_check_protection(currVar, handle->currPermissionLevel) == false){
-    				ttprintf(" No permission\r\n");
-    				return TERM_CMD_EXIT_SUCCESS;
-    			}
-    			uint8_t permission_level = strtoul(args[1], NULL, 0);
-    			if(permission_level>15){
-    				ttprintf(" Only permission levels <16 are allowed\r\n");
-    				return TERM_CMD_EXIT_SUCCESS;
-    			}
-    			TERM_set_protection(currVar, permission_level);
-    			ttprintf(" Changed permission to %u\r\n", permission_level);
-
-				return TERM_CMD_EXIT_SUCCESS;
-    	}
+	if(currVar != NULL){
+		if(TERM_check_protection(currVar, handle->currPermissionLevel) == false){
+			ttprintf(" No permission\r\n");
+			return TERM_CMD_EXIT_SUCCESS;
+		}
+		uint8_t permission_level = strtoul(args[1], NULL, 0);
+		if(permission_level>15){
+			ttprintf(" Only permission levels <16 are allowed\r\n");
+			return TERM_CMD_EXIT_SUCCESS;
+		}
+		TERM_set_protection(currVar, permission_level);
+		ttprintf(" Changed permission to %u\r\n", permission_level);
 
-        currVar = currVar->nextVar;
-    }
+		return TERM_CMD_EXIT_SUCCESS;
+	}
 
 	return TERM_CMD_EXIT_SUCCESS;
 }
@@ -941,26 +994,10 @@ uint8_t CMD_su(TERMINAL_HANDLE * handle, uint8_t argCount, char ** args){
 }
 
 
-typedef struct _FlashHeader_ FlashHeader;
-typedef struct _FlashFooter_ FlashFooter;
+typedef TTERM_NVM_HEADER FlashHeader;
+typedef TTERM_NVM_FOOTER FlashFooter;
 typedef struct _FlashVariable_ FlashVariable;
 
-struct _FlashHeader_{
-	uint32_t start;
-	uint32_t num_entries;
-	uint32_t size;
-	uint32_t version;
-	uint32_t revision;
-#ifdef ALLIGNED_DOUBLE_WORD
-	uint32_t padding;
-#endif
-} __attribute__((packed));
-
-struct _FlashFooter_{
-	uint32_t end;
-	uint32_t crc;
-} __attribute__((packed));
-
 struct _FlashVariable_{
     void * variable;
     TermVariableType type;
@@ -975,53 +1012,16 @@ struct _FlashVariable_{
 } __attribute__((packed));
 
 
-static uint8_t * find_next_free_memory(uint8_t * address, uint32_t storage_size){
-	//Find last active header
-	FlashHeader * header_ptr;
-	header_ptr = (FlashHeader*)address;
+static void print_headers(TERMINAL_HANDLE * handle, uint8_t * address, uint32_t storage_size){
+	FlashHeader * header_ptr = (FlashHeader*)address;
 	uint8_t * header_section = address;
-	while(header_ptr->start == HEADER_START && header_section < address + storage_size){
-		header_section += header_ptr->size;
-		header_ptr = (FlashHeader*)header_section;
-	}
-	return header_section;
-}
-
-static uint8_t * find_last_active_header(bool find_revision, uint32_t revision, uint8_t * address, uint32_t storage_size){
-	//Find last active header
-	FlashHeader * header_ptr;
-	header_ptr = (FlashHeader*)address;
-	uint32_t size_last=0;
-	uint8_t * header_section = address;
-	while(header_ptr->start == HEADER_START && header_section < address + storage_size){
-		header_section += header_ptr->size;
-		size_last = header_ptr->size;
-		if(find_revision && header_ptr->revision == revision){
-			return (uint8_t*)header_ptr;
-		}
-		header_ptr = (FlashHeader*)header_section;
-	}
-	if(find_revision){
-		return NULL;
-	}else{
-		return header_section - size_last;
-	}
-}
-
-static uint8_t * print_headers(TERMINAL_HANDLE * handle, uint8_t * address, uint32_t storage_size){
-	//Find last active header
-	FlashHeader * header_ptr;
-	header_ptr = (FlashHeader*)address;
-	uint32_t size_last=0;
-	uint8_t * header_section = address;
-	while(header_ptr->start == HEADER_START && header_section < address + storage_size){
-		FlashFooter * footer = (FlashFooter *)((uint8_t*)header_ptr + header_ptr->size - sizeof(FlashFooter));
+	while(header_ptr->start == TTERM_NVM_HEADER_START && header_ptr->size >= sizeof(FlashHeader) + sizeof(FlashFooter) && header_section + header_ptr->size <= address + storage_size){
+		const FlashFooter * footer = TTERM_nvm_footer(header_ptr);
 		ttprintf("Revision: %u Size: %u CRC: %08x \r\n", header_ptr->revision, header_ptr->size, footer->crc);
 		header_section += header_ptr->size;
-		size_last = header_ptr->size;
 		header_ptr = (FlashHeader*)header_section;
 	}
-	return header_section - size_last;
+	ttprintf("Index: %u slots\r\n", TTERM_nvm_index_count(address, storage_size));
 }
 
 uint32_t get_padding(uint32_t num, uint32_t allignement){
@@ -1031,40 +1031,6 @@ uint32_t get_padding(uint32_t num, uint32_t allignement){
 
 }
 
-uint32_t validate(TERMINAL_HANDLE * handle, FlashHeader * header){
-	TermVariableHandle * var = handle->varHandle;
-
-	FlashVariable * FlashVar = (FlashVariable*)(header + 1);
-	FlashVariable * currFlashVar = FlashVar;
-	FlashFooter * footer = (FlashFooter *)((uint8_t*)header + header->size - sizeof(FlashFooter));
-
-	uint32_t crc = TTERM_fnv1a_init();
-	crc = TTERM_fnv1a_process_data(crc, header, sizeof(FlashHeader));
-
-	//Checking CRC
-	for(uint32_t currPos=0;currPos < header->num_entries; currPos++){
-		if(currFlashVar < (FlashVariable *)var->nvm_address || currFlashVar > (FlashVariable *)(var->nvm_address + var->nvm_size)){
-			return 0;
-		}
-		crc = TTERM_fnv1a_process_data(crc, currFlashVar, sizeof(FlashVariable));
-		currFlashVar = currFlashVar->nextVar;
-	}
-
-	currFlashVar = FlashVar;
-	for(uint32_t currPos=0;currPos < header->num_entries; currPos++){
-		uint32_t size = currFlashVar->nameLength + 1 + currFlashVar->typeSize;  //Include variable data which follows the name
-
-#ifdef ALLIGNED_DOUBLE_WORD
-		size += get_padding(size, 8);
-#endif
-		crc = TTERM_fnv1a_process_data(crc, currFlashVar->name, size);
-		currFlashVar = currFlashVar->nextVar;
-	}
-
-	return TTERM_fnv1a_process_data(crc, footer, sizeof(FlashFooter) - sizeof(uint32_t));
-}
-
-
 
 uint8_t CMD_varSave(TERMINAL_HANDLE * handle, uint8_t argCount, char ** args){
 
@@ -1103,11 +1069,11 @@ uint8_t CMD_varSave(TERMINAL_HANDLE * handle, uint8_t argCount, char ** args){
 	}
 
 	//Determine how much memory is needed
-	uint32_t n_bytes = sizeof(FlashHeader) + (sizeof(FlashVariable) * head->nameLength) + sizeof(FlashFooter);  //nameLength is the number of vars here
-	for(;currPos < head->nameLength; currPos++){
+	uint32_t n_bytes = sizeof(FlashHeader) + (sizeof(FlashVariable) * head->count) + sizeof(FlashFooter);
+	for(;currPos < head->count; currPos++){
 		uint32_t bytes = 0;
-		bytes += (currVar->nameLength+1);
-		bytes += currVar->typeSize;
+		bytes += (currVar->info->nameLength+1);
+		bytes += currVar->info->typeSize;
 
 #ifdef ALLIGNED_DOUBLE_WORD
 		bytes += get_padding(bytes, 8);
@@ -1118,31 +1084,32 @@ uint8_t CMD_varSave(TERMINAL_HANDLE * handle, uint8_t argCount, char ** args){
 		currVar = currVar->nextVar;
 	}
 
-	if(n_bytes > storage_size){
-		ttprintf("Memory overflow by %u bytes\r\n", n_bytes - storage_size);
+	if(n_bytes + sizeof(TTERM_NVM_SLOT) > storage_size){
+		ttprintf("Memory overflow by %u bytes\r\n", (uint32_t)(n_bytes + sizeof(TTERM_NVM_SLOT) - storage_size));
 		return TERM_CMD_EXIT_SUCCESS;
 	}
 
-	//Find last active header and increment revision
-	FlashHeader * last_header = (FlashHeader*)find_last_active_header(false, 0, address, storage_size);
-	handle->varHandle->nvm_revision = last_header->revision + 1;
+	//Find end of last dataset and increment revision
+	uint32_t offset = TTERM_nvm_next_free(address, storage_size, &handle->varHandle->nvm_revision);
 
-	header_section = find_next_free_memory(address, storage_size);
-
-	//Check if new dataset fits into memory
-	if(header_section + n_bytes > address + storage_size){
-		header_section = address;
+	//Check if new dataset and its index slot fit into memory
+	if(TTERM_nvm_fits(address, storage_size, offset, n_bytes) == false){
+		offset = 0;
 		ttprintf("Memory full, erasing flash...\r\n");
 		var->nvm_clear(address, storage_size);
 	}
 
+	uint32_t slot_number = TTERM_nvm_index_count(address, storage_size);
+	TTERM_NVM_SLOT slot = TTERM_nvm_index_make(offset, handle->varHandle->nvm_revision);
+	header_section = address + offset;
+
 	FlashVariable * var_section 	 = (FlashVariable *)(header_section + sizeof(FlashHeader));
-	uint8_t * data_section 	 = header_section + sizeof(FlashHeader) + (sizeof(FlashVariable) * head->nameLength);
+	uint8_t * data_section 	 = header_section + sizeof(FlashHeader) + (sizeof(FlashVariable) * head->count);
 
 
-	header.start = HEADER_START;
-	header.num_entries = head->nameLength;
-	header.version = HEADER_VERSION;
+	header.start = TTERM_NVM_HEADER_START;
+	header.num_entries = head->count;
+	header.version = TTERM_NVM_HEADER_VERSION;
 	header.size = n_bytes;
 	header.revision = handle->varHandle->nvm_revision;
 
@@ -1157,14 +1124,14 @@ uint8_t CMD_varSave(TERMINAL_HANDLE * handle, uint8_t argCount, char ** args){
 	uint8_t * currData = data_section;
 
 	//Write descriptors
-	for(;currPos < head->nameLength; currPos++){
+	for(;currPos < head->count; currPos++){
 
-		uint32_t nameLengthWNull = currVar->nameLength+1;
+		uint32_t nameLengthWNull = currVar->info->nameLength+1;
 
-		temp.nameLength = currVar->nameLength;
+		temp.nameLength = currVar->info->nameLength;
 		temp.flags = currVar->flags;
-		temp.type = currVar->type;
-		temp.typeSize = currVar->typeSize;
+		temp.type = currVar->info->type;
+		temp.typeSize = currVar->info->typeSize;
 		temp.name = (const char *)currData;
 		temp.variable = currData + nameLengthWNull;
 
@@ -1179,7 +1146,7 @@ uint8_t CMD_varSave(TERMINAL_HANDLE * handle, uint8_t argCount, char ** args){
 
 		//Calculate new data section pointers
 		uint32_t bytes = nameLengthWNull;
-		bytes += currVar->typeSize;
+		bytes += currVar->info->typeSize;
 #ifdef ALLIGNED_DOUBLE_WORD
 		bytes += get_padding(bytes, 8);
 #endif
@@ -1201,23 +1168,23 @@ uint8_t CMD_varSave(TERMINAL_HANDLE * handle, uint8_t argCount, char ** args){
 		return TERM_CMD_EXIT_SUCCESS;
 	}
 
-	for(;currPos < head->nameLength; currPos++){
+	for(;currPos < head->count; currPos++){
 		memset(data_cpy,0,largest_data);
 
-		uint32_t nameLengthWNull = currVar->nameLength+1;
+		uint32_t nameLengthWNull = currVar->info->nameLength+1;
 
-		memcpy(data_cpy, currVar->name, nameLengthWNull);
-		memcpy(data_cpy + nameLengthWNull, currVar->variable, currVar->typeSize);
+		memcpy(data_cpy, currVar->info->name, nameLengthWNull);
+		memcpy(data_cpy + nameLengthWNull, currVar->info->variable, currVar->info->typeSize);
 
-		uint32_t bytes_to_write = nameLengthWNull + currVar->typeSize;
+		uint32_t bytes_to_write = nameLengthWNull + currVar->info->typeSize;
 
 #ifdef ALLIGNED_DOUBLE_WORD
 		bytes_to_write += get_padding(bytes_to_write, 8);
 #endif
 
-		//written += var->nvm_write(currData, (uint8_t*)currVar->name, nameLengthWNull);
+		//written += var->nvm_write(currData, (uint8_t*)currVar->info->name, nameLengthWNull);
 		footer.crc = TTERM_fnv1a_process_data(footer.crc, data_cpy, bytes_to_write);
-		//footer.crc = TTERM_fnv1a_process_data(footer.crc, data_cpy + nameLengthWNull, currVar->typeSize);
+		//footer.crc = TTERM_fnv1a_process_data(footer.crc, data_cpy + nameLengthWNull, currVar->info->typeSize);
 
 		written += var->nvm_write(currData, data_cpy, bytes_to_write);
 
@@ -1228,13 +1195,15 @@ uint8_t CMD_varSave(TERMINAL_HANDLE * handle, uint8_t argCount, char ** args){
 
 	vPortFree(data_cpy);
 
+	//Index slot goes in before the footer, a dataset without a footer is skipped when loading
+	written += var->nvm_write((void*)TTERM_nvm_index_slot(address, storage_size, slot_number), &slot, sizeof(TTERM_NVM_SLOT));
 
-	footer.end = FOOTER_END;
+	footer.end = TTERM_NVM_FOOTER_END;
 
 	footer.crc = TTERM_fnv1a_process_data(footer.crc, &footer, sizeof(FlashFooter)-sizeof(uint32_t));  //Dont CRC the crc field
 	written += var->nvm_end_write(currData, &footer, sizeof(FlashFooter));
 
-	uint32_t crc = validate(handle, (FlashHeader*)header_section);
+	uint32_t crc = TTERM_nvm_crc((FlashHeader*)header_section);
 
 	if(footer.crc != crc){
 		ttprintf("CRC mismatch Flash: %08x Saved: %08x\r\n", footer.crc, crc);
@@ -1243,18 +1212,19 @@ uint8_t CMD_varSave(TERMINAL_HANDLE * handle, uint8_t argCount, char ** args){
 		ttprintf("Validating flash... ok\r\n", footer.crc, crc);
 	}
 
-	ttprintf("Saved %u variables in %u bytes with CRC: %08x\r\n", head->nameLength, n_bytes, footer.crc);
+	ttprintf("Saved %u variables in %u bytes with CRC: %08x\r\n", head->count, n_bytes, footer.crc);
 
 	return TERM_CMD_EXIT_SUCCESS;
 }
 
 static void print_var_flash(TERMINAL_HANDLE * handle, FlashVariable * flashVar){
-	TermVariableDescriptor var;
-	var.name = flashVar->name;
-	var.nameLength = flashVar->nameLength;
-	var.type = flashVar->type;
-	var.typeSize = flashVar->typeSize;
-	var.variable = flashVar->variable;
+	TermVariableInfo info;
+	info.name = flashVar->name;
+	info.nameLength = flashVar->nameLength;
+	info.type = flashVar->type;
+	info.typeSize = flashVar->typeSize;
+	info.variable = flashVar->variable;
+	TermVariableDescriptor var = {.info = &info};
 	print_var_helperfunc(handle, &var, HELPER_FLAG_FLASH);
 }
 
@@ -1300,85 +1270,80 @@ uint8_t CMD_varLoad(TERMINAL_HANDLE * handle, uint8_t argCount, char ** args){
 		}
 	}
 
-	FlashHeader * header = (FlashHeader*)find_last_active_header(load_revision, revision_to_load, address, storage_size);
+	const FlashHeader * header;
 
-	if(header == NULL || header->start != HEADER_START || header->version != HEADER_VERSION){
-			ttprintf("No dataset found\r\n");
-		return TERM_CMD_EXIT_SUCCESS;
-	}
-	FlashFooter * footer = (FlashFooter *)((uint8_t*)header + header->size - sizeof(FlashFooter));
-	if(footer->end != FOOTER_END){
-		ttprintf("Unexpected footer\r\n");
-		return TERM_CMD_EXIT_SUCCESS;
+	if(load_revision){
+		header = TTERM_nvm_find_revision(address, storage_size, revision_to_load);
+		if(header != NULL && TTERM_nvm_valid(address, storage_size, (const uint8_t*)header - address) == false){
+			ttprintf("CRC mismatch in revision %u\r\n", revision_to_load);
+			return TERM_CMD_EXIT_ERROR;
+		}
+	}else{
+		//Newest dataset that passes its CRC, located through the index
+		header = TTERM_nvm_find_newest(address, storage_size);
 	}
 
-	uint32_t currPos = 0;
-	FlashVariable * FlashVar = (FlashVariable*)(header + 1);
-	FlashVariable * currFlashVar = FlashVar;
-
-	if(header > (FlashHeader *)(address + storage_size) || header < (FlashHeader *)address){
-		ttprintf("Header out of bounds\r\n");
+	if(header == NULL){
+		ttprintf("No dataset found\r\n");
 		return TERM_CMD_EXIT_SUCCESS;
 	}
 
-	uint32_t crc = validate(handle, header);
+	//Descriptors and data must lie within the validated dataset
+	const uint8_t * data_start = (const uint8_t*)header + sizeof(FlashHeader) + (sizeof(FlashVariable) * header->num_entries);
+	const uint8_t * data_end = (const uint8_t*)TTERM_nvm_footer(header);
 
-	if(footer->crc != crc){
-		ttprintf("CRC mismatch Flash: %08x Loaded: %08x\r\n", footer->crc, crc);
+	if(header->num_entries > header->size / sizeof(FlashVariable) || data_start > data_end){
+		ttprintf("Unexpected dataset layout\r\n");
 		return TERM_CMD_EXIT_ERROR;
 	}
 
-	currPos = 0;
-	currFlashVar = FlashVar;
+	const FlashVariable * FlashVar = (const FlashVariable*)(header + 1);
+
 	print_var_header_update(handle);
 
 	if(show_only == false || load_revision == true){
 		handle->varHandle->nvm_revision = header->revision;
 	}
-	for(;currPos < header->num_entries; currPos++){
+	for(uint32_t currPos = 0;currPos < header->num_entries; currPos++){
+		const FlashVariable * currFlashVar = &FlashVar[currPos];
+
+		const uint8_t * name = (const uint8_t*)currFlashVar->name;
+		if(name < data_start || name > data_end || (uint32_t)(data_end - name) < currFlashVar->nameLength + 1 + currFlashVar->typeSize){
+			ttprintf("Entry %u out of bounds\r\n", currPos);
+			continue;
+		}
+
 		if(var_to_load != NULL){
 			if(strcmp(currFlashVar->name, var_to_load) != 0){
-				currFlashVar = currFlashVar->nextVar;
 				continue;
 			}
 		}
 
 
-		print_var_flash(handle, currFlashVar);
-
-		uint32_t currUpdatePos = 0;
-		bool found_var=false;
-
-		TermVariableDescriptor * head = handle->varHandle->varListHead;
-		TermVariableDescriptor * currVar = handle->varHandle->varListHead->nextVar;
-
-		for(;currUpdatePos < head->nameLength; currUpdatePos++){
-			if(strcmp(currFlashVar->name, currVar->name)==0){
-				currVar->flags=currFlashVar->flags;
-				if(currFlashVar->type == currVar->type && currFlashVar->typeSize == currVar->typeSize){
-					if((currVar->rw & VAR_ACCESS_W)){
-						if(show_only==false && memcmp(currVar->variable, currFlashVar->variable, currVar->typeSize) != 0){
-							memcpy(currVar->variable, currFlashVar->variable, currVar->typeSize);
-							ttprintf("Updated value from flash\r\n");
-						}else{
-							ttprintf("-\r\n");
-						}
-					}else{
-						ttprintf("Not writable\r\n");
-					}
+		print_var_flash(handle, (FlashVariable*)currFlashVar);
+
+		TermVariableDescriptor * currVar = TERM_findVar(handle->varHandle->varListHead, currFlashVar->name);
+
+		if(currVar == NULL){
+			ttprintf("Cannot find variable in firmware\r\n");
+			continue;
+		}
+
+		currVar->flags=currFlashVar->flags;
+		if(currFlashVar->type == currVar->info->type && currFlashVar->typeSize == currVar->info->typeSize){
+			if((currVar->info->rw & VAR_ACCESS_W)){
+				if(show_only==false && memcmp(currVar->info->variable, currFlashVar->variable, currVar->info->typeSize) != 0){
+					memcpy(currVar->info->variable, currFlashVar->variable, currVar->info->typeSize);
+					ttprintf("Updated value from flash\r\n");
 				}else{
-					ttprintf("Type or size mismatch\r\n");
+					ttprintf("-\r\n");
 				}
-				found_var = true;
+			}else{
+				ttprintf("Not writable\r\n");
 			}
-			currVar = currVar->nextVar;
-		}
-		if(found_var==false){
-			ttprintf("Cannot find variable in firmware\r\n");
+		}else{
+			ttprintf("Type or size mismatch\r\n");
 		}
-
-
-		currFlashVar = currFlashVar->nextVar;
 	}
 
 	return TERM_CMD_EXIT_SUCCESS;
@@ -29,6 +29,7 @@
 #include "stream_buffer.h"
 
 #include "TTerm_VT100.h"
+#include "TTerm_trie.h"
 #include "TTerm/TTerm_config.h"
 #include "stdint.h"
 
@@ -122,6 +123,34 @@ typedef enum {
     char:       TERM_addVarChar, \
     char*:      TERM_addVarString)(&var, sizeof(var), min, max, name, description, rw, cb, listHandle)
 
+//Static counterparts of TERM_addVar, each expands to a TermVariableInfo initialiser so a whole
+//table can be declared const and stay in flash (see TERM_addVarTable). The variable type is
+//checked at compile time (arrays excepted, like TERM_addVarArrayFloat) and the name has to be
+//a string literal. min and max are ignored for bool.
+#define TERM_VAR_INFO(var, varType, size, name_, description, rw_, cb_, flags_) \
+    .variable = (void*)&(var), .type = (varType), .typeSize = (size), .name = (name_), .nameLength = sizeof("" name_) - 1, \
+    .variableDescription = (description), .rw = (rw_), .cb = (cb_), .flags = (flags_)
+
+#define TERM_VAR_UNSIGNED(var, min, max, name, description, rw, cb, flags) { \
+    TERM_VAR_INFO(var, _Generic((var), uint8_t: TERM_VARIABLE_UINT, uint16_t: TERM_VARIABLE_UINT, uint32_t: TERM_VARIABLE_UINT), \
+    sizeof(var), name, description, rw, cb, flags), .min_unsigned = (min), .max_unsigned = (max) }
+
+#define TERM_VAR_SIGNED(var, min, max, name, description, rw, cb, flags) { \
+    TERM_VAR_INFO(var, _Generic((var), int8_t: TERM_VARIABLE_INT, int16_t: TERM_VARIABLE_INT, int32_t: TERM_VARIABLE_INT), \
+    sizeof(var), name, description, rw, cb, flags), .min_signed = (min), .max_signed = (max) }
+
+#define TERM_VAR_FLOAT(var, min, max, name, description, rw, cb, flags) { \
+    TERM_VAR_INFO(var, _Generic((var), float: TERM_VARIABLE_FLOAT), \
+    sizeof(var), name, description, rw, cb, flags), .min_float = (min), .max_float = (max) }
+
+#define TERM_VAR_ARRAY_FLOAT(var, min, max, name, description, rw, cb, flags) { \
+    TERM_VAR_INFO(var, TERM_VARIABLE_FLOAT_ARRAY, sizeof(var), name, description, rw, cb, flags), \
+    .min_float = (min), .max_float = (max) }
+
+#define TERM_VAR_BOOL(var, min, max, name, description, rw, cb, flags) { \
+    TERM_VAR_INFO(var, _Generic((var), bool: TERM_VARIABLE_BOOL), \
+    sizeof(bool), name, description, rw, cb, flags), .min_unsigned = 0, .max_unsigned = 1 }
+
 
 typedef uint32_t (* nvm_clear)(void * address, uint32_t len);
 typedef uint32_t (* nvm_start_write)(void * address, void * buffer, uint32_t len);
@@ -129,11 +158,13 @@ typedef uint32_t (* nvm_write)(void * address, void * buffer, uint32_t len);
 typedef uint32_t (* nvm_end_write)(void * address, void * buffer, uint32_t len);
 
 
+typedef struct __TermVariableInfo__ TermVariableInfo;
 typedef struct __TermVariableDescriptor__ TermVariableDescriptor;
 
 typedef void (* term_var_cb)(TermVariableDescriptor * var);
 
-struct __TermVariableDescriptor__{
+//everything known at build time, tables of these can be const and live in flash
+struct __TermVariableInfo__{
     void * variable;
     TermVariableType type;
     uint16_t typeSize;
@@ -152,8 +183,17 @@ struct __TermVariableDescriptor__{
    		float max_float;
     };
     uint8_t rw;
-    uint32_t flags;
+    uint32_t flags;     //initial flags, copied into the descriptor when it is registered
     term_var_cb cb;
+};
+
+//list node, only the parts that change at runtime
+struct __TermVariableDescriptor__{
+    const TermVariableInfo * info;
+    union{
+        uint32_t flags;
+        uint32_t count;     //list head only, number of variables in the list
+    };
     TermVariableDescriptor * nextVar;
 };
 
@@ -269,9 +309,11 @@ typedef enum{
 } COPYCHECK_MODE;
 
 extern TermCommandDescriptor TERM_defaultList; 
+extern TTERM_TRIE TERM_cmdTrie;
 
 #if TERM_SUPPORT_VARIABLES
 extern TermVariableDescriptor TERM_varList;
+extern TTERM_TRIE TERM_varTrie;
 #endif
 
 extern TERMINAL_HANDLE null_handle;
@@ -307,6 +349,7 @@ void TERM_killProgramm(TERMINAL_HANDLE * handle);
 uint8_t TERM_doAutoComplete(TERMINAL_HANDLE * handle);
 uint8_t TERM_findMatchingCMDs(char * currInput, uint8_t length, char ** buff, TermCommandDescriptor * cmdListHead);
 TermCommandDescriptor * TERM_findCMD(TERMINAL_HANDLE * handle);
+TTERM_TRIE * TERM_getCmdTrie(TermCommandDescriptor * head);
 uint8_t TERM_findLastArg(TERMINAL_HANDLE * handle, char * buff, uint8_t * lenBuff);
 BaseType_t ptr_is_in_ram(void* ptr);
 uint8_t TERM_defaultErrorPrinter(TERMINAL_HANDLE * handle, uint32_t retCode);
@@ -35,8 +35,8 @@ http://www.isthe.com/chongo/tech/comp/fnv/index.html
 Accessed 2021-04-17
 */
 
-#ifndef MESC_FNV1A_H
-#define MESC_FNV1A_H
+#ifndef TTERM_FNV1A_H
+#define TTERM_FNV1A_H
 
 #include <stdint.h>
 
@@ -0,0 +1,140 @@
+/*
+* Copyright 2021-2023 cod3b453
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its contributors
+*    may be used to endorse or promote products derived from this software
+*    without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef TTERM_NVM_H
+#define TTERM_NVM_H
+
+#include "../../TTerm_config.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+Layout of the variable store
+
+Datasets are appended from the start of the region, each one is
+
+    TTERM_NVM_HEADER
+    TTERM_NVM_VARIABLE[num_entries]
+    name '\0' value [padding], per variable
+    TTERM_NVM_FOOTER
+
+with nothing in between, so the checksum is a single FNV pass over the bytes
+from the header up to the footer crc field.
+
+The revision index grows down from the end of the region, one slot per dataset
+in the order they were written. A slot stores the dataset offset XOR
+TTERM_NVM_INDEX_KEY so neither erased nor zeroed flash looks like a slot; the
+slots in use are always a prefix and the newest is found by bisection.
+
+Stores written before the index existed have no slots and are still found by
+walking the headers.
+*/
+
+#define TTERM_NVM_HEADER_START   UINT32_C(0xDEADBEEF)
+#define TTERM_NVM_FOOTER_END     UINT32_C(0xDEADC0DE)
+#define TTERM_NVM_HEADER_VERSION UINT32_C(0x00000001)
+
+#define TTERM_NVM_INDEX_KEY      UINT32_C(0x5EC7AB1E)
+
+// Older slots tried when the newest dataset is damaged
+#define TTERM_NVM_INDEX_RETRY    4
+
+struct TTERM_NVM_HEADER
+{
+    uint32_t start;
+    uint32_t num_entries;
+    uint32_t size;
+    uint32_t version;
+    uint32_t revision;
+#ifdef ALLIGNED_DOUBLE_WORD
+    uint32_t padding;
+#endif
+} __attribute__((packed));
+
+typedef struct TTERM_NVM_HEADER TTERM_NVM_HEADER;
+
+struct TTERM_NVM_FOOTER
+{
+    uint32_t end;
+    uint32_t crc;
+} __attribute__((packed));
+
+typedef struct TTERM_NVM_FOOTER TTERM_NVM_FOOTER;
+
+// One double word so it can be programmed on its own on every target
+struct TTERM_NVM_SLOT
+{
+    uint32_t key;
+    uint32_t revision;
+};
+
+typedef struct TTERM_NVM_SLOT TTERM_NVM_SLOT;
+
+TTERM_NVM_FOOTER const * TTERM_nvm_footer( TTERM_NVM_HEADER const * const header );
+
+// Checksum of the dataset as stored, to be compared with the footer crc
+uint32_t TTERM_nvm_crc( TTERM_NVM_HEADER const * const header );
+
+/*
+Check the dataset at offset: header, bounds, footer and checksum. Every byte
+is read once, in address order.
+*/
+bool TTERM_nvm_valid( uint8_t const * const address, uint32_t const size, uint32_t const offset );
+
+// Number of index slots in use
+uint32_t TTERM_nvm_index_count( uint8_t const * const address, uint32_t const size );
+
+// Location of index slot i
+TTERM_NVM_SLOT const * TTERM_nvm_index_slot( uint8_t const * const address, uint32_t const size, uint32_t const i );
+
+TTERM_NVM_SLOT TTERM_nvm_index_make( uint32_t const offset, uint32_t const revision );
+
+/*
+Newest valid dataset, from the index where there is one and by walking the
+headers otherwise. Returns NULL if there is none.
+*/
+TTERM_NVM_HEADER const * TTERM_nvm_find_newest( uint8_t const * const address, uint32_t const size );
+
+// Dataset with the given revision (not validated), NULL if not present
+TTERM_NVM_HEADER const * TTERM_nvm_find_revision( uint8_t const * const address, uint32_t const size, uint32_t const revision );
+
+/*
+Offset of the free space after the last dataset, also giving the revision the
+next dataset should carry.
+*/
+uint32_t TTERM_nvm_next_free( uint8_t const * const address, uint32_t const size, uint32_t * const revision );
+
+/*
+Whether a dataset of length bytes fits at offset, leaving room below the index
+for its own slot.
+*/
+bool TTERM_nvm_fits( uint8_t const * const address, uint32_t const size, uint32_t const offset, uint32_t const length );
+
+#endif
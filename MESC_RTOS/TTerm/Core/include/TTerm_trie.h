@@ -0,0 +1,105 @@
+/*
+* Copyright 2021-2022 cod3b453
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its contributors
+*    may be used to endorse or promote products derived from this software
+*    without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef TTERM_TRIE_H
+#define TTERM_TRIE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+Radix tree over the registered command and variable names.
+
+Edge labels point into the registered names themselves (which must therefore
+outlive the tree) so the only storage is the nodes, taken from the heap in
+chunks of TTERM_TRIE_CHUNK to keep the allocator overhead down.
+
+Children are kept sorted by their first byte, a depth first walk visits the
+names in strcmp order.
+*/
+
+#define TTERM_TRIE_CHUNK     16
+#define TTERM_TRIE_LABEL_MAX 255
+
+typedef void * (* TTERM_trie_alloc)( size_t size );
+
+struct TTERM_TRIE_NODE
+{
+    char const *             label;
+    struct TTERM_TRIE_NODE * child;
+    struct TTERM_TRIE_NODE * next;
+    void *                   value; // Non-NULL where a name ends
+    uint16_t                 count; // Names in this subtree
+    uint8_t                  len;
+};
+
+typedef struct TTERM_TRIE_NODE TTERM_TRIE_NODE;
+
+struct TTERM_TRIE
+{
+    TTERM_TRIE_NODE   root;
+
+    TTERM_TRIE_NODE * pool;
+    uint32_t          pool_free;
+    TTERM_trie_alloc  alloc;
+
+    // Statistics
+    uint32_t          nodes;
+    uint32_t          bytes;
+
+    // Set when an insertion could not be completed, lookups are then unreliable
+    bool              failed;
+};
+
+typedef struct TTERM_TRIE TTERM_TRIE;
+
+// Static initialiser, a zeroed tree with an allocator is ready for use
+#define TTERM_TRIE_INIT(alloc_) { .alloc = (alloc_) }
+
+void TTERM_trie_init( TTERM_TRIE * const trie, TTERM_trie_alloc const alloc );
+
+/*
+Add name[0..len) with the associated value; a name that is already present has
+its value replaced.
+*/
+bool TTERM_trie_insert( TTERM_TRIE * const trie, char const * const name, uint32_t const len, void * const value );
+
+void * TTERM_trie_find( TTERM_TRIE const * const trie, char const * const name, uint32_t const len );
+
+// Number of names starting with prefix[0..len)
+uint32_t TTERM_trie_count( TTERM_TRIE const * const trie, char const * const prefix, uint32_t const len );
+
+/*
+Store up to max values whose names start with prefix[0..len) in buff, in name
+order. Returns the number stored.
+*/
+uint32_t TTERM_trie_complete( TTERM_TRIE const * const trie, char const * const prefix, uint32_t const len, void ** const buff, uint32_t const max );
+
+#endif
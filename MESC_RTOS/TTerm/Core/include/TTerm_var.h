@@ -50,17 +50,22 @@ TermVariableDescriptor * TERM_addVarString(void* variable, uint16_t typeSize, ui
 TermVariableDescriptor * TERM_addVarChar(void* variable, uint16_t typeSize, uint32_t min, uint32_t max, const char * name, const char * description, uint8_t rw, term_var_cb cb, TermVariableDescriptor * head);
 TermVariableDescriptor * TERM_addVarBool(void* variable, uint16_t typeSize, uint32_t min, uint32_t max, const char * name, const char * description, uint8_t rw, term_var_cb cb, TermVariableDescriptor * head);
 TermVariableDescriptor * TERM_addVarArrayFloat(void* variable, uint32_t size,  float min, float max, const char * name, const char * description, uint8_t rw, term_var_cb cb, TermVariableDescriptor * head);
+uint32_t TERM_addVarTable(const TermVariableInfo * table, TermVariableDescriptor * nodes, uint32_t count, TermVariableDescriptor * head);
+
+#define TERM_VAR_TABLE_SIZE(table) (sizeof(table) / sizeof((table)[0]))
 
 void print_var_helperfunc(TERMINAL_HANDLE * handle, TermVariableDescriptor * var, HelperFlagType flag );
 uint32_t TERM_var2str(TERMINAL_HANDLE * handle, TermVariableDescriptor * var, char * buffer, int32_t len );
 
 void TERM_setFlag(TermVariableDescriptor * desc, TermFlagType flag);
 void TERM_clearFlag(TermVariableDescriptor * desc, TermFlagType flag);
+bool TERM_check_protection(TermVariableDescriptor * desc, uint8_t level);
 
 
 TermVariableHandle * TERM_VAR_init(TERMINAL_HANDLE * handle, void * nvm_address, uint32_t nvm_size, nvm_clear, nvm_start_write, nvm_write, nvm_end_write);
 
 uint8_t TERM_varCompleter(TERMINAL_HANDLE * handle, void * params);
+TermVariableDescriptor * TERM_findVar(TermVariableDescriptor * head, const char * name);
 
 
 #endif
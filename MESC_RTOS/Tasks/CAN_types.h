@@ -15,6 +15,8 @@
 #include "stdbool.h"
 #include "FreeRTOS.h"
 #include "queue.h"
+#include "semphr.h"
+#include "MESCcansess.h"
 
 typedef enum{
 	NODE_TYPE_ESC,
@@ -49,6 +51,8 @@ typedef struct {
 	QueueHandle_t rx_queue;
 	uint32_t rx_dropped;
 	QueueHandle_t tx_queue;
+	CANSESS_MUX sessions;
+	SemaphoreHandle_t session_lock;
 }TASK_CAN_handle;
 
 
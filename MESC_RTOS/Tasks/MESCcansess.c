@@ -0,0 +1,462 @@
+/*
+ **
+ ******************************************************************************
+ * @file           : MESCcansess.c
+ * @brief          : Windowed byte stream sessions over CAN
+ ******************************************************************************
+ * @attention
+ *
+ * <h2><center>&copy; Copyright (c) 2020 David Molony.
+ * All rights reserved.</center></h2>
+ *
+ * This software component is licensed under BSD 3-Clause license,
+ * the "License"; You may not use this file except in compliance with the
+ * License. You may obtain a copy of the License at:
+ *                        opensource.org/licenses/BSD-3-Clause
+ *
+ ******************************************************************************
+ *In addition to the usual 3 BSD clauses, it is explicitly noted that you
+ *do NOT have the right to take sections of this code for other projects
+ *without attribution and credit to the source. Specifically, if you copy into
+ *copyleft licenced code without attribution and retention of the permissive BSD
+ *3 clause licence, you grant a perpetual licence to do the same regarding turning sections of your code
+ *permissive, and lose any rights to use of this code previously granted or assumed.
+ *
+ *This code is intended to remain permissively licensed wherever it goes,
+ *maintaining the freedom to distribute compiled binaries WITHOUT a requirement to supply source.
+ *
+ *This is to ensure this code can at any point be used commercially, on products that may require
+ *such restriction to meet regulatory requirements, or to avoid damage to hardware, or to ensure
+ *warranties can reasonably be honoured.
+ ******************************************************************************
+ */
+
+
+#include "MESCcansess.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#define CANSESS_MASK (CANSESS_BUF_SIZE - 1)
+
+enum CANSESSSend
+{
+    CANSESS_SEND_IDLE,
+    CANSESS_SEND_SENT,
+    CANSESS_SEND_BUSY,  // Bus has no room, stop for this poll
+};
+
+typedef enum CANSESSSend CANSESSSend;
+
+static void cansess_reset( CANSESS * const s, uint8_t const remote, bool const local )
+{
+    memset( s, 0, sizeof(*s) );
+
+    s->open      = true;
+    s->local     = local;
+    s->remote    = remote;
+    s->peer_free = CANSESS_WINDOW;
+}
+
+static CANSESS * cansess_slot( CANSESS_MUX * const mux, uint8_t const remote )
+{
+    CANSESS * s = cansess_find( mux, remote );
+
+    if (s != NULL)
+    {
+        return s;
+    }
+
+    for ( uint32_t i = 0; i < CANSESS_MAX_SESSIONS; ++i )
+    {
+        if (!mux->session[i].open)
+        {
+            return &mux->session[i];
+        }
+    }
+
+    return NULL;
+}
+
+void cansess_init( CANSESS_MUX * const mux, CANSESS_send const send, void * const ctx )
+{
+    memset( mux, 0, sizeof(*mux) );
+
+    mux->send = send;
+    mux->ctx  = ctx;
+}
+
+CANSESS * cansess_open( CANSESS_MUX * const mux, uint8_t const remote )
+{
+    CANSESS * const s = cansess_slot( mux, remote );
+
+    if (s != NULL)
+    {
+        cansess_reset( s, remote, true );
+    }
+
+    return s;
+}
+
+CANSESS * cansess_accept( CANSESS_MUX * const mux, uint8_t const remote )
+{
+    CANSESS * const s = cansess_slot( mux, remote );
+
+    if (s != NULL)
+    {
+        cansess_reset( s, remote, false );
+    }
+
+    return s;
+}
+
+void cansess_close( CANSESS_MUX * const mux, uint8_t const remote )
+{
+    CANSESS * const s = cansess_find( mux, remote );
+
+    if (s != NULL)
+    {
+        s->open = false;
+    }
+}
+
+CANSESS * cansess_find( CANSESS_MUX * const mux, uint8_t const remote )
+{
+    for ( uint32_t i = 0; i < CANSESS_MAX_SESSIONS; ++i )
+    {
+        if (mux->session[i].open && (mux->session[i].remote == remote))
+        {
+            return &mux->session[i];
+        }
+    }
+
+    return NULL;
+}
+
+uint32_t cansess_tx_free( CANSESS const * const s )
+{
+    return CANSESS_BUF_SIZE - (s->tx_head - s->tx_acked);
+}
+
+uint32_t cansess_rx_avail( CANSESS const * const s )
+{
+    return s->rx_head - s->rx_tail;
+}
+
+uint32_t cansess_write( CANSESS * const s, uint8_t const * const data, uint32_t const len )
+{
+    uint32_t n = cansess_tx_free( s );
+
+    if (n > len)
+    {
+        n = len;
+    }
+
+    for ( uint32_t i = 0; i < n; ++i )
+    {
+        s->tx_buf[(s->tx_head + i) & CANSESS_MASK] = data[i];
+    }
+
+    s->tx_head = s->tx_head + n;
+
+    return n;
+}
+
+uint32_t cansess_read( CANSESS * const s, uint8_t * const data, uint32_t const len )
+{
+    uint32_t n = cansess_rx_avail( s );
+
+    if (n > len)
+    {
+        n = len;
+    }
+
+    for ( uint32_t i = 0; i < n; ++i )
+    {
+        data[i] = s->rx_buf[(s->rx_tail + i) & CANSESS_MASK];
+    }
+
+    s->rx_tail = s->rx_tail + n;
+
+    if (n > 0)
+    {
+        // Space freed, tell the sender in case it has stalled on a full window
+        s->ack_due = true;
+    }
+
+    return n;
+}
+
+static void cansess_receive_data( CANSESS * const s, uint8_t const * const data, uint8_t const len )
+{
+    uint32_t const n = (uint32_t)len - 1;
+
+    // Anything out of order or that does not fit is dropped and resent later
+    if (data[0] != s->rx_expect)
+    {
+        // A duplicate is just behind rx_expect, anything else means one went missing
+        if ((uint8_t)(s->rx_expect - data[0]) > CANSESS_WINDOW)
+        {
+            s->gap = true;
+        }
+
+        ++s->rejected;
+    }
+    else if (n > (CANSESS_BUF_SIZE - cansess_rx_avail( s )))
+    {
+        ++s->rejected;
+    }
+    else
+    {
+        for ( uint32_t i = 0; i < n; ++i )
+        {
+            s->rx_buf[(s->rx_head + i) & CANSESS_MASK] = data[1 + i];
+        }
+
+        s->rx_head   = s->rx_head + n;
+        s->rx_expect = (uint8_t)(s->rx_expect + 1);
+        ++s->frames_rx;
+    }
+
+    // Duplicates are acknowledged again, the first ack may have been lost
+    s->ack_due = true;
+}
+
+static void cansess_go_back( CANSESS * const s )
+{
+    // Frames already sent are resent with the same boundaries so sequence
+    // numbers keep their meaning
+    s->seq_next = s->seq_base;
+    s->tx_sent  = s->tx_acked;
+}
+
+static void cansess_receive_ack( CANSESS * const s, uint8_t const * const data, uint8_t const len, uint32_t const tick )
+{
+    uint8_t const next  = data[0];
+    uint8_t const acked = (uint8_t)(next - s->seq_base);
+
+    // Frames sent before a go back may be acknowledged before they are resent
+    if ((acked > 0) && (acked <= (uint8_t)(s->seq_high - s->seq_base)))
+    {
+        s->tx_acked = s->tx_end[(uint8_t)(next - 1) % CANSESS_WINDOW];
+
+        if ((uint8_t)(s->seq_next - s->seq_base) < acked)
+        {
+            s->seq_next = next;
+            s->tx_sent  = s->tx_acked;
+        }
+
+        s->seq_base = next;
+        s->tx_tick  = tick;
+        s->timeouts   = 0;
+        s->failed     = false;
+        s->recovering = false;
+    }
+
+    s->peer_free = data[1];
+
+    if ((len > 2) && ((data[2] & CANSESS_ACK_GAP) != 0) && !s->recovering && (s->seq_next != s->seq_base))
+    {
+        cansess_go_back( s );
+        s->recovering = true;
+        s->tx_tick    = tick;
+    }
+}
+
+void cansess_receive( CANSESS_MUX * const mux, CANSESSFrame const frame, uint8_t const remote,
+                      uint8_t const * const data, uint8_t const len, uint32_t const tick )
+{
+    CANSESS * s = cansess_find( mux, remote );
+
+    if ((s == NULL) && (frame == CANSESS_FRAME_DATA) && (len >= 1) && (data[0] == 0))
+    {
+        s = cansess_accept( mux, remote );
+    }
+
+    if ((s == NULL) || (len < ((frame == CANSESS_FRAME_ACK) ? 2 : 1)))
+    {
+        ++mux->unknown;
+        return;
+    }
+
+    switch (frame)
+    {
+        case CANSESS_FRAME_DATA:
+            cansess_receive_data( s, data, len );
+            break;
+        case CANSESS_FRAME_ACK:
+            cansess_receive_ack( s, data, len, tick );
+            break;
+    }
+}
+
+static void cansess_send_ack( CANSESS_MUX * const mux, CANSESS * const s )
+{
+    uint32_t free = (CANSESS_BUF_SIZE - cansess_rx_avail( s )) / CANSESS_PAYLOAD;
+    uint8_t  buf[3];
+
+    if (free > 255)
+    {
+        free = 255;
+    }
+
+    buf[0] = s->rx_expect;
+    buf[1] = (uint8_t)free;
+    buf[2] = s->gap ? CANSESS_ACK_GAP : 0;
+
+    if (mux->send( mux->ctx, CANSESS_FRAME_ACK, s->remote, buf, sizeof(buf) ))
+    {
+        s->ack_due = false;
+        s->gap     = false;
+    }
+}
+
+static void cansess_check_timeout( CANSESS * const s, uint32_t const tick )
+{
+    bool const busy = (s->seq_next != s->seq_base) || (s->tx_sent != s->tx_head);
+
+    if (!busy)
+    {
+        s->tx_tick = tick;
+        return;
+    }
+
+    if ((tick - s->tx_tick) <= CANSESS_TIMEOUT)
+    {
+        return;
+    }
+
+    cansess_go_back( s );
+    s->tx_tick    = tick;
+    s->recovering = false;
+
+    if (s->peer_free == 0)
+    {
+        // Window update lost, probe with a single frame
+        s->peer_free = 1;
+    }
+
+    ++s->timeouts;
+
+    if (s->timeouts >= CANSESS_RETRIES)
+    {
+        s->failed = true;
+
+        if (!s->local)
+        {
+            // Nobody here owns it, a remote that comes back starts again from seq 0
+            s->open = false;
+        }
+    }
+}
+
+static CANSESSSend cansess_send_one( CANSESS_MUX * const mux, CANSESS * const s )
+{
+    uint8_t const in_flight = (uint8_t)(s->seq_next - s->seq_base);
+
+    if ((in_flight >= CANSESS_WINDOW) || (in_flight >= s->peer_free) || (s->tx_sent == s->tx_head))
+    {
+        return CANSESS_SEND_IDLE;
+    }
+
+    uint8_t const seq    = s->seq_next;
+    bool const    resend = (uint8_t)(seq - s->seq_base) < (uint8_t)(s->seq_high - s->seq_base);
+    uint32_t      end;
+
+    if (resend)
+    {
+        end = s->tx_end[seq % CANSESS_WINDOW];
+    }
+    else
+    {
+        end = s->tx_sent + CANSESS_PAYLOAD;
+
+        if (end > s->tx_head)
+        {
+            end = s->tx_head;
+        }
+    }
+
+    uint8_t       buf[1 + CANSESS_PAYLOAD];
+    uint8_t const n = (uint8_t)(end - s->tx_sent);
+
+    buf[0] = seq;
+
+    for ( uint32_t i = 0; i < n; ++i )
+    {
+        buf[1 + i] = s->tx_buf[(s->tx_sent + i) & CANSESS_MASK];
+    }
+
+    if (!mux->send( mux->ctx, CANSESS_FRAME_DATA, s->remote, buf, (uint8_t)(1 + n) ))
+    {
+        return CANSESS_SEND_BUSY;
+    }
+
+    s->tx_end[seq % CANSESS_WINDOW] = end;
+    s->tx_sent  = end;
+    s->seq_next = (uint8_t)(seq + 1);
+
+    if (resend)
+    {
+        ++s->resent;
+    }
+    else
+    {
+        s->seq_high = s->seq_next;
+    }
+
+    ++s->frames_tx;
+
+    return CANSESS_SEND_SENT;
+}
+
+void cansess_poll( CANSESS_MUX * const mux, uint32_t const tick )
+{
+    for ( uint32_t i = 0; i < CANSESS_MAX_SESSIONS; ++i )
+    {
+        CANSESS * const s = &mux->session[i];
+
+        if (s->open)
+        {
+            if (s->ack_due)
+            {
+                cansess_send_ack( mux, s );
+            }
+
+            cansess_check_timeout( s, tick );
+        }
+    }
+
+    // One frame per session per round so no session can starve the others
+    bool progress = true;
+
+    while (progress)
+    {
+        progress = false;
+
+        for ( uint32_t i = 0; i < CANSESS_MAX_SESSIONS; ++i )
+        {
+            CANSESS * const s = &mux->session[(mux->next + i) % CANSESS_MAX_SESSIONS];
+
+            if (!s->open)
+            {
+                continue;
+            }
+
+            CANSESSSend const r = cansess_send_one( mux, s );
+
+            if (r == CANSESS_SEND_BUSY)
+            {
+                progress = false;
+                break;
+            }
+
+            if (r == CANSESS_SEND_SENT)
+            {
+                progress = true;
+            }
+        }
+    }
+
+    mux->next = mux->next + 1;
+}
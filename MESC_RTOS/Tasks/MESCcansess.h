@@ -0,0 +1,175 @@
+/*
+ **
+ ******************************************************************************
+ * @file           : MESCcansess.h
+ * @brief          : Windowed byte stream sessions over CAN
+ ******************************************************************************
+ * @attention
+ *
+ * <h2><center>&copy; Copyright (c) 2020 David Molony.
+ * All rights reserved.</center></h2>
+ *
+ * This software component is licensed under BSD 3-Clause license,
+ * the "License"; You may not use this file except in compliance with the
+ * License. You may obtain a copy of the License at:
+ *                        opensource.org/licenses/BSD-3-Clause
+ *
+ ******************************************************************************
+ *In addition to the usual 3 BSD clauses, it is explicitly noted that you
+ *do NOT have the right to take sections of this code for other projects
+ *without attribution and credit to the source. Specifically, if you copy into
+ *copyleft licenced code without attribution and retention of the permissive BSD
+ *3 clause licence, you grant a perpetual licence to do the same regarding turning sections of your code
+ *permissive, and lose any rights to use of this code previously granted or assumed.
+ *
+ *This code is intended to remain permissively licensed wherever it goes,
+ *maintaining the freedom to distribute compiled binaries WITHOUT a requirement to supply source.
+ *
+ *This is to ensure this code can at any point be used commercially, on products that may require
+ *such restriction to meet regulatory requirements, or to avoid damage to hardware, or to ensure
+ *warranties can reasonably be honoured.
+ ******************************************************************************
+ */
+
+
+#ifndef MESC_CANSESS_H
+#define MESC_CANSESS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+Each session is a reliable byte stream to one remote node, several can be
+open at once. The layer knows nothing about the CAN hardware or the ids in
+use; received frames are handed in by the caller and frames to send go out
+through the send callback.
+
+DATA  [seq][up to 7 bytes]
+ACK   [next seq expected][free receive space, frames][flags]
+
+Up to CANSESS_WINDOW frames are in flight, limited further by the space the
+peer reports. The receiver only accepts frames in order; when a frame is
+lost the receiver flags the gap in its next ACK and the sender goes back to
+the oldest unacknowledged frame. A lost ACK is covered by a timeout.
+
+The receiving end only gets a session once the first DATA frame (seq 0)
+arrives, so a remote that never sends one (older firmware) is never given
+one. A session that runs out of retries is marked failed; one accepted from
+a remote is closed there and then, the owner of a local one closes it.
+*/
+#define CANSESS_MAX_SESSIONS  4
+#define CANSESS_WINDOW        16     // Frames in flight, must be below 128
+#define CANSESS_PAYLOAD       7      // Bytes per DATA frame
+#define CANSESS_BUF_SIZE      256    // Per direction per session, power of two
+#define CANSESS_TIMEOUT       20     // Ticks without progress before resending
+#define CANSESS_RETRIES       10     // Timeouts in a row before the session is failed
+
+#define CANSESS_ACK_GAP       0x01   // ACK flag, a frame was received out of order
+
+enum CANSESSFrame
+{
+    CANSESS_FRAME_DATA,
+    CANSESS_FRAME_ACK,
+};
+
+typedef enum CANSESSFrame CANSESSFrame;
+
+/*
+Return false if the frame could not be queued (no mailbox free), it will be
+offered again on a later poll.
+*/
+typedef bool (* CANSESS_send)( void * ctx, CANSESSFrame const frame, uint8_t const remote, uint8_t const * const data, uint8_t const len );
+
+struct CANSESS
+{
+    bool     open;
+    bool     failed;     // Remote stopped answering
+    bool     local;      // Opened here rather than accepted from the remote
+    uint8_t  remote;
+
+    // Transmit; monotonic byte counters, buffer index is counter % CANSESS_BUF_SIZE
+    uint8_t  tx_buf[CANSESS_BUF_SIZE];
+    uint32_t tx_head;    // Written by the application
+    uint32_t tx_sent;    // Handed to the bus
+    uint32_t tx_acked;   // Confirmed by the remote
+    uint32_t tx_end[CANSESS_WINDOW]; // End of the frame with seq s at s % CANSESS_WINDOW
+    uint8_t  seq_base;   // Oldest unacknowledged
+    uint8_t  seq_next;
+    uint8_t  seq_high;   // One past the highest seq sent, beyond seq_next after a go back
+    uint8_t  peer_free;  // Frames the remote can still take
+    uint32_t tx_tick;    // Last progress
+    uint32_t timeouts;
+    bool     recovering; // Gone back, ignore further gaps until progress
+
+    // Receive
+    uint8_t  rx_buf[CANSESS_BUF_SIZE];
+    uint32_t rx_head;
+    uint32_t rx_tail;
+    uint8_t  rx_expect;
+    bool     ack_due;
+    bool     gap;        // Out of order frame since the last ACK
+
+    // Statistics
+    uint32_t frames_tx;
+    uint32_t frames_rx;
+    uint32_t resent;
+    uint32_t rejected;
+};
+
+typedef struct CANSESS CANSESS;
+
+struct CANSESS_MUX
+{
+    CANSESS      session[CANSESS_MAX_SESSIONS];
+    CANSESS_send send;
+    void *       ctx;
+    uint32_t     next;       // Round robin start
+    uint32_t     unknown;    // Frames for sessions that are not open
+};
+
+typedef struct CANSESS_MUX CANSESS_MUX;
+
+void cansess_init( CANSESS_MUX * const mux, CANSESS_send const send, void * const ctx );
+
+/*
+Start a session to remote, restarting any that exists. NULL if all slots
+are used.
+*/
+CANSESS * cansess_open( CANSESS_MUX * const mux, uint8_t const remote );
+
+/*
+Remote side of cansess_open, done by cansess_receive on the first DATA frame.
+*/
+CANSESS * cansess_accept( CANSESS_MUX * const mux, uint8_t const remote );
+
+void cansess_close( CANSESS_MUX * const mux, uint8_t const remote );
+
+CANSESS * cansess_find( CANSESS_MUX * const mux, uint8_t const remote );
+
+/*
+Queue bytes to send, returns the number accepted.
+*/
+uint32_t cansess_write( CANSESS * const s, uint8_t const * const data, uint32_t const len );
+
+/*
+Take received bytes, returns the number copied.
+*/
+uint32_t cansess_read( CANSESS * const s, uint8_t * const data, uint32_t const len );
+
+uint32_t cansess_tx_free( CANSESS const * const s );
+uint32_t cansess_rx_avail( CANSESS const * const s );
+
+/*
+A session frame arrived from remote. DATA with seq 0 from a remote without
+a session accepts one.
+*/
+void cansess_receive( CANSESS_MUX * const mux, CANSESSFrame const frame, uint8_t const remote,
+                      uint8_t const * const data, uint8_t const len, uint32_t const tick );
+
+/*
+Send acknowledgements, new data and any retransmission due. tick is any
+monotonic counter, CANSESS_TIMEOUT is in the same units.
+*/
+void cansess_poll( CANSESS_MUX * const mux, uint32_t const tick );
+
+#endif
@@ -15,6 +15,8 @@
 #define CAN_ID_PING				0x29A
 #define CAN_ID_TERMINAL			0x29B
 #define CAN_ID_CONNECT			0x29C
+#define CAN_ID_SESSION			0x29D
+#define CAN_ID_SESSION_ACK		0x29E
 
 #define CAN_ID_SPEED 			0x2A0
 
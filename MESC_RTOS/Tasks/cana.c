@@ -36,7 +36,7 @@
 #include "stdlib.h"
 
 #define APP_NAME "can"
-#define APP_DESCRIPTION "CAN test"
+#define APP_DESCRIPTION "Remote terminal over CAN, can <node id>"
 #define APP_STACK 512
 #define RAW_INPUT 1
 
@@ -79,11 +79,38 @@ static uint8_t CMD_main(TERMINAL_HANDLE * handle, uint8_t argCount, char ** args
 
 
 
-extern port_str main_can;
-
 const char reset[] = "\r\ncls\r\n";
 const char ctrl_text[] = "Press CTRL+C again to exit";
 
+#ifdef HAL_CAN_MODULE_ENABLED
+extern port_str main_can;
+
+static CANSESS * can_session_start(uint32_t id){
+    //CONNECT goes out first, the remote drops whatever it had from us when it arrives
+    while(TASK_CAN_connect(&can1,id, 1)==0){
+    	vTaskDelay(1);
+    }
+    xSemaphoreTake(can1.session_lock, portMAX_DELAY);
+    CANSESS * s = cansess_open(&can1.sessions, id);
+    if(s){
+    	cansess_write(s, (const uint8_t*)reset, sizeof(reset)-1);
+    }
+    xSemaphoreGive(can1.session_lock);
+    return s;
+}
+
+//Remotes without sessions (older firmware) get the unacknowledged terminal
+//stream, which only one can program at a time can use
+static void can_legacy_start(uint32_t id){
+    xSemaphoreTake(main_can.term_block, portMAX_DELAY);
+    xSemaphoreTake(main_can.tx_semaphore, portMAX_DELAY);
+    xSemaphoreTake(can1.session_lock, portMAX_DELAY);
+    can1.remote_node_id = id;
+    xSemaphoreGive(can1.session_lock);
+    xStreamBufferSend(main_can.tx_stream, &reset, sizeof(reset)-1, 100);
+}
+#endif
+
 static void TASK_main(void *pvParameters){
 
 
@@ -91,45 +118,62 @@ static void TASK_main(void *pvParameters){
     port_str * port = handle->port;
 #ifdef HAL_CAN_MODULE_ENABLED
 
-    xSemaphoreTake(main_can.term_block, portMAX_DELAY);
     uint8_t c=0;
     uint32_t id=0;
 
-    ttprintf("Press 2x CTRL+C to exit.\r\n");
-
     if(handle->currProgram->argCount>1){
     	id = strtoul(handle->currProgram->args[1], NULL, 10);
     }
 
-
-    while(TASK_CAN_connect(&can1,id, 1)==0){
-    	vTaskDelay(1);
+    //Each can program has its own session, so several remotes can be open at once from different terminals
+    CANSESS * session = can_session_start(id);
+    if(session == NULL){
+    	ttprintf("No free CAN session\r\n");
+    	TERM_killProgramm(handle);
+    	return;
     }
-    int8_t ctrl_cnt = 2;
-
-
-    xSemaphoreTake(main_can.tx_semaphore, portMAX_DELAY);
+    bool legacy = false;
+    uint32_t last_ping = xTaskGetTickCount();
 
-    xStreamBufferSend(main_can.tx_stream, &reset, sizeof(reset)-1, 100);
+    ttprintf("Press 2x CTRL+C to exit.\r\n");
 
-    uint32_t last_ping = xTaskGetTickCount();
+    int8_t ctrl_cnt = 2;
 
     do{
 
-    	if(xTaskGetTickCount() >  last_ping + 500){
-    		TASK_CAN_connect(&can1,id, 1);
-			last_ping = xTaskGetTickCount();
-		}
-
     	if(c!=0){
     		if(c!=CTRL_C){
     			ctrl_cnt = 2;
     		}
-			xStreamBufferSend(main_can.tx_stream, &c, 1, 100);
+    		if(legacy){
+    			xStreamBufferSend(main_can.tx_stream, &c, 1, 100);
+    		}else{
+    			xSemaphoreTake(can1.session_lock, portMAX_DELAY);
+    			cansess_write(session, &c, 1);
+    			xSemaphoreGive(can1.session_lock);
+    		}
     	}
 
     	uint8_t buffer[64];
-    	uint32_t len= xStreamBufferReceive(main_can.rx_stream, buffer, sizeof(buffer), 1);
+    	uint32_t len;
+    	bool failed = false;
+    	bool answered = false;
+    	if(legacy){
+    		len = xStreamBufferReceive(main_can.rx_stream, buffer, sizeof(buffer), 0);
+    		if(xTaskGetTickCount() > last_ping + 500){
+    			TASK_CAN_connect(&can1,id, 1);
+    			last_ping = xTaskGetTickCount();
+    		}
+    	}else{
+    		xSemaphoreTake(can1.session_lock, portMAX_DELAY);
+    		len = cansess_read(session, buffer, sizeof(buffer));
+    		failed = session->failed;
+    		answered = session->tx_acked != 0;
+    		if(failed){
+    			cansess_close(&can1.sessions, id);
+    		}
+    		xSemaphoreGive(can1.session_lock);
+    	}
     	if(len){
 			xSemaphoreTake(port->term_block, portMAX_DELAY);
 
@@ -138,10 +182,22 @@ static void TASK_main(void *pvParameters){
 			xSemaphoreGive(port->term_block);
 		}
 
-
+    	if(failed && answered){
+    		ttprintf("\r\nNo answer from node %u, reconnecting\r\n", id);
+    		session = can_session_start(id);
+    		if(session == NULL){
+    			break;
+    		}
+    	}else if(failed){
+    		//Never acknowledged anything, the remote does not know about sessions
+    		ttprintf("\r\nNode %u has no CAN sessions, using the plain terminal stream\r\n", id);
+    		session = NULL;
+    		legacy = true;
+    		can_legacy_start(id);
+    	}
 
         c=0;
-        xStreamBufferReceive(handle->currProgram->inputStream,&c,sizeof(c),pdMS_TO_TICKS(0));
+        xStreamBufferReceive(handle->currProgram->inputStream,&c,sizeof(c),pdMS_TO_TICKS(len ? 0 : 1));
         if(c==CTRL_C) {
         	ctrl_cnt--;
         	if(ctrl_cnt==1){
@@ -158,8 +214,18 @@ static void TASK_main(void *pvParameters){
 		vTaskDelay(1);
 	}
 
-    xSemaphoreGive(main_can.tx_semaphore);
-    xSemaphoreGive(main_can.term_block);
+    if(legacy){
+    	//Stop TASK_CAN_tx sending this terminal's stream on to the node
+    	xSemaphoreTake(can1.session_lock, portMAX_DELAY);
+    	can1.remote_node_id = 0;
+    	xSemaphoreGive(can1.session_lock);
+    	xSemaphoreGive(main_can.tx_semaphore);
+    	xSemaphoreGive(main_can.term_block);
+    }else if(session != NULL){
+    	xSemaphoreTake(can1.session_lock, portMAX_DELAY);
+    	cansess_close(&can1.sessions, id);
+    	xSemaphoreGive(can1.session_lock);
+    }
 #endif
     TERM_sendVT100Code(handle,_VT100_CURSOR_ENABLE, 0);
     TERM_killProgramm(handle);
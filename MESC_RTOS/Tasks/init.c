@@ -43,6 +43,10 @@
 #include "MESChw_setup.h"
 #endif
 
+#ifdef MESC
+#include "MESC/task_health.h"
+#endif
+
 
 #ifdef HAL_CAN_MODULE_ENABLED
 extern CAN_HandleTypeDef hcan1;
@@ -118,6 +122,7 @@ void init_system(void){
 	task_cli_init(&main_uart);
 #ifdef MESC
 	task_led_init();
+	task_health_init();
 #endif
 #ifdef HAL_CAN_MODULE_ENABLED
 	task_cli_init(&main_can);
@@ -149,11 +149,23 @@ void TASK_CAN_packet_received(TASK_CAN_handle * handle, uint32_t id, uint8_t sen
 			break;
 		}
 		case CAN_ID_CONNECT:{
-			if(*data){
-				handle->remote_node_id = sender;
-			}else{
-				handle->remote_node_id = 0;
+			//A remote that speaks sessions opens one with its first frame after
+			//this, anything left from before is dropped. Older remotes never
+			//send one and get the legacy terminal stream.
+			xSemaphoreTake(handle->session_lock, portMAX_DELAY);
+			CANSESS * s = cansess_find(&handle->sessions, sender);
+			if(s != NULL && s->local == false){
+				cansess_close(&handle->sessions, sender);
 			}
+			handle->remote_node_id = *data ? sender : 0;
+			xSemaphoreGive(handle->session_lock);
+			break;
+		}
+		case CAN_ID_SESSION:
+		case CAN_ID_SESSION_ACK:{
+			xSemaphoreTake(handle->session_lock, portMAX_DELAY);
+			cansess_receive(&handle->sessions, id == CAN_ID_SESSION ? CANSESS_FRAME_DATA : CANSESS_FRAME_ACK, sender, data, len, xTaskGetTickCount());
+			xSemaphoreGive(handle->session_lock);
 			break;
 		}
 		default:
@@ -181,6 +193,7 @@ void TASK_CAN_rx(void * argument){
 		HAL_GPIO_TogglePin(LED_RED_GPIO_Port, LED_RED_Pin);
 #endif
 		if(packet.message_id == CAN_ID_TERMINAL && packet.receiver == handle->node_id){
+			//Legacy unacknowledged terminal stream
 			handle->remote_node_id = packet.sender;
 			if(xStreamBufferSend(port->rx_stream, packet.buffer, packet.len, ALLOWED_BLOCK_TIME) != packet.len){
 				handle->stream_dropped++;  //Streambuffer was not consumed fast enough from other tasks
@@ -236,12 +249,6 @@ void TASK_CAN_ping(TASK_CAN_handle * handle){
 
 uint32_t TASK_CAN_connect(TASK_CAN_handle * handle, uint16_t remote, uint8_t connect){
 	if(HAL_CAN_GetTxMailboxesFreeLevel(handle->hw)){
-		if(connect){
-			handle->remote_node_id = remote;
-		}else{
-			handle->remote_node_id = 0;
-		}
-
 		uint8_t buffer[1];
 		uint32_t TxMailbox;
 		buffer[0] = connect;
@@ -270,6 +277,59 @@ TASK_CAN_node * TASK_CAN_get_node_from_id(uint8_t id){
 
 }
 
+static bool TASK_CAN_session_send(void * ctx, CANSESSFrame const frame, uint8_t const remote, uint8_t const * const data, uint8_t const len){
+	TASK_CAN_handle * handle = ctx;
+	if(HAL_CAN_GetTxMailboxesFreeLevel(handle->hw) == 0){
+		return false;
+	}
+	uint32_t TxMailbox;
+	CAN_TxHeaderTypeDef TxHeader;
+	TxHeader.ExtId = CANhelper_packMESC_id(frame == CANSESS_FRAME_DATA ? CAN_ID_SESSION : CAN_ID_SESSION_ACK, handle->node_id, remote);
+	TxHeader.RTR = CAN_RTR_DATA;
+	TxHeader.IDE = CAN_ID_EXT;
+	TxHeader.DLC = len;
+	TxHeader.TransmitGlobalTime = DISABLE;
+
+	return HAL_CAN_AddTxMessage(handle->hw, &TxHeader, (uint8_t*)data, &TxMailbox) == HAL_OK;
+}
+
+//Moves the local terminal to and from a remote that connected with a session,
+//then lets every session send what it has. Sessions opened here (can command)
+//are serviced by their own task. legacy is set when the terminal remote has
+//no session and wants the plain stream.
+static bool TASK_CAN_session_service(port_str * port, TASK_CAN_handle * handle, bool * legacy){
+	uint8_t buffer[32];
+	bool busy = false;
+
+	xSemaphoreTake(handle->session_lock, portMAX_DELAY);
+
+	CANSESS * s = cansess_find(&handle->sessions, handle->remote_node_id);
+	*legacy = (s == NULL || s->local);
+	if(!*legacy){
+		uint32_t space = xStreamBufferSpacesAvailable(port->rx_stream);
+		uint32_t len = cansess_read(s, buffer, space < sizeof(buffer) ? space : sizeof(buffer));
+		if(len){
+			xStreamBufferSend(port->rx_stream, buffer, len, 0);
+		}
+
+		uint32_t free = cansess_tx_free(s);
+		len = xStreamBufferReceive(port->tx_stream, buffer, free < sizeof(buffer) ? free : sizeof(buffer), 0);
+		cansess_write(s, buffer, len);
+	}
+
+	cansess_poll(&handle->sessions, xTaskGetTickCount());
+
+	for(uint32_t i=0;i<CANSESS_MAX_SESSIONS;i++){
+		CANSESS * si = &handle->sessions.session[i];
+		if(si->open && (si->tx_sent != si->tx_head || si->seq_next != si->seq_base || si->ack_due)){
+			busy = true;
+		}
+	}
+
+	xSemaphoreGive(handle->session_lock);
+	return busy;
+}
+
 void TASK_CAN_tx(void * argument){
 
 	port_str * port = argument;
@@ -282,7 +342,11 @@ void TASK_CAN_tx(void * argument){
 	TASK_CAN_packet packet;
 
 	while(1){
-		if(HAL_CAN_GetTxMailboxesFreeLevel(handle->hw)){
+		bool legacy;
+		bool session_busy = TASK_CAN_session_service(port, handle, &legacy);
+
+		if(legacy && HAL_CAN_GetTxMailboxesFreeLevel(handle->hw)){
+			//Remote without a session, fall back to the unacknowledged stream
 			uint8_t buffer[8];
 
 			uint8_t len = xStreamBufferReceive(port->tx_stream, buffer, sizeof(buffer), 0);
@@ -342,7 +406,7 @@ void TASK_CAN_tx(void * argument){
 		}
 
 
-		if(xStreamBufferIsEmpty(port->tx_stream) && uxQueueMessagesWaiting(handle->tx_queue) == 0){
+		if(session_busy == false && xStreamBufferIsEmpty(port->tx_stream) && uxQueueMessagesWaiting(handle->tx_queue) == 0){
 			vTaskDelay(10);
 		}
 		vTaskDelay(1);
@@ -391,6 +455,9 @@ void TASK_CAN_init(port_str * port, char * short_name){
 	memset(handle->short_name,0,9);
 	strncpy(handle->short_name, short_name, 8);
 
+	handle->session_lock = xSemaphoreCreateMutex();
+	cansess_init(&handle->sessions, TASK_CAN_session_send, handle);
+
 	handle->rx_queue = xQueueCreate(128, sizeof(TASK_CAN_packet));
 	handle->tx_queue = xQueueCreate(128, sizeof(TASK_CAN_packet));
 
@@ -482,6 +549,13 @@ uint8_t CMD_can_send(TERMINAL_HANDLE * handle, uint8_t argCount, char ** args){
 		}
 		if(strcmp(args[i], "-i")==0){
 			ttprintf("Dropped frames\r\nTX: %u RX: %u\r\n", can1.stream_dropped, can1.rx_dropped);
+			for(uint32_t j=0;j<CANSESS_MAX_SESSIONS;j++){
+				CANSESS * s = &can1.sessions.session[j];
+				if(s->open){
+					ttprintf("Session %u: %s TX: %u RX: %u Resent: %u Rejected: %u%s\r\n", s->remote, s->local ? "out" : "in",
+							s->frames_tx, s->frames_rx, s->resent, s->rejected, s->failed ? " failed" : "");
+				}
+			}
 		}
 	}
 
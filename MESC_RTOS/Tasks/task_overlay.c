@@ -159,10 +159,10 @@ void show_overlay(TERMINAL_HANDLE * handle){
 uint32_t format_json(TERMINAL_HANDLE * handle, TermVariableDescriptor * desc, char * buffer, int32_t len){
 	uint32_t written=0;
 	uint32_t bytes_written=0;
-	if(desc->type == TERM_VARIABLE_CHAR || desc->type == TERM_VARIABLE_STRING){
-		written = snprintf(buffer, len, "\"%s\":\"", desc->name);
+	if(desc->info->type == TERM_VARIABLE_CHAR || desc->info->type == TERM_VARIABLE_STRING){
+		written = snprintf(buffer, len, "\"%s\":\"", desc->info->name);
 	}else{
-		written = snprintf(buffer, len, "\"%s\":", desc->name);
+		written = snprintf(buffer, len, "\"%s\":", desc->info->name);
 	}
 	buffer += written;
 	len -= written;
@@ -171,7 +171,7 @@ uint32_t format_json(TERMINAL_HANDLE * handle, TermVariableDescriptor * desc, ch
 	buffer += written;
 	len -= written;
 	bytes_written += written;
-	if(desc->type == TERM_VARIABLE_CHAR || desc->type == TERM_VARIABLE_STRING){
+	if(desc->info->type == TERM_VARIABLE_CHAR || desc->info->type == TERM_VARIABLE_STRING){
 		written = snprintf(buffer, len, "\",");
 	}else{
 		written = snprintf(buffer, len, ",");
@@ -199,7 +199,7 @@ void show_overlay_json(TERMINAL_HANDLE * handle){
 	uint32_t currPos = 0;
 	TermVariableDescriptor * head = handle->varHandle->varListHead;
 	TermVariableDescriptor * currVar = handle->varHandle->varListHead->nextVar;
-    for(;currPos < head->nameLength; currPos++){
+    for(;currPos < head->count; currPos++){
 
     	if(currVar->flags & FLAG_TELEMETRY_ON){
     		written = format_json(handle, currVar, ptr, bytes_left);
@@ -330,22 +330,16 @@ uint8_t CMD_status(TERMINAL_HANDLE * handle, uint8_t argCount, char ** args){
 
 
 void log_mod(TERMINAL_HANDLE * handle, char * name, bool delete){
-	uint32_t currPos = 0;
-	TermVariableDescriptor * head = handle->varHandle->varListHead;
-	TermVariableDescriptor * currVar = handle->varHandle->varListHead->nextVar;
-
-	for(;currPos < head->nameLength; currPos++){
-
-		if(strcmp(name, currVar->name)==0){
-			if(delete){
-				ttprintf("Removed [%s] from log list\r\n", name);
-				TERM_clearFlag(currVar, FLAG_TELEMETRY_ON);
-			}else{
-				ttprintf("Added [%s] to log list\r\n", name);
-				TERM_setFlag(currVar, FLAG_TELEMETRY_ON);
-			}
+	TermVariableDescriptor * currVar = TERM_findVar(handle->varHandle->varListHead, name);
+
+	if(currVar != NULL){
+		if(delete){
+			ttprintf("Removed [%s] from log list\r\n", name);
+			TERM_clearFlag(currVar, FLAG_TELEMETRY_ON);
+		}else{
+			ttprintf("Added [%s] to log list\r\n", name);
+			TERM_setFlag(currVar, FLAG_TELEMETRY_ON);
 		}
-		currVar = currVar->nextVar;
 	}
 }
 
@@ -563,10 +557,10 @@ uint8_t CMD_log(TERMINAL_HANDLE * handle, uint8_t argCount, char ** args){
 
 		ttprintf("Datasources selected for log output:\r\n");
 
-	    for(;currPos < head->nameLength; currPos++){
+	    for(;currPos < head->count; currPos++){
 
 	    	if(currVar->flags & FLAG_TELEMETRY_ON){
-	    		ttprintf("\t%u: %s\r\n", count, currVar->name);
+	    		ttprintf("\t%u: %s\r\n", count, currVar->info->name);
 	    		count++;
 	    	}
 	    	currVar = currVar->nextVar;
@@ -579,7 +573,7 @@ uint8_t CMD_log(TERMINAL_HANDLE * handle, uint8_t argCount, char ** args){
 		TermVariableDescriptor * head = handle->varHandle->varListHead;
 		TermVariableDescriptor * currVar = handle->varHandle->varListHead->nextVar;
 
-		for(;currPos < head->nameLength; currPos++){
+		for(;currPos < head->count; currPos++){
 
 			if(currVar->flags & FLAG_TELEMETRY_ON){
 				TERM_clearFlag(currVar, FLAG_TELEMETRY_ON);
@@ -26,11 +26,13 @@
 
 #ifdef MESC
 #include "MESCfoc.h"
+#include "MESC/task_health.h"
 #endif
 
 #define APP_NAME "top"
-#define APP_DESCRIPTION "shows performance stats"
+#define APP_DESCRIPTION "shows performance stats, r resets the worst cases"
 #define APP_STACK 400
+#define APP_MAX_TASKS 16
 
 static uint8_t CMD_main(TERMINAL_HANDLE * handle, uint8_t argCount, char ** args);
 static void TASK_main(void *pvParameters);
@@ -73,16 +75,22 @@ static uint8_t CMD_main(TERMINAL_HANDLE * handle, uint8_t argCount, char ** args
 static void TASK_main(void *pvParameters){
     TERMINAL_HANDLE * handle = (TERMINAL_HANDLE*)pvParameters;
 
+    //One snapshot per running top, taken once at start rather than each refresh
+    //since a starved heap is when top is needed most
+    TaskStatus_t * taskStats = pvPortMalloc(sizeof(TaskStatus_t) * APP_MAX_TASKS);
+    if(taskStats == NULL){
+        ttprintf("Not enough memory\r\n");
+        TERM_killProgramm(handle);
+        return;
+    }
+
     char c=0;
     do{
         
-        TaskStatus_t * taskStats;
-        uint32_t taskCount = uxTaskGetNumberOfTasks();
         uint32_t sysTime;
-                
-        taskStats = pvPortMalloc( taskCount * sizeof( TaskStatus_t ) );
-        if(taskStats){
-            taskCount = uxTaskGetSystemState(taskStats, taskCount, &sysTime);
+        uint32_t taskCount = uxTaskGetSystemState(taskStats, APP_MAX_TASKS, &sysTime);
+
+        if(taskCount){
             
             TERM_sendVT100Code(handle, _VT100_CURSOR_POS1, 0);
         
@@ -108,6 +116,16 @@ static void TASK_main(void *pvParameters){
             uint32_t cycles_left = cycles_available - max_cycles;
             float foc_load = 100.0f / cycles_available * max_cycles;
             ttprintf("%sFOC load %3.0f%% - PWMloop: %5d Fastloop: %5d Cycles to overrun: %5d\r\n", TERM_getVT100Code(_VT100_ERASE_LINE_END, 0),foc_load , sum_pwmloop, sum_fastloop, cycles_left);
+
+            uint32_t worst_fastloop=0;
+            uint32_t worst_pwmloop=0;
+            for(int i=0;i<NUM_MOTORS;i++){
+            	worst_fastloop += mtr[i].health_fastloop.worst;
+            	worst_pwmloop += mtr[i].health_pwmloop.worst;
+            }
+            HEALTH_TASK const * lowest = health_lowest_stack(&health);
+            ttprintf("%sWorst  - PWMloop: %5d Fastloop: %5d Overruns: %d Lowest stack: %s %d%s\r\n", TERM_getVT100Code(_VT100_ERASE_LINE_END, 0), worst_pwmloop, worst_fastloop, health.overruns,
+            		lowest ? lowest->name : "-", lowest ? lowest->stack_min : 0, health.warnings ? " WARNING" : "");
 #endif
             uint32_t heapRemaining = xPortGetFreeHeapSize();
             ttprintf("%sMem: \t%db total,\t %db free,\t %db used (%d%%)\r\n", TERM_getVT100Code(_VT100_ERASE_LINE_END, 0), configTOTAL_HEAP_SIZE, heapRemaining, configTOTAL_HEAP_SIZE - heapRemaining, ((configTOTAL_HEAP_SIZE - heapRemaining) * 100) / configTOTAL_HEAP_SIZE);
@@ -130,13 +148,13 @@ static void TASK_main(void *pvParameters){
                             , 38 + configMAX_TASK_NAME_LEN, taskStats[currTask].usStackHighWaterMark, 45 + configMAX_TASK_NAME_LEN, 0);
                 }
             }
-            vPortFree(taskStats);
         }else{
-            ttprintf("Malloc failed\r\n");
+            ttprintf("More than %d tasks\r\n", APP_MAX_TASKS);
         }
         
         xStreamBufferReceive(handle->currProgram->inputStream,&c,sizeof(c),pdMS_TO_TICKS(1000));
     }while(c!=CTRL_C);
+    vPortFree(taskStats);
     TERM_killProgramm(handle);
 }
 
@@ -148,6 +166,15 @@ static uint8_t INPUT_handler(TERMINAL_HANDLE * handle, uint16_t c){
             c=CTRL_C;
             xStreamBufferSend(handle->currProgram->inputStream,&c,1,20);
             return TERM_CMD_EXIT_SUCCESS;
+#ifdef MESC
+        case 'r':
+            for(int i=0;i<NUM_MOTORS;i++){
+            	//The ISRs own these, they clear them at their next sample
+            	health_isr_request_reset(&mtr[i].health_fastloop);
+            	health_isr_request_reset(&mtr[i].health_pwmloop);
+            }
+            return TERM_CMD_CONTINUE;
+#endif
         default:
             return TERM_CMD_CONTINUE;
     }